@@ -6,6 +6,11 @@
 #include "mqnic.h"
 #include <linux/module.h>
 #include <linux/pci.h>
+#include <linux/debugfs.h>
+#include <linux/iommu.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/sort.h>
 
 /*
  * compitability for newer kernels where PCI_DMA_XXX flags were renamed to DMA_XXX
@@ -29,6 +34,82 @@ MODULE_AUTHOR("Alex Forencich");
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_VERSION("0.1");
 
+static unsigned int probe_sweep;
+
+module_param(probe_sweep, uint, 0444);
+MODULE_PARM_DESC(probe_sweep, "run the fixed benchmark sweep at probe time (default: 0)");
+
+static int irq_index = -1;
+
+module_param(irq_index, int, 0444);
+MODULE_PARM_DESC(irq_index, "IRQ vector that wakes block transfer waits, -1 to sleep-poll only (default: -1)");
+
+/*
+ * On-demand runs through debugfs, mqnic_app_dma_bench/<device>/:
+ *   dir     0 = read (host to card), 1 = write (card to host)
+ *   mem     0 = dma_alloc_coherent buffer, 1 = alloc_pages_node + dma_map_page,
+ *           2 = as 1 but from a 2 MiB compound page
+ *   node    host NUMA node for mem=1/2; out of range for no preference
+ *   size    block size in bytes (up to the 16 KiB buffer)
+ *   stride  block stride in bytes
+ *   count   number of blocks
+ *   samples per-request latency samples to collect after the run (0 = off)
+ *   entries submission queue entries of count blocks each, run back to back
+ *           (0 = program the engine directly)
+ *   inflight cap on DMA operations in flight (0 = DMA engine limit)
+ *   run     write to start a run; read for the last result as key=value pairs
+ *   hist    latency summary and log2 histogram of the last sampled run
+ *   matrix  write to sweep direction, size and placement on every node;
+ *           read for one result line per combination
+ *   depth   write to sweep inflight from 1 up to the engine limit with the
+ *           current parameters; read for aggregate throughput per depth
+ */
+static struct dentry *dma_bench_debugfs_root;
+
+enum {
+	DMA_BENCH_DIR_READ = 0,
+	DMA_BENCH_DIR_WRITE = 1
+};
+
+enum {
+	DMA_BENCH_MEM_COHERENT = 0,
+	DMA_BENCH_MEM_PAGES = 1,
+	DMA_BENCH_MEM_HUGE = 2
+};
+
+#define DMA_BENCH_HUGE_ORDER get_order(SZ_2M)
+#define DMA_BENCH_MATRIX_MIN_SIZE 64
+#define DMA_BENCH_LINE_LEN 256
+
+#define DMA_BENCH_HIST_BUCKETS 64
+#define DMA_BENCH_MAX_SAMPLES 1000000
+
+// block transfers spin this long before sleeping between status reads
+#define DMA_BENCH_SPIN_NS 50000
+
+#define DMA_BENCH_CPL_RING_LOG_SIZE 4
+#define DMA_BENCH_CPL_RING_SIZE (1 << DMA_BENCH_CPL_RING_LOG_SIZE)
+
+#define DMA_BENCH_MAX_INFLIGHT 256
+
+struct dma_bench_hist {
+	u64 samples;
+	u64 min;
+	u64 max;
+	u64 p50;
+	u64 p99;
+	u64 p999;
+	u64 bucket[DMA_BENCH_HIST_BUCKETS];
+};
+
+struct dma_bench_result {
+	u64 time;
+	u64 op_count;
+	u64 op_latency;
+	u64 req_count;
+	u64 req_latency;
+};
+
 struct mqnic_app_dma_bench {
 	struct device *dev;
 	struct mqnic_dev *mdev;
@@ -43,10 +124,40 @@ struct mqnic_app_dma_bench {
 	struct mqnic_reg_block *rb_list;
 	struct mqnic_reg_block *dma_bench_rb;
 
+	// completion wakeup
+	wait_queue_head_t irq_wait;
+	struct notifier_block irq_nb;
+	int irq_index;
+
+	// block completion ring
+	__le32 *cpl_ring;
+	dma_addr_t cpl_ring_addr;
+	u32 cpl_ring_tail;
+
+	// submission queue entries per direction, 0 if not supported
+	u32 queue_size;
+
 	// DMA buffer
 	size_t dma_region_len;
 	void *dma_region;
 	dma_addr_t dma_region_addr;
+
+	// on-demand benchmark
+	struct dentry *debugfs_dir;
+	struct mutex bench_lock;
+	u32 bench_dir;
+	u32 bench_mem;
+	u32 bench_node;
+	u64 bench_size;
+	u64 bench_stride;
+	u64 bench_count;
+	u32 bench_samples;
+	u32 bench_entries;
+	u32 bench_inflight;
+	char bench_result[DMA_BENCH_LINE_LEN];
+	char *bench_matrix;
+	char *bench_depth;
+	struct dma_bench_hist bench_hist;
 };
 
 const char *dma_bench_stats_names[] = {
@@ -192,6 +303,103 @@ static void dma_write(struct mqnic_app_dma_bench *app,
 		dev_warn(app->dev, "%s: tag %d (expected %d)", __func__, new_tag, tag);
 }
 
+static int dma_bench_irq(struct notifier_block *nb, unsigned long action, void *data)
+{
+	struct mqnic_app_dma_bench *app = container_of(nb, struct mqnic_app_dma_bench, irq_nb);
+
+	// vector may be shared with EQs, waiters re-check the busy bit
+	wake_up(&app->irq_wait);
+
+	return NOTIFY_DONE;
+}
+
+static void dma_bench_cpl_ring_enable(struct mqnic_app_dma_bench *app)
+{
+	app->cpl_ring = dma_alloc_coherent(app->nic_dev, DMA_BENCH_CPL_RING_SIZE * sizeof(*app->cpl_ring),
+			&app->cpl_ring_addr, GFP_KERNEL | __GFP_ZERO);
+	if (!app->cpl_ring)
+		return;
+
+	app->cpl_ring_tail = 0;
+
+	iowrite32(app->cpl_ring_addr & 0xffffffff, app->dma_bench_rb->regs + 0x080);
+	iowrite32((app->cpl_ring_addr >> 32) & 0xffffffff, app->dma_bench_rb->regs + 0x084);
+	iowrite32(0x80000000 | DMA_BENCH_CPL_RING_LOG_SIZE, app->dma_bench_rb->regs + 0x088);
+
+	// older blocks and cores without immediate writes leave the enable bit clear
+	if ((ioread32(app->dma_bench_rb->regs + 0x088) & 0x80000000) == 0) {
+		dev_info(app->dev, "Block completion ring not supported, polling status registers");
+		dma_free_coherent(app->nic_dev, DMA_BENCH_CPL_RING_SIZE * sizeof(*app->cpl_ring),
+				app->cpl_ring, app->cpl_ring_addr);
+		app->cpl_ring = NULL;
+	}
+}
+
+static void dma_bench_cpl_ring_disable(struct mqnic_app_dma_bench *app)
+{
+	if (!app->cpl_ring)
+		return;
+
+	iowrite32(0, app->dma_bench_rb->regs + 0x088);
+	ioread32(app->dma_bench_rb->regs + 0x088); // flush
+
+	dma_free_coherent(app->nic_dev, DMA_BENCH_CPL_RING_SIZE * sizeof(*app->cpl_ring),
+			app->cpl_ring, app->cpl_ring_addr);
+	app->cpl_ring = NULL;
+}
+
+// with the completion ring this only looks at host memory
+static bool dma_block_idle(struct mqnic_app_dma_bench *app, u32 reg)
+{
+	if (app->cpl_ring) {
+		__le32 *rec = &app->cpl_ring[app->cpl_ring_tail & (DMA_BENCH_CPL_RING_SIZE - 1)];
+		u32 phase = app->cpl_ring_tail & DMA_BENCH_CPL_RING_SIZE ? 0 : 0x80000000;
+
+		return (le32_to_cpu(READ_ONCE(*rec)) & 0x80000000) == phase;
+	}
+
+	return (ioread32(app->dma_bench_rb->regs + reg) & 1) == 0;
+}
+
+static bool dma_block_complete(struct mqnic_app_dma_bench *app)
+{
+	if (app->cpl_ring) {
+		dma_rmb();
+		app->cpl_ring_tail++;
+	}
+
+	return true;
+}
+
+// wait for a block operation to finish; the cycle counter in hardware
+// times the run, so sleeping here does not skew the result
+static bool dma_bench_wait_idle(struct mqnic_app_dma_bench *app, u32 reg,
+		unsigned int timeout_ms)
+{
+	u64 spin = ktime_get_ns() + DMA_BENCH_SPIN_NS;
+	unsigned long t = jiffies + msecs_to_jiffies(timeout_ms);
+
+	while (ktime_get_ns() < spin) {
+		if (dma_block_idle(app, reg))
+			return dma_block_complete(app);
+	}
+
+	while (!dma_block_idle(app, reg)) {
+		if (time_after_eq(jiffies, t)) {
+			// resynchronize with the producer
+			if (app->cpl_ring)
+				app->cpl_ring_tail = ioread32(app->dma_bench_rb->regs + 0x08c);
+			return false;
+		}
+
+		// the block raises no interrupt of its own, so without a
+		// wakeup vector this re-checks once per tick
+		wait_event_timeout(app->irq_wait, dma_block_idle(app, reg), 1);
+	}
+
+	return dma_block_complete(app);
+}
+
 static void dma_block_read(struct mqnic_app_dma_bench *app,
 		dma_addr_t dma_addr, size_t dma_offset,
 		size_t dma_offset_mask, size_t dma_stride,
@@ -199,8 +407,6 @@ static void dma_block_read(struct mqnic_app_dma_bench *app,
 		size_t ram_offset_mask, size_t ram_stride,
 		size_t block_len, size_t block_count)
 {
-	unsigned long t;
-
 	// DMA base address
 	iowrite32(dma_addr & 0xffffffff, app->dma_bench_rb->regs + 0x380);
 	iowrite32((dma_addr >> 32) & 0xffffffff, app->dma_bench_rb->regs + 0x384);
@@ -236,13 +442,7 @@ static void dma_block_read(struct mqnic_app_dma_bench *app,
 	iowrite32(1, app->dma_bench_rb->regs + 0x300);
 
 	// wait for transfer to complete
-	t = jiffies + msecs_to_jiffies(20000);
-	while (time_before(jiffies, t)) {
-		if ((ioread32(app->dma_bench_rb->regs + 0x300) & 1) == 0)
-			break;
-	}
-
-	if ((ioread32(app->dma_bench_rb->regs + 0x300) & 1) != 0)
+	if (!dma_bench_wait_idle(app, 0x300, 20000))
 		dev_warn(app->dev, "%s: operation timed out", __func__);
 }
 
@@ -253,8 +453,6 @@ static void dma_block_write(struct mqnic_app_dma_bench *app,
 		size_t ram_offset_mask, size_t ram_stride,
 		size_t block_len, size_t block_count)
 {
-	unsigned long t;
-
 	// DMA base address
 	iowrite32(dma_addr & 0xffffffff, app->dma_bench_rb->regs + 0x480);
 	iowrite32((dma_addr >> 32) & 0xffffffff, app->dma_bench_rb->regs + 0x484);
@@ -290,19 +488,69 @@ static void dma_block_write(struct mqnic_app_dma_bench *app,
 	iowrite32(1, app->dma_bench_rb->regs + 0x400);
 
 	// wait for transfer to complete
-	t = jiffies + msecs_to_jiffies(20000);
-	while (time_before(jiffies, t)) {
-		if ((ioread32(app->dma_bench_rb->regs + 0x400) & 1) == 0)
-			break;
+	if (!dma_bench_wait_idle(app, 0x400, 20000))
+		dev_warn(app->dev, "%s: operation timed out", __func__);
+}
+
+// run entries queued copies of one block operation back to back, base is
+// 0x300 for block read or 0x400 for block write
+static void dma_block_queue(struct mqnic_app_dma_bench *app, u32 base,
+		dma_addr_t dma_addr, size_t stride, size_t block_len,
+		size_t block_count, u32 entries)
+{
+	u8 __iomem *regs = app->dma_bench_rb->regs + base;
+	u32 k;
+
+	// DMA base address
+	iowrite32(dma_addr & 0xffffffff, regs + 0x080);
+	iowrite32((dma_addr >> 32) & 0xffffffff, regs + 0x084);
+	// DMA offset address
+	iowrite32(0, regs + 0x088);
+	iowrite32(0, regs + 0x08c);
+	// DMA offset mask
+	iowrite32(0x3fff, regs + 0x090);
+	iowrite32(0, regs + 0x094);
+	// RAM base address
+	iowrite32(0, regs + 0x0c0);
+	iowrite32(0, regs + 0x0c4);
+	// RAM offset address
+	iowrite32(0, regs + 0x0c8);
+	iowrite32(0, regs + 0x0cc);
+	// RAM offset mask
+	iowrite32(0x3fff, regs + 0x0d0);
+	iowrite32(0, regs + 0x0d4);
+	// clear cycle count
+	iowrite32(0, regs + 0x008);
+	iowrite32(0, regs + 0x00c);
+	// no block count of its own, every block comes from the queue
+	iowrite32(0, regs + 0x018);
+	// flush and fill queue
+	iowrite32(0x80000000, regs + 0x04c);
+	for (k = 0; k < entries; k++) {
+		iowrite32(block_len, regs + 0x040);
+		iowrite32(stride, regs + 0x044);
+		iowrite32(block_count, regs + 0x048);
+		iowrite32(0, regs + 0x04c);
 	}
+	// start
+	iowrite32(1, regs + 0x000);
 
-	if ((ioread32(app->dma_bench_rb->regs + 0x400) & 1) != 0)
+	// wait for transfer to complete
+	if (!dma_bench_wait_idle(app, base, 20000))
 		dev_warn(app->dev, "%s: operation timed out", __func__);
 }
 
+static void dma_bench_set_inflight(struct mqnic_app_dma_bench *app, u32 inflight)
+{
+	iowrite32(inflight, app->dma_bench_rb->regs + 0x320);
+	iowrite32(inflight, app->dma_bench_rb->regs + 0x420);
+}
+
 static void dma_block_read_bench(struct mqnic_app_dma_bench *app,
-		dma_addr_t dma_addr, u64 size, u64 stride, u64 count)
+		dma_addr_t dma_addr, u64 size, u64 stride, u64 count, u32 entries,
+		struct dma_bench_result *res)
 {
+	u64 blocks = count * max_t(u32, entries, 1);
 	u64 time;
 	u64 op_count;
 	u64 op_latency;
@@ -316,8 +564,11 @@ static void dma_block_read_bench(struct mqnic_app_dma_bench *app,
 	req_count = mqnic_stats_read(app->mdev, 36);
 	req_latency = mqnic_stats_read(app->mdev, 37);
 
-	dma_block_read(app, dma_addr, 0, 0x3fff, stride,
-			0, 0, 0x3fff, stride, size, count);
+	if (entries)
+		dma_block_queue(app, 0x300, dma_addr, stride, size, count, entries);
+	else
+		dma_block_read(app, dma_addr, 0, 0x3fff, stride,
+				0, 0, 0x3fff, stride, size, count);
 
 	time = mqnic_core_clk_cycles_to_ns(app->mdev, ioread32(app->dma_bench_rb->regs + 0x308));
 
@@ -328,14 +579,29 @@ static void dma_block_read_bench(struct mqnic_app_dma_bench *app,
 	req_count = mqnic_stats_read(app->mdev, 36) - req_count;
 	req_latency = mqnic_core_clk_cycles_to_ns(app->mdev, mqnic_stats_read(app->mdev, 37) - req_latency);
 
+	if (res) {
+		res->time = time;
+		res->op_count = op_count;
+		res->op_latency = op_latency;
+		res->req_count = req_count;
+		res->req_latency = req_latency;
+	}
+
+	if (!op_count || !req_count || !time) {
+		dev_warn(app->dev, "%s: no operations completed", __func__);
+		return;
+	}
+
 	dev_info(app->dev, "read %lld blocks of %lld bytes (stride %lld) in %lld ns (%lld ns/op, %lld req, %lld ns/req): %lld Mbps",
-			count, size, stride, time, op_latency / op_count, req_count,
-			req_latency / req_count, size * count * 8 * 1000 / time);
+			blocks, size, stride, time, op_latency / op_count, req_count,
+			req_latency / req_count, size * blocks * 8 * 1000 / time);
 }
 
 static void dma_block_write_bench(struct mqnic_app_dma_bench *app,
-		dma_addr_t dma_addr, u64 size, u64 stride, u64 count)
+		dma_addr_t dma_addr, u64 size, u64 stride, u64 count, u32 entries,
+		struct dma_bench_result *res)
 {
+	u64 blocks = count * max_t(u32, entries, 1);
 	u64 time;
 	u64 op_count;
 	u64 op_latency;
@@ -349,8 +615,11 @@ static void dma_block_write_bench(struct mqnic_app_dma_bench *app,
 	req_count = mqnic_stats_read(app->mdev, 52);
 	req_latency = mqnic_stats_read(app->mdev, 53);
 
-	dma_block_write(app, dma_addr, 0, 0x3fff, stride,
-			0, 0, 0x3fff, stride, size, count);
+	if (entries)
+		dma_block_queue(app, 0x400, dma_addr, stride, size, count, entries);
+	else
+		dma_block_write(app, dma_addr, 0, 0x3fff, stride,
+				0, 0, 0x3fff, stride, size, count);
 
 	time = mqnic_core_clk_cycles_to_ns(app->mdev, ioread32(app->dma_bench_rb->regs + 0x408));
 
@@ -361,9 +630,475 @@ static void dma_block_write_bench(struct mqnic_app_dma_bench *app,
 	req_count = mqnic_stats_read(app->mdev, 52) - req_count;
 	req_latency = mqnic_core_clk_cycles_to_ns(app->mdev, mqnic_stats_read(app->mdev, 53) - req_latency);
 
+	if (res) {
+		res->time = time;
+		res->op_count = op_count;
+		res->op_latency = op_latency;
+		res->req_count = req_count;
+		res->req_latency = req_latency;
+	}
+
+	if (!op_count || !req_count || !time) {
+		dev_warn(app->dev, "%s: no operations completed", __func__);
+		return;
+	}
+
 	dev_info(app->dev, "wrote %lld blocks of %lld bytes (stride %lld) in %lld ns (%lld ns/op, %lld req, %lld ns/req): %lld Mbps",
-			count, size, stride, time, op_latency / op_count, req_count,
-			req_latency / req_count, size * count * 8 * 1000 / time);
+			blocks, size, stride, time, op_latency / op_count, req_count,
+			req_latency / req_count, size * blocks * 8 * 1000 / time);
+}
+
+static int dma_bench_u64_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a;
+	u64 y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * The stats block only accumulates latency sums, so tails are measured by
+ * issuing single-block operations and taking the per-request latency of
+ * each one from the counter deltas.  Exact while a block fits in one request.
+ */
+static int dma_bench_collect_hist(struct mqnic_app_dma_bench *app, bool write,
+		dma_addr_t dma_addr)
+{
+	struct dma_bench_hist *hist = &app->bench_hist;
+	int cnt_index = write ? 52 : 36;
+	int lat_index = write ? 53 : 37;
+	u64 req_count, req_latency;
+	u64 *samples;
+	u32 n = 0;
+	u32 k;
+
+	memset(hist, 0, sizeof(*hist));
+
+	samples = kvmalloc_array(app->bench_samples, sizeof(*samples), GFP_KERNEL);
+	if (!samples)
+		return -ENOMEM;
+
+	for (k = 0; k < app->bench_samples; k++) {
+		req_count = mqnic_stats_read(app->mdev, cnt_index);
+		req_latency = mqnic_stats_read(app->mdev, lat_index);
+
+		if (write)
+			dma_block_write(app, dma_addr, 0, 0x3fff, app->bench_stride,
+					0, 0, 0x3fff, app->bench_stride, app->bench_size, 1);
+		else
+			dma_block_read(app, dma_addr, 0, 0x3fff, app->bench_stride,
+					0, 0, 0x3fff, app->bench_stride, app->bench_size, 1);
+
+		udelay(5);
+
+		req_count = mqnic_stats_read(app->mdev, cnt_index) - req_count;
+		req_latency = mqnic_stats_read(app->mdev, lat_index) - req_latency;
+
+		if (!req_count)
+			continue;
+
+		samples[n++] = mqnic_core_clk_cycles_to_ns(app->mdev, req_latency) / req_count;
+
+		cond_resched();
+	}
+
+	if (n) {
+		sort(samples, n, sizeof(*samples), dma_bench_u64_cmp, NULL);
+
+		hist->samples = n;
+		hist->min = samples[0];
+		hist->max = samples[n - 1];
+		hist->p50 = samples[div_u64((u64)n * 500, 1000)];
+		hist->p99 = samples[div_u64((u64)n * 990, 1000)];
+		hist->p999 = samples[div_u64((u64)n * 999, 1000)];
+
+		// bucket k holds latencies in [2^(k-1), 2^k) ns, bucket 0 holds 0
+		for (k = 0; k < n; k++)
+			hist->bucket[min_t(int, fls64(samples[k]), DMA_BENCH_HIST_BUCKETS - 1)]++;
+	}
+
+	kvfree(samples);
+
+	return 0;
+}
+
+static const char *dma_bench_mem_name(u32 mem)
+{
+	switch (mem) {
+	case DMA_BENCH_MEM_COHERENT:
+		return "coherent";
+	case DMA_BENCH_MEM_PAGES:
+		return "pages";
+	case DMA_BENCH_MEM_HUGE:
+		return "huge";
+	default:
+		return "unknown";
+	}
+}
+
+// one benchmark run; appends a line of key=value pairs to out
+static int dma_bench_run_one(struct mqnic_app_dma_bench *app, u32 bench_dir, u32 mem,
+		int node, u64 size, u64 stride, u32 inflight, bool hist, char *out, size_t out_len)
+{
+	u64 blocks = app->bench_count * max_t(u32, app->bench_entries, 1);
+	struct dma_bench_result res = {0};
+	bool write = bench_dir == DMA_BENCH_DIR_WRITE;
+	enum dma_data_direction dir = write ? MQNIC_DMA_FROM_DEVICE : MQNIC_DMA_TO_DEVICE;
+	struct iommu_domain *domain;
+	struct page *page = NULL;
+	unsigned int order = 0;
+	dma_addr_t dma_addr;
+	bool iommu;
+	int ret = 0;
+
+	// report whether DMA addresses are translated, it cannot be toggled per run
+	domain = iommu_get_domain_for_dev(app->nic_dev);
+	iommu = domain && domain->type != IOMMU_DOMAIN_IDENTITY;
+
+	if (mem == DMA_BENCH_MEM_COHERENT) {
+		dma_addr = app->dma_region_addr;
+		node = dev_to_node(app->nic_dev);
+	} else {
+		if (node != NUMA_NO_NODE && !node_online(node))
+			return -EINVAL;
+
+		order = mem == DMA_BENCH_MEM_HUGE ? DMA_BENCH_HUGE_ORDER : get_order(app->dma_region_len);
+
+		page = alloc_pages_node(node, GFP_KERNEL | __GFP_NOWARN | __GFP_COMP, order);
+		if (!page)
+			return -ENOMEM;
+
+		node = page_to_nid(page);
+
+		dma_addr = dma_map_page(app->nic_dev, page, 0, PAGE_SIZE << order, dir);
+		if (dma_mapping_error(app->nic_dev, dma_addr)) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	dma_bench_set_inflight(app, inflight);
+
+	if (write)
+		dma_block_write_bench(app, dma_addr, size, stride, app->bench_count,
+				app->bench_entries, &res);
+	else
+		dma_block_read_bench(app, dma_addr, size, stride, app->bench_count,
+				app->bench_entries, &res);
+
+	dma_bench_set_inflight(app, 0);
+
+	if (hist)
+		ret = dma_bench_collect_hist(app, write, dma_addr);
+
+	if (page)
+		dma_unmap_page(app->nic_dev, dma_addr, PAGE_SIZE << order, dir);
+
+	scnprintf(out, out_len,
+			"dir=%s mem=%s node=%d dev_node=%d iommu=%d size=%llu stride=%llu count=%llu "
+			"entries=%u inflight=%u "
+			"time_ns=%llu op_ns=%llu req_count=%llu req_ns=%llu mbps=%llu\n",
+			write ? "write" : "read", dma_bench_mem_name(mem), node,
+			dev_to_node(app->nic_dev), iommu, size, stride, app->bench_count,
+			app->bench_entries, inflight, res.time,
+			res.op_count ? res.op_latency / res.op_count : 0, res.req_count,
+			res.req_count ? res.req_latency / res.req_count : 0,
+			res.time ? size * blocks * 8 * 1000 / res.time : 0);
+
+out:
+	if (page)
+		__free_pages(page, order);
+
+	return ret;
+}
+
+static bool dma_bench_params_valid(struct mqnic_app_dma_bench *app)
+{
+	return app->bench_dir <= DMA_BENCH_DIR_WRITE && app->bench_mem <= DMA_BENCH_MEM_HUGE &&
+			app->bench_size && app->bench_size <= app->dma_region_len &&
+			app->bench_stride && app->bench_count && app->bench_count <= U32_MAX &&
+			app->bench_samples <= DMA_BENCH_MAX_SAMPLES &&
+			app->bench_entries <= app->queue_size &&
+			app->bench_inflight <= DMA_BENCH_MAX_INFLIGHT;
+}
+
+static int dma_bench_run(struct mqnic_app_dma_bench *app)
+{
+	// out-of-range node means no preference
+	int node = app->bench_node < nr_node_ids ? app->bench_node : NUMA_NO_NODE;
+
+	if (!dma_bench_params_valid(app))
+		return -EINVAL;
+
+	app->bench_result[0] = 0;
+
+	return dma_bench_run_one(app, app->bench_dir, app->bench_mem, node,
+			app->bench_size, app->bench_stride, app->bench_inflight, app->bench_samples,
+			app->bench_result, sizeof(app->bench_result));
+}
+
+/*
+ * Sweep both directions and block sizes over the coherent buffer and over
+ * streaming-mapped pages and hugepages on every online node.
+ */
+static int dma_bench_run_matrix(struct mqnic_app_dma_bench *app)
+{
+	size_t len, pos = 0;
+	u32 dir, mem;
+	u64 size;
+	int node;
+	int ret;
+
+	if (!dma_bench_params_valid(app))
+		return -EINVAL;
+
+	len = 2 * (1 + 2 * num_online_nodes()) *
+			(ilog2(app->dma_region_len / DMA_BENCH_MATRIX_MIN_SIZE) / 2 + 1) *
+			DMA_BENCH_LINE_LEN;
+
+	kvfree(app->bench_matrix);
+	app->bench_matrix = kvzalloc(len, GFP_KERNEL);
+	if (!app->bench_matrix)
+		return -ENOMEM;
+
+	for (dir = DMA_BENCH_DIR_READ; dir <= DMA_BENCH_DIR_WRITE; dir++) {
+		for (size = DMA_BENCH_MATRIX_MIN_SIZE; size <= app->dma_region_len; size *= 4) {
+			ret = dma_bench_run_one(app, dir, DMA_BENCH_MEM_COHERENT, NUMA_NO_NODE,
+					size, size, app->bench_inflight, false,
+					app->bench_matrix + pos, len - pos);
+			if (ret)
+				return ret;
+			pos += strlen(app->bench_matrix + pos);
+
+			for_each_online_node(node) {
+				for (mem = DMA_BENCH_MEM_PAGES; mem <= DMA_BENCH_MEM_HUGE; mem++) {
+					ret = dma_bench_run_one(app, dir, mem, node, size, size,
+							app->bench_inflight, false,
+							app->bench_matrix + pos, len - pos);
+					// no memory left on this node is a result, not a failure
+					if (ret == -ENOMEM) {
+						pos += scnprintf(app->bench_matrix + pos, len - pos,
+								"dir=%s mem=%s node=%d error=nomem\n",
+								dir ? "write" : "read",
+								dma_bench_mem_name(mem), node);
+						continue;
+					}
+					if (ret)
+						return ret;
+					pos += strlen(app->bench_matrix + pos);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Sweep the in-flight operation limit with the current parameters, with
+ * queued entries this shows how much aggregate throughput depends on
+ * keeping the DMA engine busy.
+ */
+static int dma_bench_run_depth(struct mqnic_app_dma_bench *app)
+{
+	int node = app->bench_node < nr_node_ids ? app->bench_node : NUMA_NO_NODE;
+	size_t len, pos = 0;
+	u32 inflight;
+	int ret;
+
+	if (!dma_bench_params_valid(app))
+		return -EINVAL;
+
+	len = (ilog2(DMA_BENCH_MAX_INFLIGHT) + 2) * DMA_BENCH_LINE_LEN;
+
+	kvfree(app->bench_depth);
+	app->bench_depth = kvzalloc(len, GFP_KERNEL);
+	if (!app->bench_depth)
+		return -ENOMEM;
+
+	// powers of two up to the limit, then unlimited
+	for (inflight = 1; ; inflight = inflight < DMA_BENCH_MAX_INFLIGHT ? inflight * 2 : 0) {
+		ret = dma_bench_run_one(app, app->bench_dir, app->bench_mem, node,
+				app->bench_size, app->bench_stride, inflight, false,
+				app->bench_depth + pos, len - pos);
+		if (ret)
+			return ret;
+		pos += strlen(app->bench_depth + pos);
+
+		if (!inflight)
+			break;
+	}
+
+	return 0;
+}
+
+static ssize_t dma_bench_run_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_app_dma_bench *app = file->private_data;
+	ssize_t ret;
+
+	mutex_lock(&app->bench_lock);
+	ret = simple_read_from_buffer(buf, count, ppos, app->bench_result,
+			strlen(app->bench_result));
+	mutex_unlock(&app->bench_lock);
+
+	return ret;
+}
+
+static ssize_t dma_bench_run_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_app_dma_bench *app = file->private_data;
+	int ret;
+
+	// any write starts a run with the current parameters
+	mutex_lock(&app->bench_lock);
+	ret = dma_bench_run(app);
+	mutex_unlock(&app->bench_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations dma_bench_run_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = dma_bench_run_read,
+	.write = dma_bench_run_write,
+	.llseek = default_llseek,
+};
+
+static ssize_t dma_bench_matrix_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_app_dma_bench *app = file->private_data;
+	ssize_t ret = 0;
+
+	mutex_lock(&app->bench_lock);
+	if (app->bench_matrix)
+		ret = simple_read_from_buffer(buf, count, ppos, app->bench_matrix,
+				strlen(app->bench_matrix));
+	mutex_unlock(&app->bench_lock);
+
+	return ret;
+}
+
+static ssize_t dma_bench_matrix_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_app_dma_bench *app = file->private_data;
+	int ret;
+
+	mutex_lock(&app->bench_lock);
+	ret = dma_bench_run_matrix(app);
+	mutex_unlock(&app->bench_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations dma_bench_matrix_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = dma_bench_matrix_read,
+	.write = dma_bench_matrix_write,
+	.llseek = default_llseek,
+};
+
+static ssize_t dma_bench_depth_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_app_dma_bench *app = file->private_data;
+	ssize_t ret = 0;
+
+	mutex_lock(&app->bench_lock);
+	if (app->bench_depth)
+		ret = simple_read_from_buffer(buf, count, ppos, app->bench_depth,
+				strlen(app->bench_depth));
+	mutex_unlock(&app->bench_lock);
+
+	return ret;
+}
+
+static ssize_t dma_bench_depth_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_app_dma_bench *app = file->private_data;
+	int ret;
+
+	mutex_lock(&app->bench_lock);
+	ret = dma_bench_run_depth(app);
+	mutex_unlock(&app->bench_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations dma_bench_depth_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = dma_bench_depth_read,
+	.write = dma_bench_depth_write,
+	.llseek = default_llseek,
+};
+
+static int dma_bench_hist_show(struct seq_file *m, void *v)
+{
+	struct mqnic_app_dma_bench *app = m->private;
+	struct dma_bench_hist *hist = &app->bench_hist;
+	int k;
+
+	mutex_lock(&app->bench_lock);
+
+	seq_printf(m, "samples=%llu min_ns=%llu max_ns=%llu p50_ns=%llu p99_ns=%llu p999_ns=%llu\n",
+			hist->samples, hist->min, hist->max, hist->p50, hist->p99, hist->p999);
+
+	for (k = 0; k < DMA_BENCH_HIST_BUCKETS; k++) {
+		if (hist->bucket[k])
+			seq_printf(m, "bucket_ns=%llu count=%llu\n",
+					k ? 1ull << (k - 1) : 0, hist->bucket[k]);
+	}
+
+	mutex_unlock(&app->bench_lock);
+
+	return 0;
+}
+
+static int dma_bench_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dma_bench_hist_show, inode->i_private);
+}
+
+static const struct file_operations dma_bench_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = dma_bench_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void dma_bench_debugfs_init(struct mqnic_app_dma_bench *app)
+{
+	app->bench_dir = DMA_BENCH_DIR_READ;
+	app->bench_mem = DMA_BENCH_MEM_COHERENT;
+	app->bench_node = U32_MAX;
+	app->bench_size = 256;
+	app->bench_stride = 256;
+	app->bench_count = 10000;
+
+	app->debugfs_dir = debugfs_create_dir(dev_name(app->dev), dma_bench_debugfs_root);
+
+	debugfs_create_u32("dir", 0600, app->debugfs_dir, &app->bench_dir);
+	debugfs_create_u32("mem", 0600, app->debugfs_dir, &app->bench_mem);
+	debugfs_create_u32("node", 0600, app->debugfs_dir, &app->bench_node);
+	debugfs_create_u64("size", 0600, app->debugfs_dir, &app->bench_size);
+	debugfs_create_u64("stride", 0600, app->debugfs_dir, &app->bench_stride);
+	debugfs_create_u64("count", 0600, app->debugfs_dir, &app->bench_count);
+	debugfs_create_u32("samples", 0600, app->debugfs_dir, &app->bench_samples);
+	debugfs_create_u32("entries", 0600, app->debugfs_dir, &app->bench_entries);
+	debugfs_create_u32("inflight", 0600, app->debugfs_dir, &app->bench_inflight);
+	debugfs_create_file("run", 0600, app->debugfs_dir, app, &dma_bench_run_fops);
+	debugfs_create_file("hist", 0400, app->debugfs_dir, app, &dma_bench_hist_fops);
+	debugfs_create_file("matrix", 0600, app->debugfs_dir, app, &dma_bench_matrix_fops);
+	debugfs_create_file("depth", 0600, app->debugfs_dir, app, &dma_bench_depth_fops);
 }
 
 static void mqnic_app_dma_bench_remove(struct auxiliary_device *adev);
@@ -394,6 +1129,7 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 
 	app->dev = dev;
 	app->mdev = mdev;
+	app->irq_index = -1;
 	dev_set_drvdata(&adev->dev, app);
 
 	app->nic_dev = mdev->dev;
@@ -420,6 +1156,23 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 		goto fail_rb_init;
 	}
 
+	// older bitstreams have no submission queue and read back zero
+	app->queue_size = (ioread32(app->dma_bench_rb->regs + 0x34c) >> 8) & 0xff;
+	if (app->queue_size)
+		dev_info(dev, "DMA block submission queue: %d entries", app->queue_size);
+
+	init_waitqueue_head(&app->irq_wait);
+
+	if (irq_index >= 0) {
+		app->irq_nb.notifier_call = dma_bench_irq;
+		ret = mqnic_irq_register_notifier(mdev, irq_index, &app->irq_nb);
+		if (ret) {
+			dev_err(dev, "Failed to attach to IRQ %d", irq_index);
+			goto fail_irq;
+		}
+		app->irq_index = irq_index;
+	}
+
 	// Allocate DMA buffer
 	app->dma_region_len = 16 * 1024;
 	app->dma_region = dma_alloc_coherent(app->nic_dev, app->dma_region_len,
@@ -432,6 +1185,8 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 	dev_info(dev, "Allocated DMA region virt %p, phys %p",
 			app->dma_region, (void *)app->dma_region_addr);
 
+	dma_bench_cpl_ring_enable(app);
+
 	// Dump counters
 	dev_info(dev, "Statistics counters");
 	print_counters(app);
@@ -464,7 +1219,7 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 		mismatch = 1;
 	}
 
-	if (!mismatch) {
+	if (!mismatch && probe_sweep) {
 		u64 size;
 		u64 stride;
 		struct page *page;
@@ -475,7 +1230,7 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 		for (size = 1; size <= 8192; size *= 2) {
 			for (stride = size; stride <= max(size, 256llu); stride *= 2) {
 				dma_block_read_bench(app, app->dma_region_addr + 0x0000,
-						size, stride, 10000);
+						size, stride, 10000, 0, NULL);
 			}
 		}
 
@@ -484,7 +1239,7 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 		for (size = 1; size <= 8192; size *= 2) {
 			for (stride = size; stride <= max(size, 256llu); stride *= 2) {
 				dma_block_write_bench(app, app->dma_region_addr + 0x0000,
-						size, stride, 10000);
+						size, stride, 10000, 0, NULL);
 			}
 		}
 
@@ -500,7 +1255,7 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 				for (size = 1; size <= 8192; size *= 2) {
 					for (stride = size; stride <= max(size, 256llu); stride *= 2) {
 						dma_block_read_bench(app, dma_addr + 0x0000,
-								size, stride, 10000);
+								size, stride, 10000, 0, NULL);
 					}
 				}
 
@@ -517,7 +1272,7 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 				for (size = 1; size <= 8192; size *= 2) {
 					for (stride = size; stride <= max(size, 256llu); stride *= 2) {
 						dma_block_write_bench(app, dma_addr + 0x0000,
-								size, stride, 10000);
+								size, stride, 10000, 0, NULL);
 					}
 				}
 
@@ -539,7 +1294,7 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 
 	// DRAM test
 	rb_index = 0;
-	while ((rb = mqnic_find_reg_block(app->rb_list, 0x12348102, 0x00000100, rb_index))) {
+	while (probe_sweep && (rb = mqnic_find_reg_block(app->rb_list, 0x12348102, 0x00000100, rb_index))) {
 		u32 data_width;
 		u32 lane_count;
 		u64 size;
@@ -672,9 +1427,13 @@ static int mqnic_app_dma_bench_probe(struct auxiliary_device *adev,
 		rb_index++;
 	}
 
+	mutex_init(&app->bench_lock);
+	dma_bench_debugfs_init(app);
+
 	return 0;
 
 fail_dma_alloc:
+fail_irq:
 fail_rb_init:
 	mqnic_app_dma_bench_remove(adev);
 	return ret;
@@ -687,10 +1446,23 @@ static void mqnic_app_dma_bench_remove(struct auxiliary_device *adev)
 
 	dev_info(dev, "%s() called", __func__);
 
+	if (app->debugfs_dir) {
+		debugfs_remove_recursive(app->debugfs_dir);
+		app->debugfs_dir = NULL;
+		mutex_destroy(&app->bench_lock);
+		kvfree(app->bench_matrix);
+		kvfree(app->bench_depth);
+	}
+
+	dma_bench_cpl_ring_disable(app);
+
 	if (app->dma_region)
 		dma_free_coherent(app->nic_dev, app->dma_region_len, app->dma_region,
 				app->dma_region_addr);
 
+	if (app->irq_index >= 0)
+		mqnic_irq_unregister_notifier(app->mdev, app->irq_index, &app->irq_nb);
+
 	if (app->rb_list)
 		mqnic_free_reg_block_list(app->rb_list);
 }
@@ -711,12 +1483,21 @@ static struct auxiliary_driver mqnic_app_dma_bench_driver = {
 
 static int __init mqnic_app_dma_bench_init(void)
 {
-	return auxiliary_driver_register(&mqnic_app_dma_bench_driver);
+	int ret;
+
+	dma_bench_debugfs_root = debugfs_create_dir("mqnic_app_dma_bench", NULL);
+
+	ret = auxiliary_driver_register(&mqnic_app_dma_bench_driver);
+	if (ret)
+		debugfs_remove_recursive(dma_bench_debugfs_root);
+
+	return ret;
 }
 
 static void __exit mqnic_app_dma_bench_exit(void)
 {
 	auxiliary_driver_unregister(&mqnic_app_dma_bench_driver);
+	debugfs_remove_recursive(dma_bench_debugfs_root);
 }
 
 module_init(mqnic_app_dma_bench_init);
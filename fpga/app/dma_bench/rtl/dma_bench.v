@@ -116,6 +116,9 @@ localparam RAM_ADDR_IMM_WIDTH = (DMA_IMM_ENABLE && (DMA_IMM_WIDTH > RAM_ADDR_WID
 
 localparam RBB = RB_BASE_ADDR & {REG_ADDR_WIDTH{1'b1}};
 
+// block operation submission queue depth, per direction
+localparam QUEUE_LOG_SIZE = 4;
+
 // check configuration
 initial begin
     if (REG_DATA_WIDTH != 32) begin
@@ -198,6 +201,57 @@ reg [RAM_ADDR_WIDTH-1:0] dma_write_block_ram_offset_reg = 0, dma_write_block_ram
 reg [RAM_ADDR_WIDTH-1:0] dma_write_block_ram_offset_mask_reg = 0, dma_write_block_ram_offset_mask_next;
 reg [RAM_ADDR_WIDTH-1:0] dma_write_block_ram_stride_reg = 0, dma_write_block_ram_stride_next;
 
+// block completion ring in host memory, one 32 bit record per finished run:
+// [31] phase, [30] 0 = block read, 1 = block write, [29:0] run cycle count
+reg [DMA_ADDR_WIDTH-1:0] cpl_ring_base_addr_reg = 0, cpl_ring_base_addr_next;
+reg [3:0] cpl_ring_log_size_reg = 0, cpl_ring_log_size_next;
+reg cpl_ring_enable_reg = 1'b0, cpl_ring_enable_next;
+reg [15:0] cpl_ring_head_ptr_reg = 0, cpl_ring_head_ptr_next;
+reg dma_read_block_cpl_pending_reg = 1'b0, dma_read_block_cpl_pending_next;
+reg dma_write_block_cpl_pending_reg = 1'b0, dma_write_block_cpl_pending_next;
+reg [31:0] cpl_ring_record;
+reg cpl_ring_write_issue;
+
+// read block submission queue, entries run back to back on one start;
+// an entry sets block length, DMA and RAM stride, and block count
+reg [DMA_LEN_WIDTH-1:0] dma_read_queue_len_mem[(2**QUEUE_LOG_SIZE)-1:0];
+reg [31:0] dma_read_queue_stride_mem[(2**QUEUE_LOG_SIZE)-1:0];
+reg [31:0] dma_read_queue_count_mem[(2**QUEUE_LOG_SIZE)-1:0];
+reg [QUEUE_LOG_SIZE:0] dma_read_queue_wr_ptr_reg = 0, dma_read_queue_wr_ptr_next;
+reg [QUEUE_LOG_SIZE:0] dma_read_queue_rd_ptr_reg = 0, dma_read_queue_rd_ptr_next;
+reg [DMA_LEN_WIDTH-1:0] dma_read_queue_len_reg = 0, dma_read_queue_len_next;
+reg [31:0] dma_read_queue_stride_reg = 0, dma_read_queue_stride_next;
+reg [31:0] dma_read_queue_count_reg = 0, dma_read_queue_count_next;
+reg dma_read_queue_push;
+
+// cap on read operations in flight, 0 for no limit beyond the DMA engine
+reg [15:0] dma_read_block_max_inflight_reg = 0, dma_read_block_max_inflight_next;
+
+wire dma_read_queue_empty = dma_read_queue_wr_ptr_reg == dma_read_queue_rd_ptr_reg;
+wire dma_read_queue_full = dma_read_queue_wr_ptr_reg == (dma_read_queue_rd_ptr_reg ^ {1'b1, {QUEUE_LOG_SIZE{1'b0}}});
+wire dma_read_block_inflight_ok = dma_read_block_max_inflight_reg == 0 ||
+    dma_read_active_count_reg + dma_read_desc_valid_reg < dma_read_block_max_inflight_reg;
+
+// write block submission queue, entries run back to back on one start;
+// an entry sets block length, DMA and RAM stride, and block count
+reg [DMA_LEN_WIDTH-1:0] dma_write_queue_len_mem[(2**QUEUE_LOG_SIZE)-1:0];
+reg [31:0] dma_write_queue_stride_mem[(2**QUEUE_LOG_SIZE)-1:0];
+reg [31:0] dma_write_queue_count_mem[(2**QUEUE_LOG_SIZE)-1:0];
+reg [QUEUE_LOG_SIZE:0] dma_write_queue_wr_ptr_reg = 0, dma_write_queue_wr_ptr_next;
+reg [QUEUE_LOG_SIZE:0] dma_write_queue_rd_ptr_reg = 0, dma_write_queue_rd_ptr_next;
+reg [DMA_LEN_WIDTH-1:0] dma_write_queue_len_reg = 0, dma_write_queue_len_next;
+reg [31:0] dma_write_queue_stride_reg = 0, dma_write_queue_stride_next;
+reg [31:0] dma_write_queue_count_reg = 0, dma_write_queue_count_next;
+reg dma_write_queue_push;
+
+// cap on write operations in flight, 0 for no limit beyond the DMA engine
+reg [15:0] dma_write_block_max_inflight_reg = 0, dma_write_block_max_inflight_next;
+
+wire dma_write_queue_empty = dma_write_queue_wr_ptr_reg == dma_write_queue_rd_ptr_reg;
+wire dma_write_queue_full = dma_write_queue_wr_ptr_reg == (dma_write_queue_rd_ptr_reg ^ {1'b1, {QUEUE_LOG_SIZE{1'b0}}});
+wire dma_write_block_inflight_ok = dma_write_block_max_inflight_reg == 0 ||
+    dma_write_active_count_reg + dma_write_desc_valid_reg < dma_write_block_max_inflight_reg;
+
 assign reg_wr_wait = 1'b0;
 assign reg_wr_ack = reg_wr_ack_reg;
 assign reg_rd_data = reg_rd_data_reg;
@@ -275,6 +329,31 @@ always @* begin
     dma_write_block_ram_offset_mask_next = dma_write_block_ram_offset_mask_reg;
     dma_write_block_ram_stride_next = dma_write_block_ram_stride_reg;
 
+    cpl_ring_base_addr_next = cpl_ring_base_addr_reg;
+    cpl_ring_log_size_next = cpl_ring_log_size_reg;
+    cpl_ring_enable_next = cpl_ring_enable_reg;
+    cpl_ring_head_ptr_next = cpl_ring_head_ptr_reg;
+    dma_read_block_cpl_pending_next = dma_read_block_cpl_pending_reg;
+    dma_write_block_cpl_pending_next = dma_write_block_cpl_pending_reg;
+    cpl_ring_record = 0;
+    cpl_ring_write_issue = 1'b0;
+
+    dma_read_queue_wr_ptr_next = dma_read_queue_wr_ptr_reg;
+    dma_read_queue_rd_ptr_next = dma_read_queue_rd_ptr_reg;
+    dma_read_queue_len_next = dma_read_queue_len_reg;
+    dma_read_queue_stride_next = dma_read_queue_stride_reg;
+    dma_read_queue_count_next = dma_read_queue_count_reg;
+    dma_read_queue_push = 1'b0;
+    dma_read_block_max_inflight_next = dma_read_block_max_inflight_reg;
+
+    dma_write_queue_wr_ptr_next = dma_write_queue_wr_ptr_reg;
+    dma_write_queue_rd_ptr_next = dma_write_queue_rd_ptr_reg;
+    dma_write_queue_len_next = dma_write_queue_len_reg;
+    dma_write_queue_stride_next = dma_write_queue_stride_reg;
+    dma_write_queue_count_next = dma_write_queue_count_reg;
+    dma_write_queue_push = 1'b0;
+    dma_write_block_max_inflight_next = dma_write_block_max_inflight_reg;
+
     if (reg_wr_en && !reg_wr_ack_reg) begin
         // write operation
         reg_wr_ack_next = 1'b1;
@@ -284,6 +363,15 @@ always @* begin
                 dma_rd_int_en_next = reg_wr_data[0];
                 dma_wr_int_en_next = reg_wr_data[1];
             end
+            // block completion ring
+            RBB+12'h080: cpl_ring_base_addr_next[31:0] = reg_wr_data;
+            RBB+12'h084: cpl_ring_base_addr_next[63:32] = reg_wr_data;
+            RBB+12'h088: begin
+                // records are immediate writes, so the ring needs DMA_IMM_ENABLE
+                cpl_ring_log_size_next = reg_wr_data[3:0];
+                cpl_ring_enable_next = DMA_IMM_ENABLE && reg_wr_data[31];
+                cpl_ring_head_ptr_next = 0;
+            end
             // single read
             RBB+12'h100: dma_read_desc_dma_addr_next[31:0] = reg_wr_data;
             RBB+12'h104: dma_read_desc_dma_addr_next[63:32] = reg_wr_data;
@@ -311,6 +399,19 @@ always @* begin
             RBB+12'h30c: dma_read_block_cycle_count_next[63:32] = reg_wr_data;
             RBB+12'h310: dma_read_block_len_next = reg_wr_data;
             RBB+12'h318: dma_read_block_count_next[31:0] = reg_wr_data;
+            RBB+12'h320: dma_read_block_max_inflight_next = reg_wr_data;
+            RBB+12'h340: dma_read_queue_len_next = reg_wr_data;
+            RBB+12'h344: dma_read_queue_stride_next = reg_wr_data;
+            RBB+12'h348: dma_read_queue_count_next = reg_wr_data;
+            RBB+12'h34c: begin
+                if (reg_wr_data[31]) begin
+                    // flush
+                    dma_read_queue_wr_ptr_next = dma_read_queue_rd_ptr_reg;
+                end else if (!dma_read_queue_full) begin
+                    dma_read_queue_push = 1'b1;
+                    dma_read_queue_wr_ptr_next = dma_read_queue_wr_ptr_reg + 1;
+                end
+            end
             RBB+12'h380: dma_read_block_dma_base_addr_next[31:0] = reg_wr_data;
             RBB+12'h384: dma_read_block_dma_base_addr_next[63:32] = reg_wr_data;
             RBB+12'h388: dma_read_block_dma_offset_next[31:0] = reg_wr_data;
@@ -331,6 +432,19 @@ always @* begin
             RBB+12'h40c: dma_write_block_cycle_count_next[63:32] = reg_wr_data;
             RBB+12'h410: dma_write_block_len_next = reg_wr_data;
             RBB+12'h418: dma_write_block_count_next[31:0] = reg_wr_data;
+            RBB+12'h420: dma_write_block_max_inflight_next = reg_wr_data;
+            RBB+12'h440: dma_write_queue_len_next = reg_wr_data;
+            RBB+12'h444: dma_write_queue_stride_next = reg_wr_data;
+            RBB+12'h448: dma_write_queue_count_next = reg_wr_data;
+            RBB+12'h44c: begin
+                if (reg_wr_data[31]) begin
+                    // flush
+                    dma_write_queue_wr_ptr_next = dma_write_queue_rd_ptr_reg;
+                end else if (!dma_write_queue_full) begin
+                    dma_write_queue_push = 1'b1;
+                    dma_write_queue_wr_ptr_next = dma_write_queue_wr_ptr_reg + 1;
+                end
+            end
             RBB+12'h480: dma_write_block_dma_base_addr_next[31:0] = reg_wr_data;
             RBB+12'h484: dma_write_block_dma_base_addr_next[63:32] = reg_wr_data;
             RBB+12'h488: dma_write_block_dma_offset_next[31:0] = reg_wr_data;
@@ -363,6 +477,14 @@ always @* begin
             RBB+12'h014: reg_rd_data_next = cycle_count_reg >> 32;
             RBB+12'h020: reg_rd_data_next = dma_read_active_count_reg;
             RBB+12'h028: reg_rd_data_next = dma_write_active_count_reg;
+            // block completion ring
+            RBB+12'h080: reg_rd_data_next = cpl_ring_base_addr_reg;
+            RBB+12'h084: reg_rd_data_next = cpl_ring_base_addr_reg >> 32;
+            RBB+12'h088: begin
+                reg_rd_data_next[3:0] = cpl_ring_log_size_reg;
+                reg_rd_data_next[31] = cpl_ring_enable_reg;
+            end
+            RBB+12'h08c: reg_rd_data_next = cpl_ring_head_ptr_reg;
             // single read
             RBB+12'h100: reg_rd_data_next = dma_read_desc_dma_addr_reg;
             RBB+12'h104: reg_rd_data_next = dma_read_desc_dma_addr_reg >> 32;
@@ -401,6 +523,14 @@ always @* begin
             RBB+12'h310: reg_rd_data_next = dma_read_block_len_reg;
             RBB+12'h318: reg_rd_data_next = dma_read_block_count_reg;
             RBB+12'h31c: reg_rd_data_next = dma_read_block_count_reg >> 32;
+            RBB+12'h320: reg_rd_data_next = dma_read_block_max_inflight_reg;
+            RBB+12'h340: reg_rd_data_next = dma_read_queue_len_reg;
+            RBB+12'h344: reg_rd_data_next = dma_read_queue_stride_reg;
+            RBB+12'h348: reg_rd_data_next = dma_read_queue_count_reg;
+            RBB+12'h34c: begin
+                reg_rd_data_next[7:0] = dma_read_queue_wr_ptr_reg - dma_read_queue_rd_ptr_reg;
+                reg_rd_data_next[15:8] = 2**QUEUE_LOG_SIZE;
+            end
             RBB+12'h380: reg_rd_data_next = dma_read_block_dma_base_addr_reg;
             RBB+12'h384: reg_rd_data_next = dma_read_block_dma_base_addr_reg >> 32;
             RBB+12'h388: reg_rd_data_next = dma_read_block_dma_offset_reg;
@@ -426,6 +556,14 @@ always @* begin
             RBB+12'h410: reg_rd_data_next = dma_write_block_len_reg;
             RBB+12'h418: reg_rd_data_next = dma_write_block_count_reg;
             RBB+12'h41c: reg_rd_data_next = dma_write_block_count_reg >> 32;
+            RBB+12'h420: reg_rd_data_next = dma_write_block_max_inflight_reg;
+            RBB+12'h440: reg_rd_data_next = dma_write_queue_len_reg;
+            RBB+12'h444: reg_rd_data_next = dma_write_queue_stride_reg;
+            RBB+12'h448: reg_rd_data_next = dma_write_queue_count_reg;
+            RBB+12'h44c: begin
+                reg_rd_data_next[7:0] = dma_write_queue_wr_ptr_reg - dma_write_queue_rd_ptr_reg;
+                reg_rd_data_next[15:8] = 2**QUEUE_LOG_SIZE;
+            end
             RBB+12'h480: reg_rd_data_next = dma_write_block_dma_base_addr_reg;
             RBB+12'h484: reg_rd_data_next = dma_write_block_dma_base_addr_reg >> 32;
             RBB+12'h488: reg_rd_data_next = dma_write_block_dma_offset_reg;
@@ -465,11 +603,19 @@ always @* begin
         dma_read_block_cycle_count_next = dma_read_block_cycle_count_reg + 1;
 
         if (dma_read_block_count_reg == 0) begin
-            if (dma_read_active_count_reg == 0) begin
+            if (!dma_read_queue_empty) begin
+                // next queued entry, offsets carry on from the previous one
+                dma_read_block_len_next = dma_read_queue_len_mem[dma_read_queue_rd_ptr_reg[QUEUE_LOG_SIZE-1:0]];
+                dma_read_block_dma_stride_next = dma_read_queue_stride_mem[dma_read_queue_rd_ptr_reg[QUEUE_LOG_SIZE-1:0]];
+                dma_read_block_ram_stride_next = dma_read_queue_stride_mem[dma_read_queue_rd_ptr_reg[QUEUE_LOG_SIZE-1:0]];
+                dma_read_block_count_next = dma_read_queue_count_mem[dma_read_queue_rd_ptr_reg[QUEUE_LOG_SIZE-1:0]];
+                dma_read_queue_rd_ptr_next = dma_read_queue_rd_ptr_reg + 1;
+            end else if (dma_read_active_count_reg == 0) begin
                 dma_read_block_run_next = 1'b0;
+                dma_read_block_cpl_pending_next = cpl_ring_enable_reg;
             end
         end else begin
-            if (!dma_read_desc_valid_reg || m_axis_dma_read_desc_ready) begin
+            if ((!dma_read_desc_valid_reg || m_axis_dma_read_desc_ready) && dma_read_block_inflight_ok) begin
                 dma_read_block_dma_offset_next = dma_read_block_dma_offset_reg + dma_read_block_dma_stride_reg;
                 dma_read_desc_dma_addr_next = dma_read_block_dma_base_addr_reg + (dma_read_block_dma_offset_reg & dma_read_block_dma_offset_mask_reg);
                 dma_read_block_ram_offset_next = dma_read_block_ram_offset_reg + dma_read_block_ram_stride_reg;
@@ -482,16 +628,46 @@ always @* begin
         end
     end
 
+    // block completion record, takes the write descriptor ahead of block writes
+    if ((dma_read_block_cpl_pending_reg || dma_write_block_cpl_pending_reg) && (!dma_write_desc_valid_reg || m_axis_dma_write_desc_ready)) begin
+        cpl_ring_write_issue = 1'b1;
+        cpl_ring_record[31] = !(cpl_ring_head_ptr_reg & (16'd1 << cpl_ring_log_size_reg));
+        if (dma_read_block_cpl_pending_reg) begin
+            cpl_ring_record[30] = 1'b0;
+            cpl_ring_record[29:0] = dma_read_block_cycle_count_reg;
+            dma_read_block_cpl_pending_next = 1'b0;
+        end else begin
+            cpl_ring_record[30] = 1'b1;
+            cpl_ring_record[29:0] = dma_write_block_cycle_count_reg;
+            dma_write_block_cpl_pending_next = 1'b0;
+        end
+        dma_write_desc_dma_addr_next = cpl_ring_base_addr_reg + ((cpl_ring_head_ptr_reg & ((16'd1 << cpl_ring_log_size_reg) - 1)) << 2);
+        dma_write_desc_ram_addr_imm_next = cpl_ring_record;
+        dma_write_desc_imm_en_next = 1'b1;
+        dma_write_desc_len_next = 4;
+        dma_write_desc_tag_next = 0;
+        dma_write_desc_valid_next = 1'b1;
+        cpl_ring_head_ptr_next = cpl_ring_head_ptr_reg + 1;
+    end
+
     // block write
     if (dma_write_block_run_reg) begin
         dma_write_block_cycle_count_next = dma_write_block_cycle_count_reg + 1;
 
         if (dma_write_block_count_reg == 0) begin
-            if (dma_write_active_count_reg == 0) begin
+            if (!dma_write_queue_empty) begin
+                // next queued entry, offsets carry on from the previous one
+                dma_write_block_len_next = dma_write_queue_len_mem[dma_write_queue_rd_ptr_reg[QUEUE_LOG_SIZE-1:0]];
+                dma_write_block_dma_stride_next = dma_write_queue_stride_mem[dma_write_queue_rd_ptr_reg[QUEUE_LOG_SIZE-1:0]];
+                dma_write_block_ram_stride_next = dma_write_queue_stride_mem[dma_write_queue_rd_ptr_reg[QUEUE_LOG_SIZE-1:0]];
+                dma_write_block_count_next = dma_write_queue_count_mem[dma_write_queue_rd_ptr_reg[QUEUE_LOG_SIZE-1:0]];
+                dma_write_queue_rd_ptr_next = dma_write_queue_rd_ptr_reg + 1;
+            end else if (dma_write_active_count_reg == 0) begin
                 dma_write_block_run_next = 1'b0;
+                dma_write_block_cpl_pending_next = cpl_ring_enable_reg;
             end
         end else begin
-            if (!dma_write_desc_valid_reg || m_axis_dma_write_desc_ready) begin
+            if (!cpl_ring_write_issue && (!dma_write_desc_valid_reg || m_axis_dma_write_desc_ready) && dma_write_block_inflight_ok) begin
                 dma_write_block_dma_offset_next = dma_write_block_dma_offset_reg + dma_write_block_dma_stride_reg;
                 dma_write_desc_dma_addr_next = dma_write_block_dma_base_addr_reg + (dma_write_block_dma_offset_reg & dma_write_block_dma_offset_mask_reg);
                 dma_write_block_ram_offset_next = dma_write_block_ram_offset_reg + dma_write_block_ram_stride_reg;
@@ -570,6 +746,39 @@ always @(posedge clk) begin
     dma_write_block_ram_offset_mask_reg <= dma_write_block_ram_offset_mask_next;
     dma_write_block_ram_stride_reg <= dma_write_block_ram_stride_next;
 
+    cpl_ring_base_addr_reg <= cpl_ring_base_addr_next;
+    cpl_ring_log_size_reg <= cpl_ring_log_size_next;
+    cpl_ring_enable_reg <= cpl_ring_enable_next;
+    cpl_ring_head_ptr_reg <= cpl_ring_head_ptr_next;
+    dma_read_block_cpl_pending_reg <= dma_read_block_cpl_pending_next;
+    dma_write_block_cpl_pending_reg <= dma_write_block_cpl_pending_next;
+
+    dma_read_queue_wr_ptr_reg <= dma_read_queue_wr_ptr_next;
+    dma_read_queue_rd_ptr_reg <= dma_read_queue_rd_ptr_next;
+    dma_read_queue_len_reg <= dma_read_queue_len_next;
+    dma_read_queue_stride_reg <= dma_read_queue_stride_next;
+    dma_read_queue_count_reg <= dma_read_queue_count_next;
+    dma_read_block_max_inflight_reg <= dma_read_block_max_inflight_next;
+
+    if (dma_read_queue_push) begin
+        dma_read_queue_len_mem[dma_read_queue_wr_ptr_reg[QUEUE_LOG_SIZE-1:0]] <= dma_read_queue_len_reg;
+        dma_read_queue_stride_mem[dma_read_queue_wr_ptr_reg[QUEUE_LOG_SIZE-1:0]] <= dma_read_queue_stride_reg;
+        dma_read_queue_count_mem[dma_read_queue_wr_ptr_reg[QUEUE_LOG_SIZE-1:0]] <= dma_read_queue_count_reg;
+    end
+
+    dma_write_queue_wr_ptr_reg <= dma_write_queue_wr_ptr_next;
+    dma_write_queue_rd_ptr_reg <= dma_write_queue_rd_ptr_next;
+    dma_write_queue_len_reg <= dma_write_queue_len_next;
+    dma_write_queue_stride_reg <= dma_write_queue_stride_next;
+    dma_write_queue_count_reg <= dma_write_queue_count_next;
+    dma_write_block_max_inflight_reg <= dma_write_block_max_inflight_next;
+
+    if (dma_write_queue_push) begin
+        dma_write_queue_len_mem[dma_write_queue_wr_ptr_reg[QUEUE_LOG_SIZE-1:0]] <= dma_write_queue_len_reg;
+        dma_write_queue_stride_mem[dma_write_queue_wr_ptr_reg[QUEUE_LOG_SIZE-1:0]] <= dma_write_queue_stride_reg;
+        dma_write_queue_count_mem[dma_write_queue_wr_ptr_reg[QUEUE_LOG_SIZE-1:0]] <= dma_write_queue_count_reg;
+    end
+
     if (rst) begin
         reg_wr_ack_reg <= 1'b0;
         reg_rd_ack_reg <= 1'b0;
@@ -586,6 +795,16 @@ always @(posedge clk) begin
         dma_wr_int_en_reg <= 1'b0;
         dma_read_block_run_reg <= 1'b0;
         dma_write_block_run_reg <= 1'b0;
+        cpl_ring_enable_reg <= 1'b0;
+        cpl_ring_head_ptr_reg <= 0;
+        dma_read_block_cpl_pending_reg <= 1'b0;
+        dma_write_block_cpl_pending_reg <= 1'b0;
+        dma_read_queue_wr_ptr_reg <= 0;
+        dma_read_queue_rd_ptr_reg <= 0;
+        dma_read_block_max_inflight_reg <= 0;
+        dma_write_queue_wr_ptr_reg <= 0;
+        dma_write_queue_rd_ptr_reg <= 0;
+        dma_write_block_max_inflight_reg <= 0;
     end
 end
 
@@ -878,6 +878,56 @@ async def run_test_nic(dut):
 
     assert mem[src_offset:src_offset+region_len] == mem[dest_offset:dest_offset+region_len]
 
+    tb.log.info("Test queued DMA block operations")
+
+    dest_offset = 0x8000
+
+    val = await dma_bench_rb.read_dword(0x34c)
+    assert val == 0x1000
+
+    for base in [0x300, 0x400]:
+        if base == 0x400:
+            # DMA base address
+            await dma_bench_rb.write_dword(0x480, (mem_base+dest_offset) & 0xffffffff)
+            await dma_bench_rb.write_dword(0x484, (mem_base+dest_offset >> 32) & 0xffffffff)
+
+        # reset offsets
+        await dma_bench_rb.write_dword(base+0x088, 0)
+        await dma_bench_rb.write_dword(base+0x0c8, 0)
+        # at most two operations in flight
+        await dma_bench_rb.write_dword(base+0x020, 2)
+
+        # two entries covering the region, different block sizes
+        for size, count in [(128, region_len//2//128), (512, region_len//2//512)]:
+            await dma_bench_rb.write_dword(base+0x040, size)
+            await dma_bench_rb.write_dword(base+0x044, size)
+            await dma_bench_rb.write_dword(base+0x048, count)
+            await dma_bench_rb.write_dword(base+0x04c, 0)
+
+        val = await dma_bench_rb.read_dword(base+0x04c)
+        assert val & 0xff == 2
+
+        # start with no block of its own, runs the queue
+        await dma_bench_rb.write_dword(base+0x018, 0)
+        await dma_bench_rb.write_dword(base+0x000, 1)
+
+        for k in range(20):
+            await Timer(1000, 'ns')
+            run = await dma_bench_rb.read_dword(base+0x000)
+            if run == 0:
+                break
+
+        assert run == 0
+
+        val = await dma_bench_rb.read_dword(base+0x04c)
+        assert val & 0xff == 0
+
+        await dma_bench_rb.write_dword(base+0x020, 0)
+
+    tb.log.info("%s", mem.hexdump_str(dest_offset, region_len))
+
+    assert mem[src_offset:src_offset+region_len] == mem[dest_offset:dest_offset+region_len]
+
     tb.log.info("Test DRAM channels")
 
     index = 0
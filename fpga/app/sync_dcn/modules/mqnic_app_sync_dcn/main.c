@@ -0,0 +1,614 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+#include "mqnic_app_sync_dcn_ioctl.h"
+
+#include <linux/module.h>
+#include <linux/eventfd.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+
+MODULE_DESCRIPTION("mqnic Sync-DCN application driver");
+MODULE_AUTHOR("Alex Forencich");
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_VERSION("0.1");
+
+/*
+ * Owns the Sync-DCN subsystem in the application region and exposes it as
+ * /dev/<mqnic>_sync_dcn.  Bank images are loaded with one ioctl, and bank
+ * switches are armed against the PHC.  The app block has no interrupt, so
+ * an hrtimer is set for the activation time translated onto CLOCK_MONOTONIC
+ * and confirms the switch in EXEC_STATUS; the outcome is queued as an event
+ * for read()/poll() and signalled on an optional eventfd.
+ */
+
+// subsystem registers, see rtl/sync_dcn_subsystem.v
+#define SYNC_DCN_REG_CTRL               0x0008
+#define SYNC_DCN_REG_EXEC_STATUS        0x0014
+#define SYNC_DCN_REG_ACTIVATE_TIME_LO   0x001C
+#define SYNC_DCN_REG_ACTIVATE_TIME_HI   0x0020
+#define SYNC_DCN_REG_ADMIN              0x0024
+#define SYNC_DCN_REG_WINDOW_STATUS      0x0034
+#define SYNC_DCN_REG_CURRENT_ENTRY_PTR  0x0038
+#define SYNC_DCN_REG_ACTIVE_APP_INFO    0x0048
+#define SYNC_DCN_REG_ACTIVE_CONTEXT     0x004C
+#define SYNC_DCN_REG_AI_ENABLE          0x0054
+#define SYNC_DCN_REG_BANK_STATUS        0x0060
+#define SYNC_DCN_REG_PENDING_TIME_LO    0x0064
+#define SYNC_DCN_REG_PENDING_TIME_HI    0x0068
+
+#define SYNC_DCN_CTRL_ENABLE          0x00000001
+#define SYNC_DCN_EXEC_STATUS_ENABLE   0x00000001
+#define SYNC_DCN_EXEC_STATUS_BANK     0x00000002
+#define SYNC_DCN_EXEC_STATUS_PENDING  0x00000004
+#define SYNC_DCN_ADMIN_ARM            0x00000002
+
+#define SYNC_DCN_LOAD_CHUNK 64
+
+// re-check this often once the activation time has passed
+#define SYNC_DCN_CONFIRM_NS 10000
+// and report the switch as late after this long
+#define SYNC_DCN_LATE_NS 1000000
+
+#define SYNC_DCN_EVENT_RING 16
+
+struct sync_dcn_table {
+	u32 offset;
+	u32 count;
+	bool banked;
+};
+
+static const struct sync_dcn_table sync_dcn_tables[] = {
+	[SYNC_DCN_TABLE_TX_EXEC] = { 0x1000, 576, true },
+	[SYNC_DCN_TABLE_RX_EXEC] = { 0x5800, 448, true },
+	[SYNC_DCN_TABLE_AI_TRACE] = { 0x9000, 896, false },
+};
+
+struct mqnic_app_sync_dcn {
+	struct device *dev;
+	struct mqnic_dev *mdev;
+	struct mqnic_adev *adev;
+
+	struct device *nic_dev;
+
+	void __iomem *nic_hw_addr;
+	void __iomem *app_hw_addr;
+	void __iomem *app_hw_addr_wc;
+
+	char name[32];
+	struct miscdevice misc_dev;
+
+	// serializes table loads and arming
+	struct mutex lock;
+
+	// switch tracking and the event ring, also touched from the timer
+	spinlock_t event_lock;
+	struct hrtimer timer;
+	bool armed;
+	bool armed_late;
+	u32 armed_bank;
+	u64 armed_time_ns;
+	u64 armed_mono_ns;
+	u64 switch_count;
+	u64 last_switch_ns;
+
+	u64 event_seq;
+	struct sync_dcn_event events[SYNC_DCN_EVENT_RING];
+	wait_queue_head_t event_wq;
+	struct eventfd_ctx *eventfd;
+};
+
+struct mqnic_app_sync_dcn_file {
+	struct mqnic_app_sync_dcn *app;
+	u64 read_seq;
+};
+
+static u32 sync_dcn_read(struct mqnic_app_sync_dcn *app, u32 reg)
+{
+	return ioread32(app->app_hw_addr + reg);
+}
+
+static void sync_dcn_write(struct mqnic_app_sync_dcn *app, u32 reg, u32 val)
+{
+	iowrite32(val, app->app_hw_addr + reg);
+}
+
+// caller holds event_lock
+static void sync_dcn_post_event(struct mqnic_app_sync_dcn *app, u32 type, u64 phc_ns)
+{
+	struct sync_dcn_event *ev = &app->events[app->event_seq % SYNC_DCN_EVENT_RING];
+
+	memset(ev, 0, sizeof(*ev));
+	ev->type = type;
+	ev->seq = app->event_seq;
+	ev->bank = app->armed_bank;
+	ev->exec_status = sync_dcn_read(app, SYNC_DCN_REG_EXEC_STATUS);
+	ev->window_status = sync_dcn_read(app, SYNC_DCN_REG_WINDOW_STATUS);
+	ev->entry_ptr = sync_dcn_read(app, SYNC_DCN_REG_CURRENT_ENTRY_PTR);
+	ev->activate_time_ns = app->armed_time_ns;
+	ev->phc_time_ns = phc_ns;
+
+	app->event_seq++;
+
+	if (app->eventfd)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+		eventfd_signal(app->eventfd);
+#else
+		eventfd_signal(app->eventfd, 1);
+#endif
+
+	wake_up_interruptible(&app->event_wq);
+}
+
+static enum hrtimer_restart sync_dcn_timer(struct hrtimer *timer)
+{
+	struct mqnic_app_sync_dcn *app = container_of(timer, struct mqnic_app_sync_dcn, timer);
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long flags;
+	u64 phc_ns, mono_ns;
+	u32 val;
+
+	spin_lock_irqsave(&app->event_lock, flags);
+
+	if (!app->armed)
+		goto out;
+
+	if (mqnic_phc_read_time(app->mdev, &phc_ns, &mono_ns))
+		phc_ns = 0;
+
+	val = sync_dcn_read(app, SYNC_DCN_REG_EXEC_STATUS);
+
+	if (!(val & SYNC_DCN_EXEC_STATUS_PENDING) &&
+			!!(val & SYNC_DCN_EXEC_STATUS_BANK) == app->armed_bank) {
+		app->armed = false;
+		app->switch_count++;
+		app->last_switch_ns = phc_ns;
+		sync_dcn_post_event(app, SYNC_DCN_EVENT_BANK_SWITCH, phc_ns);
+		goto out;
+	}
+
+	// the host clock runs a little off the PHC; keep checking, but say
+	// once that the switch is overdue
+	if (!app->armed_late && phc_ns > app->armed_time_ns + SYNC_DCN_LATE_NS) {
+		app->armed_late = true;
+		sync_dcn_post_event(app, SYNC_DCN_EVENT_SWITCH_LATE, phc_ns);
+	}
+
+	hrtimer_forward_now(timer, ns_to_ktime(SYNC_DCN_CONFIRM_NS));
+	ret = HRTIMER_RESTART;
+
+out:
+	spin_unlock_irqrestore(&app->event_lock, flags);
+	return ret;
+}
+
+static int sync_dcn_load_table(struct mqnic_app_sync_dcn *app,
+		struct sync_dcn_ioctl_load_table *info)
+{
+	const u32 __user *src = u64_to_user_ptr(info->data);
+	const struct sync_dcn_table *table;
+	void __iomem *base;
+	u32 buf[SYNC_DCN_LOAD_CHUNK];
+	u32 words, done, n, k;
+	u32 val;
+
+	if (info->table >= ARRAY_SIZE(sync_dcn_tables) || info->bank > 1)
+		return -EINVAL;
+
+	table = &sync_dcn_tables[info->table];
+
+	if (info->count > table->count)
+		return -E2BIG;
+
+	if (table->banked) {
+		val = sync_dcn_read(app, SYNC_DCN_REG_EXEC_STATUS);
+
+		// never rewrite the bank that is executing, and leave the admin
+		// bank alone while a switch is pending
+		if ((val & SYNC_DCN_EXEC_STATUS_ENABLE) &&
+				!!(val & SYNC_DCN_EXEC_STATUS_BANK) == info->bank)
+			return -EBUSY;
+		if (READ_ONCE(app->armed))
+			return -EBUSY;
+
+		sync_dcn_write(app, SYNC_DCN_REG_ADMIN, info->bank);
+	}
+
+	base = (app->app_hw_addr_wc ?: app->app_hw_addr) + table->offset;
+	words = info->count * SYNC_DCN_ENTRY_WORDS;
+
+	for (done = 0; done < words; done += n) {
+		n = min_t(u32, words - done, SYNC_DCN_LOAD_CHUNK);
+
+		if (copy_from_user(buf, src + done, n * sizeof(u32)))
+			return -EFAULT;
+
+		for (k = 0; k < n; k++)
+			iowrite32(buf[k], base + (done + k) * 4);
+
+		cond_resched();
+	}
+
+	// flush write-combined stores before the bank can be armed
+	wmb();
+	ioread32(app->app_hw_addr + SYNC_DCN_REG_ADMIN);
+
+	if (info->flags & SYNC_DCN_LOAD_FLAG_AI_ENABLE)
+		sync_dcn_write(app, SYNC_DCN_REG_AI_ENABLE, 1);
+
+	return 0;
+}
+
+static int sync_dcn_arm(struct mqnic_app_sync_dcn *app, struct sync_dcn_ioctl_arm *info)
+{
+	unsigned long flags;
+	u64 phc_ns, mono_ns;
+	int ret;
+
+	if (info->bank > 1)
+		return -EINVAL;
+
+	ret = mqnic_phc_read_time(app->mdev, &phc_ns, &mono_ns);
+	if (ret)
+		return ret;
+
+	info->phc_time_ns = phc_ns;
+
+	if (info->activate_time_ns < phc_ns + info->min_lead_ns)
+		return -ETIME;
+
+	hrtimer_cancel(&app->timer);
+
+	spin_lock_irqsave(&app->event_lock, flags);
+
+	// the hardware keeps one pending switch, a new arm replaces it
+	if (app->armed)
+		sync_dcn_post_event(app, SYNC_DCN_EVENT_CANCELED, phc_ns);
+
+	app->armed = true;
+	app->armed_late = false;
+	app->armed_bank = info->bank;
+	app->armed_time_ns = info->activate_time_ns;
+	app->armed_mono_ns = mono_ns + (info->activate_time_ns - phc_ns);
+
+	sync_dcn_write(app, SYNC_DCN_REG_ACTIVATE_TIME_LO, lower_32_bits(info->activate_time_ns));
+	sync_dcn_write(app, SYNC_DCN_REG_ACTIVATE_TIME_HI, upper_32_bits(info->activate_time_ns));
+	sync_dcn_write(app, SYNC_DCN_REG_ADMIN, info->bank | SYNC_DCN_ADMIN_ARM);
+
+	spin_unlock_irqrestore(&app->event_lock, flags);
+
+	if (info->flags & SYNC_DCN_ARM_FLAG_ENABLE)
+		sync_dcn_write(app, SYNC_DCN_REG_CTRL, SYNC_DCN_CTRL_ENABLE);
+
+	hrtimer_start(&app->timer, ns_to_ktime(app->armed_mono_ns), HRTIMER_MODE_ABS);
+
+	return 0;
+}
+
+static void sync_dcn_get_status(struct mqnic_app_sync_dcn *app, struct sync_dcn_ioctl_status *info)
+{
+	unsigned long flags;
+	u64 mono_ns;
+
+	info->exec_status = sync_dcn_read(app, SYNC_DCN_REG_EXEC_STATUS);
+	info->window_status = sync_dcn_read(app, SYNC_DCN_REG_WINDOW_STATUS);
+	info->bank_status = sync_dcn_read(app, SYNC_DCN_REG_BANK_STATUS);
+	info->entry_ptr = sync_dcn_read(app, SYNC_DCN_REG_CURRENT_ENTRY_PTR);
+	info->active_context = sync_dcn_read(app, SYNC_DCN_REG_ACTIVE_CONTEXT);
+	info->active_app_info = sync_dcn_read(app, SYNC_DCN_REG_ACTIVE_APP_INFO);
+	info->pending_time_ns = sync_dcn_read(app, SYNC_DCN_REG_PENDING_TIME_LO);
+	info->pending_time_ns |= (u64)sync_dcn_read(app, SYNC_DCN_REG_PENDING_TIME_HI) << 32;
+
+	if (mqnic_phc_read_time(app->mdev, &info->phc_time_ns, &mono_ns))
+		info->phc_time_ns = 0;
+
+	spin_lock_irqsave(&app->event_lock, flags);
+	info->switch_count = app->switch_count;
+	info->last_switch_ns = app->last_switch_ns;
+	spin_unlock_irqrestore(&app->event_lock, flags);
+}
+
+static int sync_dcn_set_eventfd(struct mqnic_app_sync_dcn *app, int fd)
+{
+	struct eventfd_ctx *ctx = NULL;
+	struct eventfd_ctx *old;
+	unsigned long flags;
+
+	if (fd >= 0) {
+		ctx = eventfd_ctx_fdget(fd);
+		if (IS_ERR(ctx))
+			return PTR_ERR(ctx);
+	}
+
+	spin_lock_irqsave(&app->event_lock, flags);
+	old = app->eventfd;
+	app->eventfd = ctx;
+	spin_unlock_irqrestore(&app->event_lock, flags);
+
+	if (old)
+		eventfd_ctx_put(old);
+
+	return 0;
+}
+
+static int sync_dcn_open(struct inode *inode, struct file *file)
+{
+	struct miscdevice *miscdev = file->private_data;
+	struct mqnic_app_sync_dcn *app = container_of(miscdev, struct mqnic_app_sync_dcn, misc_dev);
+	struct mqnic_app_sync_dcn_file *fp;
+	unsigned long flags;
+
+	fp = kzalloc(sizeof(*fp), GFP_KERNEL);
+	if (!fp)
+		return -ENOMEM;
+
+	fp->app = app;
+
+	// only events from here on
+	spin_lock_irqsave(&app->event_lock, flags);
+	fp->read_seq = app->event_seq;
+	spin_unlock_irqrestore(&app->event_lock, flags);
+
+	file->private_data = fp;
+
+	return nonseekable_open(inode, file);
+}
+
+static int sync_dcn_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+
+	return 0;
+}
+
+static ssize_t sync_dcn_read_events(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	struct mqnic_app_sync_dcn_file *fp = file->private_data;
+	struct mqnic_app_sync_dcn *app = fp->app;
+	struct sync_dcn_event ev;
+	unsigned long flags;
+	size_t done = 0;
+	int ret;
+
+	if (count < sizeof(ev))
+		return -EINVAL;
+
+	if (!(file->f_flags & O_NONBLOCK)) {
+		ret = wait_event_interruptible(app->event_wq, READ_ONCE(app->event_seq) != fp->read_seq);
+		if (ret)
+			return ret;
+	}
+
+	while (done + sizeof(ev) <= count) {
+		spin_lock_irqsave(&app->event_lock, flags);
+
+		if (fp->read_seq == app->event_seq) {
+			spin_unlock_irqrestore(&app->event_lock, flags);
+			break;
+		}
+
+		if (app->event_seq - fp->read_seq > SYNC_DCN_EVENT_RING) {
+			fp->read_seq = app->event_seq - SYNC_DCN_EVENT_RING;
+			ev = app->events[fp->read_seq % SYNC_DCN_EVENT_RING];
+			ev.flags |= SYNC_DCN_EVENT_FLAG_LOST;
+		} else {
+			ev = app->events[fp->read_seq % SYNC_DCN_EVENT_RING];
+		}
+		fp->read_seq++;
+
+		spin_unlock_irqrestore(&app->event_lock, flags);
+
+		if (copy_to_user(buf + done, &ev, sizeof(ev)))
+			return -EFAULT;
+
+		done += sizeof(ev);
+	}
+
+	return done ? done : -EAGAIN;
+}
+
+static __poll_t sync_dcn_poll(struct file *file, poll_table *wait)
+{
+	struct mqnic_app_sync_dcn_file *fp = file->private_data;
+	struct mqnic_app_sync_dcn *app = fp->app;
+
+	poll_wait(file, &app->event_wq, wait);
+
+	if (READ_ONCE(app->event_seq) != fp->read_seq)
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+static long sync_dcn_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct mqnic_app_sync_dcn_file *fp = file->private_data;
+	struct mqnic_app_sync_dcn *app = fp->app;
+	size_t minsz;
+	int ret;
+
+	if (cmd == SYNC_DCN_IOCTL_GET_API_VERSION) {
+		return SYNC_DCN_IOCTL_API_VERSION;
+	} else if (cmd == SYNC_DCN_IOCTL_LOAD_TABLE) {
+		struct sync_dcn_ioctl_load_table info;
+
+		minsz = offsetofend(struct sync_dcn_ioctl_load_table, data);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz || (info.flags & ~SYNC_DCN_LOAD_FLAG_AI_ENABLE))
+			return -EINVAL;
+
+		if ((info.flags & SYNC_DCN_LOAD_FLAG_AI_ENABLE) && info.table != SYNC_DCN_TABLE_AI_TRACE)
+			return -EINVAL;
+
+		mutex_lock(&app->lock);
+		ret = sync_dcn_load_table(app, &info);
+		mutex_unlock(&app->lock);
+
+		return ret;
+	} else if (cmd == SYNC_DCN_IOCTL_ARM_SWITCH) {
+		struct sync_dcn_ioctl_arm info;
+
+		minsz = offsetofend(struct sync_dcn_ioctl_arm, phc_time_ns);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz || (info.flags & ~SYNC_DCN_ARM_FLAG_ENABLE))
+			return -EINVAL;
+
+		mutex_lock(&app->lock);
+		ret = sync_dcn_arm(app, &info);
+		mutex_unlock(&app->lock);
+
+		if (ret && ret != -ETIME)
+			return ret;
+
+		if (copy_to_user((void __user *)arg, &info, minsz))
+			return -EFAULT;
+
+		return ret;
+	} else if (cmd == SYNC_DCN_IOCTL_GET_STATUS) {
+		struct sync_dcn_ioctl_status info;
+
+		minsz = offsetofend(struct sync_dcn_ioctl_status, last_switch_ns);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz)
+			return -EINVAL;
+
+		info.flags = 0;
+		sync_dcn_get_status(app, &info);
+
+		return copy_to_user((void __user *)arg, &info, minsz) ? -EFAULT : 0;
+	} else if (cmd == SYNC_DCN_IOCTL_SET_EVENTFD) {
+		s32 fd;
+
+		if (get_user(fd, (s32 __user *)arg))
+			return -EFAULT;
+
+		return sync_dcn_set_eventfd(app, fd);
+	}
+
+	return -EINVAL;
+}
+
+static const struct file_operations sync_dcn_fops = {
+	.owner = THIS_MODULE,
+	.open = sync_dcn_open,
+	.release = sync_dcn_release,
+	.read = sync_dcn_read_events,
+	.poll = sync_dcn_poll,
+	.unlocked_ioctl = sync_dcn_ioctl,
+};
+
+static int mqnic_app_sync_dcn_probe(struct auxiliary_device *adev,
+		const struct auxiliary_device_id *id)
+{
+	struct mqnic_app_sync_dcn *app;
+	struct mqnic_dev *mdev = container_of(adev, struct mqnic_adev, adev)->mdev;
+	struct device *dev = &adev->dev;
+	int ret;
+
+	dev_info(dev, "%s() called", __func__);
+
+	if (!mdev->hw_addr || !mdev->app_hw_addr) {
+		dev_err(dev, "Error: required region not present");
+		return -EIO;
+	}
+
+	if (!mdev->phc_rb) {
+		dev_err(dev, "Error: PHC not present");
+		return -EIO;
+	}
+
+	app = devm_kzalloc(dev, sizeof(*app), GFP_KERNEL);
+	if (!app)
+		return -ENOMEM;
+
+	app->dev = dev;
+	app->mdev = mdev;
+	dev_set_drvdata(&adev->dev, app);
+
+	app->nic_dev = mdev->dev;
+	app->nic_hw_addr = mdev->hw_addr;
+	app->app_hw_addr = mdev->app_hw_addr;
+	app->app_hw_addr_wc = mdev->app_hw_addr_wc;
+
+	mutex_init(&app->lock);
+	spin_lock_init(&app->event_lock);
+	init_waitqueue_head(&app->event_wq);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&app->timer, sync_dcn_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+#else
+	hrtimer_init(&app->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	app->timer.function = sync_dcn_timer;
+#endif
+
+	snprintf(app->name, sizeof(app->name), "%s_sync_dcn", mdev->name);
+
+	app->misc_dev.minor = MISC_DYNAMIC_MINOR;
+	app->misc_dev.name = app->name;
+	app->misc_dev.fops = &sync_dcn_fops;
+	app->misc_dev.parent = dev;
+
+	ret = misc_register(&app->misc_dev);
+	if (ret) {
+		dev_err(dev, "misc_register failed: %d", ret);
+		return ret;
+	}
+
+	dev_info(dev, "Registered device %s", app->name);
+
+	return 0;
+}
+
+static void mqnic_app_sync_dcn_remove(struct auxiliary_device *adev)
+{
+	struct mqnic_app_sync_dcn *app = dev_get_drvdata(&adev->dev);
+	struct device *dev = app->dev;
+
+	dev_info(dev, "%s() called", __func__);
+
+	misc_deregister(&app->misc_dev);
+
+	hrtimer_cancel(&app->timer);
+
+	if (app->eventfd)
+		eventfd_ctx_put(app->eventfd);
+}
+
+static const struct auxiliary_device_id mqnic_app_sync_dcn_id_table[] = {
+	{ .name = "mqnic.app_12340001" },
+	{},
+};
+
+MODULE_DEVICE_TABLE(auxiliary, mqnic_app_sync_dcn_id_table);
+
+static struct auxiliary_driver mqnic_app_sync_dcn_driver = {
+	.name = "mqnic_app_sync_dcn",
+	.probe = mqnic_app_sync_dcn_probe,
+	.remove = mqnic_app_sync_dcn_remove,
+	.id_table = mqnic_app_sync_dcn_id_table,
+};
+
+static int __init mqnic_app_sync_dcn_init(void)
+{
+	return auxiliary_driver_register(&mqnic_app_sync_dcn_driver);
+}
+
+static void __exit mqnic_app_sync_dcn_exit(void)
+{
+	auxiliary_driver_unregister(&mqnic_app_sync_dcn_driver);
+}
+
+module_init(mqnic_app_sync_dcn_init);
+module_exit(mqnic_app_sync_dcn_exit);
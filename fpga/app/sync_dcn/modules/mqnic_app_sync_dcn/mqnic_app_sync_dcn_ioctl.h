@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: BSD-2-Clause-Views */
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#ifndef MQNIC_APP_SYNC_DCN_IOCTL_H
+#define MQNIC_APP_SYNC_DCN_IOCTL_H
+
+#include <linux/types.h>
+
+#define SYNC_DCN_IOCTL_API_VERSION 1
+
+#define SYNC_DCN_IOCTL_TYPE 0x89
+#define SYNC_DCN_IOCTL_BASE 0xC0
+
+enum {
+	SYNC_DCN_TABLE_TX_EXEC = 0,
+	SYNC_DCN_TABLE_RX_EXEC = 1,
+	SYNC_DCN_TABLE_AI_TRACE = 2
+};
+
+// every table entry occupies 8 words, unused trailing words are written too
+#define SYNC_DCN_ENTRY_WORDS 8
+
+// get API version
+#define SYNC_DCN_IOCTL_GET_API_VERSION _IO(SYNC_DCN_IOCTL_TYPE, SYNC_DCN_IOCTL_BASE + 0)
+
+// load count entries from data (count*8 words) into a table of the given
+// bank, starting at entry 0; execution tables are refused for the active
+// bank while the subsystem is enabled, and for either bank while a switch
+// is armed; the AI trace table is unbanked
+struct sync_dcn_ioctl_load_table {
+	__u32 argsz;
+	__u32 flags;
+	__u32 bank;
+	__u32 table;
+	__u32 count;
+	__u32 rsvd;
+	__u64 data;
+};
+
+// load flags
+#define SYNC_DCN_LOAD_FLAG_AI_ENABLE (1 << 0) // AI trace only: enable replay once loaded
+
+#define SYNC_DCN_IOCTL_LOAD_TABLE _IO(SYNC_DCN_IOCTL_TYPE, SYNC_DCN_IOCTL_BASE + 1)
+
+// arm flags
+#define SYNC_DCN_ARM_FLAG_ENABLE (1 << 0) // enable the subsystem once armed
+
+// switch to bank at activate_time_ns on the PHC timescale; fails with
+// -ETIME when that is less than min_lead_ns away, current PHC time is
+// returned in phc_time_ns either way
+struct sync_dcn_ioctl_arm {
+	__u32 argsz;
+	__u32 flags;
+	__u32 bank;
+	__u32 rsvd;
+	__u64 activate_time_ns;
+	__u64 min_lead_ns;
+	__u64 phc_time_ns;
+};
+
+#define SYNC_DCN_IOCTL_ARM_SWITCH _IO(SYNC_DCN_IOCTL_TYPE, SYNC_DCN_IOCTL_BASE + 2)
+
+// raw register snapshot, decoded the same way as sync_dcn_host.py
+struct sync_dcn_ioctl_status {
+	__u32 argsz;
+	__u32 flags;
+	__u32 exec_status;
+	__u32 window_status;
+	__u32 bank_status;
+	__u32 entry_ptr;
+	__u32 active_context;
+	__u32 active_app_info;
+	__u64 pending_time_ns;
+	__u64 phc_time_ns;
+	__u64 switch_count;
+	__u64 last_switch_ns;
+};
+
+#define SYNC_DCN_IOCTL_GET_STATUS _IO(SYNC_DCN_IOCTL_TYPE, SYNC_DCN_IOCTL_BASE + 3)
+
+// signal an eventfd on every event, -1 to detach
+#define SYNC_DCN_IOCTL_SET_EVENTFD _IOW(SYNC_DCN_IOCTL_TYPE, SYNC_DCN_IOCTL_BASE + 4, __s32)
+
+enum {
+	SYNC_DCN_EVENT_BANK_SWITCH = 1, // armed switch observed as taken
+	SYNC_DCN_EVENT_SWITCH_LATE = 2, // still pending well after activate time
+	SYNC_DCN_EVENT_CANCELED = 3 // replaced by a new arm before it fired
+};
+
+// event flags
+#define SYNC_DCN_EVENT_FLAG_LOST (1 << 0) // older events were overwritten
+
+// read() returns whole events; poll() reports EPOLLIN while any are unread
+struct sync_dcn_event {
+	__u32 type;
+	__u32 flags;
+	__u64 seq;
+	__u32 bank;
+	__u32 exec_status;
+	__u32 window_status;
+	__u32 entry_ptr;
+	__u64 activate_time_ns;
+	__u64 phc_time_ns;
+};
+
+/*
+ * Binary table image, as emitted by per_node_lowering/sync_dcn_compile.py
+ * and results/nic/node_<id>.bin.  All fields are little-endian.  The header
+ * is followed by section_count section descriptors; each section is count
+ * entries of SYNC_DCN_ENTRY_WORDS words laid out exactly as in the hardware
+ * table, so a loader maps the file and hands data at offset straight to
+ * SYNC_DCN_IOCTL_LOAD_TABLE, or copies it to the table in the BAR.
+ */
+#define SYNC_DCN_IMAGE_MAGIC "SDCNIMG"
+#define SYNC_DCN_IMAGE_VERSION 1
+
+// image flags
+#define SYNC_DCN_IMAGE_FLAG_ARM       (1 << 0) // load exec tables into admin_bank and arm
+#define SYNC_DCN_IMAGE_FLAG_ENABLE    (1 << 1) // enable the subsystem once armed
+#define SYNC_DCN_IMAGE_FLAG_AI_REPLAY (1 << 2) // enable AI replay after the trace load
+
+struct sync_dcn_image_header {
+	__u8 magic[8];
+	__u32 version;
+	__u32 header_len; // header plus section descriptors
+	__u32 flags;
+	__u32 admin_bank;
+	__u64 activate_time_ns;
+	__u32 section_count;
+	__u32 rsvd;
+};
+
+struct sync_dcn_image_section {
+	__u32 table; // SYNC_DCN_TABLE_*
+	__u32 count;
+	__u64 offset; // from the start of the image, 64-byte aligned
+};
+
+#endif /* MQNIC_APP_SYNC_DCN_IOCTL_H */
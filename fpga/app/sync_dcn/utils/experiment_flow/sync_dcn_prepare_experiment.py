@@ -27,6 +27,7 @@ if str(UTILS_ROOT) not in sys.path:
     sys.path.append(str(UTILS_ROOT))
 
 from global_co_compiler.sync_dcn_global_compile import compile_global_spec
+from per_node_lowering.sync_dcn_compile import compile_image
 from system_input.sync_dcn_build_moe_model_experiment import build_global_ai_spec
 from system_input.sync_dcn_load_system_input import load_system_input_spec
 from visualization.sync_dcn_export_schedule import build_flat_rows, export_csv, export_flat_json, export_mermaid
@@ -339,6 +340,7 @@ def build_manifest_json(
             "hostname": hostname,
             "processor_artifact": str(results_dir / "processor" / f"node_{node_id}.json"),
             "nic_artifact": str(results_dir / "nic" / f"node_{node_id}.json"),
+            "nic_image": str(results_dir / "nic" / f"node_{node_id}.bin"),
             "prototype_runtime_artifact": str(prototype_runtime_dir / f"node_{node_id}.json"),
             "resource": resource_template.format(node_id=node_id),
             "source_workloads": compiled["per_node_programs"][node_id].get("metadata", {}).get("source_workloads", []),
@@ -399,12 +401,14 @@ def build_manifest(
 
     for node_id in sorted_node_ids(compiled["per_node_programs"]):
         nic_path = results_dir / "nic" / f"node_{node_id}.json"
+        nic_image_path = results_dir / "nic" / f"node_{node_id}.bin"
         proc_path = results_dir / "processor" / f"node_{node_id}.json"
         proto_path = prototype_runtime_dir / f"node_{node_id}.json"
         hostname = compiled["per_node_programs"][node_id].get("metadata", {}).get("hostname", f"node-{node_id}")
         lines.append(f"- node {node_id} ({hostname}):")
         lines.append(f"  processor: {proc_path}")
         lines.append(f"  nic: {nic_path}")
+        lines.append(f"  nic_image: {nic_image_path}")
         lines.append(f"  prototype_runtime_compat: {proto_path}")
 
     lines.append("")
@@ -520,6 +524,7 @@ def main(argv: list[str] | None = None) -> int:
 
     for node_id, artifact in nic_artifacts.items():
         write_json(results_dir / "nic" / f"node_{node_id}.json", artifact)
+        (results_dir / "nic" / f"node_{node_id}.bin").write_bytes(compile_image(artifact))
 
     for node_id, artifact in prototype_runtime_artifacts.items():
         write_json(prototype_runtime_dir / f"node_{node_id}.json", artifact)
@@ -4,7 +4,8 @@
 This tool is intentionally simple:
 
 - consensus workloads use periodic EPS control windows
-- AI matrix workloads use greedy OCS matching epochs
+- AI matrix workloads use greedy OCS matching epochs, computed by the native
+  core in sync_dcn_match.c when it is built and spread across CPU cores
 - local per-node programs are lowered into the existing low-level JSON ABI via
   sync_dcn_compile.compile_spec
 
@@ -18,7 +19,9 @@ import argparse
 import copy
 import json
 import math
+import os
 import sys
+from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
 from typing import Any, Dict, List, Tuple
 
@@ -29,6 +32,7 @@ if str(UTILS_ROOT) not in sys.path:
 from system_input.sync_dcn_build_moe_model_experiment import build_compiled_matrix, normalize_matrix
 from per_node_lowering.sync_dcn_compile import compile_spec
 from schedule_timing import estimate_epoch_duration_ns, resolve_ai_plane_timing
+from global_co_compiler.sync_dcn_match import load_native_core, schedule_epochs
 
 try:
     import yaml  # type: ignore
@@ -182,6 +186,70 @@ def matrix_has_work(remaining: List[List[int]], active_nodes: List[int]) -> bool
     return False
 
 
+def build_workload_matrix(workload: Dict[str, Any]) -> List[List[int]]:
+    """Return the compiled packet matrix an AI matrix workload schedules."""
+
+    return build_compiled_matrix(
+        normalize_matrix(workload["base_matrix"]),
+        matrix_mode=str(workload.get("matrix_mode", "exact")).strip().lower(),
+        capacity_factor=float(workload.get("capacity_factor", 1.0)),
+        padding_packets=parse_int(workload.get("padding_packets", 0), "padding_packets"),
+    )
+
+
+def schedule_workload_epochs(workload: Dict[str, Any], active_nodes: List[Any]) -> List[List[Tuple[int, int, int]]]:
+    """Compute the greedy matching epochs of one AI matrix workload."""
+
+    return schedule_epochs(
+        build_workload_matrix(workload),
+        [parse_int(node, "active_node") for node in active_nodes],
+    )
+
+
+def ai_schedule_jobs(workloads: List[Dict[str, Any]]) -> List[Tuple[Tuple[int, str | None], Dict[str, Any], List[Any]]]:
+    """List every matrix to schedule as ((workload index, phase role), workload, nodes)."""
+
+    jobs = []
+    for index, workload in enumerate(workloads):
+        workload_type = str(workload["type"]).strip().lower()
+        if workload_type == "ai_matrix":
+            jobs.append(((index, None), workload, workload["active_nodes"]))
+        elif workload_type == "moe_phase_sequence":
+            for role in ("dispatch", "combine"):
+                jobs.append(((index, role), workload[role], workload["active_nodes"]))
+    return jobs
+
+
+def precompute_ai_epochs(
+    workloads: List[Dict[str, Any]],
+    jobs: int | None = None,
+) -> Dict[Tuple[int, str | None], List[List[Tuple[int, int, int]]]]:
+    """Schedule every AI phase up front, in parallel when the native core is built.
+
+    Matching depends only on a phase's own matrix, while window timing depends
+    on where earlier phases end, so the matchings can be computed independently
+    and the timeline assembled serially afterwards.  The pure Python fallback
+    holds the GIL and always runs serially.
+    """
+
+    schedule_jobs = ai_schedule_jobs(workloads)
+    if jobs is None:
+        jobs = os.cpu_count() or 1
+    if load_native_core() is None:
+        jobs = 1
+    jobs = max(1, min(jobs, len(schedule_jobs)))
+
+    if jobs == 1:
+        return {key: schedule_workload_epochs(workload, nodes) for key, workload, nodes in schedule_jobs}
+
+    with ThreadPoolExecutor(max_workers=jobs) as pool:
+        futures = {
+            key: pool.submit(schedule_workload_epochs, workload, nodes)
+            for key, workload, nodes in schedule_jobs
+        }
+        return {key: future.result() for key, future in futures.items()}
+
+
 def append_compute_gap_window(
     *,
     global_windows: List[Dict[str, Any]],
@@ -220,8 +288,13 @@ def compile_ai_matrix_workload(
     start_time_override_ns: int | None = None,
     source_workload_name: str = "ai_matrix",
     phase_role: str | None = None,
+    epochs: List[List[Tuple[int, int, int]]] | None = None,
 ) -> int:
-    """Schedule one AI matrix workload using greedy OCS matching epochs."""
+    """Schedule one AI matrix workload using greedy OCS matching epochs.
+
+    ``epochs`` may carry the matchings already computed for this workload by
+    precompute_ai_epochs; they are computed here otherwise.
+    """
 
     active_nodes = [parse_int(node, "active_node") for node in workload["active_nodes"]]
     base_matrix = normalize_matrix(workload["base_matrix"])
@@ -252,8 +325,6 @@ def compile_ai_matrix_workload(
         capacity_factor=capacity_factor,
         padding_packets=padding_packets,
     )
-    remaining = [row[:] for row in compiled_matrix]
-
     if realized_matrix is not None:
         spill_total = 0
         for src in active_nodes:
@@ -269,11 +340,12 @@ def compile_ai_matrix_workload(
             }
         )
 
+    if epochs is None:
+        epochs = schedule_epochs(compiled_matrix, active_nodes)
+
     cursor_ns = start_time_ns
-    epoch_index = 0
 
-    while matrix_has_work(remaining, active_nodes):
-        matching = greedy_matching(remaining, active_nodes)
+    for epoch_index, matching in enumerate(epochs):
         if not matching:
             raise RuntimeError("greedy matching failed to make progress on non-empty matrix")
 
@@ -305,7 +377,6 @@ def compile_ai_matrix_workload(
         )
 
         for src, dst, packet_count in matching:
-            remaining[src][dst] = 0
             flow_id = epoch_index * 256 + src * 16 + dst
             payload_seed = ((src & 0xFF) << 24) | ((dst & 0xFF) << 16) | (flow_id & 0xFFFF)
 
@@ -348,7 +419,7 @@ def compile_ai_matrix_workload(
             )
 
         cursor_ns = epoch_end
-        if matrix_has_work(remaining, active_nodes):
+        if epoch_index + 1 < len(epochs):
             guard_before_end = cursor_ns + guard_band_ns
             global_windows.append(
                 {
@@ -418,8 +489,6 @@ def compile_ai_matrix_workload(
                 )
             cursor_ns = guard_after_end
 
-        epoch_index += 1
-
     return cursor_ns
 
 
@@ -429,6 +498,9 @@ def compile_moe_phase_sequence(
     global_windows: List[Dict[str, Any]],
     global_metadata: Dict[str, Any],
     topology: Dict[str, Any] | None = None,
+    *,
+    dispatch_epochs: List[List[Tuple[int, int, int]]] | None = None,
+    combine_epochs: List[List[Tuple[int, int, int]]] | None = None,
 ) -> None:
     """Expand one MoE step into dispatch -> compute gap -> combine."""
 
@@ -461,6 +533,7 @@ def compile_moe_phase_sequence(
         start_time_override_ns=dispatch_start_ns,
         source_workload_name=phase_name,
         phase_role="dispatch",
+        epochs=dispatch_epochs,
     )
 
     compute_end_ns = dispatch_end_ns + expert_compute_ns
@@ -494,6 +567,7 @@ def compile_moe_phase_sequence(
         start_time_override_ns=combine_start_ns,
         source_workload_name=phase_name,
         phase_role="combine",
+        epochs=combine_epochs,
     )
 
     completion_end_ns = combine_end_ns + completion_slack_ns
@@ -507,8 +581,11 @@ def compile_moe_phase_sequence(
     )
 
 
-def compile_global_spec(spec: Dict[str, Any]) -> Dict[str, Any]:
-    """Compile the global input into a global plan plus per-node low-level programs."""
+def compile_global_spec(spec: Dict[str, Any], jobs: int | None = None) -> Dict[str, Any]:
+    """Compile the global input into a global plan plus per-node low-level programs.
+
+    ``jobs`` bounds the threads scheduling AI phases (default: one per CPU).
+    """
 
     cluster_spec = spec.get("cluster", {})
     topology = spec.get("topology", {})
@@ -551,7 +628,9 @@ def compile_global_spec(spec: Dict[str, Any]) -> Dict[str, Any]:
     if isinstance(spec.get("metadata"), dict):
         global_metadata["input_metadata"] = copy.deepcopy(spec["metadata"])
 
-    for workload in workloads:
+    ai_epochs = precompute_ai_epochs(workloads, jobs)
+
+    for workload_index, workload in enumerate(workloads):
         workload_type = str(workload["type"]).strip().lower()
         if workload_type == "consensus_periodic":
             phase = make_consensus_phase(workload)
@@ -581,14 +660,29 @@ def compile_global_spec(spec: Dict[str, Any]) -> Dict[str, Any]:
                     local_specs[node_id]["phases"].append(copy.deepcopy(phase))
                     local_specs[node_id]["metadata"]["source_workloads"].append("consensus_periodic")
         elif workload_type == "ai_matrix":
-            compile_ai_matrix_workload(workload, local_specs, global_windows, global_metadata, topology)
+            compile_ai_matrix_workload(
+                workload,
+                local_specs,
+                global_windows,
+                global_metadata,
+                topology,
+                epochs=ai_epochs[(workload_index, None)],
+            )
             for node_id, local_spec in local_specs.items():
                 if local_spec["phases"]:
                     local_spec["enable_ai_replay"] = True
                     if "ai_matrix" not in local_spec["metadata"]["source_workloads"]:
                         local_spec["metadata"]["source_workloads"].append("ai_matrix")
         elif workload_type == "moe_phase_sequence":
-            compile_moe_phase_sequence(workload, local_specs, global_windows, global_metadata, topology)
+            compile_moe_phase_sequence(
+                workload,
+                local_specs,
+                global_windows,
+                global_metadata,
+                topology,
+                dispatch_epochs=ai_epochs[(workload_index, "dispatch")],
+                combine_epochs=ai_epochs[(workload_index, "combine")],
+            )
             for node_id, local_spec in local_specs.items():
                 if local_spec["phases"]:
                     local_spec["enable_ai_replay"] = True
@@ -633,6 +727,12 @@ def build_arg_parser() -> argparse.ArgumentParser:
         help="Write the compiled global result to this path (default: stdout)",
     )
     parser.add_argument("--pretty", action="store_true", help="Pretty-print JSON output")
+    parser.add_argument(
+        "-j",
+        "--jobs",
+        type=int,
+        help="Threads scheduling AI phases with the native core (default: one per CPU)",
+    )
     return parser
 
 
@@ -640,7 +740,7 @@ def main(argv: List[str] | None = None) -> int:
     """CLI entry point."""
 
     args = build_arg_parser().parse_args(argv)
-    result = compile_global_spec(load_spec(args.input))
+    result = compile_global_spec(load_spec(args.input), jobs=args.jobs)
     text = json.dumps(result, indent=2 if args.pretty else None)
     if args.pretty:
         text += "\n"
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+/*
+ * Native core for the greedy OCS epoch schedule in sync_dcn_global_compile.py.
+ *
+ * A selected edge carries its whole remaining packet budget, so edge weights
+ * never change once the matrix is compiled.  The candidate list is therefore
+ * sorted once and every epoch is a single pass over the edges still
+ * unscheduled, which are kept on a linked list in sorted order.  The pass
+ * stops as soon as fewer than two nodes are free.  The result is identical
+ * to re-sorting and re-scanning the whole matrix for every epoch.
+ *
+ * Loaded from Python with ctypes; the call holds no interpreter state, so
+ * independent phases can be scheduled from several threads at once.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+struct match_edge
+{
+    int64_t weight;
+    int32_t src;
+    int32_t dst;
+    int32_t src_index;
+    int32_t dst_index;
+};
+
+static int edge_cmp(const void *a, const void *b)
+{
+    const struct match_edge *ea = a;
+    const struct match_edge *eb = b;
+
+    // heaviest first, then lowest source, then lowest destination node ID
+    if (ea->weight != eb->weight)
+        return ea->weight > eb->weight ? -1 : 1;
+    if (ea->src != eb->src)
+        return ea->src < eb->src ? -1 : 1;
+    if (ea->dst != eb->dst)
+        return ea->dst < eb->dst ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Schedule every positive off-diagonal entry of the n x n row-major weight
+ * matrix, where row and column k belong to node ID node_ids[k].  Edge k of
+ * the schedule goes from out_src[k] to out_dst[k] with out_weight[k] packets
+ * in epoch out_epoch[k]; edges are grouped by epoch and listed in selection
+ * order within one.  The output arrays need room for n * (n - 1) edges.
+ *
+ * Returns the number of scheduled edges, or -1 if memory could not be
+ * allocated.
+ */
+int sync_dcn_match_epochs(int n, const int32_t *node_ids, const int64_t *weights,
+        int32_t *out_src, int32_t *out_dst, int64_t *out_weight, int32_t *out_epoch)
+{
+    struct match_edge *edges;
+    int32_t *next;
+    uint64_t *used;
+    int32_t head;
+    int edge_count = 0;
+    int out_count = 0;
+    int epoch = 0;
+
+    if (n < 2)
+        return 0;
+
+    edges = malloc((size_t)n * (n - 1) * sizeof(*edges));
+    next = malloc(((size_t)n * (n - 1) + 1) * sizeof(*next));
+    used = calloc((n + 63) / 64, sizeof(*used));
+
+    if (!edges || !next || !used)
+    {
+        free(edges);
+        free(next);
+        free(used);
+        return -1;
+    }
+
+    for (int s = 0; s < n; s++)
+    {
+        for (int d = 0; d < n; d++)
+        {
+            int64_t w = weights[(size_t)s * n + d];
+
+            if (s == d || w <= 0)
+                continue;
+
+            edges[edge_count].weight = w;
+            edges[edge_count].src = node_ids[s];
+            edges[edge_count].dst = node_ids[d];
+            edges[edge_count].src_index = s;
+            edges[edge_count].dst_index = d;
+            edge_count++;
+        }
+    }
+
+    qsort(edges, edge_count, sizeof(*edges), edge_cmp);
+
+    // next[k] follows edge k, index edge_count terminates the list
+    for (int k = 0; k < edge_count; k++)
+        next[k] = k + 1;
+    head = 0;
+
+    while (head != edge_count)
+    {
+        int32_t *link = &head;
+        int free_nodes = n;
+
+        for (int k = 0; k < (n + 63) / 64; k++)
+            used[k] = 0;
+
+        while (*link != edge_count && free_nodes >= 2)
+        {
+            struct match_edge *e = &edges[*link];
+            uint64_t src_bit = 1ull << (e->src_index & 63);
+            uint64_t dst_bit = 1ull << (e->dst_index & 63);
+
+            if ((used[e->src_index >> 6] & src_bit) || (used[e->dst_index >> 6] & dst_bit))
+            {
+                link = &next[*link];
+                continue;
+            }
+
+            used[e->src_index >> 6] |= src_bit;
+            used[e->dst_index >> 6] |= dst_bit;
+            free_nodes -= 2;
+
+            out_src[out_count] = e->src;
+            out_dst[out_count] = e->dst;
+            out_weight[out_count] = e->weight;
+            out_epoch[out_count] = epoch;
+            out_count++;
+
+            // scheduled edges are done for good
+            *link = next[*link];
+        }
+
+        epoch++;
+    }
+
+    free(edges);
+    free(next);
+    free(used);
+
+    return out_count;
+}
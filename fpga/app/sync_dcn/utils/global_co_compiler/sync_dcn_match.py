@@ -0,0 +1,139 @@
+"""Greedy OCS epoch scheduling for the Sync-DCN global co-compiler.
+
+Every epoch is the greedy matching that ``greedy_matching`` in
+``sync_dcn_global_compile`` would pick from the remaining matrix.  Because a
+selected edge always drains its whole budget, edge weights never change, so
+the candidates are sorted once and each epoch is one pass over the edges that
+are still unscheduled.
+
+The same algorithm is available as a native library built from
+``sync_dcn_match.c`` (``make`` in this directory).  It is used automatically
+when present unless ``SYNC_DCN_NATIVE=0`` is set in the environment, and it
+releases the GIL, so several phases can be scheduled on separate cores.
+"""
+
+from __future__ import annotations
+
+import ctypes
+import os
+from pathlib import Path
+from typing import List, Optional, Tuple
+
+Matching = List[Tuple[int, int, int]]
+
+NATIVE_LIBRARY_PATH = Path(__file__).resolve().with_name("libsync_dcn_match.so")
+
+_native = None
+_native_loaded = False
+
+
+def load_native_core() -> Optional[ctypes.CDLL]:
+    """Return the native scheduling core, or None if it is unavailable."""
+
+    global _native, _native_loaded
+
+    if _native_loaded:
+        return _native
+    _native_loaded = True
+
+    if os.environ.get("SYNC_DCN_NATIVE", "1") == "0" or not NATIVE_LIBRARY_PATH.exists():
+        return None
+
+    try:
+        lib = ctypes.CDLL(str(NATIVE_LIBRARY_PATH))
+    except OSError:
+        return None
+
+    lib.sync_dcn_match_epochs.restype = ctypes.c_int
+    lib.sync_dcn_match_epochs.argtypes = [
+        ctypes.c_int,
+        ctypes.POINTER(ctypes.c_int32),
+        ctypes.POINTER(ctypes.c_int64),
+        ctypes.POINTER(ctypes.c_int32),
+        ctypes.POINTER(ctypes.c_int32),
+        ctypes.POINTER(ctypes.c_int64),
+        ctypes.POINTER(ctypes.c_int32),
+    ]
+    _native = lib
+    return _native
+
+
+def unique_nodes(active_nodes: List[int]) -> List[int]:
+    """Drop repeated node IDs, which cannot add edges to a matching."""
+
+    return list(dict.fromkeys(active_nodes))
+
+
+def schedule_epochs_python(remaining: List[List[int]], active_nodes: List[int]) -> List[Matching]:
+    """Pure Python epoch schedule, one (src, dst, packets) list per epoch."""
+
+    nodes = unique_nodes(active_nodes)
+    pending = sorted(
+        (
+            (remaining[src][dst], src, dst)
+            for src in nodes
+            for dst in nodes
+            if src != dst and remaining[src][dst] > 0
+        ),
+        key=lambda item: (-item[0], item[1], item[2]),
+    )
+
+    epochs: List[Matching] = []
+    while pending:
+        used_nodes = set()
+        matching: Matching = []
+        deferred = []
+        free_nodes = len(nodes)
+
+        for index, (weight, src, dst) in enumerate(pending):
+            if free_nodes < 2:
+                deferred.extend(pending[index:])
+                break
+            if src in used_nodes or dst in used_nodes:
+                deferred.append((weight, src, dst))
+                continue
+            matching.append((src, dst, weight))
+            used_nodes.add(src)
+            used_nodes.add(dst)
+            free_nodes -= 2
+
+        epochs.append(matching)
+        pending = deferred
+
+    return epochs
+
+
+def schedule_epochs_native(lib: ctypes.CDLL, remaining: List[List[int]], active_nodes: List[int]) -> List[Matching]:
+    """Epoch schedule computed by the native core."""
+
+    nodes = unique_nodes(active_nodes)
+    n = len(nodes)
+    if n < 2:
+        return []
+
+    capacity = n * (n - 1)
+    node_ids = (ctypes.c_int32 * n)(*nodes)
+    weights = (ctypes.c_int64 * (n * n))(*(remaining[src][dst] for src in nodes for dst in nodes))
+    out_src = (ctypes.c_int32 * capacity)()
+    out_dst = (ctypes.c_int32 * capacity)()
+    out_weight = (ctypes.c_int64 * capacity)()
+    out_epoch = (ctypes.c_int32 * capacity)()
+
+    edge_count = lib.sync_dcn_match_epochs(n, node_ids, weights, out_src, out_dst, out_weight, out_epoch)
+    if edge_count < 0:
+        raise MemoryError("native schedule core failed to allocate its working set")
+
+    epochs: List[Matching] = [[] for _ in range(out_epoch[edge_count - 1] + 1 if edge_count else 0)]
+    for index in range(edge_count):
+        epochs[out_epoch[index]].append((out_src[index], out_dst[index], out_weight[index]))
+
+    return epochs
+
+
+def schedule_epochs(remaining: List[List[int]], active_nodes: List[int]) -> List[Matching]:
+    """Schedule the whole matrix into greedy matching epochs."""
+
+    lib = load_native_core()
+    if lib is None:
+        return schedule_epochs_python(remaining, active_nodes)
+    return schedule_epochs_native(lib, remaining, active_nodes)
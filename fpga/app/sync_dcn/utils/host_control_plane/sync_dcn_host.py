@@ -10,17 +10,25 @@ shared by:
 
 The helper does not depend on a specific device-access backend.  Instead, the
 caller provides `read32` and `write32` callables that implement 32-bit MMIO
-access to the Sync-DCN AXI-Lite register space.
+access to the Sync-DCN AXI-Lite register space.  An optional `write_block`
+callable lets a backend load whole table images in one call (for example a
+single mmap slice copy or the mqnic driver's bulk register write).
+
+`SyncDcnHost` remembers what it last wrote to every table and bank.  Table
+image writes with `delta=True` compare against that shadow and only write the
+entries that changed, so a schedule update costs time in proportion to the
+size of the change rather than the size of the schedule.
 """
 
 from __future__ import annotations
 
 from dataclasses import dataclass
-from typing import Callable, Iterable, List
+from typing import Callable, Dict, Iterable, List, Optional, Sequence, Tuple
 
 
 Read32Fn = Callable[[int], int]
 Write32Fn = Callable[[int, int], None]
+WriteBlockFn = Callable[[int, Sequence[int]], None]
 
 
 class SyncDcnAppId:
@@ -200,11 +208,26 @@ class SyncDcnHost:
     The wrapper deliberately stays thin: it performs only deterministic word
     packing and register sequencing.  Policy, schedule compilation, and device
     discovery remain outside this module.
+
+    The table shadow only knows about writes made through this object.  Call
+    `invalidate_table_shadow` if anything else may have written the tables
+    (another process, a soft reset), or `load_table_shadow` to rebuild it from
+    a hardware read-back.
     """
 
-    def __init__(self, read32: Read32Fn, write32: Write32Fn):
+    def __init__(
+        self,
+        read32: Read32Fn,
+        write32: Write32Fn,
+        write_block: Optional[WriteBlockFn] = None,
+    ):
         self._read32 = read32
         self._write32 = write32
+        self._write_block = write_block
+        self._admin_bank: Optional[int] = None
+        # (table base, bank) -> {entry index: padded entry words}; the AI
+        # trace table is unbanked and always uses bank 0
+        self._shadow: Dict[Tuple[int, int], Dict[int, Tuple[int, ...]]] = {}
 
     def read32(self, addr: int) -> int:
         """Read one 32-bit register or table word from the subsystem."""
@@ -223,6 +246,15 @@ class SyncDcnHost:
         hi = self.read32(addr_hi)
         return lo | (hi << 32)
 
+    def write_block(self, addr: int, words: Sequence[int]) -> None:
+        """Write consecutive 32-bit words starting at `addr`."""
+
+        if self._write_block is None:
+            for word_index, word in enumerate(words):
+                self.write32(addr + word_index * 4, word)
+            return
+        self._write_block(addr, [word & 0xFFFFFFFF for word in words])
+
     def write64(self, addr_lo: int, addr_hi: int, value: int) -> None:
         """Write a little-endian 64-bit value exposed as two 32-bit registers."""
 
@@ -234,6 +266,7 @@ class SyncDcnHost:
         """Select which execution-table bank subsequent table writes target."""
 
         self.write32(SyncDcnRegister.ADMIN, bank & 0x1)
+        self._admin_bank = bank & 0x1
 
     def arm_bank_switch(self, bank: int, activate_time_ns: int) -> None:
         """Request a future hitless switch to the selected execution bank."""
@@ -244,6 +277,7 @@ class SyncDcnHost:
             activate_time_ns,
         )
         self.write32(SyncDcnRegister.ADMIN, (bank & 0x1) | 0x2)
+        self._admin_bank = bank & 0x1
 
     def enable_subsystem(self, enable: bool = True) -> None:
         """Enable or disable the top-level Sync-DCN subsystem."""
@@ -276,11 +310,16 @@ class SyncDcnHost:
             )
         self._write_table_words(TX_EXEC_TABLE_BASE, index, entry.encode_words())
 
-    def write_tx_exec_entries(self, entries: Iterable[ExecutionEntry]) -> None:
-        """Write a sequence of TX execution entries starting at entry index 0."""
+    def write_tx_exec_entries(self, entries: Iterable[ExecutionEntry], delta: bool = False) -> int:
+        """Write a sequence of TX execution entries starting at entry index 0.
 
-        for index, entry in enumerate(entries):
-            self.write_tx_exec_entry(index, entry)
+        With `delta`, entries the admin bank already holds are skipped.
+        Returns the number of entries written.
+        """
+
+        return self._write_table_image(
+            TX_EXEC_TABLE_BASE, TX_EXEC_VISIBLE_ENTRY_COUNT, "TX execution", entries, delta
+        )
 
     def write_rx_exec_entry(self, index: int, entry: ExecutionEntry) -> None:
         """Write one RX execution-table entry into the currently selected bank."""
@@ -292,21 +331,26 @@ class SyncDcnHost:
             )
         self._write_table_words(RX_EXEC_TABLE_BASE, index, entry.encode_words())
 
-    def write_rx_exec_entries(self, entries: Iterable[ExecutionEntry]) -> None:
-        """Write a sequence of RX execution entries starting at entry index 0."""
+    def write_rx_exec_entries(self, entries: Iterable[ExecutionEntry], delta: bool = False) -> int:
+        """Write a sequence of RX execution entries starting at entry index 0.
 
-        for index, entry in enumerate(entries):
-            self.write_rx_exec_entry(index, entry)
+        With `delta`, entries the admin bank already holds are skipped.
+        Returns the number of entries written.
+        """
+
+        return self._write_table_image(
+            RX_EXEC_TABLE_BASE, RX_EXEC_VISIBLE_ENTRY_COUNT, "RX execution", entries, delta
+        )
 
     def write_exec_entry(self, index: int, entry: ExecutionEntry) -> None:
         """Backward-compatible alias for programming the TX execution table."""
 
         self.write_tx_exec_entry(index, entry)
 
-    def write_exec_entries(self, entries: Iterable[ExecutionEntry]) -> None:
+    def write_exec_entries(self, entries: Iterable[ExecutionEntry], delta: bool = False) -> int:
         """Backward-compatible alias for programming TX execution entries."""
 
-        self.write_tx_exec_entries(entries)
+        return self.write_tx_exec_entries(entries, delta)
 
     def write_ai_trace_entry(self, index: int, entry: AiTraceEntry) -> None:
         """Write one AI trace record into the local AI trace table."""
@@ -318,11 +362,17 @@ class SyncDcnHost:
             )
         self._write_table_words(AI_TRACE_TABLE_BASE, index, entry.encode_words())
 
-    def write_ai_trace_entries(self, entries: Iterable[AiTraceEntry]) -> None:
-        """Write a sequence of AI trace records starting at entry index 0."""
+    def write_ai_trace_entries(self, entries: Iterable[AiTraceEntry], delta: bool = False) -> int:
+        """Write a sequence of AI trace records starting at entry index 0.
 
-        for index, entry in enumerate(entries):
-            self.write_ai_trace_entry(index, entry)
+        With `delta`, records the table already holds are skipped.  The AI
+        trace table is not banked, so changed records take effect as soon as
+        they are written.  Returns the number of entries written.
+        """
+
+        return self._write_table_image(
+            AI_TRACE_TABLE_BASE, AI_TRACE_VISIBLE_ENTRY_COUNT, "AI trace", entries, delta
+        )
 
     def read_exec_status(self) -> dict[str, int]:
         """Read the top-level executor/bank status in a decoded form."""
@@ -450,31 +500,154 @@ class SyncDcnHost:
         entries: Iterable[ExecutionEntry],
         activate_time_ns: int,
         enable_subsystem: bool = True,
-    ) -> None:
+        *,
+        rx_entries: Optional[Iterable[ExecutionEntry]] = None,
+        ai_entries: Optional[Iterable[AiTraceEntry]] = None,
+        delta: bool = False,
+    ) -> int:
         """Convenience flow for a complete schedule-bank update.
 
         This method mirrors the intended programming sequence:
 
         1. select the inactive bank
-        2. write the local execution table image
+        2. write the local execution table images
         3. program the future activation time
         4. arm the bank switch
         5. optionally enable the subsystem
+
+        With `delta`, only entries that differ from what this host last wrote
+        to `bank` are written.  The switch of the execution tables stays
+        atomic: the bank being updated is not executing, and the executor only
+        moves to it when the armed switch fires.  Returns the number of
+        entries written.
+
+        The AI trace table has no banks, so `ai_entries` are written straight
+        into the live table.  They are only accepted while the subsystem is
+        disabled or AI replay is off, so the executing schedule never replays
+        them early; otherwise ValueError is raised before anything is written.
         """
 
+        if ai_entries is not None:
+            ai_enabled = self.read32(SyncDcnRegister.AI_ENABLE) & 0x1
+            if self.read_exec_status()["exec_enable"] and ai_enabled:
+                raise ValueError(
+                    "AI trace entries can only be written while the subsystem "
+                    "is disabled or AI replay is off"
+                )
+
+        written = 0
+        if ai_entries is not None:
+            written += self.write_ai_trace_entries(ai_entries, delta)
         self.set_admin_bank(bank)
-        self.write_exec_entries(entries)
+        written += self.write_tx_exec_entries(entries, delta)
+        if rx_entries is not None:
+            written += self.write_rx_exec_entries(rx_entries, delta)
         self.arm_bank_switch(bank, activate_time_ns)
         if enable_subsystem:
             self.enable_subsystem(True)
+        return written
 
-    def _write_table_words(self, base: int, index: int, words: Iterable[int]) -> None:
+    def invalidate_table_shadow(self) -> None:
+        """Forget what the tables hold; the next delta writes are full writes."""
+
+        self._shadow.clear()
+        self._admin_bank = None
+
+    def load_table_shadow(self, bank: int, tx_count: int = 0, rx_count: int = 0, ai_count: int = 0) -> None:
+        """Read back the first entries of each table of `bank` into the shadow.
+
+        Register reads are much slower than posted writes, so this only pays
+        off when a fresh host object is about to make many small updates to
+        tables something else loaded.  Leaves `bank` selected as admin bank.
+        """
+
+        words_per_entry = ENTRY_STRIDE_BYTES // 4
+
+        self.set_admin_bank(bank)
+        for base, count in (
+            (TX_EXEC_TABLE_BASE, tx_count),
+            (RX_EXEC_TABLE_BASE, rx_count),
+            (AI_TRACE_TABLE_BASE, ai_count),
+        ):
+            shadow = self._shadow.setdefault(self._shadow_key(base), {})
+            for index in range(count):
+                addr = base + index * ENTRY_STRIDE_BYTES
+                shadow[index] = tuple(self.read32(addr + word * 4) for word in range(words_per_entry))
+
+    def _shadow_key(self, base: int) -> Tuple[int, int]:
+        """Shadow key for a table in the bank host writes currently go to."""
+
+        if base == AI_TRACE_TABLE_BASE:
+            return base, 0
+        if self._admin_bank is None:
+            self._admin_bank = self.read32(SyncDcnRegister.ADMIN) & 0x1
+        return base, self._admin_bank
+
+    def _write_table_image(
+        self,
+        base: int,
+        capacity: int,
+        name: str,
+        entries: Iterable[ExecutionEntry] | Iterable[AiTraceEntry],
+        delta: bool = False,
+    ) -> int:
+        """Write entries starting at index 0 as one contiguous table image.
+
+        With `delta`, only runs of entries that differ from the shadow are
+        written, each run as one block.  Without a block backend this falls
+        back to per-entry word writes so reserved words past each record are
+        left untouched.
+        """
+
+        entries = list(entries)
+        if len(entries) > capacity:
+            raise ValueError(
+                f"{name} table image of {len(entries)} entries exceeds visible "
+                f"table capacity ({capacity})"
+            )
+
+        words_per_entry = ENTRY_STRIDE_BYTES // 4
+        encoded = [entry.encode_words() for entry in entries]
+        padded = [tuple(words) + (0,) * (words_per_entry - len(words)) for words in encoded]
+
+        shadow = self._shadow.setdefault(self._shadow_key(base), {})
+
+        # runs of [start, end) entries to write
+        runs: List[Tuple[int, int]] = []
+        for index, words in enumerate(padded):
+            if delta and shadow.get(index) == words:
+                continue
+            if runs and runs[-1][1] == index:
+                runs[-1] = (runs[-1][0], index + 1)
+            else:
+                runs.append((index, index + 1))
+
+        for start, end in runs:
+            if self._write_block is None:
+                for index in range(start, end):
+                    self._write_table_words(base, index, encoded[index])
+            else:
+                image: List[int] = []
+                for words in padded[start:end]:
+                    image.extend(words)
+                self.write_block(base + start * ENTRY_STRIDE_BYTES, image)
+
+            for index in range(start, end):
+                shadow[index] = padded[index]
+
+        return sum(end - start for start, end in runs)
+
+    def _write_table_words(self, base: int, index: int, words: Sequence[int]) -> None:
         """Write one table entry using the common 32-byte-per-entry ABI."""
 
         for word_index, word in enumerate(words):
             addr = base + index * ENTRY_STRIDE_BYTES + word_index * 4
             self.write32(addr, word)
 
+        words_per_entry = ENTRY_STRIDE_BYTES // 4
+        shadow = self._shadow.setdefault(self._shadow_key(base), {})
+        shadow[index] = tuple(words) + (0,) * (words_per_entry - len(words))
+
 
 __all__ = [
     "AI_TRACE_TABLE_BASE",
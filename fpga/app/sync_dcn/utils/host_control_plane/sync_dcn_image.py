@@ -0,0 +1,270 @@
+"""Binary table images for the Sync-DCN subsystem.
+
+A table image is the compact counterpart of the low-level JSON artifacts:
+a small header and section table followed by the TX execution, RX execution,
+and AI trace tables already encoded in the exact 32-byte-per-entry layout of
+`mqnic_app_block_sync_dcn.v`.  Loading one takes no parsing or word encoding;
+the file is mapped and every section is copied into its table as is, either
+as one slice store into a BAR mapping or handed directly to the
+`SYNC_DCN_IOCTL_LOAD_TABLE` ioctl of the mqnic_app_sync_dcn driver.
+
+The layout is defined by `struct sync_dcn_image_header` and
+`struct sync_dcn_image_section` in
+`modules/mqnic_app_sync_dcn/mqnic_app_sync_dcn_ioctl.h`; keep both in sync.
+"""
+
+from __future__ import annotations
+
+import ctypes
+import mmap
+import struct
+from dataclasses import dataclass
+from pathlib import Path
+from typing import List, Sequence
+
+from host_control_plane.sync_dcn_host import (
+    AI_TRACE_TABLE_BASE,
+    AI_TRACE_VISIBLE_ENTRY_COUNT,
+    ENTRY_STRIDE_BYTES,
+    RX_EXEC_TABLE_BASE,
+    RX_EXEC_VISIBLE_ENTRY_COUNT,
+    TX_EXEC_TABLE_BASE,
+    TX_EXEC_VISIBLE_ENTRY_COUNT,
+    AiTraceEntry,
+    ExecutionEntry,
+)
+
+
+IMAGE_MAGIC = b"SDCNIMG\0"
+IMAGE_VERSION = 1
+IMAGE_ALIGN = 64
+
+IMAGE_FLAG_ARM = 0x1
+IMAGE_FLAG_ENABLE = 0x2
+IMAGE_FLAG_AI_REPLAY = 0x4
+
+# struct sync_dcn_image_header / struct sync_dcn_image_section
+HEADER_STRUCT = struct.Struct("<8sIIIIQII")
+SECTION_STRUCT = struct.Struct("<IIQ")
+
+
+class SyncDcnTable:
+    """Table ids shared with the driver's SYNC_DCN_TABLE_* values."""
+
+    TX_EXEC = 0
+    RX_EXEC = 1
+    AI_TRACE = 2
+
+
+# table id -> (BAR offset, visible entry count)
+TABLE_LAYOUT = {
+    SyncDcnTable.TX_EXEC: (TX_EXEC_TABLE_BASE, TX_EXEC_VISIBLE_ENTRY_COUNT),
+    SyncDcnTable.RX_EXEC: (RX_EXEC_TABLE_BASE, RX_EXEC_VISIBLE_ENTRY_COUNT),
+    SyncDcnTable.AI_TRACE: (AI_TRACE_TABLE_BASE, AI_TRACE_VISIBLE_ENTRY_COUNT),
+}
+
+TABLE_NAMES = {
+    SyncDcnTable.TX_EXEC: "TX execution",
+    SyncDcnTable.RX_EXEC: "RX execution",
+    SyncDcnTable.AI_TRACE: "AI trace",
+}
+
+
+def _align(value: int) -> int:
+    return (value + IMAGE_ALIGN - 1) & ~(IMAGE_ALIGN - 1)
+
+
+def encode_table(entries: Sequence[ExecutionEntry] | Sequence[AiTraceEntry]) -> bytes:
+    """Encode entries into one padded 32-byte-per-entry table image."""
+
+    words_per_entry = ENTRY_STRIDE_BYTES // 4
+    words: List[int] = []
+    for entry in entries:
+        encoded = entry.encode_words()
+        words.extend(encoded)
+        words.extend([0] * (words_per_entry - len(encoded)))
+    return struct.pack(f"<{len(words)}I", *words)
+
+
+def encode_image(
+    *,
+    admin_bank: int,
+    activate_time_ns: int,
+    flags: int,
+    tx_execution_entries: Sequence[ExecutionEntry],
+    rx_execution_entries: Sequence[ExecutionEntry],
+    ai_entries: Sequence[AiTraceEntry],
+) -> bytes:
+    """Build a complete table image; empty tables get no section."""
+
+    tables = [
+        (SyncDcnTable.TX_EXEC, tx_execution_entries),
+        (SyncDcnTable.RX_EXEC, rx_execution_entries),
+        (SyncDcnTable.AI_TRACE, ai_entries),
+    ]
+    tables = [(table, entries) for table, entries in tables if entries]
+
+    for table, entries in tables:
+        capacity = TABLE_LAYOUT[table][1]
+        if len(entries) > capacity:
+            raise ValueError(
+                f"{TABLE_NAMES[table]} table image of {len(entries)} entries exceeds "
+                f"visible table capacity ({capacity})"
+            )
+
+    header_len = HEADER_STRUCT.size + SECTION_STRUCT.size * len(tables)
+    header = HEADER_STRUCT.pack(
+        IMAGE_MAGIC,
+        IMAGE_VERSION,
+        header_len,
+        flags,
+        admin_bank & 0x1,
+        activate_time_ns,
+        len(tables),
+        0,
+    )
+
+    sections = b""
+    body = b""
+    offset = _align(header_len)
+    for table, entries in tables:
+        data = encode_table(entries)
+        sections += SECTION_STRUCT.pack(table, len(entries), offset)
+        body += data + b"\0" * (_align(len(data)) - len(data))
+        offset += _align(len(data))
+
+    prefix = header + sections
+    return prefix + b"\0" * (_align(header_len) - len(prefix)) + body
+
+
+def is_image(path: Path) -> bool:
+    """Return True if path starts with the table image magic."""
+
+    with open(path, "rb") as f:
+        return f.read(len(IMAGE_MAGIC)) == IMAGE_MAGIC
+
+
+@dataclass(frozen=True)
+class ImageSection:
+    """One table section of a mapped image."""
+
+    table: int
+    count: int
+    offset: int
+
+    @property
+    def length(self) -> int:
+        return self.count * ENTRY_STRIDE_BYTES
+
+    @property
+    def bar_offset(self) -> int:
+        return TABLE_LAYOUT[self.table][0]
+
+
+class TableImage:
+    """A table image mapped from disk; sections are views into the mapping.
+
+    The mapping is private and copy-on-write so that section buffers can be
+    passed to ioctl() by address without ever being copied in user space.
+    """
+
+    def __init__(self, path: Path | None = None, *, data: bytes | None = None):
+        if data is not None:
+            # an image built in memory gets an anonymous mapping of its own
+            self._mmap = mmap.mmap(-1, len(data))
+            self._mmap[:] = data
+        else:
+            with open(path, "rb") as f:
+                self._mmap = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_COPY)
+
+        try:
+            self._parse_header()
+        except Exception:
+            self._mmap.close()
+            raise
+
+    def _parse_header(self) -> None:
+        if len(self._mmap) < HEADER_STRUCT.size:
+            raise ValueError("table image is truncated")
+
+        (
+            magic,
+            version,
+            header_len,
+            self.flags,
+            self.admin_bank,
+            self.activate_time_ns,
+            section_count,
+            _,
+        ) = HEADER_STRUCT.unpack_from(self._mmap, 0)
+
+        if magic != IMAGE_MAGIC:
+            raise ValueError("not a Sync-DCN table image")
+        if version != IMAGE_VERSION:
+            raise ValueError(f"unsupported table image version {version}")
+        if header_len < HEADER_STRUCT.size + SECTION_STRUCT.size * section_count:
+            raise ValueError("table image header is inconsistent")
+
+        self.sections: List[ImageSection] = []
+        for index in range(section_count):
+            table, count, offset = SECTION_STRUCT.unpack_from(
+                self._mmap, HEADER_STRUCT.size + index * SECTION_STRUCT.size
+            )
+            if table not in TABLE_LAYOUT:
+                raise ValueError(f"table image section {index} has unknown table {table}")
+            if count > TABLE_LAYOUT[table][1]:
+                raise ValueError(
+                    f"{TABLE_NAMES[table]} section of {count} entries exceeds visible "
+                    f"table capacity ({TABLE_LAYOUT[table][1]})"
+                )
+            section = ImageSection(table, count, offset)
+            if offset + section.length > len(self._mmap):
+                raise ValueError(f"table image section {index} is truncated")
+            self.sections.append(section)
+
+    def close(self) -> None:
+        self._mmap.close()
+
+    def __enter__(self) -> "TableImage":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def section(self, table: int) -> ImageSection | None:
+        """Return the section for one table, or None if the image has none."""
+
+        for section in self.sections:
+            if section.table == table:
+                return section
+        return None
+
+    def data(self, section: ImageSection) -> memoryview:
+        """Zero-copy view of one section's table image."""
+
+        return memoryview(self._mmap)[section.offset : section.offset + section.length]
+
+    def address(self, section: ImageSection) -> int:
+        """User-space address of one section, for passing to ioctl()."""
+
+        anchor = ctypes.c_char.from_buffer(self._mmap, section.offset)
+        address = ctypes.addressof(anchor)
+        del anchor
+        return address
+
+    def entry_count(self, table: int) -> int:
+        section = self.section(table)
+        return section.count if section else 0
+
+
+__all__ = [
+    "IMAGE_FLAG_AI_REPLAY",
+    "IMAGE_FLAG_ARM",
+    "IMAGE_FLAG_ENABLE",
+    "ImageSection",
+    "SyncDcnTable",
+    "TableImage",
+    "encode_image",
+    "encode_table",
+    "is_image",
+]
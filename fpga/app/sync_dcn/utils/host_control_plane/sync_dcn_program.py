@@ -12,13 +12,18 @@ Usage modes:
 
 - `--dry-run`: validate and print the writes without touching hardware
 - `--resource PATH`: mmap a resource/BAR file and program the subsystem
+- `--device PATH`: load through the mqnic_app_sync_dcn driver instead
 
 JSON is always supported.  YAML is supported when `PyYAML` is available.
+Binary table images (see `sync_dcn_image.py`) are recognised by their magic
+and loaded without parsing: every table is copied from the mapped file in
+one piece.
 """
 
 from __future__ import annotations
 
 import argparse
+import fcntl
 import json
 import mmap
 import os
@@ -44,6 +49,15 @@ from host_control_plane.sync_dcn_host import (
     SyncDcnPlaneId,
     TX_EXEC_VISIBLE_ENTRY_COUNT,
 )
+from host_control_plane.sync_dcn_image import (
+    IMAGE_FLAG_AI_REPLAY,
+    IMAGE_FLAG_ARM,
+    IMAGE_FLAG_ENABLE,
+    SyncDcnTable,
+    TableImage,
+    encode_image,
+    is_image,
+)
 
 try:
     import yaml  # type: ignore
@@ -117,6 +131,9 @@ class DryRunBackend:
         self.regs[addr] = value & 0xFFFFFFFF
         print(f"WRITE 0x{addr:04X} = 0x{value & 0xFFFFFFFF:08X}")
 
+    def write_bytes(self, addr: int, data: memoryview) -> None:
+        print(f"COPY  0x{addr:04X} <- {len(data)} bytes")
+
 
 class MmapBackend:
     """Minimal little-endian BAR/resource mapper for MMIO register access."""
@@ -136,6 +153,55 @@ class MmapBackend:
     def write32(self, addr: int, value: int) -> None:
         struct.pack_into("<I", self._mmap, addr, value & 0xFFFFFFFF)
 
+    def write_block(self, addr: int, words: List[int]) -> None:
+        # pack once and copy the whole image into the BAR in a single slice store
+        data = struct.pack(f"<{len(words)}I", *words)
+        self._mmap[addr : addr + len(data)] = data
+
+    def write_bytes(self, addr: int, data: memoryview) -> None:
+        # table image sections are already in hardware layout
+        self._mmap[addr : addr + len(data)] = data
+
+
+SYNC_DCN_IOCTL_TYPE = 0x89
+SYNC_DCN_IOCTL_BASE = 0xC0
+SYNC_DCN_IOCTL_API_VERSION = 1
+SYNC_DCN_IOCTL_GET_API_VERSION = (SYNC_DCN_IOCTL_TYPE << 8) | (SYNC_DCN_IOCTL_BASE + 0)
+SYNC_DCN_IOCTL_LOAD_TABLE = (SYNC_DCN_IOCTL_TYPE << 8) | (SYNC_DCN_IOCTL_BASE + 1)
+SYNC_DCN_IOCTL_ARM_SWITCH = (SYNC_DCN_IOCTL_TYPE << 8) | (SYNC_DCN_IOCTL_BASE + 2)
+SYNC_DCN_LOAD_FLAG_AI_ENABLE = 0x1
+SYNC_DCN_ARM_FLAG_ENABLE = 0x1
+
+# struct sync_dcn_ioctl_load_table / struct sync_dcn_ioctl_arm
+LOAD_TABLE_STRUCT = struct.Struct("<IIIIIIQ")
+ARM_STRUCT = struct.Struct("<IIIIQQQ")
+
+
+class DriverBackend:
+    """Table loads and switch arming through /dev/<mqnic>_sync_dcn."""
+
+    def __init__(self, path: Path):
+        self._fd = os.open(path, os.O_RDWR)
+        version = fcntl.ioctl(self._fd, SYNC_DCN_IOCTL_GET_API_VERSION)
+        if version < SYNC_DCN_IOCTL_API_VERSION:
+            os.close(self._fd)
+            raise RuntimeError(f"{path}: driver API version {version} is too old")
+
+    def close(self) -> None:
+        os.close(self._fd)
+
+    def load_table(self, bank: int, table: int, count: int, address: int, flags: int = 0) -> None:
+        arg = bytearray(LOAD_TABLE_STRUCT.pack(LOAD_TABLE_STRUCT.size, flags, bank, table, count, 0, address))
+        fcntl.ioctl(self._fd, SYNC_DCN_IOCTL_LOAD_TABLE, arg)
+
+    def arm(self, bank: int, activate_time_ns: int, enable: bool) -> int:
+        """Arm a bank switch and return the PHC time the driver saw."""
+
+        flags = SYNC_DCN_ARM_FLAG_ENABLE if enable else 0
+        arg = bytearray(ARM_STRUCT.pack(ARM_STRUCT.size, flags, bank, 0, activate_time_ns, 0, 0))
+        fcntl.ioctl(self._fd, SYNC_DCN_IOCTL_ARM_SWITCH, arg)
+        return ARM_STRUCT.unpack(arg)[6]
+
 
 def parse_int(value: Any) -> int:
     """Parse an integer from either a numeric or string field."""
@@ -315,6 +381,66 @@ def split_execution_entries_for_hw(
     return tx_entries, rx_entries
 
 
+def normalize_target_type(raw: Dict[str, Any]) -> str:
+    """Return the artifact target type, mapping the historical prototype name."""
+
+    target_type = str(raw.get("target_type", "prototype_fpga_runtime")).strip().lower()
+    if target_type == "prototype_fpga_runtime":
+        # Older compatibility artifacts still use the historical target name.
+        # Normalize it so guardrails and programming behavior stay consistent.
+        target_type = "prototype_runtime"
+    return target_type
+
+
+def resolve_execution_tables(raw: Dict[str, Any]) -> tuple[List[ExecutionEntry], List[ExecutionEntry]]:
+    """Return the TX and RX hardware tables of a NIC or merged artifact."""
+
+    if "tx_execution_entries" in raw or "rx_execution_entries" in raw:
+        raw_tx_entries = list(raw.get("tx_execution_entries", []))
+        raw_rx_entries = list(raw.get("rx_execution_entries", []))
+    else:
+        raw_tx_entries, raw_rx_entries = split_execution_entries_for_hw(raw.get("execution_entries", []))
+
+    return build_execution_entries(raw_tx_entries), build_execution_entries(raw_rx_entries)
+
+
+def build_artifact_image(raw: Dict[str, Any]) -> bytes:
+    """Encode a processor, NIC, or prototype artifact as a binary table image."""
+
+    target_type = normalize_target_type(raw)
+    ai_entries = build_ai_trace_entries(raw.get("ai_trace_entries", []))
+
+    if target_type == "processor":
+        return encode_image(
+            admin_bank=0,
+            activate_time_ns=0,
+            flags=IMAGE_FLAG_AI_REPLAY if ai_entries else 0,
+            tx_execution_entries=[],
+            rx_execution_entries=[],
+            ai_entries=ai_entries,
+        )
+
+    if target_type == "fabric":
+        raise ValueError("fabric artifacts have no NIC table image")
+
+    tx_execution_entries, rx_execution_entries = resolve_execution_tables(raw)
+
+    flags = IMAGE_FLAG_ARM
+    if bool(raw.get("enable_subsystem", True)):
+        flags |= IMAGE_FLAG_ENABLE
+    if target_type != "nic" and bool(raw.get("enable_ai_replay", False)):
+        flags |= IMAGE_FLAG_AI_REPLAY
+
+    return encode_image(
+        admin_bank=parse_int(raw.get("admin_bank", 1)),
+        activate_time_ns=parse_int(raw.get("activate_time_ns", 0)),
+        flags=flags,
+        tx_execution_entries=tx_execution_entries,
+        rx_execution_entries=rx_execution_entries,
+        ai_entries=[] if target_type == "nic" else ai_entries,
+    )
+
+
 def build_ai_trace_entries(raw_entries: Iterable[Dict[str, Any]]) -> List[AiTraceEntry]:
     """Convert parsed schedule objects into strongly-typed AI trace records."""
 
@@ -441,6 +567,72 @@ def program_processor_artifact(
         host.enable_ai_replay(True)
 
 
+def print_image_summary(image: TableImage) -> None:
+    """Print a concise summary for one binary table image."""
+
+    print("Sync-DCN table image summary")
+    print(f"  admin_bank       : {image.admin_bank}")
+    print(f"  activate_time_ns : {image.activate_time_ns}")
+    print(f"  tx_exec_entries  : {image.entry_count(SyncDcnTable.TX_EXEC)}")
+    print(f"  rx_exec_entries  : {image.entry_count(SyncDcnTable.RX_EXEC)}")
+    print(f"  ai_trace_entries : {image.entry_count(SyncDcnTable.AI_TRACE)}")
+    print(f"  arm_bank_switch  : {bool(image.flags & IMAGE_FLAG_ARM)}")
+    print(f"  enable_ai_replay : {bool(image.flags & IMAGE_FLAG_AI_REPLAY)}")
+    print(f"  enable_subsystem : {bool(image.flags & IMAGE_FLAG_ENABLE)}")
+
+
+def program_image(host: SyncDcnHost, write_bytes, image: TableImage) -> None:
+    """Apply the standard programming sequence from a mapped table image.
+
+    Same order as program_device, but every table is one bulk copy of the
+    mapped section into the BAR.
+    """
+
+    ai = image.section(SyncDcnTable.AI_TRACE)
+    if ai is not None:
+        with image.data(ai) as data:
+            write_bytes(ai.bar_offset, data)
+
+    if image.flags & IMAGE_FLAG_AI_REPLAY:
+        host.enable_ai_replay(True)
+
+    if not image.flags & IMAGE_FLAG_ARM:
+        return
+
+    host.set_admin_bank(image.admin_bank)
+
+    for table in (SyncDcnTable.TX_EXEC, SyncDcnTable.RX_EXEC):
+        section = image.section(table)
+        if section is not None:
+            with image.data(section) as data:
+                write_bytes(section.bar_offset, data)
+
+    host.arm_bank_switch(image.admin_bank, image.activate_time_ns)
+
+    if image.flags & IMAGE_FLAG_ENABLE:
+        host.enable_subsystem(True)
+
+
+def program_image_driver(driver: DriverBackend, image: TableImage) -> None:
+    """Load a mapped table image through the driver, one ioctl per table."""
+
+    ai = image.section(SyncDcnTable.AI_TRACE)
+    if ai is not None:
+        flags = SYNC_DCN_LOAD_FLAG_AI_ENABLE if image.flags & IMAGE_FLAG_AI_REPLAY else 0
+        driver.load_table(0, ai.table, ai.count, image.address(ai), flags)
+
+    if not image.flags & IMAGE_FLAG_ARM:
+        return
+
+    for table in (SyncDcnTable.TX_EXEC, SyncDcnTable.RX_EXEC):
+        section = image.section(table)
+        if section is not None:
+            driver.load_table(image.admin_bank, section.table, section.count, image.address(section))
+
+    phc_time_ns = driver.arm(image.admin_bank, image.activate_time_ns, bool(image.flags & IMAGE_FLAG_ENABLE))
+    print(f"Armed bank {image.admin_bank} at {image.activate_time_ns} ns (PHC now {phc_time_ns} ns)")
+
+
 def print_status(host: SyncDcnHost) -> None:
     """Print the minimum bring-up status fields for the live subsystem."""
 
@@ -504,13 +696,18 @@ def build_arg_parser() -> argparse.ArgumentParser:
         "schedule",
         type=Path,
         nargs="?",
-        help="Artifact JSON/YAML, or a results manifest JSON",
+        help="Artifact JSON/YAML or table image, or a results manifest JSON",
     )
     parser.add_argument(
         "--resource",
         type=Path,
         help="Path to a BAR/resource file to mmap and program",
     )
+    parser.add_argument(
+        "--device",
+        type=Path,
+        help="Load through the mqnic_app_sync_dcn driver device (e.g. /dev/mqnic0_sync_dcn)",
+    )
     parser.add_argument(
         "--map-size",
         type=lambda x: int(x, 0),
@@ -558,8 +755,16 @@ def main(argv: List[str] | None = None) -> int:
 
     args = build_arg_parser().parse_args(argv)
 
-    if not args.dry_run and args.resource is None:
-        print("error: either --dry-run or --resource must be provided", file=sys.stderr)
+    if not args.dry_run and args.resource is None and args.device is None:
+        print("error: one of --dry-run, --resource or --device must be provided", file=sys.stderr)
+        return 2
+
+    if args.device is not None and (args.resource is not None or args.dry_run):
+        print("error: --device cannot be combined with --resource or --dry-run", file=sys.stderr)
+        return 2
+
+    if args.device is not None and args.schedule is None:
+        print("error: --device requires a schedule file", file=sys.stderr)
         return 2
 
     if args.schedule is None and not (args.status or args.dump_entry):
@@ -585,6 +790,9 @@ def main(argv: List[str] | None = None) -> int:
             backend.close()
         return 0
 
+    if is_image(args.schedule):
+        return program_image_file(args, TableImage(args.schedule))
+
     raw = load_schedule_file(args.schedule)
 
     if "nodes" in raw and "fabric" in raw and "summary" in raw:
@@ -603,13 +811,15 @@ def main(argv: List[str] | None = None) -> int:
             fabric_component=args.fabric_component,
         )
         print(f"Resolved manifest target -> {artifact_path}")
+        if is_image(artifact_path):
+            return program_image_file(args, TableImage(artifact_path))
         raw = load_schedule_file(artifact_path)
 
-    target_type = str(raw.get("target_type", "prototype_fpga_runtime")).strip().lower()
-    if target_type == "prototype_fpga_runtime":
-        # Older compatibility artifacts still use the historical target name.
-        # Normalize it so guardrails and programming behavior stay consistent.
-        target_type = "prototype_runtime"
+    target_type = normalize_target_type(raw)
+
+    if args.device is not None and target_type != "fabric":
+        # the driver takes whole tables, so encode once and load like an image file
+        return program_image_file(args, TableImage(data=build_artifact_image(raw)))
 
     if target_type == "processor":
         ai_entries = build_ai_trace_entries(raw.get("ai_trace_entries", []))
@@ -634,7 +844,7 @@ def main(argv: List[str] | None = None) -> int:
 
         backend = MmapBackend(args.resource, args.map_size)
         try:
-            host = SyncDcnHost(backend.read32, backend.write32)
+            host = SyncDcnHost(backend.read32, backend.write32, backend.write_block)
             program_processor_artifact(host, ai_entries=ai_entries, enable_ai=enable_ai)
         finally:
             backend.close()
@@ -656,14 +866,7 @@ def main(argv: List[str] | None = None) -> int:
     enable_ai = bool(raw.get("enable_ai_replay", False))
     enable_subsystem = bool(raw.get("enable_subsystem", True))
 
-    if "tx_execution_entries" in raw or "rx_execution_entries" in raw:
-        raw_tx_entries = list(raw.get("tx_execution_entries", []))
-        raw_rx_entries = list(raw.get("rx_execution_entries", []))
-    else:
-        raw_tx_entries, raw_rx_entries = split_execution_entries_for_hw(raw.get("execution_entries", []))
-
-    tx_execution_entries = build_execution_entries(raw_tx_entries)
-    rx_execution_entries = build_execution_entries(raw_rx_entries)
+    tx_execution_entries, rx_execution_entries = resolve_execution_tables(raw)
     ai_entries = build_ai_trace_entries(raw.get("ai_trace_entries", []))
 
     if target_type == "prototype_runtime":
@@ -710,7 +913,7 @@ def main(argv: List[str] | None = None) -> int:
 
     backend = MmapBackend(args.resource, args.map_size)
     try:
-        host = SyncDcnHost(backend.read32, backend.write32)
+        host = SyncDcnHost(backend.read32, backend.write32, backend.write_block)
         program_device(
             host,
             admin_bank=admin_bank,
@@ -731,5 +934,40 @@ def main(argv: List[str] | None = None) -> int:
     return 0
 
 
+def program_image_file(args: argparse.Namespace, image: TableImage) -> int:
+    """Program, or dry-run, one mapped table image."""
+
+    try:
+        print_image_summary(image)
+
+        if args.device is not None:
+            driver = DriverBackend(args.device)
+            try:
+                program_image_driver(driver, image)
+            finally:
+                driver.close()
+            return 0
+
+        if args.dry_run:
+            backend = DryRunBackend(regs={})
+            host = SyncDcnHost(backend.read32, backend.write32)
+            program_image(host, backend.write_bytes, image)
+            return 0
+
+        backend = MmapBackend(args.resource, args.map_size)
+        try:
+            host = SyncDcnHost(backend.read32, backend.write32, backend.write_block)
+            program_image(host, backend.write_bytes, image)
+            if args.status:
+                print_status(host)
+            if args.dump_entry:
+                print_active_entry(host)
+        finally:
+            backend.close()
+        return 0
+    finally:
+        image.close()
+
+
 if __name__ == "__main__":
     raise SystemExit(main())
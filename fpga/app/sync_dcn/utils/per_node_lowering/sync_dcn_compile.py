@@ -34,7 +34,9 @@ The output is a low-level JSON file containing:
 - execution_entries[]
 - ai_trace_entries[]
 
-That output can be fed directly into sync_dcn_program.py.
+That output can be fed directly into sync_dcn_program.py.  With --image the
+same schedule is also written as a binary table image whose sections match
+the hardware table layout, so it loads with no parsing or encoding.
 """
 
 from __future__ import annotations
@@ -51,6 +53,7 @@ if str(UTILS_ROOT) not in sys.path:
     sys.path.append(str(UTILS_ROOT))
 
 from host_control_plane.sync_dcn_host import SyncDcnAppId, SyncDcnFlags, SyncDcnOpcode, SyncDcnPlaneId
+from host_control_plane.sync_dcn_program import build_artifact_image
 
 try:
     import yaml  # type: ignore
@@ -445,6 +448,13 @@ def compile_spec(spec: Dict[str, Any]) -> Dict[str, Any]:
     }
 
 
+def compile_image(artifact: Dict[str, Any]) -> bytes:
+    """Encode compiled low-level schedule JSON, or a NIC artifact derived
+    from it, as a binary table image."""
+
+    return build_artifact_image(artifact)
+
+
 def build_arg_parser() -> argparse.ArgumentParser:
     """Build the CLI parser for the compiler."""
 
@@ -461,6 +471,11 @@ def build_arg_parser() -> argparse.ArgumentParser:
         action="store_true",
         help="Pretty-print the compiled JSON output",
     )
+    parser.add_argument(
+        "--image",
+        type=Path,
+        help="Also write the schedule as a binary table image to this path",
+    )
     return parser
 
 
@@ -479,6 +494,9 @@ def main(argv: List[str] | None = None) -> int:
     else:
         args.output.write_text(text)
 
+    if args.image is not None:
+        args.image.write_bytes(compile_image(compiled))
+
     return 0
 
 
@@ -164,7 +164,7 @@ module mqnic_tx_scheduler_block #
 parameter SCHED_COUNT = 2;
 parameter AXIL_SCHED_ADDR_WIDTH = AXIL_ADDR_WIDTH-$clog2(SCHED_COUNT);
 
-localparam SCHED_RB_BASE_ADDR = RB_BASE_ADDR + 32'h60;
+localparam SCHED_RB_BASE_ADDR = RB_BASE_ADDR + 32'h100;
 
 localparam RBB = RB_BASE_ADDR & {REG_ADDR_WIDTH{1'b1}};
 
@@ -230,6 +230,15 @@ reg set_tdma_timeslot_period_valid_reg = 0;
 reg [79:0] set_tdma_active_period_reg = 0;
 reg set_tdma_active_period_valid_reg = 0;
 
+// staged schedule, committed to the scheduler as a whole at commit time
+reg [79:0] stage_tdma_schedule_start_reg = 0;
+reg [79:0] stage_tdma_schedule_period_reg = 0;
+reg [79:0] stage_tdma_timeslot_period_reg = 0;
+reg [79:0] stage_tdma_active_period_reg = 0;
+reg [79:0] tdma_commit_time_reg = 0;
+reg tdma_commit_pending_reg = 1'b0;
+reg [15:0] tdma_commit_count_reg = 0;
+
 assign ctrl_reg_wr_wait = sched_ctrl_reg_wr_wait;
 assign ctrl_reg_wr_ack = ctrl_reg_wr_ack_reg | sched_ctrl_reg_wr_ack;
 assign ctrl_reg_rd_data = ctrl_reg_rd_data_reg | sched_ctrl_reg_rd_data;
@@ -286,6 +295,25 @@ always @(posedge clk) begin
                 set_tdma_active_period_reg[29:0] <= ctrl_reg_wr_data;
                 set_tdma_active_period_valid_reg <= 1'b1;
             end
+            RBB+8'h60: stage_tdma_schedule_start_reg[29:0] <= ctrl_reg_wr_data;   // TDMA: staged schedule start ns
+            RBB+8'h64: stage_tdma_schedule_start_reg[63:32] <= ctrl_reg_wr_data;  // TDMA: staged schedule start sec l
+            RBB+8'h68: stage_tdma_schedule_start_reg[79:64] <= ctrl_reg_wr_data;  // TDMA: staged schedule start sec h
+            RBB+8'h6C: stage_tdma_schedule_period_reg[29:0] <= ctrl_reg_wr_data;  // TDMA: staged schedule period ns
+            RBB+8'h70: stage_tdma_timeslot_period_reg[29:0] <= ctrl_reg_wr_data;  // TDMA: staged timeslot period ns
+            RBB+8'h74: stage_tdma_active_period_reg[29:0] <= ctrl_reg_wr_data;    // TDMA: staged active period ns
+            RBB+8'h78: tdma_commit_time_reg[29:0] <= ctrl_reg_wr_data;            // TDMA: commit time ns
+            RBB+8'h7C: tdma_commit_time_reg[63:32] <= ctrl_reg_wr_data;           // TDMA: commit time sec l
+            RBB+8'h80: tdma_commit_time_reg[79:64] <= ctrl_reg_wr_data;           // TDMA: commit time sec h
+            RBB+8'h84: begin
+                // TDMA: commit control
+                if (ctrl_reg_wr_strb[0]) begin
+                    if (ctrl_reg_wr_data[1]) begin
+                        tdma_commit_pending_reg <= 1'b0;
+                    end else if (ctrl_reg_wr_data[0]) begin
+                        tdma_commit_pending_reg <= 1'b1;
+                    end
+                end
+            end
             default: ctrl_reg_wr_ack_reg <= 1'b0;
         endcase
     end
@@ -313,7 +341,7 @@ always @(posedge clk) begin
             RBB+8'h2C: ctrl_reg_rd_data_reg <= 2**TDMA_INDEX_WIDTH;   // Sched ctrl: Timeslot count
             // TDMA scheduler
             RBB+8'h30: ctrl_reg_rd_data_reg <= 32'h0000C060;          // TDMA: Type
-            RBB+8'h34: ctrl_reg_rd_data_reg <= 32'h00000200;          // TDMA: Version
+            RBB+8'h34: ctrl_reg_rd_data_reg <= 32'h00000300;          // TDMA: Version
             RBB+8'h38: ctrl_reg_rd_data_reg <= 0;                     // TDMA: Next header
             RBB+8'h3C: begin
                 // TDMA: control
@@ -328,13 +356,47 @@ always @(posedge clk) begin
             RBB+8'h54: ctrl_reg_rd_data_reg <= set_tdma_schedule_period_reg[29:0];   // TDMA: schedule period ns
             RBB+8'h58: ctrl_reg_rd_data_reg <= set_tdma_timeslot_period_reg[29:0];   // TDMA: timeslot period ns
             RBB+8'h5C: ctrl_reg_rd_data_reg <= set_tdma_active_period_reg[29:0];     // TDMA: active period ns
+            RBB+8'h60: ctrl_reg_rd_data_reg <= stage_tdma_schedule_start_reg[29:0];  // TDMA: staged schedule start ns
+            RBB+8'h64: ctrl_reg_rd_data_reg <= stage_tdma_schedule_start_reg[63:32]; // TDMA: staged schedule start sec l
+            RBB+8'h68: ctrl_reg_rd_data_reg <= stage_tdma_schedule_start_reg[79:64]; // TDMA: staged schedule start sec h
+            RBB+8'h6C: ctrl_reg_rd_data_reg <= stage_tdma_schedule_period_reg[29:0]; // TDMA: staged schedule period ns
+            RBB+8'h70: ctrl_reg_rd_data_reg <= stage_tdma_timeslot_period_reg[29:0]; // TDMA: staged timeslot period ns
+            RBB+8'h74: ctrl_reg_rd_data_reg <= stage_tdma_active_period_reg[29:0];   // TDMA: staged active period ns
+            RBB+8'h78: ctrl_reg_rd_data_reg <= tdma_commit_time_reg[29:0];           // TDMA: commit time ns
+            RBB+8'h7C: ctrl_reg_rd_data_reg <= tdma_commit_time_reg[63:32];          // TDMA: commit time sec l
+            RBB+8'h80: ctrl_reg_rd_data_reg <= tdma_commit_time_reg[79:64];          // TDMA: commit time sec h
+            RBB+8'h84: begin
+                // TDMA: commit control
+                ctrl_reg_rd_data_reg[0] <= tdma_commit_pending_reg;
+                ctrl_reg_rd_data_reg[31:16] <= tdma_commit_count_reg;
+            end
             default: ctrl_reg_rd_ack_reg <= 1'b0;
         endcase
     end
 
+    // commit the staged schedule once PTP time reaches the commit time; all
+    // parameters reach the TDMA scheduler in the same cycle
+    if (tdma_commit_pending_reg && (ptp_sync_ts_tod[95:48] > tdma_commit_time_reg[79:32] ||
+            (ptp_sync_ts_tod[95:48] == tdma_commit_time_reg[79:32] && ptp_sync_ts_tod[45:16] >= tdma_commit_time_reg[29:0]))) begin
+        set_tdma_schedule_start_reg <= stage_tdma_schedule_start_reg;
+        set_tdma_schedule_start_valid_reg <= 1'b1;
+        set_tdma_schedule_period_reg <= stage_tdma_schedule_period_reg;
+        set_tdma_schedule_period_valid_reg <= 1'b1;
+        set_tdma_timeslot_period_reg <= stage_tdma_timeslot_period_reg;
+        set_tdma_timeslot_period_valid_reg <= 1'b1;
+        set_tdma_active_period_reg <= stage_tdma_active_period_reg;
+        set_tdma_active_period_valid_reg <= 1'b1;
+        tdma_enable_reg <= 1'b1;
+        tdma_commit_pending_reg <= 1'b0;
+        tdma_commit_count_reg <= tdma_commit_count_reg + 1;
+    end
+
     if (rst) begin
         ctrl_reg_wr_ack_reg <= 1'b0;
         ctrl_reg_rd_ack_reg <= 1'b0;
+
+        tdma_commit_pending_reg <= 1'b0;
+        tdma_commit_count_reg <= 0;
     end
 end
 
@@ -17,7 +17,9 @@ module rx_hash #
     // Width of AXI stream interfaces in bits
     parameter DATA_WIDTH = 256,
     // AXI stream tkeep signal width (words per cycle)
-    parameter KEEP_WIDTH = (DATA_WIDTH/8)
+    parameter KEEP_WIDTH = (DATA_WIDTH/8),
+    // Hash the inner headers of VXLAN and Geneve over IPv4/UDP
+    parameter TUNNEL_ENABLE = 1
 )
 (
     input  wire                   clk,
@@ -44,7 +46,7 @@ module rx_hash #
     output wire                   m_axis_hash_valid
 );
 
-parameter CYCLE_COUNT = (38+KEEP_WIDTH-1)/KEEP_WIDTH;
+parameter CYCLE_COUNT = ((TUNNEL_ENABLE ? 88 : 38)+KEEP_WIDTH-1)/KEEP_WIDTH;
 
 parameter PTR_WIDTH = $clog2(CYCLE_COUNT);
 
@@ -102,6 +104,25 @@ TCP/UDP Frame (IPv6)
  desination port             2 octets
  other fields + payload
 
+VXLAN (UDP port 4789) / Geneve (UDP port 6081) over IPv4
+
+ Field                       Length
+ Outer Ethernet/IPv4/UDP     42 octets (IHL 5)
+ VXLAN flags (I bit set)     1 octet
+  or Geneve ver/opt len (0)  1 octet
+ reserved/flags              1 octet
+ reserved                    2 octets
+  or Geneve protocol (6558)  2 octets
+ VNI + reserved              4 octets
+ Inner Ethernet              14 octets (ethertype 0x0800)
+ Inner IPv4                  20 octets (IHL 5)
+ Inner source port           2 octets
+ Inner desination port       2 octets
+
+ The inner 4-tuple is hashed so that flows between the same pair of VTEPs
+ spread across queues; when the inner headers cannot be parsed, the outer
+ UDP hash is reported instead.
+
 */
 
 reg active_reg = 1'b1, active_next;
@@ -110,6 +131,15 @@ reg [PTR_WIDTH-1:0] ptr_reg = 0, ptr_next;
 reg [15:0] eth_type_reg = 15'd0, eth_type_next;
 reg [3:0] ihl_reg = 4'd0, ihl_next;
 
+reg tun_reg = 1'b0, tun_next;
+reg tun_geneve_reg = 1'b0, tun_geneve_next;
+reg [7:0] tun_proto_reg = 8'd0, tun_proto_next;
+reg [7:0] inner_eth_type_reg = 8'd0, inner_eth_type_next;
+reg [3:0] inner_ihl_reg = 4'd0, inner_ihl_next;
+reg inner_tcp_reg = 1'b0, inner_tcp_next;
+reg inner_udp_reg = 1'b0, inner_udp_next;
+reg [12*8-1:0] inner_data_reg = 0, inner_data_next;
+
 reg [36*8-1:0] hash_data_reg = 0, hash_data_next;
 reg hash_data_ipv4_reg = 1'b0, hash_data_ipv4_next;
 reg hash_data_tcp_reg = 1'b0, hash_data_tcp_next;
@@ -158,6 +188,15 @@ always @* begin
     eth_type_next = eth_type_reg;
     ihl_next = ihl_reg;
 
+    tun_next = tun_reg;
+    tun_geneve_next = tun_geneve_reg;
+    tun_proto_next = tun_proto_reg;
+    inner_eth_type_next = inner_eth_type_reg;
+    inner_ihl_next = inner_ihl_reg;
+    inner_tcp_next = inner_tcp_reg;
+    inner_udp_next = inner_udp_reg;
+    inner_data_next = inner_data_reg;
+
     hash_data_next = hash_data_reg;
     hash_data_ipv4_next = hash_data_ipv4_reg;
     hash_data_tcp_next = hash_data_tcp_reg;
@@ -173,6 +212,9 @@ always @* begin
                 hash_data_ipv4_next = 1'b0;
                 hash_data_tcp_next = 1'b0;
                 hash_data_udp_next = 1'b0;
+                tun_next = 1'b0;
+                inner_tcp_next = 1'b0;
+                inner_udp_next = 1'b0;
             end
             if (ptr_reg == 12/KEEP_WIDTH) begin
                 // eth type MSB
@@ -266,6 +308,102 @@ always @* begin
                         // capture dest port
                         hash_data_next[95:88] = s_axis_tdata[(37%KEEP_WIDTH)*8 +: 8];
                         hash_data_type_next = {hash_data_udp_next, hash_data_tcp_next, 1'b0, 1'b1};
+                        if (TUNNEL_ENABLE && hash_data_udp_next &&
+                                ({hash_data_next[87:80], hash_data_next[95:88]} == 16'd4789 ||
+                                {hash_data_next[87:80], hash_data_next[95:88]} == 16'd6081)) begin
+                            // UDP tunnel; keep the outer hash as the fallback
+                            tun_next = 1'b1;
+                            tun_geneve_next = {hash_data_next[87:80], hash_data_next[95:88]} == 16'd6081;
+                        end else begin
+                            hash_data_valid_next = 1'b1;
+                            active_next = 1'b0;
+                        end
+                    end
+                end
+            end
+            if (TUNNEL_ENABLE && tun_next) begin
+                if (ptr_reg == 42/KEEP_WIDTH) begin
+                    // check VXLAN I flag, or Geneve version 0 without options
+                    if (tun_geneve_next ? s_axis_tdata[(42%KEEP_WIDTH)*8 +: 8] != 8'h00 : !s_axis_tdata[(42%KEEP_WIDTH)*8+3]) begin
+                        tun_next = 1'b0;
+                        hash_data_valid_next = 1'b1;
+                        active_next = 1'b0;
+                    end
+                end
+                if (ptr_reg == 44/KEEP_WIDTH) begin
+                    // Geneve protocol MSB
+                    tun_proto_next = s_axis_tdata[(44%KEEP_WIDTH)*8 +: 8];
+                end
+                if (ptr_reg == 45/KEEP_WIDTH) begin
+                    // Geneve protocol LSB, must be transparent Ethernet bridging
+                    if (tun_geneve_next && {tun_proto_next, s_axis_tdata[(45%KEEP_WIDTH)*8 +: 8]} != 16'h6558) begin
+                        tun_next = 1'b0;
+                        hash_data_valid_next = 1'b1;
+                        active_next = 1'b0;
+                    end
+                end
+            end
+            if (TUNNEL_ENABLE && tun_next) begin
+                if (ptr_reg == 62/KEEP_WIDTH) begin
+                    // inner eth type MSB
+                    inner_eth_type_next = s_axis_tdata[(62%KEEP_WIDTH)*8 +: 8];
+                end
+                if (ptr_reg == 63/KEEP_WIDTH) begin
+                    // inner eth type LSB
+                    if ({inner_eth_type_next, s_axis_tdata[(63%KEEP_WIDTH)*8 +: 8]} != 16'h0800) begin
+                        tun_next = 1'b0;
+                        hash_data_valid_next = 1'b1;
+                        active_next = 1'b0;
+                    end
+                end
+                if (ptr_reg == 64/KEEP_WIDTH) begin
+                    // capture inner IHL
+                    inner_ihl_next = s_axis_tdata[(64%KEEP_WIDTH)*8 +: 8];
+                end
+                if (ptr_reg == 73/KEEP_WIDTH) begin
+                    // capture inner protocol
+                    if (inner_ihl_next != 5) begin
+                        tun_next = 1'b0;
+                        hash_data_valid_next = 1'b1;
+                        active_next = 1'b0;
+                    end else if (s_axis_tdata[(73%KEEP_WIDTH)*8 +: 8] == 8'h06) begin
+                        inner_tcp_next = 1'b1;
+                    end else if (s_axis_tdata[(73%KEEP_WIDTH)*8 +: 8] == 8'h11) begin
+                        inner_udp_next = 1'b1;
+                    end
+                end
+            end
+            if (TUNNEL_ENABLE && tun_next) begin
+                // capture inner source and dest IP, then ports
+                if (ptr_reg == 76/KEEP_WIDTH) inner_data_next[7:0] = s_axis_tdata[(76%KEEP_WIDTH)*8 +: 8];
+                if (ptr_reg == 77/KEEP_WIDTH) inner_data_next[15:8] = s_axis_tdata[(77%KEEP_WIDTH)*8 +: 8];
+                if (ptr_reg == 78/KEEP_WIDTH) inner_data_next[23:16] = s_axis_tdata[(78%KEEP_WIDTH)*8 +: 8];
+                if (ptr_reg == 79/KEEP_WIDTH) inner_data_next[31:24] = s_axis_tdata[(79%KEEP_WIDTH)*8 +: 8];
+                if (ptr_reg == 80/KEEP_WIDTH) inner_data_next[39:32] = s_axis_tdata[(80%KEEP_WIDTH)*8 +: 8];
+                if (ptr_reg == 81/KEEP_WIDTH) inner_data_next[47:40] = s_axis_tdata[(81%KEEP_WIDTH)*8 +: 8];
+                if (ptr_reg == 82/KEEP_WIDTH) inner_data_next[55:48] = s_axis_tdata[(82%KEEP_WIDTH)*8 +: 8];
+                if (ptr_reg == 83/KEEP_WIDTH) begin
+                    inner_data_next[63:56] = s_axis_tdata[(83%KEEP_WIDTH)*8 +: 8];
+                    if (!(inner_tcp_next || inner_udp_next)) begin
+                        // inner IPv4 without ports
+                        hash_data_next[95:0] = inner_data_next;
+                        hash_data_tcp_next = 1'b0;
+                        hash_data_udp_next = 1'b0;
+                        hash_data_type_next = {1'b0, 1'b0, 1'b0, 1'b1};
+                        hash_data_valid_next = 1'b1;
+                        active_next = 1'b0;
+                    end
+                end
+                if (inner_tcp_next || inner_udp_next) begin
+                    if (ptr_reg == 84/KEEP_WIDTH) inner_data_next[71:64] = s_axis_tdata[(84%KEEP_WIDTH)*8 +: 8];
+                    if (ptr_reg == 85/KEEP_WIDTH) inner_data_next[79:72] = s_axis_tdata[(85%KEEP_WIDTH)*8 +: 8];
+                    if (ptr_reg == 86/KEEP_WIDTH) inner_data_next[87:80] = s_axis_tdata[(86%KEEP_WIDTH)*8 +: 8];
+                    if (ptr_reg == 87/KEEP_WIDTH) begin
+                        inner_data_next[95:88] = s_axis_tdata[(87%KEEP_WIDTH)*8 +: 8];
+                        hash_data_next[95:0] = inner_data_next;
+                        hash_data_tcp_next = inner_tcp_next;
+                        hash_data_udp_next = inner_udp_next;
+                        hash_data_type_next = {inner_udp_next, inner_tcp_next, 1'b0, 1'b1};
                         hash_data_valid_next = 1'b1;
                         active_next = 1'b0;
                     end
@@ -275,7 +413,10 @@ always @* begin
 
         if (s_axis_tlast) begin
             if (active_next) begin
-                hash_data_type_next = 4'b0000;
+                // a truncated tunnel frame still reports the outer hash
+                if (!tun_next) begin
+                    hash_data_type_next = 4'b0000;
+                end
                 hash_data_valid_next = 1'b1;
             end
             ptr_next = 0;
@@ -291,6 +432,15 @@ always @(posedge clk) begin
     eth_type_reg <= eth_type_next;
     ihl_reg <= ihl_next;
 
+    tun_reg <= tun_next;
+    tun_geneve_reg <= tun_geneve_next;
+    tun_proto_reg <= tun_proto_next;
+    inner_eth_type_reg <= inner_eth_type_next;
+    inner_ihl_reg <= inner_ihl_next;
+    inner_tcp_reg <= inner_tcp_next;
+    inner_udp_reg <= inner_udp_next;
+    inner_data_reg <= inner_data_next;
+
     hash_data_reg <= hash_data_next;
     hash_data_ipv4_reg <= hash_data_ipv4_next;
     hash_data_tcp_reg <= hash_data_tcp_next;
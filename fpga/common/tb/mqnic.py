@@ -286,7 +286,7 @@ MQNIC_RB_SCHED_CTRL_TDMA_REG_CTRL       = 0x18
 MQNIC_RB_SCHED_CTRL_TDMA_REG_TS_COUNT   = 0x1C
 
 MQNIC_RB_TDMA_SCH_TYPE                     = 0x0000C060
-MQNIC_RB_TDMA_SCH_VER                      = 0x00000200
+MQNIC_RB_TDMA_SCH_VER                      = 0x00000300
 MQNIC_RB_TDMA_SCH_REG_CTRL                 = 0x0C
 MQNIC_RB_TDMA_SCH_REG_SCH_START_FNS        = 0x10
 MQNIC_RB_TDMA_SCH_REG_SCH_START_NS         = 0x14
@@ -296,6 +296,16 @@ MQNIC_RB_TDMA_SCH_REG_SCH_PERIOD_FNS       = 0x20
 MQNIC_RB_TDMA_SCH_REG_SCH_PERIOD_NS        = 0x24
 MQNIC_RB_TDMA_SCH_REG_TS_PERIOD_NS         = 0x28
 MQNIC_RB_TDMA_SCH_REG_ACTIVE_PERIOD_NS     = 0x2C
+MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_NS     = 0x30
+MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_SEC_L  = 0x34
+MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_SEC_H  = 0x38
+MQNIC_RB_TDMA_SCH_REG_STG_SCH_PERIOD_NS    = 0x3C
+MQNIC_RB_TDMA_SCH_REG_STG_TS_PERIOD_NS     = 0x40
+MQNIC_RB_TDMA_SCH_REG_STG_ACTIVE_PERIOD_NS = 0x44
+MQNIC_RB_TDMA_SCH_REG_COMMIT_NS            = 0x48
+MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_L         = 0x4C
+MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_H         = 0x50
+MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL          = 0x54
 
 MQNIC_RB_APP_INFO_TYPE    = 0x0000C005
 MQNIC_RB_APP_INFO_VER     = 0x00000200
@@ -1439,6 +1449,9 @@ class NetDev:
         self.tx_ring_size = 1024
         self.rx_ring_size = 1024
 
+        self.tx_desc_block_size = 4
+        self.rx_desc_block_size = 4
+
         self.pkt_rx_queue = deque()
         self.pkt_rx_sync = Event()
 
@@ -1456,7 +1469,7 @@ class NetDev:
             await cq.open(self.interface.eq[k % len(self.interface.eq)], 1024)
             await cq.arm()
             rxq = self.interface.create_rxq()
-            await rxq.open(self, cq, self.rx_ring_size, 4)
+            await rxq.open(self, cq, self.rx_ring_size, self.rx_desc_block_size)
             self.rxq.append(rxq)
 
         for k in range(self.txq_count):
@@ -1464,7 +1477,7 @@ class NetDev:
             await cq.open(self.interface.eq[k % len(self.interface.eq)], 1024)
             await cq.arm()
             txq = self.interface.create_txq()
-            await txq.open(self, cq, self.tx_ring_size, 4)
+            await txq.open(self, cq, self.tx_ring_size, self.tx_desc_block_size)
             self.txq.append(txq)
 
         for k in range(self.rx_queue_map_indir_table_size):
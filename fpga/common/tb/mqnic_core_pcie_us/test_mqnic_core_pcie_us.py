@@ -5,6 +5,7 @@ import logging
 import os
 import struct
 import sys
+from collections import deque
 
 import scapy.utils
 from scapy.layers.l2 import Ether
@@ -16,7 +17,7 @@ import pytest
 import cocotb
 from cocotb.log import SimLog
 from cocotb.clock import Clock
-from cocotb.triggers import RisingEdge, FallingEdge, Timer
+from cocotb.triggers import RisingEdge, FallingEdge, Timer, Event
 
 from cocotbext.axi import AxiStreamBus
 from cocotbext.axi import AxiSlave, AxiBus, SparseMemoryRegion
@@ -427,7 +428,176 @@ class TB(object):
                         await mac.rx.send(await mac.tx.recv())
 
 
-@cocotb.test()
+class OpMonitor:
+    """Cycles spent by each operation in one datapath module
+
+    An operation starts on the request handshake and ends on the matching
+    status, matched by tag and, for a repeated tag, in issue order.  Status
+    reporting an empty queue or an error retires the operation without
+    counting it.
+    """
+    def __init__(self, name, start, end, drop=None):
+        self.name = name
+        self.start = start
+        self.end = end
+        self.drop = drop
+        # an error status on the completion channel must not also complete
+        self.drop_is_end = drop is not None and drop[0]._path == end[0]._path
+        self.clear()
+
+    def clear(self):
+        self.pending = {}
+        self.pending_count = 0
+        self.ops = 0
+        self.dropped = 0
+        self.lat_total = 0
+        self.lat_max = 0
+        self.busy_cycles = 0
+
+    @staticmethod
+    def _fire(valid, ready=None, last=None):
+        return valid.value.integer and (ready is None or ready.value.integer) and (last is None or last.value.integer)
+
+    def _retire(self, tag, cycle):
+        q = self.pending.get(tag)
+        if not q:
+            return None
+        self.pending_count -= 1
+        return cycle - q.popleft()
+
+    def sample(self, cycle, enable):
+        valid, ready, tag = self.start
+        if self._fire(valid, ready):
+            self.pending.setdefault(tag.value.integer, deque()).append(cycle)
+            self.pending_count += 1
+
+        dropped = False
+        if self.drop:
+            valid, tag, flags = self.drop
+            if self._fire(valid) and any(f.value.integer for f in flags):
+                dropped = True
+                if self._retire(tag.value.integer, cycle) is not None and enable:
+                    self.dropped += 1
+
+        valid, ready, tag, last = self.end
+        if not (dropped and self.drop_is_end) and self._fire(valid, ready, last):
+            lat = self._retire(tag.value.integer, cycle)
+            if lat is not None and enable:
+                self.ops += 1
+                self.lat_total += lat
+                self.lat_max = max(self.lat_max, lat)
+
+        if enable and self.pending_count:
+            self.busy_cycles += 1
+
+    def report(self, log, cycles, packets):
+        log.info("  %-12s ops %6d (%.2f/pkt)  dropped %4d  latency avg %7.1f max %5d  cycles/op %7.2f  busy %5.1f%%",
+            self.name, self.ops, self.ops / packets, self.dropped, self.lat_total / self.ops if self.ops else 0,
+            self.lat_max, cycles / self.ops if self.ops else 0, 100 * self.busy_cycles / cycles if cycles else 0)
+
+
+class OccupancyMonitor:
+    """Active entries in a queue manager operation table"""
+    def __init__(self, name, active):
+        self.name = name
+        self.active = active
+        self.size = len(active)
+        self.clear()
+
+    def clear(self):
+        self.total = 0
+        self.max = 0
+        self.full_cycles = 0
+
+    def sample(self, cycle, enable):
+        if not enable:
+            return
+        count = self.active.value.binstr.count('1')
+        self.total += count
+        self.max = max(self.max, count)
+        if count == self.size:
+            self.full_cycles += 1
+
+    def report(self, log, cycles, packets):
+        log.info("  %-12s op table avg %5.2f max %3d of %3d  full %5.1f%%",
+            self.name, self.total / cycles if cycles else 0, self.max, self.size,
+            100 * self.full_cycles / cycles if cycles else 0)
+
+
+class DatapathMonitor:
+    """Per-cycle sampling of the datapath of one interface
+
+    Covers descriptor fetch, completion and event writes, the TX and RX
+    engines, and the TX and RX queue manager operation tables.
+    """
+    def __init__(self, clk, iface):
+        self.clk = clk
+        self.enable = False
+        self.cycles = 0
+
+        df = iface.desc_fetch_inst
+        cw = iface.cpl_write_inst
+        ew = iface.event_write_inst
+        tx = iface.interface_tx_inst.tx_engine_inst
+        rx = iface.interface_rx_inst.rx_engine_inst
+
+        self.monitors = [
+            OpMonitor("desc_fetch",
+                (df.s_axis_req_valid, df.s_axis_req_ready, df.s_axis_req_tag),
+                (df.m_axis_desc_tvalid, df.m_axis_desc_tready, df.m_axis_desc_tid, df.m_axis_desc_tlast),
+                (df.m_axis_req_status_valid, df.m_axis_req_status_tag,
+                    [df.m_axis_req_status_empty, df.m_axis_req_status_error])),
+            OpMonitor("cpl_write",
+                (cw.s_axis_req_valid, cw.s_axis_req_ready, cw.s_axis_req_tag),
+                (cw.m_axis_req_status_valid, None, cw.m_axis_req_status_tag, None),
+                (cw.m_axis_req_status_valid, cw.m_axis_req_status_tag,
+                    [cw.m_axis_req_status_full, cw.m_axis_req_status_error])),
+            OpMonitor("event_write",
+                (ew.s_axis_req_valid, ew.s_axis_req_ready, ew.s_axis_req_tag),
+                (ew.m_axis_req_status_valid, None, ew.m_axis_req_status_tag, None)),
+            OpMonitor("tx_engine",
+                (tx.s_axis_tx_req_valid, tx.s_axis_tx_req_ready, tx.s_axis_tx_req_tag),
+                (tx.m_axis_tx_status_finish_valid, None, tx.m_axis_tx_status_finish_tag, None),
+                (tx.m_axis_tx_status_dequeue_valid, tx.m_axis_tx_status_dequeue_tag,
+                    [tx.m_axis_tx_status_dequeue_empty, tx.m_axis_tx_status_dequeue_error])),
+            OpMonitor("rx_engine",
+                (rx.s_axis_rx_req_valid, rx.s_axis_rx_req_ready, rx.s_axis_rx_req_tag),
+                (rx.m_axis_rx_req_status_valid, None, rx.m_axis_rx_req_status_tag, None)),
+            OccupancyMonitor("tx_qm", iface.tx_qm_inst.op_table_active),
+            OccupancyMonitor("rx_qm", iface.rx_qm_inst.op_table_active),
+        ]
+
+        cocotb.start_soon(self._run())
+
+    def start(self):
+        for m in self.monitors:
+            m.clear()
+        self.cycles = 0
+        self.enable = True
+
+    def stop(self):
+        self.enable = False
+
+    def report(self, log, packets):
+        for m in self.monitors:
+            m.report(log, self.cycles, packets)
+
+    async def _run(self):
+        cycle = 0
+        while True:
+            await RisingEdge(self.clk)
+            cycle += 1
+            for m in self.monitors:
+                m.sample(cycle, self.enable)
+            if self.enable:
+                self.cycles += 1
+
+
+# benchmark mode, see run_bench_nic
+BENCH = int(os.getenv("BENCH", "0"))
+
+
+@cocotb.test(skip=bool(BENCH))
 async def run_test_nic(dut):
 
     tb = TB(dut, msix_count=2**len(dut.core_pcie_inst.irq_index))
@@ -724,6 +894,89 @@ async def run_test_nic(dut):
     await RisingEdge(dut.clk)
 
 
+@cocotb.test(skip=not BENCH)
+async def run_bench_nic(dut):
+    """Sustained TX and RX through loopback on interface 0
+
+    Configured from the environment:
+      BENCH_TXQ_COUNT, BENCH_RXQ_COUNT   queues opened on the netdev
+      BENCH_DESC_BLOCK_SIZE              descriptors per TX and RX slot
+      BENCH_PKT_SIZES                    comma separated frame sizes
+      BENCH_PKT_COUNT                    frames per size
+
+    For each size, reports the cycles per packet and per-operation latency
+    of each datapath module, and queue manager operation table occupancy.
+    """
+
+    tb = TB(dut, msix_count=2**len(dut.core_pcie_inst.irq_index))
+
+    await tb.init()
+
+    txq_count = int(os.getenv("BENCH_TXQ_COUNT", "4"))
+    rxq_count = int(os.getenv("BENCH_RXQ_COUNT", "4"))
+    desc_block_size = int(os.getenv("BENCH_DESC_BLOCK_SIZE", "4"))
+    pkt_sizes = [int(x) for x in os.getenv("BENCH_PKT_SIZES", "60,512,1514").split(",")]
+    pkt_count = int(os.getenv("BENCH_PKT_COUNT", "256"))
+
+    clk_period_ns = int(os.getenv("PARAM_CLK_PERIOD_NS_NUM", "4")) / int(os.getenv("PARAM_CLK_PERIOD_NS_DENOM", "1"))
+
+    tb.log.info("Init driver")
+    await tb.driver.init_pcie_dev(tb.rc.find_device(tb.dev.functions[0].pcie_id))
+
+    interface = tb.driver.interfaces[0]
+    ndev = interface.ndevs[0]
+
+    ndev.txq_count = min(txq_count, interface.txq_res.get_count() // interface.port_count)
+    ndev.rxq_count = min(rxq_count, interface.rxq_res.get_count() // interface.port_count)
+    ndev.tx_desc_block_size = desc_block_size
+    ndev.rx_desc_block_size = desc_block_size
+
+    await ndev.open()
+
+    tb.log.info("Benchmark: %d TX queues, %d RX queues, desc block size %d, %d packets per size",
+        ndev.txq_count, ndev.rxq_count, desc_block_size, pkt_count)
+
+    mon = DatapathMonitor(dut.clk, dut.core_pcie_inst.core_inst.iface[0].interface_inst)
+
+    tb.loopback_enable = True
+
+    for size in pkt_sizes:
+        eth = Ether(src='5A:51:52:53:54:55', dst='DA:D1:D2:D3:D4:D5')
+        ip = IP(src='192.168.1.100', dst='192.168.1.101')
+        pkts = [(eth / ip / UDP(sport=1, dport=k) / bytes([(x+k) % 256 for x in range(max(size-42, 0))])).build()
+            for k in range(pkt_count)]
+
+        done = Event()
+
+        async def send():
+            for k, p in enumerate(pkts):
+                await ndev.start_xmit(p, k % ndev.txq_count)
+            done.set()
+
+        mon.start()
+
+        cocotb.start_soon(send())
+
+        for k in range(pkt_count):
+            pkt = await ndev.recv()
+            assert len(pkt.data) == len(pkts[0])
+
+        await done.wait()
+
+        mon.stop()
+
+        cycles = mon.cycles
+        tb.log.info("Size %d: %d packets in %d cycles, %.2f cycles/pkt, %.3f Gbps",
+            len(pkts[0]), pkt_count, cycles, cycles / pkt_count,
+            len(pkts[0]) * 8 * pkt_count / (cycles * clk_period_ns))
+        mon.report(tb.log, pkt_count)
+
+    tb.loopback_enable = False
+
+    await RisingEdge(dut.clk)
+    await RisingEdge(dut.clk)
+
+
 # cocotb-test
 
 tests_dir = os.path.dirname(__file__)
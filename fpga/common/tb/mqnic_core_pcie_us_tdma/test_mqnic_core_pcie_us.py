@@ -753,6 +753,40 @@ async def run_test_nic(dut):
 
     tb.loopback_enable = False
 
+    tb.log.info("TDMA staged commit")
+
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_NS,    0)
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_SEC_L, 0)
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_SEC_H, 0)
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_STG_SCH_PERIOD_NS,    80000)
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_STG_TS_PERIOD_NS,     20000)
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_STG_ACTIVE_PERIOD_NS, 15000)
+
+    # commit a few microseconds in the future
+    now_ns = await tb.driver.phc_rb.read_dword(mqnic.MQNIC_RB_PHC_REG_CUR_TOD_NS)
+    now_s = await tb.driver.phc_rb.read_dword(mqnic.MQNIC_RB_PHC_REG_CUR_TOD_SEC_L)
+    commit_ns = now_ns + 5000
+    commit_s = now_s + commit_ns // 1000000000
+    commit_ns %= 1000000000
+
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_COMMIT_NS, commit_ns)
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_L, commit_s)
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_H, 0)
+    await tdma_sch_rb.write_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL, 0x00000001)
+
+    # staged values are not visible before the commit time
+    assert await tdma_sch_rb.read_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL) & 0x1
+    assert await tdma_sch_rb.read_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_SCH_PERIOD_NS) == 40000
+
+    await Timer(10000, 'ns')
+
+    val = await tdma_sch_rb.read_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL)
+    assert not val & 0x1
+    assert val >> 16 == 1
+    assert await tdma_sch_rb.read_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_SCH_PERIOD_NS) == 80000
+    assert await tdma_sch_rb.read_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_TS_PERIOD_NS) == 20000
+    assert await tdma_sch_rb.read_dword(mqnic.MQNIC_RB_TDMA_SCH_REG_ACTIVE_PERIOD_NS) == 15000
+
     tb.log.info("Read statistics counters")
 
     await Timer(2000, 'ns')
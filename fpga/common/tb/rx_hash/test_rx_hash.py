@@ -10,6 +10,7 @@ import os
 
 from scapy.layers.l2 import Ether
 from scapy.layers.inet import IP, UDP, TCP
+from scapy.layers.vxlan import VXLAN
 
 import cocotb_test.simulator
 import pytest
@@ -143,6 +144,15 @@ async def run_test(dut, payload_lengths=None, payload_data=None, idle_inserter=N
                 test_pkt = eth / ip / tcp / payload
                 hash_type = HashType.IPV4 | HashType.TCP
                 hash_val = hash_toep(tuple_pack(ip.src, ip.dst, tcp.sport, tcp.dport), tb.hash_key)
+            elif pkt_type == VXLAN:
+                # outer flow is fixed between two VTEPs; the inner flow is hashed
+                udp = UDP(sport=0xc000, dport=4789)
+                inner_eth = Ether(src='5A:61:62:63:64:65', dst='DA:E1:E2:E3:E4:E5')
+                inner_ip = IP(src=f'192.168.0.{ip_id & 0xff}', dst='192.168.1.1', id=ip_id)
+                inner_tcp = TCP(sport=ip_id, dport=0x2000+ip_id)
+                test_pkt = eth / ip / udp / VXLAN(vni=ip_id) / inner_eth / inner_ip / inner_tcp / payload
+                hash_type = HashType.IPV4 | HashType.TCP
+                hash_val = hash_toep(tuple_pack(inner_ip.src, inner_ip.dst, inner_tcp.sport, inner_tcp.dport), tb.hash_key)
 
         test_pkts.append(test_pkt)
         hash_info.append((hash_type, hash_val))
@@ -185,7 +195,7 @@ def incrementing_payload(length):
 if cocotb.SIM_NAME:
 
     factory = TestFactory(run_test)
-    factory.add_option("pkt_type", [Ether, IP, UDP, TCP])
+    factory.add_option("pkt_type", [Ether, IP, UDP, TCP, VXLAN])
     factory.add_option("payload_lengths", [size_list])
     factory.add_option("payload_data", [incrementing_payload])
     factory.add_option("idle_inserter", [None, cycle_pause])
@@ -51,6 +51,75 @@ static const struct pci_device_id pci_ids[] = {
 
 MODULE_DEVICE_TABLE(pci, pci_ids);
 
+static void edev_cpl_ring_enable(struct example_dev *edev)
+{
+	struct device *dev = edev->dev;
+
+	edev->cpl_ring = dma_alloc_coherent(dev, EDEV_CPL_RING_SIZE * sizeof(*edev->cpl_ring),
+			&edev->cpl_ring_addr, GFP_KERNEL | __GFP_ZERO);
+	if (!edev->cpl_ring)
+		return;
+
+	edev->cpl_ring_tail = 0;
+
+	iowrite32(edev->cpl_ring_addr & 0xffffffff, edev->bar[0] + 0x000080);
+	iowrite32((edev->cpl_ring_addr >> 32) & 0xffffffff, edev->bar[0] + 0x000084);
+	iowrite32(0x80000000 | EDEV_CPL_RING_LOG_SIZE, edev->bar[0] + 0x000088);
+
+	// older cores and cores without immediate writes leave the enable bit clear
+	if ((ioread32(edev->bar[0] + 0x000088) & 0x80000000) == 0) {
+		dev_info(dev, "block completion ring not supported, polling status registers");
+		dma_free_coherent(dev, EDEV_CPL_RING_SIZE * sizeof(*edev->cpl_ring),
+				edev->cpl_ring, edev->cpl_ring_addr);
+		edev->cpl_ring = NULL;
+	}
+}
+
+static void edev_cpl_ring_disable(struct example_dev *edev)
+{
+	if (!edev->cpl_ring)
+		return;
+
+	iowrite32(0, edev->bar[0] + 0x000088);
+	ioread32(edev->bar[0] + 0x000088); // flush
+
+	dma_free_coherent(edev->dev, EDEV_CPL_RING_SIZE * sizeof(*edev->cpl_ring),
+			edev->cpl_ring, edev->cpl_ring_addr);
+	edev->cpl_ring = NULL;
+}
+
+// wait for a block operation to finish; with the completion ring this spins
+// on host memory, so no MMIO reads compete with the traffic being measured
+static bool edev_block_wait(struct example_dev *edev, u32 run_reg)
+{
+	unsigned long t = jiffies + msecs_to_jiffies(20000);
+
+	if (edev->cpl_ring) {
+		__le32 *rec = &edev->cpl_ring[edev->cpl_ring_tail & (EDEV_CPL_RING_SIZE - 1)];
+		u32 phase = edev->cpl_ring_tail & EDEV_CPL_RING_SIZE ? 0 : 0x80000000;
+
+		while (time_before(jiffies, t)) {
+			if ((le32_to_cpu(READ_ONCE(*rec)) & 0x80000000) == phase) {
+				dma_rmb();
+				edev->cpl_ring_tail++;
+				return true;
+			}
+			cpu_relax();
+		}
+
+		// resynchronize with the producer
+		edev->cpl_ring_tail = ioread32(edev->bar[0] + 0x00008c);
+		return false;
+	}
+
+	while (time_before(jiffies, t)) {
+		if ((ioread32(edev->bar[0] + run_reg) & 1) == 0)
+			return true;
+	}
+
+	return (ioread32(edev->bar[0] + run_reg) & 1) == 0;
+}
+
 static void dma_block_read(struct example_dev *edev,
 		dma_addr_t dma_addr, size_t dma_offset,
 		size_t dma_offset_mask, size_t dma_stride,
@@ -58,8 +127,6 @@ static void dma_block_read(struct example_dev *edev,
 		size_t ram_offset_mask, size_t ram_stride,
 		size_t block_len, size_t block_count)
 {
-	unsigned long t;
-
 	// DMA base address
 	iowrite32(dma_addr & 0xffffffff, edev->bar[0] + 0x001080);
 	iowrite32((dma_addr >> 32) & 0xffffffff, edev->bar[0] + 0x001084);
@@ -95,13 +162,7 @@ static void dma_block_read(struct example_dev *edev,
 	iowrite32(1, edev->bar[0] + 0x001000);
 
 	// wait for transfer to complete
-	t = jiffies + msecs_to_jiffies(20000);
-	while (time_before(jiffies, t)) {
-		if ((ioread32(edev->bar[0] + 0x001000) & 1) == 0)
-			break;
-	}
-
-	if ((ioread32(edev->bar[0] + 0x001000) & 1) != 0)
+	if (!edev_block_wait(edev, 0x001000))
 		dev_warn(edev->dev, "%s: operation timed out", __func__);
 	if ((ioread32(edev->bar[0] + 0x000000) & 0x300) != 0)
 		dev_warn(edev->dev, "%s: DMA engine busy", __func__);
@@ -114,8 +175,6 @@ static void dma_block_write(struct example_dev *edev,
 		size_t ram_offset_mask, size_t ram_stride,
 		size_t block_len, size_t block_count)
 {
-	unsigned long t;
-
 	// DMA base address
 	iowrite32(dma_addr & 0xffffffff, edev->bar[0] + 0x001180);
 	iowrite32((dma_addr >> 32) & 0xffffffff, edev->bar[0] + 0x001184);
@@ -151,13 +210,7 @@ static void dma_block_write(struct example_dev *edev,
 	iowrite32(1, edev->bar[0] + 0x001100);
 
 	// wait for transfer to complete
-	t = jiffies + msecs_to_jiffies(20000);
-	while (time_before(jiffies, t)) {
-		if ((ioread32(edev->bar[0] + 0x001100) & 1) == 0)
-			break;
-	}
-
-	if ((ioread32(edev->bar[0] + 0x001100) & 1) != 0)
+	if (!edev_block_wait(edev, 0x001100))
 		dev_warn(edev->dev, "%s: operation timed out", __func__);
 	if ((ioread32(edev->bar[0] + 0x000000) & 0x300) != 0)
 		dev_warn(edev->dev, "%s: DMA engine busy", __func__);
@@ -215,7 +268,6 @@ static void dma_block_write_bench(struct example_dev *edev,
 static void dma_cpl_buf_test(struct example_dev *edev, dma_addr_t dma_addr,
 		u64 size, u64 stride, u64 count, int stall)
 {
-	unsigned long t;
 	u64 cycles;
 	u32 rd_req;
 	u32 rd_cpl;
@@ -265,13 +317,7 @@ static void dma_cpl_buf_test(struct example_dev *edev, dma_addr_t dma_addr,
 		msleep(10);
 
 	// wait for transfer to complete
-	t = jiffies + msecs_to_jiffies(20000);
-	while (time_before(jiffies, t)) {
-		if ((ioread32(edev->bar[0] + 0x001000) & 1) == 0)
-			break;
-	}
-
-	if ((ioread32(edev->bar[0] + 0x001000) & 1) != 0)
+	if (!edev_block_wait(edev, 0x001000))
 		dev_warn(edev->dev, "%s: operation timed out", __func__);
 	if ((ioread32(edev->bar[0] + 0x000000) & 0x300) != 0)
 		dev_warn(edev->dev, "%s: DMA engine busy", __func__);
@@ -509,6 +555,9 @@ static int edev_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 		dev_info(dev, "disable interrupts");
 		iowrite32(0x0, edev->bar[0] + 0x000008);
 
+		dev_info(dev, "enable block completion ring");
+		edev_cpl_ring_enable(edev);
+
 		dev_info(dev, "test RX completion buffer (CPLH, 8)");
 
 		size = 8;
@@ -613,6 +662,8 @@ static void edev_remove(struct pci_dev *pdev)
 
 	dev_info(dev, DRIVER_NAME " remove");
 
+	edev_cpl_ring_disable(edev);
+
 	pci_free_irq(pdev, 0, edev);
 	pci_free_irq_vectors(pdev);
 	free_bars(edev, pdev);
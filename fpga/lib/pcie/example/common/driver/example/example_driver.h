@@ -29,6 +29,9 @@
 #define DRIVER_NAME "edev"
 #define DRIVER_VERSION "0.1"
 
+#define EDEV_CPL_RING_LOG_SIZE 4
+#define EDEV_CPL_RING_SIZE (1 << EDEV_CPL_RING_LOG_SIZE)
+
 struct example_dev {
 	struct pci_dev *pdev;
 	struct device *dev;
@@ -43,6 +46,11 @@ struct example_dev {
 	dma_addr_t dma_region_addr;
 
 	int irqcount;
+
+	// block completion ring
+	__le32 *cpl_ring;
+	dma_addr_t cpl_ring_addr;
+	u32 cpl_ring_tail;
 };
 
 #endif /* EXAMPLE_DRIVER_H */
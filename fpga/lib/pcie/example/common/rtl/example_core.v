@@ -242,6 +242,7 @@ reg dma_write_desc_status_valid_reg = 0, dma_write_desc_status_valid_next;
 reg dma_enable_reg = 0, dma_enable_next;
 reg dma_rd_int_en_reg = 0, dma_rd_int_en_next;
 reg dma_wr_int_en_reg = 0, dma_wr_int_en_next;
+reg dma_blk_int_en_reg = 0, dma_blk_int_en_next;
 reg irq_valid_reg = 1'b0, irq_valid_next;
 
 reg rx_cpl_stall_reg = 1'b0, rx_cpl_stall_next;
@@ -273,6 +274,17 @@ reg [RAM_ADDR_WIDTH-1:0] dma_write_block_ram_offset_reg = 0, dma_write_block_ram
 reg [RAM_ADDR_WIDTH-1:0] dma_write_block_ram_offset_mask_reg = 0, dma_write_block_ram_offset_mask_next;
 reg [RAM_ADDR_WIDTH-1:0] dma_write_block_ram_stride_reg = 0, dma_write_block_ram_stride_next;
 
+// block completion ring in host memory, one 32 bit record per finished run:
+// [31] phase, [30] 0 = block read, 1 = block write, [29:0] run cycle count
+reg [DMA_ADDR_WIDTH-1:0] cpl_ring_base_addr_reg = 0, cpl_ring_base_addr_next;
+reg [3:0] cpl_ring_log_size_reg = 0, cpl_ring_log_size_next;
+reg cpl_ring_enable_reg = 1'b0, cpl_ring_enable_next;
+reg [15:0] cpl_ring_head_ptr_reg = 0, cpl_ring_head_ptr_next;
+reg dma_read_block_cpl_pending_reg = 1'b0, dma_read_block_cpl_pending_next;
+reg dma_write_block_cpl_pending_reg = 1'b0, dma_write_block_cpl_pending_next;
+reg [31:0] cpl_ring_record;
+reg cpl_ring_write_issue;
+
 assign s_axil_ctrl_awready = axil_ctrl_awready_reg;
 assign s_axil_ctrl_wready = axil_ctrl_wready_reg;
 assign s_axil_ctrl_bresp = axil_ctrl_bresp_reg;
@@ -339,6 +351,7 @@ always @* begin
 
     dma_rd_int_en_next = dma_rd_int_en_reg;
     dma_wr_int_en_next = dma_wr_int_en_reg;
+    dma_blk_int_en_next = dma_blk_int_en_reg;
 
     irq_valid_next = irq_valid_reg && !irq_ready;
 
@@ -371,6 +384,15 @@ always @* begin
     dma_write_block_ram_offset_mask_next = dma_write_block_ram_offset_mask_reg;
     dma_write_block_ram_stride_next = dma_write_block_ram_stride_reg;
 
+    cpl_ring_base_addr_next = cpl_ring_base_addr_reg;
+    cpl_ring_log_size_next = cpl_ring_log_size_reg;
+    cpl_ring_enable_next = cpl_ring_enable_reg;
+    cpl_ring_head_ptr_next = cpl_ring_head_ptr_reg;
+    dma_read_block_cpl_pending_next = dma_read_block_cpl_pending_reg;
+    dma_write_block_cpl_pending_next = dma_write_block_cpl_pending_reg;
+    cpl_ring_record = 0;
+    cpl_ring_write_issue = 1'b0;
+
     if (rx_cpl_stall_count_reg) begin
         rx_cpl_stall_count_next = rx_cpl_stall_count_reg - 1;
         rx_cpl_stall_next = 1'b1;
@@ -391,8 +413,18 @@ always @* begin
             16'h0008: begin
                 dma_rd_int_en_next = s_axil_ctrl_wdata[0];
                 dma_wr_int_en_next = s_axil_ctrl_wdata[1];
+                dma_blk_int_en_next = s_axil_ctrl_wdata[2];
             end
             16'h0040: rx_cpl_stall_count_next = s_axil_ctrl_wdata;
+            // block completion ring
+            16'h0080: cpl_ring_base_addr_next[31:0] = s_axil_ctrl_wdata;
+            16'h0084: cpl_ring_base_addr_next[63:32] = s_axil_ctrl_wdata;
+            16'h0088: begin
+                // records are immediate writes, so the ring needs DMA_IMM_ENABLE
+                cpl_ring_log_size_next = s_axil_ctrl_wdata[3:0];
+                cpl_ring_enable_next = DMA_IMM_ENABLE && s_axil_ctrl_wdata[31];
+                cpl_ring_head_ptr_next = 0;
+            end
             // single read
             16'h0100: dma_read_desc_dma_addr_next[31:0] = s_axil_ctrl_wdata;
             16'h0104: dma_read_desc_dma_addr_next[63:32] = s_axil_ctrl_wdata;
@@ -472,6 +504,7 @@ always @* begin
             16'h0008: begin
                 axil_ctrl_rdata_next[0] = dma_rd_int_en_reg;
                 axil_ctrl_rdata_next[1] = dma_wr_int_en_reg;
+                axil_ctrl_rdata_next[2] = dma_blk_int_en_reg;
             end
             16'h0010: axil_ctrl_rdata_next = cycle_count_reg;
             16'h0014: axil_ctrl_rdata_next = cycle_count_reg >> 32;
@@ -481,6 +514,14 @@ always @* begin
             16'h0024: axil_ctrl_rdata_next = dma_rd_cpl_count_reg;
             16'h0028: axil_ctrl_rdata_next = dma_wr_req_count_reg;
             16'h0040: axil_ctrl_rdata_next = rx_cpl_stall_count_reg;
+            // block completion ring
+            16'h0080: axil_ctrl_rdata_next = cpl_ring_base_addr_reg;
+            16'h0084: axil_ctrl_rdata_next = cpl_ring_base_addr_reg >> 32;
+            16'h0088: begin
+                axil_ctrl_rdata_next[3:0] = cpl_ring_log_size_reg;
+                axil_ctrl_rdata_next[31] = cpl_ring_enable_reg;
+            end
+            16'h008c: axil_ctrl_rdata_next = cpl_ring_head_ptr_reg;
             // single read
             16'h0100: axil_ctrl_rdata_next = dma_read_desc_dma_addr_reg;
             16'h0104: axil_ctrl_rdata_next = dma_read_desc_dma_addr_reg >> 32;
@@ -592,6 +633,7 @@ always @* begin
         if (dma_read_block_count_reg == 0) begin
             if (dma_read_active_count_reg == 0) begin
                 dma_read_block_run_next = 1'b0;
+                dma_read_block_cpl_pending_next = cpl_ring_enable_reg;
             end
         end else begin
             if (!dma_read_desc_valid_reg || m_axis_dma_read_desc_ready) begin
@@ -607,6 +649,32 @@ always @* begin
         end
     end
 
+    // block completion record, takes the write descriptor ahead of block writes
+    if ((dma_read_block_cpl_pending_reg || dma_write_block_cpl_pending_reg) && (!dma_write_desc_valid_reg || m_axis_dma_write_desc_ready)) begin
+        cpl_ring_write_issue = 1'b1;
+        dma_write_desc_dma_addr_next = cpl_ring_base_addr_reg + ((cpl_ring_head_ptr_reg & ((16'd1 << cpl_ring_log_size_reg) - 1)) << 2);
+        cpl_ring_record[31] = !(cpl_ring_head_ptr_reg & (16'd1 << cpl_ring_log_size_reg));
+        if (dma_read_block_cpl_pending_reg) begin
+            cpl_ring_record[30] = 1'b0;
+            cpl_ring_record[29:0] = dma_read_block_cycle_count_reg;
+            dma_read_block_cpl_pending_next = 1'b0;
+        end else begin
+            cpl_ring_record[30] = 1'b1;
+            cpl_ring_record[29:0] = dma_write_block_cycle_count_reg;
+            dma_write_block_cpl_pending_next = 1'b0;
+        end
+        dma_write_desc_ram_addr_imm_next = cpl_ring_record;
+        dma_write_desc_imm_en_next = 1'b1;
+        dma_write_desc_len_next = 4;
+        dma_write_desc_tag_next = 0;
+        dma_write_desc_valid_next = 1'b1;
+        cpl_ring_head_ptr_next = cpl_ring_head_ptr_reg + 1;
+
+        if (dma_blk_int_en_reg) begin
+            irq_valid_next = 1'b1;
+        end
+    end
+
     // block write
     if (dma_write_block_run_reg) begin
         dma_write_block_cycle_count_next = dma_write_block_cycle_count_reg + 1;
@@ -614,9 +682,10 @@ always @* begin
         if (dma_write_block_count_reg == 0) begin
             if (dma_write_active_count_reg == 0) begin
                 dma_write_block_run_next = 1'b0;
+                dma_write_block_cpl_pending_next = cpl_ring_enable_reg;
             end
         end else begin
-            if (!dma_write_desc_valid_reg || m_axis_dma_write_desc_ready) begin
+            if (!cpl_ring_write_issue && (!dma_write_desc_valid_reg || m_axis_dma_write_desc_ready)) begin
                 dma_write_block_dma_offset_next = dma_write_block_dma_offset_reg + dma_write_block_dma_stride_reg;
                 dma_write_desc_dma_addr_next = dma_write_block_dma_base_addr_reg + (dma_write_block_dma_offset_reg & dma_write_block_dma_offset_mask_reg);
                 dma_write_block_ram_offset_next = dma_write_block_ram_offset_reg + dma_write_block_ram_stride_reg;
@@ -679,6 +748,7 @@ always @(posedge clk) begin
 
     dma_rd_int_en_reg <= dma_rd_int_en_next;
     dma_wr_int_en_reg <= dma_wr_int_en_next;
+    dma_blk_int_en_reg <= dma_blk_int_en_next;
 
     irq_valid_reg <= irq_valid_next;
 
@@ -711,6 +781,13 @@ always @(posedge clk) begin
     dma_write_block_ram_offset_mask_reg <= dma_write_block_ram_offset_mask_next;
     dma_write_block_ram_stride_reg <= dma_write_block_ram_stride_next;
 
+    cpl_ring_base_addr_reg <= cpl_ring_base_addr_next;
+    cpl_ring_log_size_reg <= cpl_ring_log_size_next;
+    cpl_ring_enable_reg <= cpl_ring_enable_next;
+    cpl_ring_head_ptr_reg <= cpl_ring_head_ptr_next;
+    dma_read_block_cpl_pending_reg <= dma_read_block_cpl_pending_next;
+    dma_write_block_cpl_pending_reg <= dma_write_block_cpl_pending_next;
+
     if (rst) begin
         axil_ctrl_awready_reg <= 1'b0;
         axil_ctrl_wready_reg <= 1'b0;
@@ -732,11 +809,16 @@ always @(posedge clk) begin
         dma_enable_reg <= 1'b0;
         dma_rd_int_en_reg <= 1'b0;
         dma_wr_int_en_reg <= 1'b0;
+        dma_blk_int_en_reg <= 1'b0;
         irq_valid_reg <= 1'b0;
         rx_cpl_stall_reg <= 1'b0;
         rx_cpl_stall_count_reg <= 0;
         dma_read_block_run_reg <= 1'b0;
         dma_write_block_run_reg <= 1'b0;
+        cpl_ring_enable_reg <= 1'b0;
+        cpl_ring_head_ptr_reg <= 0;
+        dma_read_block_cpl_pending_reg <= 1'b0;
+        dma_write_block_cpl_pending_reg <= 1'b0;
     end
 end
 
@@ -388,6 +388,51 @@ async def run_test(dut):
 
     assert mem[src_offset:src_offset+region_len] == mem[dest_offset:dest_offset+region_len]
 
+    tb.log.info("Test DMA block completion ring")
+
+    cpl_offset = 0x8000
+    cpl_log_size = 1
+
+    mem[cpl_offset:cpl_offset+4*2**cpl_log_size] = bytearray(4*2**cpl_log_size)
+
+    # ring base address
+    await dev_pf0_bar0.write_dword(0x000080, (mem_base+cpl_offset) & 0xffffffff)
+    await dev_pf0_bar0.write_dword(0x000084, (mem_base+cpl_offset >> 32) & 0xffffffff)
+    # ring size and enable
+    await dev_pf0_bar0.write_dword(0x000088, 0x80000000 | cpl_log_size)
+
+    val = await dev_pf0_bar0.read_dword(0x000088)
+    assert val == 0x80000000 | cpl_log_size
+
+    # read, write, then read again to wrap the ring and flip the phase
+    for k, base in enumerate([0x001000, 0x001100, 0x001000]):
+        await dev_pf0_bar0.write_dword(base+0x008, 0)
+        await dev_pf0_bar0.write_dword(base+0x00c, 0)
+        await dev_pf0_bar0.write_dword(base+0x018, block_count)
+        await dev_pf0_bar0.write_dword(base+0x000, 1)
+
+        ptr = cpl_offset + 4*(k % 2**cpl_log_size)
+        phase = 0 if k < 2**cpl_log_size else 1
+
+        for j in range(10):
+            await Timer(1000, 'ns')
+            rec = int.from_bytes(mem[ptr:ptr+4], 'little')
+            if (rec >> 31) != phase:
+                break
+
+        tb.log.info("Completion record: 0x%08x", rec)
+
+        assert (rec >> 31) != phase
+        assert (rec >> 30) & 1 == (1 if base == 0x001100 else 0)
+
+        cycles = await dev_pf0_bar0.read_dword(base+0x008)
+        assert rec & 0x3fffffff == cycles & 0x3fffffff
+
+    val = await dev_pf0_bar0.read_dword(0x00008c)
+    assert val == 3
+
+    await dev_pf0_bar0.write_dword(0x000088, 0)
+
     await RisingEdge(dut.clk)
     await RisingEdge(dut.clk)
 
@@ -87,9 +87,9 @@ static int mqnic_try_open(struct mqnic *dev, const char *fmt, ...)
     if (dev->regs_size == 0)
     {
         // miscdevice
-        off_t regs_offset = 0;
         off_t app_regs_offset = 0;
         off_t ram_offset = 0;
+        int app_regs_wc = 0;
 
         if (ioctl(dev->fd, MQNIC_IOCTL_GET_API_VERSION, 0) != MQNIC_IOCTL_API_VERSION)
         {
@@ -122,24 +122,52 @@ static int mqnic_try_open(struct mqnic *dev, const char *fmt, ...)
 
             switch (region_info.type) {
             case MQNIC_REGION_TYPE_NIC_CTRL:
-                regs_offset = region_info.offset;
+                dev->regs_offset = region_info.offset;
                 dev->regs_size = region_info.size;
                 break;
             case MQNIC_REGION_TYPE_APP_CTRL:
                 app_regs_offset = region_info.offset;
                 dev->app_regs_size = region_info.size;
+                app_regs_wc = region_info.flags & MQNIC_REGION_FLAG_WC;
                 break;
             case MQNIC_REGION_TYPE_RAM:
                 ram_offset = region_info.offset;
                 dev->ram_size = region_info.size;
                 break;
+            case MQNIC_REGION_TYPE_PTR_SHADOW:
+                // optional, registers are read directly without it
+                if (region_info.size && region_info.index >= 3 && region_info.index - 3 < MQNIC_MAX_IF)
+                {
+                    int n = region_info.index - 3;
+                    void *ptr = mmap(NULL, region_info.size, PROT_READ, MAP_SHARED, dev->fd, region_info.offset);
+
+                    if (ptr != MAP_FAILED)
+                    {
+                        dev->ptr_shadow[n] = (volatile struct mqnic_ptr_shadow *)ptr;
+                        dev->ptr_shadow_size[n] = region_info.size;
+                    }
+                }
+                break;
+            case MQNIC_REGION_TYPE_STATS:
+                // optional, counters are read from registers without it
+                if (region_info.size)
+                {
+                    void *ptr = mmap(NULL, region_info.size, PROT_READ, MAP_SHARED, dev->fd, region_info.offset);
+
+                    if (ptr != MAP_FAILED)
+                    {
+                        dev->stats_dma = (volatile struct mqnic_stats_dma_hdr *)ptr;
+                        dev->stats_dma_size = region_info.size;
+                    }
+                }
+                break;
             default:
                 break;
             }
         }
 
         // map registers
-        dev->regs = (volatile uint8_t *)mmap(NULL, dev->regs_size, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, regs_offset);
+        dev->regs = (volatile uint8_t *)mmap(NULL, dev->regs_size, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, dev->regs_offset);
         if (dev->regs == MAP_FAILED)
         {
             perror("mmap regs failed");
@@ -157,6 +185,14 @@ static int mqnic_try_open(struct mqnic *dev, const char *fmt, ...)
             }
         }
 
+        // optional write-combined view for bulk table loads
+        if (dev->app_regs_size && app_regs_wc)
+        {
+            dev->app_regs_wc = (volatile uint8_t *)mmap(NULL, dev->app_regs_size, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, app_regs_offset | MQNIC_REGION_OFFSET_WC);
+            if (dev->app_regs_wc == MAP_FAILED)
+                dev->app_regs_wc = NULL;
+        }
+
         // map RAM
         if (dev->ram_size)
         {
@@ -171,6 +207,7 @@ static int mqnic_try_open(struct mqnic *dev, const char *fmt, ...)
     else
     {
         // PCIe resource
+        dev->regs_offset = 0;
 
         // map registers
         dev->regs = (volatile uint8_t *)mmap(NULL, dev->regs_size, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, 0);
@@ -253,7 +290,11 @@ static int mqnic_try_open(struct mqnic *dev, const char *fmt, ...)
         goto fail_reset;
     }
 
-    dev->rb_list = mqnic_enumerate_reg_block_list(dev->regs, 0, dev->regs_size);
+    // the FW ID block leads the list and keys the layout cache
+    if (mqnic_reg_read32(dev->regs, MQNIC_RB_REG_TYPE) == MQNIC_RB_FW_ID_TYPE)
+        mqnic_rb_cache_load(dev);
+
+    dev->rb_list = mqnic_rb_cache_enumerate(dev, dev->regs, 0, dev->regs_size);
 
     if (!dev->rb_list)
     {
@@ -275,11 +316,16 @@ static int mqnic_try_open(struct mqnic *dev, const char *fmt, ...)
 fail_enum:
     if (dev->rb_list)
         mqnic_free_reg_block_list(dev->rb_list);
+    dev->rb_list = NULL;
+    mqnic_rb_cache_free(dev);
 fail_reset:
 fail_mmap_regs:
     if (dev->ram)
         munmap((void *)dev->ram, dev->ram_size);
     dev->ram = NULL;
+    if (dev->app_regs_wc)
+        munmap((void *)dev->app_regs_wc, dev->app_regs_size);
+    dev->app_regs_wc = NULL;
     if (dev->app_regs)
         munmap((void *)dev->app_regs, dev->app_regs_size);
     dev->app_regs = NULL;
@@ -287,6 +333,15 @@ fail_mmap_regs:
         munmap((void *)dev->regs, dev->regs_size);
     dev->regs = NULL;
 fail_ioctl:
+    for (int k = 0; k < MQNIC_MAX_IF; k++)
+    {
+        if (dev->ptr_shadow[k])
+            munmap((void *)dev->ptr_shadow[k], dev->ptr_shadow_size[k]);
+        dev->ptr_shadow[k] = NULL;
+    }
+    if (dev->stats_dma)
+        munmap((void *)dev->stats_dma, dev->stats_dma_size);
+    dev->stats_dma = NULL;
 fail_fstat:
     close(dev->fd);
     dev->fd = -1;
@@ -414,7 +469,7 @@ open:
     mqnic_stats_init(dev);
     mqnic_clk_info_init(dev);
 
-    dev->phc_rb = mqnic_find_reg_block(dev->rb_list, MQNIC_RB_PHC_TYPE, MQNIC_RB_PHC_VER, 0);
+    mqnic_phc_init(dev);
 
     // Enumerate interfaces
     dev->if_rb = mqnic_find_reg_block(dev->rb_list, MQNIC_RB_IF_TYPE, MQNIC_RB_IF_VER, 0);
@@ -434,18 +489,7 @@ open:
     if (dev->if_count > MQNIC_MAX_IF)
         dev->if_count = MQNIC_MAX_IF;
 
-    for (int k = 0; k < dev->if_count; k++)
-    {
-        struct mqnic_if *interface = mqnic_if_open(dev, k, dev->regs + dev->if_offset + k*dev->if_stride);
-
-        if (!interface)
-        {
-            fprintf(stderr, "Failed to create interface %d, skipping\n", k);
-            continue;
-        }
-
-        dev->interfaces[k] = interface;
-    }
+    // interfaces are opened on first use, most tools need one or none
 
 skip_interface:
     return dev;
@@ -456,6 +500,22 @@ fail_alloc:
     return NULL;
 }
 
+struct mqnic_if *mqnic_get_interface(struct mqnic *dev, int index)
+{
+    if (index < 0 || index >= dev->if_count)
+        return NULL;
+
+    if (!dev->interfaces[index])
+    {
+        dev->interfaces[index] = mqnic_if_open(dev, index, dev->regs + dev->if_offset + index*dev->if_stride);
+
+        if (!dev->interfaces[index])
+            fprintf(stderr, "Failed to create interface %d\n", index);
+    }
+
+    return dev->interfaces[index];
+}
+
 void mqnic_close(struct mqnic *dev)
 {
     if (!dev)
@@ -473,8 +533,22 @@ void mqnic_close(struct mqnic *dev)
     if (dev->rb_list)
         mqnic_free_reg_block_list(dev->rb_list);
 
+    mqnic_rb_cache_save(dev);
+    mqnic_rb_cache_free(dev);
+
+    for (int k = 0; k < MQNIC_MAX_IF; k++)
+    {
+        if (dev->ptr_shadow[k])
+            munmap((void *)dev->ptr_shadow[k], dev->ptr_shadow_size[k]);
+    }
+
+    if (dev->stats_dma)
+        munmap((void *)dev->stats_dma, dev->stats_dma_size);
+
     if (dev->ram)
         munmap((void *)dev->ram, dev->ram_size);
+    if (dev->app_regs_wc)
+        munmap((void *)dev->app_regs_wc, dev->app_regs_size);
     if (dev->app_regs)
         munmap((void *)dev->app_regs, dev->app_regs_size);
     if (dev->regs)
@@ -507,3 +581,35 @@ void mqnic_print_fw_id(struct mqnic *dev)
     if (dev->app_id)
         printf("Application ID: 0x%08x\n", dev->app_id);
 }
+
+int mqnic_app_write_table(struct mqnic *dev, size_t offset, const uint32_t *words, size_t count)
+{
+    if (!dev->app_regs || (offset & 3) || offset + count*4 > dev->app_regs_size)
+        return -1;
+
+    // the driver streams the image in a single call
+    if (dev->app_fd < 0)
+    {
+        struct mqnic_ioctl_reg_write info;
+
+        info.argsz = sizeof(info);
+        info.flags = 0;
+        info.index = 1;
+        info.count = count;
+        info.offset = offset;
+        info.data = (uintptr_t)words;
+
+        if (ioctl(dev->fd, MQNIC_IOCTL_REG_WRITE, &info) == 0)
+            return 0;
+    }
+
+    // PCIe resource or older driver
+    volatile uint32_t *dst = (volatile uint32_t *)((dev->app_regs_wc ? dev->app_regs_wc : dev->app_regs) + offset);
+
+    for (size_t k = 0; k < count; k++)
+        dst[k] = words[k];
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return 0;
+}
@@ -12,6 +12,8 @@
 #include "mqnic_hw.h"
 #include "reg_block.h"
 
+#define MQNIC_MAX_PEROUT 8
+
 #define mqnic_reg_read32(base, reg) (((volatile uint32_t *)(base))[(reg)/4])
 #define mqnic_reg_write32(base, reg, val) (((volatile uint32_t *)(base))[(reg)/4]) = val
 #define mqnic_reg_read16(base, reg) (((volatile uint16_t *)(base))[(reg)/2])
@@ -20,11 +22,15 @@
 #define mqnic_reg_write8(base, reg, val) (((volatile uint8_t *)(base))[reg]) = val
 
 struct mqnic;
+struct mqnic_rb_cache;
 
 struct mqnic_res {
     unsigned int count;
     volatile uint8_t *base;
     unsigned int stride;
+
+    // pointer write-back slots, indexed like the queues
+    volatile struct mqnic_ptr_shadow *shadow;
 };
 
 struct mqnic_sched {
@@ -106,6 +112,7 @@ struct mqnic_if {
     struct mqnic_res *txq_res;
     struct mqnic_res *rxq_res;
 
+    // opened on first use, see mqnic_if_get_port() and mqnic_if_get_sched_block()
     uint32_t port_count;
     struct mqnic_port *ports[MQNIC_MAX_PORTS];
 
@@ -120,13 +127,19 @@ struct mqnic {
 
     size_t regs_size;
     volatile uint8_t *regs;
+    // file offset of the register mapping on fd
+    off_t regs_offset;
 
     size_t app_regs_size;
     volatile uint8_t *app_regs;
+    volatile uint8_t *app_regs_wc;
 
     size_t ram_size;
     volatile uint8_t *ram;
 
+    // register block layout cache, NULL when disabled
+    struct mqnic_rb_cache *rb_cache;
+
     struct mqnic_reg_block *rb_list;
     struct mqnic_reg_block *fw_id_rb;
     struct mqnic_reg_block *if_rb;
@@ -134,6 +147,9 @@ struct mqnic {
     struct mqnic_reg_block *clk_info_rb;
     struct mqnic_reg_block *phc_rb;
 
+    uint32_t phc_perout_count;
+    struct mqnic_reg_block *phc_perout_rb[MQNIC_MAX_PEROUT];
+
     uint32_t fpga_id;
     const char *fpga_part;
     uint32_t fw_id;
@@ -166,26 +182,162 @@ struct mqnic {
 
     char build_date_str[32];
 
+    // opened on first use, see mqnic_get_interface()
     struct mqnic_if *interfaces[MQNIC_MAX_IF];
 
+    // read-only pointer write-back areas, one per interface
+    size_t ptr_shadow_size[MQNIC_MAX_IF];
+    volatile struct mqnic_ptr_shadow *ptr_shadow[MQNIC_MAX_IF];
+
+    // read-only statistics write-back buffer, NULL when off
+    size_t stats_dma_size;
+    volatile struct mqnic_stats_dma_hdr *stats_dma;
+
     char device_path[PATH_MAX];
     char pci_device_path[PATH_MAX];
 };
 
+// PHC reader with a read-only view of the PHC registers and a cycle counter
+// to PHC time mapping; a reader is not thread safe, use one per thread
+struct mqnic_phc {
+    struct mqnic *mqnic;
+
+    volatile uint8_t *regs;
+    void *map;
+    size_t map_size;
+
+    // PHC ns = base_ns + (cycles - base_cycles) * mult / 2^32
+    uint64_t base_cycles;
+    uint64_t base_ns;
+    uint64_t mult;
+
+    // mqnic_phc_read_fast() recalibrates once this much PHC time has
+    // passed; 0 leaves it to explicit mqnic_phc_calibrate() calls
+    uint64_t cal_interval_ns;
+    uint64_t next_cal_cycles;
+};
+
+struct mqnic_dma_buf {
+    struct mqnic *mqnic;
+
+    size_t size;
+    void *vaddr;
+    uint64_t iova;
+};
+
+// one PHC periodic output, relative to a common start time
+struct mqnic_perout_config {
+    int enable;
+    int64_t phase_ns;
+    uint64_t period_ns;
+    uint64_t width_ns; // 0 for half the period
+};
+
+struct mqnic_pkt {
+    void *data;
+    uint64_t iova;
+    uint32_t len;
+};
+
+struct mqnic_uq {
+    int index;
+    int cqn;
+
+    uint32_t size;
+    uint32_t size_mask;
+    uint32_t stride;
+    uint32_t cq_stride;
+
+    uint32_t prod_ptr;
+    uint32_t cons_ptr;
+    uint32_t cq_cons_ptr;
+
+    uint8_t *buf;
+    uint64_t buf_iova;
+    uint8_t *cq_buf;
+    uint64_t cq_iova;
+
+    volatile uint8_t *regs;
+    volatile uint8_t *cq_regs;
+};
+
+struct mqnic_queue_pair {
+    struct mqnic_if *interface;
+    struct mqnic_sched *sched;
+
+    int port;
+
+    struct mqnic_uq tx;
+    struct mqnic_uq rx;
+
+    struct mqnic_dma_buf *dma;
+
+    uint32_t rx_buf_size;
+    uint8_t *rx_bufs;
+    uint64_t rx_bufs_iova;
+};
+
+// capture filter: frames from the ports in port_mask whose bytes offset to
+// offset+15 equal match under mask
+struct mqnic_capture_filter {
+    uint32_t port_mask;
+    uint32_t offset;
+    uint8_t match[MQNIC_RX_CAPTURE_MATCH_SIZE];
+    uint8_t mask[MQNIC_RX_CAPTURE_MATCH_SIZE];
+};
+
+struct mqnic_capture_pkt {
+    const void *data;
+    uint32_t len;
+    uint32_t orig_len;
+    uint64_t ts_ns;
+    int port;
+};
+
+struct mqnic_capture {
+    struct mqnic_if *interface;
+
+    struct mqnic_uq rx;
+
+    struct mqnic_dma_buf *dma;
+
+    uint32_t buf_size;
+    uint8_t *bufs;
+    uint64_t bufs_iova;
+
+    int rule;
+
+    // PHC seconds the 16-bit completion seconds are widened against,
+    // refreshed every MQNIC_CAPTURE_TOD_REFRESH_S
+    uint64_t tod_s;
+    uint64_t tod_mono_s;
+};
+
 // mqnic.c
 struct mqnic *mqnic_open(const char *dev_name);
 void mqnic_close(struct mqnic *dev);
+struct mqnic_if *mqnic_get_interface(struct mqnic *dev, int index);
 void mqnic_print_fw_id(struct mqnic *dev);
+int mqnic_app_write_table(struct mqnic *dev, size_t offset, const uint32_t *words, size_t count);
+
+// mqnic_rb_cache.c
+void mqnic_rb_cache_load(struct mqnic *dev);
+void mqnic_rb_cache_save(struct mqnic *dev);
+void mqnic_rb_cache_free(struct mqnic *dev);
+struct mqnic_reg_block *mqnic_rb_cache_enumerate(struct mqnic *dev, volatile uint8_t *base, size_t offset, size_t size);
 
 // mqnic_res.c
 struct mqnic_res *mqnic_res_open(unsigned int count, volatile uint8_t *base, unsigned int stride);
 void mqnic_res_close(struct mqnic_res *res);
 unsigned int mqnic_res_get_count(struct mqnic_res *res);
 volatile uint8_t *mqnic_res_get_addr(struct mqnic_res *res, int index);
+uint32_t mqnic_res_read_ptr(struct mqnic_res *res, int index, int reg);
 
 // mqnic_if.c
 struct mqnic_if *mqnic_if_open(struct mqnic *dev, int index, volatile uint8_t *regs);
 void mqnic_if_close(struct mqnic_if *interface);
+struct mqnic_port *mqnic_if_get_port(struct mqnic_if *interface, int index);
+struct mqnic_sched_block *mqnic_if_get_sched_block(struct mqnic_if *interface, int index);
 uint32_t mqnic_interface_get_tx_mtu(struct mqnic_if *interface);
 uint32_t mqnic_interface_get_rx_mtu(struct mqnic_if *interface);
 uint32_t mqnic_interface_get_rx_queue_map_rss_mask(struct mqnic_if *interface, int port);
@@ -220,8 +372,37 @@ uint64_t mqnic_core_clk_ns_to_cycles(struct mqnic *dev, uint64_t ns);
 uint64_t mqnic_ref_clk_cycles_to_ns(struct mqnic *dev, uint64_t cycles);
 uint64_t mqnic_ref_clk_ns_to_cycles(struct mqnic *dev, uint64_t ns);
 
+// mqnic_phc.c
+void mqnic_phc_init(struct mqnic *dev);
+int mqnic_phc_read_tod(struct mqnic *dev, uint64_t *tod_ns);
+struct mqnic_phc *mqnic_phc_open(struct mqnic *dev);
+void mqnic_phc_close(struct mqnic_phc *phc);
+int mqnic_phc_read(struct mqnic_phc *phc, uint64_t *tod_ns);
+int mqnic_phc_calibrate(struct mqnic_phc *phc);
+uint64_t mqnic_phc_read_fast(struct mqnic_phc *phc);
+int mqnic_perout_get_count(struct mqnic *dev);
+int mqnic_perout_disable(struct mqnic *dev, int index);
+int mqnic_perout_arm(struct mqnic *dev, const struct mqnic_perout_config *config, int count,
+        uint64_t start_ns, uint64_t min_lead_ns);
+
 // mqnic_stats.c
 void mqnic_stats_init(struct mqnic *dev);
 uint64_t mqnic_stats_read(struct mqnic *dev, int index);
+uint32_t mqnic_stats_dma_gen(struct mqnic *dev);
+int mqnic_stats_read_bulk(struct mqnic *dev, int index, uint64_t *buf, int count);
+int mqnic_stats_snapshot(struct mqnic *dev, uint64_t *buf, int count);
+const char *mqnic_stats_name(int index);
+
+// mqnic_queue.c
+struct mqnic_dma_buf *mqnic_dma_alloc(struct mqnic *dev, size_t size);
+void mqnic_dma_free(struct mqnic_dma_buf *buf);
+struct mqnic_queue_pair *mqnic_queue_pair_open(struct mqnic_if *interface, int port, uint32_t size, uint32_t rx_buf_size);
+void mqnic_queue_pair_close(struct mqnic_queue_pair *qp);
+int mqnic_tx_burst(struct mqnic_queue_pair *qp, const struct mqnic_pkt *pkts, int count);
+int mqnic_tx_complete(struct mqnic_queue_pair *qp);
+int mqnic_rx_burst(struct mqnic_queue_pair *qp, struct mqnic_pkt *pkts, int count);
+struct mqnic_capture *mqnic_capture_open(struct mqnic_if *interface, const struct mqnic_capture_filter *filter, uint32_t size, uint32_t snaplen);
+void mqnic_capture_close(struct mqnic_capture *cap);
+int mqnic_capture_burst(struct mqnic_capture *cap, struct mqnic_capture_pkt *pkts, int count);
 
 #endif /* MQNIC_H */
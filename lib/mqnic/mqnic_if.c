@@ -32,7 +32,7 @@ struct mqnic_if *mqnic_if_open(struct mqnic *dev, int index, volatile uint8_t *r
     }
 
     // Enumerate registers
-    interface->rb_list = mqnic_enumerate_reg_block_list(interface->regs, dev->if_csr_offset, interface->regs_size);
+    interface->rb_list = mqnic_rb_cache_enumerate(dev, interface->regs, dev->if_csr_offset, interface->regs_size);
 
     if (!interface->rb_list)
     {
@@ -56,6 +56,12 @@ struct mqnic_if *mqnic_if_open(struct mqnic *dev, int index, volatile uint8_t *r
     interface->tx_fifo_depth = mqnic_reg_read32(interface->if_ctrl_rb->regs, MQNIC_RB_IF_CTRL_REG_TX_FIFO_DEPTH);
     interface->rx_fifo_depth = mqnic_reg_read32(interface->if_ctrl_rb->regs, MQNIC_RB_IF_CTRL_REG_RX_FIFO_DEPTH);
 
+    if (interface->port_count > MQNIC_MAX_PORTS)
+        interface->port_count = MQNIC_MAX_PORTS;
+
+    if (interface->sched_block_count > MQNIC_MAX_PORTS)
+        interface->sched_block_count = MQNIC_MAX_PORTS;
+
     interface->eq_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_EQM_TYPE, MQNIC_RB_EQM_VER, 0);
 
     if (!interface->eq_rb)
@@ -136,6 +142,24 @@ struct mqnic_if *mqnic_if_open(struct mqnic *dev, int index, volatile uint8_t *r
     if (!interface->rxq_res)
         goto fail;
 
+    // same slot order as the driver: EQs, CQs, TXQs, RXQs
+    if (dev->ptr_shadow[index])
+    {
+        interface->eq_res->shadow = dev->ptr_shadow[index];
+        interface->cq_res->shadow = interface->eq_res->shadow + interface->eq_res->count;
+        interface->txq_res->shadow = interface->cq_res->shadow + interface->cq_res->count;
+        interface->rxq_res->shadow = interface->txq_res->shadow + interface->txq_res->count;
+
+        if ((interface->rxq_res->shadow + interface->rxq_res->count - dev->ptr_shadow[index]) *
+                sizeof(struct mqnic_ptr_shadow) > dev->ptr_shadow_size[index])
+        {
+            interface->eq_res->shadow = NULL;
+            interface->cq_res->shadow = NULL;
+            interface->txq_res->shadow = NULL;
+            interface->rxq_res->shadow = NULL;
+        }
+    }
+
     interface->rx_queue_map_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_RX_QUEUE_MAP_TYPE, MQNIC_RB_RX_QUEUE_MAP_VER, 0);
 
     if (!interface->rx_queue_map_rb)
@@ -153,38 +177,6 @@ struct mqnic_if *mqnic_if_open(struct mqnic *dev, int index, volatile uint8_t *r
             MQNIC_RB_RX_QUEUE_MAP_CH_STRIDE*k + MQNIC_RB_RX_QUEUE_MAP_CH_REG_OFFSET);
     }
 
-    for (int k = 0; k < interface->port_count; k++)
-    {
-        struct mqnic_reg_block *port_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_PORT_TYPE, MQNIC_RB_PORT_VER, k);
-        struct mqnic_port *port;
-
-        if (!port_rb)
-            goto fail;
-
-        port = mqnic_port_open(interface, k, port_rb);
-
-        if (!port)
-            goto fail;
-
-        interface->ports[k] = port;
-    }
-
-    for (int k = 0; k < interface->sched_block_count; k++)
-    {
-        struct mqnic_reg_block *sched_block_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_SCHED_BLOCK_TYPE, MQNIC_RB_SCHED_BLOCK_VER, k);
-        struct mqnic_sched_block *sched_block;
-
-        if (!sched_block_rb)
-            goto fail;
-
-        sched_block = mqnic_sched_block_open(interface, k, sched_block_rb);
-
-        if (!sched_block)
-            goto fail;
-
-        interface->sched_blocks[k] = sched_block;
-    }
-
     return interface;
 
 fail:
@@ -226,6 +218,48 @@ void mqnic_if_close(struct mqnic_if *interface)
     free(interface);
 }
 
+struct mqnic_port *mqnic_if_get_port(struct mqnic_if *interface, int index)
+{
+    struct mqnic_reg_block *port_rb;
+
+    if (index < 0 || index >= interface->port_count)
+        return NULL;
+
+    if (interface->ports[index])
+        return interface->ports[index];
+
+    port_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_PORT_TYPE, MQNIC_RB_PORT_VER, index);
+
+    if (port_rb)
+        interface->ports[index] = mqnic_port_open(interface, index, port_rb);
+
+    if (!interface->ports[index])
+        fprintf(stderr, "Failed to create port %d\n", index);
+
+    return interface->ports[index];
+}
+
+struct mqnic_sched_block *mqnic_if_get_sched_block(struct mqnic_if *interface, int index)
+{
+    struct mqnic_reg_block *sched_block_rb;
+
+    if (index < 0 || index >= interface->sched_block_count)
+        return NULL;
+
+    if (interface->sched_blocks[index])
+        return interface->sched_blocks[index];
+
+    sched_block_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_SCHED_BLOCK_TYPE, MQNIC_RB_SCHED_BLOCK_VER, index);
+
+    if (sched_block_rb)
+        interface->sched_blocks[index] = mqnic_sched_block_open(interface, index, sched_block_rb);
+
+    if (!interface->sched_blocks[index])
+        fprintf(stderr, "Failed to create scheduler block %d\n", index);
+
+    return interface->sched_blocks[index];
+}
+
 uint32_t mqnic_interface_get_tx_mtu(struct mqnic_if *interface)
 {
     return mqnic_reg_read32(interface->if_ctrl_rb->regs, MQNIC_RB_IF_CTRL_REG_TX_MTU);
@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "mqnic.h"
+
+#define NSEC_PER_SEC 1000000000ull
+
+void mqnic_phc_init(struct mqnic *dev)
+{
+    struct mqnic_reg_block *rb;
+
+    dev->phc_rb = mqnic_find_reg_block(dev->rb_list, MQNIC_RB_PHC_TYPE, MQNIC_RB_PHC_VER, 0);
+
+    dev->phc_perout_count = 0;
+
+    if (!dev->phc_rb)
+        return;
+
+    while (dev->phc_perout_count < MQNIC_MAX_PEROUT && (rb = mqnic_find_reg_block(dev->rb_list,
+            MQNIC_RB_PHC_PEROUT_TYPE, MQNIC_RB_PHC_PEROUT_VER, dev->phc_perout_count)))
+    {
+        dev->phc_perout_rb[dev->phc_perout_count++] = rb;
+    }
+}
+
+int mqnic_phc_read_tod(struct mqnic *dev, uint64_t *tod_ns)
+{
+    uint64_t sec;
+    uint32_t ns;
+
+    if (!dev->phc_rb)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    // reading the fractional ns field latches the whole snapshot
+    mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_SNAP_FNS);
+    ns = mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_SNAP_TOD_NS);
+    sec = mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_SNAP_TOD_SEC_L);
+    sec |= (uint64_t)mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_SNAP_TOD_SEC_H) << 32;
+
+    *tod_ns = sec * NSEC_PER_SEC + ns;
+    return 0;
+}
+
+/*
+ * Userspace PHC reader.
+ *
+ * mqnic_phc_read() reads the free-running current ToD registers through a
+ * read-only mapping of the PHC block, with no system call.  The snapshot
+ * registers are left alone since the driver latches them too; instead the
+ * seconds are read on both sides of the ns field and the read is retried
+ * if they differ.  That still costs four non-posted MMIO reads, so
+ * mqnic_phc_read_fast() extrapolates from the CPU cycle counter (the TSC
+ * on x86, which must be invariant, the generic timer on arm64) along a
+ * line through the last two calibration points, for the cost of a counter
+ * read and a multiply.  It follows frequency adjustments of the PHC with
+ * one calibration interval of lag, and steps of the PHC once recalibrated.
+ */
+
+#define MQNIC_PHC_CAL_SAMPLES 8
+#define MQNIC_PHC_CAL_MIN_NS 1000000ull
+
+static inline uint64_t mqnic_phc_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t val;
+
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r" (val) :: "memory");
+    return val;
+#else
+    struct timespec ts;
+
+    // vDSO, no system call
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+static void mqnic_phc_read_cur(volatile uint8_t *regs, uint64_t *tod_ns)
+{
+    uint32_t sec_l, sec_h, ns;
+
+    do {
+        sec_l = mqnic_reg_read32(regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_L);
+        ns = mqnic_reg_read32(regs, MQNIC_RB_PHC_REG_CUR_TOD_NS);
+        sec_h = mqnic_reg_read32(regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_H);
+    } while (mqnic_reg_read32(regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_L) != sec_l);
+
+    *tod_ns = (((uint64_t)sec_h << 32) | sec_l) * NSEC_PER_SEC + ns;
+}
+
+// the read bracketed most tightly by the cycle counter, taken at its midpoint
+static void mqnic_phc_sample(struct mqnic_phc *phc, uint64_t *cycles, uint64_t *tod_ns)
+{
+    uint64_t best = UINT64_MAX;
+
+    *cycles = 0;
+    *tod_ns = 0;
+
+    for (int k = 0; k < MQNIC_PHC_CAL_SAMPLES; k++)
+    {
+        uint64_t c0, c1, ns;
+
+        c0 = mqnic_phc_cycles();
+        mqnic_phc_read_cur(phc->regs, &ns);
+        c1 = mqnic_phc_cycles();
+
+        if (c1 - c0 < best)
+        {
+            best = c1 - c0;
+            *cycles = c0 + (c1 - c0) / 2;
+            *tod_ns = ns;
+        }
+    }
+}
+
+struct mqnic_phc *mqnic_phc_open(struct mqnic *dev)
+{
+    struct mqnic_phc *phc;
+    struct timespec ts = {0, 10000000};
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t offset;
+
+    if (!dev->phc_rb)
+    {
+        errno = ENODEV;
+        return NULL;
+    }
+
+    phc = calloc(1, sizeof(*phc));
+    if (!phc)
+        return NULL;
+
+    phc->mqnic = dev;
+    phc->cal_interval_ns = NSEC_PER_SEC;
+
+    // private read-only view, falling back on the shared mapping
+    offset = dev->phc_rb->regs - dev->regs;
+    phc->map_size = (offset % page_size + MQNIC_RB_PHC_REG_PERIOD_FNS + 4 + page_size - 1) / page_size * page_size;
+    phc->map = mmap(NULL, phc->map_size, PROT_READ, MAP_SHARED, dev->fd,
+            dev->regs_offset + offset / page_size * page_size);
+
+    if (phc->map == MAP_FAILED)
+    {
+        phc->map = NULL;
+        phc->regs = dev->phc_rb->regs;
+    }
+    else
+    {
+        phc->regs = (volatile uint8_t *)phc->map + offset % page_size;
+    }
+
+    // two points 10 ms apart for the initial rate
+    mqnic_phc_sample(phc, &phc->base_cycles, &phc->base_ns);
+    nanosleep(&ts, NULL);
+
+    if (mqnic_phc_calibrate(phc))
+    {
+        mqnic_phc_close(phc);
+        return NULL;
+    }
+
+    return phc;
+}
+
+void mqnic_phc_close(struct mqnic_phc *phc)
+{
+    if (!phc)
+        return;
+
+    if (phc->map)
+        munmap(phc->map, phc->map_size);
+
+    free(phc);
+}
+
+int mqnic_phc_read(struct mqnic_phc *phc, uint64_t *tod_ns)
+{
+    mqnic_phc_read_cur(phc->regs, tod_ns);
+    return 0;
+}
+
+/*
+ * Take a new calibration point.  The rate comes from the previous point
+ * when it is at least 1 ms older; the line then runs through the new one.
+ */
+int mqnic_phc_calibrate(struct mqnic_phc *phc)
+{
+    uint64_t cycles, ns;
+
+    mqnic_phc_sample(phc, &cycles, &ns);
+
+    if (cycles <= phc->base_cycles)
+    {
+        // cycle counter went backwards, e.g. migration to an unsynced CPU
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (ns > phc->base_ns + MQNIC_PHC_CAL_MIN_NS)
+        phc->mult = (((unsigned __int128)(ns - phc->base_ns)) << 32) / (cycles - phc->base_cycles);
+    else if (!phc->mult)
+        return 0;
+
+    phc->base_cycles = cycles;
+    phc->base_ns = ns;
+
+    if (phc->cal_interval_ns && phc->mult)
+        phc->next_cal_cycles = cycles + (((unsigned __int128)phc->cal_interval_ns) << 32) / phc->mult;
+    else
+        phc->next_cal_cycles = UINT64_MAX;
+
+    return 0;
+}
+
+uint64_t mqnic_phc_read_fast(struct mqnic_phc *phc)
+{
+    uint64_t cycles = mqnic_phc_cycles();
+    int64_t delta;
+
+    if (cycles >= phc->next_cal_cycles && !mqnic_phc_calibrate(phc))
+        return phc->base_ns;
+
+    delta = cycles - phc->base_cycles;
+
+    return phc->base_ns + (int64_t)(((__int128)delta * phc->mult) >> 32);
+}
+
+int mqnic_perout_get_count(struct mqnic *dev)
+{
+    return dev->phc_perout_count;
+}
+
+static void mqnic_perout_write_time(volatile uint8_t *regs, int reg, uint64_t time_ns)
+{
+    uint64_t sec = time_ns / NSEC_PER_SEC;
+
+    // fns, ns, sec l, sec h; the sec h write latches the value
+    mqnic_reg_write32(regs, reg, 0);
+    mqnic_reg_write32(regs, reg + 0x4, time_ns - sec * NSEC_PER_SEC);
+    mqnic_reg_write32(regs, reg + 0x8, sec & 0xffffffff);
+    mqnic_reg_write32(regs, reg + 0xC, sec >> 32);
+}
+
+int mqnic_perout_disable(struct mqnic *dev, int index)
+{
+    if (index < 0 || index >= dev->phc_perout_count)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    mqnic_reg_write32(dev->phc_perout_rb[index]->regs, MQNIC_RB_PHC_PEROUT_REG_CTRL, 0);
+    return 0;
+}
+
+/*
+ * Program periodic outputs 0 to count-1 to start together at start_ns plus
+ * their phase offsets.  Channels with enable clear are switched off.  Fails
+ * with ETIME, leaving the channels off, unless the start time is at least
+ * min_lead_ns in the future and still ahead once every channel is armed.
+ */
+int mqnic_perout_arm(struct mqnic *dev, const struct mqnic_perout_config *config, int count,
+        uint64_t start_ns, uint64_t min_lead_ns)
+{
+    uint64_t now_ns;
+
+    if (count < 1 || count > dev->phc_perout_count)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (int k = 0; k < count; k++)
+    {
+        const struct mqnic_perout_config *c = &config[k];
+
+        if (!c->enable)
+            continue;
+
+        if (c->period_ns == 0 || c->width_ns >= c->period_ns ||
+                (c->phase_ns < 0 && (uint64_t)-c->phase_ns > start_ns))
+        {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    if (mqnic_phc_read_tod(dev, &now_ns))
+        return -1;
+
+    if (start_ns < now_ns + min_lead_ns)
+    {
+        errno = ETIME;
+        return -1;
+    }
+
+    // Every channel runs from its own absolute start time, so channels
+    // staged one after another before the start time come up in phase.
+    // Stop them all first so none runs on a mix of old and new settings.
+    for (int k = 0; k < count; k++)
+        mqnic_reg_write32(dev->phc_perout_rb[k]->regs, MQNIC_RB_PHC_PEROUT_REG_CTRL, 0);
+
+    for (int k = 0; k < count; k++)
+    {
+        const struct mqnic_perout_config *c = &config[k];
+        volatile uint8_t *regs = dev->phc_perout_rb[k]->regs;
+
+        if (!c->enable)
+            continue;
+
+        mqnic_perout_write_time(regs, MQNIC_RB_PHC_PEROUT_REG_PERIOD_FNS, c->period_ns);
+        mqnic_perout_write_time(regs, MQNIC_RB_PHC_PEROUT_REG_WIDTH_FNS, c->width_ns ? c->width_ns : c->period_ns / 2);
+        mqnic_perout_write_time(regs, MQNIC_RB_PHC_PEROUT_REG_START_FNS, start_ns + c->phase_ns);
+    }
+
+    for (int k = 0; k < count; k++)
+    {
+        if (config[k].enable)
+            mqnic_reg_write32(dev->phc_perout_rb[k]->regs, MQNIC_RB_PHC_PEROUT_REG_CTRL, 1);
+    }
+
+    // the read also flushes the posted writes above
+    mqnic_phc_read_tod(dev, &now_ns);
+
+    if (now_ns >= start_ns)
+    {
+        for (int k = 0; k < count; k++)
+            mqnic_reg_write32(dev->phc_perout_rb[k]->regs, MQNIC_RB_PHC_PEROUT_REG_CTRL, 0);
+
+        errno = ETIME;
+        return -1;
+    }
+
+    return 0;
+}
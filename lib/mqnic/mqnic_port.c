@@ -22,7 +22,7 @@ struct mqnic_port *mqnic_port_open(struct mqnic_if *interface, int index, struct
 
     port->index = index;
 
-    port->rb_list = mqnic_enumerate_reg_block_list(interface->regs, offset, interface->regs_size);
+    port->rb_list = mqnic_rb_cache_enumerate(interface->mqnic, interface->regs, offset, interface->regs_size);
 
     if (!port->rb_list)
     {
@@ -0,0 +1,658 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+#include "mqnic_ioctl.h"
+
+#include <endian.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define MQNIC_HUGEPAGE_SIZE (2*1024*1024)
+
+#define mqnic_wmb() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define mqnic_rmb() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+static size_t mqnic_align(size_t val, size_t align)
+{
+    return (val + align - 1) & ~(align - 1);
+}
+
+static unsigned int mqnic_ilog2(uint32_t val)
+{
+    unsigned int k = 0;
+
+    while ((1u << (k + 1)) <= val)
+        k++;
+
+    return k;
+}
+
+struct mqnic_dma_buf *mqnic_dma_alloc(struct mqnic *dev, size_t size)
+{
+    struct mqnic_dma_buf *buf = calloc(1, sizeof(struct mqnic_dma_buf));
+    struct mqnic_ioctl_dma_map map;
+
+    if (!buf)
+        return NULL;
+
+    buf->mqnic = dev;
+
+    // hugepages keep the buffer physically contiguous when there is no IOMMU
+    buf->size = mqnic_align(size, MQNIC_HUGEPAGE_SIZE);
+    buf->vaddr = mmap(NULL, buf->size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+
+    if (buf->vaddr == MAP_FAILED)
+    {
+        buf->size = mqnic_align(size, 4096);
+        buf->vaddr = mmap(NULL, buf->size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    }
+
+    if (buf->vaddr == MAP_FAILED)
+    {
+        perror("mmap DMA buffer failed");
+        buf->vaddr = NULL;
+        goto fail;
+    }
+
+    memset(buf->vaddr, 0, buf->size);
+
+    map.argsz = sizeof(map);
+    map.flags = 0;
+    map.vaddr = (uintptr_t)buf->vaddr;
+    map.size = buf->size;
+    map.iova = 0;
+
+    if (ioctl(dev->fd, MQNIC_IOCTL_DMA_MAP, &map) != 0)
+    {
+        perror("MQNIC_IOCTL_DMA_MAP ioctl failed");
+        goto fail;
+    }
+
+    buf->iova = map.iova;
+
+    return buf;
+
+fail:
+    mqnic_dma_free(buf);
+    return NULL;
+}
+
+void mqnic_dma_free(struct mqnic_dma_buf *buf)
+{
+    struct mqnic_ioctl_dma_map map;
+
+    if (!buf)
+        return;
+
+    if (buf->iova)
+    {
+        map.argsz = sizeof(map);
+        map.flags = 0;
+        map.vaddr = (uintptr_t)buf->vaddr;
+        map.size = buf->size;
+        map.iova = buf->iova;
+
+        ioctl(buf->mqnic->fd, MQNIC_IOCTL_DMA_UNMAP, &map);
+    }
+
+    if (buf->vaddr)
+        munmap(buf->vaddr, buf->size);
+
+    free(buf);
+}
+
+static int mqnic_alloc_queue(struct mqnic_if *interface, uint32_t type)
+{
+    struct mqnic_ioctl_queue q;
+
+    q.argsz = sizeof(q);
+    q.flags = 0;
+    q.if_index = interface->index;
+    q.type = type;
+    q.index = 0;
+
+    if (ioctl(interface->mqnic->fd, MQNIC_IOCTL_ALLOC_QUEUE, &q) != 0)
+    {
+        perror("MQNIC_IOCTL_ALLOC_QUEUE ioctl failed");
+        return -1;
+    }
+
+    return q.index;
+}
+
+static void mqnic_free_queue(struct mqnic_if *interface, uint32_t type, int index)
+{
+    struct mqnic_ioctl_queue q;
+
+    if (index < 0)
+        return;
+
+    q.argsz = sizeof(q);
+    q.flags = 0;
+    q.if_index = interface->index;
+    q.type = type;
+    q.index = index;
+
+    ioctl(interface->mqnic->fd, MQNIC_IOCTL_FREE_QUEUE, &q);
+}
+
+static void mqnic_uq_init(struct mqnic_uq *q, uint32_t size)
+{
+    q->index = -1;
+    q->cqn = -1;
+
+    q->size = size;
+    q->size_mask = size - 1;
+    q->stride = MQNIC_DESC_SIZE;
+    q->cq_stride = MQNIC_CPL_SIZE;
+}
+
+static int mqnic_uq_open(struct mqnic_if *interface, struct mqnic_uq *q, uint32_t type, struct mqnic_res *res)
+{
+    q->cqn = mqnic_alloc_queue(interface, MQNIC_QUEUE_TYPE_CQ);
+    if (q->cqn < 0)
+        return -1;
+
+    q->index = mqnic_alloc_queue(interface, type);
+    if (q->index < 0)
+        return -1;
+
+    q->regs = mqnic_res_get_addr(res, q->index);
+    q->cq_regs = mqnic_res_get_addr(interface->cq_res, q->cqn);
+
+    if (!q->regs || !q->cq_regs)
+        return -1;
+
+    q->prod_ptr = 0;
+    q->cons_ptr = 0;
+    q->cq_cons_ptr = 0;
+
+    // polled only; the CQ is never armed, so the EQ it names stays quiet
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_CTRL_STATUS_REG, MQNIC_CQ_CMD_SET_ENABLE | 0);
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_BASE_ADDR_VF_REG + 0, q->cq_iova & 0xfffff000);
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_BASE_ADDR_VF_REG + 4, q->cq_iova >> 32);
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_CTRL_STATUS_REG, MQNIC_CQ_CMD_SET_SIZE | mqnic_ilog2(q->size));
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_CTRL_STATUS_REG, MQNIC_CQ_CMD_SET_EQN | 0);
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_CTRL_STATUS_REG, MQNIC_CQ_CMD_SET_PROD_PTR | 0);
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_CTRL_STATUS_REG, MQNIC_CQ_CMD_SET_CONS_PTR | 0);
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_CTRL_STATUS_REG, MQNIC_CQ_CMD_SET_ENABLE | 1);
+
+    mqnic_reg_write32(q->regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_ENABLE | 0);
+    mqnic_reg_write32(q->regs, MQNIC_QUEUE_BASE_ADDR_VF_REG + 0, q->buf_iova & 0xfffff000);
+    mqnic_reg_write32(q->regs, MQNIC_QUEUE_BASE_ADDR_VF_REG + 4, q->buf_iova >> 32);
+    mqnic_reg_write32(q->regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_SIZE | mqnic_ilog2(q->size));
+    mqnic_reg_write32(q->regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_CQN | q->cqn);
+    mqnic_reg_write32(q->regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_PROD_PTR | 0);
+    mqnic_reg_write32(q->regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_CONS_PTR | 0);
+
+    return 0;
+}
+
+static void mqnic_uq_close(struct mqnic_if *interface, struct mqnic_uq *q, uint32_t type)
+{
+    if (q->regs)
+        mqnic_reg_write32(q->regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_ENABLE | 0);
+    if (q->cq_regs)
+        mqnic_reg_write32(q->cq_regs, MQNIC_CQ_CTRL_STATUS_REG, MQNIC_CQ_CMD_SET_ENABLE | 0);
+
+    mqnic_free_queue(interface, type, q->index);
+    mqnic_free_queue(interface, MQNIC_QUEUE_TYPE_CQ, q->cqn);
+
+    q->regs = NULL;
+    q->cq_regs = NULL;
+    q->index = -1;
+    q->cqn = -1;
+}
+
+// returns a completion record, or NULL if the hardware has not written one yet
+static struct mqnic_cpl *mqnic_uq_next_cpl(struct mqnic_uq *q)
+{
+    struct mqnic_cpl *cpl = (struct mqnic_cpl *)(q->cq_buf + (q->cq_cons_ptr & q->size_mask) * q->cq_stride);
+
+    if (!!(cpl->phase & htole32(0x80000000)) == !!(q->cq_cons_ptr & q->size))
+        return NULL;
+
+    mqnic_rmb();
+
+    return cpl;
+}
+
+static void mqnic_uq_write_cq_cons_ptr(struct mqnic_uq *q)
+{
+    mqnic_reg_write32(q->cq_regs, MQNIC_CQ_CTRL_STATUS_REG,
+        MQNIC_CQ_CMD_SET_CONS_PTR | (q->cq_cons_ptr & MQNIC_CQ_PTR_MASK));
+}
+
+static void mqnic_uq_write_prod_ptr(struct mqnic_uq *q)
+{
+    mqnic_wmb();
+    mqnic_reg_write32(q->regs, MQNIC_QUEUE_CTRL_STATUS_REG,
+        MQNIC_QUEUE_CMD_SET_PROD_PTR | (q->prod_ptr & MQNIC_QUEUE_PTR_MASK));
+}
+
+struct mqnic_queue_pair *mqnic_queue_pair_open(struct mqnic_if *interface, int port, uint32_t size, uint32_t rx_buf_size)
+{
+    struct mqnic_queue_pair *qp = calloc(1, sizeof(struct mqnic_queue_pair));
+    size_t ring_size, cq_size, offset;
+    uint8_t *base;
+
+    if (!qp)
+        return NULL;
+
+    qp->interface = interface;
+    qp->port = port;
+
+    struct mqnic_sched_block *sched_block = mqnic_if_get_sched_block(interface, port);
+
+    if (!sched_block || !sched_block->sched_count)
+    {
+        fprintf(stderr, "Error: no scheduler for port %d\n", port);
+        goto fail;
+    }
+
+    qp->sched = sched_block->sched[0];
+
+    if (size < 16)
+        size = 16;
+    size = 1u << mqnic_ilog2(size);
+    if (size > MQNIC_QUEUE_PTR_MASK)
+        size = (MQNIC_QUEUE_PTR_MASK + 1) / 2;
+
+    qp->rx_buf_size = mqnic_align(rx_buf_size, 64);
+
+    mqnic_uq_init(&qp->tx, size);
+    mqnic_uq_init(&qp->rx, size);
+
+    // one IOVA-contiguous buffer: rings, CQs, then RX packet buffers
+    ring_size = mqnic_align(size * MQNIC_DESC_SIZE, 4096);
+    cq_size = mqnic_align(size * MQNIC_CPL_SIZE, 4096);
+
+    qp->dma = mqnic_dma_alloc(interface->mqnic, 2*ring_size + 2*cq_size + size * qp->rx_buf_size);
+    if (!qp->dma)
+        goto fail;
+
+    base = qp->dma->vaddr;
+    offset = 0;
+
+    qp->tx.buf = base + offset;
+    qp->tx.buf_iova = qp->dma->iova + offset;
+    offset += ring_size;
+    qp->rx.buf = base + offset;
+    qp->rx.buf_iova = qp->dma->iova + offset;
+    offset += ring_size;
+    qp->tx.cq_buf = base + offset;
+    qp->tx.cq_iova = qp->dma->iova + offset;
+    offset += cq_size;
+    qp->rx.cq_buf = base + offset;
+    qp->rx.cq_iova = qp->dma->iova + offset;
+    offset += cq_size;
+    qp->rx_bufs = base + offset;
+    qp->rx_bufs_iova = qp->dma->iova + offset;
+
+    if (mqnic_uq_open(interface, &qp->tx, MQNIC_QUEUE_TYPE_TXQ, interface->txq_res))
+        goto fail;
+
+    if (mqnic_uq_open(interface, &qp->rx, MQNIC_QUEUE_TYPE_RXQ, interface->rxq_res))
+        goto fail;
+
+    // RX slot k always holds packet buffer k
+    for (uint32_t k = 0; k < size; k++)
+    {
+        struct mqnic_desc *desc = (struct mqnic_desc *)(qp->rx.buf + k * qp->rx.stride);
+
+        desc->len = htole32(qp->rx_buf_size);
+        desc->addr = htole64(qp->rx_bufs_iova + (uint64_t)k * qp->rx_buf_size);
+    }
+
+    qp->rx.prod_ptr = size;
+
+    mqnic_reg_write32(qp->rx.regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_ENABLE | 1);
+    mqnic_uq_write_prod_ptr(&qp->rx);
+
+    mqnic_reg_write32(qp->tx.regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_ENABLE | 1);
+
+    // bind the TX queue to the first port/TC of the scheduler
+    mqnic_reg_write32(qp->sched->regs, qp->sched->queue_stride*qp->tx.index, MQNIC_SCHED_RR_CMD_SET_PORT_TC | 0);
+    mqnic_reg_write32(qp->sched->regs, qp->sched->queue_stride*qp->tx.index, MQNIC_SCHED_RR_CMD_SET_PORT_ENABLE | 1);
+    mqnic_reg_write32(qp->sched->regs, qp->sched->queue_stride*qp->tx.index, MQNIC_SCHED_RR_CMD_SET_QUEUE_ENABLE | 1);
+
+    return qp;
+
+fail:
+    mqnic_queue_pair_close(qp);
+    return NULL;
+}
+
+void mqnic_queue_pair_close(struct mqnic_queue_pair *qp)
+{
+    if (!qp)
+        return;
+
+    if (qp->sched && qp->tx.index >= 0)
+        mqnic_reg_write32(qp->sched->regs, qp->sched->queue_stride*qp->tx.index, MQNIC_SCHED_RR_CMD_SET_QUEUE_ENABLE | 0);
+
+    mqnic_uq_close(qp->interface, &qp->tx, MQNIC_QUEUE_TYPE_TXQ);
+    mqnic_uq_close(qp->interface, &qp->rx, MQNIC_QUEUE_TYPE_RXQ);
+
+    mqnic_dma_free(qp->dma);
+
+    free(qp);
+}
+
+int mqnic_tx_burst(struct mqnic_queue_pair *qp, const struct mqnic_pkt *pkts, int count)
+{
+    struct mqnic_uq *q = &qp->tx;
+    int k;
+
+    for (k = 0; k < count; k++)
+    {
+        struct mqnic_desc *desc;
+
+        if (q->prod_ptr - q->cons_ptr >= q->size)
+            break;
+
+        desc = (struct mqnic_desc *)(q->buf + (q->prod_ptr & q->size_mask) * q->stride);
+
+        desc->tx.tso_mss = 0;
+        desc->tx.csum_cmd = 0;
+        desc->len = htole32(pkts[k].len);
+        desc->addr = htole64(pkts[k].iova);
+
+        q->prod_ptr++;
+    }
+
+    if (k)
+        mqnic_uq_write_prod_ptr(q);
+
+    return k;
+}
+
+int mqnic_tx_complete(struct mqnic_queue_pair *qp)
+{
+    struct mqnic_uq *q = &qp->tx;
+    int done = 0;
+
+    // TX completes in ring order; buffers may be reused in submission order
+    while (mqnic_uq_next_cpl(q))
+    {
+        q->cq_cons_ptr++;
+        q->cons_ptr++;
+        done++;
+    }
+
+    if (done)
+        mqnic_uq_write_cq_cons_ptr(q);
+
+    return done;
+}
+
+int mqnic_rx_burst(struct mqnic_queue_pair *qp, struct mqnic_pkt *pkts, int count)
+{
+    struct mqnic_uq *q = &qp->rx;
+    struct mqnic_cpl *cpl;
+    int done = 0;
+
+    // hand back the buffers returned by the previous call
+    if (q->prod_ptr != q->cons_ptr + q->size)
+    {
+        q->prod_ptr = q->cons_ptr + q->size;
+        mqnic_uq_write_prod_ptr(q);
+    }
+
+    while (done < count && (cpl = mqnic_uq_next_cpl(q)))
+    {
+        uint32_t index = le16toh(cpl->index) & q->size_mask;
+
+        pkts[done].data = qp->rx_bufs + (size_t)index * qp->rx_buf_size;
+        pkts[done].iova = qp->rx_bufs_iova + (uint64_t)index * qp->rx_buf_size;
+        pkts[done].len = le16toh(cpl->len);
+
+        q->cq_cons_ptr++;
+        q->cons_ptr++;
+        done++;
+    }
+
+    if (done)
+        mqnic_uq_write_cq_cons_ptr(q);
+
+    return done;
+}
+
+/*
+ * Packet capture.
+ *
+ * A capture is an RX queue of its own with a rule in front of the flow
+ * tables and RSS that mirrors matching frames to it, so the traffic being
+ * watched still reaches its normal consumers.  Each copy comes with the
+ * PHC arrival time and the length on the wire; with a snap length the
+ * hardware cuts copies short and the packet buffers shrink to match.
+ */
+
+#define MQNIC_CAPTURE_TOD_REFRESH_S 60
+
+#define NSEC_PER_SEC 1000000000ull
+
+static void mqnic_capture_refresh_tod(struct mqnic_capture *cap, uint64_t mono_s)
+{
+    uint64_t tod_ns;
+
+    if (mqnic_phc_read_tod(cap->interface->mqnic, &tod_ns) == 0)
+        cap->tod_s = tod_ns / NSEC_PER_SEC;
+
+    cap->tod_mono_s = mono_s;
+}
+
+static uint64_t mqnic_capture_mono_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+    return ts.tv_sec;
+}
+
+// widen the 16-bit completion seconds like the driver does
+static uint64_t mqnic_capture_cpl_ts(struct mqnic_capture *cap, const struct mqnic_cpl *cpl)
+{
+    uint64_t ts_s = le16toh(cpl->ts_s);
+
+    ts_s |= cap->tod_s & ~0xffffULL;
+
+    // pick the 16-bit wrap closest to the cached value
+    if (ts_s > cap->tod_s + 0x8000 && ts_s >= 0x10000)
+        ts_s -= 0x10000;
+    else if (ts_s + 0x8000 < cap->tod_s)
+        ts_s += 0x10000;
+
+    return ts_s * NSEC_PER_SEC + le32toh(cpl->ts_ns);
+}
+
+static int mqnic_capture_add_rule(struct mqnic_capture *cap, const struct mqnic_capture_filter *filter, uint32_t snaplen)
+{
+    struct mqnic_ioctl_capture_rule rule;
+
+    memset(&rule, 0, sizeof(rule));
+    rule.argsz = sizeof(rule);
+    rule.flags = 0;
+    rule.if_index = cap->interface->index;
+    rule.port_mask = filter->port_mask;
+    rule.queue = cap->rx.index;
+    rule.snaplen = snaplen;
+    rule.offset = filter->offset;
+    memcpy(rule.match, filter->match, sizeof(rule.match));
+    memcpy(rule.mask, filter->mask, sizeof(rule.mask));
+
+    if (ioctl(cap->interface->mqnic->fd, MQNIC_IOCTL_ADD_CAPTURE_RULE, &rule) != 0)
+    {
+        perror("MQNIC_IOCTL_ADD_CAPTURE_RULE ioctl failed");
+        return -1;
+    }
+
+    return rule.index;
+}
+
+static void mqnic_capture_del_rule(struct mqnic_capture *cap)
+{
+    struct mqnic_ioctl_capture_rule rule;
+
+    if (cap->rule < 0)
+        return;
+
+    memset(&rule, 0, sizeof(rule));
+    rule.argsz = sizeof(rule);
+    rule.if_index = cap->interface->index;
+    rule.index = cap->rule;
+
+    ioctl(cap->interface->mqnic->fd, MQNIC_IOCTL_DEL_CAPTURE_RULE, &rule);
+
+    cap->rule = -1;
+}
+
+struct mqnic_capture *mqnic_capture_open(struct mqnic_if *interface, const struct mqnic_capture_filter *filter, uint32_t size, uint32_t snaplen)
+{
+    struct mqnic_capture *cap;
+    size_t ring_size, cq_size, offset;
+    uint8_t *base;
+
+    if (!(interface->if_features & MQNIC_IF_FEATURE_RX_CAPTURE))
+    {
+        fprintf(stderr, "Error: interface %d does not support capture\n", interface->index);
+        return NULL;
+    }
+
+    cap = calloc(1, sizeof(struct mqnic_capture));
+    if (!cap)
+        return NULL;
+
+    cap->interface = interface;
+    cap->rule = -1;
+
+    if (size < 16)
+        size = 16;
+    size = 1u << mqnic_ilog2(size);
+    if (size > MQNIC_QUEUE_PTR_MASK)
+        size = (MQNIC_QUEUE_PTR_MASK + 1) / 2;
+
+    cap->buf_size = mqnic_align(snaplen ? snaplen : interface->max_rx_mtu, 64);
+
+    mqnic_uq_init(&cap->rx, size);
+
+    // one IOVA-contiguous buffer: ring, CQ, then packet buffers
+    ring_size = mqnic_align(size * MQNIC_DESC_SIZE, 4096);
+    cq_size = mqnic_align(size * MQNIC_CPL_SIZE, 4096);
+
+    cap->dma = mqnic_dma_alloc(interface->mqnic, ring_size + cq_size + size * cap->buf_size);
+    if (!cap->dma)
+        goto fail;
+
+    base = cap->dma->vaddr;
+    offset = 0;
+
+    cap->rx.buf = base + offset;
+    cap->rx.buf_iova = cap->dma->iova + offset;
+    offset += ring_size;
+    cap->rx.cq_buf = base + offset;
+    cap->rx.cq_iova = cap->dma->iova + offset;
+    offset += cq_size;
+    cap->bufs = base + offset;
+    cap->bufs_iova = cap->dma->iova + offset;
+
+    if (mqnic_uq_open(interface, &cap->rx, MQNIC_QUEUE_TYPE_RXQ, interface->rxq_res))
+        goto fail;
+
+    // RX slot k always holds packet buffer k
+    for (uint32_t k = 0; k < size; k++)
+    {
+        struct mqnic_desc *desc = (struct mqnic_desc *)(cap->rx.buf + k * cap->rx.stride);
+
+        desc->len = htole32(cap->buf_size);
+        desc->addr = htole64(cap->bufs_iova + (uint64_t)k * cap->buf_size);
+    }
+
+    cap->rx.prod_ptr = size;
+
+    mqnic_reg_write32(cap->rx.regs, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_CMD_SET_ENABLE | 1);
+    mqnic_uq_write_prod_ptr(&cap->rx);
+
+    mqnic_capture_refresh_tod(cap, mqnic_capture_mono_s());
+
+    // the queue is live before frames are mirrored to it
+    cap->rule = mqnic_capture_add_rule(cap, filter, snaplen);
+    if (cap->rule < 0)
+        goto fail;
+
+    return cap;
+
+fail:
+    mqnic_capture_close(cap);
+    return NULL;
+}
+
+void mqnic_capture_close(struct mqnic_capture *cap)
+{
+    if (!cap)
+        return;
+
+    mqnic_capture_del_rule(cap);
+
+    mqnic_uq_close(cap->interface, &cap->rx, MQNIC_QUEUE_TYPE_RXQ);
+
+    mqnic_dma_free(cap->dma);
+
+    free(cap);
+}
+
+int mqnic_capture_burst(struct mqnic_capture *cap, struct mqnic_capture_pkt *pkts, int count)
+{
+    struct mqnic_uq *q = &cap->rx;
+    struct mqnic_cpl *cpl;
+    uint64_t mono_s;
+    int done = 0;
+
+    // hand back the buffers returned by the previous call
+    if (q->prod_ptr != q->cons_ptr + q->size)
+    {
+        q->prod_ptr = q->cons_ptr + q->size;
+        mqnic_uq_write_prod_ptr(q);
+    }
+
+    while (done < count && (cpl = mqnic_uq_next_cpl(q)))
+    {
+        uint32_t index = le16toh(cpl->index) & q->size_mask;
+
+        // one clock read per burst, and a PHC read only when the cached
+        // seconds have aged
+        if (!done)
+        {
+            mono_s = mqnic_capture_mono_s();
+            if (mono_s - cap->tod_mono_s >= MQNIC_CAPTURE_TOD_REFRESH_S)
+                mqnic_capture_refresh_tod(cap, mono_s);
+        }
+
+        pkts[done].data = cap->bufs + (size_t)index * cap->buf_size;
+        pkts[done].len = le16toh(cpl->len);
+        pkts[done].orig_len = pkts[done].len;
+        if (cpl->rx_flags & MQNIC_CPL_RX_FLAG_CAPTURE)
+            pkts[done].orig_len = le16toh(cpl->rx_orig_len);
+        pkts[done].ts_ns = mqnic_capture_cpl_ts(cap, cpl);
+        pkts[done].port = cpl->port;
+
+        q->cq_cons_ptr++;
+        q->cons_ptr++;
+        done++;
+    }
+
+    if (done)
+        mqnic_uq_write_cq_cons_ptr(q);
+
+    return done;
+}
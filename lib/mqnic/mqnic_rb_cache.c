@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * Register block layout cache.
+ *
+ * Walking a register block list costs three MMIO reads per block, and a
+ * tool opening a device walks the device list and then the list of every
+ * interface, port and scheduler block it touches.  The layout is fixed by
+ * the bitstream, so walked lists are saved to a file named after the FW ID
+ * block contents; the next open of a device running the same build reads
+ * them back and only touches the FW ID block.
+ *
+ * The file lives in $MQNIC_RB_CACHE_DIR, else $XDG_RUNTIME_DIR, else
+ * /run/mqnic; MQNIC_RB_CACHE=0 turns the cache off.  A file not owned by
+ * the caller or writable by others is ignored, cached offsets are range
+ * checked like walked ones, and any problem falls back on walking.
+ */
+
+#define MQNIC_RB_CACHE_MAGIC 0x4342524d
+#define MQNIC_RB_CACHE_VERSION 1
+
+struct mqnic_rb_cache_hdr
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t key[9];
+    uint32_t word_count;
+};
+
+// one list: base offset from the device registers, start offset, block
+// count, then type, version and offset of each block
+struct mqnic_rb_cache
+{
+    uint32_t key[9];
+    uint32_t *words;
+    uint32_t word_count;
+    int dirty;
+};
+
+static int mqnic_rb_cache_path(const struct mqnic_rb_cache *cache, char *path, size_t len, int create)
+{
+    const char *dir = getenv("MQNIC_RB_CACHE_DIR");
+
+    if (!dir)
+        dir = getenv("XDG_RUNTIME_DIR");
+    if (!dir)
+    {
+        dir = "/run/mqnic";
+        if (create && mkdir(dir, 0700) && errno != EEXIST)
+            return -1;
+    }
+
+    snprintf(path, len, "%s/mqnic-rb-%08x-%08x-%08x-%08x.cache", dir,
+            cache->key[1], cache->key[2], cache->key[5], cache->key[6]);
+
+    return 0;
+}
+
+void mqnic_rb_cache_load(struct mqnic *dev)
+{
+    const char *env = getenv("MQNIC_RB_CACHE");
+    volatile uint8_t *fw_id = dev->regs;
+    struct mqnic_rb_cache_hdr hdr;
+    struct mqnic_rb_cache *cache;
+    char path[PATH_MAX];
+    struct stat st;
+    FILE *fp;
+
+    if (env && !strcmp(env, "0"))
+        return;
+
+    cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        return;
+
+    // the FW ID block leads the device list
+    cache->key[0] = mqnic_reg_read32(fw_id, MQNIC_RB_FW_ID_REG_FPGA_ID);
+    cache->key[1] = mqnic_reg_read32(fw_id, MQNIC_RB_FW_ID_REG_FW_ID);
+    cache->key[2] = mqnic_reg_read32(fw_id, MQNIC_RB_FW_ID_REG_FW_VER);
+    cache->key[3] = mqnic_reg_read32(fw_id, MQNIC_RB_FW_ID_REG_BOARD_ID);
+    cache->key[4] = mqnic_reg_read32(fw_id, MQNIC_RB_FW_ID_REG_BOARD_VER);
+    cache->key[5] = mqnic_reg_read32(fw_id, MQNIC_RB_FW_ID_REG_BUILD_DATE);
+    cache->key[6] = mqnic_reg_read32(fw_id, MQNIC_RB_FW_ID_REG_GIT_HASH);
+    cache->key[7] = mqnic_reg_read32(fw_id, MQNIC_RB_FW_ID_REG_REL_INFO);
+    cache->key[8] = dev->regs_size;
+
+    dev->rb_cache = cache;
+
+    if (mqnic_rb_cache_path(cache, path, sizeof(path), 0))
+        return;
+
+    fp = fopen(path, "rb");
+    if (!fp)
+        return;
+
+    if (fstat(fileno(fp), &st) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)))
+        goto out;
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1)
+        goto out;
+
+    if (hdr.magic != MQNIC_RB_CACHE_MAGIC || hdr.version != MQNIC_RB_CACHE_VERSION ||
+            memcmp(hdr.key, cache->key, sizeof(cache->key)) || hdr.word_count > 65536)
+        goto out;
+
+    cache->words = calloc(hdr.word_count, sizeof(uint32_t));
+    if (!cache->words)
+        goto out;
+
+    if (fread(cache->words, sizeof(uint32_t), hdr.word_count, fp) != hdr.word_count)
+    {
+        free(cache->words);
+        cache->words = NULL;
+        goto out;
+    }
+
+    cache->word_count = hdr.word_count;
+
+out:
+    fclose(fp);
+}
+
+void mqnic_rb_cache_save(struct mqnic *dev)
+{
+    struct mqnic_rb_cache *cache = dev->rb_cache;
+    struct mqnic_rb_cache_hdr hdr;
+    char path[PATH_MAX];
+    char tmp[PATH_MAX+32];
+    FILE *fp;
+    int ok;
+
+    if (!cache || !cache->dirty)
+        return;
+
+    if (mqnic_rb_cache_path(cache, path, sizeof(path), 1))
+        return;
+
+    // written aside and renamed so concurrent opens never see a partial file
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+
+    fp = fopen(tmp, "wb");
+    if (!fp)
+        return;
+
+    fchmod(fileno(fp), 0600);
+
+    hdr.magic = MQNIC_RB_CACHE_MAGIC;
+    hdr.version = MQNIC_RB_CACHE_VERSION;
+    memcpy(hdr.key, cache->key, sizeof(hdr.key));
+    hdr.word_count = cache->word_count;
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+        fwrite(cache->words, sizeof(uint32_t), cache->word_count, fp) == cache->word_count;
+
+    if (fclose(fp) || !ok || rename(tmp, path))
+        unlink(tmp);
+}
+
+void mqnic_rb_cache_free(struct mqnic *dev)
+{
+    if (!dev->rb_cache)
+        return;
+
+    free(dev->rb_cache->words);
+    free(dev->rb_cache);
+    dev->rb_cache = NULL;
+}
+
+static struct mqnic_reg_block *mqnic_rb_cache_lookup(struct mqnic *dev, volatile uint8_t *base, size_t offset, size_t size)
+{
+    struct mqnic_rb_cache *cache = dev->rb_cache;
+    struct mqnic_reg_block *list;
+    uint32_t base_offset = base - dev->regs;
+    uint32_t *w = cache->words;
+    uint32_t *end = cache->words + cache->word_count;
+    uint32_t count;
+
+    while (end - w >= 3)
+    {
+        count = w[2];
+
+        if (count > (end - w - 3) / 3)
+            return NULL;
+
+        if (w[0] == base_offset && w[1] == offset)
+        {
+            list = calloc(count + 1, sizeof(struct mqnic_reg_block));
+            if (!list)
+                return NULL;
+
+            w += 3;
+
+            for (int k = 0; k < count; k++, w += 3)
+            {
+                if (w[2] >= size)
+                {
+                    free(list);
+                    return NULL;
+                }
+
+                list[k].type = w[0];
+                list[k].version = w[1];
+                list[k].base = base;
+                list[k].regs = base + w[2];
+            }
+
+            return list;
+        }
+
+        w += 3 + count*3;
+    }
+
+    return NULL;
+}
+
+static void mqnic_rb_cache_add(struct mqnic *dev, volatile uint8_t *base, size_t offset, struct mqnic_reg_block *list)
+{
+    struct mqnic_rb_cache *cache = dev->rb_cache;
+    uint32_t count = 0;
+    uint32_t *words;
+    uint32_t *w;
+
+    while (list[count].regs)
+        count++;
+
+    words = realloc(cache->words, (cache->word_count + 3 + count*3) * sizeof(uint32_t));
+    if (!words)
+        return;
+
+    cache->words = words;
+    w = cache->words + cache->word_count;
+
+    *w++ = base - dev->regs;
+    *w++ = offset;
+    *w++ = count;
+
+    for (int k = 0; k < count; k++)
+    {
+        *w++ = list[k].type;
+        *w++ = list[k].version;
+        *w++ = list[k].regs - base;
+    }
+
+    cache->word_count += 3 + count*3;
+    cache->dirty = 1;
+}
+
+struct mqnic_reg_block *mqnic_rb_cache_enumerate(struct mqnic *dev, volatile uint8_t *base, size_t offset, size_t size)
+{
+    struct mqnic_reg_block *list;
+
+    if (!dev->rb_cache)
+        return mqnic_enumerate_reg_block_list(base, offset, size);
+
+    list = mqnic_rb_cache_lookup(dev, base, offset, size);
+    if (list)
+        return list;
+
+    list = mqnic_enumerate_reg_block_list(base, offset, size);
+    if (list)
+        mqnic_rb_cache_add(dev, base, offset, list);
+
+    return list;
+}
@@ -42,3 +42,13 @@ volatile uint8_t *mqnic_res_get_addr(struct mqnic_res *res, int index)
     
     return res->base + index * res->stride;
 }
+
+// PTR register of a queue, from host memory while the driver has the
+// write-back slot enabled
+uint32_t mqnic_res_read_ptr(struct mqnic_res *res, int index, int reg)
+{
+    if (res->shadow && (res->shadow[index].flags & MQNIC_PTR_SHADOW_FLAG_VALID))
+        return res->shadow[index].ptr;
+
+    return mqnic_reg_read32(mqnic_res_get_addr(res, index), reg);
+}
@@ -22,7 +22,7 @@ struct mqnic_sched_block *mqnic_sched_block_open(struct mqnic_if *interface, int
 
     block->index = index;
 
-    block->rb_list = mqnic_enumerate_reg_block_list(interface->regs, offset, interface->regs_size);
+    block->rb_list = mqnic_rb_cache_enumerate(interface->mqnic, interface->regs, offset, interface->regs_size);
 
     if (!block->rb_list)
     {
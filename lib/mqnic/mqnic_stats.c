@@ -5,6 +5,8 @@
 
 #include "mqnic.h"
 
+#define MQNIC_STATS_DMA_RETRIES 8
+
 void mqnic_stats_init(struct mqnic *dev)
 {
     dev->stats_rb = mqnic_find_reg_block(dev->rb_list, MQNIC_RB_STATS_TYPE, MQNIC_RB_STATS_VER, 0);
@@ -18,15 +20,182 @@ void mqnic_stats_init(struct mqnic *dev)
     dev->stats_flags = mqnic_reg_read32(dev->stats_rb->regs, MQNIC_RB_STATS_REG_FLAGS);
 }
 
-uint64_t mqnic_stats_read(struct mqnic *dev, int index)
+// counter layout of the PCIe core stats block; indices past the table
+// belong to the application or are unassigned
+static const char *mqnic_stats_names[] = {
+    // PCIe stats
+    "pcie_rx_tlp_mem_rd",      // index 0
+    "pcie_rx_tlp_mem_wr",      // index 1
+    "pcie_rx_tlp_io",          // index 2
+    "pcie_rx_tlp_cfg",         // index 3
+    "pcie_rx_tlp_msg",         // index 4
+    "pcie_rx_tlp_cpl",         // index 5
+    "pcie_rx_tlp_cpl_ur",      // index 6
+    "pcie_rx_tlp_cpl_ca",      // index 7
+    "pcie_rx_tlp_atomic",      // index 8
+    "pcie_rx_tlp_ep",          // index 9
+    "pcie_rx_tlp_hdr_dw",      // index 10
+    "pcie_rx_tlp_req_dw",      // index 11
+    "pcie_rx_tlp_payload_dw",  // index 12
+    "pcie_rx_tlp_cpl_dw",      // index 13
+    "",                        // index 14
+    "",                        // index 15
+    "pcie_tx_tlp_mem_rd",      // index 16
+    "pcie_tx_tlp_mem_wr",      // index 17
+    "pcie_tx_tlp_io",          // index 18
+    "pcie_tx_tlp_cfg",         // index 19
+    "pcie_tx_tlp_msg",         // index 20
+    "pcie_tx_tlp_cpl",         // index 21
+    "pcie_tx_tlp_cpl_ur",      // index 22
+    "pcie_tx_tlp_cpl_ca",      // index 23
+    "pcie_tx_tlp_atomic",      // index 24
+    "pcie_tx_tlp_ep",          // index 25
+    "pcie_tx_tlp_hdr_dw",      // index 26
+    "pcie_tx_tlp_req_dw",      // index 27
+    "pcie_tx_tlp_payload_dw",  // index 28
+    "pcie_tx_tlp_cpl_dw",      // index 29
+    "",                        // index 30
+    "",                        // index 31
+
+    // DMA statistics
+    "dma_rd_op_count",         // index 32
+    "dma_rd_op_bytes",         // index 33
+    "dma_rd_op_latency",       // index 34
+    "dma_rd_op_error",         // index 35
+    "dma_rd_req_count",        // index 36
+    "dma_rd_req_latency",      // index 37
+    "dma_rd_req_timeout",      // index 38
+    "dma_rd_op_table_full",    // index 39
+    "dma_rd_no_tags",          // index 40
+    "dma_rd_tx_limit",         // index 41
+    "dma_rd_tx_stall",         // index 42
+    "",                        // index 43
+    "",                        // index 44
+    "",                        // index 45
+    "",                        // index 46
+    "",                        // index 47
+    "dma_wr_op_count",         // index 48
+    "dma_wr_op_bytes",         // index 49
+    "dma_wr_op_latency",       // index 50
+    "dma_wr_op_error",         // index 51
+    "dma_wr_req_count",        // index 52
+    "dma_wr_req_latency",      // index 53
+    "",                        // index 54
+    "dma_wr_op_table_full",    // index 55
+    "",                        // index 56
+    "dma_wr_tx_limit",         // index 57
+    "dma_wr_tx_stall",         // index 58
+    "",                        // index 59
+    "",                        // index 60
+    "",                        // index 61
+    "",                        // index 62
+    "",                        // index 63
+};
+
+const char *mqnic_stats_name(int index)
+{
+    if (index < 0 || index >= (int)(sizeof(mqnic_stats_names)/sizeof(*mqnic_stats_names)))
+        return NULL;
+
+    if (!mqnic_stats_names[index][0])
+        return NULL;
+
+    return mqnic_stats_names[index];
+}
+
+// the two halves are separate reads, so re-read the high word and retry
+// the low word if a carry landed in between
+static inline uint64_t mqnic_stats_read_reg(volatile uint32_t *reg)
 {
-    uint64_t val;
+    uint32_t hi = reg[1];
+    uint32_t lo = reg[0];
+    uint32_t hi2 = reg[1];
+
+    if (hi != hi2)
+        lo = reg[0];
+
+    return ((uint64_t)hi2 << 32) | lo;
+}
 
+uint64_t mqnic_stats_read(struct mqnic *dev, int index)
+{
     if (!dev->stats_rb || index < 0 || index >= dev->stats_count)
         return 0;
 
-    val = (uint64_t)mqnic_reg_read32(dev->regs, dev->stats_offset + index*8 + 0);
-    val |= (uint64_t)mqnic_reg_read32(dev->regs, dev->stats_offset + index*8 + 4) << 32;
+    return mqnic_stats_read_reg((volatile uint32_t *)(dev->regs + dev->stats_offset) + index*2);
+}
+
+// generation of the last complete write-back pass, 0 when there is none
+uint32_t mqnic_stats_dma_gen(struct mqnic *dev)
+{
+    volatile uint32_t *trailer;
+
+    if (!dev->stats_dma || !dev->stats_rb ||
+            MQNIC_STATS_DMA_SIZE(dev->stats_count) > dev->stats_dma_size)
+        return 0;
+
+    trailer = (volatile uint32_t *)((volatile uint64_t *)(dev->stats_dma + 1) + dev->stats_count);
+
+    return *trailer;
+}
+
+// copy out of the write-back buffer when the driver has it on; the same
+// generation in the trailer before and the header after means the copy
+// holds a single pass
+static int mqnic_stats_read_dma(struct mqnic *dev, int index, uint64_t *buf, int count)
+{
+    volatile uint64_t *counters = (volatile uint64_t *)(dev->stats_dma + 1);
+    uint32_t gen;
+
+    for (int retry = 0; retry < MQNIC_STATS_DMA_RETRIES; retry++)
+    {
+        gen = mqnic_stats_dma_gen(dev);
+        if (!gen)
+            return -1;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        for (int k = 0; k < count; k++)
+            buf[k] = counters[index + k];
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (dev->stats_dma->gen == gen)
+            return 0;
+    }
+
+    return -1;
+}
+
+int mqnic_stats_read_bulk(struct mqnic *dev, int index, uint64_t *buf, int count)
+{
+    volatile uint32_t *regs;
+
+    if (!dev->stats_rb || index < 0 || count < 0 || (uint32_t)(index + count) > dev->stats_count)
+        return -1;
+
+    if (!mqnic_stats_read_dma(dev, index, buf, count))
+        return 0;
+
+    // counters are contiguous lo/hi word pairs; one pass keeps the reads back to back
+    regs = (volatile uint32_t *)(dev->regs + dev->stats_offset) + index*2;
+
+    for (int k = 0; k < count; k++)
+        buf[k] = mqnic_stats_read_reg(regs + k*2);
+
+    return 0;
+}
+
+int mqnic_stats_snapshot(struct mqnic *dev, uint64_t *buf, int count)
+{
+    if (!dev->stats_rb)
+        return 0;
+
+    if (count > (int)dev->stats_count)
+        count = dev->stats_count;
+
+    if (mqnic_stats_read_bulk(dev, 0, buf, count))
+        return -1;
 
-    return val;
+    return count;
 }
@@ -5,62 +5,88 @@
 
 #include "reg_if.h"
 
-int mqnic_reg_if_read8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t *value)
+int mqnic_reg_if_ops_read8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t *value)
 {
     if (!reg || !reg->ops || !reg->ops->read8)
         return -1;
     return reg->ops->read8(reg, offset, value);
 }
 
-int mqnic_reg_if_write8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t value)
+int mqnic_reg_if_ops_write8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t value)
 {
     if (!reg || !reg->ops || !reg->ops->write8)
         return -1;
     return reg->ops->write8(reg, offset, value);
 }
 
-int mqnic_reg_if_read16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t *value)
+int mqnic_reg_if_ops_read16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t *value)
 {
     if (!reg || !reg->ops || !reg->ops->read16)
         return -1;
     return reg->ops->read16(reg, offset, value);
 }
 
-int mqnic_reg_if_write16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t value)
+int mqnic_reg_if_ops_write16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t value)
 {
     if (!reg || !reg->ops || !reg->ops->write16)
         return -1;
     return reg->ops->write16(reg, offset, value);
 }
 
-int mqnic_reg_if_read32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *value)
+int mqnic_reg_if_ops_read32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *value)
 {
     if (!reg || !reg->ops || !reg->ops->read32)
         return -1;
     return reg->ops->read32(reg, offset, value);
 }
 
-int mqnic_reg_if_write32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t value)
+int mqnic_reg_if_ops_write32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t value)
 {
     if (!reg || !reg->ops || !reg->ops->write32)
         return -1;
     return reg->ops->write32(reg, offset, value);
 }
 
-int mqnic_reg_if_read64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t *value)
+int mqnic_reg_if_ops_read64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t *value)
 {
     if (!reg || !reg->ops || !reg->ops->read64)
         return -1;
     return reg->ops->read64(reg, offset, value);
 }
 
-int mqnic_reg_if_write64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t value)
+int mqnic_reg_if_ops_write64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t value)
 {
     if (!reg || !reg->ops || !reg->ops->write64)
         return -1;
     return reg->ops->write64(reg, offset, value);
 }
 
+int mqnic_reg_if_ops_read32_bulk(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *buf, size_t count)
+{
+    int ret;
+
+    for (size_t k = 0; k < count; k++)
+    {
+        ret = mqnic_reg_if_ops_read32(reg, offset+k*4, &buf[k]);
+        if (ret)
+            return ret;
+    }
+    return 0;
+}
+
+int mqnic_reg_if_ops_write32_bulk(const struct mqnic_reg_if *reg, ptrdiff_t offset, const uint32_t *buf, size_t count)
+{
+    int ret;
+
+    for (size_t k = 0; k < count; k++)
+    {
+        ret = mqnic_reg_if_ops_write32(reg, offset+k*4, buf[k]);
+        if (ret)
+            return ret;
+    }
+    return 0;
+}
+
 static int mqnic_reg_if_raw_read8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t *value)
 {
     uint8_t *regs = (uint8_t *)reg->priv;
@@ -132,4 +158,5 @@ void mqnic_reg_if_setup_raw(struct mqnic_reg_if *reg, void *regs)
 {
     reg->priv = regs;
     reg->ops = &mqnic_reg_if_raw_ops;
+    reg->raw = regs;
 }
@@ -12,6 +12,7 @@
 struct mqnic_reg_if {
     const struct mqnic_reg_if_ops *ops;
     void *priv;
+    volatile uint8_t *raw;
 };
 
 struct mqnic_reg_if_ops {
@@ -25,14 +26,123 @@ struct mqnic_reg_if_ops {
     int (*write64)(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t value);
 };
 
-int mqnic_reg_if_read8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t *value);
-int mqnic_reg_if_write8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t value);
-int mqnic_reg_if_read16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t *value);
-int mqnic_reg_if_write16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t value);
-int mqnic_reg_if_read32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *value);
-int mqnic_reg_if_write32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t value);
-int mqnic_reg_if_read64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t *value);
-int mqnic_reg_if_write64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t value);
+// out-of-line accessors, dispatched through ops
+int mqnic_reg_if_ops_read8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t *value);
+int mqnic_reg_if_ops_write8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t value);
+int mqnic_reg_if_ops_read16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t *value);
+int mqnic_reg_if_ops_write16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t value);
+int mqnic_reg_if_ops_read32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *value);
+int mqnic_reg_if_ops_write32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t value);
+int mqnic_reg_if_ops_read64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t *value);
+int mqnic_reg_if_ops_write64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t value);
+int mqnic_reg_if_ops_read32_bulk(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *buf, size_t count);
+int mqnic_reg_if_ops_write32_bulk(const struct mqnic_reg_if *reg, ptrdiff_t offset, const uint32_t *buf, size_t count);
+
+// direct MMIO when raw is set (plain mmap BAR), ops otherwise
+static inline int mqnic_reg_if_read8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t *value)
+{
+    if (reg && reg->raw)
+    {
+        *value = *(volatile uint8_t *)(reg->raw+offset);
+        return 0;
+    }
+    return mqnic_reg_if_ops_read8(reg, offset, value);
+}
+
+static inline int mqnic_reg_if_write8(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint8_t value)
+{
+    if (reg && reg->raw)
+    {
+        *(volatile uint8_t *)(reg->raw+offset) = value;
+        return 0;
+    }
+    return mqnic_reg_if_ops_write8(reg, offset, value);
+}
+
+static inline int mqnic_reg_if_read16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t *value)
+{
+    if (reg && reg->raw)
+    {
+        *value = *(volatile uint16_t *)(reg->raw+offset);
+        return 0;
+    }
+    return mqnic_reg_if_ops_read16(reg, offset, value);
+}
+
+static inline int mqnic_reg_if_write16(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint16_t value)
+{
+    if (reg && reg->raw)
+    {
+        *(volatile uint16_t *)(reg->raw+offset) = value;
+        return 0;
+    }
+    return mqnic_reg_if_ops_write16(reg, offset, value);
+}
+
+static inline int mqnic_reg_if_read32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *value)
+{
+    if (reg && reg->raw)
+    {
+        *value = *(volatile uint32_t *)(reg->raw+offset);
+        return 0;
+    }
+    return mqnic_reg_if_ops_read32(reg, offset, value);
+}
+
+static inline int mqnic_reg_if_write32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t value)
+{
+    if (reg && reg->raw)
+    {
+        *(volatile uint32_t *)(reg->raw+offset) = value;
+        return 0;
+    }
+    return mqnic_reg_if_ops_write32(reg, offset, value);
+}
+
+static inline int mqnic_reg_if_read64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t *value)
+{
+    if (reg && reg->raw)
+    {
+        *value = *(volatile uint64_t *)(reg->raw+offset);
+        return 0;
+    }
+    return mqnic_reg_if_ops_read64(reg, offset, value);
+}
+
+static inline int mqnic_reg_if_write64(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint64_t value)
+{
+    if (reg && reg->raw)
+    {
+        *(volatile uint64_t *)(reg->raw+offset) = value;
+        return 0;
+    }
+    return mqnic_reg_if_ops_write64(reg, offset, value);
+}
+
+// bulk access to count consecutive 32-bit registers starting at offset
+static inline int mqnic_reg_if_read32_bulk(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *buf, size_t count)
+{
+    if (reg && reg->raw)
+    {
+        const volatile uint32_t *src = (const volatile uint32_t *)(reg->raw+offset);
+        for (size_t k = 0; k < count; k++)
+            buf[k] = src[k];
+        return 0;
+    }
+    return mqnic_reg_if_ops_read32_bulk(reg, offset, buf, count);
+}
+
+static inline int mqnic_reg_if_write32_bulk(const struct mqnic_reg_if *reg, ptrdiff_t offset, const uint32_t *buf, size_t count)
+{
+    if (reg && reg->raw)
+    {
+        volatile uint32_t *dst = (volatile uint32_t *)(reg->raw+offset);
+        for (size_t k = 0; k < count; k++)
+            dst[k] = buf[k];
+        return 0;
+    }
+    return mqnic_reg_if_ops_write32_bulk(reg, offset, buf, count);
+}
 
 void mqnic_reg_if_setup_raw(struct mqnic_reg_if *reg, void *regs);
 
@@ -7,6 +7,7 @@
 #define MQNIC_H
 
 #include <linux/kernel.h>
+#include <linux/version.h>
 #ifdef CONFIG_PCI
 #include <linux/pci.h>
 #endif
@@ -17,14 +18,82 @@
 #include <linux/miscdevice.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
+#include <linux/if_vlan.h>
 #include <linux/net_tstamp.h>
 #include <linux/ptp_clock_kernel.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/jump_label.h>
+#include <linux/timex.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/seqlock.h>
+#include <linux/bpf.h>
 #include <net/devlink.h>
+#include <net/xdp.h>
+#include <net/pkt_sched.h>
+#ifdef CONFIG_DCB
+#include <net/dcbnl.h>
+#endif
 
 #include <linux/i2c.h>
 #include <linux/i2c-algo-bit.h>
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+#define MQNIC_SW_TSO
+#endif
+
+// macvlan offload relies on subordinate channels and sb_dev in ndo_select_queue
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+#include <linux/if_macvlan.h>
+#define MQNIC_L2FW
+#endif
+
+// header split RX into memory provider buffers (devmem TCP, io_uring
+// zero-copy RX), swapped in per queue through the queue management ops
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 15, 0)
+#include <net/netdev_queues.h>
+#include <net/netmem.h>
+#define MQNIC_NETMEM
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+#include <linux/ptp_classify.h>
+#define MQNIC_PTP_ONESTEP
+#endif
+
+#if IS_ENABLED(CONFIG_DIMLIB) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+#include <linux/dim.h>
+#define MQNIC_DIM
+#endif
+
+// board sensors through hwmon, channel tables need HWMON_CHANNEL_INFO
+#if IS_REACHABLE(CONFIG_HWMON) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 3, 0)
+#include <linux/hwmon.h>
+#define MQNIC_HWMON
+#endif
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 5, 0)
+typedef struct {
+	u64 v;
+} u64_stats_t;
+
+static inline u64 u64_stats_read(const u64_stats_t *p)
+{
+	return p->v;
+}
+
+static inline void u64_stats_add(u64_stats_t *p, unsigned long val)
+{
+	p->v += val;
+}
+
+static inline void u64_stats_inc(u64_stats_t *p)
+{
+	p->v++;
+}
+#endif
+
 #define DRIVER_NAME "mqnic"
 #define DRIVER_VERSION "0.1"
 
@@ -41,14 +110,83 @@
 // default interval to poll port TX/RX status, in ms
 #define MQNIC_LINK_STATUS_POLL_MS 1000
 
+// interval to refresh the cached PHC ToD seconds, in ms
+#define MQNIC_PHC_TOD_REFRESH_MS 1000
+
+// default interval to refresh cached board sensor values, in ms
+#define MQNIC_HWMON_UPDATE_INTERVAL_MS 1000
+
+// maximum number of TX descriptors deferred by xmit_more before ringing the doorbell
+#define MQNIC_TX_DOORBELL_BATCH 64
+
+// queue memory is carved out of coherent chunks of this size
+#define MQNIC_DMA_ARENA_CHUNK_SIZE SZ_2M
+
+// RX refill is skipped until at least this many descriptors are free,
+// unless set otherwise through devlink
+#define MQNIC_RX_REFILL_BATCH 16
+
+// RX frames up to this length are copied into a linear skb by default
+#define MQNIC_RX_COPYBREAK_DEFAULT 256
+#define MQNIC_RX_COPYBREAK_MAX 1024
+
+// largest RX buffer size settable through devlink, within the 16-bit
+// completion length
+#define MQNIC_MAX_RX_BUF_SIZE 32768
+
+// RSS rebalancer period limits, in ms
+#define MQNIC_RSS_MIN_INTERVAL 100
+#define MQNIC_RSS_MAX_INTERVAL 60000
+
+// header buffer posted first in each RX block when headers are split
+#define MQNIC_RX_HDR_BUF_SIZE 256
+
+// TX frames up to this length are copied into a pre-mapped per-entry bounce
+// slot instead of being DMA mapped; the maximum is the slot size
+#define MQNIC_TX_COPYBREAK_DEFAULT 256
+#define MQNIC_TX_COPYBREAK_MAX 256
+
+// events handled per EQ interrupt or tasklet run before deferring the rest
+#define MQNIC_EQ_BUDGET 64
+
+// offloaded macvlan stations per netdev, and TX/RX queues each (power of two)
+#define MQNIC_MAX_FWD_STATIONS 8
+#define MQNIC_FWD_QUEUES 2
+
+// log2 ns buckets per queue for latency telemetry
+#define MQNIC_LAT_HIST_BUCKETS 32
+// events handled between EQ consumer pointer updates
+#define MQNIC_EQ_CONS_PTR_BATCH 16
+
+// XDP runs on single-page RX buffers with room for an xdp_frame and skb_shared_info
+#define MQNIC_XDP_TAILROOM SKB_DATA_ALIGN(sizeof(struct skb_shared_info))
+#define MQNIC_XDP_MAX_MTU (PAGE_SIZE - XDP_PACKET_HEADROOM - MQNIC_XDP_TAILROOM - ETH_HLEN)
+
+// XDP verdicts, as seen by the RX path
+#define MQNIC_XDP_PASS 0
+#define MQNIC_XDP_CONSUMED BIT(0)
+#define MQNIC_XDP_TX BIT(1)
+#define MQNIC_XDP_REDIR BIT(2)
+
 extern unsigned int mqnic_num_eq_entries;
 extern unsigned int mqnic_num_txq_entries;
 extern unsigned int mqnic_num_rxq_entries;
 
 extern unsigned int mqnic_link_status_poll;
+extern unsigned int mqnic_per_cpu_eq;
+extern unsigned int mqnic_napi_threaded;
+extern unsigned int mqnic_tx_push;
+extern unsigned int mqnic_mod_dom_ttl;
+extern unsigned int mqnic_mod_static_ttl;
+extern unsigned int mqnic_sriov_vf_queues;
+extern unsigned int mqnic_stats_dma_interval;
 
 struct mqnic_dev;
 struct mqnic_if;
+struct mqnic_priv;
+struct mqnic_vf;
+struct xsk_buff_pool;
+struct page_pool;
 
 struct mqnic_res {
 	unsigned int count;
@@ -57,6 +195,44 @@ struct mqnic_res {
 
 	spinlock_t lock;
 	unsigned long *bmap;
+	unsigned int hint;
+};
+
+struct mqnic_vf_range {
+	int base;
+	unsigned int count;
+};
+
+// devlink rate object; leaves weight the TX queues of a netdev or a VF
+struct mqnic_rate {
+	struct list_head list;
+	struct mqnic_rate *parent;
+	u32 tx_weight;
+
+	struct mqnic_priv *priv;
+	struct mqnic_vf *vf;
+
+	// share of the scheduler per queue, 32.32 fixed point
+	u64 queue_share;
+	// hardware DWRR weight of each of the leaf's queues, 0 if never set
+	int queue_weight;
+};
+
+struct mqnic_vf {
+	int index;
+
+	struct mqnic_vf_range eq;
+	struct mqnic_vf_range cq;
+	struct mqnic_vf_range txq;
+	struct mqnic_vf_range rxq;
+
+	struct mqnic_sched_port *sched_port;
+
+	u8 mac[ETH_ALEN];
+
+	struct devlink_port dl_port;
+	bool dl_port_registered;
+	struct mqnic_rate dl_rate;
 };
 
 struct mqnic_reg_block {
@@ -84,6 +260,9 @@ struct mqnic_i2c_bus {
 	u32 sda_in_mask;
 	u32 sda_out_mask;
 
+	// hardware I2C master, NULL when bit-banging
+	u8 __iomem *master_regs;
+
 	struct list_head head;
 
 	struct i2c_algo_bit_data algo;
@@ -93,6 +272,8 @@ struct mqnic_i2c_bus {
 struct mqnic_irq {
 	int index;
 	int irqn;
+	int node;
+	const struct cpumask *affinity;
 	char name[16 + 3];
 	struct atomic_notifier_head nh;
 	struct list_head list;
@@ -127,11 +308,36 @@ struct mqnic_dev {
 	phys_addr_t ram_hw_regs_phys;
 	u8 __iomem *ram_hw_addr;
 
+	// write-combined views of prefetchable BARs, for bulk sequential writes
+	u8 __iomem *app_hw_addr_wc;
+	u8 __iomem *ram_hw_addr_wc;
+
 	struct mutex state_lock;
 
+	// devlink rate leaves and nodes, under the devlink instance lock
+	struct list_head rate_list;
+	struct work_struct rate_work;
+
+	// datapath tuning from devlink params, under state_lock; read when a
+	// port starts, except copybreak, which applies at once
+	bool devlink_params;
+	u32 eq_size;
+	u32 tx_desc_block_size;
+	u32 rx_buf_size;
+	bool rx_page_split;
+	u32 rx_refill_batch;
+	u32 rx_copybreak;
+	u32 tx_copybreak;
+	// RSS rebalancer period in ms, 0 when off; applies at once
+	u32 rss_rebalance_interval;
+
 	int mac_count;
 	u8 mac_list[MQNIC_MAX_IF][ETH_ALEN];
 
+	// board init, run from a work item during probe
+	struct work_struct board_work;
+	int board_ret;
+
 	char name[16];
 
 	int irq_count;
@@ -151,6 +357,7 @@ struct mqnic_dev {
 	struct mqnic_reg_block *stats_rb;
 	struct mqnic_reg_block *clk_info_rb;
 	struct mqnic_reg_block *phc_rb;
+	struct mqnic_reg_block *sriov_rb;
 
 	int phys_port_max;
 
@@ -170,6 +377,11 @@ struct mqnic_dev {
 	u32 stats_stride;
 	u32 stats_flags;
 
+	// periodic counter write-back, NULL when off
+	struct mqnic_stats_dma_hdr *stats_dma_buf;
+	dma_addr_t stats_dma_addr;
+	size_t stats_dma_size;
+
 	u32 core_clk_nom_per_ns_num;
 	u32 core_clk_nom_per_ns_denom;
 	u32 core_clk_nom_freq_hz;
@@ -178,6 +390,12 @@ struct mqnic_dev {
 	u32 ref_clk_nom_freq_hz;
 	u32 clk_info_channels;
 
+	u32 sriov_vf_max;
+	u32 sriov_vf_offset;
+	u32 sriov_vf_stride;
+	int vf_count;
+	struct mqnic_vf *vf;
+
 	u32 if_offset;
 	u32 if_count;
 	u32 if_stride;
@@ -190,6 +408,14 @@ struct mqnic_dev {
 	struct ptp_clock *ptp_clock;
 	struct ptp_clock_info ptp_clock_info;
 
+	// PHC ToD seconds, refreshed by the PTP aux worker to extend completion timestamps
+	seqlock_t tod_lock;
+	u64 tod_s;
+
+	// any read of the PHC snapshot registers, from the latch read to the
+	// last field; also taken from app driver timers in hard IRQ context
+	spinlock_t phc_snap_lock;
+
 	struct mqnic_board_ops *board_ops;
 
 	struct list_head i2c_bus;
@@ -198,6 +424,16 @@ struct mqnic_dev {
 	int mod_i2c_client_count;
 	struct i2c_client *mod_i2c_client[MQNIC_MAX_IF];
 	struct i2c_client *eeprom_i2c_client;
+
+	struct mqnic_hwmon *hwmon;
+};
+
+// interface-wide backing store for ring, CQ and EQ memory
+struct mqnic_dma_arena {
+	struct device *dev;
+	struct mutex lock;
+	// one gen_pool of chunks per NUMA node
+	struct list_head pools;
 };
 
 struct mqnic_frag {
@@ -207,15 +443,28 @@ struct mqnic_frag {
 
 struct mqnic_tx_info {
 	struct sk_buff *skb;
+	struct xdp_frame *xdpf;
 	DEFINE_DMA_UNMAP_ADDR(dma_addr);
 	DEFINE_DMA_UNMAP_LEN(len);
 	u32 frag_count;
 	struct mqnic_frag frags[MQNIC_MAX_FRAGS - 1];
 	int ts_requested;
+	int xsk;
+	int tso;
+	int bounce;
+	// doorbell time, only stamped with latency telemetry on
+	u64 db_ns;
 };
 
 struct mqnic_rx_info {
-	struct page *page;
+	union {
+		struct page *page;
+#ifdef MQNIC_NETMEM
+		// payload buffers of a header split ring, maybe not readable
+		netmem_ref netmem;
+#endif
+	};
+	struct xdp_buff *xdp;
 	u32 page_order;
 	u32 page_offset;
 	dma_addr_t dma_addr;
@@ -225,15 +474,24 @@ struct mqnic_rx_info {
 struct mqnic_ring {
 	// written on enqueue (i.e. start_xmit)
 	u32 prod_ptr;
-	u64 bytes;
-	u64 packets;
-	u64 dropped_packets;
+	u32 db_prod_ptr;
+	struct u64_stats_sync syncp;
+	u64_stats_t bytes;
+	u64_stats_t packets;
+	u64_stats_t dropped_packets;
+	u64_stats_t alloc_failed;
+	u64_stats_t queue_stops;
 	struct netdev_queue *tx_queue;
 
 	// written from completion
 	u32 cons_ptr ____cacheline_aligned_in_smp;
-	u64 ts_s;
-	u8 ts_valid;
+	struct u64_stats_sync cpl_syncp;
+	u64_stats_t napi_exhausted;
+	// NAPI processing cost, only accumulated while a benchmark runs
+	u64 bench_cycles;
+	u64 bench_packets;
+	// RSS rebalancer snapshot of the ring load, only touched by its work
+	u64 rss_load;
 
 	// mostly constant
 	u32 size;
@@ -243,14 +501,30 @@ struct mqnic_ring {
 
 	u32 mtu;
 	u32 page_order;
+	u32 headroom;
+	u32 tailroom;
+	u32 frag_size;
+	// first buffer of each block takes the headers, from hdr_page_pool
+	bool hdr_split;
 
 	u32 desc_block_size;
 	u32 log_desc_block_size;
+	u32 rx_buf_count;
+	u32 refill_batch;
+
+	int node;
 
 	size_t buf_size;
 	u8 *buf;
 	dma_addr_t buf_dma_addr;
 
+	u8 *tso_hdrs;
+	dma_addr_t tso_hdrs_dma_addr;
+
+	// per-entry copy slots for small TX frames, mapped for the ring lifetime
+	u8 *tx_bounce;
+	dma_addr_t tx_bounce_dma_addr;
+
 	union {
 		struct mqnic_tx_info *tx_info;
 		struct mqnic_rx_info *rx_info;
@@ -259,15 +533,45 @@ struct mqnic_ring {
 	struct device *dev;
 	struct mqnic_if *interface;
 	struct mqnic_priv *priv;
+	// RX frames are delivered here; an offloaded macvlan rather than the port
+	struct net_device *ndev;
 	int index;
+	int queue_index;
 	struct mqnic_cq *cq;
 	int enabled;
 
+	// counters already folded into the port totals on replacement
+	u64 retired_packets;
+	u64 retired_bytes;
+	u64 retired_dropped;
+
+	struct xdp_rxq_info xdp_rxq;
+	spinlock_t xdp_tx_lock;
+	struct xsk_buff_pool *xsk_pool;
+	struct page_pool *page_pool;
+	struct page_pool *hdr_page_pool;
+
 	u8 __iomem *hw_addr;
+	// hardware PTR register mirrored in host memory, NULL without shadowing
+	struct mqnic_ptr_shadow *ptr_shadow;
+
+	// descriptor push window, NULL when pushing is off
+	u8 __iomem *push_addr;
+	u32 push_slot_size;
+	u32 push_slot_mask;
+	u32 push_inline_len;
+
+	// latency telemetry, written from completion
+	u32 lat_hist[MQNIC_LAT_HIST_BUCKETS];
+	u64 lat_count;
+	u64 lat_sum_ns;
+	u64 lat_early;
 } ____cacheline_aligned_in_smp;
 
 struct mqnic_cq {
 	u32 cons_ptr;
+	// consumer pointer last written to the hardware
+	u32 hw_cons_ptr;
 
 	u32 size;
 	u32 size_mask;
@@ -281,13 +585,43 @@ struct mqnic_cq {
 	struct mqnic_if *interface;
 	struct napi_struct napi;
 	int cqn;
+	int node;
 	struct mqnic_eq *eq;
 	struct mqnic_ring *src_ring;
 	int enabled;
+	// combined channels: a TX CQ is reaped from the NAPI of rx_cq,
+	// which points back at it through tx_cq
+	struct mqnic_cq *rx_cq;
+	struct mqnic_cq *tx_cq;
+	// with a shared CQ, the TX ring posting here next to src_ring
+	struct mqnic_ring *tx_ring;
+
+	u32 coal_usecs;
+	u32 coal_frames;
+	struct hrtimer holdoff_timer;
+
+	u16 event_ctr;
+	// time of the interrupt that delivered the last event, ktime_get_ns
+	u64 last_event_ns;
+#ifdef MQNIC_DIM
+	struct dim dim;
+#endif
 
 	void (*handler)(struct mqnic_cq *cq);
 
 	u8 __iomem *hw_addr;
+	struct mqnic_ptr_shadow *ptr_shadow;
+};
+
+// TX completion state carried across one pass over a CQ
+struct mqnic_tx_cpl_ctx {
+	u32 ring_cons_ptr;
+	u32 packets;
+	u32 bytes;
+	u32 xsk_frames;
+	bool in_order;
+	bool lat;
+	s64 lat_offset;
 };
 
 struct mqnic_eq {
@@ -308,13 +642,14 @@ struct mqnic_eq {
 	int enabled;
 
 	struct notifier_block irq_nb;
+	struct tasklet_struct tasklet;
+	bool deferred;
+	u64 last_irq_ns;
 
 	void (*handler)(struct mqnic_eq *eq);
 
-	spinlock_t table_lock;
-	struct radix_tree_root cq_table;
-
 	u8 __iomem *hw_addr;
+	struct mqnic_ptr_shadow *ptr_shadow;
 };
 
 struct mqnic_sched {
@@ -338,6 +673,11 @@ struct mqnic_sched {
 
 	int enable_count;
 
+	// optional token buckets, rates in Mbps
+	struct mqnic_reg_block *rl_rb;
+	// per-queue DWRR weights
+	bool dwrr;
+
 	struct list_head sched_port_list;
 
 	u8 __iomem *hw_addr;
@@ -363,6 +703,9 @@ struct mqnic_port {
 
 	u32 port_features;
 
+	// netdev on this port, for status change events
+	struct net_device *ndev;
+
 	struct devlink_port dl_port;
 };
 
@@ -379,6 +722,63 @@ struct mqnic_sched_block {
 	struct mqnic_sched *sched[MQNIC_MAX_PORTS];
 };
 
+// SFF-8024 identifiers
+#define SFF_MODULE_ID_SFP        0x03
+#define SFF_MODULE_ID_QSFP       0x0c
+#define SFF_MODULE_ID_QSFP_PLUS  0x0d
+#define SFF_MODULE_ID_QSFP28     0x11
+
+#define MQNIC_MOD_CACHE_ENTRIES 8
+
+// 128 bytes of module EEPROM: lower or upper half of one I2C address and page
+struct mqnic_mod_page {
+	u8 i2c_addr;
+	u8 page;
+	bool upper;
+	bool valid;
+	unsigned long updated;
+	unsigned long used;
+	u8 data[128];
+};
+
+struct mqnic_flow_rule {
+	struct mqnic_priv *priv;
+	__be32 src_ip;
+	__be32 dst_ip;
+	__be16 src_port;
+	__be16 dst_port;
+	u8 ip_proto;
+	u16 rxq;
+	bool arfs;
+	u32 flow_id;
+};
+
+// capture rule, owned by the char device file that installed it; with
+// priv set, rxq is an RX channel of that netdev, else a hardware RXQ index
+struct mqnic_capture_rule {
+	const void *owner;
+	struct mqnic_priv *priv;
+	u32 rxq;
+	u32 port_mask;
+	u32 snaplen;
+	u32 offset;
+	u8 match[MQNIC_RX_CAPTURE_MATCH_SIZE];
+	u8 mask[MQNIC_RX_CAPTURE_MATCH_SIZE];
+};
+
+// macvlan upper device with its own queue group, sharing the port's EQs
+struct mqnic_fwd_station {
+	struct mqnic_priv *priv;
+	struct net_device *vdev;
+	int index;
+	int l2_index;
+	// first netdev TX/RX queue, taken from the top of the port's queue space
+	u32 txq_base;
+	u32 rxq_base;
+	struct mqnic_ring *txq[MQNIC_FWD_QUEUES];
+	struct mqnic_ring *rxq[MQNIC_FWD_QUEUES];
+};
+
 struct mqnic_if {
 	struct device *dev;
 	struct mqnic_dev *mdev;
@@ -390,6 +790,9 @@ struct mqnic_if {
 	struct mqnic_reg_block *txq_rb;
 	struct mqnic_reg_block *rxq_rb;
 	struct mqnic_reg_block *rx_queue_map_rb;
+	struct mqnic_reg_block *rx_hash_rb;
+	struct mqnic_reg_block *rx_flow_table_rb;
+	struct mqnic_reg_block *tx_push_rb;
 
 	int index;
 
@@ -405,9 +808,19 @@ struct mqnic_if {
 	struct mqnic_res *txq_res;
 	struct mqnic_res *rxq_res;
 
+	// write-combined descriptor push windows, indexed by TXQ
+	u8 __iomem *tx_push_hw_addr;
+	u32 tx_push_count;
+	u32 tx_push_stride;
+	u32 tx_push_slot_size;
+
 	u32 eq_count;
-	struct rw_semaphore eq_table_sem;
-	struct radix_tree_root eq_table;
+	struct mqnic_eq **eq_table;
+	// EQ k is serviced on the k-th online CPU
+	bool eq_per_cpu;
+
+	// indexed by CQN, looked up for every completion event
+	struct mqnic_cq **cq_table;
 
 	u32 port_count;
 	struct mqnic_port *port[MQNIC_MAX_PORTS];
@@ -415,22 +828,66 @@ struct mqnic_if {
 	u32 sched_block_count;
 	struct mqnic_sched_block *sched_block[MQNIC_MAX_PORTS];
 
+	// traffic classes available on every scheduler port
+	int sched_tc_count;
+	bool sched_rate_limit;
+	bool sched_dwrr;
+
 	spinlock_t free_sched_port_list_lock;
 	struct list_head free_sched_port_list;
 
 	u32 max_desc_block_size;
+	u32 max_rx_desc_block_size;
 
 	u32 rx_queue_map_indir_table_size;
 	u8 __iomem *rx_queue_map_indir_table[MQNIC_MAX_PORTS];
 
+	u8 rx_hash_key[MQNIC_RX_HASH_KEY_SIZE];
+
+	// exact-match flow rules, shared by all ports of the interface
+	u32 rx_flow_table_size;
+	struct mqnic_flow_rule *rx_flow_rules;
+	spinlock_t rx_flow_table_lock;
+
+	// hardware LAG over the ports, while all of them are slaves of one bond
+	struct mqnic_reg_block *lag_rb;
+	struct notifier_block lag_nb;
+	bool lag_offload;
+	enum netdev_lag_tx_type lag_tx_type;
+	enum netdev_lag_hash lag_hash_type;
+
+	// capture rules for the mirror to capture queues
+	struct mqnic_reg_block *rx_capture_rb;
+	u32 rx_capture_rule_count;
+	u32 rx_capture_offset_max;
+	struct mqnic_capture_rule *rx_capture_rules;
+	spinlock_t rx_capture_lock;
+
+	// L2 station table for macvlan offload, shared by all ports of the interface
+	struct mqnic_reg_block *rx_l2_table_rb;
+	u32 rx_l2_table_size;
+	unsigned long *rx_l2_table_bmap;
+
 	resource_size_t hw_regs_size;
 	u8 __iomem *hw_addr;
 	u8 __iomem *csr_hw_addr;
 
+	// pointer write-back slots for every EQ, CQ, TXQ and RXQ, in that order
+	struct mqnic_ptr_shadow *ptr_shadow;
+	dma_addr_t ptr_shadow_dma_addr;
+	size_t ptr_shadow_size;
+
+	struct mqnic_dma_arena dma_arena;
+
 	u32 ndev_count;
 	struct list_head ndev_list;
 
 	struct i2c_client *mod_i2c_client;
+
+	// module EEPROM cache, shared by the ports of the interface
+	struct mutex mod_lock;
+	struct mqnic_mod_page mod_cache[MQNIC_MOD_CACHE_ENTRIES];
+	struct delayed_work mod_refresh_work;
 };
 
 struct mqnic_priv {
@@ -440,27 +897,64 @@ struct mqnic_priv {
 	struct mqnic_dev *mdev;
 	struct mqnic_if *interface;
 
-	spinlock_t stats_lock;
-
 	bool registered;
 	bool port_up;
+	bool loopback;
+
+	// bond master and lower state, under RTNL
+	struct net_device *lag_upper;
+	bool lag_tx_enabled;
 
 	u32 if_features;
 
 	unsigned int link_status;
 	struct timer_list link_status_timer;
+	// the port reports status changes as events, no polling
+	bool link_event;
+	bool link_status_active;
+	spinlock_t link_status_lock;
 
 	u32 txq_count;
 	u32 rxq_count;
+	u32 xps_txq_count;
+	// TX and RX queue k share one NAPI context
+	bool combined;
 
 	u32 tx_ring_size;
 	u32 rx_ring_size;
-
-	struct rw_semaphore txq_table_sem;
-	struct radix_tree_root txq_table;
-
-	struct rw_semaphore rxq_table_sem;
-	struct radix_tree_root rxq_table;
+	u32 rx_copybreak;
+	u32 tx_copybreak;
+	// ethtool tcp-data-split, applied to RX rings without XDP or XSK
+	bool rx_hdr_split;
+
+	u32 tx_coal_usecs;
+	u32 tx_coal_frames;
+	u32 rx_coal_usecs;
+	u32 rx_coal_frames;
+	bool tx_dim_enabled;
+	bool rx_dim_enabled;
+
+	// indexed by netdev queue, looked up for every transmitted skb
+	struct mqnic_ring **txq_table;
+	struct mqnic_ring **rxq_table;
+
+	struct bpf_prog *xdp_prog;
+	u32 xdp_txq_count;
+	struct mqnic_ring **xdp_txq;
+
+	int fwd_count;
+	struct mqnic_fwd_station *fwd_station[MQNIC_MAX_FWD_STATIONS];
+
+	unsigned long *xsk_zc_qps;
+	// TX queues with ETF offload, indexed by queue
+	unsigned long *txq_launch_time;
+	// TX queues the watchdog found stuck in hardware, awaiting a reset
+	unsigned long *txq_timed_out;
+	struct work_struct tx_timeout_work;
+
+	// totals of rings replaced while the port stayed up
+	struct u64_stats_sync retired_syncp;
+	struct rtnl_link_stats64 retired_stats;
 
 	struct mqnic_sched_port *sched_port;
 	struct mqnic_port *port;
@@ -470,24 +964,80 @@ struct mqnic_priv {
 	u32 rx_queue_map_indir_table_size;
 	u32 *rx_queue_map_indir_table;
 
+	// mqprio shaping, in bytes per second; zero when unset
+	u64 tc_min_rate[TC_MAX_QUEUE];
+	u64 tc_max_rate[TC_MAX_QUEUE];
+
+	// DCB ETS bandwidth shares in percent; zero when unset
+	u8 tc_bw[TC_MAX_QUEUE];
+	// traffic classes set up through DCB rather than mqprio
+	bool dcb_tcs;
+#ifdef CONFIG_DCB
+	u8 dcbx_mode;
+	struct ieee_ets dcb_ets;
+	struct ieee_pfc dcb_pfc;
+#endif
+
+	// devlink rate leaf cap on the whole port, in bytes per second
+	u64 tx_max_rate;
+	bool dl_rate_leaf;
+	struct mqnic_rate dl_rate;
+
+#ifdef CONFIG_RFS_ACCEL
+	struct work_struct arfs_expire_work;
+#endif
+
 	struct hwtstamp_config hwts_config;
 
+	struct dentry *debugfs_dir;
+
+	// loopback datapath benchmark
+	u32 bench_queues;
+	u32 bench_count;
+	u32 bench_size;
+	char bench_result[256];
+
+	// latency telemetry; PHC time minus CLOCK_MONOTONIC
+	bool lat_enabled;
+	s64 lat_phc_offset;
+	struct delayed_work lat_work;
+
+	// RSS rebalancer; table cursor and the last entry move, as RX channels
+	struct delayed_work rss_work;
+	u32 rss_cursor;
+	int rss_last_from;
+	int rss_last_to;
+
 	struct list_head ndev_list;
 
 	struct i2c_client *mod_i2c_client;
 };
 
 // mqnic_main.c
+int mqnic_board_wait(struct mqnic_dev *mqnic);
 
 // mqnic_devlink.c
 struct devlink *mqnic_devlink_alloc(struct device *dev);
 void mqnic_devlink_free(struct devlink *devlink);
+int mqnic_devlink_params_register(struct mqnic_dev *mdev);
+void mqnic_devlink_params_unregister(struct mqnic_dev *mdev);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+void mqnic_devl_rate_update(struct mqnic_dev *mdev);
+void mqnic_devlink_rate_work(struct work_struct *work);
+void mqnic_devlink_rate_update(struct mqnic_dev *mdev);
+#else
+static inline void mqnic_devlink_rate_update(struct mqnic_dev *mdev)
+{
+}
+#endif
 
 // mqnic_res.c
 struct mqnic_res *mqnic_create_res(unsigned int count, u8 __iomem *base, unsigned int stride);
 void mqnic_destroy_res(struct mqnic_res *res);
 int mqnic_res_alloc(struct mqnic_res *res);
+int mqnic_res_alloc_range(struct mqnic_res *res, unsigned int nr);
 void mqnic_res_free(struct mqnic_res *res, int index);
+void mqnic_res_free_range(struct mqnic_res *res, int index, unsigned int nr);
 unsigned int mqnic_res_get_count(struct mqnic_res *res);
 u8 __iomem *mqnic_res_get_addr(struct mqnic_res *res, int index);
 
@@ -500,13 +1050,41 @@ void mqnic_free_reg_block_list(struct mqnic_reg_block *list);
 int mqnic_irq_init_pcie(struct mqnic_dev *mdev);
 void mqnic_irq_deinit_pcie(struct mqnic_dev *mdev);
 int mqnic_irq_init_platform(struct mqnic_dev *mdev);
+int mqnic_irq_register_notifier(struct mqnic_dev *mdev, int index,
+		struct notifier_block *nb);
+void mqnic_irq_unregister_notifier(struct mqnic_dev *mdev, int index,
+		struct notifier_block *nb);
+void *mqnic_dma_alloc_coherent_node(struct device *dev, size_t size,
+		dma_addr_t *dma_handle, int node);
+
+// mqnic_dma_arena.c
+void mqnic_dma_arena_init(struct mqnic_dma_arena *arena, struct device *dev);
+void mqnic_dma_arena_destroy(struct mqnic_dma_arena *arena);
+void *mqnic_dma_arena_alloc(struct mqnic_dma_arena *arena, size_t size,
+		dma_addr_t *dma_handle, int node);
+void mqnic_dma_arena_free(struct mqnic_dma_arena *arena, size_t size,
+		void *buf, dma_addr_t dma_handle);
 
 // mqnic_dev.c
 extern const struct file_operations mqnic_fops;
 
 // mqnic_if.c
+// PTR register value, from the write-back slot when the queue has one
+static inline u32 mqnic_read_hw_ptr(struct mqnic_ptr_shadow *shadow, u8 __iomem *reg)
+{
+	if (shadow)
+		return le32_to_cpu(READ_ONCE(shadow->ptr));
+
+	return ioread32(reg);
+}
+
 struct mqnic_if *mqnic_create_interface(struct mqnic_dev *mdev, int index, u8 __iomem *hw_addr);
 void mqnic_destroy_interface(struct mqnic_if *interface);
+struct mqnic_ptr_shadow *mqnic_interface_attach_ptr_shadow(struct mqnic_if *interface,
+		struct mqnic_res *res, int index, u8 __iomem *addr_reg);
+void mqnic_interface_detach_ptr_shadow(struct mqnic_ptr_shadow *shadow, u8 __iomem *addr_reg);
+int mqnic_interface_resize_eqs(struct mqnic_if *interface, u32 size);
+struct mqnic_eq *mqnic_interface_select_eq(struct mqnic_if *interface, int index);
 u32 mqnic_interface_get_tx_mtu(struct mqnic_if *interface);
 void mqnic_interface_set_tx_mtu(struct mqnic_if *interface, u32 mtu);
 u32 mqnic_interface_get_rx_mtu(struct mqnic_if *interface);
@@ -517,6 +1095,20 @@ u32 mqnic_interface_get_rx_queue_map_app_mask(struct mqnic_if *interface, int po
 void mqnic_interface_set_rx_queue_map_app_mask(struct mqnic_if *interface, int port, u32 val);
 u32 mqnic_interface_get_rx_queue_map_indir_table(struct mqnic_if *interface, int port, int index);
 void mqnic_interface_set_rx_queue_map_indir_table(struct mqnic_if *interface, int port, int index, u32 val);
+void mqnic_interface_set_rx_queue_map_ptp_queue(struct mqnic_if *interface, int port, u32 val);
+void mqnic_interface_get_rx_hash_key(struct mqnic_if *interface, u8 *key);
+int mqnic_interface_set_rx_hash_key(struct mqnic_if *interface, const u8 *key);
+int mqnic_interface_add_flow_rule(struct mqnic_if *interface, int index,
+		const struct mqnic_flow_rule *rule);
+int mqnic_interface_del_flow_rule(struct mqnic_if *interface, struct mqnic_priv *priv, int index);
+int mqnic_interface_get_flow_rule(struct mqnic_if *interface, int index, struct mqnic_flow_rule *rule);
+void mqnic_interface_update_flow_rules(struct mqnic_if *interface, struct mqnic_priv *priv);
+void mqnic_interface_clear_flow_rules(struct mqnic_if *interface, struct mqnic_priv *priv);
+void mqnic_interface_expire_flow_rules(struct mqnic_if *interface, struct mqnic_priv *priv);
+int mqnic_interface_alloc_l2_entry(struct mqnic_if *interface);
+void mqnic_interface_free_l2_entry(struct mqnic_if *interface, int index);
+void mqnic_interface_write_l2_entry(struct mqnic_if *interface, int index, const u8 *mac,
+		int port, u32 queue, u32 log_queues);
 int mqnic_interface_register_sched_port(struct mqnic_if *interface, struct mqnic_sched_port *port);
 int mqnic_interface_unregister_sched_port(struct mqnic_if *interface, struct mqnic_sched_port *port);
 struct mqnic_sched_port *mqnic_interface_alloc_sched_port(struct mqnic_if *interface);
@@ -536,14 +1128,79 @@ u32 mqnic_port_get_lfc_ctrl(struct mqnic_port *port);
 void mqnic_port_set_lfc_ctrl(struct mqnic_port *port, u32 val);
 u32 mqnic_port_get_pfc_ctrl(struct mqnic_port *port, int index);
 void mqnic_port_set_pfc_ctrl(struct mqnic_port *port, int index, u32 val);
+void mqnic_port_set_event_ctrl(struct mqnic_port *port, u32 val);
 
 // mqnic_netdev.c
 int mqnic_start_port(struct net_device *ndev);
 void mqnic_stop_port(struct net_device *ndev);
 int mqnic_update_indir_table(struct net_device *ndev);
+void mqnic_update_ptp_queue(struct net_device *ndev);
+void mqnic_update_tx_rates(struct net_device *ndev);
+int mqnic_reconfigure_port(struct net_device *ndev, u32 txq_count, u32 rxq_count,
+		u32 tx_ring_size, u32 rx_ring_size);
 void mqnic_update_stats(struct net_device *ndev);
 struct net_device *mqnic_create_netdev(struct mqnic_if *interface, struct mqnic_port *port);
 void mqnic_destroy_netdev(struct net_device *ndev);
+void mqnic_set_port_loopback(struct mqnic_priv *priv, bool enable);
+void mqnic_port_status_event(struct mqnic_port *port);
+
+// with queue management ops the core calls in with the netdev instance lock
+// held; driver paths that rebuild queues from elsewhere take it themselves
+static inline void mqnic_netdev_lock(struct net_device *ndev)
+{
+#ifdef MQNIC_NETMEM
+	netdev_lock(ndev);
+#endif
+}
+
+static inline void mqnic_netdev_unlock(struct net_device *ndev)
+{
+#ifdef MQNIC_NETMEM
+	netdev_unlock(ndev);
+#endif
+}
+
+// mqnic_debugfs.c
+void mqnic_debugfs_init(void);
+void mqnic_debugfs_exit(void);
+void mqnic_create_netdev_debugfs(struct mqnic_priv *priv);
+void mqnic_destroy_netdev_debugfs(struct mqnic_priv *priv);
+
+// mqnic_bench.c
+DECLARE_STATIC_KEY_FALSE(mqnic_bench_key);
+void mqnic_bench_create_debugfs(struct mqnic_priv *priv);
+
+static inline void mqnic_bench_account(struct mqnic_ring *ring, u64 start, int done)
+{
+	if (start) {
+		ring->bench_cycles += get_cycles() - start;
+		ring->bench_packets += done;
+	}
+}
+
+// mqnic_latency.c
+DECLARE_STATIC_KEY_FALSE(mqnic_lat_key);
+void mqnic_lat_tx_doorbell(struct mqnic_ring *ring);
+void mqnic_lat_create_debugfs(struct mqnic_priv *priv);
+void mqnic_lat_destroy(struct mqnic_priv *priv);
+
+static inline bool mqnic_lat_enabled(struct mqnic_priv *priv)
+{
+	return static_branch_unlikely(&mqnic_lat_key) && READ_ONCE(priv->lat_enabled);
+}
+
+// log2 buckets: bucket k counts samples in [2^(k-1), 2^k) ns
+static inline void mqnic_lat_record(struct mqnic_ring *ring, s64 ns)
+{
+	if (unlikely(ns < 0)) {
+		ring->lat_early++;
+		return;
+	}
+
+	ring->lat_hist[min_t(int, fls64(ns), MQNIC_LAT_HIST_BUCKETS - 1)]++;
+	ring->lat_count++;
+	ring->lat_sum_ns += ns;
+}
 
 // mqnic_sched_block.c
 struct mqnic_sched_block *mqnic_create_sched_block(struct mqnic_if *interface,
@@ -580,6 +1237,9 @@ void mqnic_scheduler_queue_port_set_pause(struct mqnic_sched *sched, int queue,
 int mqnic_scheduler_queue_port_get_pause(struct mqnic_sched *sched, int queue, int port);
 void mqnic_scheduler_queue_port_set_tc(struct mqnic_sched *sched, int queue, int port, int val);
 int mqnic_scheduler_queue_port_get_tc(struct mqnic_sched *sched, int queue, int port);
+int mqnic_scheduler_queue_set_rate(struct mqnic_sched *sched, int queue, u32 rate, u32 burst);
+int mqnic_scheduler_queue_set_weight(struct mqnic_sched *sched, int queue, int weight);
+int mqnic_scheduler_channel_set_rate(struct mqnic_sched *sched, int port, int tc, u32 rate, u32 burst);
 
 // mqnic_sched_port.c
 struct mqnic_sched_port *mqnic_create_sched_port(struct mqnic_sched *sched, int index);
@@ -604,12 +1264,35 @@ void mqnic_sched_port_queue_set_pause(struct mqnic_sched_port *port, int queue,
 int mqnic_sched_port_queue_get_pause(struct mqnic_sched_port *port, int queue);
 void mqnic_sched_port_queue_set_tc(struct mqnic_sched_port *port, int queue, int val);
 int mqnic_sched_port_queue_get_tc(struct mqnic_sched_port *port, int queue);
+int mqnic_sched_port_queue_set_weight(struct mqnic_sched_port *port, int queue, int weight);
+int mqnic_sched_port_queue_set_rate(struct mqnic_sched_port *port, int queue, u32 rate, u32 burst);
+int mqnic_sched_port_channel_set_rate(struct mqnic_sched_port *port, int tc, u32 rate, u32 burst);
 
 // mqnic_ptp.c
 void mqnic_register_phc(struct mqnic_dev *mdev);
 void mqnic_unregister_phc(struct mqnic_dev *mdev);
-ktime_t mqnic_read_cpl_ts(struct mqnic_dev *mdev, struct mqnic_ring *ring,
-		const struct mqnic_cpl *cpl);
+ktime_t mqnic_read_cpl_ts(struct mqnic_dev *mdev, const struct mqnic_cpl *cpl);
+int mqnic_phc_read_time(struct mqnic_dev *mdev, u64 *phc_ns, u64 *mono_ns);
+
+// RX timestamps are reconstructed only for frames the rx_filter asks for;
+// under PTP_V2_EVENT that is the frames hardware flagged as PTP events
+static inline bool mqnic_rx_want_ts(struct mqnic_priv *priv, const struct mqnic_cpl *cpl)
+{
+	switch (READ_ONCE(priv->hwts_config.rx_filter)) {
+	case HWTSTAMP_FILTER_ALL:
+		return true;
+	case HWTSTAMP_FILTER_PTP_V2_EVENT:
+		return cpl->rx_flags & MQNIC_CPL_RX_FLAG_PTP_EVENT;
+	default:
+		return false;
+	}
+}
+
+// mqnic_module.c
+int mqnic_mod_read(struct mqnic_if *interface, u8 i2c_addr, u8 page,
+		u16 offset, u16 len, u8 *data);
+void mqnic_mod_cache_init(struct mqnic_if *interface);
+void mqnic_mod_cache_destroy(struct mqnic_if *interface);
 
 // mqnic_i2c.c
 struct mqnic_i2c_bus *mqnic_i2c_bus_create(struct mqnic_dev *mqnic, int index);
@@ -622,6 +1305,54 @@ void mqnic_i2c_deinit(struct mqnic_dev *mqnic);
 // mqnic_board.c
 int mqnic_board_init(struct mqnic_dev *mqnic);
 void mqnic_board_deinit(struct mqnic_dev *mqnic);
+u32 mqnic_alveo_bmc_reg_read(struct mqnic_dev *mqnic, struct mqnic_reg_block *rb, u32 reg);
+
+// mqnic_lag.c
+int mqnic_lag_init(struct mqnic_if *interface);
+void mqnic_lag_deinit(struct mqnic_if *interface);
+void mqnic_lag_update(struct mqnic_if *interface);
+int mqnic_lag_update_indir_table(struct net_device *ndev);
+
+// mqnic_rss.c
+void mqnic_rss_init(struct mqnic_priv *priv);
+void mqnic_rss_start(struct mqnic_priv *priv);
+void mqnic_rss_stop(struct mqnic_priv *priv);
+void mqnic_rss_set_interval(struct mqnic_dev *mdev);
+
+// mqnic_capture.c
+int mqnic_capture_init(struct mqnic_if *interface);
+void mqnic_capture_deinit(struct mqnic_if *interface);
+int mqnic_capture_add_rule(struct mqnic_if *interface, const struct mqnic_capture_rule *rule);
+int mqnic_capture_del_rule(struct mqnic_if *interface, const void *owner, int index);
+void mqnic_capture_del_owner(struct mqnic_if *interface, const void *owner);
+void mqnic_capture_del_queue(struct mqnic_if *interface, u32 rxq);
+void mqnic_capture_update(struct mqnic_if *interface, struct mqnic_priv *priv);
+
+// mqnic_hwmon.c
+#ifdef MQNIC_HWMON
+int mqnic_hwmon_alveo_register(struct mqnic_dev *mqnic, struct mqnic_reg_block *rb);
+void mqnic_hwmon_unregister(struct mqnic_dev *mqnic);
+#else
+static inline int mqnic_hwmon_alveo_register(struct mqnic_dev *mqnic, struct mqnic_reg_block *rb)
+{
+	return 0;
+}
+
+static inline void mqnic_hwmon_unregister(struct mqnic_dev *mqnic)
+{
+}
+#endif
+
+// mqnic_sriov.c
+void mqnic_sriov_init(struct mqnic_dev *mdev);
+bool mqnic_sriov_is_vf(struct mqnic_dev *mdev);
+int mqnic_sriov_vf_init(struct mqnic_dev *mdev);
+#ifdef CONFIG_PCI
+int mqnic_sriov_configure(struct pci_dev *pdev, int num_vfs);
+void mqnic_sriov_disable(struct mqnic_dev *mdev);
+int mqnic_set_vf_mac(struct net_device *ndev, int vf, u8 *mac);
+int mqnic_get_vf_config(struct net_device *ndev, int vf, struct ifla_vf_info *ivi);
+#endif
 
 // mqnic_clk_info.c
 void mqnic_clk_info_init(struct mqnic_dev *mdev);
@@ -636,7 +1367,11 @@ u64 mqnic_ref_clk_ns_to_cycles(struct mqnic_dev *mdev, u64 ns);
 
 // mqnic_stats.c
 void mqnic_stats_init(struct mqnic_dev *mdev);
+void mqnic_stats_deinit(struct mqnic_dev *mdev);
 u64 mqnic_stats_read(struct mqnic_dev *mdev, int index);
+u32 mqnic_stats_dma_gen(struct mqnic_dev *mdev);
+int mqnic_stats_read_bulk(struct mqnic_dev *mdev, int index, u64 *buf, int count);
+u64 mqnic_stats_read_cached(struct mqnic_dev *mdev, int index);
 
 // mqnic_eq.c
 struct mqnic_eq *mqnic_create_eq(struct mqnic_if *interface);
@@ -647,7 +1382,7 @@ int mqnic_eq_attach_cq(struct mqnic_eq *eq, struct mqnic_cq *cq);
 void mqnic_eq_detach_cq(struct mqnic_eq *eq, struct mqnic_cq *cq);
 void mqnic_eq_write_cons_ptr(struct mqnic_eq *eq);
 void mqnic_arm_eq(struct mqnic_eq *eq);
-void mqnic_process_eq(struct mqnic_eq *eq);
+int mqnic_process_eq(struct mqnic_eq *eq, int budget);
 
 // mqnic_cq.c
 struct mqnic_cq *mqnic_create_cq(struct mqnic_if *interface);
@@ -655,7 +1390,15 @@ void mqnic_destroy_cq(struct mqnic_cq *cq);
 int mqnic_open_cq(struct mqnic_cq *cq, struct mqnic_eq *eq, int size);
 void mqnic_close_cq(struct mqnic_cq *cq);
 void mqnic_cq_write_cons_ptr(struct mqnic_cq *cq);
+void mqnic_cq_update_cons_ptr(struct mqnic_cq *cq);
 void mqnic_arm_cq(struct mqnic_cq *cq);
+void mqnic_cq_set_coalesce(struct mqnic_cq *cq, u32 usecs, u32 frames);
+void mqnic_rearm_cq(struct mqnic_cq *cq, int done);
+
+static inline struct napi_struct *mqnic_cq_napi(struct mqnic_cq *cq)
+{
+	return cq->rx_cq ? &cq->rx_cq->napi : &cq->napi;
+}
 
 // mqnic_tx.c
 struct mqnic_ring *mqnic_create_tx_ring(struct mqnic_if *interface);
@@ -671,9 +1414,18 @@ void mqnic_tx_read_cons_ptr(struct mqnic_ring *ring);
 void mqnic_tx_write_prod_ptr(struct mqnic_ring *ring);
 void mqnic_free_tx_desc(struct mqnic_ring *ring, int index, int napi_budget);
 int mqnic_free_tx_buf(struct mqnic_ring *ring);
+void mqnic_tx_cpl_begin(struct mqnic_ring *ring, struct mqnic_tx_cpl_ctx *ctx);
+void mqnic_tx_cpl(struct mqnic_ring *ring, struct mqnic_tx_cpl_ctx *ctx,
+		struct mqnic_cpl *cpl, int napi_budget);
+void mqnic_tx_cpl_end(struct mqnic_ring *ring, struct mqnic_tx_cpl_ctx *ctx);
 int mqnic_process_tx_cq(struct mqnic_cq *cq, int napi_budget);
 void mqnic_tx_irq(struct mqnic_cq *cq);
+int mqnic_reap_tx_cq(struct mqnic_cq *cq, int budget);
+void mqnic_complete_tx_cq(struct mqnic_cq *cq, int done);
 int mqnic_poll_tx_cq(struct napi_struct *napi, int budget);
+void mqnic_tx_dim_work(struct work_struct *work);
+netdev_features_t mqnic_features_check(struct sk_buff *skb, struct net_device *ndev,
+		netdev_features_t features);
 netdev_tx_t mqnic_start_xmit(struct sk_buff *skb, struct net_device *dev);
 
 // mqnic_rx.c
@@ -694,9 +1446,43 @@ int mqnic_prepare_rx_desc(struct mqnic_ring *ring, int index);
 int mqnic_refill_rx_buffers(struct mqnic_ring *ring);
 int mqnic_process_rx_cq(struct mqnic_cq *cq, int napi_budget);
 void mqnic_rx_irq(struct mqnic_cq *cq);
+void mqnic_rx_vlan(struct mqnic_ring *ring, const struct mqnic_cpl *cpl, struct sk_buff *skb);
+void mqnic_rx_hash(struct mqnic_ring *ring, const struct mqnic_cpl *cpl, struct sk_buff *skb);
 int mqnic_poll_rx_cq(struct napi_struct *napi, int budget);
+void mqnic_rx_dim_work(struct work_struct *work);
+
+// mqnic_xdp.c
+int mqnic_xdp_xmit_frame(struct mqnic_ring *ring, struct xdp_frame *xdpf);
+void mqnic_xdp_flush(struct mqnic_ring *ring);
+int mqnic_xdp_xmit(struct net_device *ndev, int n, struct xdp_frame **frames, u32 flags);
+u32 mqnic_run_xdp(struct mqnic_ring *rx_ring, struct bpf_prog *prog, struct xdp_buff *xdp);
+int mqnic_xdp(struct net_device *ndev, struct netdev_bpf *bpf);
+
+// mqnic_xsk.c
+int mqnic_xsk_pool_setup(struct net_device *ndev, struct xsk_buff_pool *pool, u16 qid);
+int mqnic_xsk_wakeup(struct net_device *ndev, u32 qid, u32 flags);
+int mqnic_prepare_rx_desc_zc(struct mqnic_ring *ring, int index);
+void mqnic_free_rx_desc_zc(struct mqnic_ring *ring, int index);
+int mqnic_process_rx_cq_zc(struct mqnic_cq *cq, int napi_budget);
+bool mqnic_xsk_xmit(struct mqnic_ring *ring, int budget);
 
 // mqnic_ethtool.c
 extern const struct ethtool_ops mqnic_ethtool_ops;
 
+// mqnic_dcb.c
+#ifdef CONFIG_DCB
+extern const struct dcbnl_rtnl_ops mqnic_dcbnl_ops;
+void mqnic_dcb_init(struct mqnic_priv *priv);
+bool mqnic_dcb_pfc_enabled(struct mqnic_priv *priv);
+#else
+static inline void mqnic_dcb_init(struct mqnic_priv *priv)
+{
+}
+
+static inline bool mqnic_dcb_pfc_enabled(struct mqnic_priv *priv)
+{
+	return false;
+}
+#endif
+
 #endif /* MQNIC_H */
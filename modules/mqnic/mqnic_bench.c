@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+
+/*
+ * Loopback datapath benchmark, debugfs mqnic/<netdev>/:
+ *   queues  number of TX queues to spread frames over (0 = all)
+ *   count   frames to send in total
+ *   size    frame length in bytes, without FCS
+ *   run     write to start a run with port loopback enabled, read for
+ *           the result of the last run
+ *
+ * Frames go through the regular ndo_start_xmit path and come back through
+ * NAPI, so the numbers cover the whole driver datapath. The RX side counts
+ * every ring, since loopback frames land wherever RSS puts them.
+ */
+
+#define MQNIC_BENCH_BATCH 32
+#define MQNIC_BENCH_TIMEOUT_MS 1000
+#define MQNIC_BENCH_IDLE_MS 100
+
+DEFINE_STATIC_KEY_FALSE(mqnic_bench_key);
+
+struct mqnic_bench_snap {
+	u64 tx_cycles;
+	u64 tx_packets;
+	u64 rx_cycles;
+	u64 rx_packets;
+	u64 rx_cpl_packets;
+};
+
+static u64 mqnic_bench_ring_packets(struct mqnic_ring *ring)
+{
+	unsigned int start;
+	u64 p;
+
+	do {
+		start = u64_stats_fetch_begin(&ring->syncp);
+		p = u64_stats_read(&ring->packets);
+	} while (u64_stats_fetch_retry(&ring->syncp, start));
+
+	return p;
+}
+
+static void mqnic_bench_snapshot(struct mqnic_priv *priv, struct mqnic_bench_snap *snap)
+{
+	struct mqnic_ring *ring;
+	int k;
+
+	memset(snap, 0, sizeof(*snap));
+
+	for (k = 0; k < priv->txq_count; k++) {
+		ring = priv->txq_table[k];
+		snap->tx_cycles += READ_ONCE(ring->bench_cycles);
+		snap->tx_packets += READ_ONCE(ring->bench_packets);
+	}
+
+	for (k = 0; k < priv->rxq_count; k++) {
+		ring = priv->rxq_table[k];
+		snap->rx_cycles += READ_ONCE(ring->bench_cycles);
+		snap->rx_cpl_packets += READ_ONCE(ring->bench_packets);
+		snap->rx_packets += mqnic_bench_ring_packets(ring);
+	}
+}
+
+static struct sk_buff *mqnic_bench_alloc_skb(struct mqnic_priv *priv, u32 len)
+{
+	struct net_device *ndev = priv->ndev;
+	struct sk_buff *skb;
+	struct ethhdr *eth;
+
+	skb = netdev_alloc_skb(ndev, len);
+	if (!skb)
+		return NULL;
+
+	eth = skb_put_zero(skb, len);
+	ether_addr_copy(eth->h_dest, ndev->dev_addr);
+	ether_addr_copy(eth->h_source, ndev->dev_addr);
+	eth->h_proto = htons(ETH_P_802_EX1);
+
+	skb->protocol = eth->h_proto;
+	skb->ip_summed = CHECKSUM_NONE;
+
+	return skb;
+}
+
+// the same skb is resent with an extra reference, as pktgen does with
+// clone_skb, so the generator itself stays out of the measurement
+static int mqnic_bench_xmit(struct mqnic_priv *priv, struct sk_buff *skb, u16 q, bool more)
+{
+	struct net_device *ndev = priv->ndev;
+	struct netdev_queue *txq = netdev_get_tx_queue(ndev, q);
+	unsigned long timeout = jiffies + msecs_to_jiffies(MQNIC_BENCH_TIMEOUT_MS);
+	netdev_tx_t ret;
+
+	for (;;) {
+		local_bh_disable();
+		__netif_tx_lock(txq, smp_processor_id());
+
+		if (!netif_xmit_frozen_or_drv_stopped(txq)) {
+			skb_get(skb);
+			skb_set_queue_mapping(skb, q);
+			ret = netdev_start_xmit(skb, ndev, txq, more);
+			__netif_tx_unlock(txq);
+			local_bh_enable();
+
+			return ret == NETDEV_TX_OK ? 0 : -EIO;
+		}
+
+		__netif_tx_unlock(txq);
+		local_bh_enable();
+
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+
+		// a stopped queue has already rung the doorbell, wait for completions
+		usleep_range(10, 20);
+	}
+}
+
+static int mqnic_bench_run(struct mqnic_priv *priv)
+{
+	struct mqnic_bench_snap before, after;
+	unsigned long idle_timeout;
+	struct sk_buff *skb;
+	u64 start_ns, end_ns, elapsed_ns;
+	u64 rx_packets, last_rx;
+	u64 tx_cpl, rx_cpl;
+	u64 kpps, mbps;
+	u32 kpps_rem, mbps_rem;
+	u32 queues, count, size;
+	bool loopback;
+	int ret = 0;
+	u32 k;
+
+	if (!(priv->port->port_features & MQNIC_PORT_FEATURE_LOOPBACK))
+		return -EOPNOTSUPP;
+
+	if (!priv->port_up)
+		return -ENETDOWN;
+
+	queues = priv->bench_queues;
+	if (!queues || queues > priv->txq_count)
+		queues = priv->txq_count;
+
+	count = priv->bench_count;
+	size = clamp_t(u32, priv->bench_size, ETH_ZLEN, priv->ndev->mtu + ETH_HLEN);
+
+	if (!count)
+		return -EINVAL;
+
+	skb = mqnic_bench_alloc_skb(priv, size);
+	if (!skb)
+		return -ENOMEM;
+
+	loopback = priv->loopback;
+	mqnic_set_port_loopback(priv, true);
+	static_branch_inc(&mqnic_bench_key);
+
+	// let frames already in flight drain before taking the baseline
+	msleep(20);
+
+	mqnic_bench_snapshot(priv, &before);
+	start_ns = ktime_get_ns();
+
+	for (k = 0; k < count; k++) {
+		bool more = (k + 1) % MQNIC_BENCH_BATCH && k + 1 < count;
+
+		ret = mqnic_bench_xmit(priv, skb, k % queues, more);
+		if (ret)
+			break;
+
+		if (!more)
+			cond_resched();
+	}
+
+	// wait until every sent frame came back or RX stops making progress
+	end_ns = ktime_get_ns();
+	last_rx = 0;
+	idle_timeout = jiffies + msecs_to_jiffies(MQNIC_BENCH_IDLE_MS);
+
+	while (!time_after(jiffies, idle_timeout)) {
+		mqnic_bench_snapshot(priv, &after);
+		rx_packets = after.rx_packets - before.rx_packets;
+
+		if (rx_packets != last_rx) {
+			last_rx = rx_packets;
+			end_ns = ktime_get_ns();
+			idle_timeout = jiffies + msecs_to_jiffies(MQNIC_BENCH_IDLE_MS);
+		}
+
+		if (rx_packets >= k)
+			break;
+
+		usleep_range(50, 100);
+	}
+
+	static_branch_dec(&mqnic_bench_key);
+	mqnic_set_port_loopback(priv, loopback);
+
+	kfree_skb(skb);
+
+	mqnic_bench_snapshot(priv, &after);
+	rx_packets = after.rx_packets - before.rx_packets;
+	elapsed_ns = max_t(u64, end_ns - start_ns, 1);
+	tx_cpl = after.tx_packets - before.tx_packets;
+	rx_cpl = after.rx_cpl_packets - before.rx_cpl_packets;
+	kpps = div64_u64(rx_packets * NSEC_PER_MSEC, elapsed_ns);
+	mbps = div64_u64(rx_packets * size * 8 * 1000, elapsed_ns);
+	kpps = div_u64_rem(kpps, 1000, &kpps_rem);
+	mbps = div_u64_rem(mbps, 1000, &mbps_rem);
+
+	snprintf(priv->bench_result, sizeof(priv->bench_result),
+			"queues=%u size=%u tx_packets=%u rx_packets=%llu ns=%llu mpps=%llu.%03u gbps=%llu.%03u tx_cpl_cycles_per_pkt=%llu rx_cycles_per_pkt=%llu status=%d\n",
+			queues, size, k, rx_packets, elapsed_ns,
+			kpps, kpps_rem, mbps, mbps_rem,
+			tx_cpl ? div64_u64(after.tx_cycles - before.tx_cycles, tx_cpl) : 0,
+			rx_cpl ? div64_u64(after.rx_cycles - before.rx_cycles, rx_cpl) : 0,
+			ret);
+
+	return ret;
+}
+
+static ssize_t mqnic_bench_run_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_priv *priv = file->private_data;
+	ssize_t ret;
+
+	mutex_lock(&priv->mdev->state_lock);
+	ret = simple_read_from_buffer(buf, count, ppos, priv->bench_result,
+			strlen(priv->bench_result));
+	mutex_unlock(&priv->mdev->state_lock);
+
+	return ret;
+}
+
+static ssize_t mqnic_bench_run_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_priv *priv = file->private_data;
+	int ret;
+
+	// state_lock keeps the rings in place for the whole run
+	mutex_lock(&priv->mdev->state_lock);
+	ret = mqnic_bench_run(priv);
+	mutex_unlock(&priv->mdev->state_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations mqnic_bench_run_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = mqnic_bench_run_read,
+	.write = mqnic_bench_run_write,
+	.llseek = default_llseek,
+};
+
+void mqnic_bench_create_debugfs(struct mqnic_priv *priv)
+{
+	priv->bench_queues = 0;
+	priv->bench_count = 1000000;
+	priv->bench_size = ETH_ZLEN;
+
+	debugfs_create_u32("queues", 0600, priv->debugfs_dir, &priv->bench_queues);
+	debugfs_create_u32("count", 0600, priv->debugfs_dir, &priv->bench_count);
+	debugfs_create_u32("size", 0600, priv->debugfs_dir, &priv->bench_size);
+	debugfs_create_file("run", 0600, priv->debugfs_dir, priv, &mqnic_bench_run_fops);
+}
@@ -816,7 +816,7 @@ static struct mqnic_board_ops generic_board_ops = {
 	.deinit = mqnic_generic_board_deinit
 };
 
-static u32 mqnic_alveo_bmc_reg_read(struct mqnic_dev *mqnic, struct mqnic_reg_block *rb, u32 reg)
+u32 mqnic_alveo_bmc_reg_read(struct mqnic_dev *mqnic, struct mqnic_reg_block *rb, u32 reg)
 {
 	iowrite32(reg, rb->regs + MQNIC_RB_ALVEO_BMC_REG_ADDR);
 	ioread32(rb->regs + MQNIC_RB_ALVEO_BMC_REG_DATA); // dummy read
@@ -947,10 +947,14 @@ static int mqnic_alveo_board_init(struct mqnic_dev *mqnic)
 			msleep(200);
 		}
 
-		if (mqnic_alveo_bmc_reg_read(mqnic, rb, 0x028000) != 0x74736574)
+		if (mqnic_alveo_bmc_reg_read(mqnic, rb, 0x028000) != 0x74736574) {
 			dev_warn(mqnic->dev, "Alveo CMS not responding");
-		else
+		} else {
 			mqnic_alveo_bmc_read_mac_list(mqnic, rb, 8);
+
+			if (mqnic_hwmon_alveo_register(mqnic, rb))
+				dev_warn(mqnic->dev, "Failed to register Alveo CMS sensors");
+		}
 	} else {
 		dev_warn(mqnic->dev, "Alveo CMS not found");
 	}
@@ -958,9 +962,16 @@ static int mqnic_alveo_board_init(struct mqnic_dev *mqnic)
 	return ret;
 }
 
+static void mqnic_alveo_board_deinit(struct mqnic_dev *mqnic)
+{
+	mqnic_hwmon_unregister(mqnic);
+
+	mqnic_generic_board_deinit(mqnic);
+}
+
 static struct mqnic_board_ops alveo_board_ops = {
 	.init = mqnic_alveo_board_init,
-	.deinit = mqnic_generic_board_deinit
+	.deinit = mqnic_alveo_board_deinit
 };
 
 static int mqnic_gecko_bmc_read(struct mqnic_dev *mqnic, struct mqnic_reg_block *rb)
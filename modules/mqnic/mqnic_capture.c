@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+#include <linux/unaligned.h>
+#else
+#include <asm/unaligned.h>
+#endif
+
+/*
+ * Timestamped packet capture.
+ *
+ * The capture block sits in front of the flow tables and RSS and copies
+ * frames that match a masked 16 byte window at a fixed offset, from a set
+ * of ports, to one capture queue, optionally cut to a snap length.  The
+ * original frame is delivered as usual, so capturing does not disturb the
+ * traffic being watched.  The copy carries the PHC arrival timestamp and
+ * the wire length in its completion.
+ *
+ * Rules are installed through the char device and go away with the file.
+ * The target is either an RXQ reserved on the same file and drained from
+ * userspace with the mqnic library, or an RX channel of a netdev for an
+ * AF_XDP socket bound to it; such a channel should be taken out of the RSS
+ * indirection table (ethtool -X), and its rule follows the channel to a
+ * new hardware queue and is disabled while the port is down.
+ */
+
+static void mqnic_capture_write_rule(struct mqnic_if *interface, int index)
+{
+	struct mqnic_capture_rule *rule = &interface->rx_capture_rules[index];
+	u8 __iomem *regs = interface->rx_capture_rb->regs;
+	struct mqnic_priv *priv = rule->priv;
+	struct mqnic_ring *q;
+	int queue = -1;
+	u32 ctrl = 0;
+	int k;
+
+	rcu_read_lock();
+
+	if (priv) {
+		if (priv->port_up && rule->rxq < priv->rxq_count) {
+			q = rcu_dereference(priv->rxq_table[rule->rxq]);
+			if (q)
+				queue = q->index;
+		}
+	} else if (rule->owner) {
+		queue = rule->rxq;
+	}
+
+	rcu_read_unlock();
+
+	iowrite32(index, regs + MQNIC_RB_RX_CAPTURE_REG_INDEX);
+
+	if (queue >= 0) {
+		iowrite32(queue, regs + MQNIC_RB_RX_CAPTURE_REG_QUEUE);
+		iowrite32(rule->snaplen, regs + MQNIC_RB_RX_CAPTURE_REG_SNAPLEN);
+		iowrite32(rule->offset, regs + MQNIC_RB_RX_CAPTURE_REG_OFFSET);
+
+		for (k = 0; k < MQNIC_RX_CAPTURE_MATCH_SIZE / 4; k++) {
+			iowrite32(get_unaligned_le32(rule->match + k * 4),
+					regs + MQNIC_RB_RX_CAPTURE_REG_MATCH + k * 4);
+			iowrite32(get_unaligned_le32(rule->mask + k * 4),
+					regs + MQNIC_RB_RX_CAPTURE_REG_MASK + k * 4);
+		}
+
+		ctrl = MQNIC_RX_CAPTURE_CTRL_ENABLE | (rule->port_mask & MQNIC_RX_CAPTURE_CTRL_PORT_MASK);
+	}
+
+	// control write commits the rule
+	iowrite32(ctrl, regs + MQNIC_RB_RX_CAPTURE_REG_CTRL);
+}
+
+int mqnic_capture_init(struct mqnic_if *interface)
+{
+	u32 val;
+	int k;
+
+	spin_lock_init(&interface->rx_capture_lock);
+
+	if (!(interface->if_features & MQNIC_IF_FEATURE_RX_CAPTURE))
+		return 0;
+
+	interface->rx_capture_rb = mqnic_find_reg_block(interface->rb_list,
+			MQNIC_RB_RX_CAPTURE_TYPE, MQNIC_RB_RX_CAPTURE_VER, 0);
+
+	if (!interface->rx_capture_rb)
+		return 0;
+
+	val = ioread32(interface->rx_capture_rb->regs + MQNIC_RB_RX_CAPTURE_REG_CFG);
+
+	if (((val >> 8) & 0xff) != MQNIC_RX_CAPTURE_MATCH_SIZE) {
+		dev_warn(interface->dev, "Unsupported capture match window of %d bytes", (val >> 8) & 0xff);
+		interface->rx_capture_rb = NULL;
+		return 0;
+	}
+
+	interface->rx_capture_rule_count = val & 0xff;
+	interface->rx_capture_offset_max = val >> 16;
+
+	dev_info(interface->dev, "RX capture rules: %d", interface->rx_capture_rule_count);
+
+	interface->rx_capture_rules = kcalloc(interface->rx_capture_rule_count,
+			sizeof(*interface->rx_capture_rules), GFP_KERNEL);
+	if (!interface->rx_capture_rules)
+		return -ENOMEM;
+
+	// clear table
+	for (k = 0; k < interface->rx_capture_rule_count; k++)
+		mqnic_capture_write_rule(interface, k);
+
+	return 0;
+}
+
+void mqnic_capture_deinit(struct mqnic_if *interface)
+{
+	int k;
+
+	if (!interface->rx_capture_rules)
+		return;
+
+	spin_lock_bh(&interface->rx_capture_lock);
+
+	for (k = 0; k < interface->rx_capture_rule_count; k++) {
+		memset(&interface->rx_capture_rules[k], 0, sizeof(struct mqnic_capture_rule));
+		mqnic_capture_write_rule(interface, k);
+	}
+
+	kfree(interface->rx_capture_rules);
+	interface->rx_capture_rules = NULL;
+
+	spin_unlock_bh(&interface->rx_capture_lock);
+}
+
+// place a rule in the first free slot, returns its index
+int mqnic_capture_add_rule(struct mqnic_if *interface, const struct mqnic_capture_rule *rule)
+{
+	int k;
+
+	if (!rule->owner)
+		return -EINVAL;
+
+	if (!rule->port_mask || rule->port_mask & ~GENMASK(interface->port_count - 1, 0))
+		return -EINVAL;
+
+	if (rule->snaplen && rule->snaplen < ETH_HLEN)
+		return -EINVAL;
+
+	if (rule->offset > interface->rx_capture_offset_max)
+		return -EINVAL;
+
+	spin_lock_bh(&interface->rx_capture_lock);
+
+	if (!interface->rx_capture_rules) {
+		spin_unlock_bh(&interface->rx_capture_lock);
+		return -EOPNOTSUPP;
+	}
+
+	for (k = 0; k < interface->rx_capture_rule_count; k++) {
+		if (interface->rx_capture_rules[k].owner)
+			continue;
+
+		interface->rx_capture_rules[k] = *rule;
+		mqnic_capture_write_rule(interface, k);
+
+		spin_unlock_bh(&interface->rx_capture_lock);
+		return k;
+	}
+
+	spin_unlock_bh(&interface->rx_capture_lock);
+
+	return -ENOSPC;
+}
+
+int mqnic_capture_del_rule(struct mqnic_if *interface, const void *owner, int index)
+{
+	int ret = -ENOENT;
+
+	spin_lock_bh(&interface->rx_capture_lock);
+
+	if (interface->rx_capture_rules && index >= 0 && index < interface->rx_capture_rule_count &&
+			interface->rx_capture_rules[index].owner == owner) {
+		memset(&interface->rx_capture_rules[index], 0, sizeof(struct mqnic_capture_rule));
+		mqnic_capture_write_rule(interface, index);
+		ret = 0;
+	}
+
+	spin_unlock_bh(&interface->rx_capture_lock);
+
+	return ret;
+}
+
+void mqnic_capture_del_owner(struct mqnic_if *interface, const void *owner)
+{
+	int k;
+
+	spin_lock_bh(&interface->rx_capture_lock);
+
+	for (k = 0; interface->rx_capture_rules && k < interface->rx_capture_rule_count; k++) {
+		if (interface->rx_capture_rules[k].owner != owner)
+			continue;
+
+		memset(&interface->rx_capture_rules[k], 0, sizeof(struct mqnic_capture_rule));
+		mqnic_capture_write_rule(interface, k);
+	}
+
+	spin_unlock_bh(&interface->rx_capture_lock);
+}
+
+// drop rules aimed at a hardware RXQ before it is freed
+void mqnic_capture_del_queue(struct mqnic_if *interface, u32 rxq)
+{
+	int k;
+
+	spin_lock_bh(&interface->rx_capture_lock);
+
+	for (k = 0; interface->rx_capture_rules && k < interface->rx_capture_rule_count; k++) {
+		struct mqnic_capture_rule *rule = &interface->rx_capture_rules[k];
+
+		if (!rule->owner || rule->priv || rule->rxq != rxq)
+			continue;
+
+		memset(rule, 0, sizeof(*rule));
+		mqnic_capture_write_rule(interface, k);
+	}
+
+	spin_unlock_bh(&interface->rx_capture_lock);
+}
+
+// reprogram rules aimed at the channels of priv after its queues change
+void mqnic_capture_update(struct mqnic_if *interface, struct mqnic_priv *priv)
+{
+	int k;
+
+	spin_lock_bh(&interface->rx_capture_lock);
+
+	for (k = 0; interface->rx_capture_rules && k < interface->rx_capture_rule_count; k++)
+		if (interface->rx_capture_rules[k].priv == priv)
+			mqnic_capture_write_rule(interface, k);
+
+	spin_unlock_bh(&interface->rx_capture_lock);
+}
@@ -4,6 +4,22 @@
  */
 
 #include "mqnic.h"
+#include "mqnic_trace.h"
+
+// consumer pointer updates are held back until this fraction of the CQ
+// (1 / 2^shift) is consumed but not yet handed back; arming always flushes
+#define MQNIC_CQ_CONS_PTR_SLACK_SHIFT 3
+
+static enum hrtimer_restart mqnic_cq_holdoff_timeout(struct hrtimer *timer)
+{
+	struct mqnic_cq *cq = container_of(timer, struct mqnic_cq, holdoff_timer);
+
+	// holdoff expired; poll again instead of taking an interrupt
+	cq->event_ctr++;
+	napi_schedule_irqoff(mqnic_cq_napi(cq));
+
+	return HRTIMER_NORESTART;
+}
 
 struct mqnic_cq *mqnic_create_cq(struct mqnic_if *interface)
 {
@@ -23,6 +39,14 @@ struct mqnic_cq *mqnic_create_cq(struct mqnic_if *interface)
 
 	cq->cons_ptr = 0;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&cq->holdoff_timer, mqnic_cq_holdoff_timeout,
+			CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&cq->holdoff_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cq->holdoff_timer.function = mqnic_cq_holdoff_timeout;
+#endif
+
 	return cq;
 }
 
@@ -48,8 +72,11 @@ int mqnic_open_cq(struct mqnic_cq *cq, struct mqnic_eq *eq, int size)
 	cq->size_mask = cq->size - 1;
 	cq->stride = roundup_pow_of_two(MQNIC_CPL_SIZE);
 
+	cq->node = eq->irq->node;
+
 	cq->buf_size = cq->size * cq->stride;
-	cq->buf = dma_alloc_coherent(cq->dev, cq->buf_size, &cq->buf_dma_addr, GFP_KERNEL);
+	cq->buf = mqnic_dma_arena_alloc(&cq->interface->dma_arena, cq->buf_size,
+			&cq->buf_dma_addr, cq->node);
 	if (!cq->buf) {
 		ret = -ENOMEM;
 		goto fail;
@@ -60,6 +87,7 @@ int mqnic_open_cq(struct mqnic_cq *cq, struct mqnic_eq *eq, int size)
 	cq->hw_addr = mqnic_res_get_addr(cq->interface->cq_res, cq->cqn);
 
 	cq->cons_ptr = 0;
+	cq->event_ctr = 0;
 
 	// clear all phase tag bits
 	memset(cq->buf, 0, cq->buf_size);
@@ -82,11 +110,16 @@ int mqnic_open_cq(struct mqnic_cq *cq, struct mqnic_eq *eq, int size)
 			cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
 	iowrite32(MQNIC_CQ_CMD_SET_CONS_PTR | (cq->cons_ptr & MQNIC_CQ_PTR_MASK),
 			cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
+	cq->hw_cons_ptr = cq->cons_ptr;
+	cq->ptr_shadow = mqnic_interface_attach_ptr_shadow(cq->interface,
+			cq->interface->cq_res, cq->cqn, cq->hw_addr + MQNIC_CQ_SHADOW_ADDR_REG);
 	// activate queue
 	iowrite32(MQNIC_CQ_CMD_SET_ENABLE | 1, cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
 
 	cq->enabled = 1;
 
+	mqnic_cq_set_coalesce(cq, cq->coal_usecs, cq->coal_frames);
+
 	return 0;
 
 fail:
@@ -96,9 +129,14 @@ fail:
 
 void mqnic_close_cq(struct mqnic_cq *cq)
 {
+	hrtimer_cancel(&cq->holdoff_timer);
+
 	if (cq->hw_addr) {
 		// deactivate queue
 		iowrite32(MQNIC_CQ_CMD_SET_ENABLE | 0, cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
+
+		mqnic_interface_detach_ptr_shadow(cq->ptr_shadow, cq->hw_addr + MQNIC_CQ_SHADOW_ADDR_REG);
+		cq->ptr_shadow = NULL;
 	}
 
 	if (cq->eq) {
@@ -109,7 +147,8 @@ void mqnic_close_cq(struct mqnic_cq *cq)
 	cq->hw_addr = NULL;
 
 	if (cq->buf) {
-		dma_free_coherent(cq->dev, cq->buf_size, cq->buf, cq->buf_dma_addr);
+		mqnic_dma_arena_free(&cq->interface->dma_arena, cq->buf_size,
+				cq->buf, cq->buf_dma_addr);
 		cq->buf = NULL;
 		cq->buf_dma_addr = 0;
 	}
@@ -122,14 +161,59 @@ void mqnic_close_cq(struct mqnic_cq *cq)
 
 void mqnic_cq_write_cons_ptr(struct mqnic_cq *cq)
 {
+	cq->hw_cons_ptr = cq->cons_ptr;
 	iowrite32(MQNIC_CQ_CMD_SET_CONS_PTR | (cq->cons_ptr & MQNIC_CQ_PTR_MASK),
 			cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
 }
 
+// called after processing; the hardware only needs the consumer pointer
+// before it runs out of room, and the arm at the end of the poll carries it
+void mqnic_cq_update_cons_ptr(struct mqnic_cq *cq)
+{
+	if (cq->cons_ptr - cq->hw_cons_ptr >= cq->size >> MQNIC_CQ_CONS_PTR_SLACK_SHIFT)
+		mqnic_cq_write_cons_ptr(cq);
+}
+
 void mqnic_arm_cq(struct mqnic_cq *cq)
 {
 	if (!cq->enabled)
 		return;
 
+	// fold a held back consumer pointer update into the arm
+	if (cq->hw_cons_ptr != cq->cons_ptr) {
+		cq->hw_cons_ptr = cq->cons_ptr;
+		iowrite32(MQNIC_CQ_CMD_SET_CONS_PTR_ARM | (cq->cons_ptr & MQNIC_CQ_PTR_MASK),
+				cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
+		return;
+	}
+
 	iowrite32(MQNIC_CQ_CMD_SET_ARM | 1, cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
 }
+
+void mqnic_cq_set_coalesce(struct mqnic_cq *cq, u32 usecs, u32 frames)
+{
+	cq->coal_usecs = min_t(u32, usecs, MQNIC_CQ_HOLDOFF_MASK);
+	cq->coal_frames = min_t(u32, frames, MQNIC_CQ_HOLDOFF_MASK);
+
+	if (!cq->hw_addr || !(cq->interface->if_features & MQNIC_IF_FEATURE_CQ_HOLDOFF))
+		return;
+
+	iowrite32(MQNIC_CQ_CMD_SET_HOLDOFF_USECS | cq->coal_usecs,
+			cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
+	iowrite32(MQNIC_CQ_CMD_SET_HOLDOFF_FRAMES | cq->coal_frames,
+			cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
+}
+
+void mqnic_rearm_cq(struct mqnic_cq *cq, int done)
+{
+	// without a hardware holdoff timer, defer re-arming while traffic is flowing
+	if (done && cq->coal_usecs && !(cq->interface->if_features & MQNIC_IF_FEATURE_CQ_HOLDOFF)) {
+		trace_mqnic_cq_arm(cq, done, true);
+		hrtimer_start(&cq->holdoff_timer, ns_to_ktime(cq->coal_usecs * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+		return;
+	}
+
+	trace_mqnic_cq_arm(cq, done, false);
+	mqnic_arm_cq(cq);
+}
@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#ifdef CONFIG_DCB
+
+/*
+ * IEEE DCB through dcbnl, driven by a host LLDP agent (lldpad, or dcb/
+ * dcbtool by hand):
+ *   ETS: the priority to traffic class table becomes the netdev prio_tc_map,
+ *     the TX queues are split evenly between the classes, and the bandwidth
+ *     shares weight the data budgets of the scheduler channels, one channel
+ *     per class
+ *   PFC: the per-priority TX and RX enables of the port
+ *
+ * DCB and hardware mqprio both lay out traffic classes and exclude each
+ * other.  The scheduler is round robin between channels, so strict priority
+ * classes are not supported.
+ */
+
+static bool mqnic_dcb_pfc_supported(struct mqnic_priv *priv)
+{
+	return (priv->if_features & MQNIC_IF_FEATURE_PFC) &&
+		(priv->port->port_features & MQNIC_PORT_FEATURE_PFC);
+}
+
+bool mqnic_dcb_pfc_enabled(struct mqnic_priv *priv)
+{
+	return priv->dcb_pfc.pfc_en != 0;
+}
+
+static int mqnic_dcbnl_ieee_getets(struct net_device *ndev, struct ieee_ets *ets)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	*ets = priv->dcb_ets;
+	ets->ets_cap = priv->interface->sched_tc_count;
+
+	return 0;
+}
+
+static int mqnic_dcbnl_check_ets(struct mqnic_priv *priv, struct ieee_ets *ets, u8 *num_tc)
+{
+	u32 bw = 0;
+	int k;
+
+	*num_tc = 1;
+
+	for (k = 0; k < IEEE_8021QAZ_MAX_TCS; k++) {
+		if (ets->prio_tc[k] >= priv->interface->sched_tc_count)
+			return -EINVAL;
+
+		*num_tc = max_t(u8, *num_tc, ets->prio_tc[k] + 1);
+	}
+
+	for (k = 0; k < IEEE_8021QAZ_MAX_TCS; k++) {
+		if (k >= *num_tc) {
+			if (ets->tc_tx_bw[k])
+				return -EINVAL;
+			continue;
+		}
+
+		if (ets->tc_tsa[k] != IEEE_8021QAZ_TSA_ETS)
+			return -EOPNOTSUPP;
+
+		bw += ets->tc_tx_bw[k];
+	}
+
+	if (bw != 100)
+		return -EINVAL;
+
+	// every class needs a queue of its own
+	if (*num_tc > priv->txq_count)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int mqnic_dcbnl_ieee_setets(struct net_device *ndev, struct ieee_ets *ets)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	u8 num_tc;
+	int port_up;
+	int ret;
+	int k;
+
+	ret = mqnic_dcbnl_check_ets(priv, ets, &num_tc);
+	if (ret)
+		return ret;
+
+	if (netdev_get_num_tc(ndev) && !priv->dcb_tcs) {
+		netdev_err(ndev, "Traffic classes are set up through mqprio");
+		return -EBUSY;
+	}
+
+	mqnic_netdev_lock(ndev);
+	mutex_lock(&mdev->state_lock);
+
+	// queue to TC assignment and channel budgets are set on port start
+	port_up = priv->port_up;
+
+	if (port_up)
+		mqnic_stop_port(ndev);
+
+	memset(priv->tc_min_rate, 0, sizeof(priv->tc_min_rate));
+	memset(priv->tc_max_rate, 0, sizeof(priv->tc_max_rate));
+	memset(priv->tc_bw, 0, sizeof(priv->tc_bw));
+
+	if (num_tc == 1) {
+		netdev_reset_tc(ndev);
+		priv->dcb_tcs = false;
+	} else {
+		u32 count = priv->txq_count / num_tc;
+
+		ret = netdev_set_num_tc(ndev, num_tc);
+		if (ret)
+			goto out;
+
+		for (k = 0; k < num_tc; k++) {
+			netdev_set_tc_queue(ndev, k, count, k * count);
+			priv->tc_bw[k] = ets->tc_tx_bw[k];
+		}
+
+		for (k = 0; k < IEEE_8021QAZ_MAX_TCS; k++)
+			netdev_set_prio_tc_map(ndev, k, ets->prio_tc[k]);
+
+		priv->dcb_tcs = true;
+	}
+
+	priv->dcb_ets = *ets;
+
+out:
+	if (port_up) {
+		int err = mqnic_start_port(ndev);
+
+		if (err) {
+			netdev_err(ndev, "Failed to start port on interface %d: %d",
+					priv->interface->index, err);
+			if (!ret)
+				ret = err;
+		}
+	}
+
+	mutex_unlock(&mdev->state_lock);
+	mqnic_netdev_unlock(ndev);
+
+	return ret;
+}
+
+static int mqnic_dcbnl_ieee_getpfc(struct net_device *ndev, struct ieee_pfc *pfc)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	*pfc = priv->dcb_pfc;
+	pfc->pfc_cap = mqnic_dcb_pfc_supported(priv) ? IEEE_8021QAZ_MAX_TCS : 0;
+
+	return 0;
+}
+
+static int mqnic_dcbnl_ieee_setpfc(struct net_device *ndev, struct ieee_pfc *pfc)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	u32 val;
+	int k;
+
+	if (!mqnic_dcb_pfc_supported(priv))
+		return -EOPNOTSUPP;
+
+	// 802.3x pause and PFC do not mix on one link
+	if (pfc->pfc_en && (priv->if_features & MQNIC_IF_FEATURE_LFC) &&
+			(mqnic_port_get_lfc_ctrl(priv->port) &
+			(MQNIC_PORT_LFC_CTRL_TX_LFC_EN | MQNIC_PORT_LFC_CTRL_RX_LFC_EN))) {
+		netdev_err(ndev, "Link flow control is enabled");
+		return -EBUSY;
+	}
+
+	for (k = 0; k < IEEE_8021QAZ_MAX_TCS; k++) {
+		val = mqnic_port_get_pfc_ctrl(priv->port, k);
+
+		if (pfc->pfc_en & BIT(k))
+			val |= MQNIC_PORT_PFC_CTRL_TX_PFC_EN | MQNIC_PORT_PFC_CTRL_RX_PFC_EN;
+		else
+			val &= ~(MQNIC_PORT_PFC_CTRL_TX_PFC_EN | MQNIC_PORT_PFC_CTRL_RX_PFC_EN);
+
+		mqnic_port_set_pfc_ctrl(priv->port, k, val);
+	}
+
+	priv->dcb_pfc.pfc_en = pfc->pfc_en;
+	priv->dcb_pfc.mbc = pfc->mbc;
+	priv->dcb_pfc.delay = pfc->delay;
+
+	return 0;
+}
+
+static u8 mqnic_dcbnl_getdcbx(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	return priv->dcbx_mode;
+}
+
+// there is no firmware agent, only a host one speaking IEEE
+static u8 mqnic_dcbnl_setdcbx(struct net_device *ndev, u8 mode)
+{
+	if (mode != (DCB_CAP_DCBX_HOST | DCB_CAP_DCBX_VER_IEEE))
+		return 1;
+
+	return 0;
+}
+
+const struct dcbnl_rtnl_ops mqnic_dcbnl_ops = {
+	.ieee_getets = mqnic_dcbnl_ieee_getets,
+	.ieee_setets = mqnic_dcbnl_ieee_setets,
+	.ieee_getpfc = mqnic_dcbnl_ieee_getpfc,
+	.ieee_setpfc = mqnic_dcbnl_ieee_setpfc,
+	.getdcbx = mqnic_dcbnl_getdcbx,
+	.setdcbx = mqnic_dcbnl_setdcbx,
+};
+
+void mqnic_dcb_init(struct mqnic_priv *priv)
+{
+	int k;
+
+	if (priv->interface->sched_tc_count < 2 && !mqnic_dcb_pfc_supported(priv))
+		return;
+
+	priv->dcbx_mode = DCB_CAP_DCBX_HOST | DCB_CAP_DCBX_VER_IEEE;
+
+	// everything in one class until an agent says otherwise
+	for (k = 0; k < IEEE_8021QAZ_MAX_TCS; k++)
+		priv->dcb_ets.tc_tsa[k] = IEEE_8021QAZ_TSA_ETS;
+	priv->dcb_ets.tc_tx_bw[0] = 100;
+
+	priv->ndev->dcbnl_ops = &mqnic_dcbnl_ops;
+}
+
+#endif
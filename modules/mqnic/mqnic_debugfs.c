@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+/*
+ * Queue state inspector, debugfs mqnic/<netdev>/:
+ *   txq, rxq  one line per ring with its CQ: software pointers next to the
+ *             pointers read back from the queue registers, occupancy, and
+ *             the age of the last completion event
+ *   eq        the same for every EQ of the interface
+ *
+ * Reads take state_lock only to keep the rings in place; the datapath keeps
+ * running, so software and hardware values are a loose snapshot.
+ */
+
+static struct dentry *mqnic_debugfs_root;
+
+static u64 mqnic_debugfs_age_us(u64 now, u64 ts)
+{
+	return ts ? div_u64(now - ts, NSEC_PER_USEC) : 0;
+}
+
+static void mqnic_debugfs_show_ring(struct seq_file *s, struct mqnic_ring *ring, int k, u64 now)
+{
+	struct mqnic_cq *cq = ring->cq;
+	u32 val, ptr;
+	u32 cq_val, cq_ptr;
+
+	val = ioread32(ring->hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
+	ptr = mqnic_read_hw_ptr(ring->ptr_shadow, ring->hw_addr + MQNIC_QUEUE_PTR_REG);
+
+	seq_printf(s, "%d: index=%d size=%u enabled=%d hw_en=%d hw_active=%d prod=%u cons=%u hw_prod=%u hw_cons=%u occupancy=%u",
+			k, ring->index, ring->size, ring->enabled,
+			!!(val & MQNIC_QUEUE_ENABLE_MASK), !!(val & MQNIC_QUEUE_ACTIVE_MASK),
+			ring->prod_ptr & MQNIC_QUEUE_PTR_MASK,
+			READ_ONCE(ring->cons_ptr) & MQNIC_QUEUE_PTR_MASK,
+			ptr & MQNIC_QUEUE_PTR_MASK, (ptr >> 16) & MQNIC_QUEUE_PTR_MASK,
+			ring->prod_ptr - READ_ONCE(ring->cons_ptr));
+
+	if (ring->tx_queue)
+		seq_printf(s, " db_prod=%u stopped=%d",
+				ring->db_prod_ptr & MQNIC_QUEUE_PTR_MASK,
+				netif_tx_queue_stopped(ring->tx_queue));
+
+	if (cq) {
+		cq_val = ioread32(cq->hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
+		cq_ptr = mqnic_read_hw_ptr(cq->ptr_shadow, cq->hw_addr + MQNIC_CQ_PTR_REG);
+
+		seq_printf(s, " cqn=%d eqn=%d cq_cons=%u cq_hw_prod=%u cq_hw_cons=%u cq_hw_en=%d cq_armed=%d last_event_us=%llu",
+				cq->cqn, cq->eq ? cq->eq->eqn : -1,
+				cq->cons_ptr & MQNIC_CQ_PTR_MASK,
+				cq_ptr & MQNIC_CQ_PTR_MASK, (cq_ptr >> 16) & MQNIC_CQ_PTR_MASK,
+				!!(cq_val & MQNIC_CQ_ENABLE_MASK), !!(cq_val & MQNIC_CQ_ARM_MASK),
+				mqnic_debugfs_age_us(now, READ_ONCE(cq->last_event_ns)));
+	}
+
+	seq_puts(s, "\n");
+}
+
+static int mqnic_debugfs_show_rings(struct seq_file *s, bool rx)
+{
+	struct mqnic_priv *priv = s->private;
+	u64 now = ktime_get_ns();
+	u32 count;
+	int k;
+
+	mutex_lock(&priv->mdev->state_lock);
+
+	if (!priv->port_up) {
+		seq_puts(s, "port down\n");
+		goto out;
+	}
+
+	count = rx ? priv->rxq_count : priv->txq_count;
+
+	for (k = 0; k < count; k++)
+		mqnic_debugfs_show_ring(s, rx ? priv->rxq_table[k] : priv->txq_table[k], k, now);
+
+	if (!rx) {
+		for (k = 0; k < priv->xdp_txq_count; k++)
+			mqnic_debugfs_show_ring(s, priv->xdp_txq[k], count + k, now);
+	}
+
+out:
+	mutex_unlock(&priv->mdev->state_lock);
+
+	return 0;
+}
+
+static int mqnic_debugfs_txq_show(struct seq_file *s, void *data)
+{
+	return mqnic_debugfs_show_rings(s, false);
+}
+DEFINE_SHOW_ATTRIBUTE(mqnic_debugfs_txq);
+
+static int mqnic_debugfs_rxq_show(struct seq_file *s, void *data)
+{
+	return mqnic_debugfs_show_rings(s, true);
+}
+DEFINE_SHOW_ATTRIBUTE(mqnic_debugfs_rxq);
+
+static int mqnic_debugfs_eq_show(struct seq_file *s, void *data)
+{
+	struct mqnic_priv *priv = s->private;
+	struct mqnic_if *interface = priv->interface;
+	u64 now = ktime_get_ns();
+	struct mqnic_eq *eq;
+	u32 val, ptr;
+	int k;
+
+	mutex_lock(&priv->mdev->state_lock);
+
+	for (k = 0; k < interface->eq_count; k++) {
+		eq = interface->eq_table[k];
+
+		if (!eq || !eq->enabled)
+			continue;
+
+		val = ioread32(eq->hw_addr + MQNIC_EQ_CTRL_STATUS_REG);
+		ptr = mqnic_read_hw_ptr(eq->ptr_shadow, eq->hw_addr + MQNIC_EQ_PTR_REG);
+
+		seq_printf(s, "%d: eqn=%d size=%u irq=%d cons=%u hw_prod=%u hw_cons=%u hw_en=%d armed=%d deferred=%d last_irq_us=%llu\n",
+				k, eq->eqn, eq->size, eq->irq ? eq->irq->irqn : -1,
+				eq->cons_ptr & MQNIC_EQ_PTR_MASK,
+				ptr & MQNIC_EQ_PTR_MASK, (ptr >> 16) & MQNIC_EQ_PTR_MASK,
+				!!(val & MQNIC_EQ_ENABLE_MASK), !!(val & MQNIC_EQ_ARM_MASK),
+				READ_ONCE(eq->deferred),
+				mqnic_debugfs_age_us(now, READ_ONCE(eq->last_irq_ns)));
+	}
+
+	mutex_unlock(&priv->mdev->state_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mqnic_debugfs_eq);
+
+void mqnic_create_netdev_debugfs(struct mqnic_priv *priv)
+{
+	if (!mqnic_debugfs_root)
+		return;
+
+	priv->debugfs_dir = debugfs_create_dir(netdev_name(priv->ndev), mqnic_debugfs_root);
+
+	debugfs_create_file("txq", 0400, priv->debugfs_dir, priv, &mqnic_debugfs_txq_fops);
+	debugfs_create_file("rxq", 0400, priv->debugfs_dir, priv, &mqnic_debugfs_rxq_fops);
+	debugfs_create_file("eq", 0400, priv->debugfs_dir, priv, &mqnic_debugfs_eq_fops);
+
+	mqnic_bench_create_debugfs(priv);
+	mqnic_lat_create_debugfs(priv);
+}
+
+void mqnic_destroy_netdev_debugfs(struct mqnic_priv *priv)
+{
+	if (priv->debugfs_dir)
+		mqnic_lat_destroy(priv);
+
+	debugfs_remove_recursive(priv->debugfs_dir);
+	priv->debugfs_dir = NULL;
+}
+
+void mqnic_debugfs_init(void)
+{
+	mqnic_debugfs_root = debugfs_create_dir(KBUILD_MODNAME, NULL);
+}
+
+void mqnic_debugfs_exit(void)
+{
+	debugfs_remove_recursive(mqnic_debugfs_root);
+	mqnic_debugfs_root = NULL;
+}
@@ -7,35 +7,360 @@
 #include "mqnic_ioctl.h"
 
 #include <linux/uaccess.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+
+// per-open state; queues and DMA mappings are released with the file
+struct mqnic_file {
+	struct mqnic_dev *mdev;
+
+	struct mutex lock;
+	struct list_head queues;
+	struct list_head dma_maps;
+};
+
+struct mqnic_file_queue {
+	struct list_head list;
+	struct mqnic_if *interface;
+	u32 type;
+	int index;
+};
+
+struct mqnic_file_dma_map {
+	struct list_head list;
+	u64 vaddr;
+	u64 size;
+	unsigned long npages;
+	struct page **pages;
+	struct sg_table sgt;
+	dma_addr_t iova;
+};
+
+static struct mqnic_res *mqnic_file_queue_res(struct mqnic_if *interface, u32 type)
+{
+	switch (type) {
+	case MQNIC_QUEUE_TYPE_EQ:
+		return interface->eq_res;
+	case MQNIC_QUEUE_TYPE_CQ:
+		return interface->cq_res;
+	case MQNIC_QUEUE_TYPE_TXQ:
+		return interface->txq_res;
+	case MQNIC_QUEUE_TYPE_RXQ:
+		return interface->rxq_res;
+	default:
+		return NULL;
+	}
+}
+
+static void mqnic_file_free_queue(struct mqnic_file_queue *q)
+{
+	struct mqnic_res *res = mqnic_file_queue_res(q->interface, q->type);
+	u8 __iomem *hw_addr = mqnic_res_get_addr(res, q->index);
+
+	// no more capture copies for a queue about to be handed out again
+	if (q->type == MQNIC_QUEUE_TYPE_RXQ)
+		mqnic_capture_del_queue(q->interface, q->index);
+
+	// stop DMA before the memory behind the queue goes away
+	switch (q->type) {
+	case MQNIC_QUEUE_TYPE_EQ:
+		iowrite32(MQNIC_EQ_CMD_SET_ENABLE | 0, hw_addr + MQNIC_EQ_CTRL_STATUS_REG);
+		break;
+	case MQNIC_QUEUE_TYPE_CQ:
+		iowrite32(MQNIC_CQ_CMD_SET_ENABLE | 0, hw_addr + MQNIC_CQ_CTRL_STATUS_REG);
+		break;
+	default:
+		iowrite32(MQNIC_QUEUE_CMD_SET_ENABLE | 0, hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
+		break;
+	}
+
+	mqnic_res_free(res, q->index);
+
+	list_del(&q->list);
+	kfree(q);
+}
+
+static void mqnic_file_unpin(struct mqnic_file_dma_map *map)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+	unpin_user_pages_dirty_lock(map->pages, map->npages, true);
+#else
+	unsigned long k;
+
+	for (k = 0; k < map->npages; k++) {
+		set_page_dirty_lock(map->pages[k]);
+		put_page(map->pages[k]);
+	}
+#endif
+}
+
+static void mqnic_file_dma_unmap(struct mqnic_dev *mqnic, struct mqnic_file_dma_map *map)
+{
+	dma_unmap_sg(mqnic->dev, map->sgt.sgl, map->sgt.orig_nents, DMA_BIDIRECTIONAL);
+	sg_free_table(&map->sgt);
+	mqnic_file_unpin(map);
+	kvfree(map->pages);
+
+	list_del(&map->list);
+	kfree(map);
+}
+
+static int mqnic_file_dma_map(struct mqnic_file *fp, struct mqnic_ioctl_dma_map *info)
+{
+	struct mqnic_dev *mqnic = fp->mdev;
+	struct mqnic_file_dma_map *map;
+	long pinned;
+	int nents;
+	int ret;
+
+	if (!info->size || !PAGE_ALIGNED(info->vaddr) || !PAGE_ALIGNED(info->size))
+		return -EINVAL;
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return -ENOMEM;
+
+	map->vaddr = info->vaddr;
+	map->size = info->size;
+	map->npages = info->size >> PAGE_SHIFT;
+
+	map->pages = kvcalloc(map->npages, sizeof(*map->pages), GFP_KERNEL);
+	if (!map->pages) {
+		ret = -ENOMEM;
+		goto fail_pages;
+	}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+	pinned = pin_user_pages_fast(info->vaddr, map->npages, FOLL_WRITE | FOLL_LONGTERM, map->pages);
+#else
+	pinned = get_user_pages_fast(info->vaddr, map->npages, FOLL_WRITE, map->pages);
+#endif
+	if (pinned != map->npages) {
+		if (pinned > 0) {
+			map->npages = pinned;
+			mqnic_file_unpin(map);
+		}
+		ret = pinned < 0 ? pinned : -EFAULT;
+		goto fail_pin;
+	}
+
+	ret = sg_alloc_table_from_pages(&map->sgt, map->pages, map->npages, 0,
+			info->size, GFP_KERNEL);
+	if (ret)
+		goto fail_sgt;
+
+	nents = dma_map_sg(mqnic->dev, map->sgt.sgl, map->sgt.orig_nents, DMA_BIDIRECTIONAL);
+	if (nents <= 0) {
+		ret = -ENOMEM;
+		goto fail_map;
+	}
+
+	// rings and buffers are addressed from a single base
+	if (nents != 1) {
+		dev_err(mqnic->dev, "%s: buffer at 0x%llx is not IOVA-contiguous (%d segments)",
+				__func__, info->vaddr, nents);
+		dma_unmap_sg(mqnic->dev, map->sgt.sgl, map->sgt.orig_nents, DMA_BIDIRECTIONAL);
+		ret = -EINVAL;
+		goto fail_map;
+	}
+
+	map->iova = sg_dma_address(map->sgt.sgl);
+	info->iova = map->iova;
+
+	list_add_tail(&map->list, &fp->dma_maps);
+
+	return 0;
+
+fail_map:
+	sg_free_table(&map->sgt);
+fail_sgt:
+	mqnic_file_unpin(map);
+fail_pin:
+	kvfree(map->pages);
+fail_pages:
+	kfree(map);
+	return ret;
+}
+
+#define MQNIC_REG_WRITE_CHUNK 64
+
+static int mqnic_file_reg_write(struct mqnic_dev *mqnic, struct mqnic_ioctl_reg_write *info)
+{
+	const u32 __user *src = u64_to_user_ptr(info->data);
+	u8 __iomem *base;
+	resource_size_t size;
+	u32 buf[MQNIC_REG_WRITE_CHUNK];
+	u32 done = 0;
+	u32 n;
+
+	switch (info->index) {
+	case 0:
+		base = mqnic->hw_addr;
+		size = mqnic->hw_regs_size;
+		break;
+	case 1:
+		base = mqnic->app_hw_addr_wc ?: mqnic->app_hw_addr;
+		size = mqnic->app_hw_regs_size;
+		break;
+	case 2:
+		base = mqnic->ram_hw_addr_wc ?: mqnic->ram_hw_addr;
+		size = mqnic->ram_hw_regs_size;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!base || (info->offset & 3) || info->offset > size ||
+			(u64)info->count * 4 > size - info->offset)
+		return -EINVAL;
+
+	// copy the image in chunks and stream it out as back-to-back posted writes
+	while (done < info->count) {
+		n = min_t(u32, info->count - done, MQNIC_REG_WRITE_CHUNK);
+
+		if (copy_from_user(buf, src + done, n * 4))
+			return -EFAULT;
+
+		__iowrite32_copy(base + info->offset + done * 4, buf, n);
+
+		done += n;
+		cond_resched();
+	}
+
+	// drain write-combining buffers before returning to the caller
+	wmb();
+
+	return 0;
+}
+
+static bool mqnic_file_owns_queue(struct mqnic_file *fp, struct mqnic_if *interface,
+		u32 type, u32 index)
+{
+	struct mqnic_file_queue *q;
+
+	list_for_each_entry(q, &fp->queues, list)
+		if (q->interface == interface && q->type == type && q->index == index)
+			return true;
+
+	return false;
+}
+
+static int mqnic_file_add_capture_rule(struct mqnic_file *fp, struct mqnic_ioctl_capture_rule *info)
+{
+	struct mqnic_dev *mqnic = fp->mdev;
+	struct mqnic_capture_rule rule = {0};
+	struct mqnic_if *interface;
+	struct mqnic_priv *priv;
+	int ret;
+
+	if (info->if_index >= mqnic->if_count || !mqnic->interface[info->if_index])
+		return -EINVAL;
+
+	interface = mqnic->interface[info->if_index];
+
+	rule.owner = fp;
+	rule.rxq = info->queue;
+	rule.port_mask = info->port_mask;
+	rule.snaplen = info->snaplen;
+	rule.offset = info->offset;
+	memcpy(rule.match, info->match, sizeof(rule.match));
+	memcpy(rule.mask, info->mask, sizeof(rule.mask));
+
+	if (info->flags & MQNIC_CAPTURE_FLAG_CHANNEL) {
+		list_for_each_entry(priv, &interface->ndev_list, ndev_list) {
+			if (priv->port->index == info->port) {
+				rule.priv = priv;
+				break;
+			}
+		}
+
+		if (!rule.priv)
+			return -EINVAL;
+	}
+
+	// held so the queue cannot be freed before the rule is in
+	mutex_lock(&fp->lock);
+
+	if (!rule.priv && !mqnic_file_owns_queue(fp, interface, MQNIC_QUEUE_TYPE_RXQ, info->queue))
+		ret = -EPERM;
+	else
+		ret = mqnic_capture_add_rule(interface, &rule);
+
+	mutex_unlock(&fp->lock);
+
+	if (ret < 0)
+		return ret;
+
+	info->index = ret;
+
+	return 0;
+}
 
 static int mqnic_open(struct inode *inode, struct file *file)
 {
-	// struct miscdevice *miscdev = file->private_data;
-	// struct mqnic_dev *mqnic = container_of(miscdev, struct mqnic_dev, misc_dev);
+	struct miscdevice *miscdev = file->private_data;
+	struct mqnic_dev *mqnic = container_of(miscdev, struct mqnic_dev, misc_dev);
+	struct mqnic_file *fp;
+
+	fp = kzalloc(sizeof(*fp), GFP_KERNEL);
+	if (!fp)
+		return -ENOMEM;
+
+	fp->mdev = mqnic;
+	mutex_init(&fp->lock);
+	INIT_LIST_HEAD(&fp->queues);
+	INIT_LIST_HEAD(&fp->dma_maps);
+
+	file->private_data = fp;
 
 	return 0;
 }
 
 static int mqnic_release(struct inode *inode, struct file *file)
 {
-	// struct miscdevice *miscdev = file->private_data;
-	// struct mqnic_dev *mqnic = container_of(miscdev, struct mqnic_dev, misc_dev);
+	struct mqnic_file *fp = file->private_data;
+	struct mqnic_file_queue *q, *q_tmp;
+	struct mqnic_file_dma_map *map, *map_tmp;
+	int k;
+
+	// capture rules on netdev channels; rules on the file's own queues
+	// go with the queues
+	for (k = 0; k < fp->mdev->if_count; k++)
+		if (fp->mdev->interface[k])
+			mqnic_capture_del_owner(fp->mdev->interface[k], fp);
+
+	// queues first, so nothing is still writing to the pinned pages
+	list_for_each_entry_safe(q, q_tmp, &fp->queues, list)
+		mqnic_file_free_queue(q);
+
+	list_for_each_entry_safe(map, map_tmp, &fp->dma_maps, list)
+		mqnic_file_dma_unmap(fp->mdev, map);
+
+	mutex_destroy(&fp->lock);
+	kfree(fp);
 
 	return 0;
 }
 
 static int mqnic_mmap(struct file *file, struct vm_area_struct *vma)
 {
-	struct miscdevice *miscdev = file->private_data;
-	struct mqnic_dev *mqnic = container_of(miscdev, struct mqnic_dev, misc_dev);
+	struct mqnic_file *fp = file->private_data;
+	struct mqnic_dev *mqnic = fp->mdev;
+	struct mqnic_if *interface;
 	int index;
 	u64 pgoff, req_len, req_start;
+	pgprot_t prot;
+	bool wc;
 
 	index = vma->vm_pgoff >> (40 - PAGE_SHIFT);
 	req_len = vma->vm_end - vma->vm_start;
 	pgoff = vma->vm_pgoff & ((1U << (40 - PAGE_SHIFT)) - 1);
+	wc = pgoff & (MQNIC_REGION_OFFSET_WC >> PAGE_SHIFT);
+	pgoff &= ~(MQNIC_REGION_OFFSET_WC >> PAGE_SHIFT);
 	req_start = pgoff << PAGE_SHIFT;
 
+	prot = wc ? pgprot_writecombine(vma->vm_page_prot) : pgprot_noncached(vma->vm_page_prot);
+
 	if (vma->vm_end < vma->vm_start)
 		return -EINVAL;
 
@@ -44,27 +369,63 @@ static int mqnic_mmap(struct file *file, struct vm_area_struct *vma)
 
 	switch (index) {
 	case 0:
-		if (req_start + req_len > mqnic->hw_regs_size)
+		if (req_start + req_len > mqnic->hw_regs_size || wc)
 			return -EINVAL;
 
 		return io_remap_pfn_range(vma, vma->vm_start,
 				(mqnic->hw_regs_phys >> PAGE_SHIFT) + pgoff,
-				req_len, pgprot_noncached(vma->vm_page_prot));
+				req_len, prot);
 	case 1:
-		if (req_start + req_len > mqnic->app_hw_regs_size)
+		if (req_start + req_len > mqnic->app_hw_regs_size || (wc && !mqnic->app_hw_addr_wc))
 			return -EINVAL;
 
 		return io_remap_pfn_range(vma, vma->vm_start,
 				(mqnic->app_hw_regs_phys >> PAGE_SHIFT) + pgoff,
-				req_len, pgprot_noncached(vma->vm_page_prot));
+				req_len, prot);
 	case 2:
-		if (req_start + req_len > mqnic->ram_hw_regs_size)
+		if (req_start + req_len > mqnic->ram_hw_regs_size || (wc && !mqnic->ram_hw_addr_wc))
 			return -EINVAL;
 
 		return io_remap_pfn_range(vma, vma->vm_start,
 				(mqnic->ram_hw_regs_phys >> PAGE_SHIFT) + pgoff,
-				req_len, pgprot_noncached(vma->vm_page_prot));
+				req_len, prot);
 	default:
+		if (index == 3 + mqnic->if_count && mqnic->stats_dma_buf) {
+			// written by the NIC only, like the pointer shadows
+			if (req_start + req_len > mqnic->stats_dma_size || wc ||
+					(vma->vm_flags & VM_WRITE))
+				return -EINVAL;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+			vm_flags_clear(vma, VM_MAYWRITE);
+#else
+			vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+			vma->vm_pgoff = pgoff;
+
+			return dma_mmap_coherent(mqnic->dev, vma, mqnic->stats_dma_buf,
+					mqnic->stats_dma_addr, mqnic->stats_dma_size);
+		}
+
+		if (index >= 3 && index < 3 + mqnic->if_count && mqnic->interface[index - 3]) {
+			interface = mqnic->interface[index - 3];
+
+			// pointer shadows are written by the NIC only
+			if (req_start + req_len > interface->ptr_shadow_size || wc ||
+					(vma->vm_flags & VM_WRITE))
+				return -EINVAL;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+			vm_flags_clear(vma, VM_MAYWRITE);
+#else
+			vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+			vma->vm_pgoff = pgoff;
+
+			return dma_mmap_coherent(interface->dev, vma, interface->ptr_shadow,
+					interface->ptr_shadow_dma_addr, interface->ptr_shadow_size);
+		}
+
 		dev_err(mqnic->dev, "%s: Tried to map an unknown region at page offset 0x%lx",
 				__func__, vma->vm_pgoff);
 		return -EINVAL;
@@ -75,9 +436,10 @@ static int mqnic_mmap(struct file *file, struct vm_area_struct *vma)
 
 static long mqnic_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
-	struct miscdevice *miscdev = file->private_data;
-	struct mqnic_dev *mqnic = container_of(miscdev, struct mqnic_dev, misc_dev);
+	struct mqnic_file *fp = file->private_data;
+	struct mqnic_dev *mqnic = fp->mdev;
 	size_t minsz;
+	int ret;
 
 	if (cmd == MQNIC_IOCTL_GET_API_VERSION) {
 		// Get API version
@@ -102,7 +464,7 @@ static long mqnic_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		info.build_date = mqnic->build_date;
 		info.git_hash = mqnic->git_hash;
 		info.rel_info = mqnic->rel_info;
-		info.num_regions = 3;
+		info.num_regions = 4 + mqnic->if_count;
 		info.num_irqs = 0;
 
 		return copy_to_user((void __user *)arg, &info, minsz) ? -EFAULT : 0;
@@ -142,6 +504,8 @@ static long mqnic_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			info.child = 0;
 			info.size = mqnic->app_hw_regs_size;
 			info.offset = ((u64)info.index) << 40;
+			if (mqnic->app_hw_addr_wc)
+				info.flags |= MQNIC_REGION_FLAG_WC;
 			strscpy(info.name, "app", sizeof(info.name));
 			break;
 		case 2:
@@ -150,14 +514,206 @@ static long mqnic_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			info.child = 0;
 			info.size = mqnic->ram_hw_regs_size;
 			info.offset = ((u64)info.index) << 40;
+			if (mqnic->ram_hw_addr_wc)
+				info.flags |= MQNIC_REGION_FLAG_WC;
 			strscpy(info.name, "ram", sizeof(info.name));
 			break;
 		default:
+			if (info.index == 3 + mqnic->if_count) {
+				// empty when statistics write-back is off
+				info.type = MQNIC_REGION_TYPE_STATS;
+				info.next = 0;
+				info.child = 0;
+				info.size = mqnic->stats_dma_size;
+				strscpy(info.name, "stats", sizeof(info.name));
+				break;
+			}
+
+			if (info.index < 3 || info.index > 3 + mqnic->if_count)
+				return -EINVAL;
+
+			// empty when the interface has no pointer write-back
+			info.type = MQNIC_REGION_TYPE_PTR_SHADOW;
+			info.next = info.index + 1;
+			info.child = 0;
+			if (mqnic->interface[info.index - 3])
+				info.size = mqnic->interface[info.index - 3]->ptr_shadow_size;
+			snprintf(info.name, sizeof(info.name), "if%d_ptr_shadow", info.index - 3);
+			break;
+		}
+
+		return copy_to_user((void __user *)arg, &info, minsz) ? -EFAULT : 0;
+
+	} else if (cmd == MQNIC_IOCTL_ALLOC_QUEUE) {
+		// Reserve a hardware queue
+		struct mqnic_ioctl_queue info;
+		struct mqnic_file_queue *q;
+		struct mqnic_res *res;
+
+		minsz = offsetofend(struct mqnic_ioctl_queue, index);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz || info.if_index >= mqnic->if_count ||
+				!mqnic->interface[info.if_index])
 			return -EINVAL;
+
+		res = mqnic_file_queue_res(mqnic->interface[info.if_index], info.type);
+		if (!res)
+			return -EINVAL;
+
+		q = kzalloc(sizeof(*q), GFP_KERNEL);
+		if (!q)
+			return -ENOMEM;
+
+		q->interface = mqnic->interface[info.if_index];
+		q->type = info.type;
+		q->index = mqnic_res_alloc(res);
+		if (q->index < 0) {
+			kfree(q);
+			return -ENOSPC;
 		}
 
+		mutex_lock(&fp->lock);
+		list_add_tail(&q->list, &fp->queues);
+		mutex_unlock(&fp->lock);
+
+		info.flags = 0;
+		info.index = q->index;
+
 		return copy_to_user((void __user *)arg, &info, minsz) ? -EFAULT : 0;
 
+	} else if (cmd == MQNIC_IOCTL_FREE_QUEUE) {
+		// Release a hardware queue
+		struct mqnic_ioctl_queue info;
+		struct mqnic_file_queue *q;
+
+		minsz = offsetofend(struct mqnic_ioctl_queue, index);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz)
+			return -EINVAL;
+
+		ret = -ENOENT;
+
+		mutex_lock(&fp->lock);
+		list_for_each_entry(q, &fp->queues, list) {
+			if (q->interface->index == info.if_index && q->type == info.type &&
+					q->index == info.index) {
+				mqnic_file_free_queue(q);
+				ret = 0;
+				break;
+			}
+		}
+		mutex_unlock(&fp->lock);
+
+		return ret;
+
+	} else if (cmd == MQNIC_IOCTL_DMA_MAP) {
+		// Map a userspace buffer for DMA
+		struct mqnic_ioctl_dma_map info;
+
+		minsz = offsetofend(struct mqnic_ioctl_dma_map, iova);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz)
+			return -EINVAL;
+
+		mutex_lock(&fp->lock);
+		ret = mqnic_file_dma_map(fp, &info);
+		mutex_unlock(&fp->lock);
+
+		if (ret)
+			return ret;
+
+		info.flags = 0;
+
+		return copy_to_user((void __user *)arg, &info, minsz) ? -EFAULT : 0;
+
+	} else if (cmd == MQNIC_IOCTL_DMA_UNMAP) {
+		// Unmap a buffer by IOVA
+		struct mqnic_ioctl_dma_map info;
+		struct mqnic_file_dma_map *map;
+
+		minsz = offsetofend(struct mqnic_ioctl_dma_map, iova);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz)
+			return -EINVAL;
+
+		ret = -ENOENT;
+
+		mutex_lock(&fp->lock);
+		list_for_each_entry(map, &fp->dma_maps, list) {
+			if (map->iova == info.iova) {
+				mqnic_file_dma_unmap(mqnic, map);
+				ret = 0;
+				break;
+			}
+		}
+		mutex_unlock(&fp->lock);
+
+		return ret;
+
+	} else if (cmd == MQNIC_IOCTL_REG_WRITE) {
+		// Bulk write a register or table image
+		struct mqnic_ioctl_reg_write info;
+
+		minsz = offsetofend(struct mqnic_ioctl_reg_write, data);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz)
+			return -EINVAL;
+
+		return mqnic_file_reg_write(mqnic, &info);
+
+	} else if (cmd == MQNIC_IOCTL_ADD_CAPTURE_RULE) {
+		// Mirror matching frames to a capture queue
+		struct mqnic_ioctl_capture_rule info;
+
+		minsz = offsetofend(struct mqnic_ioctl_capture_rule, mask);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz || info.flags & ~MQNIC_CAPTURE_FLAG_CHANNEL)
+			return -EINVAL;
+
+		ret = mqnic_file_add_capture_rule(fp, &info);
+		if (ret)
+			return ret;
+
+		if (copy_to_user((void __user *)arg, &info, minsz)) {
+			mqnic_capture_del_rule(mqnic->interface[info.if_index], fp, info.index);
+			return -EFAULT;
+		}
+
+		return 0;
+
+	} else if (cmd == MQNIC_IOCTL_DEL_CAPTURE_RULE) {
+		// Remove a capture rule by index
+		struct mqnic_ioctl_capture_rule info;
+
+		minsz = offsetofend(struct mqnic_ioctl_capture_rule, index);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz || info.if_index >= mqnic->if_count ||
+				!mqnic->interface[info.if_index])
+			return -EINVAL;
+
+		return mqnic_capture_del_rule(mqnic->interface[info.if_index], fp, info.index);
+
 	}
 
 	return -EINVAL;
@@ -5,6 +5,7 @@
 
 #include "mqnic.h"
 
+#include <linux/math64.h>
 #include <linux/version.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 1, 0)
@@ -86,10 +87,532 @@ static int mqnic_devlink_info_get(struct devlink *devlink,
 }
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+/*
+ * devlink rate tree onto per-queue DWRR weights.
+ *
+ * Leaves are the netdevs of the PF and the VFs, nodes are created by the
+ * user to group them, e.g. one node per tenant.  A leaf's share of the
+ * scheduler is the product of weight / sum of sibling weights from the leaf
+ * up to the root, unset weights counting as 1.  The scheduler arbitrates
+ * between queues rather than functions, so that share is split evenly
+ * between the leaf's TX queues, and the per-queue shares of all leaves are
+ * scaled so the largest maps to the maximum hardware weight.
+ */
+
+#define MQNIC_RATE_TX_WEIGHT_MAX 0xffff
+
+static u32 mqnic_rate_weight(struct mqnic_rate *rate)
+{
+	return rate->tx_weight ? rate->tx_weight : 1;
+}
+
+static bool mqnic_rate_is_leaf(struct mqnic_rate *rate)
+{
+	return rate->priv || rate->vf;
+}
+
+static u64 mqnic_rate_share(struct mqnic_dev *mdev, struct mqnic_rate *rate)
+{
+	struct mqnic_rate *r;
+	u64 share = 1ULL << 32;
+	u32 sum;
+
+	for (; rate; rate = rate->parent) {
+		sum = 0;
+		list_for_each_entry(r, &mdev->rate_list, list)
+			if (r->parent == rate->parent)
+				sum += mqnic_rate_weight(r);
+
+		share = mul_u64_u32_div(share, mqnic_rate_weight(rate), sum);
+	}
+
+	return share;
+}
+
+// caller holds mdev->state_lock
+static void mqnic_rate_apply(struct mqnic_dev *mdev, struct mqnic_rate *rate)
+{
+	struct mqnic_priv *priv = rate->priv;
+	struct mqnic_vf *vf = rate->vf;
+	int k;
+
+	if (priv) {
+		// programmed on port start otherwise
+		if (!priv->port_up || !priv->interface->sched_dwrr)
+			return;
+
+		// slots being replaced get their weight from mqnic_start_tx_queue
+		for (k = 0; k < priv->txq_count; k++)
+			if (priv->txq_table[k])
+				mqnic_sched_port_queue_set_weight(priv->sched_port,
+						priv->txq_table[k]->index, rate->queue_weight);
+	} else if (vf && vf->sched_port && mdev->interface[0]->sched_dwrr) {
+		for (k = 0; k < vf->txq.count; k++)
+			mqnic_sched_port_queue_set_weight(vf->sched_port,
+					vf->txq.base + k, rate->queue_weight);
+	}
+}
+
+// caller holds the devlink instance lock
+void mqnic_devl_rate_update(struct mqnic_dev *mdev)
+{
+	struct mqnic_rate *rate;
+	unsigned int count;
+	u64 max = 0;
+
+	// the PF weights VF queues, the VF leaves them alone
+	if (mqnic_sriov_is_vf(mdev))
+		return;
+
+	list_for_each_entry(rate, &mdev->rate_list, list) {
+		if (!mqnic_rate_is_leaf(rate))
+			continue;
+
+		count = rate->priv ? rate->priv->txq_count : rate->vf->txq.count;
+
+		rate->queue_share = mqnic_rate_share(mdev, rate) / max(count, 1U);
+		max = max(max, rate->queue_share);
+	}
+
+	if (!max)
+		return;
+
+	mutex_lock(&mdev->state_lock);
+
+	list_for_each_entry(rate, &mdev->rate_list, list) {
+		if (!mqnic_rate_is_leaf(rate))
+			continue;
+
+		rate->queue_weight = clamp_t(u64, DIV64_U64_ROUND_CLOSEST(rate->queue_share *
+				MQNIC_SCHED_RR_WEIGHT_MAX, max), 1, MQNIC_SCHED_RR_WEIGHT_MAX);
+
+		mqnic_rate_apply(mdev, rate);
+	}
+
+	mutex_unlock(&mdev->state_lock);
+}
+
+void mqnic_devlink_rate_work(struct work_struct *work)
+{
+	struct mqnic_dev *mdev = container_of(work, struct mqnic_dev, rate_work);
+	struct devlink *devlink = priv_to_devlink(mdev);
+
+	devl_lock(devlink);
+	mqnic_devl_rate_update(mdev);
+	devl_unlock(devlink);
+}
+
+// the devlink instance lock ranks above RTNL, so callers holding RTNL
+// leave the update to a work item
+void mqnic_devlink_rate_update(struct mqnic_dev *mdev)
+{
+	schedule_work(&mdev->rate_work);
+}
+
+static int mqnic_devlink_check_tx_weight(struct mqnic_dev *mdev, u32 tx_weight,
+		struct netlink_ext_ack *extack)
+{
+	// a VF does not own the weights of its queues, the PF does
+	if (mqnic_sriov_is_vf(mdev)) {
+		NL_SET_ERR_MSG_MOD(extack, "TX weights are set through the PF");
+		return -EOPNOTSUPP;
+	}
+
+	if (!mdev->interface[0] || !mdev->interface[0]->sched_dwrr) {
+		NL_SET_ERR_MSG_MOD(extack, "Scheduler does not support queue weights");
+		return -EOPNOTSUPP;
+	}
+
+	if (tx_weight > MQNIC_RATE_TX_WEIGHT_MAX) {
+		NL_SET_ERR_MSG_MOD(extack, "TX weight out of range");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int mqnic_devlink_rate_tx_weight_set(struct devlink *devlink,
+		struct mqnic_rate *rate, u32 tx_weight, struct netlink_ext_ack *extack)
+{
+	struct mqnic_dev *mdev = devlink_priv(devlink);
+	int ret;
+
+	ret = mqnic_devlink_check_tx_weight(mdev, tx_weight, extack);
+	if (ret)
+		return ret;
+
+	rate->tx_weight = tx_weight;
+	mqnic_devl_rate_update(mdev);
+
+	return 0;
+}
+
+static int mqnic_devlink_rate_leaf_tx_max_set(struct devlink_rate *devlink_rate,
+		void *priv_data, u64 tx_max, struct netlink_ext_ack *extack)
+{
+	struct mqnic_rate *rate = priv_data;
+	struct mqnic_priv *priv = rate->priv;
+
+	// VF channels are driven by the VF
+	if (!priv || !priv->interface->sched_rate_limit) {
+		NL_SET_ERR_MSG_MOD(extack, "TX rate limiting is not supported");
+		return -EOPNOTSUPP;
+	}
+
+	mutex_lock(&priv->mdev->state_lock);
+
+	priv->tx_max_rate = tx_max;
+
+	if (priv->port_up)
+		mqnic_update_tx_rates(priv->ndev);
+
+	mutex_unlock(&priv->mdev->state_lock);
+
+	return 0;
+}
+
+static int mqnic_devlink_rate_leaf_tx_weight_set(struct devlink_rate *devlink_rate,
+		void *priv_data, u32 tx_weight, struct netlink_ext_ack *extack)
+{
+	return mqnic_devlink_rate_tx_weight_set(devlink_rate->devlink, priv_data,
+			tx_weight, extack);
+}
+
+static int mqnic_devlink_rate_node_tx_weight_set(struct devlink_rate *devlink_rate,
+		void *priv_data, u32 tx_weight, struct netlink_ext_ack *extack)
+{
+	return mqnic_devlink_rate_tx_weight_set(devlink_rate->devlink, priv_data,
+			tx_weight, extack);
+}
+
+static int mqnic_devlink_rate_node_new(struct devlink_rate *rate_node, void **priv_data,
+		struct netlink_ext_ack *extack)
+{
+	struct mqnic_dev *mdev = devlink_priv(rate_node->devlink);
+	struct mqnic_rate *rate;
+	int ret;
+
+	ret = mqnic_devlink_check_tx_weight(mdev, 0, extack);
+	if (ret)
+		return ret;
+
+	rate = kzalloc(sizeof(*rate), GFP_KERNEL);
+	if (!rate)
+		return -ENOMEM;
+
+	list_add_tail(&rate->list, &mdev->rate_list);
+	*priv_data = rate;
+
+	mqnic_devl_rate_update(mdev);
+
+	return 0;
+}
+
+// devlink only deletes nodes with no children
+static int mqnic_devlink_rate_node_del(struct devlink_rate *rate_node, void *priv_data,
+		struct netlink_ext_ack *extack)
+{
+	struct mqnic_dev *mdev = devlink_priv(rate_node->devlink);
+	struct mqnic_rate *rate = priv_data;
+
+	list_del(&rate->list);
+	kfree(rate);
+
+	mqnic_devl_rate_update(mdev);
+
+	return 0;
+}
+
+static int mqnic_devlink_rate_parent_set(struct devlink_rate *child,
+		struct devlink_rate *parent, void *priv_child, void *priv_parent,
+		struct netlink_ext_ack *extack)
+{
+	struct mqnic_rate *rate = priv_child;
+
+	rate->parent = parent ? priv_parent : NULL;
+	mqnic_devl_rate_update(devlink_priv(child->devlink));
+
+	return 0;
+}
+#endif
+
+/*
+ * Datapath tuning through devlink params, without a module reload.
+ *
+ * The values are device-wide defaults for every port, ring sizes staying
+ * per port with ethtool -G.  They take effect when a port next starts
+ * (ip link set down/up, or any ring reconfiguration), except the
+ * copybreaks, which are read per packet and apply at once to all ports,
+ * overriding any ethtool tunable set before.  EQs are shared by the ports
+ * of an interface, so a new EQ size lands once all of them have been down.
+ *   event_eq_size       EQ entries, default num_eq_entries
+ *   tx_desc_block_size  TX descriptors per block, 0 for automatic; never
+ *                       less than the descriptor words in use need
+ *   rx_buf_size         largest RX buffer, frames over it are scattered
+ *                       across a descriptor block; 0 for one page
+ *   rx_page_split       let two small frames share an RX page
+ *   rx_refill_batch     free RX descriptors that trigger a refill
+ *   rx_copybreak        RX frames copied into a linear skb, in bytes
+ *   tx_copybreak        TX frames copied into a bounce slot, in bytes
+ *   rss_rebalance_interval  ms between passes of the RSS rebalancer, see
+ *                       mqnic_rss.c; 0 to leave the indirection tables be
+ */
+
+static void mqnic_devlink_params_init(struct mqnic_dev *mdev)
+{
+	mdev->eq_size = mqnic_num_eq_entries;
+	mdev->tx_desc_block_size = 0;
+	mdev->rx_buf_size = 0;
+	mdev->rx_page_split = true;
+	mdev->rx_refill_batch = MQNIC_RX_REFILL_BATCH;
+	mdev->rx_copybreak = MQNIC_RX_COPYBREAK_DEFAULT;
+	mdev->tx_copybreak = MQNIC_TX_COPYBREAK_DEFAULT;
+	mdev->rss_rebalance_interval = 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+enum mqnic_devlink_param_id {
+	MQNIC_DEVLINK_PARAM_ID_BASE = DEVLINK_PARAM_GENERIC_ID_MAX,
+	MQNIC_DEVLINK_PARAM_ID_TX_DESC_BLOCK_SIZE,
+	MQNIC_DEVLINK_PARAM_ID_RX_BUF_SIZE,
+	MQNIC_DEVLINK_PARAM_ID_RX_PAGE_SPLIT,
+	MQNIC_DEVLINK_PARAM_ID_RX_REFILL_BATCH,
+	MQNIC_DEVLINK_PARAM_ID_RX_COPYBREAK,
+	MQNIC_DEVLINK_PARAM_ID_TX_COPYBREAK,
+	MQNIC_DEVLINK_PARAM_ID_RSS_REBALANCE_INTERVAL,
+};
+
+static void mqnic_devlink_set_copybreak(struct mqnic_dev *mdev)
+{
+	struct mqnic_priv *priv;
+	int k;
+
+	for (k = 0; k < mdev->if_count; k++) {
+		if (!mdev->interface[k])
+			continue;
+
+		list_for_each_entry(priv, &mdev->interface[k]->ndev_list, ndev_list) {
+			WRITE_ONCE(priv->rx_copybreak, mdev->rx_copybreak);
+			WRITE_ONCE(priv->tx_copybreak, mdev->tx_copybreak);
+		}
+	}
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 17, 0)
+static int mqnic_devlink_param_get(struct devlink *devlink, u32 id,
+		struct devlink_param_gset_ctx *ctx, struct netlink_ext_ack *extack)
+#else
+static int mqnic_devlink_param_get(struct devlink *devlink, u32 id,
+		struct devlink_param_gset_ctx *ctx)
+#endif
+{
+	struct mqnic_dev *mdev = devlink_priv(devlink);
+
+	mutex_lock(&mdev->state_lock);
+
+	switch (id) {
+	case DEVLINK_PARAM_GENERIC_ID_EVENT_EQ_SIZE:
+		ctx->val.vu32 = mdev->eq_size;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_TX_DESC_BLOCK_SIZE:
+		ctx->val.vu32 = mdev->tx_desc_block_size;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_BUF_SIZE:
+		ctx->val.vu32 = mdev->rx_buf_size;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_PAGE_SPLIT:
+		ctx->val.vbool = mdev->rx_page_split;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_REFILL_BATCH:
+		ctx->val.vu32 = mdev->rx_refill_batch;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_COPYBREAK:
+		ctx->val.vu32 = mdev->rx_copybreak;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_TX_COPYBREAK:
+		ctx->val.vu32 = mdev->tx_copybreak;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RSS_REBALANCE_INTERVAL:
+		ctx->val.vu32 = mdev->rss_rebalance_interval;
+		break;
+	}
+
+	mutex_unlock(&mdev->state_lock);
+
+	return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+static int mqnic_devlink_param_set(struct devlink *devlink, u32 id,
+		struct devlink_param_gset_ctx *ctx, struct netlink_ext_ack *extack)
+#else
+static int mqnic_devlink_param_set(struct devlink *devlink, u32 id,
+		struct devlink_param_gset_ctx *ctx)
+#endif
+{
+	struct mqnic_dev *mdev = devlink_priv(devlink);
+
+	mutex_lock(&mdev->state_lock);
+
+	switch (id) {
+	case DEVLINK_PARAM_GENERIC_ID_EVENT_EQ_SIZE:
+		mdev->eq_size = ctx->val.vu32;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_TX_DESC_BLOCK_SIZE:
+		mdev->tx_desc_block_size = ctx->val.vu32;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_BUF_SIZE:
+		mdev->rx_buf_size = ctx->val.vu32;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_PAGE_SPLIT:
+		mdev->rx_page_split = ctx->val.vbool;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_REFILL_BATCH:
+		mdev->rx_refill_batch = ctx->val.vu32;
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_COPYBREAK:
+		mdev->rx_copybreak = ctx->val.vu32;
+		mqnic_devlink_set_copybreak(mdev);
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_TX_COPYBREAK:
+		mdev->tx_copybreak = ctx->val.vu32;
+		mqnic_devlink_set_copybreak(mdev);
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RSS_REBALANCE_INTERVAL:
+		WRITE_ONCE(mdev->rss_rebalance_interval, ctx->val.vu32);
+		mqnic_rss_set_interval(mdev);
+		break;
+	}
+
+	mutex_unlock(&mdev->state_lock);
+
+	return 0;
+}
+
+static int mqnic_devlink_param_validate(struct devlink *devlink, u32 id,
+		union devlink_param_value val, struct netlink_ext_ack *extack)
+{
+	switch (id) {
+	case DEVLINK_PARAM_GENERIC_ID_EVENT_EQ_SIZE:
+		if (val.vu32 < MQNIC_MIN_EQ_SZ || val.vu32 > MQNIC_MAX_EQ_SZ) {
+			NL_SET_ERR_MSG_MOD(extack, "EQ size out of range");
+			return -EINVAL;
+		}
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_TX_DESC_BLOCK_SIZE:
+		if (val.vu32 && (!is_power_of_2(val.vu32) || val.vu32 > MQNIC_MAX_FRAGS)) {
+			NL_SET_ERR_MSG_MOD(extack, "Block size must be 0 or a power of two up to " __stringify(MQNIC_MAX_FRAGS));
+			return -EINVAL;
+		}
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_BUF_SIZE:
+		if (val.vu32 && (!is_power_of_2(val.vu32) || val.vu32 < PAGE_SIZE ||
+				val.vu32 > MQNIC_MAX_RX_BUF_SIZE)) {
+			NL_SET_ERR_MSG_MOD(extack, "Buffer size must be 0 or a power of two from the page size up");
+			return -EINVAL;
+		}
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_REFILL_BATCH:
+		if (!val.vu32 || val.vu32 > MQNIC_MIN_RX_RING_SZ / 2) {
+			NL_SET_ERR_MSG_MOD(extack, "Refill batch out of range");
+			return -EINVAL;
+		}
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RX_COPYBREAK:
+		if (val.vu32 > MQNIC_RX_COPYBREAK_MAX) {
+			NL_SET_ERR_MSG_MOD(extack, "RX copybreak out of range");
+			return -EINVAL;
+		}
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_TX_COPYBREAK:
+		if (val.vu32 > MQNIC_TX_COPYBREAK_MAX) {
+			NL_SET_ERR_MSG_MOD(extack, "TX copybreak out of range");
+			return -EINVAL;
+		}
+		break;
+	case MQNIC_DEVLINK_PARAM_ID_RSS_REBALANCE_INTERVAL:
+		if (val.vu32 && (val.vu32 < MQNIC_RSS_MIN_INTERVAL || val.vu32 > MQNIC_RSS_MAX_INTERVAL)) {
+			NL_SET_ERR_MSG_MOD(extack, "Interval must be 0 or from "
+					__stringify(MQNIC_RSS_MIN_INTERVAL) " to "
+					__stringify(MQNIC_RSS_MAX_INTERVAL) " ms");
+			return -EINVAL;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+#define MQNIC_DEVLINK_PARAM(_id, _name, _type) \
+	DEVLINK_PARAM_DRIVER(MQNIC_DEVLINK_PARAM_ID_##_id, _name, DEVLINK_PARAM_TYPE_##_type, \
+			BIT(DEVLINK_PARAM_CMODE_RUNTIME), mqnic_devlink_param_get, \
+			mqnic_devlink_param_set, mqnic_devlink_param_validate)
+
+static const struct devlink_param mqnic_devlink_params[] = {
+	DEVLINK_PARAM_GENERIC(EVENT_EQ_SIZE, BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+			mqnic_devlink_param_get, mqnic_devlink_param_set,
+			mqnic_devlink_param_validate),
+	MQNIC_DEVLINK_PARAM(TX_DESC_BLOCK_SIZE, "tx_desc_block_size", U32),
+	MQNIC_DEVLINK_PARAM(RX_BUF_SIZE, "rx_buf_size", U32),
+	MQNIC_DEVLINK_PARAM(RX_PAGE_SPLIT, "rx_page_split", BOOL),
+	MQNIC_DEVLINK_PARAM(RX_REFILL_BATCH, "rx_refill_batch", U32),
+	MQNIC_DEVLINK_PARAM(RX_COPYBREAK, "rx_copybreak", U32),
+	MQNIC_DEVLINK_PARAM(TX_COPYBREAK, "tx_copybreak", U32),
+	MQNIC_DEVLINK_PARAM(RSS_REBALANCE_INTERVAL, "rss_rebalance_interval", U32),
+};
+
+int mqnic_devlink_params_register(struct mqnic_dev *mdev)
+{
+	int ret;
+
+	mqnic_devlink_params_init(mdev);
+
+	ret = devlink_params_register(priv_to_devlink(mdev), mqnic_devlink_params,
+			ARRAY_SIZE(mqnic_devlink_params));
+	if (ret)
+		return ret;
+
+	mdev->devlink_params = true;
+
+	return 0;
+}
+
+void mqnic_devlink_params_unregister(struct mqnic_dev *mdev)
+{
+	if (!mdev->devlink_params)
+		return;
+
+	devlink_params_unregister(priv_to_devlink(mdev), mqnic_devlink_params,
+			ARRAY_SIZE(mqnic_devlink_params));
+	mdev->devlink_params = false;
+}
+#else
+int mqnic_devlink_params_register(struct mqnic_dev *mdev)
+{
+	mqnic_devlink_params_init(mdev);
+
+	return 0;
+}
+
+void mqnic_devlink_params_unregister(struct mqnic_dev *mdev)
+{
+}
+#endif
+
 static const struct devlink_ops mqnic_devlink_ops = {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 1, 0)
 	.info_get = mqnic_devlink_info_get,
 #endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+	.rate_leaf_tx_max_set = mqnic_devlink_rate_leaf_tx_max_set,
+	.rate_leaf_tx_weight_set = mqnic_devlink_rate_leaf_tx_weight_set,
+	.rate_leaf_parent_set = mqnic_devlink_rate_parent_set,
+	.rate_node_tx_weight_set = mqnic_devlink_rate_node_tx_weight_set,
+	.rate_node_new = mqnic_devlink_rate_node_new,
+	.rate_node_del = mqnic_devlink_rate_node_del,
+	.rate_node_parent_set = mqnic_devlink_rate_parent_set,
+#endif
 };
 
 struct devlink *mqnic_devlink_alloc(struct device *dev)
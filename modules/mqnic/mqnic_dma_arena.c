@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#include <linux/genalloc.h>
+
+/*
+ * Interface-wide DMA arena for queue memory.
+ *
+ * Descriptor rings, CQs and EQs are carved out of coherent chunks of
+ * MQNIC_DMA_ARENA_CHUNK_SIZE bytes instead of each getting an allocation of
+ * its own, so the descriptor and completion traffic of every queue on the
+ * interface hits a handful of large, contiguous IOVA ranges rather than
+ * hundreds of scattered 4K mappings.  Chunks are grouped by NUMA node so
+ * queues keep their node placement.  Carved buffers are page aligned, which
+ * the queue base address registers require.
+ *
+ * Buffers larger than a chunk, or requested when a new chunk cannot be
+ * allocated, fall back on a dedicated coherent allocation.
+ */
+
+struct mqnic_dma_arena_pool {
+	struct list_head list;
+	int node;
+	struct gen_pool *pool;
+};
+
+void mqnic_dma_arena_init(struct mqnic_dma_arena *arena, struct device *dev)
+{
+	arena->dev = dev;
+	mutex_init(&arena->lock);
+	INIT_LIST_HEAD(&arena->pools);
+}
+
+static void mqnic_dma_arena_free_chunk(struct gen_pool *pool,
+		struct gen_pool_chunk *chunk, void *data)
+{
+	struct mqnic_dma_arena *arena = data;
+
+	dma_free_coherent(arena->dev, chunk->end_addr - chunk->start_addr + 1,
+			(void *)chunk->start_addr, chunk->phys_addr);
+}
+
+// every buffer must have been returned
+void mqnic_dma_arena_destroy(struct mqnic_dma_arena *arena)
+{
+	struct mqnic_dma_arena_pool *ap, *ap_safe;
+
+	list_for_each_entry_safe(ap, ap_safe, &arena->pools, list) {
+		list_del(&ap->list);
+		gen_pool_for_each_chunk(ap->pool, mqnic_dma_arena_free_chunk, arena);
+		gen_pool_destroy(ap->pool);
+		kfree(ap);
+	}
+}
+
+static struct mqnic_dma_arena_pool *mqnic_dma_arena_get_pool(struct mqnic_dma_arena *arena,
+		int node)
+{
+	struct mqnic_dma_arena_pool *ap;
+
+	list_for_each_entry(ap, &arena->pools, list)
+		if (ap->node == node)
+			return ap;
+
+	ap = kzalloc(sizeof(*ap), GFP_KERNEL);
+	if (!ap)
+		return NULL;
+
+	ap->pool = gen_pool_create(PAGE_SHIFT, node);
+	if (!ap->pool) {
+		kfree(ap);
+		return NULL;
+	}
+
+	ap->node = node;
+	list_add_tail(&ap->list, &arena->pools);
+
+	return ap;
+}
+
+static int mqnic_dma_arena_grow(struct mqnic_dma_arena *arena, struct mqnic_dma_arena_pool *ap)
+{
+	dma_addr_t dma_addr;
+	void *buf;
+	int ret;
+
+	buf = mqnic_dma_alloc_coherent_node(arena->dev, MQNIC_DMA_ARENA_CHUNK_SIZE,
+			&dma_addr, ap->node);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = gen_pool_add_virt(ap->pool, (unsigned long)buf, dma_addr,
+			MQNIC_DMA_ARENA_CHUNK_SIZE, ap->node);
+	if (ret) {
+		dma_free_coherent(arena->dev, MQNIC_DMA_ARENA_CHUNK_SIZE, buf, dma_addr);
+		return ret;
+	}
+
+	return 0;
+}
+
+void *mqnic_dma_arena_alloc(struct mqnic_dma_arena *arena, size_t size,
+		dma_addr_t *dma_handle, int node)
+{
+	struct mqnic_dma_arena_pool *ap;
+	void *buf = NULL;
+
+	size = PAGE_ALIGN(size);
+
+	if (size <= MQNIC_DMA_ARENA_CHUNK_SIZE) {
+		mutex_lock(&arena->lock);
+
+		ap = mqnic_dma_arena_get_pool(arena, node);
+		if (ap) {
+			buf = gen_pool_dma_alloc(ap->pool, size, dma_handle);
+			if (!buf && !mqnic_dma_arena_grow(arena, ap))
+				buf = gen_pool_dma_alloc(ap->pool, size, dma_handle);
+		}
+
+		mutex_unlock(&arena->lock);
+	}
+
+	if (buf) {
+		// match dma_alloc_coherent, carved space may be reused
+		memset(buf, 0, size);
+		return buf;
+	}
+
+	return mqnic_dma_alloc_coherent_node(arena->dev, size, dma_handle, node);
+}
+
+void mqnic_dma_arena_free(struct mqnic_dma_arena *arena, size_t size,
+		void *buf, dma_addr_t dma_handle)
+{
+	struct mqnic_dma_arena_pool *ap;
+
+	size = PAGE_ALIGN(size);
+
+	mutex_lock(&arena->lock);
+
+	list_for_each_entry(ap, &arena->pools, list) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 5, 0)
+		if (gen_pool_has_addr(ap->pool, (unsigned long)buf, size)) {
+#else
+		if (addr_in_gen_pool(ap->pool, (unsigned long)buf, size)) {
+#endif
+			gen_pool_free(ap->pool, (unsigned long)buf, size);
+			mutex_unlock(&arena->lock);
+			return;
+		}
+	}
+
+	mutex_unlock(&arena->lock);
+
+	// dedicated allocation
+	dma_free_coherent(arena->dev, size, buf, dma_handle);
+}
@@ -4,17 +4,52 @@
  */
 
 #include "mqnic.h"
+#include "mqnic_trace.h"
+
+static void mqnic_eq_poll(struct mqnic_eq *eq)
+{
+	if (mqnic_process_eq(eq, MQNIC_EQ_BUDGET) < MQNIC_EQ_BUDGET) {
+		WRITE_ONCE(eq->deferred, false);
+		mqnic_arm_eq(eq);
+		return;
+	}
+
+	// leave the EQ unarmed and finish in softirq context
+	WRITE_ONCE(eq->deferred, true);
+	tasklet_schedule(&eq->tasklet);
+}
 
 static int mqnic_eq_int(struct notifier_block *nb, unsigned long action, void *data)
 {
 	struct mqnic_eq *eq = container_of(nb, struct mqnic_eq, irq_nb);
 
-	mqnic_process_eq(eq);
-	mqnic_arm_eq(eq);
+	// the tasklet owns the EQ until it re-arms it; the IRQ may be shared
+	if (READ_ONCE(eq->deferred))
+		return NOTIFY_DONE;
+
+	WRITE_ONCE(eq->last_irq_ns, ktime_get_ns());
+
+	mqnic_eq_poll(eq);
 
 	return NOTIFY_DONE;
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+static void mqnic_eq_tasklet(struct tasklet_struct *t)
+{
+	struct mqnic_eq *eq = from_tasklet(eq, t, tasklet);
+#else
+static void mqnic_eq_tasklet(unsigned long data)
+{
+	struct mqnic_eq *eq = (struct mqnic_eq *)data;
+#endif
+
+	// CQ handlers expect to run with interrupts off
+	local_irq_disable();
+	mqnic_eq_poll(eq);
+	local_irq_enable();
+}
+
 struct mqnic_eq *mqnic_create_eq(struct mqnic_if *interface)
 {
 	struct mqnic_eq *eq;
@@ -30,15 +65,16 @@ struct mqnic_eq *mqnic_create_eq(struct mqnic_if *interface)
 	eq->enabled = 0;
 
 	eq->irq_nb.notifier_call = mqnic_eq_int;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	tasklet_setup(&eq->tasklet, mqnic_eq_tasklet);
+#else
+	tasklet_init(&eq->tasklet, mqnic_eq_tasklet, (unsigned long)eq);
+#endif
 
 	eq->hw_addr = NULL;
 
 	eq->cons_ptr = 0;
 
-	spin_lock_init(&eq->table_lock);
-
-	INIT_RADIX_TREE(&eq->cq_table, GFP_KERNEL);
-
 	return eq;
 }
 
@@ -65,7 +101,8 @@ int mqnic_open_eq(struct mqnic_eq *eq, struct mqnic_irq *irq, int size)
 	eq->stride = roundup_pow_of_two(MQNIC_EVENT_SIZE);
 
 	eq->buf_size = eq->size * eq->stride;
-	eq->buf = dma_alloc_coherent(eq->dev, eq->buf_size, &eq->buf_dma_addr, GFP_KERNEL);
+	eq->buf = mqnic_dma_arena_alloc(&eq->interface->dma_arena, eq->buf_size,
+			&eq->buf_dma_addr, irq->node);
 	if (!eq->buf) {
 		ret = -ENOMEM;
 		goto fail;
@@ -103,6 +140,8 @@ int mqnic_open_eq(struct mqnic_eq *eq, struct mqnic_irq *irq, int size)
 			eq->hw_addr + MQNIC_EQ_CTRL_STATUS_REG);
 	iowrite32(MQNIC_EQ_CMD_SET_CONS_PTR | (eq->cons_ptr & MQNIC_EQ_PTR_MASK),
 			eq->hw_addr + MQNIC_EQ_CTRL_STATUS_REG);
+	eq->ptr_shadow = mqnic_interface_attach_ptr_shadow(eq->interface,
+			eq->interface->eq_res, eq->eqn, eq->hw_addr + MQNIC_EQ_SHADOW_ADDR_REG);
 	// activate queue
 	iowrite32(MQNIC_EQ_CMD_SET_ENABLE | 1, eq->hw_addr + MQNIC_EQ_CTRL_STATUS_REG);
 
@@ -122,6 +161,9 @@ void mqnic_close_eq(struct mqnic_eq *eq)
 	if (eq->hw_addr) {
 		// deactivate queue
 		iowrite32(MQNIC_EQ_CMD_SET_ENABLE | 0, eq->hw_addr + MQNIC_EQ_CTRL_STATUS_REG);
+
+		mqnic_interface_detach_ptr_shadow(eq->ptr_shadow, eq->hw_addr + MQNIC_EQ_SHADOW_ADDR_REG);
+		eq->ptr_shadow = NULL;
 	}
 
 	// unregister interrupt
@@ -130,10 +172,14 @@ void mqnic_close_eq(struct mqnic_eq *eq)
 
 	eq->irq = NULL;
 
+	tasklet_kill(&eq->tasklet);
+	eq->deferred = false;
+
 	eq->hw_addr = NULL;
 
 	if (eq->buf) {
-		dma_free_coherent(eq->dev, eq->buf_size, eq->buf, eq->buf_dma_addr);
+		mqnic_dma_arena_free(&eq->interface->dma_arena, eq->buf_size,
+				eq->buf, eq->buf_dma_addr);
 		eq->buf = NULL;
 		eq->buf_dma_addr = 0;
 	}
@@ -146,32 +192,35 @@ void mqnic_close_eq(struct mqnic_eq *eq)
 
 int mqnic_eq_attach_cq(struct mqnic_eq *eq, struct mqnic_cq *cq)
 {
-	int ret;
+	struct mqnic_cq **slot = &eq->interface->cq_table[cq->cqn];
 
-	spin_lock_irq(&eq->table_lock);
-	ret = radix_tree_insert(&eq->cq_table, cq->cqn, cq);
-	spin_unlock_irq(&eq->table_lock);
-	return ret;
+	if (*slot)
+		return -EEXIST;
+
+	rcu_assign_pointer(*slot, cq);
+	return 0;
 }
 
 void mqnic_eq_detach_cq(struct mqnic_eq *eq, struct mqnic_cq *cq)
 {
-	struct mqnic_cq *item;
-
-	spin_lock_irq(&eq->table_lock);
-	item = radix_tree_delete(&eq->cq_table, cq->cqn);
-	spin_unlock_irq(&eq->table_lock);
+	struct mqnic_cq **slot = &eq->interface->cq_table[cq->cqn];
 
-	if (IS_ERR(item)) {
-		dev_err(eq->dev, "%s on IF %d EQ %d: radix_tree_delete failed: %ld",
-				__func__, eq->interface->index, eq->eqn, PTR_ERR(item));
-	} else if (!item) {
+	if (!*slot) {
 		dev_err(eq->dev, "%s on IF %d EQ %d: CQ %d not in table",
 				__func__, eq->interface->index, eq->eqn, cq->cqn);
-	} else if (item != cq) {
+		return;
+	} else if (*slot != cq) {
 		dev_err(eq->dev, "%s on IF %d EQ %d: entry mismatch when removing CQ %d",
 				__func__, eq->interface->index, eq->eqn, cq->cqn);
+		return;
 	}
+
+	RCU_INIT_POINTER(*slot, NULL);
+
+	// wait for a handler that may still hold the CQ
+	if (eq->irq)
+		synchronize_irq(eq->irq->irqn);
+	tasklet_unlock_wait(&eq->tasklet);
 }
 
 void mqnic_eq_write_cons_ptr(struct mqnic_eq *eq)
@@ -188,11 +237,13 @@ void mqnic_arm_eq(struct mqnic_eq *eq)
 	iowrite32(MQNIC_EQ_CMD_SET_ARM | 1, eq->hw_addr + MQNIC_EQ_CTRL_STATUS_REG);
 }
 
-void mqnic_process_eq(struct mqnic_eq *eq)
+int mqnic_process_eq(struct mqnic_eq *eq, int budget)
 {
 	struct mqnic_if *interface = eq->interface;
 	struct mqnic_event *event;
 	struct mqnic_cq *cq;
+	u32 cqn;
+	u32 port_index;
 	u32 eq_index;
 	u32 eq_cons_ptr;
 	int done = 0;
@@ -200,7 +251,7 @@ void mqnic_process_eq(struct mqnic_eq *eq)
 	eq_cons_ptr = eq->cons_ptr;
 	eq_index = eq_cons_ptr & eq->size_mask;
 
-	while (1) {
+	while (done < budget) {
 		event = (struct mqnic_event *)(eq->buf + eq_index * eq->stride);
 
 		if (!!(event->phase & cpu_to_le32(0x80000000)) == !!(eq_cons_ptr & eq->size))
@@ -208,13 +259,20 @@ void mqnic_process_eq(struct mqnic_eq *eq)
 
 		dma_rmb();
 
+		prefetch(eq->buf + ((eq_cons_ptr + 1) & eq->size_mask) * eq->stride);
+
 		if (event->type == MQNIC_EVENT_TYPE_CPL) {
 			// completion event
+			cqn = le16_to_cpu(event->source);
+			cq = NULL;
+
 			rcu_read_lock();
-			cq = radix_tree_lookup(&eq->cq_table, le16_to_cpu(event->source));
-			rcu_read_unlock();
+			if (likely(cqn < interface->cq_res->count))
+				cq = rcu_dereference(interface->cq_table[cqn]);
 
-			if (likely(cq)) {
+			if (likely(cq && cq->eq == eq)) {
+				prefetchw(&cq->napi);
+				WRITE_ONCE(cq->last_event_ns, READ_ONCE(eq->last_irq_ns));
 				if (likely(cq->handler))
 					cq->handler(cq);
 			} else {
@@ -224,6 +282,17 @@ void mqnic_process_eq(struct mqnic_eq *eq)
 				print_hex_dump(KERN_ERR, "", DUMP_PREFIX_NONE, 16, 1,
 						event, MQNIC_EVENT_SIZE, true);
 			}
+			rcu_read_unlock();
+		} else if (event->type == cpu_to_le16(MQNIC_EVENT_TYPE_PORT_STATUS)) {
+			// port status change
+			port_index = le16_to_cpu(event->source);
+
+			if (likely(port_index < interface->port_count && interface->port[port_index])) {
+				mqnic_port_status_event(interface->port[port_index]);
+			} else {
+				dev_err(eq->dev, "%s on IF %d EQ %d: unknown port %d (index %d)",
+						__func__, interface->index, eq->eqn, port_index, eq_index);
+			}
 		} else {
 			dev_err(eq->dev, "%s on IF %d EQ %d: unknown event type %d (index %d, source %d)",
 					__func__, interface->index, eq->eqn, le16_to_cpu(event->type),
@@ -236,9 +305,21 @@ void mqnic_process_eq(struct mqnic_eq *eq)
 
 		eq_cons_ptr++;
 		eq_index = eq_cons_ptr & eq->size_mask;
+
+		// hand back slots early so the hardware can keep posting
+		if (!(done % MQNIC_EQ_CONS_PTR_BATCH)) {
+			eq->cons_ptr = eq_cons_ptr;
+			mqnic_eq_write_cons_ptr(eq);
+		}
 	}
 
 	// update EQ consumer pointer
-	eq->cons_ptr = eq_cons_ptr;
-	mqnic_eq_write_cons_ptr(eq);
+	if (eq->cons_ptr != eq_cons_ptr) {
+		eq->cons_ptr = eq_cons_ptr;
+		mqnic_eq_write_cons_ptr(eq);
+	}
+
+	trace_mqnic_eq(eq, done, budget);
+
+	return done;
 }
@@ -8,10 +8,6 @@
 #include <linux/ethtool.h>
 #include <linux/version.h>
 
-#define SFF_MODULE_ID_SFP        0x03
-#define SFF_MODULE_ID_QSFP       0x0c
-#define SFF_MODULE_ID_QSFP_PLUS  0x0d
-#define SFF_MODULE_ID_QSFP28     0x11
 
 static void mqnic_get_drvinfo(struct net_device *ndev,
 		struct ethtool_drvinfo *drvinfo)
@@ -48,6 +44,197 @@ static void mqnic_get_regs(struct net_device *ndev,
 		out[k] = ioread32(priv->mdev->hw_addr + k*4);
 }
 
+struct mqnic_stat_desc {
+	int index;
+	const char *name;
+};
+
+// device statistics block: PCIe TLP counters at 0-31, DMA interface counters at 32-63
+static const struct mqnic_stat_desc mqnic_dev_stats[] = {
+	{0, "pcie_rx_tlp_mem_rd"},
+	{1, "pcie_rx_tlp_mem_wr"},
+	{2, "pcie_rx_tlp_io"},
+	{3, "pcie_rx_tlp_cfg"},
+	{4, "pcie_rx_tlp_msg"},
+	{5, "pcie_rx_tlp_cpl"},
+	{6, "pcie_rx_tlp_cpl_ur"},
+	{7, "pcie_rx_tlp_cpl_ca"},
+	{8, "pcie_rx_tlp_atomic"},
+	{9, "pcie_rx_tlp_ep"},
+	{10, "pcie_rx_tlp_hdr_dw"},
+	{11, "pcie_rx_tlp_req_dw"},
+	{12, "pcie_rx_tlp_payload_dw"},
+	{13, "pcie_rx_tlp_cpl_dw"},
+	{16, "pcie_tx_tlp_mem_rd"},
+	{17, "pcie_tx_tlp_mem_wr"},
+	{18, "pcie_tx_tlp_io"},
+	{19, "pcie_tx_tlp_cfg"},
+	{20, "pcie_tx_tlp_msg"},
+	{21, "pcie_tx_tlp_cpl"},
+	{22, "pcie_tx_tlp_cpl_ur"},
+	{23, "pcie_tx_tlp_cpl_ca"},
+	{24, "pcie_tx_tlp_atomic"},
+	{25, "pcie_tx_tlp_ep"},
+	{26, "pcie_tx_tlp_hdr_dw"},
+	{27, "pcie_tx_tlp_req_dw"},
+	{28, "pcie_tx_tlp_payload_dw"},
+	{29, "pcie_tx_tlp_cpl_dw"},
+	{32, "dma_rd_op_count"},
+	{33, "dma_rd_op_bytes"},
+	{34, "dma_rd_op_latency"},
+	{35, "dma_rd_op_error"},
+	{36, "dma_rd_req_count"},
+	{37, "dma_rd_req_latency"},
+	{38, "dma_rd_req_timeout"},
+	{39, "dma_rd_op_table_full"},
+	{40, "dma_rd_no_tags"},
+	{41, "dma_rd_tx_limit"},
+	{42, "dma_rd_tx_stall"},
+	{48, "dma_wr_op_count"},
+	{49, "dma_wr_op_bytes"},
+	{50, "dma_wr_op_latency"},
+	{51, "dma_wr_op_error"},
+	{52, "dma_wr_req_count"},
+	{53, "dma_wr_req_latency"},
+	{55, "dma_wr_op_table_full"},
+	{57, "dma_wr_tx_limit"},
+	{58, "dma_wr_tx_stall"},
+};
+
+#define MQNIC_DEV_STATS_LEN ARRAY_SIZE(mqnic_dev_stats)
+
+static const char * const mqnic_rx_ring_stats[] = {
+	"packets",
+	"bytes",
+	"dropped",
+	"alloc_failed",
+	"napi_exhausted",
+};
+
+#define MQNIC_RX_RING_STATS_LEN ARRAY_SIZE(mqnic_rx_ring_stats)
+
+static const char * const mqnic_tx_ring_stats[] = {
+	"packets",
+	"bytes",
+	"dropped",
+	"queue_stops",
+	"napi_exhausted",
+};
+
+#define MQNIC_TX_RING_STATS_LEN ARRAY_SIZE(mqnic_tx_ring_stats)
+
+static int mqnic_get_sset_count(struct net_device *ndev, int sset)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	int count;
+
+	switch (sset) {
+	case ETH_SS_STATS:
+		count = priv->rxq_count * MQNIC_RX_RING_STATS_LEN;
+		count += priv->txq_count * MQNIC_TX_RING_STATS_LEN;
+		if (priv->mdev->stats_rb)
+			count += MQNIC_DEV_STATS_LEN;
+		return count;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void mqnic_get_strings(struct net_device *ndev, u32 sset, u8 *data)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	int k, n;
+
+	if (sset != ETH_SS_STATS)
+		return;
+
+	for (k = 0; k < priv->rxq_count; k++) {
+		for (n = 0; n < MQNIC_RX_RING_STATS_LEN; n++) {
+			snprintf(data, ETH_GSTRING_LEN, "rx%d_%s", k, mqnic_rx_ring_stats[n]);
+			data += ETH_GSTRING_LEN;
+		}
+	}
+
+	for (k = 0; k < priv->txq_count; k++) {
+		for (n = 0; n < MQNIC_TX_RING_STATS_LEN; n++) {
+			snprintf(data, ETH_GSTRING_LEN, "tx%d_%s", k, mqnic_tx_ring_stats[n]);
+			data += ETH_GSTRING_LEN;
+		}
+	}
+
+	if (priv->mdev->stats_rb) {
+		for (n = 0; n < MQNIC_DEV_STATS_LEN; n++) {
+			strscpy(data, mqnic_dev_stats[n].name, ETH_GSTRING_LEN);
+			data += ETH_GSTRING_LEN;
+		}
+	}
+}
+
+static void mqnic_get_ring_stats(const struct mqnic_ring *ring, u64 *data, bool tx)
+{
+	unsigned int start;
+
+	do {
+		start = u64_stats_fetch_begin(&ring->syncp);
+		data[0] = u64_stats_read(&ring->packets);
+		data[1] = u64_stats_read(&ring->bytes);
+		data[2] = u64_stats_read(&ring->dropped_packets);
+		data[3] = u64_stats_read(tx ? &ring->queue_stops : &ring->alloc_failed);
+	} while (u64_stats_fetch_retry(&ring->syncp, start));
+
+	do {
+		start = u64_stats_fetch_begin(&ring->cpl_syncp);
+		data[4] = u64_stats_read(&ring->napi_exhausted);
+	} while (u64_stats_fetch_retry(&ring->cpl_syncp, start));
+}
+
+static void mqnic_get_ethtool_stats(struct net_device *ndev,
+		struct ethtool_stats *stats, u64 *data)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	const struct mqnic_ring *ring;
+	int k;
+
+	rcu_read_lock();
+
+	for (k = 0; k < priv->rxq_count; k++) {
+		ring = rcu_dereference(priv->rxq_table[k]);
+
+		if (ring)
+			mqnic_get_ring_stats(ring, data, false);
+		else
+			memset(data, 0, MQNIC_RX_RING_STATS_LEN * sizeof(*data));
+
+		data += MQNIC_RX_RING_STATS_LEN;
+	}
+
+	for (k = 0; k < priv->txq_count; k++) {
+		ring = rcu_dereference(priv->txq_table[k]);
+
+		if (ring)
+			mqnic_get_ring_stats(ring, data, true);
+		else
+			memset(data, 0, MQNIC_TX_RING_STATS_LEN * sizeof(*data));
+
+		data += MQNIC_TX_RING_STATS_LEN;
+	}
+
+	rcu_read_unlock();
+
+	if (priv->mdev->stats_rb) {
+		for (k = 0; k < MQNIC_DEV_STATS_LEN; k++)
+			*data++ = mqnic_stats_read_cached(priv->mdev, mqnic_dev_stats[k].index);
+	}
+}
+
+#ifdef MQNIC_NETMEM
+static bool mqnic_can_split_headers(struct mqnic_priv *priv)
+{
+	return (priv->if_features & MQNIC_IF_FEATURE_RX_HDR_SPLIT) &&
+		priv->interface->max_rx_desc_block_size >= 2;
+}
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
 static void mqnic_get_ringparam(struct net_device *ndev,
 		struct ethtool_ringparam *param,
@@ -69,6 +256,11 @@ static void mqnic_get_ringparam(struct net_device *ndev,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
 	kernel_param->cqe_size = MQNIC_CPL_SIZE;
 #endif
+#ifdef MQNIC_NETMEM
+	if (mqnic_can_split_headers(priv))
+		kernel_param->tcp_data_split = priv->rx_hdr_split ?
+			ETHTOOL_TCP_DATA_SPLIT_ENABLED : ETHTOOL_TCP_DATA_SPLIT_DISABLED;
+#endif
 }
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
@@ -82,13 +274,25 @@ static int mqnic_set_ringparam(struct net_device *ndev,
 #endif
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
+	bool hdr_split = priv->rx_hdr_split;
 	u32 tx_ring_size, rx_ring_size;
-	int port_up = priv->port_up;
 	int ret = 0;
 
 	if (param->rx_mini_pending || param->rx_jumbo_pending)
 		return -EINVAL;
 
+#ifdef MQNIC_NETMEM
+	if (kernel_param->tcp_data_split == ETHTOOL_TCP_DATA_SPLIT_ENABLED) {
+		if (!mqnic_can_split_headers(priv)) {
+			NL_SET_ERR_MSG_MOD(ext_ack, "header split not supported by hardware");
+			return -EOPNOTSUPP;
+		}
+		hdr_split = true;
+	} else if (kernel_param->tcp_data_split == ETHTOOL_TCP_DATA_SPLIT_DISABLED) {
+		hdr_split = false;
+	}
+#endif
+
 	if (param->rx_pending < MQNIC_MIN_RX_RING_SZ)
 		return -EINVAL;
 
@@ -104,7 +308,8 @@ static int mqnic_set_ringparam(struct net_device *ndev,
 	rx_ring_size = roundup_pow_of_two(param->rx_pending);
 	tx_ring_size = roundup_pow_of_two(param->tx_pending);
 
-	if (rx_ring_size == priv->rx_ring_size && tx_ring_size == priv->tx_ring_size)
+	if (rx_ring_size == priv->rx_ring_size && tx_ring_size == priv->tx_ring_size &&
+			hdr_split == priv->rx_hdr_split)
 		return 0;
 
 	netdev_info(ndev, "New TX ring size: %d", tx_ring_size);
@@ -112,17 +317,27 @@ static int mqnic_set_ringparam(struct net_device *ndev,
 
 	mutex_lock(&priv->mdev->state_lock);
 
-	if (port_up)
-		mqnic_stop_port(ndev);
+	if (hdr_split != priv->rx_hdr_split) {
+		bool port_up = priv->port_up;
 
-	priv->tx_ring_size = tx_ring_size;
-	priv->rx_ring_size = rx_ring_size;
+		// every RX ring is rebuilt with the new buffer layout
+		netdev_info(ndev, "RX header split %s", hdr_split ? "on" : "off");
 
-	if (port_up) {
-		ret = mqnic_start_port(ndev);
+		if (port_up)
+			mqnic_stop_port(ndev);
 
-		if (ret)
-			netdev_err(ndev, "%s: Failed to start port: %d", __func__, ret);
+		priv->rx_hdr_split = hdr_split;
+		priv->tx_ring_size = tx_ring_size;
+		priv->rx_ring_size = rx_ring_size;
+
+		if (port_up) {
+			ret = mqnic_start_port(ndev);
+			if (ret)
+				netdev_err(ndev, "%s: Failed to start port: %d", __func__, ret);
+		}
+	} else {
+		ret = mqnic_reconfigure_port(ndev, priv->txq_count, priv->rxq_count,
+				tx_ring_size, rx_ring_size);
 	}
 
 	mutex_unlock(&priv->mdev->state_lock);
@@ -130,6 +345,98 @@ static int mqnic_set_ringparam(struct net_device *ndev,
 	return ret;
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int mqnic_get_coalesce(struct net_device *ndev,
+		struct ethtool_coalesce *ec,
+		struct kernel_ethtool_coalesce *kernel_coal,
+		struct netlink_ext_ack *ext_ack)
+#else
+static int mqnic_get_coalesce(struct net_device *ndev,
+		struct ethtool_coalesce *ec)
+#endif
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	ec->rx_coalesce_usecs = priv->rx_coal_usecs;
+	ec->rx_max_coalesced_frames = priv->rx_coal_frames;
+	ec->tx_coalesce_usecs = priv->tx_coal_usecs;
+	ec->tx_max_coalesced_frames = priv->tx_coal_frames;
+
+	ec->use_adaptive_rx_coalesce = priv->rx_dim_enabled;
+	ec->use_adaptive_tx_coalesce = priv->tx_dim_enabled;
+
+	return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int mqnic_set_coalesce(struct net_device *ndev,
+		struct ethtool_coalesce *ec,
+		struct kernel_ethtool_coalesce *kernel_coal,
+		struct netlink_ext_ack *ext_ack)
+#else
+static int mqnic_set_coalesce(struct net_device *ndev,
+		struct ethtool_coalesce *ec)
+#endif
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *q;
+	int k;
+
+	if (ec->rx_coalesce_usecs > MQNIC_CQ_HOLDOFF_MASK ||
+			ec->tx_coalesce_usecs > MQNIC_CQ_HOLDOFF_MASK ||
+			ec->rx_max_coalesced_frames > MQNIC_CQ_HOLDOFF_MASK ||
+			ec->tx_max_coalesced_frames > MQNIC_CQ_HOLDOFF_MASK)
+		return -EINVAL;
+
+	// frame count limit requires hardware holdoff support
+	if (!(priv->if_features & MQNIC_IF_FEATURE_CQ_HOLDOFF) &&
+			(ec->rx_max_coalesced_frames || ec->tx_max_coalesced_frames))
+		return -EOPNOTSUPP;
+
+#ifndef MQNIC_DIM
+	if (ec->use_adaptive_rx_coalesce || ec->use_adaptive_tx_coalesce)
+		return -EOPNOTSUPP;
+#endif
+
+	mutex_lock(&priv->mdev->state_lock);
+
+	priv->rx_coal_usecs = ec->rx_coalesce_usecs;
+	priv->rx_coal_frames = ec->rx_max_coalesced_frames;
+	priv->tx_coal_usecs = ec->tx_coalesce_usecs;
+	priv->tx_coal_frames = ec->tx_max_coalesced_frames;
+
+	priv->rx_dim_enabled = ec->use_adaptive_rx_coalesce;
+	priv->tx_dim_enabled = ec->use_adaptive_tx_coalesce;
+
+	// apply static settings to active queues; adaptive queues retune themselves
+	if (!priv->tx_dim_enabled) {
+		for (k = 0; k < priv->txq_count; k++) {
+			q = priv->txq_table[k];
+
+			// a shared CQ follows the RX settings
+			if (q && q->cq->src_ring == q)
+				mqnic_cq_set_coalesce(q->cq, priv->tx_coal_usecs, priv->tx_coal_frames);
+		}
+
+		for (k = 0; k < priv->xdp_txq_count; k++)
+			mqnic_cq_set_coalesce(priv->xdp_txq[k]->cq,
+					priv->tx_coal_usecs, priv->tx_coal_frames);
+	}
+
+	if (!priv->rx_dim_enabled) {
+		for (k = 0; k < priv->rxq_count; k++) {
+			q = priv->rxq_table[k];
+
+			if (q)
+				mqnic_cq_set_coalesce(q->cq, priv->rx_coal_usecs, priv->rx_coal_frames);
+		}
+	}
+
+	mutex_unlock(&priv->mdev->state_lock);
+
+	return 0;
+}
+
 static void mqnic_get_pauseparam(struct net_device *ndev,
 		struct ethtool_pauseparam *param)
 {
@@ -161,6 +468,10 @@ static int mqnic_set_pauseparam(struct net_device *ndev,
 	if (param->autoneg)
 		return -EINVAL;
 
+	// PFC and link pause exclude each other
+	if ((param->rx_pause || param->tx_pause) && mqnic_dcb_pfc_enabled(priv))
+		return -EBUSY;
+
 	val = mqnic_port_get_lfc_ctrl(priv->port);
 
 	if (param->rx_pause)
@@ -178,15 +489,145 @@ static int mqnic_set_pauseparam(struct net_device *ndev,
 	return 0;
 }
 
+static int mqnic_get_tunable(struct net_device *ndev,
+		const struct ethtool_tunable *tuna, void *data)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		*(u32 *)data = priv->rx_copybreak;
+		break;
+	case ETHTOOL_TX_COPYBREAK:
+		*(u32 *)data = priv->tx_copybreak;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+static int mqnic_set_tunable(struct net_device *ndev,
+		const struct ethtool_tunable *tuna, const void *data)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	u32 val;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		val = *(const u32 *)data;
+		if (val > MQNIC_RX_COPYBREAK_MAX)
+			return -EINVAL;
+
+		// read once per NAPI poll, takes effect without a restart
+		WRITE_ONCE(priv->rx_copybreak, val);
+		break;
+	case ETHTOOL_TX_COPYBREAK:
+		val = *(const u32 *)data;
+		if (val > MQNIC_TX_COPYBREAK_MAX)
+			return -EINVAL;
+
+		// bounce slots are sized for the maximum, so no ring rebuild is needed
+		WRITE_ONCE(priv->tx_copybreak, val);
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+static int mqnic_get_flow_rule_count(struct mqnic_priv *priv)
+{
+	struct mqnic_if *iface = priv->interface;
+	struct mqnic_flow_rule rule;
+	int count = 0;
+	int k;
+
+	for (k = 0; k < iface->rx_flow_table_size; k++)
+		if (!mqnic_interface_get_flow_rule(iface, k, &rule) && rule.priv == priv && !rule.arfs)
+			count++;
+
+	return count;
+}
+
+static int mqnic_get_flow_rule_spec(struct mqnic_priv *priv, struct ethtool_rx_flow_spec *fs)
+{
+	struct mqnic_flow_rule rule;
+	struct ethtool_tcpip4_spec *spec;
+	struct ethtool_tcpip4_spec *mask;
+	int ret;
+
+	ret = mqnic_interface_get_flow_rule(priv->interface, fs->location, &rule);
+	if (ret)
+		return ret;
+
+	if (rule.priv != priv || rule.arfs)
+		return -ENOENT;
+
+	memset(&fs->h_u, 0, sizeof(fs->h_u));
+	memset(&fs->m_u, 0, sizeof(fs->m_u));
+
+	fs->flow_type = rule.ip_proto == IPPROTO_TCP ? TCP_V4_FLOW : UDP_V4_FLOW;
+
+	spec = &fs->h_u.tcp_ip4_spec;
+	mask = &fs->m_u.tcp_ip4_spec;
+
+	spec->ip4src = rule.src_ip;
+	spec->ip4dst = rule.dst_ip;
+	spec->psrc = rule.src_port;
+	spec->pdst = rule.dst_port;
+
+	mask->ip4src = htonl(0xffffffff);
+	mask->ip4dst = htonl(0xffffffff);
+	mask->psrc = htons(0xffff);
+	mask->pdst = htons(0xffff);
+
+	fs->ring_cookie = rule.rxq;
+
+	return 0;
+}
+
 static int mqnic_get_rxnfc(struct net_device *ndev,
 		struct ethtool_rxnfc *rxnfc, u32 *rule_locs)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_if *iface = priv->interface;
+	struct mqnic_flow_rule rule;
+	int count = 0;
+	int k;
 
 	switch (rxnfc->cmd) {
 	case ETHTOOL_GRXRINGS:
 		rxnfc->data = priv->rxq_count;
 		break;
+	case ETHTOOL_GRXCLSRLCNT:
+		if (!iface->rx_flow_rules)
+			return -EOPNOTSUPP;
+
+		rxnfc->data = iface->rx_flow_table_size;
+		rxnfc->rule_cnt = mqnic_get_flow_rule_count(priv);
+		break;
+	case ETHTOOL_GRXCLSRULE:
+		return mqnic_get_flow_rule_spec(priv, &rxnfc->fs);
+	case ETHTOOL_GRXCLSRLALL:
+		if (!iface->rx_flow_rules)
+			return -EOPNOTSUPP;
+
+		for (k = 0; k < iface->rx_flow_table_size; k++) {
+			if (mqnic_interface_get_flow_rule(iface, k, &rule) || rule.priv != priv || rule.arfs)
+				continue;
+
+			if (count >= rxnfc->rule_cnt)
+				return -EMSGSIZE;
+
+			rule_locs[count++] = k;
+		}
+
+		rxnfc->data = iface->rx_flow_table_size;
+		rxnfc->rule_cnt = count;
+		break;
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -194,6 +635,68 @@ static int mqnic_get_rxnfc(struct net_device *ndev,
 	return 0;
 }
 
+static int mqnic_add_flow_rule_spec(struct mqnic_priv *priv, struct ethtool_rx_flow_spec *fs)
+{
+	struct mqnic_if *iface = priv->interface;
+	struct ethtool_tcpip4_spec *spec = &fs->h_u.tcp_ip4_spec;
+	struct ethtool_tcpip4_spec *mask = &fs->m_u.tcp_ip4_spec;
+	struct mqnic_flow_rule rule = {0};
+	int ret;
+
+	if (!(priv->ndev->features & NETIF_F_NTUPLE))
+		return -EOPNOTSUPP;
+
+	// exact match on the IPv4 5-tuple, steering to a queue
+	switch (fs->flow_type) {
+	case TCP_V4_FLOW:
+		rule.ip_proto = IPPROTO_TCP;
+		break;
+	case UDP_V4_FLOW:
+		rule.ip_proto = IPPROTO_UDP;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	if (mask->ip4src != htonl(0xffffffff) || mask->ip4dst != htonl(0xffffffff) ||
+			mask->psrc != htons(0xffff) || mask->pdst != htons(0xffff) || mask->tos)
+		return -EOPNOTSUPP;
+
+	if (fs->ring_cookie == RX_CLS_FLOW_DISC || fs->ring_cookie >= priv->rxq_count)
+		return -EINVAL;
+
+	if (fs->location >= iface->rx_flow_table_size)
+		return -EINVAL;
+
+	rule.priv = priv;
+	rule.src_ip = spec->ip4src;
+	rule.dst_ip = spec->ip4dst;
+	rule.src_port = spec->psrc;
+	rule.dst_port = spec->pdst;
+	rule.rxq = fs->ring_cookie;
+
+	ret = mqnic_interface_add_flow_rule(iface, fs->location, &rule);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int mqnic_set_rxnfc(struct net_device *ndev, struct ethtool_rxnfc *rxnfc)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	if (!priv->interface->rx_flow_rules)
+		return -EOPNOTSUPP;
+
+	switch (rxnfc->cmd) {
+	case ETHTOOL_SRXCLSRLINS:
+		return mqnic_add_flow_rule_spec(priv, &rxnfc->fs);
+	case ETHTOOL_SRXCLSRLDEL:
+		return mqnic_interface_del_flow_rule(priv->interface, priv, rxnfc->fs.location);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static u32 mqnic_get_rxfh_indir_size(struct net_device *ndev)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
@@ -201,6 +704,11 @@ static u32 mqnic_get_rxfh_indir_size(struct net_device *ndev)
 	return priv->rx_queue_map_indir_table_size;
 }
 
+static u32 mqnic_get_rxfh_key_size(struct net_device *ndev)
+{
+	return MQNIC_RX_HASH_KEY_SIZE;
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
 static int mqnic_get_rxfh(struct net_device *ndev, struct ethtool_rxfh_param *rxfh)
 {
@@ -215,6 +723,10 @@ static int mqnic_get_rxfh(struct net_device *ndev, struct ethtool_rxfh_param *rx
 		for (k = 0; k < priv->rx_queue_map_indir_table_size; k++)
 			rxfh->indir[k] = priv->rx_queue_map_indir_table[k];
 
+	rxfh->key_size = MQNIC_RX_HASH_KEY_SIZE;
+	if (rxfh->key)
+		mqnic_interface_get_rx_hash_key(priv->interface, rxfh->key);
+
 	return 0;
 }
 
@@ -223,24 +735,33 @@ static int mqnic_set_rxfh(struct net_device *ndev, struct ethtool_rxfh_param *rx
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
 	int k;
+	int ret;
 
 	if (rxfh->hfunc != ETH_RSS_HASH_NO_CHANGE && rxfh->hfunc != ETH_RSS_HASH_TOP)
 		return -EOPNOTSUPP;
 
-	if (!rxfh->indir)
-		return 0;
-
 	if (rxfh->indir) {
 		for (k = 0; k < priv->rx_queue_map_indir_table_size; k++) {
 			if (rxfh->indir[k] >= priv->rxq_count)
 				return -EINVAL;
 		}
+	}
 
-		for (k = 0; k < priv->rx_queue_map_indir_table_size; k++)
-			priv->rx_queue_map_indir_table[k] = rxfh->indir[k];
+	// key is shared by all ports on the interface
+	if (rxfh->key) {
+		ret = mqnic_interface_set_rx_hash_key(priv->interface, rxfh->key);
+		if (ret)
+			return ret;
 	}
 
-	return mqnic_update_indir_table(ndev);
+	if (!rxfh->indir)
+		return 0;
+
+	for (k = 0; k < priv->rx_queue_map_indir_table_size; k++)
+		priv->rx_queue_map_indir_table[k] = rxfh->indir[k];
+
+	// shared by all members under hardware LAG
+	return mqnic_lag_update_indir_table(ndev);
 }
 #else
 static int mqnic_get_rxfh(struct net_device *ndev, u32 *indir, u8 *key,
@@ -256,6 +777,9 @@ static int mqnic_get_rxfh(struct net_device *ndev, u32 *indir, u8 *key,
 		for (k = 0; k < priv->rx_queue_map_indir_table_size; k++)
 			indir[k] = priv->rx_queue_map_indir_table[k];
 
+	if (key)
+		mqnic_interface_get_rx_hash_key(priv->interface, key);
+
 	return 0;
 }
 
@@ -264,24 +788,33 @@ static int mqnic_set_rxfh(struct net_device *ndev, const u32 *indir,
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
 	int k;
+	int ret;
 
 	if (hfunc != ETH_RSS_HASH_NO_CHANGE && hfunc != ETH_RSS_HASH_TOP)
 		return -EOPNOTSUPP;
 
-	if (!indir)
-		return 0;
-
 	if (indir) {
 		for (k = 0; k < priv->rx_queue_map_indir_table_size; k++) {
 			if (indir[k] >= priv->rxq_count)
 				return -EINVAL;
 		}
+	}
 
-		for (k = 0; k < priv->rx_queue_map_indir_table_size; k++)
-			priv->rx_queue_map_indir_table[k] = indir[k];
+	// key is shared by all ports on the interface
+	if (key) {
+		ret = mqnic_interface_set_rx_hash_key(priv->interface, key);
+		if (ret)
+			return ret;
 	}
 
-	return mqnic_update_indir_table(ndev);
+	if (!indir)
+		return 0;
+
+	for (k = 0; k < priv->rx_queue_map_indir_table_size; k++)
+		priv->rx_queue_map_indir_table[k] = indir[k];
+
+	// shared by all members under hardware LAG
+	return mqnic_lag_update_indir_table(ndev);
 }
 #endif
 
@@ -292,9 +825,14 @@ static void mqnic_get_channels(struct net_device *ndev,
 
 	channel->max_rx = mqnic_res_get_count(priv->interface->rxq_res);
 	channel->max_tx = mqnic_res_get_count(priv->interface->txq_res);
+	channel->max_combined = min(channel->max_rx, channel->max_tx);
 
-	channel->rx_count = priv->rxq_count;
-	channel->tx_count = priv->txq_count;
+	if (priv->combined) {
+		channel->combined_count = priv->rxq_count;
+	} else {
+		channel->rx_count = priv->rxq_count;
+		channel->tx_count = priv->txq_count;
+	}
 }
 
 static int mqnic_set_channels(struct net_device *ndev,
@@ -302,11 +840,18 @@ static int mqnic_set_channels(struct net_device *ndev,
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
 	u32 txq_count, rxq_count;
-	int port_up = priv->port_up;
+	bool txq_changed, rxq_changed;
+	bool combined;
+	bool restart;
 	int ret = 0;
 	int k;
 
-	if (channel->combined_count || channel->other_count)
+	if (channel->other_count)
+		return -EINVAL;
+
+	// either combined channels or separate RX and TX, not a mix
+	combined = channel->combined_count != 0;
+	if (combined && (channel->rx_count || channel->tx_count))
 		return -EINVAL;
 
 	if (priv->rxq_count > mqnic_res_get_count(priv->interface->rxq_res))
@@ -315,12 +860,38 @@ static int mqnic_set_channels(struct net_device *ndev,
 	if (priv->txq_count > mqnic_res_get_count(priv->interface->txq_res))
 		return -EINVAL;
 
-	rxq_count = channel->rx_count;
-	txq_count = channel->tx_count;
+	if (combined) {
+		rxq_count = channel->combined_count;
+		txq_count = channel->combined_count;
+	} else {
+		rxq_count = channel->rx_count;
+		txq_count = channel->tx_count;
+	}
 
-	if (rxq_count == priv->rxq_count && txq_count == priv->txq_count)
+	if (rxq_count == priv->rxq_count && txq_count == priv->txq_count &&
+			combined == priv->combined)
 		return 0;
 
+	// queues bound to AF_XDP sockets must stay in range
+	if (find_next_bit(priv->xsk_zc_qps, ndev->num_rx_queues, rxq_count) < ndev->num_rx_queues) {
+		netdev_err(ndev, "Cannot remove RX queues bound to AF_XDP sockets");
+		return -EBUSY;
+	}
+
+	// mqprio queue groups are laid out over the current TX queues
+	if (txq_count != priv->txq_count && netdev_get_num_tc(ndev)) {
+		netdev_err(ndev, "Cannot change TX queue count with mqprio offload active");
+		return -EBUSY;
+	}
+
+#ifdef MQNIC_L2FW
+	// offloaded macvlans own the queues at the top of the port's range
+	if (priv->fwd_count) {
+		netdev_err(ndev, "Cannot change channel count with offloaded macvlans");
+		return -EBUSY;
+	}
+#endif
+
 	netdev_info(ndev, "New TX channel count: %d", txq_count);
 	netdev_info(ndev, "New RX channel count: %d", rxq_count);
 
@@ -328,23 +899,38 @@ static int mqnic_set_channels(struct net_device *ndev,
 		for (k = 0; k < priv->rx_queue_map_indir_table_size; k++)
 			priv->rx_queue_map_indir_table[k] = k % rxq_count;
 
+	txq_changed = txq_count != priv->txq_count;
+	rxq_changed = rxq_count != priv->rxq_count;
+
 	mutex_lock(&priv->mdev->state_lock);
 
-	if (port_up)
+	// rings are paired up as they are created, so a mode change restarts the port
+	restart = priv->port_up && combined != priv->combined;
+	if (restart)
 		mqnic_stop_port(ndev);
 
-	priv->txq_count = txq_count;
-	priv->rxq_count = rxq_count;
+	priv->combined = combined;
 
-	if (port_up) {
-		ret = mqnic_start_port(ndev);
+	ret = mqnic_reconfigure_port(ndev, txq_count, rxq_count,
+			priv->tx_ring_size, priv->rx_ring_size);
 
+	if (restart && !ret) {
+		ret = mqnic_start_port(ndev);
 		if (ret)
-			netdev_err(ndev, "%s: Failed to start port: %d", __func__, ret);
+			netdev_err(ndev, "Failed to start port: %d", ret);
 	}
 
 	mutex_unlock(&priv->mdev->state_lock);
 
+	// queue weights split the port's share by queue count
+	if (!ret && txq_changed)
+		mqnic_devlink_rate_update(priv->mdev);
+
+	// hardware LAG needs equal RX queue counts, and a new table is shared
+	mqnic_lag_update(priv->interface);
+	if (priv->interface->lag_offload && rxq_changed)
+		mqnic_lag_update_indir_table(ndev);
+
 	return ret;
 }
 
@@ -372,8 +958,18 @@ static int mqnic_get_ts_info(struct net_device *ndev,
 
 	info->tx_types = BIT(HWTSTAMP_TX_OFF) | BIT(HWTSTAMP_TX_ON);
 
+#ifdef MQNIC_PTP_ONESTEP
+	if (priv->if_features & MQNIC_IF_FEATURE_PTP_ONESTEP && priv->interface->max_desc_block_size >= 4)
+		info->tx_types |= BIT(HWTSTAMP_TX_ONESTEP_SYNC);
+#endif
+
 	info->rx_filters = BIT(HWTSTAMP_FILTER_NONE) | BIT(HWTSTAMP_FILTER_ALL);
 
+	if (priv->if_features & MQNIC_IF_FEATURE_PTP_CLASSIFY)
+		info->rx_filters |= BIT(HWTSTAMP_FILTER_PTP_V2_EVENT) |
+			BIT(HWTSTAMP_FILTER_PTP_V2_L2_EVENT) |
+			BIT(HWTSTAMP_FILTER_PTP_V2_L4_EVENT);
+
 	return 0;
 }
 
@@ -382,27 +978,7 @@ static int mqnic_read_module_eeprom(struct net_device *ndev,
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
 
-	if (!priv->mod_i2c_client)
-		return -EINVAL;
-
-	if (len > I2C_SMBUS_BLOCK_MAX)
-		len = I2C_SMBUS_BLOCK_MAX;
-
-	return i2c_smbus_read_i2c_block_data(priv->mod_i2c_client, offset, len, data);
-}
-
-static int mqnic_write_module_eeprom(struct net_device *ndev,
-		u16 offset, u16 len, u8 *data)
-{
-	struct mqnic_priv *priv = netdev_priv(ndev);
-
-	if (!priv->mod_i2c_client)
-		return -EINVAL;
-
-	if (len > I2C_SMBUS_BLOCK_MAX)
-		len = I2C_SMBUS_BLOCK_MAX;
-
-	return i2c_smbus_write_i2c_block_data(priv->mod_i2c_client, offset, len, data);
+	return mqnic_mod_read(priv->interface, 0x50, 0, offset, len, data);
 }
 
 static int mqnic_query_module_id(struct net_device *ndev)
@@ -423,9 +999,6 @@ static int mqnic_query_module_eeprom_by_page(struct net_device *ndev,
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
 	int module_id;
-	u8 d;
-	int ret;
-	unsigned short orig_i2c_addr;
 
 	module_id = mqnic_query_module_id(ndev);
 
@@ -454,42 +1027,8 @@ static int mqnic_query_module_eeprom_by_page(struct net_device *ndev,
 		return -EINVAL;
 	}
 
-	// set page
-	switch (module_id) {
-	case SFF_MODULE_ID_SFP:
-		break;
-	case SFF_MODULE_ID_QSFP:
-	case SFF_MODULE_ID_QSFP_PLUS:
-	case SFF_MODULE_ID_QSFP28:
-		if (offset+len >= 128) {
-			// select page
-			d = page;
-			mqnic_write_module_eeprom(ndev, 127, 1, &d);
-			msleep(1);
-		}
-		break;
-	default:
-		netdev_err(ndev, "%s: Unknown module ID (0x%x)", __func__, module_id);
-		return -EINVAL;
-	}
-
-	// set i2c address of the mod_i2c_client
-	// This code section should not be called concurrently since the IOCTL
-	// handler for ethtool operations is called under the RTNL lock.
-	// In addition the i2c_client is used only within code inside this lock.
-	if (!priv->mod_i2c_client)
-		return -EINVAL;
-
-	orig_i2c_addr = priv->mod_i2c_client->addr;
-	priv->mod_i2c_client->addr = i2c_addr;
-
-	// read data
-	ret = mqnic_read_module_eeprom(ndev, offset, len, data);
-
-	// reset i2c addr
-	priv->mod_i2c_client->addr = orig_i2c_addr;
-
-	return ret;
+	// served from the interface module cache, which handles page select
+	return mqnic_mod_read(priv->interface, i2c_addr, page, offset, len, data);
 }
 
 static int mqnic_query_module_eeprom(struct net_device *ndev,
@@ -650,16 +1189,33 @@ static int mqnic_get_module_eeprom_by_page(struct net_device *ndev,
 #endif
 
 const struct ethtool_ops mqnic_ethtool_ops = {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 7, 0)
+	.supported_coalesce_params = ETHTOOL_COALESCE_USECS |
+		ETHTOOL_COALESCE_MAX_FRAMES |
+		ETHTOOL_COALESCE_USE_ADAPTIVE,
+#endif
+#ifdef MQNIC_NETMEM
+	.supported_ring_params = ETHTOOL_RING_USE_TCP_DATA_SPLIT,
+#endif
 	.get_drvinfo = mqnic_get_drvinfo,
 	.get_regs_len = mqnic_get_regs_len,
 	.get_regs = mqnic_get_regs,
+	.get_sset_count = mqnic_get_sset_count,
+	.get_strings = mqnic_get_strings,
+	.get_ethtool_stats = mqnic_get_ethtool_stats,
 	.get_link = ethtool_op_get_link,
 	.get_ringparam = mqnic_get_ringparam,
 	.set_ringparam = mqnic_set_ringparam,
+	.get_coalesce = mqnic_get_coalesce,
+	.set_coalesce = mqnic_set_coalesce,
 	.get_pauseparam = mqnic_get_pauseparam,
 	.set_pauseparam = mqnic_set_pauseparam,
+	.get_tunable = mqnic_get_tunable,
+	.set_tunable = mqnic_set_tunable,
 	.get_rxnfc = mqnic_get_rxnfc,
+	.set_rxnfc = mqnic_set_rxnfc,
 	.get_rxfh_indir_size = mqnic_get_rxfh_indir_size,
+	.get_rxfh_key_size = mqnic_get_rxfh_key_size,
 	.get_rxfh = mqnic_get_rxfh,
 	.set_rxfh = mqnic_set_rxfh,
 	.get_channels = mqnic_get_channels,
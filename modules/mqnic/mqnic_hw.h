@@ -25,6 +25,8 @@
 #define MQNIC_MAX_TX_RING_SZ  32768
 #define MQNIC_MIN_RX_RING_SZ  (4096/16)
 #define MQNIC_MAX_RX_RING_SZ  32768
+#define MQNIC_MIN_EQ_SZ       (4096/32)
+#define MQNIC_MAX_EQ_SZ       32768
 
 #define MQNIC_MAX_I2C_ADAPTERS 4
 
@@ -86,6 +88,27 @@
 #define MQNIC_REG_GPIO_I2C_SDA_IN         0x00000100
 #define MQNIC_REG_GPIO_I2C_SDA_OUT        0x00000200
 
+// byte-level I2C master, used in place of the GPIO block at the same index
+#define MQNIC_RB_I2C_MASTER_TYPE          0x0000C111
+#define MQNIC_RB_I2C_MASTER_VER           0x00000100
+#define MQNIC_RB_I2C_MASTER_REG_STATUS    0x0C
+#define MQNIC_RB_I2C_MASTER_REG_CMD       0x10
+#define MQNIC_RB_I2C_MASTER_REG_DATA      0x14
+#define MQNIC_RB_I2C_MASTER_REG_PRESCALE  0x18
+
+#define MQNIC_I2C_MASTER_STATUS_BUSY        0x00000001
+#define MQNIC_I2C_MASTER_STATUS_MISSED_ACK  0x00000008
+
+#define MQNIC_I2C_MASTER_CMD_ADDR_MASK    0x0000007f
+#define MQNIC_I2C_MASTER_CMD_START        0x00000100
+#define MQNIC_I2C_MASTER_CMD_READ         0x00000200
+#define MQNIC_I2C_MASTER_CMD_WRITE_MULTI  0x00000800
+#define MQNIC_I2C_MASTER_CMD_STOP         0x00001000
+
+#define MQNIC_I2C_MASTER_DATA_MASK   0x000000ff
+#define MQNIC_I2C_MASTER_DATA_VALID  0x00000100
+#define MQNIC_I2C_MASTER_DATA_LAST   0x00000200
+
 #define MQNIC_RB_SPI_FLASH_TYPE        0x0000C120
 #define MQNIC_RB_SPI_FLASH_VER         0x00000200
 #define MQNIC_RB_SPI_FLASH_REG_FORMAT  0x0C
@@ -94,11 +117,17 @@
 
 #define MQNIC_RB_BPI_FLASH_TYPE        0x0000C121
 #define MQNIC_RB_BPI_FLASH_VER         0x00000200
+#define MQNIC_RB_BPI_FLASH_VER_ADDR_INC 0x00000300
 #define MQNIC_RB_BPI_FLASH_REG_FORMAT  0x0C
 #define MQNIC_RB_BPI_FLASH_REG_ADDR    0x10
 #define MQNIC_RB_BPI_FLASH_REG_DATA    0x14
 #define MQNIC_RB_BPI_FLASH_REG_CTRL    0x18
 
+// shift register engine, one block per chip select, index matches CTRL_n;
+// register layout in utils/flash_spi.c
+#define MQNIC_RB_SPI_FLASH_ENGINE_TYPE  0x0000C122
+#define MQNIC_RB_SPI_FLASH_ENGINE_VER   0x00000100
+
 #define MQNIC_RB_ALVEO_BMC_TYPE      0x0000C140
 #define MQNIC_RB_ALVEO_BMC_VER       0x00000100
 #define MQNIC_RB_ALVEO_BMC_REG_ADDR  0x0C
@@ -116,6 +145,15 @@
 #define MQNIC_RB_STATS_REG_COUNT   0x10
 #define MQNIC_RB_STATS_REG_STRIDE  0x14
 #define MQNIC_RB_STATS_REG_FLAGS   0x18
+#define MQNIC_RB_STATS_REG_DMA_CTRL      0x1C
+#define MQNIC_RB_STATS_REG_DMA_INTERVAL  0x20
+#define MQNIC_RB_STATS_REG_DMA_ADDR_L    0x24
+#define MQNIC_RB_STATS_REG_DMA_ADDR_H    0x28
+
+#define MQNIC_RB_STATS_FLAG_DMA  0x00000001
+
+#define MQNIC_RB_STATS_DMA_CTRL_EN      0x00000001
+#define MQNIC_RB_STATS_DMA_CTRL_ACTIVE  0x00000100
 
 #define MQNIC_RB_IRQ_TYPE        0x0000C007
 #define MQNIC_RB_IRQ_VER         0x00000100
@@ -128,6 +166,27 @@
 #define MQNIC_RB_CLK_INFO_CLK_FREQ     0x1C
 #define MQNIC_RB_CLK_INFO_FREQ_BASE    0x20
 
+#define MQNIC_RB_SRIOV_TYPE            0x0000C009
+#define MQNIC_RB_SRIOV_VER             0x00000100
+#define MQNIC_RB_SRIOV_REG_VF_COUNT    0x0C
+#define MQNIC_RB_SRIOV_REG_VF_OFFSET   0x10
+#define MQNIC_RB_SRIOV_REG_VF_STRIDE   0x14
+
+#define MQNIC_SRIOV_VF_REG_CTRL        0x00
+#define MQNIC_SRIOV_VF_REG_EQ_BASE     0x04
+#define MQNIC_SRIOV_VF_REG_EQ_COUNT    0x08
+#define MQNIC_SRIOV_VF_REG_CQ_BASE     0x0C
+#define MQNIC_SRIOV_VF_REG_CQ_COUNT    0x10
+#define MQNIC_SRIOV_VF_REG_TXQ_BASE    0x14
+#define MQNIC_SRIOV_VF_REG_TXQ_COUNT   0x18
+#define MQNIC_SRIOV_VF_REG_RXQ_BASE    0x1C
+#define MQNIC_SRIOV_VF_REG_RXQ_COUNT   0x20
+#define MQNIC_SRIOV_VF_REG_SCHED_PORT  0x24
+#define MQNIC_SRIOV_VF_REG_MAC_L       0x28
+#define MQNIC_SRIOV_VF_REG_MAC_H       0x2C
+
+#define MQNIC_SRIOV_VF_CTRL_EN  (1 << 0)
+
 #define MQNIC_RB_PHC_TYPE                0x0000C080
 #define MQNIC_RB_PHC_VER                 0x00000200
 #define MQNIC_RB_PHC_REG_CTRL            0x0C
@@ -202,6 +261,22 @@
 #define MQNIC_IF_FEATURE_RX_HASH  (1 << 10)
 #define MQNIC_IF_FEATURE_LFC      (1 << 11)
 #define MQNIC_IF_FEATURE_PFC      (1 << 12)
+#define MQNIC_IF_FEATURE_CQ_HOLDOFF  (1 << 13)
+#define MQNIC_IF_FEATURE_TSO      (1 << 14)
+#define MQNIC_IF_FEATURE_CPL_IN_ORDER  (1 << 15)
+#define MQNIC_IF_FEATURE_TX_LAUNCH_TIME  (1 << 16)
+#define MQNIC_IF_FEATURE_TX_DESC_PUSH  (1 << 17)
+#define MQNIC_IF_FEATURE_SHARED_CQ  (1 << 18)
+#define MQNIC_IF_FEATURE_PTR_SHADOW  (1 << 19)
+#define MQNIC_IF_FEATURE_VLAN_TX  (1 << 20)
+#define MQNIC_IF_FEATURE_VLAN_RX  (1 << 21)
+#define MQNIC_IF_FEATURE_TX_CSUM_EXT  (1 << 22)
+#define MQNIC_IF_FEATURE_TSO_TUNNEL  (1 << 23)
+#define MQNIC_IF_FEATURE_USO  (1 << 24)
+#define MQNIC_IF_FEATURE_RX_HDR_SPLIT  (1 << 25)
+#define MQNIC_IF_FEATURE_PTP_CLASSIFY  (1 << 26)
+#define MQNIC_IF_FEATURE_PTP_ONESTEP  (1 << 27)
+#define MQNIC_IF_FEATURE_RX_CAPTURE  (1 << 28)
 
 #define MQNIC_RB_RX_QUEUE_MAP_TYPE             0x0000C090
 #define MQNIC_RB_RX_QUEUE_MAP_VER              0x00000200
@@ -211,6 +286,97 @@
 #define MQNIC_RB_RX_QUEUE_MAP_CH_REG_OFFSET    0x00
 #define MQNIC_RB_RX_QUEUE_MAP_CH_REG_RSS_MASK  0x04
 #define MQNIC_RB_RX_QUEUE_MAP_CH_REG_APP_MASK  0x08
+#define MQNIC_RB_RX_QUEUE_MAP_CH_REG_PTP_QUEUE 0x0C
+
+// with MQNIC_IF_FEATURE_PTP_CLASSIFY, PTP event frames bypass RSS and go to
+// the queue in the low bits of the channel PTP_QUEUE register while it is
+// enabled
+#define MQNIC_RX_QUEUE_MAP_PTP_QUEUE_MASK    0x00ffffff
+#define MQNIC_RX_QUEUE_MAP_PTP_QUEUE_ENABLE  0x80000000
+
+#define MQNIC_RB_RX_HASH_TYPE     0x0000C091
+#define MQNIC_RB_RX_HASH_VER      0x00000100
+#define MQNIC_RB_RX_HASH_REG_KEY  0x10
+
+#define MQNIC_RX_HASH_KEY_SIZE 40
+
+#define MQNIC_RX_HASH_TYPE_IPV4  (1 << 0)
+#define MQNIC_RX_HASH_TYPE_IPV6  (1 << 1)
+#define MQNIC_RX_HASH_TYPE_TCP   (1 << 2)
+#define MQNIC_RX_HASH_TYPE_UDP   (1 << 3)
+
+#define MQNIC_RB_RX_FLOW_TABLE_TYPE          0x0000C092
+#define MQNIC_RB_RX_FLOW_TABLE_VER           0x00000100
+#define MQNIC_RB_RX_FLOW_TABLE_REG_CFG       0x0C
+#define MQNIC_RB_RX_FLOW_TABLE_REG_INDEX     0x10
+#define MQNIC_RB_RX_FLOW_TABLE_REG_SRC_IP    0x14
+#define MQNIC_RB_RX_FLOW_TABLE_REG_DST_IP    0x18
+#define MQNIC_RB_RX_FLOW_TABLE_REG_PORTS     0x1C
+#define MQNIC_RB_RX_FLOW_TABLE_REG_QUEUE     0x20
+#define MQNIC_RB_RX_FLOW_TABLE_REG_CTRL      0x24
+
+#define MQNIC_RX_FLOW_CTRL_PROTO_MASK  0x000000ff
+#define MQNIC_RX_FLOW_CTRL_PORT_SHIFT  8
+#define MQNIC_RX_FLOW_CTRL_PORT_MASK   0x0000ff00
+#define MQNIC_RX_FLOW_CTRL_ENABLE      0x80000000
+
+#define MQNIC_RB_RX_L2_TABLE_TYPE        0x0000C093
+#define MQNIC_RB_RX_L2_TABLE_VER         0x00000100
+#define MQNIC_RB_RX_L2_TABLE_REG_CFG     0x0C
+#define MQNIC_RB_RX_L2_TABLE_REG_INDEX   0x10
+#define MQNIC_RB_RX_L2_TABLE_REG_MAC_L   0x14
+#define MQNIC_RB_RX_L2_TABLE_REG_MAC_H   0x18
+#define MQNIC_RB_RX_L2_TABLE_REG_VLAN    0x1C
+#define MQNIC_RB_RX_L2_TABLE_REG_QUEUE   0x20
+#define MQNIC_RB_RX_L2_TABLE_REG_CTRL    0x24
+
+#define MQNIC_RX_L2_VLAN_VID_MASK     0x00000fff
+#define MQNIC_RX_L2_VLAN_MATCH        0x80000000
+#define MQNIC_RX_L2_CTRL_PORT_SHIFT   8
+#define MQNIC_RX_L2_CTRL_PORT_MASK    0x0000ff00
+#define MQNIC_RX_L2_CTRL_LOG_QUEUES_SHIFT  16
+#define MQNIC_RX_L2_CTRL_LOG_QUEUES_MASK   0x000f0000
+#define MQNIC_RX_L2_CTRL_ENABLE       0x80000000
+
+// packet capture: a frame that arrives on a port in the PORT_MASK of an
+// enabled rule and whose bytes OFFSET to OFFSET+15 (counted from the start
+// of the Ethernet header) equal MATCH under MASK is also copied to QUEUE,
+// cut to SNAPLEN bytes when that is nonzero.  The lowest matching rule
+// wins, and the original frame carries on to the flow tables and RSS.  CFG
+// holds the rule count in bits 7:0, the match window size in bytes in 15:8
+// and the largest OFFSET in 31:16; the CTRL write commits the rule at INDEX
+#define MQNIC_RB_RX_CAPTURE_TYPE          0x0000C094
+#define MQNIC_RB_RX_CAPTURE_VER           0x00000100
+#define MQNIC_RB_RX_CAPTURE_REG_CFG       0x0C
+#define MQNIC_RB_RX_CAPTURE_REG_INDEX     0x10
+#define MQNIC_RB_RX_CAPTURE_REG_QUEUE     0x14
+#define MQNIC_RB_RX_CAPTURE_REG_SNAPLEN   0x18
+#define MQNIC_RB_RX_CAPTURE_REG_OFFSET    0x1C
+#define MQNIC_RB_RX_CAPTURE_REG_MATCH     0x20
+#define MQNIC_RB_RX_CAPTURE_REG_MASK      0x30
+#define MQNIC_RB_RX_CAPTURE_REG_CTRL      0x40
+
+// match and mask words hold window bytes 4k to 4k+3, first byte lowest
+#define MQNIC_RX_CAPTURE_MATCH_SIZE       16
+
+#define MQNIC_RX_CAPTURE_CTRL_PORT_MASK   0x0000ffff
+#define MQNIC_RX_CAPTURE_CTRL_ENABLE      0x80000000
+
+// link aggregation: with EN set, frames for any port in MEMBERS leave on a
+// port in ACTIVE picked by the flow hash, or the lowest one in active-backup
+// mode; a member whose link is down is skipped without waiting for ACTIVE
+#define MQNIC_RB_LAG_TYPE         0x0000C0A0
+#define MQNIC_RB_LAG_VER          0x00000100
+#define MQNIC_RB_LAG_REG_CTRL     0x0C
+#define MQNIC_RB_LAG_REG_MEMBERS  0x10
+#define MQNIC_RB_LAG_REG_ACTIVE   0x14
+
+#define MQNIC_LAG_CTRL_EN                 (1 << 0)
+#define MQNIC_LAG_CTRL_MODE_HASH          (0 << 4)
+#define MQNIC_LAG_CTRL_MODE_ACTIVE_BACKUP (1 << 4)
+#define MQNIC_LAG_CTRL_HASH_L2            (0 << 8)
+#define MQNIC_LAG_CTRL_HASH_L23           (1 << 8)
+#define MQNIC_LAG_CTRL_HASH_L34           (2 << 8)
 
 #define MQNIC_RB_EQM_TYPE        0x0000C010
 #define MQNIC_RB_EQM_VER         0x00000400
@@ -236,6 +402,15 @@
 #define MQNIC_RB_RX_QM_REG_COUNT   0x10
 #define MQNIC_RB_RX_QM_REG_STRIDE  0x14
 
+// per-TXQ windows; a descriptor block (plus optional leading packet bytes)
+// written to the slot for its ring index spares the descriptor fetch
+#define MQNIC_RB_TX_PUSH_TYPE            0x0000C032
+#define MQNIC_RB_TX_PUSH_VER             0x00000100
+#define MQNIC_RB_TX_PUSH_REG_OFFSET      0x0C
+#define MQNIC_RB_TX_PUSH_REG_COUNT       0x10
+#define MQNIC_RB_TX_PUSH_REG_STRIDE      0x14
+#define MQNIC_RB_TX_PUSH_REG_SLOT_SIZE   0x18
+
 #define MQNIC_RB_PORT_TYPE        0x0000C002
 #define MQNIC_RB_PORT_VER         0x00000200
 #define MQNIC_RB_PORT_REG_OFFSET  0x0C
@@ -255,12 +430,16 @@
 #define MQNIC_RB_PORT_CTRL_REG_PFC_CTRL5  0x34
 #define MQNIC_RB_PORT_CTRL_REG_PFC_CTRL6  0x38
 #define MQNIC_RB_PORT_CTRL_REG_PFC_CTRL7  0x3C
+#define MQNIC_RB_PORT_CTRL_REG_EVENT_CTRL 0x40
 
 #define MQNIC_PORT_FEATURE_LFC           (1 << 0)
 #define MQNIC_PORT_FEATURE_PFC           (1 << 1)
 #define MQNIC_PORT_FEATURE_INT_MAC_CTRL  (1 << 2)
+#define MQNIC_PORT_FEATURE_LOOPBACK      (1 << 3)
+#define MQNIC_PORT_FEATURE_LINK_EVENT    (1 << 4)
 
 #define MQNIC_PORT_TX_CTRL_EN            (1 << 0)
+#define MQNIC_PORT_TX_CTRL_LOOPBACK      (1 << 4)
 #define MQNIC_PORT_TX_CTRL_PAUSE         (1 << 8)
 #define MQNIC_PORT_TX_CTRL_STATUS        (1 << 16)
 #define MQNIC_PORT_TX_CTRL_RESET         (1 << 17)
@@ -284,6 +463,10 @@
 #define MQNIC_PORT_PFC_CTRL_TX_PFC_REQ   (1 << 28)
 #define MQNIC_PORT_PFC_CTRL_RX_PFC_REQ   (1 << 29)
 
+// status change events go to EQ [15:0] of the interface
+#define MQNIC_PORT_EVENT_CTRL_EQN_MASK   0x0000ffff
+#define MQNIC_PORT_EVENT_CTRL_EN         (1 << 31)
+
 #define MQNIC_RB_SCHED_BLOCK_TYPE        0x0000C004
 #define MQNIC_RB_SCHED_BLOCK_VER         0x00000300
 #define MQNIC_RB_SCHED_BLOCK_REG_OFFSET  0x0C
@@ -319,6 +502,22 @@
 #define MQNIC_SCHED_RR_CMD_SET_PORT_PAUSE    0x80030000
 #define MQNIC_SCHED_RR_CMD_SET_QUEUE_ENABLE  0x40000100
 #define MQNIC_SCHED_RR_CMD_SET_QUEUE_PAUSE   0x40000200
+#define MQNIC_SCHED_RR_CMD_SET_QUEUE_WEIGHT  0x40000300
+
+// CFG: deficit weighted round robin between queues; each round a queue is
+// credited its weight (1-255) times the FC scale in bytes, and is served
+// while its deficit is positive
+#define MQNIC_SCHED_RR_CFG_DWRR  (1 << 24)
+
+#define MQNIC_SCHED_RR_WEIGHT_MAX  255
+
+#define MQNIC_RB_SCHED_RL_TYPE          0x0000C041
+#define MQNIC_RB_SCHED_RL_VER           0x00000100
+#define MQNIC_RB_SCHED_RL_REG_INDEX     0x0C
+#define MQNIC_RB_SCHED_RL_REG_BURST     0x10
+#define MQNIC_RB_SCHED_RL_REG_RATE      0x14
+
+#define MQNIC_SCHED_RL_INDEX_CHANNEL  0x80000000
 
 #define MQNIC_RB_SCHED_CTRL_TDMA_TYPE           0x0000C050
 #define MQNIC_RB_SCHED_CTRL_TDMA_VER            0x00000100
@@ -329,7 +528,8 @@
 #define MQNIC_RB_SCHED_CTRL_TDMA_REG_TS_COUNT   0x1C
 
 #define MQNIC_RB_TDMA_SCH_TYPE                     0x0000C060
-#define MQNIC_RB_TDMA_SCH_VER                      0x00000200
+#define MQNIC_RB_TDMA_SCH_VER                      0x00000300
+#define MQNIC_RB_TDMA_SCH_VER_STAGED               0x00000300
 #define MQNIC_RB_TDMA_SCH_REG_CTRL                 0x0C
 #define MQNIC_RB_TDMA_SCH_REG_SCH_START_FNS        0x10
 #define MQNIC_RB_TDMA_SCH_REG_SCH_START_NS         0x14
@@ -339,6 +539,21 @@
 #define MQNIC_RB_TDMA_SCH_REG_SCH_PERIOD_NS        0x24
 #define MQNIC_RB_TDMA_SCH_REG_TS_PERIOD_NS         0x28
 #define MQNIC_RB_TDMA_SCH_REG_ACTIVE_PERIOD_NS     0x2C
+// staged schedule and commit, from MQNIC_RB_TDMA_SCH_VER_STAGED
+#define MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_NS     0x30
+#define MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_SEC_L  0x34
+#define MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_SEC_H  0x38
+#define MQNIC_RB_TDMA_SCH_REG_STG_SCH_PERIOD_NS    0x3C
+#define MQNIC_RB_TDMA_SCH_REG_STG_TS_PERIOD_NS     0x40
+#define MQNIC_RB_TDMA_SCH_REG_STG_ACTIVE_PERIOD_NS 0x44
+#define MQNIC_RB_TDMA_SCH_REG_COMMIT_NS            0x48
+#define MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_L         0x4C
+#define MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_H         0x50
+#define MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL          0x54
+
+#define MQNIC_TDMA_SCH_COMMIT_ARM      (1 << 0)
+#define MQNIC_TDMA_SCH_COMMIT_CANCEL   (1 << 1)
+#define MQNIC_TDMA_SCH_COMMIT_PENDING  (1 << 0)
 
 #define MQNIC_RB_APP_INFO_TYPE    0x0000C005
 #define MQNIC_RB_APP_INFO_VER     0x00000200
@@ -350,6 +565,7 @@
 #define MQNIC_QUEUE_PTR_REG           0x10
 #define MQNIC_QUEUE_PROD_PTR_REG      0x10
 #define MQNIC_QUEUE_CONS_PTR_REG      0x12
+#define MQNIC_QUEUE_SHADOW_ADDR_REG   0x18
 
 #define MQNIC_QUEUE_ENABLE_MASK  0x00000001
 #define MQNIC_QUEUE_ACTIVE_MASK  0x00000008
@@ -367,11 +583,13 @@
 #define MQNIC_CQ_PTR_REG           0x0C
 #define MQNIC_CQ_PROD_PTR_REG      0x0C
 #define MQNIC_CQ_CONS_PTR_REG      0x0E
+#define MQNIC_CQ_SHADOW_ADDR_REG   0x10
 
 #define MQNIC_CQ_ENABLE_MASK  0x00010000
 #define MQNIC_CQ_ARM_MASK     0x00020000
 #define MQNIC_CQ_ACTIVE_MASK  0x00080000
 #define MQNIC_CQ_PTR_MASK     0xFFFF
+#define MQNIC_CQ_HOLDOFF_MASK 0xFFFF
 
 #define MQNIC_CQ_CMD_SET_VF_ID         0x80010000
 #define MQNIC_CQ_CMD_SET_SIZE          0x80020000
@@ -381,12 +599,15 @@
 #define MQNIC_CQ_CMD_SET_CONS_PTR_ARM  0x80910000
 #define MQNIC_CQ_CMD_SET_ENABLE        0x40000100
 #define MQNIC_CQ_CMD_SET_ARM           0x40000200
+#define MQNIC_CQ_CMD_SET_HOLDOFF_USECS   0x80A00000
+#define MQNIC_CQ_CMD_SET_HOLDOFF_FRAMES  0x80A10000
 
 #define MQNIC_EQ_BASE_ADDR_VF_REG  0x00
 #define MQNIC_EQ_CTRL_STATUS_REG   0x08
 #define MQNIC_EQ_PTR_REG           0x0C
 #define MQNIC_EQ_PROD_PTR_REG      0x0C
 #define MQNIC_EQ_CONS_PTR_REG      0x0E
+#define MQNIC_EQ_SHADOW_ADDR_REG   0x10
 
 #define MQNIC_EQ_ENABLE_MASK  0x00010000
 #define MQNIC_EQ_ARM_MASK     0x00020000
@@ -403,20 +624,99 @@
 #define MQNIC_EQ_CMD_SET_ARM           0x40000200
 
 #define MQNIC_EVENT_TYPE_CPL 0x0000
+// source is the port index within the interface
+#define MQNIC_EVENT_TYPE_PORT_STATUS 0x0001
 
 #define MQNIC_DESC_SIZE 16
 #define MQNIC_CPL_SIZE 32
 #define MQNIC_EVENT_SIZE 32
 
+// cpl src, only valid on a CQ shared between a TX and an RX queue
+#define MQNIC_CPL_SRC_TX 0x01
+
+// SHADOW_ADDR (64 bit, high word first): with the enable bit set, the
+// hardware DMA-writes the PTR register value of the queue to this 8 byte
+// aligned host address on enable and whenever it changes
+#define MQNIC_SHADOW_ADDR_ENABLE 0x00000001
+
+#define MQNIC_TX_CSUM_CMD_ENABLE  0x8000
+
+// with MQNIC_IF_FEATURE_TX_CSUM_EXT, csum_cmd counts in 16-bit words: the
+// checksum start in bits 9:0 and the offset of the field from it in 14:10
+#define MQNIC_TX_CSUM_EXT_START_MAX   2046
+#define MQNIC_TX_CSUM_EXT_OFFSET_MAX  62
+#define MQNIC_TX_CSUM_EXT_OFFSET_SHIFT  10
+
+// with MQNIC_IF_FEATURE_TSO_TUNNEL, TSO also takes VXLAN and Geneve over
+// UDP: headers up to the inner TCP header are replicated, and the outer IP
+// length and ID and the outer UDP length are fixed up with a zero checksum
+
+// with MQNIC_IF_FEATURE_USO, a tso_mss on a UDP frame splits it into
+// datagrams of that payload size; headers up to the UDP header are
+// replicated, the IP and UDP lengths are fixed up per segment and the UDP
+// checksum is filled in by the checksum command, as for TCP
+
+// launch time word, carried in the second descriptor of a TX block
+#define MQNIC_TX_LAUNCH_TIME_ENABLE   0x80000000
+#define MQNIC_TX_LAUNCH_TIME_SEC_LSB  0x40000000
+#define MQNIC_TX_LAUNCH_TIME_NS_MASK  0x3fffffff
+#define MQNIC_TX_TSO_MAX_HDR_LEN  256
+
+// VLAN insert word, carried in the third descriptor of a TX block; the tag
+// goes in after the source MAC and checksum offsets in csum_cmd refer to
+// the frame as posted, before insertion
+#define MQNIC_TX_VLAN_CMD_INSERT  0x8000
+
+// with MQNIC_IF_FEATURE_PTP_ONESTEP, one-step timestamp word, carried in the
+// fourth descriptor of a TX block: ts_offset is the byte offset of a PTP
+// header in the frame as posted, and ts_cmd with the insert bit set has the
+// MAC write the departure time into its originTimestamp.  Bits 9:0 of
+// ts_cmd give the offset of the UDP checksum in 16-bit words, or zero for
+// none; the MAC adjusts that checksum for the inserted bytes, so the
+// originTimestamp field must be posted zeroed
+#define MQNIC_TX_TS_CMD_INSERT     0x8000
+#define MQNIC_TX_TS_CMD_CSUM_MASK  0x03ff
+
+// cpl rx_flags: an 802.1Q tag was stripped and is in rx_vlan_tci; rx_csum
+// and rx_hash cover the frame as delivered, with the tag removed
+#define MQNIC_CPL_RX_FLAG_VLAN  0x01
+// with MQNIC_IF_FEATURE_PTP_CLASSIFY: the frame is a PTPv2 event message
+// (Sync, Delay_Req, Pdelay_Req or Pdelay_Resp) over Ethernet, ethertype
+// 0x88f7, or over UDP port 319 on IPv4 or IPv6
+#define MQNIC_CPL_RX_FLAG_PTP_EVENT  0x02
+// with MQNIC_IF_FEATURE_RX_CAPTURE: the frame is a capture copy, len is the
+// number of bytes captured and rx_orig_len the length on the wire; capture
+// copies are never split
+#define MQNIC_CPL_RX_FLAG_CAPTURE  0x04
+
+// with MQNIC_IF_FEATURE_RX_HDR_SPLIT, split_cmd in the first descriptor of
+// an RX block makes its buffer a header buffer: a frame parsed up to a TCP
+// or UDP header has its headers placed there and its payload from the
+// second buffer on, with the header length in cpl rx_hdr_len; any other
+// frame fills the buffers in order and reports an rx_hdr_len of zero
+#define MQNIC_RX_SPLIT_CMD_ENABLE  0x8000
+
 struct mqnic_desc {
-	__le16 rsvd0;
 	union {
 		struct {
+			__le16 tso_mss;
 			__le16 csum_cmd;
 		} tx;
 		struct {
 			__le16 rsvd0;
+			__le16 split_cmd;
 		} rx;
+		struct {
+			__le32 launch_time;
+		} tx_time;
+		struct {
+			__le16 vlan_tci;
+			__le16 vlan_cmd;
+		} tx_vlan;
+		struct {
+			__le16 ts_offset;
+			__le16 ts_cmd;
+		} tx_ts;
 	};
 	__le32 len;
 	__le64 addr;
@@ -433,12 +733,33 @@ struct mqnic_cpl {
 	__le32 rx_hash;
 	__u8 rx_hash_type;
 	__u8 port;
-	__u8 rsvd2;
-	__u8 rsvd3;
-	__le32 rsvd4;
+	__u8 src;
+	__u8 rx_flags;
+	__le16 rx_vlan_tci;
+	union {
+		__le16 rx_hdr_len;
+		__le16 rx_orig_len;
+	};
 	__le32 phase;
 };
 
+// pointer write-back slot; ptr is written by the hardware, flags by the driver
+struct mqnic_ptr_shadow {
+	__le32 ptr;
+	__le32 flags;
+};
+
+#define MQNIC_PTR_SHADOW_FLAG_VALID 0x00000001
+
+// statistics write-back buffer; the counters follow the header as __le64,
+// then a __le32 copy of gen written last in each pass
+struct mqnic_stats_dma_hdr {
+	__le32 gen;
+	__le32 count;
+};
+
+#define MQNIC_STATS_DMA_SIZE(count) (sizeof(struct mqnic_stats_dma_hdr) + (count)*8 + 8)
+
 struct mqnic_event {
 	__le16 type;
 	__le16 source;
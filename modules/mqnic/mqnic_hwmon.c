@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#ifdef MQNIC_HWMON
+
+/*
+ * Board sensors through hwmon.
+ *
+ * The Alveo CMS keeps a max, average and instantaneous word for every
+ * sensor in its register map, behind the address/data window of the BMC
+ * register block.  One refresh walks every present sensor and reads all
+ * three words with the window held, and sysfs reads are served from that
+ * snapshot until it is older than update_interval, so a telemetry agent
+ * reading every attribute costs one sweep per interval.
+ *
+ * The window completes each read in the AXI-lite latency of the CMS and
+ * has no interrupt; nothing here sleeps or polls on it.
+ */
+
+#define MQNIC_ALVEO_CMS_SENSOR_BASE 0x028000
+
+struct mqnic_hwmon_sensor {
+	u32 reg;
+	enum hwmon_sensor_types type;
+	const char *label;
+};
+
+// grouped by type, channels are numbered in table order within a type
+static const struct mqnic_hwmon_sensor mqnic_alveo_cms_sensors[] = {
+	{0x00F8, hwmon_temp, "FPGA_TEMP"},
+	{0x0104, hwmon_temp, "FAN_TEMP"},
+	{0x0110, hwmon_temp, "DIMM_TEMP0"},
+	{0x011C, hwmon_temp, "DIMM_TEMP1"},
+	{0x0128, hwmon_temp, "DIMM_TEMP2"},
+	{0x0134, hwmon_temp, "DIMM_TEMP3"},
+	{0x0140, hwmon_temp, "SE98_TEMP0"},
+	{0x014C, hwmon_temp, "SE98_TEMP1"},
+	{0x0158, hwmon_temp, "SE98_TEMP2"},
+	{0x0170, hwmon_temp, "CAGE_TEMP0"},
+	{0x017C, hwmon_temp, "CAGE_TEMP1"},
+	{0x0188, hwmon_temp, "CAGE_TEMP2"},
+	{0x0194, hwmon_temp, "CAGE_TEMP3"},
+	{0x0260, hwmon_temp, "HBM_TEMP1"},
+	{0x02B4, hwmon_temp, "HBM_TEMP2"},
+	{0x02CC, hwmon_temp, "VCCINT_TEMP"},
+	{0x0020, hwmon_in, "12V_PEX"},
+	{0x002C, hwmon_in, "3V3_PEX"},
+	{0x0038, hwmon_in, "3V3_AUX"},
+	{0x0044, hwmon_in, "12V_AUX"},
+	{0x0050, hwmon_in, "DDR4_VPP_BTM"},
+	{0x005C, hwmon_in, "SYS_5V5"},
+	{0x0068, hwmon_in, "VCC1V2_TOP"},
+	{0x0074, hwmon_in, "VCC1V8"},
+	{0x0080, hwmon_in, "VCC0V85"},
+	{0x008C, hwmon_in, "DDR4_VPP_TOP"},
+	{0x0098, hwmon_in, "MGT0V9AVCC"},
+	{0x00A4, hwmon_in, "12VSW"},
+	{0x00B0, hwmon_in, "MGTAVTT"},
+	{0x00BC, hwmon_in, "VCC1V2_BTM"},
+	{0x00E0, hwmon_in, "VCCINT"},
+	{0x026C, hwmon_in, "VCC3V3"},
+	{0x0290, hwmon_in, "HBM_1V2"},
+	{0x029C, hwmon_in, "VPP2V5"},
+	{0x02A8, hwmon_in, "VCCINT_BRAM"},
+	{0x02C0, hwmon_in, "12V_AUX1"},
+	{0x0344, hwmon_in, "VCCAUX"},
+	{0x0350, hwmon_in, "VCCAUX_PMC"},
+	{0x035C, hwmon_in, "VCCRAM"},
+	{0x00C8, hwmon_curr, "12VPEX_I_IN"},
+	{0x00D4, hwmon_curr, "12V_AUX_I_IN"},
+	{0x00EC, hwmon_curr, "VCCINT_I"},
+	{0x0278, hwmon_curr, "3V3_PEX_I_IN"},
+	{0x0284, hwmon_curr, "VCC0V85_I"},
+	{0x02F0, hwmon_curr, "AUX_3V3_I"},
+	{0x0314, hwmon_curr, "VCC1V2_I"},
+	{0x0320, hwmon_curr, "V12_IN_I"},
+	{0x032C, hwmon_curr, "V12_IN_AUX0_I"},
+	{0x0338, hwmon_curr, "V12_IN_AUX1_I"},
+	{0x02D8, hwmon_power, "PEX_12V_POWER"},
+	{0x02E4, hwmon_power, "PEX_3V3_POWER"},
+	{0x0164, hwmon_fan, "FAN_SPEED"},
+};
+
+#define MQNIC_HWMON_SENSOR_COUNT ARRAY_SIZE(mqnic_alveo_cms_sensors)
+
+// chip, temp, in, curr, power, fan
+#define MQNIC_HWMON_INFO_COUNT 6
+
+enum {
+	MQNIC_HWMON_MAX,
+	MQNIC_HWMON_AVG,
+	MQNIC_HWMON_INS,
+};
+
+struct mqnic_hwmon {
+	struct mqnic_dev *mqnic;
+	struct mqnic_reg_block *rb;
+	struct device *hwmon_dev;
+
+	const struct mqnic_hwmon_sensor *sensors;
+	int first[hwmon_max];
+	int count[hwmon_max];
+
+	struct mutex lock;
+	unsigned long last_update;
+	bool valid;
+	unsigned int update_interval_ms;
+	bool present[MQNIC_HWMON_SENSOR_COUNT];
+	u32 val[MQNIC_HWMON_SENSOR_COUNT][3];
+
+	u32 config[MQNIC_HWMON_INFO_COUNT][MQNIC_HWMON_SENSOR_COUNT + 1];
+	struct hwmon_channel_info info[MQNIC_HWMON_INFO_COUNT];
+	const struct hwmon_channel_info *info_list[MQNIC_HWMON_INFO_COUNT + 1];
+	struct hwmon_chip_info chip;
+};
+
+// caller holds hwmon->lock
+static void mqnic_hwmon_refresh(struct mqnic_hwmon *hwmon, bool all)
+{
+	u32 reg;
+	int k;
+
+	if (hwmon->valid && time_before(jiffies, hwmon->last_update +
+			msecs_to_jiffies(hwmon->update_interval_ms)))
+		return;
+
+	for (k = 0; k < MQNIC_HWMON_SENSOR_COUNT; k++) {
+		if (!all && !hwmon->present[k])
+			continue;
+
+		reg = MQNIC_ALVEO_CMS_SENSOR_BASE + hwmon->sensors[k].reg;
+
+		hwmon->val[k][MQNIC_HWMON_MAX] = mqnic_alveo_bmc_reg_read(hwmon->mqnic, hwmon->rb, reg);
+		hwmon->val[k][MQNIC_HWMON_AVG] = mqnic_alveo_bmc_reg_read(hwmon->mqnic, hwmon->rb, reg + 4);
+		hwmon->val[k][MQNIC_HWMON_INS] = mqnic_alveo_bmc_reg_read(hwmon->mqnic, hwmon->rb, reg + 8);
+	}
+
+	hwmon->last_update = jiffies;
+	hwmon->valid = true;
+}
+
+static int mqnic_hwmon_index(struct mqnic_hwmon *hwmon, enum hwmon_sensor_types type, int channel)
+{
+	if (type >= hwmon_max || channel >= hwmon->count[type])
+		return -1;
+
+	return hwmon->first[type] + channel;
+}
+
+static umode_t mqnic_hwmon_is_visible(const void *data, enum hwmon_sensor_types type,
+		u32 attr, int channel)
+{
+	const struct mqnic_hwmon *hwmon = data;
+
+	if (type == hwmon_chip)
+		return attr == hwmon_chip_update_interval ? 0644 : 0;
+
+	if (type >= hwmon_max || channel >= hwmon->count[type])
+		return 0;
+
+	// sensors the board does not have read back as all zero
+	if (!hwmon->present[hwmon->first[type] + channel])
+		return 0;
+
+	return 0444;
+}
+
+static int mqnic_hwmon_read(struct device *dev, enum hwmon_sensor_types type,
+		u32 attr, int channel, long *val)
+{
+	struct mqnic_hwmon *hwmon = dev_get_drvdata(dev);
+	int word = MQNIC_HWMON_INS;
+	long scale = 1;
+	int index;
+
+	if (type == hwmon_chip) {
+		if (attr != hwmon_chip_update_interval)
+			return -EOPNOTSUPP;
+		*val = hwmon->update_interval_ms;
+		return 0;
+	}
+
+	index = mqnic_hwmon_index(hwmon, type, channel);
+	if (index < 0)
+		return -EOPNOTSUPP;
+
+	switch (type) {
+	case hwmon_temp:
+		// CMS reports degrees C
+		scale = 1000;
+		if (attr == hwmon_temp_highest)
+			word = MQNIC_HWMON_MAX;
+		else if (attr != hwmon_temp_input)
+			return -EOPNOTSUPP;
+		break;
+	case hwmon_in:
+		if (attr == hwmon_in_highest)
+			word = MQNIC_HWMON_MAX;
+		else if (attr == hwmon_in_average)
+			word = MQNIC_HWMON_AVG;
+		else if (attr != hwmon_in_input)
+			return -EOPNOTSUPP;
+		break;
+	case hwmon_curr:
+		if (attr == hwmon_curr_highest)
+			word = MQNIC_HWMON_MAX;
+		else if (attr == hwmon_curr_average)
+			word = MQNIC_HWMON_AVG;
+		else if (attr != hwmon_curr_input)
+			return -EOPNOTSUPP;
+		break;
+	case hwmon_power:
+		// CMS reports mW
+		scale = 1000;
+		if (attr == hwmon_power_input_highest)
+			word = MQNIC_HWMON_MAX;
+		else if (attr == hwmon_power_average)
+			word = MQNIC_HWMON_AVG;
+		else if (attr != hwmon_power_input)
+			return -EOPNOTSUPP;
+		break;
+	case hwmon_fan:
+		if (attr != hwmon_fan_input)
+			return -EOPNOTSUPP;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	mutex_lock(&hwmon->lock);
+	mqnic_hwmon_refresh(hwmon, false);
+	*val = (long)hwmon->val[index][word] * scale;
+	mutex_unlock(&hwmon->lock);
+
+	return 0;
+}
+
+static int mqnic_hwmon_read_string(struct device *dev, enum hwmon_sensor_types type,
+		u32 attr, int channel, const char **str)
+{
+	struct mqnic_hwmon *hwmon = dev_get_drvdata(dev);
+	int index;
+
+	index = mqnic_hwmon_index(hwmon, type, channel);
+	if (index < 0)
+		return -EOPNOTSUPP;
+
+	*str = hwmon->sensors[index].label;
+
+	return 0;
+}
+
+static int mqnic_hwmon_write(struct device *dev, enum hwmon_sensor_types type,
+		u32 attr, int channel, long val)
+{
+	struct mqnic_hwmon *hwmon = dev_get_drvdata(dev);
+
+	if (type != hwmon_chip || attr != hwmon_chip_update_interval)
+		return -EOPNOTSUPP;
+
+	mutex_lock(&hwmon->lock);
+	hwmon->update_interval_ms = clamp_val(val, 100, 60000);
+	mutex_unlock(&hwmon->lock);
+
+	return 0;
+}
+
+static const struct hwmon_ops mqnic_hwmon_ops = {
+	.is_visible = mqnic_hwmon_is_visible,
+	.read = mqnic_hwmon_read,
+	.read_string = mqnic_hwmon_read_string,
+	.write = mqnic_hwmon_write,
+};
+
+static void mqnic_hwmon_add_info(struct mqnic_hwmon *hwmon, int *n,
+		enum hwmon_sensor_types type, u32 config, int count)
+{
+	int k;
+
+	if (!count)
+		return;
+
+	for (k = 0; k < count; k++)
+		hwmon->config[*n][k] = config;
+	hwmon->config[*n][count] = 0;
+
+	hwmon->info[*n].type = type;
+	hwmon->info[*n].config = hwmon->config[*n];
+	hwmon->info_list[*n] = &hwmon->info[*n];
+	(*n)++;
+}
+
+int mqnic_hwmon_alveo_register(struct mqnic_dev *mqnic, struct mqnic_reg_block *rb)
+{
+	struct mqnic_hwmon *hwmon;
+	struct device *hwmon_dev;
+	enum hwmon_sensor_types type;
+	int n = 0;
+	int k;
+
+	hwmon = kzalloc(sizeof(*hwmon), GFP_KERNEL);
+	if (!hwmon)
+		return -ENOMEM;
+
+	hwmon->mqnic = mqnic;
+	hwmon->rb = rb;
+	hwmon->sensors = mqnic_alveo_cms_sensors;
+	hwmon->update_interval_ms = MQNIC_HWMON_UPDATE_INTERVAL_MS;
+	mutex_init(&hwmon->lock);
+
+	for (k = MQNIC_HWMON_SENSOR_COUNT - 1; k >= 0; k--) {
+		type = hwmon->sensors[k].type;
+		hwmon->first[type] = k;
+		hwmon->count[type]++;
+	}
+
+	// one full sweep finds the sensors this board has
+	mqnic_hwmon_refresh(hwmon, true);
+
+	for (k = 0; k < MQNIC_HWMON_SENSOR_COUNT; k++)
+		hwmon->present[k] = hwmon->val[k][MQNIC_HWMON_MAX] ||
+			hwmon->val[k][MQNIC_HWMON_AVG] || hwmon->val[k][MQNIC_HWMON_INS];
+
+	mqnic_hwmon_add_info(hwmon, &n, hwmon_chip, HWMON_C_UPDATE_INTERVAL, 1);
+	mqnic_hwmon_add_info(hwmon, &n, hwmon_temp,
+			HWMON_T_INPUT | HWMON_T_HIGHEST | HWMON_T_LABEL,
+			hwmon->count[hwmon_temp]);
+	mqnic_hwmon_add_info(hwmon, &n, hwmon_in,
+			HWMON_I_INPUT | HWMON_I_HIGHEST | HWMON_I_AVERAGE | HWMON_I_LABEL,
+			hwmon->count[hwmon_in]);
+	mqnic_hwmon_add_info(hwmon, &n, hwmon_curr,
+			HWMON_C_INPUT | HWMON_C_HIGHEST | HWMON_C_AVERAGE | HWMON_C_LABEL,
+			hwmon->count[hwmon_curr]);
+	mqnic_hwmon_add_info(hwmon, &n, hwmon_power,
+			HWMON_P_INPUT | HWMON_P_INPUT_HIGHEST | HWMON_P_AVERAGE | HWMON_P_LABEL,
+			hwmon->count[hwmon_power]);
+	mqnic_hwmon_add_info(hwmon, &n, hwmon_fan,
+			HWMON_F_INPUT | HWMON_F_LABEL,
+			hwmon->count[hwmon_fan]);
+	hwmon->info_list[n] = NULL;
+
+	hwmon->chip.ops = &mqnic_hwmon_ops;
+	hwmon->chip.info = hwmon->info_list;
+
+	hwmon_dev = hwmon_device_register_with_info(mqnic->dev, DRIVER_NAME, hwmon,
+			&hwmon->chip, NULL);
+	if (IS_ERR(hwmon_dev)) {
+		mutex_destroy(&hwmon->lock);
+		kfree(hwmon);
+		return PTR_ERR(hwmon_dev);
+	}
+
+	hwmon->hwmon_dev = hwmon_dev;
+	mqnic->hwmon = hwmon;
+
+	return 0;
+}
+
+void mqnic_hwmon_unregister(struct mqnic_dev *mqnic)
+{
+	struct mqnic_hwmon *hwmon = mqnic->hwmon;
+
+	if (!hwmon)
+		return;
+
+	hwmon_device_unregister(hwmon->hwmon_dev);
+	mutex_destroy(&hwmon->lock);
+	kfree(hwmon);
+	mqnic->hwmon = NULL;
+}
+
+#endif
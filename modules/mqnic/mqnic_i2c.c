@@ -39,14 +39,124 @@ static int mqnic_i2c_get_sda(void *data)
 	return !!(ioread32(bus->sda_in_reg) & bus->sda_in_mask);
 }
 
+static int mqnic_i2c_master_idle(struct mqnic_i2c_bus *bus)
+{
+	unsigned long timeout = jiffies + bus->adapter.timeout;
+	u32 val;
+
+	while ((val = ioread32(bus->master_regs + MQNIC_RB_I2C_MASTER_REG_STATUS)) &
+			MQNIC_I2C_MASTER_STATUS_BUSY) {
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+		usleep_range(10, 20);
+	}
+
+	if (val & MQNIC_I2C_MASTER_STATUS_MISSED_ACK) {
+		// write 1 to clear
+		iowrite32(MQNIC_I2C_MASTER_STATUS_MISSED_ACK,
+				bus->master_regs + MQNIC_RB_I2C_MASTER_REG_STATUS);
+		return -ENXIO;
+	}
+
+	return 0;
+}
+
+static int mqnic_i2c_master_read_byte(struct mqnic_i2c_bus *bus, u8 *data)
+{
+	unsigned long timeout = jiffies + bus->adapter.timeout;
+	u32 val;
+
+	while (!((val = ioread32(bus->master_regs + MQNIC_RB_I2C_MASTER_REG_DATA)) &
+			MQNIC_I2C_MASTER_DATA_VALID)) {
+		if (ioread32(bus->master_regs + MQNIC_RB_I2C_MASTER_REG_STATUS) &
+				MQNIC_I2C_MASTER_STATUS_MISSED_ACK)
+			return mqnic_i2c_master_idle(bus);
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+		usleep_range(10, 20);
+	}
+
+	*data = val & MQNIC_I2C_MASTER_DATA_MASK;
+
+	return 0;
+}
+
+static int mqnic_i2c_master_xfer_msg(struct mqnic_i2c_bus *bus, struct i2c_msg *msg, bool last)
+{
+	u32 cmd = (msg->addr & MQNIC_I2C_MASTER_CMD_ADDR_MASK) | MQNIC_I2C_MASTER_CMD_START;
+	int ret;
+	int k;
+
+	if (msg->flags & I2C_M_RD) {
+		// one command per byte; the master NAKs the byte that carries the stop
+		for (k = 0; k < msg->len; k++) {
+			iowrite32(cmd | MQNIC_I2C_MASTER_CMD_READ |
+					(last && k == msg->len - 1 ? MQNIC_I2C_MASTER_CMD_STOP : 0),
+					bus->master_regs + MQNIC_RB_I2C_MASTER_REG_CMD);
+			cmd &= ~MQNIC_I2C_MASTER_CMD_START;
+
+			ret = mqnic_i2c_master_read_byte(bus, &msg->buf[k]);
+			if (ret)
+				return ret;
+		}
+	} else {
+		if (!msg->len)
+			return -EOPNOTSUPP;
+
+		iowrite32(cmd | MQNIC_I2C_MASTER_CMD_WRITE_MULTI |
+				(last ? MQNIC_I2C_MASTER_CMD_STOP : 0),
+				bus->master_regs + MQNIC_RB_I2C_MASTER_REG_CMD);
+
+		for (k = 0; k < msg->len; k++)
+			iowrite32(msg->buf[k] | (k == msg->len - 1 ? MQNIC_I2C_MASTER_DATA_LAST : 0),
+					bus->master_regs + MQNIC_RB_I2C_MASTER_REG_DATA);
+	}
+
+	return mqnic_i2c_master_idle(bus);
+}
+
+static int mqnic_i2c_master_xfer(struct i2c_adapter *adapter, struct i2c_msg *msgs, int num)
+{
+	struct mqnic_i2c_bus *bus = i2c_get_adapdata(adapter);
+	int ret;
+	int k;
+
+	for (k = 0; k < num; k++) {
+		ret = mqnic_i2c_master_xfer_msg(bus, &msgs[k], k == num - 1);
+		if (ret) {
+			// release the bus
+			iowrite32(MQNIC_I2C_MASTER_CMD_STOP, bus->master_regs + MQNIC_RB_I2C_MASTER_REG_CMD);
+			mqnic_i2c_master_idle(bus);
+			return ret;
+		}
+	}
+
+	return num;
+}
+
+static u32 mqnic_i2c_master_func(struct i2c_adapter *adapter)
+{
+	return I2C_FUNC_I2C | (I2C_FUNC_SMBUS_EMUL & ~I2C_FUNC_SMBUS_QUICK);
+}
+
+static const struct i2c_algorithm mqnic_i2c_master_algo = {
+	.master_xfer = mqnic_i2c_master_xfer,
+	.functionality = mqnic_i2c_master_func,
+};
+
 struct mqnic_i2c_bus *mqnic_i2c_bus_create(struct mqnic_dev *mqnic, int index)
 {
 	struct mqnic_i2c_bus *bus;
 	struct i2c_algo_bit_data *algo;
 	struct i2c_adapter *adapter;
 	struct mqnic_reg_block *rb;
+	int ret;
+
+	// prefer the hardware master; boards provide one or the other per index
+	rb = mqnic_find_reg_block(mqnic->rb_list, MQNIC_RB_I2C_MASTER_TYPE, MQNIC_RB_I2C_MASTER_VER, index);
 
-	rb = mqnic_find_reg_block(mqnic->rb_list, MQNIC_RB_I2C_TYPE, MQNIC_RB_I2C_VER, index);
+	if (!rb)
+		rb = mqnic_find_reg_block(mqnic->rb_list, MQNIC_RB_I2C_TYPE, MQNIC_RB_I2C_VER, index);
 
 	if (!rb)
 		return NULL;
@@ -58,6 +168,25 @@ struct mqnic_i2c_bus *mqnic_i2c_bus_create(struct mqnic_dev *mqnic, int index)
 
 	// set private data
 	bus->mqnic = mqnic;
+
+	// adapter setup
+	adapter = &bus->adapter;
+	adapter->owner = THIS_MODULE;
+	adapter->dev.parent = mqnic->dev;
+	snprintf(adapter->name, sizeof(adapter->name), "%s I2C%d", mqnic->name,
+			mqnic->i2c_adapter_count);
+
+	if (rb->type == MQNIC_RB_I2C_MASTER_TYPE) {
+		// bus rate comes from the prescaler the firmware resets to
+		bus->master_regs = rb->regs;
+		adapter->algo = &mqnic_i2c_master_algo;
+		adapter->timeout = usecs_to_jiffies(20000);
+		i2c_set_adapdata(adapter, bus);
+
+		ret = i2c_add_adapter(adapter);
+		goto done;
+	}
+
 	bus->scl_in_reg = rb->regs + MQNIC_RB_I2C_REG_CTRL;
 	bus->scl_out_reg = rb->regs + MQNIC_RB_I2C_REG_CTRL;
 	bus->sda_in_reg = rb->regs + MQNIC_RB_I2C_REG_CTRL;
@@ -77,15 +206,12 @@ struct mqnic_i2c_bus *mqnic_i2c_bus_create(struct mqnic_dev *mqnic, int index)
 	algo->getscl = mqnic_i2c_get_scl;
 	algo->data = bus;
 
-	// adapter setup
-	adapter = &bus->adapter;
-	adapter->owner = THIS_MODULE;
 	adapter->algo_data = algo;
-	adapter->dev.parent = mqnic->dev;
-	snprintf(adapter->name, sizeof(adapter->name), "%s I2C%d", mqnic->name,
-			mqnic->i2c_adapter_count);
 
-	if (i2c_bit_add_bus(adapter)) {
+	ret = i2c_bit_add_bus(adapter);
+
+done:
+	if (ret) {
 		dev_err(mqnic->dev, "Failed to register I2C adapter");
 		goto err_free_bus;
 	}
@@ -5,13 +5,60 @@
 
 #include "mqnic.h"
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+#include <linux/unaligned.h>
+#else
+#include <asm/unaligned.h>
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+#include <net/rps.h>
+#endif
+
+// Toeplitz key used by the RX hash block when it is not programmable
+static const u8 mqnic_default_rx_hash_key[MQNIC_RX_HASH_KEY_SIZE] = {
+	0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+	0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+	0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+	0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+	0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+};
+
+static void mqnic_interface_write_flow_rule(struct mqnic_if *interface, int index);
+
+// pick an unused IRQ vector whose affinity covers cpu
+static struct mqnic_irq *mqnic_interface_cpu_irq(struct mqnic_dev *mdev, int cpu,
+		unsigned long *used)
+{
+	int k;
+
+	for (k = 0; k < mdev->irq_count; k++) {
+		struct mqnic_irq *irq = mdev->irq[k];
+
+		if (test_bit(k, used) || !irq->affinity || !cpumask_test_cpu(cpu, irq->affinity))
+			continue;
+
+		set_bit(k, used);
+		return irq;
+	}
+
+	// vectors without affinity information, or all taken; use any free one
+	k = find_first_zero_bit(used, mdev->irq_count);
+	if (k >= mdev->irq_count)
+		return NULL;
+
+	set_bit(k, used);
+	return mdev->irq[k];
+}
+
 struct mqnic_if *mqnic_create_interface(struct mqnic_dev *mdev, int index, u8 __iomem *hw_addr)
 {
 	struct device *dev = mdev->dev;
 	struct mqnic_if *interface;
 	struct mqnic_reg_block *rb;
+	DECLARE_BITMAP(irq_used, MQNIC_MAX_IRQ);
 	int ret = 0;
-	int k;
+	int cpu = 0;
+	int k, l;
 	u32 count, offset, stride;
 	u32 desc_block_size;
 	u32 val;
@@ -25,18 +72,20 @@ struct mqnic_if *mqnic_create_interface(struct mqnic_dev *mdev, int index, u8 __
 
 	interface->index = index;
 
+	mqnic_dma_arena_init(&interface->dma_arena, dev);
+
 	interface->hw_regs_size = mdev->if_stride;
 	interface->hw_addr = hw_addr;
 	interface->csr_hw_addr = hw_addr + mdev->if_csr_offset;
 
-	init_rwsem(&interface->eq_table_sem);
-	INIT_RADIX_TREE(&interface->eq_table, GFP_KERNEL);
 
 	INIT_LIST_HEAD(&interface->free_sched_port_list);
 	spin_lock_init(&interface->free_sched_port_list_lock);
 
 	INIT_LIST_HEAD(&interface->ndev_list);
 
+	mqnic_mod_cache_init(interface);
+
 	// Enumerate registers
 	interface->rb_list = mqnic_enumerate_reg_block_list(interface->hw_addr, mdev->if_csr_offset, interface->hw_regs_size);
 	if (!interface->rb_list) {
@@ -122,6 +171,12 @@ struct mqnic_if *mqnic_create_interface(struct mqnic_dev *mdev, int index, u8 __
 		goto fail;
 	}
 
+	interface->cq_table = kcalloc(count, sizeof(*interface->cq_table), GFP_KERNEL);
+	if (!interface->cq_table) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
 	interface->txq_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_TX_QM_TYPE, MQNIC_RB_TX_QM_VER, 0);
 
 	if (!interface->txq_rb) {
@@ -172,6 +227,51 @@ struct mqnic_if *mqnic_create_interface(struct mqnic_dev *mdev, int index, u8 __
 		goto fail;
 	}
 
+	// descriptor push windows are optional
+	interface->tx_push_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_TX_PUSH_TYPE, MQNIC_RB_TX_PUSH_VER, 0);
+
+	if (interface->tx_push_rb && (interface->if_features & MQNIC_IF_FEATURE_TX_DESC_PUSH) && mqnic_tx_push) {
+		offset = ioread32(interface->tx_push_rb->regs + MQNIC_RB_TX_PUSH_REG_OFFSET);
+		count = ioread32(interface->tx_push_rb->regs + MQNIC_RB_TX_PUSH_REG_COUNT);
+		stride = ioread32(interface->tx_push_rb->regs + MQNIC_RB_TX_PUSH_REG_STRIDE);
+		interface->tx_push_slot_size = ioread32(interface->tx_push_rb->regs + MQNIC_RB_TX_PUSH_REG_SLOT_SIZE);
+
+		dev_info(dev, "TX push offset: 0x%08x", offset);
+		dev_info(dev, "TX push count: %d", count);
+		dev_info(dev, "TX push stride: 0x%08x", stride);
+		dev_info(dev, "TX push slot size: %d", interface->tx_push_slot_size);
+
+		count = min_t(u32, count, mqnic_res_get_count(interface->txq_res));
+
+		// only the window is mapped write-combined, the queue registers stay uncached
+		if (count && stride && interface->tx_push_slot_size &&
+				interface->tx_push_slot_size <= stride) {
+			interface->tx_push_hw_addr = ioremap_wc(mdev->hw_regs_phys +
+					(hw_addr - mdev->hw_addr) + offset, count * stride);
+			if (interface->tx_push_hw_addr) {
+				interface->tx_push_count = count;
+				interface->tx_push_stride = stride;
+			} else {
+				dev_warn(dev, "Failed to map TX push windows");
+			}
+		}
+	}
+
+	// pointer write-back is optional, fall back to register reads without it
+	if (interface->if_features & MQNIC_IF_FEATURE_PTR_SHADOW) {
+		interface->ptr_shadow_size = PAGE_ALIGN(sizeof(*interface->ptr_shadow) *
+				(mqnic_res_get_count(interface->eq_res) +
+				mqnic_res_get_count(interface->cq_res) +
+				mqnic_res_get_count(interface->txq_res) +
+				mqnic_res_get_count(interface->rxq_res)));
+		interface->ptr_shadow = dma_alloc_coherent(dev, interface->ptr_shadow_size,
+				&interface->ptr_shadow_dma_addr, GFP_KERNEL | __GFP_ZERO);
+		if (!interface->ptr_shadow) {
+			dev_warn(dev, "Failed to allocate pointer shadow");
+			interface->ptr_shadow_size = 0;
+		}
+	}
+
 	interface->rx_queue_map_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_RX_QUEUE_MAP_TYPE, MQNIC_RB_RX_QUEUE_MAP_VER, 0);
 
 	if (!interface->rx_queue_map_rb) {
@@ -192,16 +292,85 @@ struct mqnic_if *mqnic_create_interface(struct mqnic_dev *mdev, int index, u8 __
 		mqnic_interface_set_rx_queue_map_rss_mask(interface, k, 0);
 		mqnic_interface_set_rx_queue_map_app_mask(interface, k, 0);
 		mqnic_interface_set_rx_queue_map_indir_table(interface, k, 0, 0);
+		if (interface->if_features & MQNIC_IF_FEATURE_PTP_CLASSIFY)
+			mqnic_interface_set_rx_queue_map_ptp_queue(interface, k, 0);
+	}
+
+	// RX hash key is fixed in hardware unless the key register block is present
+	interface->rx_hash_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_RX_HASH_TYPE, MQNIC_RB_RX_HASH_VER, 0);
+
+	if (interface->rx_hash_rb) {
+		netdev_rss_key_fill(interface->rx_hash_key, sizeof(interface->rx_hash_key));
+		mqnic_interface_set_rx_hash_key(interface, interface->rx_hash_key);
+	} else {
+		memcpy(interface->rx_hash_key, mqnic_default_rx_hash_key, sizeof(interface->rx_hash_key));
 	}
 
+	// flow steering rules are optional
+	spin_lock_init(&interface->rx_flow_table_lock);
+	interface->rx_flow_table_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_RX_FLOW_TABLE_TYPE, MQNIC_RB_RX_FLOW_TABLE_VER, 0);
+
+	if (interface->rx_flow_table_rb) {
+		interface->rx_flow_table_size = ioread32(interface->rx_flow_table_rb->regs + MQNIC_RB_RX_FLOW_TABLE_REG_CFG) & 0xffff;
+
+		dev_info(dev, "RX flow table size: %d", interface->rx_flow_table_size);
+
+		interface->rx_flow_rules = kcalloc(interface->rx_flow_table_size,
+				sizeof(*interface->rx_flow_rules), GFP_KERNEL);
+		if (!interface->rx_flow_rules) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		// clear table
+		for (k = 0; k < interface->rx_flow_table_size; k++)
+			mqnic_interface_write_flow_rule(interface, k);
+	}
+
+	// link aggregation across the ports is optional
+	interface->lag_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_LAG_TYPE, MQNIC_RB_LAG_VER, 0);
+
+	if (interface->lag_rb)
+		iowrite32(0, interface->lag_rb->regs + MQNIC_RB_LAG_REG_CTRL);
+
+	// L2 station table for macvlan offload is optional
+	interface->rx_l2_table_rb = mqnic_find_reg_block(interface->rb_list, MQNIC_RB_RX_L2_TABLE_TYPE, MQNIC_RB_RX_L2_TABLE_VER, 0);
+
+	if (interface->rx_l2_table_rb) {
+		interface->rx_l2_table_size = ioread32(interface->rx_l2_table_rb->regs + MQNIC_RB_RX_L2_TABLE_REG_CFG) & 0xffff;
+
+		dev_info(dev, "RX L2 station table size: %d", interface->rx_l2_table_size);
+
+		interface->rx_l2_table_bmap = bitmap_zalloc(interface->rx_l2_table_size, GFP_KERNEL);
+		if (!interface->rx_l2_table_bmap) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		// clear table
+		for (k = 0; k < interface->rx_l2_table_size; k++)
+			mqnic_interface_write_l2_entry(interface, k, NULL, 0, 0, 0);
+	}
+
+	// capture rules are optional
+	ret = mqnic_capture_init(interface);
+	if (ret)
+		goto fail;
+
 	// determine desc block size
 	iowrite32(MQNIC_QUEUE_CMD_SET_SIZE | 0xff00, mqnic_res_get_addr(interface->txq_res, 0) + MQNIC_QUEUE_CTRL_STATUS_REG);
 	interface->max_desc_block_size = 1 << ((ioread32(mqnic_res_get_addr(interface->txq_res, 0) + MQNIC_QUEUE_SIZE_CQN_REG) >> 28) & 0xf);
 	iowrite32(MQNIC_QUEUE_CMD_SET_SIZE | 0x0000, mqnic_res_get_addr(interface->txq_res, 0) + MQNIC_QUEUE_CTRL_STATUS_REG);
 
+	iowrite32(MQNIC_QUEUE_CMD_SET_SIZE | 0xff00, mqnic_res_get_addr(interface->rxq_res, 0) + MQNIC_QUEUE_CTRL_STATUS_REG);
+	interface->max_rx_desc_block_size = 1 << ((ioread32(mqnic_res_get_addr(interface->rxq_res, 0) + MQNIC_QUEUE_SIZE_CQN_REG) >> 28) & 0xf);
+	iowrite32(MQNIC_QUEUE_CMD_SET_SIZE | 0x0000, mqnic_res_get_addr(interface->rxq_res, 0) + MQNIC_QUEUE_CTRL_STATUS_REG);
+
 	dev_info(dev, "Max desc block size: %d", interface->max_desc_block_size);
+	dev_info(dev, "Max RX desc block size: %d", interface->max_rx_desc_block_size);
 
 	interface->max_desc_block_size = min_t(u32, interface->max_desc_block_size, MQNIC_MAX_FRAGS);
+	interface->max_rx_desc_block_size = min_t(u32, interface->max_rx_desc_block_size, MQNIC_MAX_FRAGS);
 
 	desc_block_size = min_t(u32, interface->max_desc_block_size, 4);
 
@@ -256,30 +425,74 @@ struct mqnic_if *mqnic_create_interface(struct mqnic_dev *mdev, int index, u8 __
 		interface->sched_block[k] = sched_block;
 	}
 
+	// ports may be bound to any scheduler, so only common features are usable
+	interface->sched_tc_count = 0;
+	interface->sched_rate_limit = interface->sched_block_count > 0;
+	interface->sched_dwrr = interface->sched_block_count > 0;
+	for (k = 0; k < interface->sched_block_count; k++) {
+		struct mqnic_sched_block *sched_block = interface->sched_block[k];
+
+		for (l = 0; l < sched_block->sched_count; l++) {
+			int tc_count = sched_block->sched[l]->tc_count;
+
+			if (!interface->sched_tc_count || tc_count < interface->sched_tc_count)
+				interface->sched_tc_count = tc_count;
+
+			if (!sched_block->sched[l]->rl_rb)
+				interface->sched_rate_limit = false;
+
+			if (!sched_block->sched[l]->dwrr)
+				interface->sched_dwrr = false;
+		}
+	}
+
 	// create EQs
+	interface->eq_table = kcalloc(mqnic_res_get_count(interface->eq_res),
+			sizeof(*interface->eq_table), GFP_KERNEL);
+	if (!interface->eq_table) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
 	interface->eq_count = mqnic_res_get_count(interface->eq_res);
+
+	interface->eq_per_cpu = mqnic_per_cpu_eq;
+	if (interface->eq_per_cpu) {
+		interface->eq_count = min_t(u32, interface->eq_count, num_online_cpus());
+		interface->eq_count = min_t(u32, interface->eq_count, mdev->irq_count);
+		bitmap_zero(irq_used, MQNIC_MAX_IRQ);
+		cpu = cpumask_first(cpu_online_mask);
+
+		dev_info(dev, "Using %d per-CPU EQs", interface->eq_count);
+	}
+
 	for (k = 0; k < interface->eq_count; k++) {
 		struct mqnic_eq *eq = mqnic_create_eq(interface);
+		struct mqnic_irq *irq = mdev->irq[k % mdev->irq_count];
+
 		if (IS_ERR_OR_NULL(eq)) {
 			ret = PTR_ERR(eq);
 			goto fail;
 		}
 
-		down_write(&interface->eq_table_sem);
-		ret = radix_tree_insert(&interface->eq_table, k, eq);
-		up_write(&interface->eq_table_sem);
-		if (ret) {
-			mqnic_destroy_eq(eq);
-			goto fail;
+		interface->eq_table[k] = eq;
+
+		if (interface->eq_per_cpu) {
+			irq = mqnic_interface_cpu_irq(mdev, cpu, irq_used);
+			cpu = cpumask_next(cpu, cpu_online_mask);
 		}
 
-		ret = mqnic_open_eq(eq, mdev->irq[k % mdev->irq_count], mqnic_num_eq_entries);
+		ret = mqnic_open_eq(eq, irq, mdev->eq_size);
 		if (ret)
 			goto fail;
 
 		mqnic_arm_eq(eq);
 	}
 
+	// MAC addresses come from board init, which overlaps the setup above;
+	// a failure there fails the probe once all interfaces are created
+	mqnic_board_wait(mdev);
+
 	// create net_devices
 	interface->ndev_count = interface->port_count;
 	for (k = 0; k < interface->ndev_count; k++) {
@@ -294,6 +507,11 @@ struct mqnic_if *mqnic_create_interface(struct mqnic_dev *mdev, int index, u8 __
 		list_add_tail(&priv->ndev_list, &interface->ndev_list);
 	}
 
+	ret = mqnic_lag_init(interface);
+	if (ret)
+		dev_warn(dev, "Failed to set up link aggregation offload: %d", ret);
+	ret = 0;
+
 	return interface;
 
 fail:
@@ -304,23 +522,30 @@ fail:
 void mqnic_destroy_interface(struct mqnic_if *interface)
 {
 	struct mqnic_priv *priv, *priv_safe;
-	struct radix_tree_iter iter;
-	void **slot;
 	int k;
 
+	mqnic_lag_deinit(interface);
+
+	// rules may point at the channels of the net_devices
+	mqnic_capture_deinit(interface);
+
 	// destroy associated net_devices
 	list_for_each_entry_safe(priv, priv_safe, &interface->ndev_list, ndev_list) {
 		list_del(&priv->ndev_list);
 		mqnic_destroy_netdev(priv->ndev);
 	}
 
+	mqnic_mod_cache_destroy(interface);
+
 	// free EQs
-	down_write(&interface->eq_table_sem);
-	radix_tree_for_each_slot(slot, &interface->eq_table, &iter, 0) {
-		struct mqnic_eq *eq = (struct mqnic_eq *)*slot;
-		mqnic_destroy_eq(eq);
+	for (k = 0; interface->eq_table && k < interface->eq_count; k++) {
+		if (interface->eq_table[k]) {
+			mqnic_destroy_eq(interface->eq_table[k]);
+			interface->eq_table[k] = NULL;
+		}
 	}
-	up_write(&interface->eq_table_sem);
+	kfree(interface->eq_table);
+	interface->eq_table = NULL;
 
 	// free schedulers
 	for (k = 0; k < ARRAY_SIZE(interface->sched_block); k++) {
@@ -338,17 +563,158 @@ void mqnic_destroy_interface(struct mqnic_if *interface)
 		}
 	}
 
+	kfree(interface->cq_table);
+	interface->cq_table = NULL;
+
+	kfree(interface->rx_flow_rules);
+	interface->rx_flow_rules = NULL;
+
+	bitmap_free(interface->rx_l2_table_bmap);
+	interface->rx_l2_table_bmap = NULL;
+
 	mqnic_destroy_res(interface->eq_res);
 	mqnic_destroy_res(interface->cq_res);
 	mqnic_destroy_res(interface->txq_res);
 	mqnic_destroy_res(interface->rxq_res);
 
+	if (interface->tx_push_hw_addr)
+		iounmap(interface->tx_push_hw_addr);
+
+	// all queues are closed by now
+	mqnic_dma_arena_destroy(&interface->dma_arena);
+
+	if (interface->ptr_shadow)
+		dma_free_coherent(interface->dev, interface->ptr_shadow_size,
+				interface->ptr_shadow, interface->ptr_shadow_dma_addr);
+
 	if (interface->rb_list)
 		mqnic_free_reg_block_list(interface->rb_list);
 
 	kfree(interface);
 }
 
+// point the queue at its write-back slot; returns NULL without shadowing
+struct mqnic_ptr_shadow *mqnic_interface_attach_ptr_shadow(struct mqnic_if *interface,
+		struct mqnic_res *res, int index, u8 __iomem *addr_reg)
+{
+	struct mqnic_ptr_shadow *shadow;
+	dma_addr_t dma_addr;
+	int offset = 0;
+
+	if (!interface->ptr_shadow)
+		return NULL;
+
+	// slots are laid out EQs, CQs, TXQs, RXQs
+	if (res != interface->eq_res) {
+		offset += mqnic_res_get_count(interface->eq_res);
+		if (res != interface->cq_res) {
+			offset += mqnic_res_get_count(interface->cq_res);
+			if (res != interface->txq_res)
+				offset += mqnic_res_get_count(interface->txq_res);
+		}
+	}
+
+	shadow = &interface->ptr_shadow[offset + index];
+	dma_addr = interface->ptr_shadow_dma_addr + (offset + index) * sizeof(*shadow);
+
+	// queues attach right after their pointers are reset, and the hardware
+	// writes the current value as soon as the address is enabled
+	WRITE_ONCE(shadow->ptr, 0);
+	WRITE_ONCE(shadow->flags, cpu_to_le32(MQNIC_PTR_SHADOW_FLAG_VALID));
+	iowrite32(upper_32_bits(dma_addr), addr_reg + 4);
+	iowrite32(lower_32_bits(dma_addr) | MQNIC_SHADOW_ADDR_ENABLE, addr_reg);
+
+	return shadow;
+}
+
+void mqnic_interface_detach_ptr_shadow(struct mqnic_ptr_shadow *shadow, u8 __iomem *addr_reg)
+{
+	if (!shadow)
+		return;
+
+	iowrite32(0, addr_reg);
+	iowrite32(0, addr_reg + 4);
+	WRITE_ONCE(shadow->flags, 0);
+}
+
+// reopen the EQs at a new size; only while no CQ is attached to any of them,
+// which is once every port of the interface is down
+int mqnic_interface_resize_eqs(struct mqnic_if *interface, u32 size)
+{
+	struct mqnic_irq *irq;
+	struct mqnic_eq *eq;
+	u32 old_size;
+	int ret;
+	int k;
+
+	size = roundup_pow_of_two(size);
+
+	for (k = 0; k < interface->eq_count; k++)
+		if (interface->eq_table[k]->size != size)
+			break;
+
+	if (k == interface->eq_count)
+		return 0;
+
+	for (k = 0; k < mqnic_res_get_count(interface->cq_res); k++)
+		if (rcu_access_pointer(interface->cq_table[k]))
+			return -EBUSY;
+
+	dev_info(interface->dev, "Resizing EQs on interface %d to %d entries", interface->index, size);
+
+	for (k = 0; k < interface->eq_count; k++) {
+		eq = interface->eq_table[k];
+		irq = eq->irq;
+		old_size = eq->size;
+
+		mqnic_close_eq(eq);
+
+		ret = mqnic_open_eq(eq, irq, size);
+		if (ret) {
+			// fall back on the size it had
+			dev_err(interface->dev, "Failed to resize EQ %d on interface %d: %d",
+					k, interface->index, ret);
+			ret = mqnic_open_eq(eq, irq, old_size);
+			if (ret)
+				return ret;
+		}
+
+		mqnic_arm_eq(eq);
+	}
+
+	return 0;
+}
+
+struct mqnic_eq *mqnic_interface_select_eq(struct mqnic_if *interface, int index)
+{
+	int node = dev_to_node(interface->dev);
+	int n = index % interface->eq_count;
+	int k;
+
+	// queue k follows the EQ of CPU k
+	if (node == NUMA_NO_NODE || interface->eq_per_cpu)
+		return interface->eq_table[n];
+
+	// walk EQs whose IRQs are serviced on the device node first,
+	// then the remaining ones, so low queue indices stay local
+	for (k = 0; k < interface->eq_count; k++) {
+		struct mqnic_eq *eq = interface->eq_table[k];
+
+		if (eq->irq->node == node && n-- == 0)
+			return eq;
+	}
+
+	for (k = 0; k < interface->eq_count; k++) {
+		struct mqnic_eq *eq = interface->eq_table[k];
+
+		if (eq->irq->node != node && n-- == 0)
+			return eq;
+	}
+
+	return interface->eq_table[index % interface->eq_count];
+}
+EXPORT_SYMBOL(mqnic_interface_select_eq);
+
 u32 mqnic_interface_get_tx_mtu(struct mqnic_if *interface)
 {
 	return ioread32(interface->if_ctrl_rb->regs + MQNIC_RB_IF_CTRL_REG_TX_MTU);
@@ -413,6 +779,301 @@ void mqnic_interface_set_rx_queue_map_indir_table(struct mqnic_if *interface, in
 }
 EXPORT_SYMBOL(mqnic_interface_set_rx_queue_map_indir_table);
 
+void mqnic_interface_set_rx_queue_map_ptp_queue(struct mqnic_if *interface, int port, u32 val)
+{
+	iowrite32(val, interface->rx_queue_map_rb->regs + MQNIC_RB_RX_QUEUE_MAP_CH_OFFSET +
+			MQNIC_RB_RX_QUEUE_MAP_CH_STRIDE*port + MQNIC_RB_RX_QUEUE_MAP_CH_REG_PTP_QUEUE);
+}
+EXPORT_SYMBOL(mqnic_interface_set_rx_queue_map_ptp_queue);
+
+void mqnic_interface_get_rx_hash_key(struct mqnic_if *interface, u8 *key)
+{
+	memcpy(key, interface->rx_hash_key, sizeof(interface->rx_hash_key));
+}
+EXPORT_SYMBOL(mqnic_interface_get_rx_hash_key);
+
+int mqnic_interface_set_rx_hash_key(struct mqnic_if *interface, const u8 *key)
+{
+	int k;
+
+	if (!interface->rx_hash_rb)
+		return -EOPNOTSUPP;
+
+	memcpy(interface->rx_hash_key, key, sizeof(interface->rx_hash_key));
+
+	for (k = 0; k < MQNIC_RX_HASH_KEY_SIZE / 4; k++)
+		iowrite32(get_unaligned_be32(key + k * 4),
+				interface->rx_hash_rb->regs + MQNIC_RB_RX_HASH_REG_KEY + k * 4);
+
+	return 0;
+}
+EXPORT_SYMBOL(mqnic_interface_set_rx_hash_key);
+
+static bool mqnic_flow_rule_match(const struct mqnic_flow_rule *a, const struct mqnic_flow_rule *b)
+{
+	return a->src_ip == b->src_ip && a->dst_ip == b->dst_ip &&
+		a->src_port == b->src_port && a->dst_port == b->dst_port &&
+		a->ip_proto == b->ip_proto;
+}
+
+// write one table entry; disabled unless its owner has the target queue up
+static void mqnic_interface_write_flow_rule(struct mqnic_if *interface, int index)
+{
+	struct mqnic_flow_rule *rule = &interface->rx_flow_rules[index];
+	u8 __iomem *regs = interface->rx_flow_table_rb->regs;
+	struct mqnic_priv *priv = rule->priv;
+	struct mqnic_ring *q = NULL;
+	u32 ctrl = 0;
+
+	rcu_read_lock();
+
+	if (priv && priv->port_up && rule->rxq < priv->rxq_count)
+		q = rcu_dereference(priv->rxq_table[rule->rxq]);
+
+	iowrite32(index, regs + MQNIC_RB_RX_FLOW_TABLE_REG_INDEX);
+
+	if (q) {
+		iowrite32(be32_to_cpu(rule->src_ip), regs + MQNIC_RB_RX_FLOW_TABLE_REG_SRC_IP);
+		iowrite32(be32_to_cpu(rule->dst_ip), regs + MQNIC_RB_RX_FLOW_TABLE_REG_DST_IP);
+		iowrite32((be16_to_cpu(rule->src_port) << 16) | be16_to_cpu(rule->dst_port),
+				regs + MQNIC_RB_RX_FLOW_TABLE_REG_PORTS);
+		iowrite32(q->index, regs + MQNIC_RB_RX_FLOW_TABLE_REG_QUEUE);
+
+		ctrl = MQNIC_RX_FLOW_CTRL_ENABLE | rule->ip_proto |
+			((priv->port->index << MQNIC_RX_FLOW_CTRL_PORT_SHIFT) & MQNIC_RX_FLOW_CTRL_PORT_MASK);
+	}
+
+	// control write commits the entry
+	iowrite32(ctrl, regs + MQNIC_RB_RX_FLOW_TABLE_REG_CTRL);
+
+	rcu_read_unlock();
+}
+
+// index < 0 places the rule automatically, reusing an aRFS entry for the same flow
+int mqnic_interface_add_flow_rule(struct mqnic_if *interface, int index,
+		const struct mqnic_flow_rule *rule)
+{
+	int k;
+
+	if (!interface->rx_flow_rules)
+		return -EOPNOTSUPP;
+
+	spin_lock_bh(&interface->rx_flow_table_lock);
+
+	if (index < 0) {
+		for (k = 0; k < interface->rx_flow_table_size; k++) {
+			struct mqnic_flow_rule *entry = &interface->rx_flow_rules[k];
+
+			if (entry->priv == rule->priv && entry->arfs && mqnic_flow_rule_match(entry, rule)) {
+				index = k;
+				break;
+			}
+
+			if (!entry->priv && index < 0)
+				index = k;
+		}
+
+		if (index < 0) {
+			spin_unlock_bh(&interface->rx_flow_table_lock);
+			return -ENOSPC;
+		}
+	} else if (index >= interface->rx_flow_table_size) {
+		spin_unlock_bh(&interface->rx_flow_table_lock);
+		return -EINVAL;
+	} else if (interface->rx_flow_rules[index].priv &&
+			!interface->rx_flow_rules[index].arfs &&
+			interface->rx_flow_rules[index].priv != rule->priv) {
+		// entry belongs to another port
+		spin_unlock_bh(&interface->rx_flow_table_lock);
+		return -EBUSY;
+	}
+
+	interface->rx_flow_rules[index] = *rule;
+	mqnic_interface_write_flow_rule(interface, index);
+
+	spin_unlock_bh(&interface->rx_flow_table_lock);
+
+	return index;
+}
+EXPORT_SYMBOL(mqnic_interface_add_flow_rule);
+
+int mqnic_interface_del_flow_rule(struct mqnic_if *interface, struct mqnic_priv *priv, int index)
+{
+	int ret = 0;
+
+	if (!interface->rx_flow_rules)
+		return -EOPNOTSUPP;
+
+	if (index < 0 || index >= interface->rx_flow_table_size)
+		return -EINVAL;
+
+	spin_lock_bh(&interface->rx_flow_table_lock);
+
+	if (interface->rx_flow_rules[index].priv == priv) {
+		memset(&interface->rx_flow_rules[index], 0, sizeof(interface->rx_flow_rules[index]));
+		mqnic_interface_write_flow_rule(interface, index);
+	} else {
+		ret = -ENOENT;
+	}
+
+	spin_unlock_bh(&interface->rx_flow_table_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(mqnic_interface_del_flow_rule);
+
+int mqnic_interface_get_flow_rule(struct mqnic_if *interface, int index, struct mqnic_flow_rule *rule)
+{
+	int ret = 0;
+
+	if (!interface->rx_flow_rules)
+		return -EOPNOTSUPP;
+
+	if (index < 0 || index >= interface->rx_flow_table_size)
+		return -EINVAL;
+
+	spin_lock_bh(&interface->rx_flow_table_lock);
+
+	if (interface->rx_flow_rules[index].priv)
+		*rule = interface->rx_flow_rules[index];
+	else
+		ret = -ENOENT;
+
+	spin_unlock_bh(&interface->rx_flow_table_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(mqnic_interface_get_flow_rule);
+
+// queue indices change across port restarts; reprogram on start and stop
+void mqnic_interface_update_flow_rules(struct mqnic_if *interface, struct mqnic_priv *priv)
+{
+	int k;
+
+	if (!interface->rx_flow_rules)
+		return;
+
+	spin_lock_bh(&interface->rx_flow_table_lock);
+
+	for (k = 0; k < interface->rx_flow_table_size; k++) {
+		struct mqnic_flow_rule *entry = &interface->rx_flow_rules[k];
+
+		if (entry->priv != priv)
+			continue;
+
+		// accelerated RFS state does not survive the port going down
+		if (entry->arfs && !priv->port_up)
+			memset(entry, 0, sizeof(*entry));
+
+		mqnic_interface_write_flow_rule(interface, k);
+	}
+
+	spin_unlock_bh(&interface->rx_flow_table_lock);
+}
+EXPORT_SYMBOL(mqnic_interface_update_flow_rules);
+
+void mqnic_interface_clear_flow_rules(struct mqnic_if *interface, struct mqnic_priv *priv)
+{
+	int k;
+
+	if (!interface->rx_flow_rules)
+		return;
+
+	spin_lock_bh(&interface->rx_flow_table_lock);
+
+	for (k = 0; k < interface->rx_flow_table_size; k++) {
+		struct mqnic_flow_rule *entry = &interface->rx_flow_rules[k];
+
+		if (entry->priv != priv)
+			continue;
+
+		memset(entry, 0, sizeof(*entry));
+		mqnic_interface_write_flow_rule(interface, k);
+	}
+
+	spin_unlock_bh(&interface->rx_flow_table_lock);
+}
+EXPORT_SYMBOL(mqnic_interface_clear_flow_rules);
+
+void mqnic_interface_expire_flow_rules(struct mqnic_if *interface, struct mqnic_priv *priv)
+{
+#ifdef CONFIG_RFS_ACCEL
+	int k;
+
+	if (!interface->rx_flow_rules)
+		return;
+
+	spin_lock_bh(&interface->rx_flow_table_lock);
+
+	for (k = 0; k < interface->rx_flow_table_size; k++) {
+		struct mqnic_flow_rule *entry = &interface->rx_flow_rules[k];
+
+		if (entry->priv != priv || !entry->arfs)
+			continue;
+
+		if (!rps_may_expire_flow(priv->ndev, entry->rxq, entry->flow_id, k))
+			continue;
+
+		memset(entry, 0, sizeof(*entry));
+		mqnic_interface_write_flow_rule(interface, k);
+	}
+
+	spin_unlock_bh(&interface->rx_flow_table_lock);
+#endif
+}
+EXPORT_SYMBOL(mqnic_interface_expire_flow_rules);
+
+int mqnic_interface_alloc_l2_entry(struct mqnic_if *interface)
+{
+	int index;
+
+	if (!interface->rx_l2_table_bmap)
+		return -EOPNOTSUPP;
+
+	do {
+		index = find_first_zero_bit(interface->rx_l2_table_bmap, interface->rx_l2_table_size);
+		if (index >= interface->rx_l2_table_size)
+			return -ENOSPC;
+	} while (test_and_set_bit(index, interface->rx_l2_table_bmap));
+
+	return index;
+}
+
+void mqnic_interface_free_l2_entry(struct mqnic_if *interface, int index)
+{
+	if (index < 0 || index >= interface->rx_l2_table_size)
+		return;
+
+	mqnic_interface_write_l2_entry(interface, index, NULL, 0, 0, 0);
+	clear_bit(index, interface->rx_l2_table_bmap);
+}
+
+// frames to mac on port go to queue + (RSS hash & ((1 << log_queues) - 1)), any VLAN;
+// a NULL mac disables the entry
+void mqnic_interface_write_l2_entry(struct mqnic_if *interface, int index, const u8 *mac,
+		int port, u32 queue, u32 log_queues)
+{
+	u8 __iomem *regs = interface->rx_l2_table_rb->regs;
+	u32 ctrl = 0;
+
+	iowrite32(index, regs + MQNIC_RB_RX_L2_TABLE_REG_INDEX);
+
+	if (mac) {
+		iowrite32((mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5],
+				regs + MQNIC_RB_RX_L2_TABLE_REG_MAC_L);
+		iowrite32((mac[0] << 8) | mac[1], regs + MQNIC_RB_RX_L2_TABLE_REG_MAC_H);
+		iowrite32(0, regs + MQNIC_RB_RX_L2_TABLE_REG_VLAN);
+		iowrite32(queue, regs + MQNIC_RB_RX_L2_TABLE_REG_QUEUE);
+
+		ctrl = MQNIC_RX_L2_CTRL_ENABLE |
+			((port << MQNIC_RX_L2_CTRL_PORT_SHIFT) & MQNIC_RX_L2_CTRL_PORT_MASK) |
+			((log_queues << MQNIC_RX_L2_CTRL_LOG_QUEUES_SHIFT) & MQNIC_RX_L2_CTRL_LOG_QUEUES_MASK);
+	}
+
+	// control write commits the entry
+	iowrite32(ctrl, regs + MQNIC_RB_RX_L2_TABLE_REG_CTRL);
+}
+
 int mqnic_interface_register_sched_port(struct mqnic_if *interface, struct mqnic_sched_port *port)
 {
 	spin_lock(&interface->free_sched_port_list_lock);
@@ -18,9 +18,18 @@ enum {
 	MQNIC_REGION_TYPE_CTRL = 0x00001000,
 	MQNIC_REGION_TYPE_NIC_CTRL = 0x00001001,
 	MQNIC_REGION_TYPE_APP_CTRL = 0x00001002,
-	MQNIC_REGION_TYPE_RAM = 0x00002000
+	MQNIC_REGION_TYPE_RAM = 0x00002000,
+	MQNIC_REGION_TYPE_PTR_SHADOW = 0x00003000,
+	MQNIC_REGION_TYPE_STATS = 0x00004000
 };
 
+// region 3+n is the read-only pointer shadow of interface n, an array of
+// struct mqnic_ptr_shadow holding all EQs, then all CQs, TXQs and RXQs,
+// each in hardware queue index order
+
+// the region after the pointer shadows is the read-only statistics
+// write-back buffer, see struct mqnic_stats_dma_hdr
+
 // get API version
 #define MQNIC_IOCTL_GET_API_VERSION _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 0)
 
@@ -41,6 +50,12 @@ struct mqnic_ioctl_device_info {
 
 #define MQNIC_IOCTL_GET_DEVICE_INFO _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 1)
 
+// region info flags
+#define MQNIC_REGION_FLAG_WC (1 << 0) // may be mapped write-combined
+
+// or into a region mmap offset to request a write-combined mapping
+#define MQNIC_REGION_OFFSET_WC (1ULL << 39)
+
 // get region information
 struct mqnic_ioctl_region_info {
 	__u32 argsz;
@@ -56,4 +71,74 @@ struct mqnic_ioctl_region_info {
 
 #define MQNIC_IOCTL_GET_REGION_INFO _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 2)
 
+enum {
+	MQNIC_QUEUE_TYPE_EQ = 0,
+	MQNIC_QUEUE_TYPE_CQ = 1,
+	MQNIC_QUEUE_TYPE_TXQ = 2,
+	MQNIC_QUEUE_TYPE_RXQ = 3
+};
+
+// reserve a hardware queue for userspace, released with the file
+struct mqnic_ioctl_queue {
+	__u32 argsz;
+	__u32 flags;
+	__u32 if_index;
+	__u32 type;
+	__u32 index;
+};
+
+#define MQNIC_IOCTL_ALLOC_QUEUE _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 3)
+#define MQNIC_IOCTL_FREE_QUEUE _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 4)
+
+// pin a userspace buffer and map it for device DMA; the buffer must be
+// page aligned and map to one contiguous IOVA range
+struct mqnic_ioctl_dma_map {
+	__u32 argsz;
+	__u32 flags;
+	__u64 vaddr;
+	__u64 size;
+	__u64 iova;
+};
+
+#define MQNIC_IOCTL_DMA_MAP _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 5)
+#define MQNIC_IOCTL_DMA_UNMAP _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 6)
+
+// write a prebuilt image of count 32-bit words from data into a region
+// (same index as region info) starting at offset
+struct mqnic_ioctl_reg_write {
+	__u32 argsz;
+	__u32 flags;
+	__u32 index;
+	__u32 count;
+	__u64 offset;
+	__u64 data;
+};
+
+#define MQNIC_IOCTL_REG_WRITE _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 7)
+
+// capture rule flags
+#define MQNIC_CAPTURE_FLAG_CHANNEL (1 << 0) // queue is an RX channel of the netdev on port
+
+// install a capture rule mirroring matching frames from the ports in
+// port_mask to queue, removed with the file; without the channel flag,
+// queue is an RXQ reserved on this file.  match and mask cover the 16
+// bytes at offset in the frame, and a snaplen of zero captures whole
+// frames.  index is returned, and selects the rule to delete
+struct mqnic_ioctl_capture_rule {
+	__u32 argsz;
+	__u32 flags;
+	__u32 if_index;
+	__u32 index;
+	__u32 port_mask;
+	__u32 port;
+	__u32 queue;
+	__u32 snaplen;
+	__u32 offset;
+	__u8 match[16];
+	__u8 mask[16];
+};
+
+#define MQNIC_IOCTL_ADD_CAPTURE_RULE _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 8)
+#define MQNIC_IOCTL_DEL_CAPTURE_RULE _IO(MQNIC_IOCTL_TYPE, MQNIC_IOCTL_BASE + 9)
+
 #endif /* MQNIC_IOCTL_H */
@@ -18,11 +18,13 @@ int mqnic_irq_init_pcie(struct mqnic_dev *mdev)
 {
 	struct pci_dev *pdev = mdev->pdev;
 	struct device *dev = mdev->dev;
+	struct irq_affinity affd = {0};
 	int ret = 0;
 	int k;
 
-	// Allocate MSI IRQs
-	mdev->irq_count = pci_alloc_irq_vectors(pdev, 1, MQNIC_MAX_IRQ, PCI_IRQ_MSI | PCI_IRQ_MSIX);
+	// Allocate MSI IRQs, spread across CPUs
+	mdev->irq_count = pci_alloc_irq_vectors_affinity(pdev, 1, MQNIC_MAX_IRQ,
+			PCI_IRQ_MSI | PCI_IRQ_MSIX | PCI_IRQ_AFFINITY, &affd);
 	if (mdev->irq_count < 0) {
 		dev_err(dev, "Failed to allocate IRQs");
 		return -ENOMEM;
@@ -51,6 +53,11 @@ int mqnic_irq_init_pcie(struct mqnic_dev *mdev)
 
 		irq->index = k;
 		irq->irqn = pci_irq_vector(pdev, k);
+		irq->affinity = pci_irq_get_affinity(pdev, k);
+		if (irq->affinity && !cpumask_empty(irq->affinity))
+			irq->node = cpu_to_node(cpumask_first(irq->affinity));
+		else
+			irq->node = dev_to_node(dev);
 		mdev->irq[k] = irq;
 	}
 
@@ -112,6 +119,8 @@ int mqnic_irq_init_platform(struct mqnic_dev *mdev)
 
 		irq->index = k;
 		irq->irqn = irqn;
+		irq->node = dev_to_node(dev);
+		irq->affinity = NULL;
 		mdev->irq[k] = irq;
 	}
 
@@ -119,3 +128,44 @@ int mqnic_irq_init_platform(struct mqnic_dev *mdev)
 
 	return 0;
 }
+
+// attach nb to IRQ vector index alongside any EQs on it; called from hard
+// IRQ context, so the callback must not sleep and must tolerate interrupts
+// raised for other users of the vector
+int mqnic_irq_register_notifier(struct mqnic_dev *mdev, int index,
+		struct notifier_block *nb)
+{
+	if (index < 0 || index >= mdev->irq_count || !mdev->irq[index])
+		return -EINVAL;
+
+	return atomic_notifier_chain_register(&mdev->irq[index]->nh, nb);
+}
+EXPORT_SYMBOL(mqnic_irq_register_notifier);
+
+void mqnic_irq_unregister_notifier(struct mqnic_dev *mdev, int index,
+		struct notifier_block *nb)
+{
+	if (index < 0 || index >= mdev->irq_count || !mdev->irq[index])
+		return;
+
+	atomic_notifier_chain_unregister(&mdev->irq[index]->nh, nb);
+}
+EXPORT_SYMBOL(mqnic_irq_unregister_notifier);
+
+void *mqnic_dma_alloc_coherent_node(struct device *dev, size_t size,
+		dma_addr_t *dma_handle, int node)
+{
+	int orig_node = dev_to_node(dev);
+	void *buf;
+
+	// the DMA API allocates on the device node; point it at the
+	// node servicing the queue for the duration of the allocation
+	set_dev_node(dev, node);
+	buf = dma_alloc_coherent(dev, size, dma_handle, GFP_KERNEL);
+	set_dev_node(dev, orig_node);
+
+	if (!buf)
+		buf = dma_alloc_coherent(dev, size, dma_handle, GFP_KERNEL);
+
+	return buf;
+}
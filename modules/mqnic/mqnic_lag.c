@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+/*
+ * Hardware link aggregation across the ports of one interface.
+ *
+ * While every port of the interface is a slave of the same bond, in
+ * active-backup or a transmit hash mode, the LAG block takes over port
+ * selection: frames from the TX queues of any member leave on an active
+ * member picked by the flow hash, or on the active port, and a member that
+ * loses link is skipped by the hardware before the bond notices.  The
+ * active set follows the bond's view of each slave.
+ *
+ * On RX the members share one RSS indirection table, programmed into each
+ * member port with that member's own queues, so a flow lands on the same
+ * queue slot, and with per-CPU EQs on the same CPU, whichever port it
+ * arrives on.  Frames still come up on the netdev of the port they arrived
+ * on, which LACP and the bond's RX path rely on.
+ */
+
+static struct mqnic_priv *mqnic_lag_find_priv(struct mqnic_if *interface,
+		struct net_device *ndev)
+{
+	struct mqnic_priv *priv;
+
+	list_for_each_entry(priv, &interface->ndev_list, ndev_list)
+		if (priv->ndev == ndev)
+			return priv;
+
+	return NULL;
+}
+
+static bool mqnic_lag_hash_ctrl(enum netdev_lag_hash hash_type, u32 *ctrl)
+{
+	switch (hash_type) {
+	case NETDEV_LAG_HASH_L2:
+		*ctrl = MQNIC_LAG_CTRL_HASH_L2;
+		return true;
+	case NETDEV_LAG_HASH_L23:
+	case NETDEV_LAG_HASH_E23:
+		*ctrl = MQNIC_LAG_CTRL_HASH_L23;
+		return true;
+	case NETDEV_LAG_HASH_L34:
+	case NETDEV_LAG_HASH_E34:
+		*ctrl = MQNIC_LAG_CTRL_HASH_L34;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool mqnic_lag_get_ctrl(struct mqnic_if *interface, u32 *ctrl)
+{
+	struct mqnic_priv *first, *priv;
+	u32 hash;
+
+	if (!interface->lag_rb || interface->ndev_count < 2)
+		return false;
+
+	first = list_first_entry(&interface->ndev_list, struct mqnic_priv, ndev_list);
+
+	if (!first->lag_upper)
+		return false;
+
+	// the shared indirection table indexes every member's queues
+	list_for_each_entry(priv, &interface->ndev_list, ndev_list)
+		if (priv->lag_upper != first->lag_upper || priv->rxq_count != first->rxq_count)
+			return false;
+
+	switch (interface->lag_tx_type) {
+	case NETDEV_LAG_TX_TYPE_ACTIVEBACKUP:
+		*ctrl = MQNIC_LAG_CTRL_EN | MQNIC_LAG_CTRL_MODE_ACTIVE_BACKUP;
+		return true;
+	case NETDEV_LAG_TX_TYPE_HASH:
+		if (!mqnic_lag_hash_ctrl(interface->lag_hash_type, &hash))
+			return false;
+		*ctrl = MQNIC_LAG_CTRL_EN | MQNIC_LAG_CTRL_MODE_HASH | hash;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void mqnic_lag_share_indir_table(struct mqnic_if *interface, struct mqnic_priv *src)
+{
+	struct mqnic_priv *priv;
+
+	list_for_each_entry(priv, &interface->ndev_list, ndev_list) {
+		if (priv == src)
+			continue;
+
+		memcpy(priv->rx_queue_map_indir_table, src->rx_queue_map_indir_table,
+				src->rx_queue_map_indir_table_size * sizeof(*src->rx_queue_map_indir_table));
+		mqnic_update_indir_table(priv->ndev);
+	}
+}
+
+// caller holds RTNL
+void mqnic_lag_update(struct mqnic_if *interface)
+{
+	struct mqnic_priv *priv;
+	u32 members = 0;
+	u32 active = 0;
+	u32 ctrl = 0;
+
+	if (!interface->lag_rb)
+		return;
+
+	if (!mqnic_lag_get_ctrl(interface, &ctrl)) {
+		if (interface->lag_offload) {
+			iowrite32(0, interface->lag_rb->regs + MQNIC_RB_LAG_REG_CTRL);
+			iowrite32(0, interface->lag_rb->regs + MQNIC_RB_LAG_REG_MEMBERS);
+			iowrite32(0, interface->lag_rb->regs + MQNIC_RB_LAG_REG_ACTIVE);
+			interface->lag_offload = false;
+			dev_info(interface->dev, "Hardware LAG disabled on interface %d", interface->index);
+		}
+		return;
+	}
+
+	list_for_each_entry(priv, &interface->ndev_list, ndev_list) {
+		members |= BIT(priv->port->index);
+		if (priv->lag_tx_enabled)
+			active |= BIT(priv->port->index);
+	}
+
+	iowrite32(members, interface->lag_rb->regs + MQNIC_RB_LAG_REG_MEMBERS);
+	iowrite32(active, interface->lag_rb->regs + MQNIC_RB_LAG_REG_ACTIVE);
+	iowrite32(ctrl, interface->lag_rb->regs + MQNIC_RB_LAG_REG_CTRL);
+
+	if (!interface->lag_offload) {
+		mqnic_lag_share_indir_table(interface,
+				list_first_entry(&interface->ndev_list, struct mqnic_priv, ndev_list));
+		interface->lag_offload = true;
+		dev_info(interface->dev, "Hardware LAG enabled on interface %d", interface->index);
+	}
+}
+
+// caller holds RTNL
+int mqnic_lag_update_indir_table(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	if (priv->interface->lag_offload)
+		mqnic_lag_share_indir_table(priv->interface, priv);
+
+	return mqnic_update_indir_table(ndev);
+}
+
+static int mqnic_lag_netdev_event(struct notifier_block *nb, unsigned long event, void *ptr)
+{
+	struct mqnic_if *interface = container_of(nb, struct mqnic_if, lag_nb);
+	struct net_device *ndev = netdev_notifier_info_to_dev(ptr);
+	struct netdev_notifier_changelowerstate_info *lower_info;
+	struct netdev_notifier_changeupper_info *upper_info;
+	struct netdev_lag_lower_state_info *lower_state;
+	struct netdev_lag_upper_info *lag_info;
+	struct mqnic_priv *priv;
+
+	priv = mqnic_lag_find_priv(interface, ndev);
+	if (!priv)
+		return NOTIFY_DONE;
+
+	switch (event) {
+	case NETDEV_CHANGEUPPER:
+		upper_info = ptr;
+
+		if (!netif_is_lag_master(upper_info->upper_dev))
+			break;
+
+		if (upper_info->linking) {
+			lag_info = upper_info->upper_info;
+
+			priv->lag_upper = upper_info->upper_dev;
+			if (lag_info) {
+				interface->lag_tx_type = lag_info->tx_type;
+				interface->lag_hash_type = lag_info->hash_type;
+			}
+		} else {
+			priv->lag_upper = NULL;
+			priv->lag_tx_enabled = false;
+		}
+
+		mqnic_lag_update(interface);
+		break;
+	case NETDEV_CHANGELOWERSTATE:
+		lower_info = ptr;
+		lower_state = lower_info->lower_state_info;
+
+		if (!netif_is_lag_port(ndev) || !lower_state)
+			break;
+
+		priv->lag_tx_enabled = lower_state->link_up && lower_state->tx_enabled;
+
+		mqnic_lag_update(interface);
+		break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+int mqnic_lag_init(struct mqnic_if *interface)
+{
+	int ret;
+
+	if (!interface->lag_rb || interface->ndev_count < 2)
+		return 0;
+
+	interface->lag_nb.notifier_call = mqnic_lag_netdev_event;
+
+	ret = register_netdevice_notifier(&interface->lag_nb);
+	if (ret) {
+		interface->lag_nb.notifier_call = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+
+void mqnic_lag_deinit(struct mqnic_if *interface)
+{
+	if (!interface->lag_nb.notifier_call)
+		return;
+
+	unregister_netdevice_notifier(&interface->lag_nb);
+	interface->lag_nb.notifier_call = NULL;
+
+	iowrite32(0, interface->lag_rb->regs + MQNIC_RB_LAG_REG_CTRL);
+	interface->lag_offload = false;
+}
@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+/*
+ * Per-queue latency telemetry, debugfs mqnic/<netdev>/latency:
+ *   write 1 to reset the histograms and start recording, 0 to stop
+ *   read for one line per queue with count, mean, p50/p99/p999 bucket
+ *   upper bounds and the nonzero log2 buckets
+ *
+ * TX measures doorbell write to the hardware completion timestamp, RX the
+ * hardware arrival timestamp to the start of the NAPI poll that picks the
+ * frame up. Host times are moved onto the PHC timescale with an offset that
+ * is re-measured every MQNIC_LAT_CAL_MS, so the results are only as good as
+ * that offset; samples that come out negative are counted as early.
+ */
+
+#define MQNIC_LAT_CAL_MS 100
+
+DEFINE_STATIC_KEY_FALSE(mqnic_lat_key);
+
+// PHC ToD minus CLOCK_MONOTONIC, taken around the snapshot latch read
+static s64 mqnic_lat_phc_offset(struct mqnic_dev *mdev)
+{
+	u64 phc_ns, mono_ns;
+
+	if (mqnic_phc_read_time(mdev, &phc_ns, &mono_ns))
+		return 0;
+
+	return (s64)phc_ns - (s64)mono_ns;
+}
+
+static void mqnic_lat_work(struct work_struct *work)
+{
+	struct mqnic_priv *priv = container_of(to_delayed_work(work), struct mqnic_priv, lat_work);
+
+	WRITE_ONCE(priv->lat_phc_offset, mqnic_lat_phc_offset(priv->mdev));
+
+	schedule_delayed_work(&priv->lat_work, msecs_to_jiffies(MQNIC_LAT_CAL_MS));
+}
+
+void mqnic_lat_tx_doorbell(struct mqnic_ring *ring)
+{
+	u64 now = ktime_get_ns();
+	u32 ptr;
+
+	// everything behind this doorbell becomes visible to the NIC now
+	for (ptr = ring->db_prod_ptr; ptr != ring->prod_ptr; ptr++)
+		ring->tx_info[ptr & ring->size_mask].db_ns = now;
+}
+
+static void mqnic_lat_reset_ring(struct mqnic_ring *ring)
+{
+	memset(ring->lat_hist, 0, sizeof(ring->lat_hist));
+	ring->lat_count = 0;
+	ring->lat_sum_ns = 0;
+	ring->lat_early = 0;
+}
+
+// caller holds mdev->state_lock
+static int mqnic_lat_enable(struct mqnic_priv *priv, bool enable)
+{
+	int k;
+
+	if (enable == priv->lat_enabled)
+		return 0;
+
+	if (enable) {
+		if (!priv->mdev->phc_rb || !(priv->if_features & MQNIC_IF_FEATURE_PTP_TS))
+			return -EOPNOTSUPP;
+
+		// rings set up later start out zeroed
+		if (priv->port_up) {
+			for (k = 0; k < priv->txq_count; k++)
+				mqnic_lat_reset_ring(priv->txq_table[k]);
+			for (k = 0; k < priv->rxq_count; k++)
+				mqnic_lat_reset_ring(priv->rxq_table[k]);
+		}
+
+		priv->lat_phc_offset = mqnic_lat_phc_offset(priv->mdev);
+		schedule_delayed_work(&priv->lat_work, msecs_to_jiffies(MQNIC_LAT_CAL_MS));
+
+		static_branch_inc(&mqnic_lat_key);
+		WRITE_ONCE(priv->lat_enabled, true);
+	} else {
+		WRITE_ONCE(priv->lat_enabled, false);
+		static_branch_dec(&mqnic_lat_key);
+
+		cancel_delayed_work_sync(&priv->lat_work);
+	}
+
+	return 0;
+}
+
+static u64 mqnic_lat_percentile(const u32 *hist, u64 count, unsigned int permille)
+{
+	u64 target = div_u64(count * permille + 999, 1000);
+	u64 sum = 0;
+	int k;
+
+	for (k = 0; k < MQNIC_LAT_HIST_BUCKETS; k++) {
+		sum += hist[k];
+		if (sum >= target)
+			return k ? 1ULL << k : 0;
+	}
+
+	return 1ULL << (MQNIC_LAT_HIST_BUCKETS - 1);
+}
+
+static void mqnic_lat_show_ring(struct seq_file *s, const char *type, int index,
+		struct mqnic_ring *ring)
+{
+	u32 hist[MQNIC_LAT_HIST_BUCKETS];
+	u64 count = READ_ONCE(ring->lat_count);
+	u64 sum = READ_ONCE(ring->lat_sum_ns);
+	int k;
+
+	memcpy(hist, ring->lat_hist, sizeof(hist));
+
+	seq_printf(s, "%s %d: count=%llu early=%llu mean_ns=%llu p50_ns=%llu p99_ns=%llu p999_ns=%llu hist=",
+			type, index, count, READ_ONCE(ring->lat_early),
+			count ? div64_u64(sum, count) : 0,
+			mqnic_lat_percentile(hist, count, 500),
+			mqnic_lat_percentile(hist, count, 990),
+			mqnic_lat_percentile(hist, count, 999));
+
+	// bucket k counts samples below 2^k ns
+	for (k = 0; k < MQNIC_LAT_HIST_BUCKETS; k++) {
+		if (hist[k])
+			seq_printf(s, "%llu:%u,", k ? 1ULL << k : 0, hist[k]);
+	}
+
+	seq_puts(s, "\n");
+}
+
+static int mqnic_lat_show(struct seq_file *s, void *data)
+{
+	struct mqnic_priv *priv = s->private;
+	int k;
+
+	mutex_lock(&priv->mdev->state_lock);
+
+	seq_printf(s, "enabled=%d phc_offset_ns=%lld\n", priv->lat_enabled,
+			READ_ONCE(priv->lat_phc_offset));
+
+	if (priv->port_up) {
+		for (k = 0; k < priv->txq_count; k++)
+			mqnic_lat_show_ring(s, "txq", k, priv->txq_table[k]);
+		for (k = 0; k < priv->rxq_count; k++)
+			mqnic_lat_show_ring(s, "rxq", k, priv->rxq_table[k]);
+	}
+
+	mutex_unlock(&priv->mdev->state_lock);
+
+	return 0;
+}
+
+static int mqnic_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mqnic_lat_show, inode->i_private);
+}
+
+static ssize_t mqnic_lat_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct mqnic_priv *priv = ((struct seq_file *)file->private_data)->private;
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(buf, count, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&priv->mdev->state_lock);
+	ret = mqnic_lat_enable(priv, enable);
+	mutex_unlock(&priv->mdev->state_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations mqnic_lat_fops = {
+	.owner = THIS_MODULE,
+	.open = mqnic_lat_open,
+	.read = seq_read,
+	.write = mqnic_lat_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void mqnic_lat_create_debugfs(struct mqnic_priv *priv)
+{
+	INIT_DELAYED_WORK(&priv->lat_work, mqnic_lat_work);
+
+	debugfs_create_file("latency", 0600, priv->debugfs_dir, priv, &mqnic_lat_fops);
+}
+
+void mqnic_lat_destroy(struct mqnic_priv *priv)
+{
+	mutex_lock(&priv->mdev->state_lock);
+	mqnic_lat_enable(priv, false);
+	mutex_unlock(&priv->mdev->state_lock);
+}
@@ -4,6 +4,10 @@
  */
 
 #include "mqnic.h"
+
+#define CREATE_TRACE_POINTS
+#include "mqnic_trace.h"
+
 #include <linux/module.h>
 #include <linux/version.h>
 #include <linux/delay.h>
@@ -37,6 +41,48 @@ module_param_named(link_status_poll, mqnic_link_status_poll, uint, 0444);
 MODULE_PARM_DESC(link_status_poll,
 		 "link status polling interval, in ms (default: 1000; 0 to turn off)");
 
+unsigned int mqnic_per_cpu_eq;
+
+module_param_named(per_cpu_eq, mqnic_per_cpu_eq, uint, 0444);
+MODULE_PARM_DESC(per_cpu_eq,
+		 "create one EQ per online CPU on its own IRQ vector (default: 0)");
+
+unsigned int mqnic_napi_threaded;
+
+module_param_named(napi_threaded, mqnic_napi_threaded, uint, 0444);
+MODULE_PARM_DESC(napi_threaded,
+		 "poll queues from kernel threads instead of softirq (default: 0)");
+
+unsigned int mqnic_tx_push;
+
+module_param_named(tx_push, mqnic_tx_push, uint, 0444);
+MODULE_PARM_DESC(tx_push,
+		 "write TX descriptors through the BAR when supported (default: 0)");
+
+unsigned int mqnic_mod_dom_ttl = 1000;
+
+module_param_named(mod_dom_ttl, mqnic_mod_dom_ttl, uint, 0644);
+MODULE_PARM_DESC(mod_dom_ttl,
+		 "module EEPROM monitor page cache lifetime, in ms (default: 1000; 0 to turn off)");
+
+unsigned int mqnic_mod_static_ttl = 60000;
+
+module_param_named(mod_static_ttl, mqnic_mod_static_ttl, uint, 0644);
+MODULE_PARM_DESC(mod_static_ttl,
+		 "module EEPROM static page cache lifetime, in ms (default: 60000; 0 to turn off)");
+
+unsigned int mqnic_sriov_vf_queues = 4;
+
+module_param_named(sriov_vf_queues, mqnic_sriov_vf_queues, uint, 0644);
+MODULE_PARM_DESC(sriov_vf_queues,
+		 "TX and RX queues assigned to each SR-IOV VF when VFs are enabled (default: 4)");
+
+unsigned int mqnic_stats_dma_interval;
+
+module_param_named(stats_dma_interval, mqnic_stats_dma_interval, uint, 0444);
+MODULE_PARM_DESC(stats_dma_interval,
+		 "statistics write-back to host memory interval, in us, when supported (default: 0; 0 to turn off)");
+
 
 #ifdef CONFIG_PCI
 static const struct pci_device_id mqnic_pci_id_table[] = {
@@ -215,6 +261,21 @@ static void mqnic_adev_release(struct device *dev)
 }
 #endif
 
+static void mqnic_board_init_work(struct work_struct *work)
+{
+	struct mqnic_dev *mqnic = container_of(work, struct mqnic_dev, board_work);
+
+	mqnic->board_ret = mqnic_board_init(mqnic);
+}
+
+// board init runs alongside interface setup; wait for it before using MACs or I2C clients
+int mqnic_board_wait(struct mqnic_dev *mqnic)
+{
+	flush_work(&mqnic->board_work);
+
+	return mqnic->board_ret;
+}
+
 static int mqnic_common_probe(struct mqnic_dev *mqnic)
 {
 	int ret = 0;
@@ -225,6 +286,11 @@ static int mqnic_common_probe(struct mqnic_dev *mqnic)
 
 	int k = 0;
 
+	INIT_WORK(&mqnic->board_work, mqnic_board_init_work);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+	INIT_WORK(&mqnic->rate_work, mqnic_devlink_rate_work);
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
 	devlink_register(devlink);
 #else
@@ -300,6 +366,8 @@ static int mqnic_common_probe(struct mqnic_dev *mqnic)
 
 	mqnic->phc_rb = mqnic_find_reg_block(mqnic->rb_list, MQNIC_RB_PHC_TYPE, MQNIC_RB_PHC_VER, 0);
 
+	mqnic_sriov_init(mqnic);
+
 	// Enumerate interfaces
 	mqnic->if_rb = mqnic_find_reg_block(mqnic->rb_list, MQNIC_RB_IF_TYPE, MQNIC_RB_IF_VER, 0);
 
@@ -327,6 +395,8 @@ static int mqnic_common_probe(struct mqnic_dev *mqnic)
 		goto fail_bar_size;
 	}
 
+	mqnic->if_count = min_t(u32, mqnic->if_count, MQNIC_MAX_IF);
+
 	if (mqnic->pfdev) {
 #ifdef CONFIG_OF
 		ret = mqnic_platform_get_mac_address(mqnic);
@@ -337,26 +407,33 @@ static int mqnic_common_probe(struct mqnic_dev *mqnic)
 		if (ret)
 			goto fail_board;
 #endif
-	} else {
-		// Board-specific init
-		ret = mqnic_board_init(mqnic);
-		if (ret) {
-			dev_err(dev, "Failed to initialize board");
+	} else if (mqnic_sriov_is_vf(mqnic)) {
+		ret = mqnic_sriov_vf_init(mqnic);
+		if (ret)
 			goto fail_board;
-		}
+	} else {
+		// Board-specific init, mostly slow bit-banged I2C; the first
+		// netdev waits for it to get its MAC address
+		schedule_work(&mqnic->board_work);
 	}
 
+	seqlock_init(&mqnic->tod_lock);
+	spin_lock_init(&mqnic->phc_snap_lock);
+
 	// register PHC
 	if (mqnic->phc_rb)
 		mqnic_register_phc(mqnic);
 
 	mutex_init(&mqnic->state_lock);
+	INIT_LIST_HEAD(&mqnic->rate_list);
+
+	// datapath defaults, before the interfaces that read them
+	if (mqnic_devlink_params_register(mqnic))
+		dev_warn(dev, "Failed to register devlink params");
 
 	// Set up interfaces
 	mqnic->phys_port_max = 0;
 
-	mqnic->if_count = min_t(u32, mqnic->if_count, MQNIC_MAX_IF);
-
 	for (k = 0; k < mqnic->if_count; k++) {
 		struct mqnic_if *interface;
 		dev_info(dev, "Creating interface %d", k);
@@ -368,6 +445,12 @@ static int mqnic_common_probe(struct mqnic_dev *mqnic)
 		mqnic->interface[k] = interface;
 	}
 
+	ret = mqnic_board_wait(mqnic);
+	if (ret) {
+		dev_err(dev, "Failed to initialize board");
+		goto fail_board;
+	}
+
 	// pass module I2C clients to interface instances
 	for (k = 0; k < mqnic->if_count; k++) {
 		struct mqnic_priv *priv;
@@ -459,6 +542,13 @@ static void mqnic_common_remove(struct mqnic_dev *mqnic)
 	if (mqnic->misc_dev.this_device)
 		misc_deregister(&mqnic->misc_dev);
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+	// user-created rate nodes, before the leaves under them go away
+	devl_lock(devlink);
+	devl_rate_nodes_destroy(devlink);
+	devl_unlock(devlink);
+#endif
+
 	for (k = 0; k < ARRAY_SIZE(mqnic->interface); k++) {
 		if (mqnic->interface[k]) {
 			mqnic_destroy_interface(mqnic->interface[k]);
@@ -466,7 +556,12 @@ static void mqnic_common_remove(struct mqnic_dev *mqnic)
 		}
 	}
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+	cancel_work_sync(&mqnic->rate_work);
+#endif
+
 	mqnic_unregister_phc(mqnic);
+	flush_work(&mqnic->board_work);
 	if (mqnic->pfdev) {
 #ifdef CONFIG_OF
 		mqnic_platform_module_eeprom_put(mqnic);
@@ -474,9 +569,11 @@ static void mqnic_common_remove(struct mqnic_dev *mqnic)
 	} else {
 		mqnic_board_deinit(mqnic);
 	}
+	mqnic_stats_deinit(mqnic);
 	if (mqnic->rb_list)
 		mqnic_free_reg_block_list(mqnic->rb_list);
 
+	mqnic_devlink_params_unregister(mqnic);
 	devlink_unregister(devlink);
 }
 
@@ -618,6 +715,12 @@ static int mqnic_pci_probe(struct pci_dev *pdev, const struct pci_device_id *ent
 		}
 	}
 
+	if (mqnic->app_hw_regs_size && (pci_resource_flags(pdev, 2) & IORESOURCE_PREFETCH)) {
+		mqnic->app_hw_addr_wc = pci_ioremap_wc_bar(pdev, 2);
+		if (!mqnic->app_hw_addr_wc)
+			dev_warn(dev, "Failed to map application BAR write-combined");
+	}
+
 	if (mqnic->ram_hw_regs_size) {
 		dev_info(dev, "RAM BAR size: %llu", mqnic->ram_hw_regs_size);
 		mqnic->ram_hw_addr = pci_ioremap_bar(pdev, 4);
@@ -628,6 +731,12 @@ static int mqnic_pci_probe(struct pci_dev *pdev, const struct pci_device_id *ent
 		}
 	}
 
+	if (mqnic->ram_hw_regs_size && (pci_resource_flags(pdev, 4) & IORESOURCE_PREFETCH)) {
+		mqnic->ram_hw_addr_wc = pci_ioremap_wc_bar(pdev, 4);
+		if (!mqnic->ram_hw_addr_wc)
+			dev_warn(dev, "Failed to map RAM BAR write-combined");
+	}
+
 	// Check if device needs to be reset
 	if (ioread32(mqnic->hw_addr+4) == 0xffffffff) {
 		ret = -EIO;
@@ -645,6 +754,12 @@ static int mqnic_pci_probe(struct pci_dev *pdev, const struct pci_device_id *ent
 	// Enable bus mastering for DMA
 	pci_set_master(pdev);
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 13, 0)
+	// PTM lets the PHC correlate its time with the host clock
+	if (!pci_enable_ptm(pdev, NULL))
+		dev_info(dev, "PCIe PTM enabled");
+#endif
+
 	// Common init
 	ret = mqnic_common_probe(mqnic);
 	if (ret)
@@ -666,6 +781,10 @@ fail_map_bars:
 		pci_iounmap(pdev, mqnic->app_hw_addr);
 	if (mqnic->ram_hw_addr)
 		pci_iounmap(pdev, mqnic->ram_hw_addr);
+	if (mqnic->app_hw_addr_wc)
+		iounmap(mqnic->app_hw_addr_wc);
+	if (mqnic->ram_hw_addr_wc)
+		iounmap(mqnic->ram_hw_addr_wc);
 	pci_release_regions(pdev);
 fail_regions:
 	pci_disable_device(pdev);
@@ -683,6 +802,7 @@ static void mqnic_pci_remove(struct pci_dev *pdev)
 
 	dev_info(&pdev->dev, DRIVER_NAME " PCI remove");
 
+	mqnic_sriov_disable(mqnic);
 	mqnic_common_remove(mqnic);
 
 	pci_clear_master(pdev);
@@ -693,6 +813,10 @@ static void mqnic_pci_remove(struct pci_dev *pdev)
 		pci_iounmap(pdev, mqnic->app_hw_addr);
 	if (mqnic->ram_hw_addr)
 		pci_iounmap(pdev, mqnic->ram_hw_addr);
+	if (mqnic->app_hw_addr_wc)
+		iounmap(mqnic->app_hw_addr_wc);
+	if (mqnic->ram_hw_addr_wc)
+		iounmap(mqnic->ram_hw_addr_wc);
 	pci_release_regions(pdev);
 	pci_disable_device(pdev);
 	mqnic_free_id(mqnic);
@@ -711,7 +835,13 @@ static struct pci_driver mqnic_pci_driver = {
 	.id_table = mqnic_pci_id_table,
 	.probe = mqnic_pci_probe,
 	.remove = mqnic_pci_remove,
-	.shutdown = mqnic_pci_shutdown
+	.shutdown = mqnic_pci_shutdown,
+	.sriov_configure = mqnic_sriov_configure,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 2, 0)
+	.driver = {
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+	},
+#endif
 };
 #endif /* CONFIG_PCI */
 
@@ -863,6 +993,9 @@ static struct platform_driver mqnic_platform_driver = {
 	.driver = {
 		.name = DRIVER_NAME,
 		.of_match_table = of_match_ptr(mqnic_of_id_table),
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 2, 0)
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+#endif
 	},
 };
 
@@ -870,10 +1003,12 @@ static int __init mqnic_init(void)
 {
 	int rc;
 
+	mqnic_debugfs_init();
+
 #ifdef CONFIG_PCI
 	rc = pci_register_driver(&mqnic_pci_driver);
 	if (rc)
-		return rc;
+		goto err_debugfs;
 #endif
 
 	rc = platform_driver_register(&mqnic_platform_driver);
@@ -885,7 +1020,9 @@ static int __init mqnic_init(void)
 err:
 #ifdef CONFIG_PCI
 	pci_unregister_driver(&mqnic_pci_driver);
+err_debugfs:
 #endif
+	mqnic_debugfs_exit();
 	return rc;
 }
 
@@ -897,6 +1034,8 @@ static void __exit mqnic_exit(void)
 	pci_unregister_driver(&mqnic_pci_driver);
 #endif
 
+	mqnic_debugfs_exit();
+
 	ida_destroy(&mqnic_instance_ida);
 }
 
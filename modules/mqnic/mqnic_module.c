@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+/*
+ * Module EEPROM cache, one per interface, in 128 byte half pages.
+ *
+ * The lower half of each I2C address holds the live monitors (QSFP lower
+ * page, SFP A2h diagnostics) and expires after mod_dom_ttl ms; upper pages
+ * are static and expire after mod_static_ttl ms, or as soon as the
+ * identifier byte changes.  While a DOM half page keeps being read, a
+ * refresher re-reads it in the background, so regular polling is served
+ * from memory instead of waiting on the bit-banged bus.  A TTL of 0 turns
+ * caching off for that class.
+ */
+
+// refresher stops once nobody has read a half page for this many DOM TTLs
+#define MQNIC_MOD_REFRESH_IDLE 10
+
+static bool mqnic_mod_is_qsfp(u8 id)
+{
+	return id == SFF_MODULE_ID_QSFP || id == SFF_MODULE_ID_QSFP_PLUS ||
+		id == SFF_MODULE_ID_QSFP28;
+}
+
+static unsigned long mqnic_mod_ttl(struct mqnic_mod_page *p)
+{
+	return msecs_to_jiffies(p->upper ? mqnic_mod_static_ttl : mqnic_mod_dom_ttl);
+}
+
+// caller holds mod_lock
+static int mqnic_mod_fill(struct mqnic_if *interface, struct mqnic_mod_page *p)
+{
+	struct i2c_client *client = interface->mod_i2c_client;
+	unsigned short orig_i2c_addr;
+	u8 d;
+	int ret = 0;
+	int k;
+
+	if (!client)
+		return -EINVAL;
+
+	p->valid = false;
+
+	orig_i2c_addr = client->addr;
+	client->addr = p->i2c_addr;
+
+	if (p->upper && p->i2c_addr == 0x50 && mqnic_mod_is_qsfp(interface->mod_cache[0].data[0])) {
+		// select page
+		d = p->page;
+		ret = i2c_smbus_write_i2c_block_data(client, 127, 1, &d);
+		if (ret < 0)
+			goto out;
+		msleep(1);
+	}
+
+	for (k = 0; k < sizeof(p->data); k += ret) {
+		ret = i2c_smbus_read_i2c_block_data(client, (p->upper ? 128 : 0) + k,
+				min_t(int, sizeof(p->data) - k, I2C_SMBUS_BLOCK_MAX), p->data + k);
+		if (ret < 0)
+			goto out;
+		if (ret == 0) {
+			ret = -EIO;
+			goto out;
+		}
+	}
+
+	ret = 0;
+	p->valid = true;
+	p->updated = jiffies;
+
+out:
+	client->addr = orig_i2c_addr;
+	return ret;
+}
+
+// entry 0 is always the lower half of 0x50, which holds the identifier
+static struct mqnic_mod_page *mqnic_mod_lookup(struct mqnic_if *interface,
+		u8 i2c_addr, u8 page, bool upper)
+{
+	struct mqnic_mod_page *p;
+	struct mqnic_mod_page *victim = NULL;
+	int k;
+
+	if (!upper)
+		page = 0;
+
+	for (k = 0; k < MQNIC_MOD_CACHE_ENTRIES; k++) {
+		p = &interface->mod_cache[k];
+
+		if (p->i2c_addr == i2c_addr && p->page == page && p->upper == upper)
+			return p;
+
+		if (k && (!victim || !p->i2c_addr || (victim->i2c_addr && time_before(p->used, victim->used))))
+			victim = p;
+	}
+
+	victim->i2c_addr = i2c_addr;
+	victim->page = page;
+	victim->upper = upper;
+	victim->valid = false;
+
+	return victim;
+}
+
+static int mqnic_mod_refresh_id(struct mqnic_if *interface)
+{
+	struct mqnic_mod_page *p = &interface->mod_cache[0];
+	u8 old_id = p->valid ? p->data[0] : 0;
+	int ret;
+	int k;
+
+	ret = mqnic_mod_fill(interface, p);
+
+	// module swapped, nothing cached for the old one is any good
+	if (ret || p->data[0] != old_id) {
+		for (k = 1; k < MQNIC_MOD_CACHE_ENTRIES; k++)
+			interface->mod_cache[k].valid = false;
+	}
+
+	return ret;
+}
+
+// caller holds mod_lock
+static int mqnic_mod_get(struct mqnic_if *interface, struct mqnic_mod_page *p)
+{
+	struct mqnic_mod_page *id = &interface->mod_cache[0];
+	int ret;
+
+	p->used = jiffies;
+
+	if (!id->valid || time_after_eq(jiffies, id->updated + msecs_to_jiffies(mqnic_mod_dom_ttl))) {
+		ret = mqnic_mod_refresh_id(interface);
+		if (ret)
+			return ret;
+	}
+
+	if (p != id && (!p->valid || time_after_eq(jiffies, p->updated + mqnic_mod_ttl(p)))) {
+		ret = mqnic_mod_fill(interface, p);
+		if (ret)
+			return ret;
+	}
+
+	// no-op while the refresher is already queued
+	if (!p->upper && mqnic_mod_dom_ttl)
+		schedule_delayed_work(&interface->mod_refresh_work,
+				msecs_to_jiffies(mqnic_mod_dom_ttl));
+
+	return 0;
+}
+
+static void mqnic_mod_refresh_work(struct work_struct *work)
+{
+	struct mqnic_if *interface = container_of(to_delayed_work(work),
+			struct mqnic_if, mod_refresh_work);
+	unsigned long idle = msecs_to_jiffies(mqnic_mod_dom_ttl * MQNIC_MOD_REFRESH_IDLE);
+	struct mqnic_mod_page *p;
+	bool active = false;
+	int k;
+
+	mutex_lock(&interface->mod_lock);
+
+	for (k = 0; k < MQNIC_MOD_CACHE_ENTRIES; k++) {
+		p = &interface->mod_cache[k];
+
+		if (!p->i2c_addr || p->upper || time_after(jiffies, p->used + idle))
+			continue;
+
+		active = true;
+
+		if (k == 0) {
+			if (mqnic_mod_refresh_id(interface))
+				break;
+		} else {
+			mqnic_mod_fill(interface, p);
+		}
+	}
+
+	mutex_unlock(&interface->mod_lock);
+
+	if (active)
+		schedule_delayed_work(&interface->mod_refresh_work,
+				msecs_to_jiffies(mqnic_mod_dom_ttl));
+}
+
+int mqnic_mod_read(struct mqnic_if *interface, u8 i2c_addr, u8 page,
+		u16 offset, u16 len, u8 *data)
+{
+	struct mqnic_mod_page *p;
+	bool upper = offset >= 128;
+	int ret;
+
+	if (!interface->mod_i2c_client)
+		return -EINVAL;
+
+	if (offset >= 256)
+		return -EINVAL;
+
+	// clip request to end of half page
+	offset &= 127;
+	if (offset + len > 128)
+		len = 128 - offset;
+
+	mutex_lock(&interface->mod_lock);
+
+	p = mqnic_mod_lookup(interface, i2c_addr, page, upper);
+
+	ret = mqnic_mod_get(interface, p);
+	if (!ret) {
+		memcpy(data, p->data + offset, len);
+		ret = len;
+	}
+
+	mutex_unlock(&interface->mod_lock);
+
+	return ret;
+}
+
+void mqnic_mod_cache_init(struct mqnic_if *interface)
+{
+	mutex_init(&interface->mod_lock);
+	INIT_DELAYED_WORK(&interface->mod_refresh_work, mqnic_mod_refresh_work);
+
+	// reserved for the identifier half page
+	interface->mod_cache[0].i2c_addr = 0x50;
+}
+
+void mqnic_mod_cache_destroy(struct mqnic_if *interface)
+{
+	cancel_delayed_work_sync(&interface->mod_refresh_work);
+}
@@ -7,6 +7,14 @@
 
 #include <linux/version.h>
 #include <linux/timer.h>
+#ifdef CONFIG_RFS_ACCEL
+#include <linux/cpu_rmap.h>
+#endif
+#include <net/flow_dissector.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+#include <net/xdp_sock_drv.h>
+#endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 16, 0)
 #define mqnic_from_timer(var, callback_timer, timer_fieldname) \
@@ -22,560 +30,2231 @@
 #define mqnic_timer_delete_sync(timer) del_timer_sync(timer)
 #endif
 
-int mqnic_start_port(struct net_device *ndev)
+#ifdef MQNIC_NETMEM
+// every path that builds or tears down queues holds the netdev instance
+// lock, see mqnic_netdev_lock()
+static void mqnic_napi_enable(struct napi_struct *napi)
 {
-	struct mqnic_priv *priv = netdev_priv(ndev);
-	struct mqnic_if *iface = priv->interface;
-	struct mqnic_ring *q;
-	struct mqnic_cq *cq;
-	struct mqnic_eq *eq;
-	struct radix_tree_iter iter;
-	void **slot;
+	napi_enable_locked(napi);
+}
+
+static void mqnic_napi_disable(struct napi_struct *napi)
+{
+	napi_disable_locked(napi);
+}
+#else
+static void mqnic_napi_enable(struct napi_struct *napi)
+{
+	napi_enable(napi);
+}
+
+static void mqnic_napi_disable(struct napi_struct *napi)
+{
+	napi_disable(napi);
+}
+
+#endif
+
+// largest rate configured on any traffic class, used to scale budgets
+static u64 mqnic_tc_ref_rate(struct mqnic_priv *priv)
+{
+	u64 rate = 0;
 	int k;
-	int ret;
-	u32 desc_block_size;
 
-	netdev_info(ndev, "%s on interface %d", __func__, iface->index);
+	for (k = 0; k < netdev_get_num_tc(priv->ndev); k++) {
+		rate = max(rate, priv->tc_min_rate[k]);
+		rate = max(rate, priv->tc_max_rate[k]);
+	}
 
-	netif_set_real_num_tx_queues(ndev, priv->txq_count);
-	netif_set_real_num_rx_queues(ndev, priv->rxq_count);
+	return rate;
+}
+
+// bytes fetched per scheduling decision, weighted by the DCB bandwidth
+// share or else the mqprio minimum rate
+static u32 mqnic_tc_data_budget(struct mqnic_priv *priv, int tc)
+{
+	u32 budget = priv->ndev->mtu + ETH_HLEN;
+	u32 max_budget = 0xffff * priv->sched_port->sched->fc_scale;
+	u64 min_rate = 0;
+	u32 min_bw = 100;
+	int k;
 
-	desc_block_size = min_t(u32, priv->interface->max_desc_block_size, 4);
+	if (tc >= netdev_get_num_tc(priv->ndev))
+		return budget;
 
-	// allocate scheduler port
-	priv->sched_port = mqnic_interface_alloc_sched_port(iface);
-	if (!priv->sched_port) {
-		netdev_err(ndev, "Failed to allocate scheduler");
-		ret = -ENOMEM;
-		goto fail;
+	if (priv->tc_bw[tc]) {
+		for (k = 0; k < netdev_get_num_tc(priv->ndev); k++)
+			if (priv->tc_bw[k] && priv->tc_bw[k] < min_bw)
+				min_bw = priv->tc_bw[k];
+
+		return min_t(u32, budget * priv->tc_bw[tc] / min_bw, max_budget);
 	}
 
-	// set up RX queues
-	for (k = 0; k < priv->rxq_count; k++) {
-		// create CQ
-		cq = mqnic_create_cq(iface);
-		if (IS_ERR_OR_NULL(cq)) {
-			ret = PTR_ERR(cq);
-			goto fail;
-		}
+	if (!priv->tc_min_rate[tc])
+		return budget;
 
-		rcu_read_lock();
-		eq = radix_tree_lookup(&iface->eq_table, k % iface->eq_count);
-		rcu_read_unlock();
+	for (k = 0; k < netdev_get_num_tc(priv->ndev); k++)
+		if (priv->tc_min_rate[k] && (!min_rate || priv->tc_min_rate[k] < min_rate))
+			min_rate = priv->tc_min_rate[k];
 
-		ret = mqnic_open_cq(cq, eq, priv->rx_ring_size);
-		if (ret) {
-			mqnic_destroy_cq(cq);
-			goto fail;
-		}
+	return min_t(u64, div64_u64((u64)budget * priv->tc_min_rate[tc], min_rate), max_budget);
+}
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
-		netif_napi_add(ndev, &cq->napi, mqnic_poll_rx_cq);
-#else
-		netif_napi_add(ndev, &cq->napi, mqnic_poll_rx_cq, NAPI_POLL_WEIGHT);
-#endif
-		napi_enable(&cq->napi);
+// bytes in flight, capped in proportion to the maximum rate
+static u32 mqnic_tc_data_limit(struct mqnic_priv *priv, int tc)
+{
+	u32 limit = priv->interface->tx_fifo_depth;
+	u64 ref_rate;
 
-		mqnic_arm_cq(cq);
+	if (tc >= netdev_get_num_tc(priv->ndev) || !priv->tc_max_rate[tc])
+		return limit;
 
-		// create RX queue
-		q = mqnic_create_rx_ring(iface);
-		if (IS_ERR_OR_NULL(q)) {
-			ret = PTR_ERR(q);
-			mqnic_destroy_cq(cq);
-			goto fail;
-		}
+	ref_rate = mqnic_tc_ref_rate(priv);
 
-		q->mtu = ndev->mtu;
-		if (ndev->mtu + ETH_HLEN <= PAGE_SIZE)
-			q->page_order = 0;
-		else
-			q->page_order = ilog2((ndev->mtu + ETH_HLEN + PAGE_SIZE - 1) / PAGE_SIZE - 1) + 1;
+	return max_t(u64, div64_u64((u64)limit * priv->tc_max_rate[tc], ref_rate),
+			priv->ndev->mtu + ETH_HLEN);
+}
 
-		ret = mqnic_open_rx_ring(q, priv, cq, priv->rx_ring_size, 1);
-		if (ret) {
-			mqnic_destroy_rx_ring(q);
-			mqnic_destroy_cq(cq);
-			goto fail;
-		}
+// bucket depth covering 20 us at the configured rate, and at least two frames
+static u32 mqnic_tx_rate_burst(struct mqnic_priv *priv, u32 rate)
+{
+	return max_t(u32, rate * 5 / 2, 2 * (priv->ndev->mtu + ETH_HLEN));
+}
 
-		down_write(&priv->rxq_table_sem);
-		ret = radix_tree_insert(&priv->rxq_table, k, q);
-		up_write(&priv->rxq_table_sem);
-		if (ret) {
-			mqnic_destroy_rx_ring(q);
-			mqnic_destroy_cq(cq);
-			goto fail;
-		}
-	}
+void mqnic_update_tx_rates(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *q;
+	u32 rate;
+	int k;
+
+	if (!priv->sched_port || !priv->interface->sched_rate_limit)
+		return;
 
-	// set up TX queues
 	for (k = 0; k < priv->txq_count; k++) {
-		// create CQ
-		cq = mqnic_create_cq(iface);
-		if (IS_ERR_OR_NULL(cq)) {
-			ret = PTR_ERR(cq);
-			goto fail;
-		}
+		q = priv->txq_table[k];
+		rate = netdev_get_tx_queue(ndev, k)->tx_maxrate;
 
-		rcu_read_lock();
-		eq = radix_tree_lookup(&iface->eq_table, k % iface->eq_count);
-		rcu_read_unlock();
+		mqnic_sched_port_queue_set_rate(priv->sched_port, q->index, rate,
+				mqnic_tx_rate_burst(priv, rate));
+	}
 
-		ret = mqnic_open_cq(cq, eq, priv->tx_ring_size);
-		if (ret) {
-			mqnic_destroy_cq(cq);
-			goto fail;
-		}
+	// port cap goes on each TC channel of the port
+	rate = min_t(u64, DIV_ROUND_UP_ULL(priv->tx_max_rate * 8, 1000000), U32_MAX);
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
-		netif_napi_add_tx(ndev, &cq->napi, mqnic_poll_tx_cq);
-#else
-		netif_tx_napi_add(ndev, &cq->napi, mqnic_poll_tx_cq, NAPI_POLL_WEIGHT);
-#endif
-		napi_enable(&cq->napi);
+	for (k = 0; k < priv->sched_port->sched->tc_count; k++)
+		mqnic_sched_port_channel_set_rate(priv->sched_port, k, rate,
+				mqnic_tx_rate_burst(priv, rate));
+}
 
-		mqnic_arm_cq(cq);
+// a TX CQ given rx_cq gets no NAPI context and is reaped from that of rx_cq
+static struct mqnic_cq *mqnic_create_queue_cq(struct net_device *ndev, int k, u32 size, bool tx,
+		struct mqnic_cq *rx_cq)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_if *iface = priv->interface;
+	struct mqnic_cq *cq;
+	struct mqnic_eq *eq;
+	int ret;
 
-		// create TX queue
-		q = mqnic_create_tx_ring(iface);
-		if (IS_ERR_OR_NULL(q)) {
-			ret = PTR_ERR(q);
-			mqnic_destroy_cq(cq);
-			goto fail;
-		}
+	cq = mqnic_create_cq(iface);
+	if (IS_ERR_OR_NULL(cq))
+		return cq;
 
-		q->tx_queue = netdev_get_tx_queue(ndev, k);
+	eq = mqnic_interface_select_eq(iface, k);
 
-		ret = mqnic_open_tx_ring(q, priv, cq, priv->tx_ring_size, desc_block_size);
-		if (ret) {
-			mqnic_destroy_tx_ring(q);
-			mqnic_destroy_cq(cq);
-			goto fail;
-		}
+	if (tx)
+		mqnic_cq_set_coalesce(cq, priv->tx_coal_usecs, priv->tx_coal_frames);
+	else
+		mqnic_cq_set_coalesce(cq, priv->rx_coal_usecs, priv->rx_coal_frames);
+#ifdef MQNIC_DIM
+	INIT_WORK(&cq->dim.work, tx ? mqnic_tx_dim_work : mqnic_rx_dim_work);
+	cq->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+#endif
 
-		down_write(&priv->txq_table_sem);
-		ret = radix_tree_insert(&priv->txq_table, k, q);
-		up_write(&priv->txq_table_sem);
-		if (ret) {
-			mqnic_destroy_tx_ring(q);
-			mqnic_destroy_cq(cq);
-			goto fail;
-		}
+	ret = mqnic_open_cq(cq, eq, size);
+	if (ret) {
+		mqnic_destroy_cq(cq);
+		return ERR_PTR(ret);
 	}
 
-	// set MTU
-	mqnic_interface_set_tx_mtu(iface, ndev->mtu + ETH_HLEN);
-	mqnic_interface_set_rx_mtu(iface, ndev->mtu + ETH_HLEN);
+	if (rx_cq) {
+		cq->rx_cq = rx_cq;
+		rx_cq->tx_cq = cq;
+		return cq;
+	}
 
-	// configure RX indirection and RSS
-	mqnic_update_indir_table(ndev);
+	if (tx) {
+#ifdef MQNIC_NETMEM
+		// netif_napi_add_tx() under the instance lock
+		set_bit(NAPI_STATE_NO_BUSY_POLL, &cq->napi.state);
+		netif_napi_add_locked(ndev, &cq->napi, mqnic_poll_tx_cq);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+		netif_napi_add_tx(ndev, &cq->napi, mqnic_poll_tx_cq);
+#else
+		netif_tx_napi_add(ndev, &cq->napi, mqnic_poll_tx_cq, NAPI_POLL_WEIGHT);
+#endif
+	} else {
+#ifdef MQNIC_NETMEM
+		netif_napi_add_locked(ndev, &cq->napi, mqnic_poll_rx_cq);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+		netif_napi_add(ndev, &cq->napi, mqnic_poll_rx_cq);
+#else
+		netif_napi_add(ndev, &cq->napi, mqnic_poll_rx_cq, NAPI_POLL_WEIGHT);
+#endif
+	}
+#ifdef MQNIC_NETMEM
+	netif_napi_set_irq_locked(&cq->napi, eq->irq->irqn);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+	netif_napi_set_irq(&cq->napi, eq->irq->irqn);
+#endif
 
-	priv->port_up = true;
+	return cq;
+}
 
-	// enable TX and RX queues
-	down_read(&priv->txq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->txq_table, &iter, 0) {
-		struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+static void mqnic_destroy_queue_cq(struct mqnic_cq *cq)
+{
+	if (cq->rx_cq)
+		cq->rx_cq->tx_cq = NULL;
+	else
+#ifdef MQNIC_NETMEM
+		netif_napi_del_locked(&cq->napi);
+#else
+		netif_napi_del(&cq->napi);
+#endif
+	mqnic_destroy_cq(cq);
+}
 
-		mqnic_enable_tx_ring(q);
-	}
-	up_read(&priv->txq_table_sem);
+// combined channel k can have its TX ring post into the RX CQ; the
+// zero-copy RX path does not handle TX completions
+static bool mqnic_can_share_cq(struct mqnic_priv *priv, int k)
+{
+	return priv->combined && (priv->if_features & MQNIC_IF_FEATURE_SHARED_CQ) &&
+		k < priv->rxq_count && !test_bit(k, priv->xsk_zc_qps);
+}
 
-	down_read(&priv->rxq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->rxq_table, &iter, 0) {
-		struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+// CQ, NAPI and ring for RX queue k, opened and filled but not enabled
+static struct mqnic_ring *mqnic_create_rx_queue(struct net_device *ndev, int k, u32 size, int index)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_if *iface = priv->interface;
+	struct mqnic_ring *q;
+	struct mqnic_cq *cq;
+	u32 rx_buf_count;
+	u32 rx_buf_len;
+	u32 rx_buf_max;
+	int ret;
 
-		mqnic_enable_rx_ring(q);
+	// a shared CQ holds completions for both rings
+	cq = mqnic_create_queue_cq(ndev, k, mqnic_can_share_cq(priv, k) ?
+			roundup_pow_of_two(size + priv->tx_ring_size) : size, false, NULL);
+	if (IS_ERR_OR_NULL(cq)) {
+		mqnic_res_free(iface->rxq_res, index);
+		return ERR_CAST(cq);
+	}
+
+	q = mqnic_create_rx_ring(iface);
+	if (IS_ERR_OR_NULL(q)) {
+		mqnic_res_free(iface->rxq_res, index);
+		mqnic_destroy_queue_cq(cq);
+		return q;
 	}
-	up_read(&priv->rxq_table_sem);
 
-	mqnic_port_set_tx_ctrl(priv->port, MQNIC_PORT_TX_CTRL_EN);
+	// from here on the ring owns the index and frees it on close
+	q->index = index;
+	q->ndev = ndev;
+	q->mtu = ndev->mtu;
+	q->queue_index = k;
 
-	// configure scheduler
-	down_read(&priv->txq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->txq_table, &iter, 0) {
-		struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	if (test_bit(k, priv->xsk_zc_qps))
+		q->xsk_pool = xsk_get_pool_from_qid(ndev, k);
+#endif
 
-		mqnic_sched_port_queue_set_tc(priv->sched_port, q->index, 0);
-		mqnic_sched_port_queue_enable(priv->sched_port, q->index);
+	if (priv->xdp_prog) {
+		// leave room for XDP to grow headers and build frames in place
+		q->headroom = XDP_PACKET_HEADROOM;
+		q->tailroom = MQNIC_XDP_TAILROOM;
 	}
-	up_read(&priv->txq_table_sem);
 
-	// configure scheduler flow control
-	mqnic_sched_port_channel_set_dest(priv->sched_port, 0, (priv->port->index << 4) | 0);
-	mqnic_sched_port_channel_set_pkt_budget(priv->sched_port, 0, 1);
-	mqnic_sched_port_channel_set_data_budget(priv->sched_port, 0, ndev->mtu + ETH_HLEN);
-	mqnic_sched_port_channel_set_pkt_limit(priv->sched_port, 0, 0xFFFF);
-	mqnic_sched_port_channel_set_data_limit(priv->sched_port, 0, iface->tx_fifo_depth);
+	// scatter jumbo frames across the buffers of a descriptor block
+	// rather than using high-order pages, unless devlink allows larger
+	// buffers; XDP and XSK need one buffer
+	rx_buf_max = priv->mdev->rx_buf_size ? priv->mdev->rx_buf_size : PAGE_SIZE;
+	rx_buf_count = 1;
+	rx_buf_len = ndev->mtu + ETH_HLEN;
+	if (rx_buf_len > rx_buf_max && !priv->xdp_prog && !q->xsk_pool) {
+		rx_buf_count = min_t(u32, DIV_ROUND_UP(rx_buf_len, rx_buf_max),
+				iface->max_rx_desc_block_size);
+		rx_buf_len = DIV_ROUND_UP(rx_buf_len, rx_buf_count);
+	}
 
-	mqnic_sched_port_channel_enable(priv->sched_port, 0);
+#ifdef MQNIC_NETMEM
+	// a header buffer, then page sized payload buffers that a memory
+	// provider bound to the queue can stand in for
+	if (priv->rx_hdr_split && !priv->xdp_prog && !q->xsk_pool) {
+		q->hdr_split = true;
+		rx_buf_count = 1 + min_t(u32, DIV_ROUND_UP(ndev->mtu + ETH_HLEN, PAGE_SIZE),
+				iface->max_rx_desc_block_size - 1);
+		rx_buf_len = PAGE_SIZE;
+	}
+#endif
 
-	// enable scheduler
-	mqnic_sched_port_enable(priv->sched_port);
+	if (rx_buf_len <= PAGE_SIZE)
+		q->page_order = 0;
+	else
+		q->page_order = ilog2((rx_buf_len + PAGE_SIZE - 1) / PAGE_SIZE - 1) + 1;
 
-	netif_tx_start_all_queues(ndev);
-	netif_device_attach(ndev);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	// split pages between two frames when they fit
+	if (priv->mdev->rx_page_split && q->page_order == 0 && !q->hdr_split &&
+			q->headroom + ndev->mtu + ETH_HLEN + q->tailroom <= PAGE_SIZE / 2)
+		q->frag_size = PAGE_SIZE / 2;
+#endif
 
-	if (mqnic_link_status_poll) {
-		priv->link_status = 0;
-		mod_timer(&priv->link_status_timer,
-				jiffies + msecs_to_jiffies(mqnic_link_status_poll));
-	} else {
-		netif_carrier_on(ndev);
+	// enable NAPI first so the ID reported to XDP and busy polling is valid
+	mqnic_napi_enable(&cq->napi);
+
+	ret = mqnic_open_rx_ring(q, priv, cq, size, rx_buf_count);
+	if (ret) {
+		mqnic_napi_disable(&cq->napi);
+		mqnic_destroy_rx_ring(q);
+		mqnic_destroy_queue_cq(cq);
+		return ERR_PTR(ret);
 	}
 
-	mqnic_port_set_rx_ctrl(priv->port, MQNIC_PORT_RX_CTRL_EN);
+	mqnic_arm_cq(cq);
 
-	return 0;
+	return q;
+}
 
-fail:
-	mqnic_stop_port(ndev);
-	return ret;
+// smallest TX block that holds the metadata words the interface uses
+static u32 mqnic_tx_min_desc_block_size(struct mqnic_priv *priv)
+{
+	if (priv->if_features & MQNIC_IF_FEATURE_PTP_ONESTEP)
+		return 4;
+	if (priv->if_features & MQNIC_IF_FEATURE_VLAN_TX)
+		return 3;
+	if (priv->if_features & MQNIC_IF_FEATURE_TX_LAUNCH_TIME)
+		return 2;
+	return 1;
 }
 
-void mqnic_stop_port(struct net_device *ndev)
+// CQ, NAPI and ring for TX queue k, or XDP TX queue k without a netdev queue
+static struct mqnic_ring *mqnic_create_tx_queue(struct net_device *ndev, int k, u32 size,
+		bool xdp, int index)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_if *iface = priv->interface;
+	struct mqnic_ring *q;
 	struct mqnic_cq *cq;
-	struct radix_tree_iter iter;
-	void **slot;
-
-	netdev_info(ndev, "%s on interface %d", __func__, priv->interface->index);
-
-	if (mqnic_link_status_poll)
-		mqnic_timer_delete_sync(&priv->link_status_timer);
+	struct mqnic_cq *rx_cq = NULL;
+	bool shared = false;
+	u32 desc_block_size;
+	int ret;
 
-	mqnic_port_set_rx_ctrl(priv->port, 0);
+	desc_block_size = min_t(u32, iface->max_desc_block_size, 4);
 
-	netif_tx_lock_bh(ndev);
-//	if (detach)
-//		netif_device_detach(ndev);
-	netif_tx_stop_all_queues(ndev);
-	netif_tx_unlock_bh(ndev);
+	// super-packets carry more frags; use the largest supported block
+	if (priv->if_features & MQNIC_IF_FEATURE_TSO)
+		desc_block_size = iface->max_desc_block_size;
 
-	netif_carrier_off(ndev);
-	netif_tx_disable(ndev);
+	// set through devlink, but not below what the metadata words need
+	if (priv->mdev->tx_desc_block_size)
+		desc_block_size = clamp_t(u32, priv->mdev->tx_desc_block_size,
+				mqnic_tx_min_desc_block_size(priv), iface->max_desc_block_size);
 
-	spin_lock_bh(&priv->stats_lock);
-	mqnic_update_stats(ndev);
-	spin_unlock_bh(&priv->stats_lock);
+	if (xdp)
+		desc_block_size = 1;
 
-	if (priv->sched_port) {
-		down_read(&priv->txq_table_sem);
-		radix_tree_for_each_slot(slot, &priv->txq_table, &iter, 0) {
-			struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+	// combined channels pair TX queue k with RX queue k, set up first
+	if (priv->combined && !xdp && k < priv->rxq_count && priv->rxq_table[k])
+		rx_cq = priv->rxq_table[k]->cq;
 
-			mqnic_sched_port_queue_disable(priv->sched_port, q->index);
+	if (rx_cq && mqnic_can_share_cq(priv, k)) {
+		// post straight into the RX CQ, already armed and polled
+		shared = true;
+		cq = rx_cq;
+		rx_cq = NULL;
+	} else {
+		cq = mqnic_create_queue_cq(ndev, k, size, true, rx_cq);
+		if (IS_ERR_OR_NULL(cq)) {
+			mqnic_res_free(iface->txq_res, index);
+			return ERR_CAST(cq);
 		}
-		up_read(&priv->txq_table_sem);
+	}
 
-		mqnic_sched_port_channel_disable(priv->sched_port, 0);
-		mqnic_sched_port_disable(priv->sched_port);
+	q = mqnic_create_tx_ring(iface);
+	if (IS_ERR_OR_NULL(q)) {
+		mqnic_res_free(iface->txq_res, index);
+		if (!shared)
+			mqnic_destroy_queue_cq(cq);
+		return q;
 	}
 
-	// disable TX and RX queues
-	down_read(&priv->txq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->txq_table, &iter, 0) {
-		struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+	// from here on the ring owns the index and frees it on close
+	q->index = index;
 
-		mqnic_disable_tx_ring(q);
+	if (xdp) {
+		q->tx_queue = NULL;
+		q->queue_index = k;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+		if (test_bit(k, priv->xsk_zc_qps))
+			q->xsk_pool = xsk_get_pool_from_qid(ndev, k);
+#endif
+	} else {
+		q->tx_queue = netdev_get_tx_queue(ndev, k);
 	}
-	up_read(&priv->txq_table_sem);
 
-	down_read(&priv->rxq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->rxq_table, &iter, 0) {
-		struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+	// enable NAPI first so the ID reported to XDP and busy polling is valid
+	if (!rx_cq && !shared)
+		mqnic_napi_enable(&cq->napi);
 
-		mqnic_disable_rx_ring(q);
+	ret = mqnic_open_tx_ring(q, priv, cq, size, desc_block_size);
+	if (ret) {
+		mqnic_destroy_tx_ring(q);
+		if (!shared) {
+			if (!rx_cq)
+				mqnic_napi_disable(&cq->napi);
+			mqnic_destroy_queue_cq(cq);
+		}
+		return ERR_PTR(ret);
 	}
-	up_read(&priv->rxq_table_sem);
 
-	msleep(20);
+	if (!shared)
+		mqnic_arm_cq(cq);
 
-	mqnic_port_set_tx_ctrl(priv->port, 0);
+	return q;
+}
 
-	priv->port_up = false;
+static void mqnic_ring_get_stats(const struct mqnic_ring *ring,
+		u64 *packets, u64 *bytes, u64 *dropped)
+{
+	unsigned int start;
+	u64 p, b, d;
+
+	do {
+		start = u64_stats_fetch_begin(&ring->syncp);
+		p = u64_stats_read(&ring->packets);
+		b = u64_stats_read(&ring->bytes);
+		d = u64_stats_read(&ring->dropped_packets);
+	} while (u64_stats_fetch_retry(&ring->syncp, start));
+
+	*packets += p;
+	*bytes += b;
+	*dropped += d;
+}
 
-	// shut down NAPI and clean queues
-	down_write(&priv->txq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->txq_table, &iter, 0) {
-		struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+// fold counters not yet accounted into the port totals
+static void mqnic_retire_ring_stats(struct mqnic_priv *priv, struct mqnic_ring *q, bool rx)
+{
+	struct rtnl_link_stats64 *stats = &priv->retired_stats;
+	u64 packets = 0, bytes = 0, dropped = 0;
 
-		cq = q->cq;
-		napi_disable(&cq->napi);
-		netif_napi_del(&cq->napi);
-		mqnic_close_tx_ring(q);
-		mqnic_destroy_tx_ring(q);
-		radix_tree_delete(&priv->txq_table, iter.index);
-		mqnic_close_cq(cq);
-		mqnic_destroy_cq(cq);
+	mqnic_ring_get_stats(q, &packets, &bytes, &dropped);
+
+	u64_stats_update_begin(&priv->retired_syncp);
+	if (rx) {
+		stats->rx_packets += packets - q->retired_packets;
+		stats->rx_bytes += bytes - q->retired_bytes;
+		stats->rx_dropped += dropped - q->retired_dropped;
+	} else {
+		stats->tx_packets += packets - q->retired_packets;
+		stats->tx_bytes += bytes - q->retired_bytes;
+		stats->tx_dropped += dropped - q->retired_dropped;
 	}
-	up_write(&priv->txq_table_sem);
+	u64_stats_update_end(&priv->retired_syncp);
 
-	down_write(&priv->rxq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->rxq_table, &iter, 0) {
-		struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+	q->retired_packets = packets;
+	q->retired_bytes = bytes;
+	q->retired_dropped = dropped;
+}
 
-		cq = q->cq;
-		napi_disable(&cq->napi);
-		netif_napi_del(&cq->napi);
-		mqnic_close_rx_ring(q);
-		mqnic_destroy_rx_ring(q);
-		radix_tree_delete(&priv->rxq_table, iter.index);
-		mqnic_close_cq(cq);
-		mqnic_destroy_cq(cq);
+// retire is set when the queue is removed or replaced with the port up
+static void mqnic_destroy_rx_queue(struct mqnic_ring *q, bool retire)
+{
+	struct mqnic_cq *cq = q->cq;
+
+	mqnic_napi_disable(&cq->napi);
+#ifdef MQNIC_DIM
+	cancel_work_sync(&cq->dim.work);
+#endif
+	if (retire)
+		mqnic_retire_ring_stats(q->priv, q, true);
+
+	mqnic_destroy_rx_ring(q);
+	mqnic_destroy_queue_cq(cq);
+}
+
+// keep_bql leaves byte queue limits alone for a replacement ring on the same netdev queue
+static void mqnic_destroy_tx_queue(struct mqnic_ring *q, bool retire, bool keep_bql)
+{
+	struct mqnic_cq *cq = q->cq;
+	bool shared = cq->src_ring != q;
+	// RX NAPI that reaps this ring, through a paired or a shared CQ
+	struct mqnic_cq *rx_cq = shared ? cq : cq->rx_cq;
+
+	// stop the RX NAPI reaping this ring until it is detached
+	mqnic_napi_disable(rx_cq ? &rx_cq->napi : &cq->napi);
+#ifdef MQNIC_DIM
+	if (!shared)
+		cancel_work_sync(&cq->dim.work);
+#endif
+	if (retire)
+		mqnic_retire_ring_stats(q->priv, q, false);
+
+	if (keep_bql)
+		q->tx_queue = NULL;
+
+	mqnic_destroy_tx_ring(q);
+	if (!shared)
+		mqnic_destroy_queue_cq(cq);
+
+	if (rx_cq)
+		mqnic_napi_enable(&rx_cq->napi);
+}
+
+static void mqnic_start_tx_queue(struct mqnic_priv *priv, struct mqnic_ring *q, int k)
+{
+	int tc = netdev_txq_to_tc(priv->ndev, k);
+	u32 rate = netdev_get_tx_queue(priv->ndev, k)->tx_maxrate;
+
+	mqnic_enable_tx_ring(q);
+
+	mqnic_sched_port_queue_set_tc(priv->sched_port, q->index, tc < 0 ? 0 : tc);
+	if (priv->interface->sched_rate_limit)
+		mqnic_sched_port_queue_set_rate(priv->sched_port, q->index, rate,
+				mqnic_tx_rate_burst(priv, rate));
+	// weight from the devlink rate tree
+	if (priv->interface->sched_dwrr && priv->dl_rate.queue_weight)
+		mqnic_sched_port_queue_set_weight(priv->sched_port, q->index,
+				priv->dl_rate.queue_weight);
+	mqnic_sched_port_queue_enable(priv->sched_port, q->index);
+}
+
+// wait for the hardware to complete everything queued on a ring
+static bool mqnic_drain_tx_queue(struct mqnic_ring *q)
+{
+	int k;
+
+	for (k = 0; k < 100; k++) {
+		if (READ_ONCE(q->cons_ptr) == q->prod_ptr)
+			return true;
+
+		usleep_range(1000, 2000);
 	}
-	up_write(&priv->rxq_table_sem);
 
-	// free scheduler port
-	if (priv->sched_port)
-		mqnic_interface_free_sched_port(priv->interface, priv->sched_port);
-	priv->sched_port = NULL;
+	return false;
 }
 
-static int mqnic_open(struct net_device *ndev)
+// offloaded macvlan stations transmit on queues above the port's own
+static unsigned int mqnic_real_num_tx_queues(struct mqnic_priv *priv)
 {
-	struct mqnic_priv *priv = netdev_priv(ndev);
-	struct mqnic_dev *mdev = priv->mdev;
-	int ret = 0;
+	return priv->fwd_count ? priv->ndev->num_tx_queues : priv->txq_count;
+}
 
-	mutex_lock(&mdev->state_lock);
+#ifdef MQNIC_L2FW
+static void mqnic_fwd_close_station(struct mqnic_fwd_station *st)
+{
+	struct mqnic_priv *priv = st->priv;
+	struct mqnic_ring *q;
+	int k;
+
+	mqnic_interface_write_l2_entry(priv->interface, st->l2_index, NULL, 0, 0, 0);
+
+	for (k = 0; k < MQNIC_FWD_QUEUES; k++) {
+		if (!st->txq[k])
+			continue;
+
+		netif_tx_stop_queue(netdev_get_tx_queue(priv->ndev, st->txq_base + k));
+		RCU_INIT_POINTER(priv->txq_table[st->txq_base + k], NULL);
+	}
+
+	synchronize_net();
+
+	for (k = 0; k < MQNIC_FWD_QUEUES; k++) {
+		q = st->txq[k];
+
+		if (!q)
+			continue;
+
+		mqnic_drain_tx_queue(q);
+		mqnic_sched_port_queue_disable(priv->sched_port, q->index);
+		mqnic_disable_tx_ring(q);
+		mqnic_destroy_tx_queue(q, false, false);
+		st->txq[k] = NULL;
+	}
+
+	for (k = 0; k < MQNIC_FWD_QUEUES; k++) {
+		if (st->rxq[k])
+			mqnic_disable_rx_ring(st->rxq[k]);
+	}
+
+	msleep(20);
+	synchronize_net();
+
+	for (k = 0; k < MQNIC_FWD_QUEUES; k++) {
+		if (st->rxq[k])
+			mqnic_destroy_rx_queue(st->rxq[k], false);
+		st->rxq[k] = NULL;
+	}
+}
+
+// queue group on contiguous hardware queues, so the L2 entry can spread
+// over it by RSS hash; the CQs land on the port's EQs like any other queue
+static int mqnic_fwd_open_station(struct mqnic_fwd_station *st)
+{
+	struct mqnic_priv *priv = st->priv;
+	struct net_device *ndev = priv->ndev;
+	struct mqnic_if *iface = priv->interface;
+	struct mqnic_ring *q;
+	int txq, rxq;
+	int ret;
+	int k;
+
+	rxq = mqnic_res_alloc_range(iface->rxq_res, MQNIC_FWD_QUEUES);
+	if (rxq < 0)
+		return rxq;
+
+	txq = mqnic_res_alloc_range(iface->txq_res, MQNIC_FWD_QUEUES);
+	if (txq < 0) {
+		mqnic_res_free_range(iface->rxq_res, rxq, MQNIC_FWD_QUEUES);
+		return txq;
+	}
+
+	for (k = 0; k < MQNIC_FWD_QUEUES; k++) {
+		q = mqnic_create_rx_queue(ndev, st->rxq_base + k, priv->rx_ring_size, rxq + k);
+		if (IS_ERR_OR_NULL(q)) {
+			mqnic_res_free_range(iface->rxq_res, rxq + k + 1, MQNIC_FWD_QUEUES - k - 1);
+			mqnic_res_free_range(iface->txq_res, txq, MQNIC_FWD_QUEUES);
+			ret = PTR_ERR(q) ?: -ENOMEM;
+			goto fail;
+		}
+
+		q->ndev = st->vdev;
+		st->rxq[k] = q;
+	}
+
+	for (k = 0; k < MQNIC_FWD_QUEUES; k++) {
+		q = mqnic_create_tx_queue(ndev, st->txq_base + k, priv->tx_ring_size, false, txq + k);
+		if (IS_ERR_OR_NULL(q)) {
+			mqnic_res_free_range(iface->txq_res, txq + k + 1, MQNIC_FWD_QUEUES - k - 1);
+			ret = PTR_ERR(q) ?: -ENOMEM;
+			goto fail;
+		}
+
+		st->txq[k] = q;
+	}
+
+	for (k = 0; k < MQNIC_FWD_QUEUES; k++)
+		mqnic_enable_rx_ring(st->rxq[k]);
+
+	for (k = 0; k < MQNIC_FWD_QUEUES; k++) {
+		mqnic_start_tx_queue(priv, st->txq[k], st->txq_base + k);
+		rcu_assign_pointer(priv->txq_table[st->txq_base + k], st->txq[k]);
+		netif_tx_start_queue(netdev_get_tx_queue(ndev, st->txq_base + k));
+	}
+
+	mqnic_interface_write_l2_entry(iface, st->l2_index, st->vdev->dev_addr,
+			priv->port->index, st->rxq[0]->index, ilog2(MQNIC_FWD_QUEUES));
+
+	return 0;
+
+fail:
+	mqnic_fwd_close_station(st);
+	return ret;
+}
+
+// a station that fails here stays on the software path until the next restart
+static void mqnic_fwd_open_stations(struct mqnic_priv *priv)
+{
+	struct mqnic_fwd_station *st;
+	int k;
+
+	for (k = 0; k < MQNIC_MAX_FWD_STATIONS; k++) {
+		st = priv->fwd_station[k];
+
+		if (st && mqnic_fwd_open_station(st))
+			netdev_warn(priv->ndev, "Failed to set up queues for offloaded %s",
+					netdev_name(st->vdev));
+	}
+}
+
+static void mqnic_fwd_close_stations(struct mqnic_priv *priv)
+{
+	int k;
+
+	for (k = 0; k < MQNIC_MAX_FWD_STATIONS; k++) {
+		if (priv->fwd_station[k])
+			mqnic_fwd_close_station(priv->fwd_station[k]);
+	}
+}
+#endif
+
+#ifdef CONFIG_RFS_ACCEL
+// steer accelerated RFS flows towards the queue serviced on the target CPU
+static void mqnic_update_rx_cpu_rmap(struct mqnic_priv *priv)
+{
+	struct net_device *ndev = priv->ndev;
+	int k;
+
+	if (!ndev->rx_cpu_rmap)
+		return;
+
+	for (k = 0; k < ndev->num_rx_queues; k++) {
+		const struct cpumask *affinity = NULL;
+
+		if (k < priv->rxq_count)
+			affinity = priv->rxq_table[k]->cq->eq->irq->affinity;
+
+		cpu_rmap_update(ndev->rx_cpu_rmap, k, affinity ? affinity : cpu_none_mask);
+	}
+}
+#endif
+
+static void mqnic_update_link_status(struct mqnic_priv *priv)
+{
+	unsigned long flags;
+	unsigned int up = 1;
+
+	// taken from the EQ handler in hard IRQ context
+	spin_lock_irqsave(&priv->link_status_lock, flags);
+
+	if (!priv->link_status_active)
+		goto out;
+
+	if (!(mqnic_port_get_tx_ctrl(priv->port) & MQNIC_PORT_TX_CTRL_STATUS))
+		up = 0;
+	if (!(mqnic_port_get_rx_ctrl(priv->port) & MQNIC_PORT_RX_CTRL_STATUS))
+		up = 0;
+
+	if (up) {
+		if (!priv->link_status) {
+			netif_carrier_on(priv->ndev);
+			priv->link_status = !priv->link_status;
+		}
+	} else {
+		if (priv->link_status) {
+			netif_carrier_off(priv->ndev);
+			priv->link_status = !priv->link_status;
+		}
+	}
+
+out:
+	spin_unlock_irqrestore(&priv->link_status_lock, flags);
+}
+
+// called from EQ processing when the port posts a status change event
+void mqnic_port_status_event(struct mqnic_port *port)
+{
+	struct net_device *ndev;
+
+	// mqnic_destroy_netdev waits for this before freeing the netdev
+	rcu_read_lock();
+
+	ndev = READ_ONCE(port->ndev);
+	if (ndev)
+		mqnic_update_link_status(netdev_priv(ndev));
+
+	rcu_read_unlock();
+}
+
+int mqnic_start_port(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_if *iface = priv->interface;
+	struct mqnic_ring *q;
+	int base;
+	int k;
+	int tc;
+	int ret;
+
+	netdev_info(ndev, "%s on interface %d", __func__, iface->index);
+
+	// an EQ size set through devlink lands once no port of the interface is up
+	ret = mqnic_interface_resize_eqs(iface, priv->mdev->eq_size);
+	if (ret && ret != -EBUSY)
+		return ret;
+
+	netif_set_real_num_tx_queues(ndev, mqnic_real_num_tx_queues(priv));
+	netif_set_real_num_rx_queues(ndev, priv->rxq_count);
+
+	// counters restart with the rings; the last totals stay in ndev->stats
+	memset(&priv->retired_stats, 0, sizeof(priv->retired_stats));
+
+	// allocate scheduler port
+	priv->sched_port = mqnic_interface_alloc_sched_port(iface);
+	if (!priv->sched_port) {
+		netdev_err(ndev, "Failed to allocate scheduler");
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	// set up RX queues on a contiguous index range when one is free,
+	// otherwise let each ring take the next free index
+	base = mqnic_res_alloc_range(iface->rxq_res, priv->rxq_count);
+	for (k = 0; k < priv->rxq_count; k++) {
+		q = mqnic_create_rx_queue(ndev, k, priv->rx_ring_size, base < 0 ? -1 : base + k);
+		if (IS_ERR_OR_NULL(q)) {
+			if (base >= 0)
+				mqnic_res_free_range(iface->rxq_res, base + k + 1, priv->rxq_count - k - 1);
+			ret = PTR_ERR(q);
+			goto fail;
+		}
+
+		rcu_assign_pointer(priv->rxq_table[k], q);
+	}
+
+	// set up TX queues
+	base = mqnic_res_alloc_range(iface->txq_res, priv->txq_count);
+	for (k = 0; k < priv->txq_count; k++) {
+		q = mqnic_create_tx_queue(ndev, k, priv->tx_ring_size, false, base < 0 ? -1 : base + k);
+		if (IS_ERR_OR_NULL(q)) {
+			if (base >= 0)
+				mqnic_res_free_range(iface->txq_res, base + k + 1, priv->txq_count - k - 1);
+			ret = PTR_ERR(q);
+			goto fail;
+		}
+
+		// steer transmit to the CPUs servicing the completion interrupt,
+		// unless the channel layout is unchanged and the user may have
+		// set their own map
+		if (q->cq->eq->irq->affinity && priv->xps_txq_count != priv->txq_count)
+			netif_set_xps_queue(ndev, q->cq->eq->irq->affinity, k);
+
+		rcu_assign_pointer(priv->txq_table[k], q);
+	}
+
+	priv->xps_txq_count = priv->txq_count;
+
+	// set up XDP TX queues, also used for XSK transmit
+	if (priv->xdp_prog || !bitmap_empty(priv->xsk_zc_qps, priv->rxq_count)) {
+		priv->xdp_txq = kcalloc(priv->rxq_count, sizeof(*priv->xdp_txq), GFP_KERNEL);
+		if (!priv->xdp_txq) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		base = mqnic_res_alloc_range(iface->txq_res, priv->rxq_count);
+		for (k = 0; k < priv->rxq_count; k++) {
+			q = mqnic_create_tx_queue(ndev, k, priv->tx_ring_size, true, base < 0 ? -1 : base + k);
+			if (IS_ERR_OR_NULL(q)) {
+				if (base >= 0)
+					mqnic_res_free_range(iface->txq_res, base + k + 1, priv->rxq_count - k - 1);
+				ret = PTR_ERR(q);
+				goto fail;
+			}
+
+			priv->xdp_txq[k] = q;
+			priv->xdp_txq_count++;
+		}
+	}
+
+	// set MTU
+	mqnic_interface_set_tx_mtu(iface, ndev->mtu + ETH_HLEN);
+	mqnic_interface_set_rx_mtu(iface, ndev->mtu + ETH_HLEN);
+
+	// configure RX indirection and RSS
+	mqnic_update_indir_table(ndev);
+
+#ifdef CONFIG_RFS_ACCEL
+	mqnic_update_rx_cpu_rmap(priv);
+#endif
+
+	priv->port_up = true;
+
+	// program flow rules with the new queue indices
+	mqnic_interface_update_flow_rules(iface, priv);
+	mqnic_capture_update(iface, priv);
+
+	// enable TX and RX queues
+	for (k = 0; k < priv->xdp_txq_count; k++)
+		mqnic_enable_tx_ring(priv->xdp_txq[k]);
+
+	for (k = 0; k < priv->rxq_count; k++)
+		mqnic_enable_rx_ring(priv->rxq_table[k]);
+
+	mqnic_port_set_tx_ctrl(priv->port, MQNIC_PORT_TX_CTRL_EN |
+			(priv->loopback ? MQNIC_PORT_TX_CTRL_LOOPBACK : 0));
+
+	// configure scheduler
+	for (k = 0; k < priv->txq_count; k++)
+		mqnic_start_tx_queue(priv, priv->txq_table[k], k);
+
+	for (k = 0; k < priv->xdp_txq_count; k++) {
+		mqnic_sched_port_queue_set_tc(priv->sched_port, priv->xdp_txq[k]->index, 0);
+		mqnic_sched_port_queue_enable(priv->sched_port, priv->xdp_txq[k]->index);
+	}
+
+	// configure scheduler flow control, one channel per traffic class
+	for (tc = 0; tc < max_t(int, netdev_get_num_tc(ndev), 1); tc++) {
+		mqnic_sched_port_channel_set_dest(priv->sched_port, tc, (priv->port->index << 4) | tc);
+		mqnic_sched_port_channel_set_pkt_budget(priv->sched_port, tc, 1);
+		mqnic_sched_port_channel_set_data_budget(priv->sched_port, tc, mqnic_tc_data_budget(priv, tc));
+		mqnic_sched_port_channel_set_pkt_limit(priv->sched_port, tc, 0xFFFF);
+		mqnic_sched_port_channel_set_data_limit(priv->sched_port, tc, mqnic_tc_data_limit(priv, tc));
+
+		mqnic_sched_port_channel_enable(priv->sched_port, tc);
+	}
+
+	mqnic_update_tx_rates(ndev);
+
+	// enable scheduler
+	mqnic_sched_port_enable(priv->sched_port);
+
+#ifdef MQNIC_L2FW
+	mqnic_fwd_open_stations(priv);
+#endif
+
+	netif_tx_start_all_queues(ndev);
+	netif_device_attach(ndev);
+
+	spin_lock_irq(&priv->link_status_lock);
+	priv->link_status = 0;
+	priv->link_status_active = true;
+	spin_unlock_irq(&priv->link_status_lock);
+
+	if (priv->link_event) {
+		struct mqnic_eq *eq = mqnic_interface_select_eq(priv->interface, priv->port->index);
+
+		mqnic_port_set_event_ctrl(priv->port, MQNIC_PORT_EVENT_CTRL_EN |
+				(eq->eqn & MQNIC_PORT_EVENT_CTRL_EQN_MASK));
+
+		// pick up the current state; later changes arrive as events
+		mqnic_update_link_status(priv);
+	} else if (mqnic_link_status_poll) {
+		mod_timer(&priv->link_status_timer,
+				jiffies + msecs_to_jiffies(mqnic_link_status_poll));
+	} else {
+		netif_carrier_on(ndev);
+	}
+
+	mqnic_port_set_rx_ctrl(priv->port, MQNIC_PORT_RX_CTRL_EN);
+
+	return 0;
+
+fail:
+	mqnic_stop_port(ndev);
+	return ret;
+}
+
+void mqnic_stop_port(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *q;
+	int k;
+
+	netdev_info(ndev, "%s on interface %d", __func__, priv->interface->index);
+
+	if (priv->link_event)
+		mqnic_port_set_event_ctrl(priv->port, 0);
+	else if (mqnic_link_status_poll)
+		mqnic_timer_delete_sync(&priv->link_status_timer);
+
+	// an event still in flight must not turn the carrier back on
+	spin_lock_irq(&priv->link_status_lock);
+	priv->link_status_active = false;
+	spin_unlock_irq(&priv->link_status_lock);
+
+	mqnic_port_set_rx_ctrl(priv->port, 0);
+
+	netif_tx_lock_bh(ndev);
+//	if (detach)
+//		netif_device_detach(ndev);
+	netif_tx_stop_all_queues(ndev);
+	netif_tx_unlock_bh(ndev);
+
+	netif_carrier_off(ndev);
+	netif_tx_disable(ndev);
+
+#ifdef MQNIC_L2FW
+	mqnic_fwd_close_stations(priv);
+#endif
+
+	mqnic_update_stats(ndev);
+
+	if (priv->sched_port) {
+		for (k = 0; k < priv->txq_count; k++) {
+			q = priv->txq_table[k];
+
+			if (q)
+				mqnic_sched_port_queue_disable(priv->sched_port, q->index);
+		}
+
+		for (k = 0; k < priv->xdp_txq_count; k++)
+			mqnic_sched_port_queue_disable(priv->sched_port, priv->xdp_txq[k]->index);
+
+		for (k = 0; k < priv->sched_port->sched->tc_count; k++)
+			mqnic_sched_port_channel_disable(priv->sched_port, k);
+
+		mqnic_sched_port_disable(priv->sched_port);
+	}
+
+	// disable TX and RX queues
+	for (k = 0; k < priv->txq_count; k++) {
+		q = priv->txq_table[k];
+
+		if (q)
+			mqnic_disable_tx_ring(q);
+	}
+
+	for (k = 0; k < priv->xdp_txq_count; k++)
+		mqnic_disable_tx_ring(priv->xdp_txq[k]);
+
+	for (k = 0; k < priv->rxq_count; k++) {
+		q = priv->rxq_table[k];
+
+		if (q)
+			mqnic_disable_rx_ring(q);
+	}
+
+	msleep(20);
+
+	mqnic_port_set_tx_ctrl(priv->port, 0);
+
+	priv->port_up = false;
+
+	// wait for in-flight datapath and ndo_xdp_xmit callers
+	synchronize_net();
+
+	// the restart is the recovery for any queue still waiting on one
+	bitmap_zero(priv->txq_timed_out, ndev->num_tx_queues);
+
+#ifdef CONFIG_RFS_ACCEL
+	cancel_work_sync(&priv->arfs_expire_work);
+#endif
+
+	// disable flow rules that point at queues about to be freed
+	mqnic_interface_update_flow_rules(priv->interface, priv);
+	mqnic_capture_update(priv->interface, priv);
+
+	// shut down NAPI and clean queues
+	for (k = 0; k < priv->txq_count; k++) {
+		q = priv->txq_table[k];
+
+		if (!q)
+			continue;
+
+		RCU_INIT_POINTER(priv->txq_table[k], NULL);
+
+		mqnic_destroy_tx_queue(q, false, false);
+	}
+
+	for (k = 0; k < priv->xdp_txq_count; k++)
+		mqnic_destroy_tx_queue(priv->xdp_txq[k], false, false);
+	priv->xdp_txq_count = 0;
+
+	kfree(priv->xdp_txq);
+	priv->xdp_txq = NULL;
+
+	for (k = 0; k < priv->rxq_count; k++) {
+		q = priv->rxq_table[k];
+
+		if (!q)
+			continue;
+
+		RCU_INIT_POINTER(priv->rxq_table[k], NULL);
+
+		mqnic_destroy_rx_queue(q, false);
+	}
+
+	// free scheduler port
+	if (priv->sched_port)
+		mqnic_interface_free_sched_port(priv->interface, priv->sched_port);
+	priv->sched_port = NULL;
+}
+
+// XDP queues and XSK pools are tied to the RX layout, and combined
+// channels pair rings by index; those still restart
+static bool mqnic_can_reconfigure_online(struct mqnic_priv *priv)
+{
+	return priv->port_up && !priv->xdp_prog && !priv->xdp_txq_count && !priv->combined &&
+		bitmap_empty(priv->xsk_zc_qps, priv->ndev->num_rx_queues);
+}
+
+// unpublish an RX ring, let in-flight frames land, then free it
+static void mqnic_retire_rx_queue(struct mqnic_priv *priv, struct mqnic_ring *old)
+{
+	mqnic_retire_ring_stats(priv, old, true);
+
+	// move flow rules off the old ring before it goes idle
+	mqnic_interface_update_flow_rules(priv->interface, priv);
+	mqnic_capture_update(priv->interface, priv);
+
+	mqnic_disable_rx_ring(old);
+	msleep(20);
+	synchronize_net();
+
+	mqnic_destroy_rx_queue(old, true);
+}
+
+// unpublish a TX ring and wait for its completions, then free it
+static int mqnic_retire_tx_queue(struct mqnic_priv *priv, struct mqnic_ring *old, bool keep_bql)
+{
+	bool drained;
+
+	drained = mqnic_drain_tx_queue(old);
+
+	mqnic_sched_port_queue_disable(priv->sched_port, old->index);
+	mqnic_disable_tx_ring(old);
+
+	mqnic_destroy_tx_queue(old, true, keep_bql);
+
+	// BQL still counts what did not complete; only a full restart resets it
+	return drained ? 0 : -ETIMEDOUT;
+}
+
+static int mqnic_reconfigure_rx_online(struct net_device *ndev, u32 rxq_count, u32 rx_ring_size)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *q, *old;
+	u32 old_count = priv->rxq_count;
+	int k;
+
+	// replace resized queues one at a time
+	for (k = 0; k < min(rxq_count, old_count); k++) {
+		old = priv->rxq_table[k];
+
+		if (old->size == rx_ring_size)
+			continue;
+
+		q = mqnic_create_rx_queue(ndev, k, rx_ring_size, -1);
+		if (IS_ERR_OR_NULL(q))
+			return PTR_ERR(q) ?: -ENOMEM;
+
+		mqnic_enable_rx_ring(q);
+
+		rcu_assign_pointer(priv->rxq_table[k], q);
+		mqnic_update_indir_table(ndev);
+
+		mqnic_retire_rx_queue(priv, old);
+	}
+
+	// add queues, then spread RSS over them
+	for (k = old_count; k < rxq_count; k++) {
+		q = mqnic_create_rx_queue(ndev, k, rx_ring_size, -1);
+		if (IS_ERR_OR_NULL(q))
+			return PTR_ERR(q) ?: -ENOMEM;
+
+		mqnic_enable_rx_ring(q);
+
+		rcu_assign_pointer(priv->rxq_table[k], q);
+		priv->rxq_count = k + 1;
+	}
+
+	netif_set_real_num_rx_queues(ndev, priv->rxq_count);
+	mqnic_update_indir_table(ndev);
+
+	// remove queues once RSS no longer points at them
+	for (k = rxq_count; k < old_count; k++) {
+		old = priv->rxq_table[k];
+
+		RCU_INIT_POINTER(priv->rxq_table[k], NULL);
+
+		mqnic_retire_rx_queue(priv, old);
+	}
+
+	if (rxq_count < old_count) {
+		priv->rxq_count = rxq_count;
+		netif_set_real_num_rx_queues(ndev, priv->rxq_count);
+	}
+
+	mqnic_interface_update_flow_rules(priv->interface, priv);
+	mqnic_capture_update(priv->interface, priv);
+
+#ifdef CONFIG_RFS_ACCEL
+	mqnic_update_rx_cpu_rmap(priv);
+#endif
+
+	return 0;
+}
+
+static int mqnic_reconfigure_tx_online(struct net_device *ndev, u32 txq_count, u32 tx_ring_size)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *q, *old;
+	struct netdev_queue *txq;
+	u32 old_count = priv->txq_count;
+	int ret = 0;
+	int k;
+
+	// replace resized queues one at a time
+	for (k = 0; k < min(txq_count, old_count); k++) {
+		old = priv->txq_table[k];
+
+		if (old->size == tx_ring_size)
+			continue;
+
+		q = mqnic_create_tx_queue(ndev, k, tx_ring_size, false, -1);
+		if (IS_ERR_OR_NULL(q))
+			return PTR_ERR(q) ?: -ENOMEM;
+
+		mqnic_start_tx_queue(priv, q, k);
+
+		// swap under the queue lock so no transmit straddles both rings;
+		// BQL is per netdev queue and carries across
+		txq = netdev_get_tx_queue(ndev, k);
+		__netif_tx_lock_bh(txq);
+		rcu_assign_pointer(priv->txq_table[k], q);
+		mqnic_retire_ring_stats(priv, old, false);
+		__netif_tx_unlock_bh(txq);
+
+		ret = mqnic_retire_tx_queue(priv, old, true);
+		if (ret)
+			return ret;
+	}
+
+	// add queues
+	for (k = old_count; k < txq_count; k++) {
+		q = mqnic_create_tx_queue(ndev, k, tx_ring_size, false, -1);
+		if (IS_ERR_OR_NULL(q))
+			return PTR_ERR(q) ?: -ENOMEM;
+
+		mqnic_start_tx_queue(priv, q, k);
+
+		if (q->cq->eq->irq->affinity)
+			netif_set_xps_queue(ndev, q->cq->eq->irq->affinity, k);
+
+		rcu_assign_pointer(priv->txq_table[k], q);
+		priv->txq_count = k + 1;
+
+		netif_tx_start_queue(netdev_get_tx_queue(ndev, k));
+	}
+
+	// remove queues after the stack stops selecting them
+	if (txq_count < old_count) {
+		netif_set_real_num_tx_queues(ndev, txq_count);
+
+		for (k = txq_count; k < old_count; k++) {
+			old = priv->txq_table[k];
+
+			txq = netdev_get_tx_queue(ndev, k);
+			__netif_tx_lock_bh(txq);
+			RCU_INIT_POINTER(priv->txq_table[k], NULL);
+			mqnic_retire_ring_stats(priv, old, false);
+			__netif_tx_unlock_bh(txq);
+
+			if (mqnic_retire_tx_queue(priv, old, false))
+				ret = -ETIMEDOUT;
+		}
+
+		priv->txq_count = txq_count;
+	} else {
+		netif_set_real_num_tx_queues(ndev, mqnic_real_num_tx_queues(priv));
+	}
+
+	priv->xps_txq_count = priv->txq_count;
+
+	return ret;
+}
+
+// change queue counts and ring sizes; swaps queues individually when the
+// port is up, and falls back to a full restart when that is not possible
+int mqnic_reconfigure_port(struct net_device *ndev, u32 txq_count, u32 rxq_count,
+		u32 tx_ring_size, u32 rx_ring_size)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	bool port_up = priv->port_up;
+	int ret = 0;
+
+	if (mqnic_can_reconfigure_online(priv)) {
+		ret = mqnic_reconfigure_rx_online(ndev, rxq_count, rx_ring_size);
+		if (!ret)
+			ret = mqnic_reconfigure_tx_online(ndev, txq_count, tx_ring_size);
+
+		priv->tx_ring_size = tx_ring_size;
+		priv->rx_ring_size = rx_ring_size;
+
+		if (!ret)
+			return 0;
+
+		netdev_warn(ndev, "%s: online reconfiguration failed (%d), restarting port",
+				__func__, ret);
+	}
+
+	if (port_up)
+		mqnic_stop_port(ndev);
+
+	priv->txq_count = txq_count;
+	priv->rxq_count = rxq_count;
+	priv->tx_ring_size = tx_ring_size;
+	priv->rx_ring_size = rx_ring_size;
+
+	if (port_up) {
+		ret = mqnic_start_port(ndev);
+
+		if (ret)
+			netdev_err(ndev, "%s: Failed to start port: %d", __func__, ret);
+	}
+
+	return ret;
+}
+
+// replace one stalled TX ring in place; the rest of the port keeps running
+static int mqnic_recover_tx_queue(struct mqnic_priv *priv, int k)
+{
+	struct net_device *ndev = priv->ndev;
+	struct netdev_queue *txq = netdev_get_tx_queue(ndev, k);
+	struct mqnic_ring *old = priv->txq_table[k];
+	struct mqnic_ring *q;
+	u32 size = old->size;
+
+	__netif_tx_lock_bh(txq);
+	netif_tx_stop_queue(txq);
+	RCU_INIT_POINTER(priv->txq_table[k], NULL);
+	mqnic_retire_ring_stats(priv, old, false);
+	__netif_tx_unlock_bh(txq);
+
+	synchronize_net();
+
+	mqnic_sched_port_queue_disable(priv->sched_port, old->index);
+	mqnic_disable_tx_ring(old);
+
+	// the stuck descriptors are dropped with the ring, so BQL starts over
+	mqnic_destroy_tx_queue(old, true, true);
+	netdev_tx_reset_queue(txq);
+
+	q = mqnic_create_tx_queue(ndev, k, size, false, -1);
+	if (IS_ERR_OR_NULL(q))
+		return PTR_ERR(q) ?: -ENOMEM;
+
+	mqnic_start_tx_queue(priv, q, k);
+
+	rcu_assign_pointer(priv->txq_table[k], q);
+	netif_tx_wake_queue(txq);
+
+	return 0;
+}
+
+static void mqnic_tx_timeout_work(struct work_struct *work)
+{
+	struct mqnic_priv *priv = container_of(work, struct mqnic_priv, tx_timeout_work);
+	int ret;
+	int k;
+
+	mqnic_netdev_lock(priv->ndev);
+	mutex_lock(&priv->mdev->state_lock);
+
+	for (k = 0; k < priv->txq_count; k++) {
+		if (!test_and_clear_bit(k, priv->txq_timed_out) || !priv->port_up ||
+				!priv->txq_table[k])
+			continue;
+
+		ret = mqnic_recover_tx_queue(priv, k);
+		if (!ret) {
+			netdev_info(priv->ndev, "%s: TX queue %d recovered on ring %d",
+					__func__, k, priv->txq_table[k]->index);
+			continue;
+		}
+
+		netdev_err(priv->ndev, "%s: failed to recover TX queue %d (%d), restarting port",
+				__func__, k, ret);
+
+		mqnic_stop_port(priv->ndev);
+		ret = mqnic_start_port(priv->ndev);
+		if (ret)
+			netdev_err(priv->ndev, "%s: Failed to start port: %d", __func__, ret);
+		break;
+	}
+
+	mutex_unlock(&priv->mdev->state_lock);
+	mqnic_netdev_unlock(priv->ndev);
+}
+
+// caller holds the RCU read lock
+static void mqnic_tx_timeout_ring(struct mqnic_priv *priv, struct mqnic_ring *ring, int k)
+{
+	struct mqnic_cq *cq = ring->cq;
+	u32 cons_ptr = READ_ONCE(ring->cons_ptr);
+	u32 val, ptr, cq_ptr;
+
+	val = ioread32(ring->hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
+	ptr = mqnic_read_hw_ptr(ring->ptr_shadow, ring->hw_addr + MQNIC_QUEUE_PTR_REG);
+	cq_ptr = mqnic_read_hw_ptr(cq->ptr_shadow, cq->hw_addr + MQNIC_CQ_PTR_REG);
+
+	netdev_warn(priv->ndev, "TX timeout on queue %d: ring=%d prod=%u db_prod=%u cons=%u hw_prod=%u hw_cons=%u hw_en=%d hw_active=%d cqn=%d cq_cons=%u cq_hw_prod=%u cq_hw_cons=%u",
+			k, ring->index, ring->prod_ptr & MQNIC_QUEUE_PTR_MASK,
+			ring->db_prod_ptr & MQNIC_QUEUE_PTR_MASK, cons_ptr & MQNIC_QUEUE_PTR_MASK,
+			ptr & MQNIC_QUEUE_PTR_MASK, (ptr >> 16) & MQNIC_QUEUE_PTR_MASK,
+			!!(val & MQNIC_QUEUE_ENABLE_MASK), !!(val & MQNIC_QUEUE_ACTIVE_MASK),
+			cq->cqn, cq->cons_ptr & MQNIC_CQ_PTR_MASK,
+			cq_ptr & MQNIC_CQ_PTR_MASK, (cq_ptr >> 16) & MQNIC_CQ_PTR_MASK);
+
+	if (ring->prod_ptr == cons_ptr)
+		return;
+
+	// the hardware moved on and only the completion went missing; poll
+	// the CQ rather than throwing the ring away
+	if ((((ptr >> 16) - cons_ptr) & MQNIC_QUEUE_PTR_MASK) ||
+			((cq_ptr - cq->cons_ptr) & MQNIC_CQ_PTR_MASK)) {
+		napi_schedule(mqnic_cq_napi(cq));
+		return;
+	}
+
+	set_bit(k, priv->txq_timed_out);
+	schedule_work(&priv->tx_timeout_work);
+}
+
+// runs from the netdev watchdog with the TX queue locks held
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+static void mqnic_tx_timeout(struct net_device *ndev, unsigned int txqueue)
+#else
+static void mqnic_tx_timeout(struct net_device *ndev)
+#endif
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *ring;
+	int k;
+
+	rcu_read_lock();
+
+	for (k = 0; k < priv->txq_count; k++) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+		if (k != txqueue)
+			continue;
+#else
+		if (!netif_xmit_stopped(netdev_get_tx_queue(ndev, k)))
+			continue;
+#endif
+
+		ring = rcu_dereference(priv->txq_table[k]);
+
+		if (ring && priv->port_up)
+			mqnic_tx_timeout_ring(priv, ring, k);
+	}
+
+	rcu_read_unlock();
+}
+
+static int mqnic_open(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	int ret = 0;
+
+	mutex_lock(&mdev->state_lock);
+
+	ret = mqnic_start_port(ndev);
+
+	if (ret)
+		netdev_err(ndev, "Failed to start port on interface %d: %d",
+				priv->interface->index, ret);
+	else
+		mqnic_rss_start(priv);
+
+	mutex_unlock(&mdev->state_lock);
+	return ret;
+}
+
+static int mqnic_close(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	int ret = 0;
+
+	mqnic_rss_stop(priv);
+
+	mutex_lock(&mdev->state_lock);
+
+	mqnic_stop_port(ndev);
+
+	mutex_unlock(&mdev->state_lock);
+	return ret;
+}
+
+int mqnic_update_indir_table(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_if *iface = priv->interface;
+	struct mqnic_ring *q;
+	int k;
+
+	mqnic_interface_set_rx_queue_map_rss_mask(iface, priv->port->index, 0xffffffff);
+	mqnic_interface_set_rx_queue_map_app_mask(iface, priv->port->index, 0);
+
+	for (k = 0; k < priv->rx_queue_map_indir_table_size; k++) {
+		rcu_read_lock();
+		q = rcu_dereference(priv->rxq_table[priv->rx_queue_map_indir_table[k]]);
+		if (q)
+			mqnic_interface_set_rx_queue_map_indir_table(iface, priv->port->index, k, q->index);
+		rcu_read_unlock();
+	}
+
+	if (priv->if_features & MQNIC_IF_FEATURE_PTP_CLASSIFY)
+		mqnic_update_ptp_queue(ndev);
+
+	return 0;
+}
+
+/*
+ * Under the PTP_V2_EVENT filter, PTP event frames go to the last RX queue
+ * ahead of RSS, so they do not wait behind bulk traffic.  Taking that queue
+ * out of the indirection table (ethtool -X <dev> equal <rxq_count - 1>)
+ * leaves it to PTP alone.
+ */
+void mqnic_update_ptp_queue(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *q = NULL;
+	u32 val = 0;
+
+	rcu_read_lock();
+
+	if (READ_ONCE(priv->hwts_config.rx_filter) == HWTSTAMP_FILTER_PTP_V2_EVENT &&
+			priv->rxq_count > 1)
+		q = rcu_dereference(priv->rxq_table[priv->rxq_count - 1]);
+
+	if (q)
+		val = (q->index & MQNIC_RX_QUEUE_MAP_PTP_QUEUE_MASK) |
+			MQNIC_RX_QUEUE_MAP_PTP_QUEUE_ENABLE;
+
+	mqnic_interface_set_rx_queue_map_ptp_queue(priv->interface, priv->port->index, val);
+
+	rcu_read_unlock();
+}
+
+static void mqnic_get_ring_stats64(struct mqnic_priv *priv,
+		struct rtnl_link_stats64 *stats)
+{
+	const struct rtnl_link_stats64 *retired = &priv->retired_stats;
+	unsigned int start;
+	int k;
+
+	do {
+		start = u64_stats_fetch_begin(&priv->retired_syncp);
+		stats->rx_packets = retired->rx_packets;
+		stats->rx_bytes = retired->rx_bytes;
+		stats->rx_dropped = retired->rx_dropped;
+		stats->tx_packets = retired->tx_packets;
+		stats->tx_bytes = retired->tx_bytes;
+		stats->tx_dropped = retired->tx_dropped;
+	} while (u64_stats_fetch_retry(&priv->retired_syncp, start));
+
+	for (k = 0; k < priv->rxq_count; k++) {
+		const struct mqnic_ring *q = rcu_dereference(priv->rxq_table[k]);
+
+		if (q)
+			mqnic_ring_get_stats(q, &stats->rx_packets, &stats->rx_bytes, &stats->rx_dropped);
+	}
+
+	for (k = 0; k < priv->txq_count; k++) {
+		const struct mqnic_ring *q = rcu_dereference(priv->txq_table[k]);
+
+		if (q)
+			mqnic_ring_get_stats(q, &stats->tx_packets, &stats->tx_bytes, &stats->tx_dropped);
+	}
+}
+
+void mqnic_update_stats(struct net_device *ndev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct rtnl_link_stats64 stats = {};
+
+	rcu_read_lock();
+
+	if (unlikely(!priv->port_up))
+		goto out;
+
+	mqnic_get_ring_stats64(priv, &stats);
+
+	ndev->stats.rx_packets = stats.rx_packets;
+	ndev->stats.rx_bytes = stats.rx_bytes;
+	ndev->stats.rx_dropped = stats.rx_dropped;
+	ndev->stats.tx_packets = stats.tx_packets;
+	ndev->stats.tx_bytes = stats.tx_bytes;
+	ndev->stats.tx_dropped = stats.tx_dropped;
+
+out:
+	rcu_read_unlock();
+}
+
+static void mqnic_get_stats64(struct net_device *ndev,
+		struct rtnl_link_stats64 *stats)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	rcu_read_lock();
+
+	// rings are gone while the port is down; report the last snapshot
+	if (likely(priv->port_up))
+		mqnic_get_ring_stats64(priv, stats);
+	else
+		netdev_stats_to_stats64(stats, &ndev->stats);
+
+	rcu_read_unlock();
+}
+
+static int mqnic_hwtstamp_set(struct net_device *ndev, struct ifreq *ifr)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct hwtstamp_config hwts_config;
+
+	if (copy_from_user(&hwts_config, ifr->ifr_data, sizeof(hwts_config)))
+		return -EFAULT;
+
+	if (hwts_config.flags)
+		return -EINVAL;
+
+	switch (hwts_config.tx_type) {
+	case HWTSTAMP_TX_OFF:
+	case HWTSTAMP_TX_ON:
+		break;
+#ifdef MQNIC_PTP_ONESTEP
+	case HWTSTAMP_TX_ONESTEP_SYNC:
+		if (!(priv->if_features & MQNIC_IF_FEATURE_PTP_ONESTEP) ||
+				priv->interface->max_desc_block_size < 4)
+			return -ERANGE;
+		break;
+#endif
+	default:
+		return -ERANGE;
+	}
+
+	switch (hwts_config.rx_filter) {
+	case HWTSTAMP_FILTER_NONE:
+		break;
+	case HWTSTAMP_FILTER_PTP_V2_L4_EVENT:
+	case HWTSTAMP_FILTER_PTP_V2_L4_SYNC:
+	case HWTSTAMP_FILTER_PTP_V2_L4_DELAY_REQ:
+	case HWTSTAMP_FILTER_PTP_V2_L2_EVENT:
+	case HWTSTAMP_FILTER_PTP_V2_L2_SYNC:
+	case HWTSTAMP_FILTER_PTP_V2_L2_DELAY_REQ:
+	case HWTSTAMP_FILTER_PTP_V2_EVENT:
+	case HWTSTAMP_FILTER_PTP_V2_SYNC:
+	case HWTSTAMP_FILTER_PTP_V2_DELAY_REQ:
+		// the hardware classifier matches every PTPv2 event message
+		if (priv->if_features & MQNIC_IF_FEATURE_PTP_CLASSIFY) {
+			hwts_config.rx_filter = HWTSTAMP_FILTER_PTP_V2_EVENT;
+			break;
+		}
+		fallthrough;
+	case HWTSTAMP_FILTER_ALL:
+	case HWTSTAMP_FILTER_SOME:
+	case HWTSTAMP_FILTER_PTP_V1_L4_EVENT:
+	case HWTSTAMP_FILTER_PTP_V1_L4_SYNC:
+	case HWTSTAMP_FILTER_PTP_V1_L4_DELAY_REQ:
+	case HWTSTAMP_FILTER_NTP_ALL:
+		hwts_config.rx_filter = HWTSTAMP_FILTER_ALL;
+		break;
+	default:
+		return -ERANGE;
+	}
+
+	if (hwts_config.rx_filter != HWTSTAMP_FILTER_NONE &&
+			!(priv->if_features & MQNIC_IF_FEATURE_PTP_TS))
+		return -ERANGE;
+
+	priv->hwts_config.flags = hwts_config.flags;
+	WRITE_ONCE(priv->hwts_config.tx_type, hwts_config.tx_type);
+	WRITE_ONCE(priv->hwts_config.rx_filter, hwts_config.rx_filter);
+
+	// steer PTP event frames to their queue, or hand them back to RSS
+	if (priv->if_features & MQNIC_IF_FEATURE_PTP_CLASSIFY)
+		mqnic_update_ptp_queue(ndev);
+
+	if (copy_to_user(ifr->ifr_data, &hwts_config, sizeof(hwts_config)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int mqnic_hwtstamp_get(struct net_device *ndev, struct ifreq *ifr)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	if (copy_to_user(ifr->ifr_data, &priv->hwts_config, sizeof(priv->hwts_config)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int mqnic_set_mac(struct net_device *ndev, void *addr)
+{
+	struct sockaddr *saddr = addr;
+
+	if (!is_valid_ether_addr(saddr->sa_data))
+		return -EADDRNOTAVAIL;
+
+	netif_addr_lock_bh(ndev);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	eth_hw_addr_set(ndev, saddr->sa_data);
+#else
+	memcpy(ndev->dev_addr, saddr->sa_data, ETH_ALEN);
+#endif
+	netif_addr_unlock_bh(ndev);
+
+	return 0;
+}
+
+static int mqnic_change_mtu(struct net_device *ndev, int new_mtu)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+
+	if (new_mtu < ndev->min_mtu || new_mtu > ndev->max_mtu) {
+		netdev_err(ndev, "Bad MTU: %d", new_mtu);
+		return -EPERM;
+	}
+
+	if (priv->xdp_prog && new_mtu > MQNIC_XDP_MAX_MTU) {
+		netdev_err(ndev, "MTU %d too large for XDP (max %lu)", new_mtu, MQNIC_XDP_MAX_MTU);
+		return -EINVAL;
+	}
+
+	netdev_info(ndev, "New MTU: %d", new_mtu);
+
+	ndev->mtu = new_mtu;
+
+	if (netif_running(ndev)) {
+		mutex_lock(&mdev->state_lock);
+
+		mqnic_stop_port(ndev);
+		mqnic_start_port(ndev);
+
+		mutex_unlock(&mdev->state_lock);
+	}
+
+	return 0;
+}
+
+static int mqnic_ioctl(struct net_device *ndev, struct ifreq *ifr, int cmd)
+{
+	switch (cmd) {
+	case SIOCSHWTSTAMP:
+		return mqnic_hwtstamp_set(ndev, ifr);
+	case SIOCGHWTSTAMP:
+		return mqnic_hwtstamp_get(ndev, ifr);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+static int mqnic_setup_mqprio(struct net_device *ndev, struct tc_mqprio_qopt_offload *mqprio)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	u8 num_tc = mqprio->qopt.num_tc;
+	int port_up;
+	int ret = 0;
+	int k;
+
+	mqprio->qopt.hw = TC_MQPRIO_HW_OFFLOAD_TCS;
+
+	if (priv->dcb_tcs) {
+		netdev_err(ndev, "Traffic classes are set up through DCB");
+		return -EBUSY;
+	}
+
+	if (num_tc > priv->interface->sched_tc_count) {
+		netdev_err(ndev, "Scheduler supports at most %d traffic classes",
+				priv->interface->sched_tc_count);
+		return -EINVAL;
+	}
+
+	for (k = 0; k < num_tc; k++) {
+		if (!mqprio->qopt.count[k] ||
+				mqprio->qopt.offset[k] + mqprio->qopt.count[k] > priv->txq_count)
+			return -EINVAL;
+	}
+
+	if (mqprio->flags & TC_MQPRIO_F_SHAPER &&
+			(mqprio->mode != TC_MQPRIO_MODE_CHANNEL ||
+			mqprio->shaper != TC_MQPRIO_SHAPER_BW_RATE))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&mdev->state_lock);
+
+	// queue to TC assignment and channel budgets are set on port start
+	port_up = priv->port_up;
+
+	if (port_up)
+		mqnic_stop_port(ndev);
+
+	memset(priv->tc_min_rate, 0, sizeof(priv->tc_min_rate));
+	memset(priv->tc_max_rate, 0, sizeof(priv->tc_max_rate));
+
+	if (!num_tc) {
+		netdev_reset_tc(ndev);
+	} else {
+		ret = netdev_set_num_tc(ndev, num_tc);
+		if (ret)
+			goto out;
+
+		for (k = 0; k < num_tc; k++) {
+			netdev_set_tc_queue(ndev, k, mqprio->qopt.count[k], mqprio->qopt.offset[k]);
+
+			if (mqprio->flags & TC_MQPRIO_F_MIN_RATE)
+				priv->tc_min_rate[k] = mqprio->min_rate[k];
+			if (mqprio->flags & TC_MQPRIO_F_MAX_RATE)
+				priv->tc_max_rate[k] = mqprio->max_rate[k];
+		}
+
+		for (k = 0; k <= TC_BITMASK; k++)
+			netdev_set_prio_tc_map(ndev, k, mqprio->qopt.prio_tc_map[k]);
+	}
+
+out:
+	if (port_up) {
+		int err = mqnic_start_port(ndev);
+
+		if (err) {
+			netdev_err(ndev, "Failed to start port on interface %d: %d",
+					priv->interface->index, err);
+			if (!ret)
+				ret = err;
+		}
+	}
+
+	mutex_unlock(&mdev->state_lock);
+
+	return ret;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0)
+static int mqnic_setup_etf(struct net_device *ndev, struct tc_etf_qopt_offload *qopt)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+
+	if (!(priv->if_features & MQNIC_IF_FEATURE_TX_LAUNCH_TIME) ||
+			priv->interface->max_desc_block_size < 2)
+		return -EOPNOTSUPP;
+
+	if (qopt->queue < 0 || qopt->queue >= ndev->num_tx_queues)
+		return -EINVAL;
+
+	// picked up by the next frame on the queue, no restart needed
+	if (qopt->enable)
+		set_bit(qopt->queue, priv->txq_launch_time);
+	else
+		clear_bit(qopt->queue, priv->txq_launch_time);
+
+	return 0;
+}
+#endif
+
+static int mqnic_setup_tc(struct net_device *ndev, enum tc_setup_type type, void *type_data)
+{
+	switch (type) {
+	case TC_SETUP_QDISC_MQPRIO:
+		return mqnic_setup_mqprio(ndev, type_data);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0)
+	case TC_SETUP_QDISC_ETF:
+		return mqnic_setup_etf(ndev, type_data);
+#endif
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+#endif
+
+static int mqnic_set_tx_maxrate(struct net_device *ndev, int queue_index, u32 maxrate)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	struct mqnic_ring *q;
+	int ret = 0;
+
+	if (!priv->interface->sched_rate_limit)
+		return -EOPNOTSUPP;
+
+	if (queue_index < 0 || queue_index >= priv->txq_count)
+		return -EINVAL;
+
+	mutex_lock(&mdev->state_lock);
+
+	// programmed from the queue's tx_maxrate on port start otherwise
+	if (priv->port_up) {
+		q = priv->txq_table[queue_index];
+		ret = mqnic_sched_port_queue_set_rate(priv->sched_port, q->index, maxrate,
+				mqnic_tx_rate_burst(priv, maxrate));
+	}
+
+	mutex_unlock(&mdev->state_lock);
+
+	return ret;
+}
+
+// caller holds mdev->state_lock
+void mqnic_set_port_loopback(struct mqnic_priv *priv, bool enable)
+{
+	priv->loopback = enable;
+
+	if (priv->port_up)
+		mqnic_port_set_tx_ctrl(priv->port, MQNIC_PORT_TX_CTRL_EN |
+				(enable ? MQNIC_PORT_TX_CTRL_LOOPBACK : 0));
+}
+
+#ifdef MQNIC_L2FW
+// caller holds the netdev instance lock, see mqnic_netdev_lock()
+static void mqnic_fwd_free_station_locked(struct mqnic_fwd_station *st)
+{
+	struct mqnic_priv *priv = st->priv;
+
+	mutex_lock(&priv->mdev->state_lock);
+
+	if (priv->port_up)
+		mqnic_fwd_close_station(st);
+
+	WRITE_ONCE(priv->fwd_station[st->index], NULL);
+	if (--priv->fwd_count == 0)
+		netif_set_real_num_tx_queues(priv->ndev, priv->txq_count);
+
+	mqnic_interface_free_l2_entry(priv->interface, st->l2_index);
+
+	mutex_unlock(&priv->mdev->state_lock);
+
+	// wait for mqnic_select_queue callers still looking at the slot
+	synchronize_net();
+
+	netdev_set_sb_channel(st->vdev, 0);
+	kfree(st);
+}
+
+static void mqnic_fwd_free_station(struct mqnic_fwd_station *st)
+{
+	struct net_device *ndev = st->priv->ndev;
+
+	// macvlan calls in with only RTNL held
+	mqnic_netdev_lock(ndev);
+	mqnic_fwd_free_station_locked(st);
+	mqnic_netdev_unlock(ndev);
+}
+
+static void *mqnic_fwd_add_station(struct net_device *ndev, struct net_device *vdev)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_fwd_station *st;
+	int index;
+	int ret;
+
+	if (priv->xdp_prog)
+		return ERR_PTR(-EBUSY);
+
+	for (index = 0; index < MQNIC_MAX_FWD_STATIONS; index++) {
+		if (!priv->fwd_station[index])
+			break;
+	}
+
+	if (index >= MQNIC_MAX_FWD_STATIONS)
+		return ERR_PTR(-ENOSPC);
+
+	// station queues must stay clear of the ones the port itself uses
+	if ((int)ndev->num_tx_queues - (index + 1) * MQNIC_FWD_QUEUES < (int)priv->txq_count ||
+			(int)ndev->num_rx_queues - (index + 1) * MQNIC_FWD_QUEUES < (int)priv->rxq_count)
+		return ERR_PTR(-ENOSPC);
+
+	st = kzalloc(sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return ERR_PTR(-ENOMEM);
+
+	st->priv = priv;
+	st->vdev = vdev;
+	st->index = index;
+	st->txq_base = ndev->num_tx_queues - (index + 1) * MQNIC_FWD_QUEUES;
+	st->rxq_base = ndev->num_rx_queues - (index + 1) * MQNIC_FWD_QUEUES;
+
+	st->l2_index = mqnic_interface_alloc_l2_entry(priv->interface);
+	if (st->l2_index < 0) {
+		ret = st->l2_index;
+		kfree(st);
+		return ERR_PTR(ret);
+	}
+
+	// channel 0 means "not a subordinate", so station n uses channel n + 1
+	netdev_set_sb_channel(vdev, index + 1);
+
+	mqnic_netdev_lock(ndev);
+	mutex_lock(&priv->mdev->state_lock);
+
+	WRITE_ONCE(priv->fwd_station[index], st);
+	if (priv->fwd_count++ == 0)
+		netif_set_real_num_tx_queues(ndev, ndev->num_tx_queues);
+
+	ret = priv->port_up ? mqnic_fwd_open_station(st) : 0;
+
+	mutex_unlock(&priv->mdev->state_lock);
+	mqnic_netdev_unlock(ndev);
+
+	if (ret) {
+		mqnic_fwd_free_station(st);
+		return ERR_PTR(ret);
+	}
 
-	ret = mqnic_start_port(ndev);
+	netdev_info(ndev, "Offloaded %s onto TX queues %u-%u",
+			netdev_name(vdev), st->txq_base, st->txq_base + MQNIC_FWD_QUEUES - 1);
 
-	if (ret)
-		netdev_err(ndev, "Failed to start port on interface %d: %d",
-				priv->interface->index, ret);
+	return st;
+}
 
-	mutex_unlock(&mdev->state_lock);
-	return ret;
+static void mqnic_fwd_del_station(struct net_device *ndev, void *accel_priv)
+{
+	mqnic_fwd_free_station(accel_priv);
 }
 
-static int mqnic_close(struct net_device *ndev)
+static u16 mqnic_select_queue(struct net_device *ndev, struct sk_buff *skb,
+		struct net_device *sb_dev)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
-	struct mqnic_dev *mdev = priv->mdev;
-	int ret = 0;
+	struct mqnic_fwd_station *st;
+	int channel = sb_dev ? netdev_get_sb_channel(sb_dev) : 0;
 
-	mutex_lock(&mdev->state_lock);
+	if (channel > 0 && channel <= MQNIC_MAX_FWD_STATIONS) {
+		st = READ_ONCE(priv->fwd_station[channel - 1]);
 
-	mqnic_stop_port(ndev);
+		if (st && st->vdev == sb_dev)
+			return st->txq_base + reciprocal_scale(skb_get_hash(skb), MQNIC_FWD_QUEUES);
+	}
 
-	mutex_unlock(&mdev->state_lock);
-	return ret;
+	// the stack must not spread port traffic onto station queues
+	return netdev_pick_tx(ndev, skb, NULL) % READ_ONCE(priv->txq_count);
 }
+#endif
 
-int mqnic_update_indir_table(struct net_device *ndev)
+static int mqnic_set_features(struct net_device *ndev, netdev_features_t features)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
-	struct mqnic_if *iface = priv->interface;
-	struct mqnic_ring *q;
-	int k;
+	netdev_features_t changed = ndev->features ^ features;
 
-	mqnic_interface_set_rx_queue_map_rss_mask(iface, priv->port->index, 0xffffffff);
-	mqnic_interface_set_rx_queue_map_app_mask(iface, priv->port->index, 0);
+	// drop all steering rules when ntuple filtering is turned off
+	if ((changed & NETIF_F_NTUPLE) && !(features & NETIF_F_NTUPLE))
+		mqnic_interface_clear_flow_rules(priv->interface, priv);
 
-	for (k = 0; k < priv->rx_queue_map_indir_table_size; k++) {
-		rcu_read_lock();
-		q = radix_tree_lookup(&priv->rxq_table, priv->rx_queue_map_indir_table[k]);
-		rcu_read_unlock();
+#ifdef MQNIC_L2FW
+	// hand offloaded macvlans back to the software path
+	if ((changed & NETIF_F_HW_L2FW_DOFFLOAD) && !(features & NETIF_F_HW_L2FW_DOFFLOAD)) {
+		struct mqnic_fwd_station *st;
+		int k;
 
-		if (q)
-			mqnic_interface_set_rx_queue_map_indir_table(iface, priv->port->index, k, q->index);
+		for (k = 0; k < MQNIC_MAX_FWD_STATIONS; k++) {
+			st = priv->fwd_station[k];
+
+			if (!st)
+				continue;
+
+			macvlan_release_l2fw_offload(st->vdev);
+			mqnic_fwd_free_station_locked(st);
+		}
+	}
+#endif
+
+	if (changed & NETIF_F_LOOPBACK) {
+		mutex_lock(&priv->mdev->state_lock);
+		mqnic_set_port_loopback(priv, !!(features & NETIF_F_LOOPBACK));
+		mutex_unlock(&priv->mdev->state_lock);
 	}
 
 	return 0;
 }
 
-void mqnic_update_stats(struct net_device *ndev)
+#ifdef CONFIG_RFS_ACCEL
+static int mqnic_rx_flow_steer(struct net_device *ndev, const struct sk_buff *skb,
+		u16 rxq_index, u32 flow_id)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
-	struct radix_tree_iter iter;
-	void **slot;
-	unsigned long packets, bytes;
-	unsigned long dropped;
+	struct mqnic_flow_rule rule = {0};
+	struct flow_keys keys;
+	int ret;
 
-	if (unlikely(!priv->port_up))
-		return;
+	if (!priv->port_up || rxq_index >= priv->rxq_count)
+		return -EINVAL;
 
-	packets = 0;
-	bytes = 0;
-	dropped = 0;
-	down_read(&priv->rxq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->rxq_table, &iter, 0) {
-		const struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+	if (!skb_flow_dissect_flow_keys(skb, &keys, 0))
+		return -EPROTONOSUPPORT;
 
-		packets += READ_ONCE(q->packets);
-		bytes += READ_ONCE(q->bytes);
-		dropped += READ_ONCE(q->dropped_packets);
-	}
-	up_read(&priv->rxq_table_sem);
-	ndev->stats.rx_packets = packets;
-	ndev->stats.rx_bytes = bytes;
-	ndev->stats.rx_dropped = dropped;
+	// table matches on the IPv4 5-tuple only
+	if (keys.basic.n_proto != htons(ETH_P_IP) ||
+			(keys.basic.ip_proto != IPPROTO_TCP && keys.basic.ip_proto != IPPROTO_UDP) ||
+			(keys.control.flags & FLOW_DIS_IS_FRAGMENT))
+		return -EPROTONOSUPPORT;
 
-	packets = 0;
-	bytes = 0;
-	dropped = 0;
-	down_read(&priv->txq_table_sem);
-	radix_tree_for_each_slot(slot, &priv->txq_table, &iter, 0) {
-		const struct mqnic_ring *q = (struct mqnic_ring *)*slot;
+	rule.priv = priv;
+	rule.src_ip = keys.addrs.v4addrs.src;
+	rule.dst_ip = keys.addrs.v4addrs.dst;
+	rule.src_port = keys.ports.src;
+	rule.dst_port = keys.ports.dst;
+	rule.ip_proto = keys.basic.ip_proto;
+	rule.rxq = rxq_index;
+	rule.arfs = true;
+	rule.flow_id = flow_id;
 
-		packets += READ_ONCE(q->packets);
-		bytes += READ_ONCE(q->bytes);
-		dropped += READ_ONCE(q->dropped_packets);
-	}
-	up_read(&priv->txq_table_sem);
-	ndev->stats.tx_packets = packets;
-	ndev->stats.tx_bytes = bytes;
-	ndev->stats.tx_dropped = dropped;
+	ret = mqnic_interface_add_flow_rule(priv->interface, -1, &rule);
+
+	if (ret >= 0)
+		schedule_work(&priv->arfs_expire_work);
+
+	return ret;
 }
 
-static void mqnic_get_stats64(struct net_device *ndev,
-		struct rtnl_link_stats64 *stats)
+static void mqnic_arfs_expire_work(struct work_struct *work)
 {
-	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_priv *priv = container_of(work, struct mqnic_priv, arfs_expire_work);
 
-	spin_lock_bh(&priv->stats_lock);
-	mqnic_update_stats(ndev);
-	netdev_stats_to_stats64(stats, &ndev->stats);
-	spin_unlock_bh(&priv->stats_lock);
+	mqnic_interface_expire_flow_rules(priv->interface, priv);
 }
+#endif
 
-static int mqnic_hwtstamp_set(struct net_device *ndev, struct ifreq *ifr)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0) && LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0)
+static struct devlink_port *mqnic_get_devlink_port(struct net_device *ndev)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
-	struct hwtstamp_config hwts_config;
+	return priv->dl_port;
+}
+#endif
 
-	if (copy_from_user(&hwts_config, ifr->ifr_data, sizeof(hwts_config)))
-		return -EFAULT;
+#ifdef MQNIC_NETMEM
+struct mqnic_queue_mem {
+	struct mqnic_ring *ring;
+};
 
-	if (hwts_config.flags)
-		return -EINVAL;
+// the core restarts RX queue idx through these to bind or release a memory
+// provider: a replacement ring is built first, so its payload page pool is
+// created against the new binding, and is then swapped in for the old one
+// the way an online resize does; with the port down nothing is built and
+// the rings pick the binding up on the next start
+static int mqnic_queue_mem_alloc(struct net_device *ndev, void *per_queue_mem, int idx)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_queue_mem *mem = per_queue_mem;
+	struct mqnic_ring *q;
+	int ret = 0;
 
-	switch (hwts_config.tx_type) {
-	case HWTSTAMP_TX_OFF:
-	case HWTSTAMP_TX_ON:
-		break;
-	default:
-		return -ERANGE;
-	}
+	mem->ring = NULL;
 
-	switch (hwts_config.rx_filter) {
-	case HWTSTAMP_FILTER_NONE:
-		break;
-	case HWTSTAMP_FILTER_ALL:
-	case HWTSTAMP_FILTER_SOME:
-	case HWTSTAMP_FILTER_PTP_V1_L4_EVENT:
-	case HWTSTAMP_FILTER_PTP_V1_L4_SYNC:
-	case HWTSTAMP_FILTER_PTP_V1_L4_DELAY_REQ:
-	case HWTSTAMP_FILTER_PTP_V2_L4_EVENT:
-	case HWTSTAMP_FILTER_PTP_V2_L4_SYNC:
-	case HWTSTAMP_FILTER_PTP_V2_L4_DELAY_REQ:
-	case HWTSTAMP_FILTER_PTP_V2_L2_EVENT:
-	case HWTSTAMP_FILTER_PTP_V2_L2_SYNC:
-	case HWTSTAMP_FILTER_PTP_V2_L2_DELAY_REQ:
-	case HWTSTAMP_FILTER_PTP_V2_EVENT:
-	case HWTSTAMP_FILTER_PTP_V2_SYNC:
-	case HWTSTAMP_FILTER_PTP_V2_DELAY_REQ:
-	case HWTSTAMP_FILTER_NTP_ALL:
-		hwts_config.rx_filter = HWTSTAMP_FILTER_ALL;
-		break;
-	default:
-		return -ERANGE;
+	mutex_lock(&priv->mdev->state_lock);
+
+	if (!priv->port_up)
+		goto out;
+
+	if (!mqnic_can_reconfigure_online(priv) || idx >= priv->rxq_count) {
+		ret = -EOPNOTSUPP;
+		goto out;
 	}
 
-	memcpy(&priv->hwts_config, &hwts_config, sizeof(hwts_config));
+	q = mqnic_create_rx_queue(ndev, idx, priv->rx_ring_size, -1);
+	if (IS_ERR_OR_NULL(q)) {
+		ret = PTR_ERR(q) ?: -ENOMEM;
+		goto out;
+	}
 
-	if (copy_to_user(ifr->ifr_data, &hwts_config, sizeof(hwts_config)))
-		return -EFAULT;
+	mem->ring = q;
 
-	return 0;
+out:
+	mutex_unlock(&priv->mdev->state_lock);
+	return ret;
 }
 
-static int mqnic_hwtstamp_get(struct net_device *ndev, struct ifreq *ifr)
+static void mqnic_queue_mem_free(struct net_device *ndev, void *per_queue_mem)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_queue_mem *mem = per_queue_mem;
 
-	if (copy_to_user(ifr->ifr_data, &priv->hwts_config, sizeof(priv->hwts_config)))
-		return -EFAULT;
+	if (!mem->ring)
+		return;
 
-	return 0;
+	mutex_lock(&priv->mdev->state_lock);
+	mqnic_destroy_rx_queue(mem->ring, true);
+	mutex_unlock(&priv->mdev->state_lock);
+
+	mem->ring = NULL;
 }
 
-static int mqnic_set_mac(struct net_device *ndev, void *addr)
+static int mqnic_queue_start(struct net_device *ndev, void *per_queue_mem, int idx)
 {
-	struct sockaddr *saddr = addr;
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_queue_mem *mem = per_queue_mem;
+	struct mqnic_ring *q = mem->ring;
+	int ret;
 
-	if (!is_valid_ether_addr(saddr->sa_data))
-		return -EADDRNOTAVAIL;
+	if (!q)
+		return 0;
 
-	netif_addr_lock_bh(ndev);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
-	eth_hw_addr_set(ndev, saddr->sa_data);
-#else
-	memcpy(ndev->dev_addr, saddr->sa_data, ETH_ALEN);
+	mutex_lock(&priv->mdev->state_lock);
+
+	ret = mqnic_enable_rx_ring(q);
+	if (ret)
+		goto out;
+
+	rcu_assign_pointer(priv->rxq_table[idx], q);
+	mqnic_update_indir_table(ndev);
+	mqnic_interface_update_flow_rules(priv->interface, priv);
+	mqnic_capture_update(priv->interface, priv);
+
+#ifdef CONFIG_RFS_ACCEL
+	mqnic_update_rx_cpu_rmap(priv);
 #endif
-	netif_addr_unlock_bh(ndev);
 
-	return 0;
+	// the ring now belongs to the port again
+	mem->ring = NULL;
+
+out:
+	mutex_unlock(&priv->mdev->state_lock);
+	return ret;
 }
 
-static int mqnic_change_mtu(struct net_device *ndev, int new_mtu)
+// the stopped ring stays published, disabled, until its replacement starts
+static int mqnic_queue_stop(struct net_device *ndev, void *per_queue_mem, int idx)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
-	struct mqnic_dev *mdev = priv->mdev;
-
-	if (new_mtu < ndev->min_mtu || new_mtu > ndev->max_mtu) {
-		netdev_err(ndev, "Bad MTU: %d", new_mtu);
-		return -EPERM;
-	}
+	struct mqnic_queue_mem *mem = per_queue_mem;
+	struct mqnic_ring *old;
 
-	netdev_info(ndev, "New MTU: %d", new_mtu);
+	mem->ring = NULL;
 
-	ndev->mtu = new_mtu;
+	mutex_lock(&priv->mdev->state_lock);
 
-	if (netif_running(ndev)) {
-		mutex_lock(&mdev->state_lock);
+	if (priv->port_up && idx < priv->rxq_count) {
+		old = priv->rxq_table[idx];
 
-		mqnic_stop_port(ndev);
-		mqnic_start_port(ndev);
+		// let in-flight frames land
+		mqnic_disable_rx_ring(old);
+		msleep(20);
+		synchronize_net();
 
-		mutex_unlock(&mdev->state_lock);
+		mem->ring = old;
 	}
 
+	mutex_unlock(&priv->mdev->state_lock);
 	return 0;
 }
 
-static int mqnic_ioctl(struct net_device *ndev, struct ifreq *ifr, int cmd)
-{
-	switch (cmd) {
-	case SIOCSHWTSTAMP:
-		return mqnic_hwtstamp_set(ndev, ifr);
-	case SIOCGHWTSTAMP:
-		return mqnic_hwtstamp_get(ndev, ifr);
-	default:
-		return -EOPNOTSUPP;
-	}
-}
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0) && LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0)
-static struct devlink_port *mqnic_get_devlink_port(struct net_device *ndev)
-{
-	struct mqnic_priv *priv = netdev_priv(ndev);
-	return priv->dl_port;
-}
+static const struct netdev_queue_mgmt_ops mqnic_queue_mgmt_ops = {
+	.ndo_queue_mem_size = sizeof(struct mqnic_queue_mem),
+	.ndo_queue_mem_alloc = mqnic_queue_mem_alloc,
+	.ndo_queue_mem_free = mqnic_queue_mem_free,
+	.ndo_queue_start = mqnic_queue_start,
+	.ndo_queue_stop = mqnic_queue_stop,
+};
 #endif
 
 static const struct net_device_ops mqnic_netdev_ops = {
 	.ndo_open = mqnic_open,
 	.ndo_stop = mqnic_close,
 	.ndo_start_xmit = mqnic_start_xmit,
+	.ndo_tx_timeout = mqnic_tx_timeout,
+	.ndo_features_check = mqnic_features_check,
 	.ndo_get_stats64 = mqnic_get_stats64,
 	.ndo_validate_addr = eth_validate_addr,
 	.ndo_set_mac_address = mqnic_set_mac,
 	.ndo_change_mtu = mqnic_change_mtu,
+	.ndo_set_features = mqnic_set_features,
+#ifdef MQNIC_L2FW
+	.ndo_select_queue = mqnic_select_queue,
+	.ndo_dfwd_add_station = mqnic_fwd_add_station,
+	.ndo_dfwd_del_station = mqnic_fwd_del_station,
+#endif
+	.ndo_set_tx_maxrate = mqnic_set_tx_maxrate,
+#ifdef CONFIG_PCI
+	.ndo_set_vf_mac = mqnic_set_vf_mac,
+	.ndo_get_vf_config = mqnic_get_vf_config,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+	.ndo_setup_tc = mqnic_setup_tc,
+#endif
+#ifdef CONFIG_RFS_ACCEL
+	.ndo_rx_flow_steer = mqnic_rx_flow_steer,
+#endif
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
 	.ndo_eth_ioctl = mqnic_ioctl,
 #else
@@ -584,29 +2263,18 @@ static const struct net_device_ops mqnic_netdev_ops = {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0) && LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0)
 	.ndo_get_devlink_port = mqnic_get_devlink_port,
 #endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	.ndo_bpf = mqnic_xdp,
+	.ndo_xdp_xmit = mqnic_xdp_xmit,
+	.ndo_xsk_wakeup = mqnic_xsk_wakeup,
+#endif
 };
 
 static void mqnic_link_status_timeout(struct timer_list *timer)
 {
 	struct mqnic_priv *priv = mqnic_from_timer(priv, timer, link_status_timer);
-	unsigned int up = 1;
 
-	if (!(mqnic_port_get_tx_ctrl(priv->port) & MQNIC_PORT_TX_CTRL_STATUS))
-		up = 0;
-	if (!(mqnic_port_get_rx_ctrl(priv->port) & MQNIC_PORT_RX_CTRL_STATUS))
-		up = 0;
-
-	if (up) {
-		if (!priv->link_status) {
-			netif_carrier_on(priv->ndev);
-			priv->link_status = !priv->link_status;
-		}
-	} else {
-		if (priv->link_status) {
-			netif_carrier_off(priv->ndev);
-			priv->link_status = !priv->link_status;
-		}
-	}
+	mqnic_update_link_status(priv);
 
 	mod_timer(&priv->link_status_timer, jiffies + msecs_to_jiffies(mqnic_link_status_poll));
 }
@@ -638,7 +2306,6 @@ struct net_device *mqnic_create_netdev(struct mqnic_if *interface, struct mqnic_
 	priv = netdev_priv(ndev);
 	memset(priv, 0, sizeof(struct mqnic_priv));
 
-	spin_lock_init(&priv->stats_lock);
 
 	priv->ndev = ndev;
 	priv->mdev = interface->mdev;
@@ -649,6 +2316,12 @@ struct net_device *mqnic_create_netdev(struct mqnic_if *interface, struct mqnic_
 	priv->port_up = false;
 	priv->sched_port = NULL;
 
+#ifdef CONFIG_RFS_ACCEL
+	INIT_WORK(&priv->arfs_expire_work, mqnic_arfs_expire_work);
+#endif
+	INIT_WORK(&priv->tx_timeout_work, mqnic_tx_timeout_work);
+	mqnic_rss_init(priv);
+
 	// associate interface resources
 	priv->if_features = interface->if_features;
 
@@ -660,11 +2333,8 @@ struct net_device *mqnic_create_netdev(struct mqnic_if *interface, struct mqnic_
 	priv->rx_ring_size = roundup_pow_of_two(clamp_t(u32, mqnic_num_rxq_entries,
 			MQNIC_MIN_RX_RING_SZ, MQNIC_MAX_RX_RING_SZ));
 
-	init_rwsem(&priv->txq_table_sem);
-	INIT_RADIX_TREE(&priv->txq_table, GFP_KERNEL);
-
-	init_rwsem(&priv->rxq_table_sem);
-	INIT_RADIX_TREE(&priv->rxq_table, GFP_KERNEL);
+	priv->rx_copybreak = mdev->rx_copybreak;
+	priv->tx_copybreak = mdev->tx_copybreak;
 
 	netif_set_real_num_tx_queues(ndev, priv->txq_count);
 	netif_set_real_num_rx_queues(ndev, priv->rxq_count);
@@ -704,9 +2374,54 @@ struct net_device *mqnic_create_netdev(struct mqnic_if *interface, struct mqnic_
 	for (k = 0; k < priv->rx_queue_map_indir_table_size; k++)
 		priv->rx_queue_map_indir_table[k] = k % priv->rxq_count;
 
+	priv->txq_table = kcalloc(ndev->num_tx_queues, sizeof(*priv->txq_table), GFP_KERNEL);
+	priv->rxq_table = kcalloc(ndev->num_rx_queues, sizeof(*priv->rxq_table), GFP_KERNEL);
+	if (!priv->txq_table || !priv->rxq_table) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	priv->xsk_zc_qps = bitmap_zalloc(ndev->num_rx_queues, GFP_KERNEL);
+	if (!priv->xsk_zc_qps) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	priv->txq_launch_time = bitmap_zalloc(ndev->num_tx_queues, GFP_KERNEL);
+	if (!priv->txq_launch_time) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	priv->txq_timed_out = bitmap_zalloc(ndev->num_tx_queues, GFP_KERNEL);
+	if (!priv->txq_timed_out) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	u64_stats_init(&priv->retired_syncp);
+
+#ifdef CONFIG_RFS_ACCEL
+	// one entry per RX queue; affinities are filled in when the port starts
+	if (interface->rx_flow_rules) {
+		ndev->rx_cpu_rmap = alloc_cpu_rmap(ndev->num_rx_queues, GFP_KERNEL);
+		if (!ndev->rx_cpu_rmap) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		for (k = 0; k < ndev->num_rx_queues; k++)
+			cpu_rmap_add(ndev->rx_cpu_rmap, priv);
+	}
+#endif
+
 	// entry points
 	ndev->netdev_ops = &mqnic_netdev_ops;
 	ndev->ethtool_ops = &mqnic_ethtool_ops;
+	mqnic_dcb_init(priv);
+#ifdef MQNIC_NETMEM
+	ndev->queue_mgmt_ops = &mqnic_queue_mgmt_ops;
+#endif
 
 	// set up features
 	ndev->hw_features = NETIF_F_SG;
@@ -714,11 +2429,68 @@ struct net_device *mqnic_create_netdev(struct mqnic_if *interface, struct mqnic_
 	if (priv->if_features & MQNIC_IF_FEATURE_RX_CSUM)
 		ndev->hw_features |= NETIF_F_RXCSUM;
 
+	if (priv->if_features & MQNIC_IF_FEATURE_RX_HASH)
+		ndev->hw_features |= NETIF_F_RXHASH;
+
+	if (port->port_features & MQNIC_PORT_FEATURE_LOOPBACK)
+		ndev->hw_features |= NETIF_F_LOOPBACK;
+
 	if (priv->if_features & MQNIC_IF_FEATURE_TX_CSUM)
 		ndev->hw_features |= NETIF_F_HW_CSUM;
 
+	if (priv->if_features & MQNIC_IF_FEATURE_TSO) {
+		ndev->hw_features |= NETIF_F_TSO | NETIF_F_TSO6;
+		if (priv->if_features & MQNIC_IF_FEATURE_TSO_TUNNEL)
+			ndev->hw_features |= NETIF_F_GSO_UDP_TUNNEL;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+		if (priv->if_features & MQNIC_IF_FEATURE_USO)
+			ndev->hw_features |= NETIF_F_GSO_UDP_L4;
+#endif
+#ifdef MQNIC_SW_TSO
+	} else if (priv->if_features & MQNIC_IF_FEATURE_TX_CSUM && desc_block_size > 1) {
+		// segmented in the driver, one ring entry per segment; net/tso
+		// handles UDP datagrams as well as TCP
+		ndev->hw_features |= NETIF_F_TSO | NETIF_F_TSO6 | NETIF_F_GSO_UDP_L4;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+		netif_set_tso_max_segs(ndev, MQNIC_MIN_TX_RING_SZ / 4);
+#else
+		ndev->gso_max_segs = MQNIC_MIN_TX_RING_SZ / 4;
+#endif
+#endif
+	}
+
+	if (priv->if_features & MQNIC_IF_FEATURE_VLAN_TX && desc_block_size > 2)
+		ndev->hw_features |= NETIF_F_HW_VLAN_CTAG_TX;
+
 	ndev->features = ndev->hw_features | NETIF_F_HIGHDMA;
-	ndev->hw_features |= 0;
+
+	if (priv->if_features & MQNIC_IF_FEATURE_VLAN_RX)
+		ndev->features |= NETIF_F_HW_VLAN_CTAG_RX;
+
+	// VLAN devices on top keep the offloads once the tag leaves the frame
+	ndev->vlan_features = ndev->features & (NETIF_F_SG | NETIF_F_HW_CSUM | NETIF_F_RXCSUM |
+			NETIF_F_TSO | NETIF_F_TSO6 | NETIF_F_HIGHDMA);
+
+	// the checksum command takes any start, so inner headers of a tunnel
+	// are covered too, within the reach of the command
+	if (priv->if_features & MQNIC_IF_FEATURE_TX_CSUM) {
+		ndev->hw_enc_features = NETIF_F_SG | NETIF_F_HW_CSUM | NETIF_F_HIGHDMA;
+		if (ndev->features & NETIF_F_GSO_UDP_TUNNEL)
+			ndev->hw_enc_features |= NETIF_F_TSO | NETIF_F_TSO6 | NETIF_F_GSO_UDP_TUNNEL;
+	}
+
+	// flow steering is off until enabled with ethtool
+	if (interface->rx_flow_rules)
+		ndev->hw_features |= NETIF_F_NTUPLE;
+#ifdef MQNIC_L2FW
+	if (interface->rx_l2_table_rb)
+		ndev->hw_features |= NETIF_F_HW_L2FW_DOFFLOAD;
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	ndev->xdp_features = NETDEV_XDP_ACT_BASIC | NETDEV_XDP_ACT_REDIRECT |
+		NETDEV_XDP_ACT_NDO_XMIT | NETDEV_XDP_ACT_XSK_ZEROCOPY;
+#endif
 
 	ndev->min_mtu = ETH_MIN_MTU;
 	ndev->max_mtu = 1500;
@@ -727,7 +2499,9 @@ struct net_device *mqnic_create_netdev(struct mqnic_if *interface, struct mqnic_
 		ndev->max_mtu = min(interface->max_tx_mtu, interface->max_rx_mtu) - ETH_HLEN;
 
 	netif_carrier_off(ndev);
-	if (mqnic_link_status_poll)
+	spin_lock_init(&priv->link_status_lock);
+	priv->link_event = !!(port->port_features & MQNIC_PORT_FEATURE_LINK_EVENT);
+	if (!priv->link_event && mqnic_link_status_poll)
 		timer_setup(&priv->link_status_timer, mqnic_link_status_timeout, 0);
 
 	ret = register_netdev(ndev);
@@ -743,6 +2517,47 @@ struct net_device *mqnic_create_netdev(struct mqnic_if *interface, struct mqnic_
 
 	priv->registered = 1;
 
+	WRITE_ONCE(port->ndev, ndev);
+
+	mqnic_create_netdev_debugfs(priv);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 12, 0)
+	// default for the sysfs threaded attribute; NAPI instances added on
+	// port start pick it up, and each CQ is still armed from its poll thread
+	if (mqnic_napi_threaded) {
+		rtnl_lock();
+		ret = dev_set_threaded(ndev, true);
+		rtnl_unlock();
+		if (ret)
+			dev_warn(dev, "Failed to enable threaded NAPI: %d", ret);
+		ret = 0;
+	}
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+	// expose the port-level TX cap and queue weights as a devlink rate object
+	if (interface->sched_rate_limit || interface->sched_dwrr) {
+		struct devlink *devlink = priv_to_devlink(mdev);
+
+		priv->dl_rate.priv = priv;
+
+		devl_lock(devlink);
+		ret = devl_rate_leaf_create(&port->dl_port, &priv->dl_rate, NULL);
+		if (!ret) {
+			list_add_tail(&priv->dl_rate.list, &mdev->rate_list);
+			mqnic_devl_rate_update(mdev);
+		}
+		devl_unlock(devlink);
+
+		if (ret)
+			dev_warn(dev, "Failed to create devlink rate object: %d", ret);
+		else
+			priv->dl_rate_leaf = true;
+
+		ret = 0;
+	}
+#endif
+
 	return ndev;
 
 fail:
@@ -754,10 +2569,48 @@ void mqnic_destroy_netdev(struct net_device *ndev)
 {
 	struct mqnic_priv *priv = netdev_priv(ndev);
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+	if (priv->dl_rate_leaf) {
+		struct devlink *devlink = priv_to_devlink(priv->mdev);
+
+		devl_lock(devlink);
+		devl_rate_leaf_destroy(priv->dl_port);
+		list_del(&priv->dl_rate.list);
+		mqnic_devl_rate_update(priv->mdev);
+		devl_unlock(devlink);
+	}
+#endif
+
+	mqnic_destroy_netdev_debugfs(priv);
+
 	if (priv->registered)
 		unregister_netdev(ndev);
 
+	WRITE_ONCE(priv->port->ndev, NULL);
+
+	// let a port status event already past the pointer finish
+	synchronize_rcu();
+
+	mqnic_interface_clear_flow_rules(priv->interface, priv);
+
+	cancel_work_sync(&priv->tx_timeout_work);
+	mqnic_rss_stop(priv);
+
+#ifdef CONFIG_RFS_ACCEL
+	cancel_work_sync(&priv->arfs_expire_work);
+
+	if (ndev->rx_cpu_rmap) {
+		free_cpu_rmap(ndev->rx_cpu_rmap);
+		ndev->rx_cpu_rmap = NULL;
+	}
+#endif
+
 	kfree(priv->rx_queue_map_indir_table);
+	kfree(priv->txq_table);
+	kfree(priv->rxq_table);
+	bitmap_free(priv->xsk_zc_qps);
+	bitmap_free(priv->txq_launch_time);
+	bitmap_free(priv->txq_timed_out);
 
 	#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0)
 		devlink_port_type_clear(priv->dl_port);
@@ -82,6 +82,8 @@ struct mqnic_port *mqnic_create_port(struct mqnic_if *interface, int index,
 
 	mqnic_port_set_tx_ctrl(port, 0);
 	mqnic_port_set_rx_ctrl(port, 0);
+	if (port->port_features & MQNIC_PORT_FEATURE_LINK_EVENT)
+		mqnic_port_set_event_ctrl(port, 0);
 	mqnic_port_set_lfc_ctrl(port, interface->max_rx_mtu * 2);
 
 	for (k = 0; k < 8; k++)
@@ -166,3 +168,9 @@ void mqnic_port_set_pfc_ctrl(struct mqnic_port *port, int index, u32 val)
 	iowrite32(val, port->port_ctrl_rb->regs + MQNIC_RB_PORT_CTRL_REG_PFC_CTRL0 + index*4);
 }
 EXPORT_SYMBOL(mqnic_port_set_pfc_ctrl);
+
+void mqnic_port_set_event_ctrl(struct mqnic_port *port, u32 val)
+{
+	iowrite32(val, port->port_ctrl_rb->regs + MQNIC_RB_PORT_CTRL_REG_EVENT_CTRL);
+}
+EXPORT_SYMBOL(mqnic_port_set_event_ctrl);
@@ -5,27 +5,89 @@
 
 #include "mqnic.h"
 #include <linux/version.h>
+#include <linux/timekeeping.h>
+#if defined(CONFIG_X86_TSC)
+#include <asm/tsc.h>
+#endif
 
-ktime_t mqnic_read_cpl_ts(struct mqnic_dev *mdev, struct mqnic_ring *ring,
-		const struct mqnic_cpl *cpl)
+// completions carry the low 16 bits of seconds; extend them from the
+// cached ToD, which lags the hardware by at most the refresh interval
+ktime_t mqnic_read_cpl_ts(struct mqnic_dev *mdev, const struct mqnic_cpl *cpl)
 {
 	u64 ts_s = le16_to_cpu(cpl->ts_s);
 	u32 ts_ns = le32_to_cpu(cpl->ts_ns);
+	unsigned int seq;
+	u64 tod_s;
 
-	if (unlikely(!ring->ts_valid || (ring->ts_s ^ ts_s) & 0xff00)) {
-		// seconds MSBs do not match, update cached timestamp
-		if (mdev->phc_rb) {
-			ring->ts_s = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_CUR_TOD_SEC_L);
-			ring->ts_s |= (u64) ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_CUR_TOD_SEC_H) << 32;
-			ring->ts_valid = 1;
-		}
-	}
+	do {
+		seq = read_seqbegin(&mdev->tod_lock);
+		tod_s = mdev->tod_s;
+	} while (read_seqretry(&mdev->tod_lock, seq));
 
-	ts_s |= ring->ts_s & 0xffffffffffffff00;
+	ts_s |= tod_s & ~0xffffULL;
+
+	// pick the 16-bit wrap closest to the cached value
+	if (ts_s > tod_s + 0x8000 && ts_s >= 0x10000)
+		ts_s -= 0x10000;
+	else if (ts_s + 0x8000 < tod_s)
+		ts_s += 0x10000;
 
 	return ktime_set(ts_s, ts_ns);
 }
 
+// PHC time and the CLOCK_MONOTONIC time it was latched at, for app
+// drivers that schedule against the PHC with host timers; callable from
+// hard IRQ context
+int mqnic_phc_read_time(struct mqnic_dev *mdev, u64 *phc_ns, u64 *mono_ns)
+{
+	unsigned long flags;
+	u64 t1, t2, tod_s;
+	u32 tod_ns;
+
+	if (!mdev->phc_rb)
+		return -EOPNOTSUPP;
+
+	spin_lock_irqsave(&mdev->phc_snap_lock, flags);
+
+	t1 = ktime_get_ns();
+	ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_FNS);
+	t2 = ktime_get_ns();
+	tod_ns = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_NS);
+	tod_s = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_SEC_L);
+	tod_s |= (u64) ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_SEC_H) << 32;
+
+	spin_unlock_irqrestore(&mdev->phc_snap_lock, flags);
+
+	*phc_ns = tod_s * NSEC_PER_SEC + tod_ns;
+	*mono_ns = t1 + (t2 - t1) / 2;
+
+	return 0;
+}
+EXPORT_SYMBOL(mqnic_phc_read_time);
+
+static void mqnic_phc_update_tod(struct mqnic_dev *mdev)
+{
+	u64 tod_s;
+
+	tod_s = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_CUR_TOD_SEC_L);
+	tod_s |= (u64) ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_CUR_TOD_SEC_H) << 32;
+
+	write_seqlock_bh(&mdev->tod_lock);
+	mdev->tod_s = tod_s;
+	write_sequnlock_bh(&mdev->tod_lock);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+static long mqnic_phc_aux_work(struct ptp_clock_info *ptp)
+{
+	struct mqnic_dev *mdev = container_of(ptp, struct mqnic_dev, ptp_clock_info);
+
+	mqnic_phc_update_tod(mdev);
+
+	return msecs_to_jiffies(MQNIC_PHC_TOD_REFRESH_MS);
+}
+#endif
+
 static int mqnic_phc_adjfine(struct ptp_clock_info *ptp, long scaled_ppm)
 {
 	struct mqnic_dev *mdev = container_of(ptp, struct mqnic_dev, ptp_clock_info);
@@ -64,12 +126,17 @@ static int mqnic_phc_adjfine(struct ptp_clock_info *ptp, long scaled_ppm)
 static int mqnic_phc_gettime(struct ptp_clock_info *ptp, struct timespec64 *ts)
 {
 	struct mqnic_dev *mdev = container_of(ptp, struct mqnic_dev, ptp_clock_info);
+	unsigned long flags;
+
+	spin_lock_irqsave(&mdev->phc_snap_lock, flags);
 
 	ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_FNS);
 	ts->tv_nsec = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_NS);
 	ts->tv_sec = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_SEC_L);
 	ts->tv_sec |= (u64) ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_SEC_H) << 32;
 
+	spin_unlock_irqrestore(&mdev->phc_snap_lock, flags);
+
 	return 0;
 }
 
@@ -78,6 +145,9 @@ static int mqnic_phc_gettimex(struct ptp_clock_info *ptp, struct timespec64 *ts,
 		struct ptp_system_timestamp *sts)
 {
 	struct mqnic_dev *mdev = container_of(ptp, struct mqnic_dev, ptp_clock_info);
+	unsigned long flags;
+
+	spin_lock_irqsave(&mdev->phc_snap_lock, flags);
 
 	ptp_read_system_prets(sts);
 	ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_FNS);
@@ -86,8 +156,61 @@ static int mqnic_phc_gettimex(struct ptp_clock_info *ptp, struct timespec64 *ts,
 	ts->tv_sec = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_SEC_L);
 	ts->tv_sec |= (u64) ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_SEC_H) << 32;
 
+	spin_unlock_irqrestore(&mdev->phc_snap_lock, flags);
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_X86_TSC) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int mqnic_phc_get_syncdevicetime(ktime_t *device,
+		struct system_counterval_t *system, void *ctx)
+{
+	struct mqnic_dev *mdev = ctx;
+	unsigned long flags;
+	u64 ptm_ns;
+	u64 tod_s;
+	u32 tod_ns;
+
+	spin_lock_irqsave(&mdev->phc_snap_lock, flags);
+
+	// one snapshot latches ToD together with the PTM master time
+	ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_FNS);
+	tod_ns = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_NS);
+	tod_s = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_SEC_L);
+	tod_s |= (u64) ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_TOD_SEC_H) << 32;
+	ptm_ns = ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_PTM_NS_L);
+	ptm_ns |= (u64) ioread32(mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SNAP_PTM_NS_H) << 32;
+
+	spin_unlock_irqrestore(&mdev->phc_snap_lock, flags);
+
+	if (!ptm_ns)
+		return -EBUSY;
+
+	*device = ktime_set(tod_s, tod_ns);
+
+	// PTM master time is the root complex ART, in ns
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
+	*system = (struct system_counterval_t) {
+		.cycles = ptm_ns,
+		.cs_id = CSID_X86_ART,
+		.use_nsecs = true,
+	};
+#else
+	*system = convert_art_ns_to_tsc(ptm_ns);
+#endif
+
 	return 0;
 }
+
+static int mqnic_phc_getcrosststamp(struct ptp_clock_info *ptp,
+		struct system_device_crosststamp *cts)
+{
+	struct mqnic_dev *mdev = container_of(ptp, struct mqnic_dev, ptp_clock_info);
+
+	return get_device_system_crosststamp(mqnic_phc_get_syncdevicetime,
+			mdev, NULL, cts);
+}
 #endif
 
 static int mqnic_phc_settime(struct ptp_clock_info *ptp, const struct timespec64 *ts)
@@ -98,6 +221,8 @@ static int mqnic_phc_settime(struct ptp_clock_info *ptp, const struct timespec64
 	iowrite32(ts->tv_sec & 0xffffffff, mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SET_TOD_SEC_L);
 	iowrite32(ts->tv_sec >> 32, mdev->phc_rb->regs + MQNIC_RB_PHC_REG_SET_TOD_SEC_H);
 
+	mqnic_phc_update_tod(mdev);
+
 	return 0;
 }
 
@@ -114,6 +239,7 @@ static int mqnic_phc_adjtime(struct ptp_clock_info *ptp, s64 delta)
 		mqnic_phc_settime(ptp, &ts);
 	} else {
 		iowrite32(delta & 0xffffffff, mdev->phc_rb->regs + MQNIC_RB_PHC_REG_OFFSET_TOD_NS);
+		mqnic_phc_update_tod(mdev);
 	}
 
 	return 0;
@@ -244,7 +370,17 @@ void mqnic_register_phc(struct mqnic_dev *mdev)
 	mdev->ptp_clock_info.gettimex64 = mqnic_phc_gettimex;
 #endif
 	mdev->ptp_clock_info.settime64 = mqnic_phc_settime;
+#if defined(CONFIG_X86_TSC) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	if (mdev->pdev && pcie_ptm_enabled(mdev->pdev) && boot_cpu_has(X86_FEATURE_ART))
+		mdev->ptp_clock_info.getcrosststamp = mqnic_phc_getcrosststamp;
+#endif
 	mdev->ptp_clock_info.enable = mqnic_phc_enable;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+	mdev->ptp_clock_info.do_aux_work = mqnic_phc_aux_work;
+#endif
+
+	mqnic_phc_update_tod(mdev);
+
 	mdev->ptp_clock = ptp_clock_register(&mdev->ptp_clock_info, mdev->dev);
 
 	if (IS_ERR(mdev->ptp_clock)) {
@@ -256,6 +392,10 @@ void mqnic_register_phc(struct mqnic_dev *mdev)
 	dev_info(mdev->dev, "registered PHC (index %d)", ptp_clock_index(mdev->ptp_clock));
 
 	mqnic_phc_set_from_system_clock(&mdev->ptp_clock_info);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+	ptp_schedule_worker(mdev->ptp_clock, 0);
+#endif
 }
 
 void mqnic_unregister_phc(struct mqnic_dev *mdev)
@@ -21,7 +21,7 @@ struct mqnic_res *mqnic_create_res(unsigned int count, u8 __iomem *base, unsigne
     spin_lock_init(&res->lock);
 
     res->bmap = bitmap_zalloc(count, GFP_KERNEL);
-    if (!res) {
+    if (!res->bmap) {
         ret = -ENOMEM;
         goto fail;
     }
@@ -43,27 +43,58 @@ void mqnic_destroy_res(struct mqnic_res *res)
     kfree(res);
 }
 
-int mqnic_res_alloc(struct mqnic_res *res)
+/*
+ * First fit, starting from a hint below which every index is in use, so
+ * the lowest indices stay packed (TX push slots only cover the first few
+ * queues) while bringing up a queue set does not rescan what it just took.
+ */
+int mqnic_res_alloc_range(struct mqnic_res *res, unsigned int nr)
 {
-    int index;
+    unsigned long index;
+
+    if (!nr || nr > res->count)
+        return -EINVAL;
 
     spin_lock(&res->lock);
-    index = bitmap_find_free_region(res->bmap, res->count, 0);
+
+    index = bitmap_find_next_zero_area(res->bmap, res->count, res->hint, nr, 0);
+    if (index >= res->count) {
+        spin_unlock(&res->lock);
+        return -ENOMEM;
+    }
+
+    bitmap_set(res->bmap, index, nr);
+
+    if (index == res->hint)
+        res->hint = find_next_zero_bit(res->bmap, res->count, index + nr);
+
     spin_unlock(&res->lock);
 
     return index;
 }
 
-void mqnic_res_free(struct mqnic_res *res, int index)
+int mqnic_res_alloc(struct mqnic_res *res)
 {
-    if (index < 0 || index >= res->count)
+    return mqnic_res_alloc_range(res, 1);
+}
+
+void mqnic_res_free_range(struct mqnic_res *res, int index, unsigned int nr)
+{
+    if (index < 0 || index >= res->count || nr > res->count - index)
         return;
 
     spin_lock(&res->lock);
-    bitmap_clear(res->bmap, index, 1);
+    bitmap_clear(res->bmap, index, nr);
+    if (index < res->hint)
+        res->hint = index;
     spin_unlock(&res->lock);
 }
 
+void mqnic_res_free(struct mqnic_res *res, int index)
+{
+    mqnic_res_free_range(res, index, 1);
+}
+
 unsigned int mqnic_res_get_count(struct mqnic_res *res)
 {
     return res->count;
@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+/*
+ * RSS indirection table rebalancing.
+ *
+ * With the rss_rebalance_interval devlink param set, every interval each
+ * running port compares the load its RX channels took since the last pass,
+ * counted in packets plus one per MQNIC_RSS_LOAD_BYTES bytes.  When the
+ * busiest channel is clearly above the mean, one indirection entry pointing
+ * at it is moved to the least busy channel.  The hardware does not count
+ * per entry, so successive moves walk the table from where the last one
+ * left off until the load evens out.  A move that only swapped the hot and
+ * cold channels carried a single flow that no spread can split, and is not
+ * undone.
+ *
+ * A table set with ethtool -X is left alone, as is the shared table of a
+ * hardware LAG; ethtool -X <dev> default hands the table back.
+ */
+
+#define MQNIC_RSS_LOAD_BYTES 256
+// mean load per channel per second below which nothing is moved
+#define MQNIC_RSS_MIN_RATE 10000
+// busiest channel over the mean, in percent, before an entry is moved
+#define MQNIC_RSS_IMBALANCE_PCT 25
+
+static u64 mqnic_rss_ring_load(const struct mqnic_ring *ring)
+{
+	unsigned int start;
+	u64 packets, bytes;
+
+	do {
+		start = u64_stats_fetch_begin(&ring->syncp);
+		packets = u64_stats_read(&ring->packets);
+		bytes = u64_stats_read(&ring->bytes);
+	} while (u64_stats_fetch_retry(&ring->syncp, start));
+
+	return packets + div_u64(bytes, MQNIC_RSS_LOAD_BYTES);
+}
+
+// caller holds mdev->state_lock
+static void mqnic_rss_snapshot(struct mqnic_priv *priv)
+{
+	int k;
+
+	for (k = 0; k < priv->rxq_count; k++)
+		if (priv->rxq_table[k])
+			priv->rxq_table[k]->rss_load = mqnic_rss_ring_load(priv->rxq_table[k]);
+
+	priv->rss_last_from = -1;
+	priv->rss_last_to = -1;
+}
+
+// caller holds RTNL and mdev->state_lock
+static void mqnic_rss_rebalance(struct mqnic_priv *priv, u32 interval)
+{
+	u32 size = priv->rx_queue_map_indir_table_size;
+	u32 *table = priv->rx_queue_map_indir_table;
+	u64 hot_load = 0, cold_load = 0;
+	int hot = -1, cold = -1;
+	struct mqnic_ring *q;
+	u64 total = 0;
+	u32 entries = 0;
+	u64 load, prev, mean;
+	u32 k, idx;
+
+	if (priv->rxq_count < 2 || netif_is_rxfh_configured(priv->ndev) ||
+			priv->interface->lag_offload)
+		return;
+
+	for (k = 0; k < priv->rxq_count; k++) {
+		q = priv->rxq_table[k];
+		if (!q)
+			return;
+
+		load = mqnic_rss_ring_load(q);
+		prev = q->rss_load;
+		q->rss_load = load;
+		load -= prev;
+		total += load;
+
+		if (hot < 0 || load > hot_load) {
+			hot = k;
+			hot_load = load;
+		}
+
+		if (cold < 0 || load < cold_load) {
+			cold = k;
+			cold_load = load;
+		}
+	}
+
+	mean = div_u64(total, priv->rxq_count);
+
+	// too little traffic to tell channels apart
+	if (mean * MSEC_PER_SEC < (u64)MQNIC_RSS_MIN_RATE * interval)
+		return;
+
+	if (hot_load * 100 < mean * (100 + MQNIC_RSS_IMBALANCE_PCT))
+		return;
+
+	// the last move took the imbalance along with it
+	if (hot == priv->rss_last_to && cold == priv->rss_last_from)
+		return;
+
+	// the busiest channel keeps at least one entry
+	for (k = 0; k < size; k++)
+		if (table[k] == hot)
+			entries++;
+
+	if (entries < 2)
+		return;
+
+	for (k = 0; k < size; k++) {
+		idx = (priv->rss_cursor + k) & (size - 1);
+		if (table[idx] == hot)
+			break;
+	}
+
+	table[idx] = cold;
+	priv->rss_cursor = idx + 1;
+	priv->rss_last_from = hot;
+	priv->rss_last_to = cold;
+
+	mqnic_interface_set_rx_queue_map_indir_table(priv->interface, priv->port->index,
+			idx, priv->rxq_table[cold]->index);
+
+	netdev_dbg(priv->ndev, "RSS entry %u moved from RX channel %d to %d", idx, hot, cold);
+}
+
+static void mqnic_rss_work(struct work_struct *work)
+{
+	struct mqnic_priv *priv = container_of(to_delayed_work(work), struct mqnic_priv, rss_work);
+	struct mqnic_dev *mdev = priv->mdev;
+	u32 interval;
+
+	// ethtool -X writes the table under RTNL, which a port stop holds
+	// while it waits for this work
+	if (!rtnl_trylock()) {
+		interval = READ_ONCE(mdev->rss_rebalance_interval);
+		if (interval)
+			schedule_delayed_work(&priv->rss_work, msecs_to_jiffies(interval));
+		return;
+	}
+
+	mutex_lock(&mdev->state_lock);
+
+	interval = mdev->rss_rebalance_interval;
+
+	if (interval && priv->port_up) {
+		mqnic_rss_rebalance(priv, interval);
+		schedule_delayed_work(&priv->rss_work, msecs_to_jiffies(interval));
+	}
+
+	mutex_unlock(&mdev->state_lock);
+	rtnl_unlock();
+}
+
+void mqnic_rss_init(struct mqnic_priv *priv)
+{
+	INIT_DELAYED_WORK(&priv->rss_work, mqnic_rss_work);
+
+	priv->rss_cursor = 0;
+	priv->rss_last_from = -1;
+	priv->rss_last_to = -1;
+}
+
+// caller holds mdev->state_lock
+void mqnic_rss_start(struct mqnic_priv *priv)
+{
+	u32 interval = priv->mdev->rss_rebalance_interval;
+
+	if (!interval || !priv->port_up)
+		return;
+
+	mqnic_rss_snapshot(priv);
+	mod_delayed_work(system_wq, &priv->rss_work, msecs_to_jiffies(interval));
+}
+
+void mqnic_rss_stop(struct mqnic_priv *priv)
+{
+	cancel_delayed_work_sync(&priv->rss_work);
+}
+
+// caller holds mdev->state_lock
+void mqnic_rss_set_interval(struct mqnic_dev *mdev)
+{
+	struct mqnic_priv *priv;
+	int k;
+
+	for (k = 0; k < mdev->if_count; k++) {
+		if (!mdev->interface[k])
+			continue;
+
+		list_for_each_entry(priv, &mdev->interface[k]->ndev_list, ndev_list) {
+			if (mdev->rss_rebalance_interval)
+				mqnic_rss_start(priv);
+			else
+				cancel_delayed_work(&priv->rss_work);
+		}
+	}
+}
@@ -3,7 +3,218 @@
  * Copyright (c) 2019-2023 The Regents of the University of California
  */
 
+#include <linux/version.h>
 #include "mqnic.h"
+#include "mqnic_trace.h"
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+#include <net/xdp_sock_drv.h>
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+#include <net/page_pool/helpers.h>
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+#include <net/page_pool.h>
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int mqnic_create_rx_page_pool(struct mqnic_ring *ring)
+{
+	struct page_pool_params pp_params = {0};
+
+	// pool keeps pages mapped and syncs recycled pages for the device
+	pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 7, 0)
+	if (ring->frag_size)
+		pp_params.flags |= PP_FLAG_PAGE_FRAG;
+#endif
+	pp_params.order = ring->page_order;
+	pp_params.pool_size = ring->size * ring->rx_buf_count;
+	pp_params.nid = ring->node;
+	pp_params.dev = ring->dev;
+	pp_params.dma_dir = DMA_FROM_DEVICE;
+	pp_params.offset = ring->headroom;
+	pp_params.max_len = (PAGE_SIZE << ring->page_order) - ring->headroom;
+#ifdef MQNIC_NETMEM
+	// payload buffers of a split ring are never read by the driver, so a
+	// memory provider bound to the queue (dma-buf, io_uring) may supply them
+	if (ring->hdr_split && ring->ndev == ring->priv->ndev) {
+		pp_params.flags |= PP_FLAG_ALLOW_UNREADABLE_NETMEM;
+		pp_params.netdev = ring->ndev;
+		pp_params.queue_idx = ring->queue_index;
+	}
+#endif
+
+	ring->page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(ring->page_pool)) {
+		int ret = PTR_ERR(ring->page_pool);
+
+		ring->page_pool = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+#endif
+
+#ifdef MQNIC_NETMEM
+// header buffers, several per host page
+static int mqnic_create_rx_hdr_page_pool(struct mqnic_ring *ring)
+{
+	struct page_pool_params pp_params = {0};
+
+	pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+	pp_params.order = 0;
+	pp_params.pool_size = ring->size;
+	pp_params.nid = ring->node;
+	pp_params.dev = ring->dev;
+	pp_params.dma_dir = DMA_FROM_DEVICE;
+	pp_params.max_len = PAGE_SIZE;
+
+	ring->hdr_page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(ring->hdr_page_pool)) {
+		int ret = PTR_ERR(ring->hdr_page_pool);
+
+		ring->hdr_page_pool = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+
+static int mqnic_rx_hdr_alloc(struct mqnic_ring *ring, struct mqnic_rx_info *rx_info)
+{
+	unsigned int offset = 0;
+	struct page *page;
+
+	page = page_pool_dev_alloc_frag(ring->hdr_page_pool, &offset, MQNIC_RX_HDR_BUF_SIZE);
+	if (unlikely(!page))
+		return -ENOMEM;
+
+	rx_info->page = page;
+	rx_info->page_order = 0;
+	rx_info->page_offset = offset;
+	rx_info->dma_addr = page_pool_get_dma_addr(page);
+	rx_info->len = MQNIC_RX_HDR_BUF_SIZE;
+
+	return 0;
+}
+
+static int mqnic_rx_netmem_alloc(struct mqnic_ring *ring, struct mqnic_rx_info *rx_info)
+{
+	netmem_ref netmem;
+
+	netmem = page_pool_alloc_netmems(ring->page_pool, GFP_ATOMIC | __GFP_NOWARN);
+	if (unlikely(!netmem))
+		return -ENOMEM;
+
+	rx_info->netmem = netmem;
+	rx_info->page_order = 0;
+	rx_info->page_offset = 0;
+	rx_info->dma_addr = page_pool_get_dma_addr_netmem(netmem);
+	rx_info->len = PAGE_SIZE;
+
+	return 0;
+}
+
+static void mqnic_rx_netmem_put(struct mqnic_ring *ring, struct mqnic_rx_info *rx_info,
+		bool allow_direct)
+{
+	page_pool_put_full_netmem(ring->page_pool, rx_info->netmem, allow_direct);
+	rx_info->dma_addr = 0;
+	rx_info->netmem = 0;
+}
+
+static void mqnic_rx_netmem_sync_for_cpu(struct mqnic_ring *ring, struct mqnic_rx_info *rx_info,
+		u32 len)
+{
+	// device memory has no CPU view to sync
+	if (!netmem_is_net_iov(rx_info->netmem))
+		dma_sync_single_range_for_cpu(ring->dev, rx_info->dma_addr, rx_info->page_offset,
+				len, DMA_FROM_DEVICE);
+}
+#endif
+
+static int mqnic_rx_page_alloc(struct mqnic_ring *ring, struct mqnic_rx_info *rx_info)
+{
+	u32 len = ring->frag_size ? ring->frag_size : PAGE_SIZE << ring->page_order;
+	unsigned int offset = 0;
+	struct page *page;
+	dma_addr_t dma_addr;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	if (ring->frag_size)
+		page = page_pool_dev_alloc_frag(ring->page_pool, &offset, ring->frag_size);
+	else
+		page = page_pool_dev_alloc_pages(ring->page_pool);
+
+	if (unlikely(!page))
+		return -ENOMEM;
+
+	dma_addr = page_pool_get_dma_addr(page);
+#else
+	page = dev_alloc_pages(ring->page_order);
+	if (unlikely(!page))
+		return -ENOMEM;
+
+	// map page
+	dma_addr = dma_map_page(ring->dev, page, 0, len, DMA_FROM_DEVICE);
+
+	if (unlikely(dma_mapping_error(ring->dev, dma_addr))) {
+		__free_pages(page, ring->page_order);
+		return -EIO;
+	}
+#endif
+
+	rx_info->page = page;
+	rx_info->page_order = ring->page_order;
+	rx_info->page_offset = offset + ring->headroom;
+	rx_info->dma_addr = dma_addr;
+	rx_info->len = len - ring->headroom - ring->tailroom;
+
+	return 0;
+}
+
+static void mqnic_rx_page_put(struct mqnic_ring *ring, struct mqnic_rx_info *rx_info,
+		bool allow_direct)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	// the first buffer of a split ring is a header buffer; the payload
+	// buffers behind it go back through mqnic_rx_netmem_put()
+	page_pool_put_full_page(ring->hdr_split ? ring->hdr_page_pool : ring->page_pool,
+			rx_info->page, allow_direct);
+#else
+	if (rx_info->dma_addr)
+		dma_unmap_page(ring->dev, rx_info->dma_addr,
+				PAGE_SIZE << rx_info->page_order, DMA_FROM_DEVICE);
+	__free_pages(rx_info->page, rx_info->page_order);
+#endif
+	rx_info->dma_addr = 0;
+	rx_info->page = NULL;
+}
+
+static void mqnic_rx_page_sync_for_cpu(struct mqnic_ring *ring, struct mqnic_rx_info *rx_info,
+		u32 len)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	dma_sync_single_range_for_cpu(ring->dev, rx_info->dma_addr, rx_info->page_offset,
+			len, DMA_FROM_DEVICE);
+#else
+	// no pool to hand the mapping back to
+	dma_unmap_page(ring->dev, rx_info->dma_addr,
+			PAGE_SIZE << rx_info->page_order, DMA_FROM_DEVICE);
+	rx_info->dma_addr = 0;
+#endif
+}
+
+static void mqnic_rx_skb_mark_for_recycle(struct mqnic_ring *ring, struct sk_buff *skb,
+		struct page *page)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+	skb_mark_for_recycle(skb);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	skb_mark_for_recycle(skb, page, ring->page_pool);
+#endif
+}
 
 struct mqnic_ring *mqnic_create_rx_ring(struct mqnic_if *interface)
 {
@@ -24,6 +235,9 @@ struct mqnic_ring *mqnic_create_rx_ring(struct mqnic_if *interface)
 	ring->prod_ptr = 0;
 	ring->cons_ptr = 0;
 
+	u64_stats_init(&ring->syncp);
+	u64_stats_init(&ring->cpl_syncp);
+
 	return ring;
 }
 
@@ -42,26 +256,35 @@ int mqnic_open_rx_ring(struct mqnic_ring *ring, struct mqnic_priv *priv,
 	if (ring->enabled || ring->hw_addr || ring->buf || !priv || !cq)
 		return -EINVAL;
 
-	ring->index = mqnic_res_alloc(ring->interface->rxq_res);
+	// the caller may have reserved an index as part of a range
+	if (ring->index < 0)
+		ring->index = mqnic_res_alloc(ring->interface->rxq_res);
 	if (ring->index < 0)
 		return -ENOMEM;
 
 	ring->log_desc_block_size = desc_block_size < 2 ? 0 : ilog2(desc_block_size - 1) + 1;
 	ring->desc_block_size = 1 << ring->log_desc_block_size;
+	// buffers posted per block, any remaining descriptors are left empty
+	ring->rx_buf_count = max(desc_block_size, 1);
+	ring->refill_batch = priv->mdev->rx_refill_batch;
 
 	ring->size = roundup_pow_of_two(size);
 	ring->full_size = ring->size >> 1;
 	ring->size_mask = ring->size - 1;
 	ring->stride = roundup_pow_of_two(MQNIC_DESC_SIZE * ring->desc_block_size);
 
-	ring->rx_info = kvzalloc(sizeof(*ring->rx_info) * ring->size, GFP_KERNEL);
+	ring->node = cq->node;
+
+	ring->rx_info = kvzalloc_node(sizeof(*ring->rx_info) * (ring->size << ring->log_desc_block_size),
+			GFP_KERNEL, ring->node);
 	if (!ring->rx_info) {
 		ret = -ENOMEM;
 		goto fail;
 	}
 
 	ring->buf_size = ring->size * ring->stride;
-	ring->buf = dma_alloc_coherent(ring->dev, ring->buf_size, &ring->buf_dma_addr, GFP_KERNEL);
+	ring->buf = mqnic_dma_arena_alloc(&ring->interface->dma_arena, ring->buf_size,
+			&ring->buf_dma_addr, ring->node);
 	if (!ring->buf) {
 		ret = -ENOMEM;
 		goto fail;
@@ -77,6 +300,43 @@ int mqnic_open_rx_ring(struct mqnic_ring *ring, struct mqnic_priv *priv,
 	ring->prod_ptr = 0;
 	ring->cons_ptr = 0;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	if (!ring->xsk_pool) {
+		ret = mqnic_create_rx_page_pool(ring);
+		if (ret)
+			goto fail;
+	}
+#endif
+#ifdef MQNIC_NETMEM
+	if (ring->hdr_split) {
+		ret = mqnic_create_rx_hdr_page_pool(ring);
+		if (ret)
+			goto fail;
+	}
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	ret = xdp_rxq_info_reg(&ring->xdp_rxq, priv->ndev, ring->queue_index, cq->napi.napi_id);
+	if (ret)
+		goto fail;
+
+	if (ring->xsk_pool) {
+		ret = xdp_rxq_info_reg_mem_model(&ring->xdp_rxq, MEM_TYPE_XSK_BUFF_POOL, NULL);
+		if (ret)
+			goto fail;
+
+		xsk_pool_set_rxq_info(ring->xsk_pool, &ring->xdp_rxq);
+	} else {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+		ret = xdp_rxq_info_reg_mem_model(&ring->xdp_rxq, MEM_TYPE_PAGE_POOL, ring->page_pool);
+#else
+		ret = xdp_rxq_info_reg_mem_model(&ring->xdp_rxq, MEM_TYPE_PAGE_SHARED, NULL);
+#endif
+		if (ret)
+			goto fail;
+	}
+#endif
+
 	// deactivate queue
 	iowrite32(MQNIC_QUEUE_CMD_SET_ENABLE | 0,
 			ring->hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
@@ -97,8 +357,14 @@ int mqnic_open_rx_ring(struct mqnic_ring *ring, struct mqnic_priv *priv,
 	iowrite32(MQNIC_QUEUE_CMD_SET_CONS_PTR | (ring->cons_ptr & MQNIC_QUEUE_PTR_MASK),
 			ring->hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
 
+	ring->ptr_shadow = mqnic_interface_attach_ptr_shadow(ring->interface,
+			ring->interface->rxq_res, ring->index, ring->hw_addr + MQNIC_QUEUE_SHADOW_ADDR_REG);
+
 	ret = mqnic_refill_rx_buffers(ring);
-	if (ret) {
+	if (ret && ring->xsk_pool) {
+		// XSK fill ring may not be populated yet
+		ret = 0;
+	} else if (ret) {
 		netdev_err(priv->ndev, "failed to allocate RX buffer for RX queue index %d (of %u total) entry index %u (of %u total)",
 				ring->index, priv->rxq_count, ring->prod_ptr, ring->size);
 		if (ret == -ENOMEM)
@@ -127,12 +393,19 @@ void mqnic_close_rx_ring(struct mqnic_ring *ring)
 	ring->priv = NULL;
 	ring->cq = NULL;
 
+	if (ring->hw_addr) {
+		mqnic_interface_detach_ptr_shadow(ring->ptr_shadow,
+				ring->hw_addr + MQNIC_QUEUE_SHADOW_ADDR_REG);
+		ring->ptr_shadow = NULL;
+	}
+
 	ring->hw_addr = NULL;
 
 	if (ring->buf) {
 		mqnic_free_rx_buf(ring);
 
-		dma_free_coherent(ring->dev, ring->buf_size, ring->buf, ring->buf_dma_addr);
+		mqnic_dma_arena_free(&ring->interface->dma_arena, ring->buf_size,
+				ring->buf, ring->buf_dma_addr);
 		ring->buf = NULL;
 		ring->buf_dma_addr = 0;
 	}
@@ -142,6 +415,25 @@ void mqnic_close_rx_ring(struct mqnic_ring *ring)
 		ring->rx_info = NULL;
 	}
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	if (xdp_rxq_info_is_reg(&ring->xdp_rxq))
+		xdp_rxq_info_unreg(&ring->xdp_rxq);
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	if (ring->page_pool) {
+		page_pool_destroy(ring->page_pool);
+		ring->page_pool = NULL;
+	}
+
+	if (ring->hdr_page_pool) {
+		page_pool_destroy(ring->hdr_page_pool);
+		ring->hdr_page_pool = NULL;
+	}
+#endif
+
+	ring->xsk_pool = NULL;
+
 	mqnic_res_free(ring->interface->rxq_res, ring->index);
 	ring->index = -1;
 }
@@ -183,7 +475,7 @@ bool mqnic_is_rx_ring_full(const struct mqnic_ring *ring)
 
 void mqnic_rx_read_cons_ptr(struct mqnic_ring *ring)
 {
-	ring->cons_ptr += ((ioread32(ring->hw_addr + MQNIC_QUEUE_PTR_REG) >> 16) - ring->cons_ptr) & MQNIC_QUEUE_PTR_MASK;
+	ring->cons_ptr += ((mqnic_read_hw_ptr(ring->ptr_shadow, ring->hw_addr + MQNIC_QUEUE_PTR_REG) >> 16) - ring->cons_ptr) & MQNIC_QUEUE_PTR_MASK;
 }
 
 void mqnic_rx_write_prod_ptr(struct mqnic_ring *ring)
@@ -194,17 +486,27 @@ void mqnic_rx_write_prod_ptr(struct mqnic_ring *ring)
 
 void mqnic_free_rx_desc(struct mqnic_ring *ring, int index)
 {
-	struct mqnic_rx_info *rx_info = &ring->rx_info[index];
-	// struct page *page = rx_info->page;
+	struct mqnic_rx_info *rx_info = &ring->rx_info[index << ring->log_desc_block_size];
+	u32 i;
 
-	if (!rx_info->page)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	if (ring->xsk_pool) {
+		mqnic_free_rx_desc_zc(ring, index);
 		return;
-
-	dma_unmap_page(ring->dev, dma_unmap_addr(rx_info, dma_addr),
-			dma_unmap_len(rx_info, len), DMA_FROM_DEVICE);
-	rx_info->dma_addr = 0;
-	__free_pages(rx_info->page, rx_info->page_order);
-	rx_info->page = NULL;
+	}
+#endif
+
+	for (i = 0; i < ring->rx_buf_count; i++) {
+		if (!rx_info[i].page)
+			continue;
+
+#ifdef MQNIC_NETMEM
+		if (ring->hdr_split && i)
+			mqnic_rx_netmem_put(ring, &rx_info[i], false);
+		else
+#endif
+			mqnic_rx_page_put(ring, &rx_info[i], false);
+	}
 }
 
 int mqnic_free_rx_buf(struct mqnic_ring *ring)
@@ -224,46 +526,53 @@ int mqnic_free_rx_buf(struct mqnic_ring *ring)
 
 int mqnic_prepare_rx_desc(struct mqnic_ring *ring, int index)
 {
-	struct mqnic_rx_info *rx_info = &ring->rx_info[index];
+	struct mqnic_rx_info *rx_info = &ring->rx_info[index << ring->log_desc_block_size];
 	struct mqnic_desc *rx_desc = (struct mqnic_desc *)(ring->buf + index * ring->stride);
-	struct page *page = rx_info->page;
-	u32 page_order = ring->page_order;
-	u32 len = PAGE_SIZE << page_order;
-	dma_addr_t dma_addr;
+	int ret;
+	u32 i;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	if (ring->xsk_pool)
+		return mqnic_prepare_rx_desc_zc(ring, index);
+#endif
 
-	if (unlikely(page)) {
-		dev_err(ring->dev, "%s: skb not yet processed on interface %d",
+	if (unlikely(rx_info->page)) {
+		dev_err_ratelimited(ring->dev, "%s: skb not yet processed on interface %d",
 				__func__, ring->interface->index);
 		return -1;
 	}
 
-	page = dev_alloc_pages(page_order);
-	if (unlikely(!page)) {
-		dev_err(ring->dev, "%s: failed to allocate memory on interface %d",
-				__func__, ring->interface->index);
-		return -ENOMEM;
+	// buffers left unused by a shorter frame are posted again as-is
+	for (i = 0; i < ring->rx_buf_count; i++) {
+		if (rx_info[i].page)
+			continue;
+
+		// counted by the caller; the refill is retried from the next poll
+#ifdef MQNIC_NETMEM
+		if (ring->hdr_split)
+			ret = i ? mqnic_rx_netmem_alloc(ring, &rx_info[i]) :
+				mqnic_rx_hdr_alloc(ring, &rx_info[i]);
+		else
+#endif
+			ret = mqnic_rx_page_alloc(ring, &rx_info[i]);
+		if (unlikely(ret)) {
+			mqnic_free_rx_desc(ring, index);
+			return ret;
+		}
 	}
 
-	// map page
-	dma_addr = dma_map_page(ring->dev, page, 0, len, DMA_FROM_DEVICE);
-
-	if (unlikely(dma_mapping_error(ring->dev, dma_addr))) {
-		dev_err(ring->dev, "%s: DMA mapping failed on interface %d",
-				__func__, ring->interface->index);
-		__free_pages(page, page_order);
-		return -1;
+	// write descriptors
+	for (i = 0; i < ring->rx_buf_count; i++) {
+		rx_desc[i].len = cpu_to_le32(rx_info[i].len);
+		rx_desc[i].addr = cpu_to_le64(rx_info[i].dma_addr + rx_info[i].page_offset);
 	}
 
-	// write descriptor
-	rx_desc->len = cpu_to_le32(len);
-	rx_desc->addr = cpu_to_le64(dma_addr);
+	for (; i < ring->desc_block_size; i++) {
+		rx_desc[i].len = 0;
+		rx_desc[i].addr = 0;
+	}
 
-	// update rx_info
-	rx_info->page = page;
-	rx_info->page_order = page_order;
-	rx_info->page_offset = 0;
-	rx_info->dma_addr = dma_addr;
-	rx_info->len = len;
+	rx_desc[0].rx.split_cmd = ring->hdr_split ? cpu_to_le16(MQNIC_RX_SPLIT_CMD_ENABLE) : 0;
 
 	return 0;
 }
@@ -271,18 +580,33 @@ int mqnic_prepare_rx_desc(struct mqnic_ring *ring, int index)
 int mqnic_refill_rx_buffers(struct mqnic_ring *ring)
 {
 	u32 missing = ring->size - (ring->prod_ptr - ring->cons_ptr);
+	u32 prod_ptr = ring->prod_ptr;
 	int ret = 0;
+	u32 k;
 
-	if (missing < 8)
+	// page pool allocations come from its per-CPU cache, which the pool
+	// refills with bulk page allocations; batching the refill here keeps
+	// that cache hot and amortizes the doorbell
+	if (missing < ring->refill_batch)
 		return 0;
 
-	for (; missing-- > 0;) {
+	for (k = 0; k < missing; k++) {
 		ret = mqnic_prepare_rx_desc(ring, ring->prod_ptr & ring->size_mask);
-		if (ret)
+		if (unlikely(ret)) {
+			u64_stats_update_begin(&ring->syncp);
+			u64_stats_inc(&ring->alloc_failed);
+			u64_stats_update_end(&ring->syncp);
 			break;
+		}
 		ring->prod_ptr++;
 	}
 
+	trace_mqnic_rx_refill(ring, missing, ring->prod_ptr - prod_ptr);
+
+	// nothing posted, skip the doorbell
+	if (ring->prod_ptr == prod_ptr)
+		return ret;
+
 	// enqueue on NIC
 	dma_wmb();
 	mqnic_rx_write_prod_ptr(ring);
@@ -290,32 +614,143 @@ int mqnic_refill_rx_buffers(struct mqnic_ring *ring)
 	return ret;
 }
 
+static void mqnic_rx_skb_set_meta(struct mqnic_ring *ring, struct mqnic_cpl *cpl,
+		struct sk_buff *skb)
+{
+	struct mqnic_if *interface = ring->interface;
+
+	// RX hardware timestamp
+	if (mqnic_rx_want_ts(ring->priv, cpl))
+		skb_hwtstamps(skb)->hwtstamp = mqnic_read_cpl_ts(interface->mdev, cpl);
+
+	skb_record_rx_queue(skb, ring->index);
+
+	// RX hardware checksum
+	if (ring->priv->ndev->features & NETIF_F_RXCSUM) {
+		skb->csum = csum_unfold((__sum16) cpu_to_be16(le16_to_cpu(cpl->rx_csum)));
+		skb->ip_summed = CHECKSUM_COMPLETE;
+	}
+
+	// RX hardware hash
+	mqnic_rx_hash(ring, cpl, skb);
+
+	// RX VLAN strip
+	mqnic_rx_vlan(ring, cpl, skb);
+}
+
+#ifdef MQNIC_NETMEM
+// headers are copied into the linear area and the header buffer recycled;
+// payload buffers are attached as frags without being touched, since they
+// may be device memory
+static struct sk_buff *mqnic_rx_split_skb(struct mqnic_ring *ring, struct napi_struct *napi,
+		const struct mqnic_cpl *cpl, struct mqnic_rx_info *rx_info)
+{
+	u32 len = le16_to_cpu(cpl->len);
+	u32 hdr_len = le16_to_cpu(cpl->rx_hdr_len);
+	struct sk_buff *skb;
+	u32 frag_len;
+	u32 i;
+
+	// frames the hardware did not split fill the header buffer first
+	if (hdr_len < ETH_HLEN || hdr_len > min(len, rx_info->len))
+		hdr_len = min_t(u32, len, rx_info->len);
+
+	len = min_t(u32, len, hdr_len + (ring->rx_buf_count - 1) * PAGE_SIZE);
+
+	mqnic_rx_page_sync_for_cpu(ring, rx_info, hdr_len);
+
+	skb = napi_alloc_skb(napi, hdr_len);
+	if (likely(skb))
+		skb_put_data(skb, page_address(rx_info->page) + rx_info->page_offset, hdr_len);
+
+	// payload buffers stay in place and are posted again on failure
+	mqnic_rx_page_put(ring, rx_info, true);
+
+	if (unlikely(!skb))
+		return NULL;
+
+	frag_len = hdr_len;
+
+	for (i = 1; frag_len < len; i++) {
+		struct mqnic_rx_info *frag_info = &rx_info[i];
+		u32 n = min_t(u32, len - frag_len, frag_info->len);
+
+		mqnic_rx_netmem_sync_for_cpu(ring, frag_info, n);
+		skb_add_rx_frag_netmem(skb, i - 1, frag_info->netmem, frag_info->page_offset,
+				n, frag_info->len);
+		frag_info->netmem = 0;
+
+		frag_len += n;
+	}
+
+	skb_mark_for_recycle(skb);
+
+	return skb;
+}
+#endif
+
 int mqnic_process_rx_cq(struct mqnic_cq *cq, int napi_budget)
 {
-	struct mqnic_if *interface = cq->interface;
-	struct device *dev = interface->dev;
 	struct mqnic_ring *rx_ring = cq->src_ring;
+	struct mqnic_ring *tx_ring = READ_ONCE(cq->tx_ring);
 	struct mqnic_priv *priv = rx_ring->priv;
 	struct mqnic_rx_info *rx_info;
+	struct mqnic_tx_cpl_ctx tx_ctx;
 	struct mqnic_cpl *cpl;
 	struct sk_buff *skb;
 	struct page *page;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	struct bpf_prog *xdp_prog;
+	struct xdp_buff xdp;
+	u32 xdp_flags = 0;
+	u32 xdp_res;
+#endif
 	u32 cq_index;
 	u32 cq_cons_ptr;
 	u32 ring_index;
 	u32 ring_cons_ptr;
+	bool shared_cq;
+	int tx_done = 0;
 	int done = 0;
 	int budget = napi_budget;
+	u32 page_offset;
+	u32 copybreak;
+	u32 frag_len;
 	u32 len;
+	u32 i;
+	bool lat;
+	s64 lat_now = 0;
 
 	if (unlikely(!priv || !priv->port_up))
 		return done;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	if (rx_ring->xsk_pool) {
+		done = mqnic_process_rx_cq_zc(cq, napi_budget);
+		trace_mqnic_rx_cq(cq, done, napi_budget);
+		return done;
+	}
+
+	xdp_prog = READ_ONCE(priv->xdp_prog);
+#endif
+
+	copybreak = READ_ONCE(priv->rx_copybreak);
+
+	// one host timestamp per poll: arrival to the start of NAPI processing
+	lat = mqnic_lat_enabled(priv);
+	if (lat)
+		lat_now = ktime_get_ns() + READ_ONCE(priv->lat_phc_offset);
+
+	// cpl->src is only defined by hardware that can share CQs
+	shared_cq = rx_ring->interface->if_features & MQNIC_IF_FEATURE_SHARED_CQ;
+	if (tx_ring)
+		mqnic_tx_cpl_begin(tx_ring, &tx_ctx);
+
 	// process completion queue
 	cq_cons_ptr = cq->cons_ptr;
 	cq_index = cq_cons_ptr & cq->size_mask;
 
-	while (done < budget) {
+	while (done < budget && tx_done < budget) {
 		cpl = (struct mqnic_cpl *)(cq->buf + cq_index * cq->stride);
 
 		if (!!(cpl->phase & cpu_to_le32(0x80000000)) == !!(cq_cons_ptr & cq->size))
@@ -323,15 +758,33 @@ int mqnic_process_rx_cq(struct mqnic_cq *cq, int napi_budget)
 
 		dma_rmb();
 
+		if (shared_cq && (cpl->src & MQNIC_CPL_SRC_TX)) {
+			// completions left over from a TX ring already torn down are skipped
+			if (tx_ring)
+				mqnic_tx_cpl(tx_ring, &tx_ctx, cpl, napi_budget);
+
+			tx_done++;
+			goto cpl_next;
+		}
+
+		if (unlikely(lat))
+			mqnic_lat_record(rx_ring, lat_now -
+					ktime_to_ns(mqnic_read_cpl_ts(priv->mdev, cpl)));
+
 		ring_index = le16_to_cpu(cpl->index) & rx_ring->size_mask;
-		rx_info = &rx_ring->rx_info[ring_index];
+		rx_info = &rx_ring->rx_info[ring_index << rx_ring->log_desc_block_size];
 		page = rx_info->page;
-		len = min_t(u32, le16_to_cpu(cpl->len), rx_info->len);
+		len = min_t(u32, le16_to_cpu(cpl->len), rx_info->len * rx_ring->rx_buf_count);
+		frag_len = min_t(u32, len, rx_info->len);
 
 		if (len < ETH_HLEN) {
 			netdev_warn(priv->ndev, "%s: ring %d dropping short frame (length %d)",
 					__func__, rx_ring->index, len);
-			rx_ring->dropped_packets++;
+			u64_stats_update_begin(&rx_ring->syncp);
+			u64_stats_inc(&rx_ring->dropped_packets);
+			u64_stats_update_end(&rx_ring->syncp);
+			if (page)
+				mqnic_rx_page_put(rx_ring, rx_info, true);
 			goto rx_drop;
 		}
 
@@ -343,99 +796,311 @@ int mqnic_process_rx_cq(struct mqnic_cq *cq, int napi_budget)
 			break;
 		}
 
+#ifdef MQNIC_NETMEM
+		if (rx_ring->hdr_split) {
+			skb = mqnic_rx_split_skb(rx_ring, &cq->napi, cpl, rx_info);
+			if (unlikely(!skb)) {
+				netdev_err(priv->ndev, "%s: ring %d failed to allocate skb",
+						__func__, rx_ring->index);
+				u64_stats_update_begin(&rx_ring->syncp);
+				u64_stats_inc(&rx_ring->dropped_packets);
+				u64_stats_update_end(&rx_ring->syncp);
+				goto rx_drop;
+			}
+
+			mqnic_rx_skb_set_meta(rx_ring, cpl, skb);
+
+			skb->protocol = eth_type_trans(skb, rx_ring->ndev);
+
+			// hand off SKB
+			napi_gro_receive(&cq->napi, skb);
+
+			u64_stats_update_begin(&rx_ring->syncp);
+			u64_stats_inc(&rx_ring->packets);
+			u64_stats_add(&rx_ring->bytes, le16_to_cpu(cpl->len));
+			u64_stats_update_end(&rx_ring->syncp);
+			goto rx_drop;
+		}
+#endif
+
+		mqnic_rx_page_sync_for_cpu(rx_ring, rx_info, frag_len);
+
+		page_offset = rx_info->page_offset;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+		if (xdp_prog) {
+			xdp_init_buff(&xdp, rx_ring->frag_size ? rx_ring->frag_size : PAGE_SIZE << rx_info->page_order,
+					&rx_ring->xdp_rxq);
+			xdp_prepare_buff(&xdp, page_address(page) + page_offset - rx_ring->headroom,
+					rx_ring->headroom, len, false);
+
+			xdp_res = mqnic_run_xdp(rx_ring, xdp_prog, &xdp);
+
+			if (xdp_res != MQNIC_XDP_PASS) {
+				// page is either queued for transmit or no longer needed
+				if (xdp_res == MQNIC_XDP_CONSUMED)
+					mqnic_rx_page_put(rx_ring, rx_info, true);
+				rx_info->page = NULL;
+
+				xdp_flags |= xdp_res;
+
+				u64_stats_update_begin(&rx_ring->syncp);
+				u64_stats_inc(&rx_ring->packets);
+				u64_stats_add(&rx_ring->bytes, le16_to_cpu(cpl->len));
+				u64_stats_update_end(&rx_ring->syncp);
+				goto rx_drop;
+			}
+
+			// program may have moved the packet boundaries
+			page_offset = xdp.data - page_address(page);
+			len = xdp.data_end - xdp.data;
+			frag_len = len;
+		}
+#endif
+
+		// copy small frames into a linear skb and recycle the page
+		if (len <= copybreak && frag_len == len) {
+			skb = napi_alloc_skb(&cq->napi, len);
+			if (likely(skb))
+				skb_put_data(skb, page_address(page) + page_offset, len);
+
+			mqnic_rx_page_put(rx_ring, rx_info, true);
+
+			if (unlikely(!skb)) {
+				netdev_err(priv->ndev, "%s: ring %d failed to allocate skb",
+						__func__, rx_ring->index);
+				u64_stats_update_begin(&rx_ring->syncp);
+				u64_stats_inc(&rx_ring->dropped_packets);
+				u64_stats_update_end(&rx_ring->syncp);
+				goto rx_drop;
+			}
+
+			mqnic_rx_skb_set_meta(rx_ring, cpl, skb);
+
+			skb->protocol = eth_type_trans(skb, rx_ring->ndev);
+
+			// hand off SKB
+			napi_gro_receive(&cq->napi, skb);
+
+			u64_stats_update_begin(&rx_ring->syncp);
+			u64_stats_inc(&rx_ring->packets);
+			u64_stats_add(&rx_ring->bytes, le16_to_cpu(cpl->len));
+			u64_stats_update_end(&rx_ring->syncp);
+			goto rx_drop;
+		}
+
 		skb = napi_get_frags(&cq->napi);
 		if (unlikely(!skb)) {
 			netdev_err(priv->ndev, "%s: ring %d failed to allocate skb",
 					__func__, rx_ring->index);
-			break;
+			mqnic_rx_page_put(rx_ring, rx_info, true);
+			u64_stats_update_begin(&rx_ring->syncp);
+			u64_stats_inc(&rx_ring->dropped_packets);
+			u64_stats_update_end(&rx_ring->syncp);
+			goto rx_drop;
 		}
 
-		// RX hardware timestamp
-		if (interface->if_features & MQNIC_IF_FEATURE_PTP_TS)
-			skb_hwtstamps(skb)->hwtstamp = mqnic_read_cpl_ts(interface->mdev, rx_ring, cpl);
+		mqnic_rx_skb_set_meta(rx_ring, cpl, skb);
 
-		skb_record_rx_queue(skb, rx_ring->index);
+		// napi_get_frags() hands out skbs on the port netdev
+		skb->dev = rx_ring->ndev;
 
-		// RX hardware checksum
-		if (priv->ndev->features & NETIF_F_RXCSUM) {
-			skb->csum = csum_unfold((__sum16) cpu_to_be16(le16_to_cpu(cpl->rx_csum)));
-			skb->ip_summed = CHECKSUM_COMPLETE;
-		}
+		__skb_fill_page_desc(skb, 0, page, page_offset, frag_len);
+		mqnic_rx_skb_mark_for_recycle(rx_ring, skb, page);
+		skb->truesize += rx_info->len;
+		rx_info->page = NULL;
 
-		// unmap
-		dma_unmap_page(dev, dma_unmap_addr(rx_info, dma_addr),
-				dma_unmap_len(rx_info, len), DMA_FROM_DEVICE);
-		rx_info->dma_addr = 0;
+		// remainder of a frame scattered across the descriptor block
+		for (i = 1; frag_len < len; i++) {
+			struct mqnic_rx_info *frag_info = &rx_info[i];
+			u32 n = min_t(u32, len - frag_len, frag_info->len);
 
-		dma_sync_single_range_for_cpu(dev, rx_info->dma_addr, rx_info->page_offset,
-				rx_info->len, DMA_FROM_DEVICE);
+			mqnic_rx_page_sync_for_cpu(rx_ring, frag_info, n);
+			__skb_fill_page_desc(skb, i, frag_info->page, frag_info->page_offset, n);
+			mqnic_rx_skb_mark_for_recycle(rx_ring, skb, frag_info->page);
+			skb->truesize += frag_info->len;
+			frag_info->page = NULL;
 
-		__skb_fill_page_desc(skb, 0, page, rx_info->page_offset, len);
-		rx_info->page = NULL;
+			frag_len += n;
+		}
 
-		skb_shinfo(skb)->nr_frags = 1;
+		skb_shinfo(skb)->nr_frags = i;
 		skb->len = len;
 		skb->data_len = len;
-		skb->truesize += rx_info->len;
 
 		// hand off SKB
 		napi_gro_frags(&cq->napi);
 
-		rx_ring->packets++;
-		rx_ring->bytes += le16_to_cpu(cpl->len);
+		u64_stats_update_begin(&rx_ring->syncp);
+		u64_stats_inc(&rx_ring->packets);
+		u64_stats_add(&rx_ring->bytes, le16_to_cpu(cpl->len));
+		u64_stats_update_end(&rx_ring->syncp);
 
 rx_drop:
 		done++;
 
+cpl_next:
 		cq_cons_ptr++;
 		cq_index = cq_cons_ptr & cq->size_mask;
 	}
 
-	// update CQ consumer pointer
+	// update CQ consumer pointer; written out once enough has been consumed
+	// or on the next arm
 	cq->cons_ptr = cq_cons_ptr;
-	mqnic_cq_write_cons_ptr(cq);
+	mqnic_cq_update_cons_ptr(cq);
+
+	if (tx_ring && tx_done)
+		mqnic_tx_cpl_end(tx_ring, &tx_ctx);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	// flush XDP transmit and redirect
+	if (xdp_flags & MQNIC_XDP_TX)
+		mqnic_xdp_flush(priv->xdp_txq[rx_ring->queue_index % priv->xdp_txq_count]);
+
+	if (xdp_flags & MQNIC_XDP_REDIR)
+		xdp_do_flush();
+#endif
 
 	// process ring
 	ring_cons_ptr = READ_ONCE(rx_ring->cons_ptr);
-	ring_index = ring_cons_ptr & rx_ring->size_mask;
 
-	while (ring_cons_ptr != rx_ring->prod_ptr) {
-		rx_info = &rx_ring->rx_info[ring_index];
+	if (rx_ring->interface->if_features & MQNIC_IF_FEATURE_CPL_IN_ORDER) {
+		// every completion consumed the next entry in ring order
+		ring_cons_ptr += done;
+	} else {
+		ring_index = ring_cons_ptr & rx_ring->size_mask;
+
+		while (ring_cons_ptr != rx_ring->prod_ptr) {
+			rx_info = &rx_ring->rx_info[ring_index << rx_ring->log_desc_block_size];
 
-		if (rx_info->page)
-			break;
+			if (rx_info->page)
+				break;
 
-		ring_cons_ptr++;
-		ring_index = ring_cons_ptr & rx_ring->size_mask;
+			ring_cons_ptr++;
+			ring_index = ring_cons_ptr & rx_ring->size_mask;
+		}
 	}
 
 	// update consumer pointer
 	WRITE_ONCE(rx_ring->cons_ptr, ring_cons_ptr);
 
-	// replenish buffers
-	mqnic_refill_rx_buffers(rx_ring);
+	trace_mqnic_rx_cq(cq, done, napi_budget);
 
-	return done;
+	// replenish buffers; with none left posted no completion will come
+	// back to retry, so stay scheduled and try again on the next poll
+	if (unlikely(mqnic_refill_rx_buffers(rx_ring)) && mqnic_is_rx_ring_empty(rx_ring))
+		return budget;
+
+	// keep polling while TX completions use up the budget
+	return tx_done < budget ? done : budget;
+}
+
+// hardware strips every 802.1Q tag when it has the feature, so this is not
+// switchable; the tag is handed to the stack out of band
+void mqnic_rx_vlan(struct mqnic_ring *ring, const struct mqnic_cpl *cpl, struct sk_buff *skb)
+{
+	if (!(ring->interface->if_features & MQNIC_IF_FEATURE_VLAN_RX))
+		return;
+
+	if (cpl->rx_flags & MQNIC_CPL_RX_FLAG_VLAN)
+		__vlan_hwaccel_put_tag(skb, htons(ETH_P_8021Q), le16_to_cpu(cpl->rx_vlan_tci));
+}
+
+void mqnic_rx_hash(struct mqnic_ring *ring, const struct mqnic_cpl *cpl, struct sk_buff *skb)
+{
+	u8 hash_type = cpl->rx_hash_type;
+
+	if (!(ring->priv->ndev->features & NETIF_F_RXHASH))
+		return;
+
+	if (!(hash_type & (MQNIC_RX_HASH_TYPE_IPV4 | MQNIC_RX_HASH_TYPE_IPV6)))
+		return;
+
+	if (hash_type & (MQNIC_RX_HASH_TYPE_TCP | MQNIC_RX_HASH_TYPE_UDP))
+		skb_set_hash(skb, le32_to_cpu(cpl->rx_hash), PKT_HASH_TYPE_L4);
+	else
+		skb_set_hash(skb, le32_to_cpu(cpl->rx_hash), PKT_HASH_TYPE_L3);
 }
 
 void mqnic_rx_irq(struct mqnic_cq *cq)
 {
+	cq->event_ctr++;
 	napi_schedule_irqoff(&cq->napi);
 }
 
+#ifdef MQNIC_DIM
+static void mqnic_rx_dim_update(struct mqnic_cq *cq)
+{
+	struct mqnic_ring *ring = cq->src_ring;
+	struct dim_sample sample = {};
+
+	dim_update_sample(cq->event_ctr, u64_stats_read(&ring->packets), u64_stats_read(&ring->bytes), &sample);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+	net_dim(&cq->dim, &sample);
+#else
+	net_dim(&cq->dim, sample);
+#endif
+}
+
+void mqnic_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct mqnic_cq *cq = container_of(dim, struct mqnic_cq, dim);
+	struct dim_cq_moder moder;
+
+	moder = net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
+	mqnic_cq_set_coalesce(cq, moder.usec, moder.pkts);
+
+	dim->state = DIM_START_MEASURE;
+}
+#endif
+
 int mqnic_poll_rx_cq(struct napi_struct *napi, int budget)
 {
 	struct mqnic_cq *cq = container_of(napi, struct mqnic_cq, napi);
+	struct mqnic_cq *tx_cq = cq->tx_cq;
+	int tx_done = 0;
+	u64 start = 0;
 	int done;
 
+	// combined channel: reap TX completions first to free up skbs and
+	// wake the queue before handing frames to the stack
+	if (tx_cq)
+		tx_done = mqnic_reap_tx_cq(tx_cq, budget);
+
+	if (static_branch_unlikely(&mqnic_bench_key))
+		start = get_cycles();
+
 	done = mqnic_process_rx_cq(cq, budget);
 
-	if (done == budget)
+	if (static_branch_unlikely(&mqnic_bench_key))
+		mqnic_bench_account(cq->src_ring, start, done);
+
+	if (done == budget) {
+		u64_stats_update_begin(&cq->src_ring->cpl_syncp);
+		u64_stats_inc(&cq->src_ring->napi_exhausted);
+		u64_stats_update_end(&cq->src_ring->cpl_syncp);
 		return done;
+	}
+
+	// TX completions do not count against the RX budget
+	if (tx_done == budget)
+		return budget;
+
+	// leave the CQ unarmed while a busy poller owns the NAPI or hard IRQs
+	// are deferred; the core calls back into poll when it lets go
+	if (!napi_complete_done(napi, done))
+		return done;
+
+	if (tx_cq)
+		mqnic_complete_tx_cq(tx_cq, tx_done);
 
-	napi_complete(napi);
+#ifdef MQNIC_DIM
+	if (cq->src_ring->priv->rx_dim_enabled)
+		mqnic_rx_dim_update(cq);
+#endif
 
-	mqnic_arm_cq(cq);
+	mqnic_rearm_cq(cq, done);
 
 	return done;
 }
@@ -150,3 +150,21 @@ int mqnic_sched_port_queue_get_tc(struct mqnic_sched_port *port, int queue)
     return mqnic_scheduler_queue_port_get_tc(port->sched, port->index, queue);
 }
 EXPORT_SYMBOL(mqnic_sched_port_queue_get_tc);
+
+int mqnic_sched_port_queue_set_weight(struct mqnic_sched_port *port, int queue, int weight)
+{
+    return mqnic_scheduler_queue_set_weight(port->sched, queue, weight);
+}
+EXPORT_SYMBOL(mqnic_sched_port_queue_set_weight);
+
+int mqnic_sched_port_queue_set_rate(struct mqnic_sched_port *port, int queue, u32 rate, u32 burst)
+{
+    return mqnic_scheduler_queue_set_rate(port->sched, queue, rate, burst);
+}
+EXPORT_SYMBOL(mqnic_sched_port_queue_set_rate);
+
+int mqnic_sched_port_channel_set_rate(struct mqnic_sched_port *port, int tc, u32 rate, u32 burst)
+{
+    return mqnic_scheduler_channel_set_rate(port->sched, port->index, tc, rate, burst);
+}
+EXPORT_SYMBOL(mqnic_sched_port_channel_set_rate);
@@ -47,6 +47,10 @@ struct mqnic_sched *mqnic_create_scheduler(struct mqnic_sched_block *block,
 	sched->port_count = (val >> 8) & 0xff;
 	sched->channel_count = sched->tc_count * sched->port_count;
 	sched->fc_scale = 1 << ((val >> 16) & 0xff);
+	sched->dwrr = !!(val & MQNIC_SCHED_RR_CFG_DWRR);
+
+	// rate limiter blocks pair up with schedulers in order
+	sched->rl_rb = mqnic_find_reg_block(block->rb_list, MQNIC_RB_SCHED_RL_TYPE, MQNIC_RB_SCHED_RL_VER, index);
 
 	sched->enable_count = 0;
 	_mqnic_scheduler_disable(sched);
@@ -59,6 +63,8 @@ struct mqnic_sched *mqnic_create_scheduler(struct mqnic_sched_block *block,
 	dev_info(dev, "Scheduler port count: %d", sched->port_count);
 	dev_info(dev, "Scheduler channel count: %d", sched->channel_count);
 	dev_info(dev, "Scheduler FC scale: %d", sched->fc_scale);
+	dev_info(dev, "Scheduler rate limiter: %s", sched->rl_rb ? "present" : "absent");
+	dev_info(dev, "Scheduler queue weights: %s", sched->dwrr ? "yes" : "no");
 
 	INIT_LIST_HEAD(&sched->sched_port_list);
 
@@ -257,3 +263,47 @@ int mqnic_scheduler_queue_port_get_tc(struct mqnic_sched *sched, int queue, int
 	return !!((ioread32(sched->hw_addr + sched->queue_stride*queue) >> port*8) & MQNIC_SCHED_RR_PORT_TC);
 }
 EXPORT_SYMBOL(mqnic_scheduler_queue_port_get_tc);
+
+int mqnic_scheduler_queue_set_weight(struct mqnic_sched *sched, int queue, int weight)
+{
+	if (!sched->dwrr)
+		return -EOPNOTSUPP;
+
+	weight = clamp(weight, 1, MQNIC_SCHED_RR_WEIGHT_MAX);
+	iowrite32(MQNIC_SCHED_RR_CMD_SET_QUEUE_WEIGHT | weight, sched->hw_addr + sched->queue_stride*queue);
+
+	return 0;
+}
+EXPORT_SYMBOL(mqnic_scheduler_queue_set_weight);
+
+static void mqnic_scheduler_set_rate(struct mqnic_sched *sched, u32 index, u32 rate, u32 burst)
+{
+	iowrite32(index, sched->rl_rb->regs + MQNIC_RB_SCHED_RL_REG_INDEX);
+	iowrite32(burst, sched->rl_rb->regs + MQNIC_RB_SCHED_RL_REG_BURST);
+	// rate write commits the bucket; zero disables limiting
+	iowrite32(rate, sched->rl_rb->regs + MQNIC_RB_SCHED_RL_REG_RATE);
+}
+
+int mqnic_scheduler_queue_set_rate(struct mqnic_sched *sched, int queue, u32 rate, u32 burst)
+{
+	if (!sched->rl_rb)
+		return -EOPNOTSUPP;
+
+	mqnic_scheduler_set_rate(sched, queue, rate, burst);
+
+	return 0;
+}
+EXPORT_SYMBOL(mqnic_scheduler_queue_set_rate);
+
+int mqnic_scheduler_channel_set_rate(struct mqnic_sched *sched, int port, int tc, u32 rate, u32 burst)
+{
+	int ch = sched->tc_count*port + tc;
+
+	if (!sched->rl_rb)
+		return -EOPNOTSUPP;
+
+	mqnic_scheduler_set_rate(sched, MQNIC_SCHED_RL_INDEX_CHANNEL | ch, rate, burst);
+
+	return 0;
+}
+EXPORT_SYMBOL(mqnic_scheduler_channel_set_rate);
@@ -0,0 +1,454 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+/*
+ * SR-IOV virtual functions.
+ *
+ * On the PF, each VF is given contiguous EQ, CQ, TXQ and RXQ ranges and one
+ * scheduler port out of interface 0.  The queues are tagged with the VF ID
+ * (VF index + 1, 0 is the PF) so their DMA goes out as the VF, and the
+ * assignment is written to the VF's entry in the SR-IOV register block.
+ *
+ * The VF sees a BAR with the same layout as a single interface PF, limited
+ * to and renumbered from its ranges, with its own RX queue map and
+ * scheduler port, and is driven by this same driver; its SR-IOV block has
+ * one read-only entry describing itself, which is where it finds the MAC
+ * address the PF assigned.  The VF device ID is expected to match the PF's.
+ */
+
+static u8 __iomem *mqnic_sriov_vf_regs(struct mqnic_dev *mdev, int index)
+{
+	return mdev->sriov_rb->regs + mdev->sriov_vf_offset + index * mdev->sriov_vf_stride;
+}
+
+static void mqnic_sriov_read_mac(u8 __iomem *regs, u8 *mac)
+{
+	u32 val;
+
+	val = ioread32(regs + MQNIC_SRIOV_VF_REG_MAC_H);
+	mac[0] = val >> 8;
+	mac[1] = val;
+	val = ioread32(regs + MQNIC_SRIOV_VF_REG_MAC_L);
+	mac[2] = val >> 24;
+	mac[3] = val >> 16;
+	mac[4] = val >> 8;
+	mac[5] = val;
+}
+
+static void mqnic_sriov_write_mac(u8 __iomem *regs, const u8 *mac)
+{
+	iowrite32((mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5],
+			regs + MQNIC_SRIOV_VF_REG_MAC_L);
+	iowrite32((mac[0] << 8) | mac[1], regs + MQNIC_SRIOV_VF_REG_MAC_H);
+}
+
+bool mqnic_sriov_is_vf(struct mqnic_dev *mdev)
+{
+#ifdef CONFIG_PCI
+	return mdev->pdev && mdev->pdev->is_virtfn;
+#else
+	return false;
+#endif
+}
+
+void mqnic_sriov_init(struct mqnic_dev *mdev)
+{
+	struct device *dev = mdev->dev;
+
+	mdev->sriov_rb = mqnic_find_reg_block(mdev->rb_list, MQNIC_RB_SRIOV_TYPE, MQNIC_RB_SRIOV_VER, 0);
+
+	if (!mdev->sriov_rb)
+		return;
+
+	mdev->sriov_vf_max = ioread32(mdev->sriov_rb->regs + MQNIC_RB_SRIOV_REG_VF_COUNT);
+	mdev->sriov_vf_offset = ioread32(mdev->sriov_rb->regs + MQNIC_RB_SRIOV_REG_VF_OFFSET);
+	mdev->sriov_vf_stride = ioread32(mdev->sriov_rb->regs + MQNIC_RB_SRIOV_REG_VF_STRIDE);
+
+	dev_info(dev, "SR-IOV VF count: %d", mdev->sriov_vf_max);
+
+#ifdef CONFIG_PCI
+	if (mdev->pdev && !mqnic_sriov_is_vf(mdev) && mdev->sriov_vf_max < pci_sriov_get_totalvfs(mdev->pdev))
+		pci_sriov_set_totalvfs(mdev->pdev, mdev->sriov_vf_max);
+#endif
+}
+
+// VFs have no board I2C; the only board state is the MAC from the PF
+int mqnic_sriov_vf_init(struct mqnic_dev *mdev)
+{
+	mdev->mac_count = 0;
+
+	if (!mdev->sriov_rb || !mdev->sriov_vf_max) {
+		dev_warn(mdev->dev, "No SR-IOV block in VF; using random MAC");
+		return 0;
+	}
+
+	mqnic_sriov_read_mac(mqnic_sriov_vf_regs(mdev, 0), mdev->mac_list[0]);
+
+	if (is_valid_ether_addr(mdev->mac_list[0]))
+		mdev->mac_count = 1;
+
+	return 0;
+}
+
+#ifdef CONFIG_PCI
+// EQ, CQ and queue control registers share the command layout
+static void mqnic_sriov_tag_range(struct mqnic_res *res, struct mqnic_vf_range *r, u32 vf_id)
+{
+	u8 __iomem *hw_addr;
+	unsigned int k;
+
+	for (k = 0; k < r->count; k++) {
+		hw_addr = mqnic_res_get_addr(res, r->base + k);
+
+		iowrite32(MQNIC_QUEUE_CMD_SET_ENABLE | 0, hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
+		iowrite32(MQNIC_QUEUE_CMD_SET_VF_ID | vf_id, hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
+	}
+}
+
+static int mqnic_sriov_assign_range(struct mqnic_res *res, struct mqnic_vf_range *r,
+		unsigned int count, u32 vf_id)
+{
+	r->base = mqnic_res_alloc_range(res, count);
+	if (r->base < 0) {
+		r->count = 0;
+		return r->base;
+	}
+
+	r->count = count;
+	mqnic_sriov_tag_range(res, r, vf_id);
+
+	return 0;
+}
+
+static void mqnic_sriov_release_range(struct mqnic_res *res, struct mqnic_vf_range *r)
+{
+	if (!r->count)
+		return;
+
+	// queues may have been left running by the VF, stop them and hand back to the PF
+	mqnic_sriov_tag_range(res, r, 0);
+	mqnic_res_free_range(res, r->base, r->count);
+	r->count = 0;
+}
+
+static void mqnic_sriov_write_vf(struct mqnic_dev *mdev, struct mqnic_vf *vf)
+{
+	u8 __iomem *regs = mqnic_sriov_vf_regs(mdev, vf->index);
+	struct mqnic_sched_port *port = vf->sched_port;
+
+	iowrite32(0, regs + MQNIC_SRIOV_VF_REG_CTRL);
+
+	if (!port)
+		return;
+
+	iowrite32(vf->eq.base, regs + MQNIC_SRIOV_VF_REG_EQ_BASE);
+	iowrite32(vf->eq.count, regs + MQNIC_SRIOV_VF_REG_EQ_COUNT);
+	iowrite32(vf->cq.base, regs + MQNIC_SRIOV_VF_REG_CQ_BASE);
+	iowrite32(vf->cq.count, regs + MQNIC_SRIOV_VF_REG_CQ_COUNT);
+	iowrite32(vf->txq.base, regs + MQNIC_SRIOV_VF_REG_TXQ_BASE);
+	iowrite32(vf->txq.count, regs + MQNIC_SRIOV_VF_REG_TXQ_COUNT);
+	iowrite32(vf->rxq.base, regs + MQNIC_SRIOV_VF_REG_RXQ_BASE);
+	iowrite32(vf->rxq.count, regs + MQNIC_SRIOV_VF_REG_RXQ_COUNT);
+	// scheduler block index, scheduler index, port index
+	iowrite32((port->sched->sched_block->index << 16) | (port->sched->index << 8) | port->index,
+			regs + MQNIC_SRIOV_VF_REG_SCHED_PORT);
+	mqnic_sriov_write_mac(regs, vf->mac);
+
+	iowrite32(MQNIC_SRIOV_VF_CTRL_EN, regs + MQNIC_SRIOV_VF_REG_CTRL);
+}
+
+static void mqnic_sriov_free_vf(struct mqnic_dev *mdev, struct mqnic_vf *vf)
+{
+	struct mqnic_if *iface = mdev->interface[0];
+
+	if (vf->sched_port) {
+		mqnic_interface_free_sched_port(iface, vf->sched_port);
+		vf->sched_port = NULL;
+	}
+
+	mqnic_sriov_write_vf(mdev, vf);
+
+	mqnic_sriov_release_range(iface->rxq_res, &vf->rxq);
+	mqnic_sriov_release_range(iface->txq_res, &vf->txq);
+	mqnic_sriov_release_range(iface->cq_res, &vf->cq);
+	mqnic_sriov_release_range(iface->eq_res, &vf->eq);
+}
+
+static int mqnic_sriov_alloc_vf(struct mqnic_dev *mdev, struct mqnic_vf *vf)
+{
+	struct mqnic_if *iface = mdev->interface[0];
+	unsigned int count = mqnic_sriov_vf_queues;
+	u32 vf_id = vf->index + 1;
+	int ret;
+
+	// one EQ and a TX and RX CQ per queue pair
+	ret = mqnic_sriov_assign_range(iface->eq_res, &vf->eq, count, vf_id);
+	if (ret)
+		goto fail;
+
+	ret = mqnic_sriov_assign_range(iface->cq_res, &vf->cq, count * 2, vf_id);
+	if (ret)
+		goto fail;
+
+	ret = mqnic_sriov_assign_range(iface->txq_res, &vf->txq, count, vf_id);
+	if (ret)
+		goto fail;
+
+	ret = mqnic_sriov_assign_range(iface->rxq_res, &vf->rxq, count, vf_id);
+	if (ret)
+		goto fail;
+
+	vf->sched_port = mqnic_interface_alloc_sched_port(iface);
+	if (!vf->sched_port) {
+		ret = -ENOSPC;
+		goto fail;
+	}
+
+	if (!is_valid_ether_addr(vf->mac))
+		eth_random_addr(vf->mac);
+
+	mqnic_sriov_write_vf(mdev, vf);
+
+	return 0;
+
+fail:
+	mqnic_sriov_free_vf(mdev, vf);
+	return ret;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+// VF port functions, so that the PF can weight VFs as devlink rate leaves
+#define MQNIC_SRIOV_DL_PORT_BASE 0x10000
+
+static void mqnic_sriov_add_vf_ports(struct mqnic_dev *mdev)
+{
+	struct devlink *devlink = priv_to_devlink(mdev);
+	struct mqnic_vf *vf;
+	int ret;
+	int k;
+
+	devl_lock(devlink);
+
+	for (k = 0; k < mdev->vf_count; k++) {
+		vf = &mdev->vf[k];
+
+		devlink_port_attrs_pci_vf_set(&vf->dl_port, 0, PCI_FUNC(mdev->pdev->devfn), k, false);
+
+		ret = devl_port_register(devlink, &vf->dl_port, MQNIC_SRIOV_DL_PORT_BASE + k);
+		if (ret) {
+			dev_warn(mdev->dev, "Failed to register devlink port for VF %d: %d", k, ret);
+			continue;
+		}
+
+		vf->dl_port_registered = true;
+
+		if (!mdev->interface[0]->sched_dwrr)
+			continue;
+
+		vf->dl_rate.vf = vf;
+
+		ret = devl_rate_leaf_create(&vf->dl_port, &vf->dl_rate, NULL);
+		if (ret) {
+			dev_warn(mdev->dev, "Failed to create devlink rate object for VF %d: %d", k, ret);
+			vf->dl_rate.vf = NULL;
+			continue;
+		}
+
+		list_add_tail(&vf->dl_rate.list, &mdev->rate_list);
+	}
+
+	mqnic_devl_rate_update(mdev);
+
+	devl_unlock(devlink);
+}
+
+static void mqnic_sriov_del_vf_ports(struct mqnic_dev *mdev)
+{
+	struct devlink *devlink = priv_to_devlink(mdev);
+	struct mqnic_vf *vf;
+	int k;
+
+	devl_lock(devlink);
+
+	for (k = 0; k < mdev->vf_count; k++) {
+		vf = &mdev->vf[k];
+
+		if (vf->dl_rate.vf) {
+			devl_rate_leaf_destroy(&vf->dl_port);
+			list_del(&vf->dl_rate.list);
+			vf->dl_rate.vf = NULL;
+		}
+
+		if (vf->dl_port_registered) {
+			devl_port_unregister(&vf->dl_port);
+			vf->dl_port_registered = false;
+		}
+	}
+
+	mqnic_devl_rate_update(mdev);
+
+	devl_unlock(devlink);
+}
+#else
+static void mqnic_sriov_add_vf_ports(struct mqnic_dev *mdev)
+{
+}
+
+static void mqnic_sriov_del_vf_ports(struct mqnic_dev *mdev)
+{
+}
+#endif
+
+void mqnic_sriov_disable(struct mqnic_dev *mdev)
+{
+	int k;
+
+	if (!mdev->vf)
+		return;
+
+	mqnic_sriov_del_vf_ports(mdev);
+
+	// removes the VF devices, and with them their drivers
+	pci_disable_sriov(mdev->pdev);
+
+	mutex_lock(&mdev->state_lock);
+
+	for (k = 0; k < mdev->vf_count; k++)
+		mqnic_sriov_free_vf(mdev, &mdev->vf[k]);
+
+	kfree(mdev->vf);
+	mdev->vf = NULL;
+	mdev->vf_count = 0;
+
+	mutex_unlock(&mdev->state_lock);
+}
+
+static int mqnic_sriov_enable(struct mqnic_dev *mdev, int num_vfs)
+{
+	struct device *dev = mdev->dev;
+	int ret;
+	int k;
+
+	if (!mdev->sriov_rb || !mdev->interface[0])
+		return -EOPNOTSUPP;
+
+	if (num_vfs > mdev->sriov_vf_max)
+		return -EINVAL;
+
+	if (!mqnic_sriov_vf_queues)
+		return -EINVAL;
+
+	mutex_lock(&mdev->state_lock);
+
+	mdev->vf = kcalloc(num_vfs, sizeof(*mdev->vf), GFP_KERNEL);
+	if (!mdev->vf) {
+		mutex_unlock(&mdev->state_lock);
+		return -ENOMEM;
+	}
+
+	for (k = 0; k < num_vfs; k++) {
+		mdev->vf[k].index = k;
+
+		ret = mqnic_sriov_alloc_vf(mdev, &mdev->vf[k]);
+		if (ret) {
+			dev_err(dev, "Not enough free queues or scheduler ports for VF %d", k);
+			mdev->vf_count = k;
+			mutex_unlock(&mdev->state_lock);
+			goto fail;
+		}
+	}
+
+	mdev->vf_count = num_vfs;
+
+	mutex_unlock(&mdev->state_lock);
+
+	ret = pci_enable_sriov(mdev->pdev, num_vfs);
+	if (ret) {
+		dev_err(dev, "Failed to enable SR-IOV: %d", ret);
+		goto fail;
+	}
+
+	dev_info(dev, "Enabled %d VFs, %d queues each", num_vfs, mqnic_sriov_vf_queues);
+
+	mqnic_sriov_add_vf_ports(mdev);
+
+	return 0;
+
+fail:
+	// pci_disable_sriov() is a no-op when SR-IOV was never enabled
+	mqnic_sriov_disable(mdev);
+	return ret;
+}
+
+int mqnic_sriov_configure(struct pci_dev *pdev, int num_vfs)
+{
+	struct mqnic_dev *mdev = pci_get_drvdata(pdev);
+	int ret;
+
+	if (!num_vfs) {
+		if (pci_vfs_assigned(pdev)) {
+			dev_warn(&pdev->dev, "VFs are assigned to guests, not disabling SR-IOV");
+			return -EPERM;
+		}
+
+		mqnic_sriov_disable(mdev);
+		return 0;
+	}
+
+	ret = mqnic_sriov_enable(mdev, num_vfs);
+
+	return ret ? ret : num_vfs;
+}
+
+// takes effect the next time the VF driver probes
+int mqnic_set_vf_mac(struct net_device *ndev, int vf, u8 *mac)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	int ret = 0;
+
+	if (!is_valid_ether_addr(mac))
+		return -EINVAL;
+
+	mutex_lock(&mdev->state_lock);
+
+	if (vf < 0 || vf >= mdev->vf_count) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ether_addr_copy(mdev->vf[vf].mac, mac);
+	mqnic_sriov_write_mac(mqnic_sriov_vf_regs(mdev, vf), mac);
+
+out:
+	mutex_unlock(&mdev->state_lock);
+
+	return ret;
+}
+
+int mqnic_get_vf_config(struct net_device *ndev, int vf, struct ifla_vf_info *ivi)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	int ret = 0;
+
+	mutex_lock(&mdev->state_lock);
+
+	if (vf < 0 || vf >= mdev->vf_count) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ivi->vf = vf;
+	ether_addr_copy(ivi->mac, mdev->vf[vf].mac);
+
+out:
+	mutex_unlock(&mdev->state_lock);
+
+	return ret;
+}
+#endif /* CONFIG_PCI */
@@ -5,6 +5,54 @@
 
 #include "mqnic.h"
 
+/*
+ * Periodic counter write-back.
+ *
+ * When the stats block advertises MQNIC_RB_STATS_FLAG_DMA and the
+ * stats_dma_interval parameter is set, the device copies the whole counter
+ * block into one coherent buffer every interval.  Each pass bumps a
+ * generation number and writes it to the header, then the counters in
+ * index order, then the trailer, so a reader that finds the same nonzero
+ * generation in the trailer before copying and in the header after holds
+ * the counters of a single pass.
+ *
+ * The buffer backs ethtool and mqnic_stats_read_bulk() for the app drivers,
+ * and is exposed read-only to userspace as an mmap region.
+ * mqnic_stats_read() stays a register read for callers that time deltas.
+ */
+
+#define MQNIC_STATS_DMA_RETRIES 8
+
+static void mqnic_stats_dma_init(struct mqnic_dev *mdev)
+{
+	u64 cycles;
+
+	if (!mqnic_stats_dma_interval || !(mdev->stats_flags & MQNIC_RB_STATS_FLAG_DMA))
+		return;
+
+	cycles = mqnic_core_clk_ns_to_cycles(mdev, (u64)mqnic_stats_dma_interval * 1000);
+	if (!cycles || cycles > U32_MAX) {
+		dev_warn(mdev->dev, "Unusable statistics DMA interval of %u us", mqnic_stats_dma_interval);
+		return;
+	}
+
+	mdev->stats_dma_size = PAGE_ALIGN(MQNIC_STATS_DMA_SIZE(mdev->stats_count));
+	mdev->stats_dma_buf = dma_alloc_coherent(mdev->dev, mdev->stats_dma_size,
+			&mdev->stats_dma_addr, GFP_KERNEL | __GFP_ZERO);
+	if (!mdev->stats_dma_buf) {
+		dev_warn(mdev->dev, "Failed to allocate statistics DMA buffer");
+		mdev->stats_dma_size = 0;
+		return;
+	}
+
+	iowrite32(upper_32_bits(mdev->stats_dma_addr), mdev->stats_rb->regs + MQNIC_RB_STATS_REG_DMA_ADDR_H);
+	iowrite32(lower_32_bits(mdev->stats_dma_addr), mdev->stats_rb->regs + MQNIC_RB_STATS_REG_DMA_ADDR_L);
+	iowrite32(cycles, mdev->stats_rb->regs + MQNIC_RB_STATS_REG_DMA_INTERVAL);
+	iowrite32(MQNIC_RB_STATS_DMA_CTRL_EN, mdev->stats_rb->regs + MQNIC_RB_STATS_REG_DMA_CTRL);
+
+	dev_info(mdev->dev, "Statistics DMA every %u us", mqnic_stats_dma_interval);
+}
+
 void mqnic_stats_init(struct mqnic_dev *mdev)
 {
 	mdev->stats_rb = mqnic_find_reg_block(mdev->rb_list, MQNIC_RB_STATS_TYPE, MQNIC_RB_STATS_VER, 0);
@@ -16,18 +64,120 @@ void mqnic_stats_init(struct mqnic_dev *mdev)
 	mdev->stats_count = ioread32(mdev->stats_rb->regs + MQNIC_RB_STATS_REG_COUNT);
 	mdev->stats_stride = ioread32(mdev->stats_rb->regs + MQNIC_RB_STATS_REG_STRIDE);
 	mdev->stats_flags = ioread32(mdev->stats_rb->regs + MQNIC_RB_STATS_REG_FLAGS);
+
+	mqnic_stats_dma_init(mdev);
+}
+
+void mqnic_stats_deinit(struct mqnic_dev *mdev)
+{
+	int k;
+
+	if (!mdev->stats_dma_buf)
+		return;
+
+	iowrite32(0, mdev->stats_rb->regs + MQNIC_RB_STATS_REG_DMA_CTRL);
+
+	// a pass already started still lands in the buffer
+	for (k = 0; k < 100; k++) {
+		if (!(ioread32(mdev->stats_rb->regs + MQNIC_RB_STATS_REG_DMA_CTRL) & MQNIC_RB_STATS_DMA_CTRL_ACTIVE))
+			break;
+		usleep_range(10, 20);
+	}
+
+	if (k == 100) {
+		// leak rather than free memory the device may still write
+		dev_warn(mdev->dev, "Statistics DMA did not stop");
+	} else {
+		iowrite32(0, mdev->stats_rb->regs + MQNIC_RB_STATS_REG_DMA_ADDR_L);
+		iowrite32(0, mdev->stats_rb->regs + MQNIC_RB_STATS_REG_DMA_ADDR_H);
+		dma_free_coherent(mdev->dev, mdev->stats_dma_size,
+				mdev->stats_dma_buf, mdev->stats_dma_addr);
+	}
+
+	mdev->stats_dma_buf = NULL;
+	mdev->stats_dma_size = 0;
 }
 
 u64 mqnic_stats_read(struct mqnic_dev *mdev, int index)
 {
-	u64 val;
+	u8 __iomem *addr;
+	u32 lo, hi, hi2;
 
 	if (!mdev->stats_rb || index < 0 || index >= mdev->stats_count)
 		return 0;
 
-	val = (u64)ioread32(mdev->hw_addr + mdev->stats_offset + index*8 + 0);
-	val |= (u64)ioread32(mdev->hw_addr + mdev->stats_offset + index*8 + 4) << 32;
+	addr = mdev->hw_addr + mdev->stats_offset + index*8;
 
-	return val;
+	// the halves are separate reads; retry the low word if a carry
+	// landed in between
+	hi = ioread32(addr + 4);
+	lo = ioread32(addr + 0);
+	hi2 = ioread32(addr + 4);
+
+	if (hi != hi2)
+		lo = ioread32(addr + 0);
+
+	return ((u64)hi2 << 32) | lo;
 }
 EXPORT_SYMBOL(mqnic_stats_read);
+
+// generation of the last complete write-back pass, 0 when there is none
+u32 mqnic_stats_dma_gen(struct mqnic_dev *mdev)
+{
+	__le32 *trailer;
+
+	if (!mdev->stats_dma_buf)
+		return 0;
+
+	trailer = (__le32 *)((__le64 *)(mdev->stats_dma_buf + 1) + mdev->stats_count);
+
+	return le32_to_cpu(READ_ONCE(*trailer));
+}
+EXPORT_SYMBOL(mqnic_stats_dma_gen);
+
+// counters from the last write-back pass, or from the registers without one
+int mqnic_stats_read_bulk(struct mqnic_dev *mdev, int index, u64 *buf, int count)
+{
+	const __le64 *counters;
+	u32 gen;
+	int retry;
+	int k;
+
+	if (!mdev->stats_rb || index < 0 || count < 0 || (u32)(index + count) > mdev->stats_count)
+		return -EINVAL;
+
+	counters = (const __le64 *)(mdev->stats_dma_buf + 1);
+
+	for (retry = 0; retry < MQNIC_STATS_DMA_RETRIES; retry++) {
+		gen = mqnic_stats_dma_gen(mdev);
+		if (!gen)
+			break;
+
+		dma_rmb();
+
+		for (k = 0; k < count; k++)
+			buf[k] = le64_to_cpu(READ_ONCE(counters[index + k]));
+
+		dma_rmb();
+
+		if (le32_to_cpu(READ_ONCE(mdev->stats_dma_buf->gen)) == gen)
+			return 0;
+	}
+
+	for (k = 0; k < count; k++)
+		buf[k] = mqnic_stats_read(mdev, index + k);
+
+	return 0;
+}
+EXPORT_SYMBOL(mqnic_stats_read_bulk);
+
+u64 mqnic_stats_read_cached(struct mqnic_dev *mdev, int index)
+{
+	u64 val;
+
+	if (mqnic_stats_read_bulk(mdev, index, &val, 1))
+		return 0;
+
+	return val;
+}
+EXPORT_SYMBOL(mqnic_stats_read_cached);
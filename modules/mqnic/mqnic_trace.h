@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: BSD-2-Clause-Views */
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mqnic
+
+#if !defined(MQNIC_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define MQNIC_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#include "mqnic.h"
+
+// ring occupancy is prod_ptr - cons_ptr at the point of the event
+
+TRACE_EVENT(mqnic_tx_xmit,
+	TP_PROTO(struct mqnic_ring *ring, u32 len, bool doorbell),
+	TP_ARGS(ring, len, doorbell),
+	TP_STRUCT__entry(
+		__field(int, ifindex)
+		__field(int, queue)
+		__field(u32, len)
+		__field(u32, occupancy)
+		__field(bool, doorbell)
+	),
+	TP_fast_assign(
+		__entry->ifindex = ring->priv->ndev->ifindex;
+		__entry->queue = ring->index;
+		__entry->len = len;
+		__entry->occupancy = ring->prod_ptr - READ_ONCE(ring->cons_ptr);
+		__entry->doorbell = doorbell;
+	),
+	TP_printk("ifindex=%d queue=%d len=%u occupancy=%u doorbell=%d",
+		__entry->ifindex, __entry->queue, __entry->len,
+		__entry->occupancy, __entry->doorbell)
+);
+
+DECLARE_EVENT_CLASS(mqnic_cq_class,
+	TP_PROTO(struct mqnic_cq *cq, int done, int budget),
+	TP_ARGS(cq, done, budget),
+	TP_STRUCT__entry(
+		__field(int, ifindex)
+		__field(int, queue)
+		__field(int, cqn)
+		__field(int, done)
+		__field(int, budget)
+		__field(u32, occupancy)
+	),
+	TP_fast_assign(
+		__entry->ifindex = cq->src_ring->priv->ndev->ifindex;
+		__entry->queue = cq->src_ring->index;
+		__entry->cqn = cq->cqn;
+		__entry->done = done;
+		__entry->budget = budget;
+		__entry->occupancy = cq->src_ring->prod_ptr - READ_ONCE(cq->src_ring->cons_ptr);
+	),
+	TP_printk("ifindex=%d queue=%d cqn=%d done=%d budget=%d occupancy=%u",
+		__entry->ifindex, __entry->queue, __entry->cqn, __entry->done,
+		__entry->budget, __entry->occupancy)
+);
+
+DEFINE_EVENT(mqnic_cq_class, mqnic_tx_cq,
+	TP_PROTO(struct mqnic_cq *cq, int done, int budget),
+	TP_ARGS(cq, done, budget)
+);
+
+DEFINE_EVENT(mqnic_cq_class, mqnic_rx_cq,
+	TP_PROTO(struct mqnic_cq *cq, int done, int budget),
+	TP_ARGS(cq, done, budget)
+);
+
+TRACE_EVENT(mqnic_rx_refill,
+	TP_PROTO(struct mqnic_ring *ring, u32 missing, u32 filled),
+	TP_ARGS(ring, missing, filled),
+	TP_STRUCT__entry(
+		__field(int, ifindex)
+		__field(int, queue)
+		__field(u32, missing)
+		__field(u32, filled)
+	),
+	TP_fast_assign(
+		__entry->ifindex = ring->priv->ndev->ifindex;
+		__entry->queue = ring->index;
+		__entry->missing = missing;
+		__entry->filled = filled;
+	),
+	TP_printk("ifindex=%d queue=%d missing=%u filled=%u",
+		__entry->ifindex, __entry->queue, __entry->missing, __entry->filled)
+);
+
+TRACE_EVENT(mqnic_eq,
+	TP_PROTO(struct mqnic_eq *eq, int done, int budget),
+	TP_ARGS(eq, done, budget),
+	TP_STRUCT__entry(
+		__field(int, interface)
+		__field(int, eqn)
+		__field(int, done)
+		__field(int, budget)
+	),
+	TP_fast_assign(
+		__entry->interface = eq->interface->index;
+		__entry->eqn = eq->eqn;
+		__entry->done = done;
+		__entry->budget = budget;
+	),
+	TP_printk("interface=%d eqn=%d done=%d budget=%d",
+		__entry->interface, __entry->eqn, __entry->done, __entry->budget)
+);
+
+TRACE_EVENT(mqnic_cq_arm,
+	TP_PROTO(struct mqnic_cq *cq, int done, bool deferred),
+	TP_ARGS(cq, done, deferred),
+	TP_STRUCT__entry(
+		__field(int, interface)
+		__field(int, cqn)
+		__field(int, done)
+		__field(bool, deferred)
+	),
+	TP_fast_assign(
+		__entry->interface = cq->interface->index;
+		__entry->cqn = cq->cqn;
+		__entry->done = done;
+		__entry->deferred = deferred;
+	),
+	TP_printk("interface=%d cqn=%d done=%d deferred=%d",
+		__entry->interface, __entry->cqn, __entry->done, __entry->deferred)
+);
+
+#endif /* MQNIC_TRACE_H */
+
+// must be outside the include guard
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mqnic_trace
+
+#include <trace/define_trace.h>
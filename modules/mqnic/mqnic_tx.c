@@ -5,6 +5,20 @@
 
 #include <linux/version.h>
 #include "mqnic.h"
+#include "mqnic_trace.h"
+
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <net/ip6_checksum.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+#include <net/xdp_sock_drv.h>
+#endif
+
+#ifdef MQNIC_SW_TSO
+#include <net/tso.h>
+#endif
 
 struct mqnic_ring *mqnic_create_tx_ring(struct mqnic_if *interface)
 {
@@ -25,6 +39,11 @@ struct mqnic_ring *mqnic_create_tx_ring(struct mqnic_if *interface)
 	ring->prod_ptr = 0;
 	ring->cons_ptr = 0;
 
+	spin_lock_init(&ring->xdp_tx_lock);
+
+	u64_stats_init(&ring->syncp);
+	u64_stats_init(&ring->cpl_syncp);
+
 	return ring;
 }
 
@@ -43,7 +62,9 @@ int mqnic_open_tx_ring(struct mqnic_ring *ring, struct mqnic_priv *priv,
 	if (ring->enabled || ring->hw_addr || ring->buf || !priv || !cq)
 		return -EINVAL;
 
-	ring->index = mqnic_res_alloc(ring->interface->txq_res);
+	// the caller may have reserved an index as part of a range
+	if (ring->index < 0)
+		ring->index = mqnic_res_alloc(ring->interface->txq_res);
 	if (ring->index < 0)
 		return -ENOMEM;
 
@@ -55,27 +76,64 @@ int mqnic_open_tx_ring(struct mqnic_ring *ring, struct mqnic_priv *priv,
 	ring->size_mask = ring->size - 1;
 	ring->stride = roundup_pow_of_two(MQNIC_DESC_SIZE * ring->desc_block_size);
 
-	ring->tx_info = kvzalloc(sizeof(*ring->tx_info) * ring->size, GFP_KERNEL);
+	ring->node = cq->node;
+
+	ring->tx_info = kvzalloc_node(sizeof(*ring->tx_info) * ring->size, GFP_KERNEL, ring->node);
 	if (!ring->tx_info) {
 		ret = -ENOMEM;
 		goto fail;
 	}
 
 	ring->buf_size = ring->size * ring->stride;
-	ring->buf = dma_alloc_coherent(ring->dev, ring->buf_size, &ring->buf_dma_addr, GFP_KERNEL);
+	ring->buf = mqnic_dma_arena_alloc(&ring->interface->dma_arena, ring->buf_size,
+			&ring->buf_dma_addr, ring->node);
 	if (!ring->buf) {
 		ret = -ENOMEM;
 		goto fail;
 	}
 
+#ifdef MQNIC_SW_TSO
+	// per-entry header buffers for driver-side segmentation
+	if (!(ring->interface->if_features & MQNIC_IF_FEATURE_TSO) && ring->desc_block_size > 1) {
+		ring->tso_hdrs = mqnic_dma_alloc_coherent_node(ring->dev, ring->size * TSO_HEADER_SIZE,
+				&ring->tso_hdrs_dma_addr, ring->node);
+		if (!ring->tso_hdrs) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+	}
+#endif
+
+	ring->tx_bounce = mqnic_dma_alloc_coherent_node(ring->dev, ring->size * MQNIC_TX_COPYBREAK_MAX,
+			&ring->tx_bounce_dma_addr, ring->node);
+	if (!ring->tx_bounce) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
 	ring->priv = priv;
 	ring->cq = cq;
-	cq->src_ring = ring;
-	cq->handler = mqnic_tx_irq;
+	// on a shared CQ the RX ring stays the source and owns the handler
+	if (!cq->src_ring) {
+		cq->src_ring = ring;
+		cq->handler = mqnic_tx_irq;
+	}
 
 	ring->hw_addr = mqnic_res_get_addr(ring->interface->txq_res, ring->index);
 
+	// a push slot holds one descriptor block followed by inline packet bytes
+	if (ring->index < ring->interface->tx_push_count &&
+			ring->interface->tx_push_slot_size >= ring->stride) {
+		ring->push_addr = ring->interface->tx_push_hw_addr +
+				ring->index * ring->interface->tx_push_stride;
+		ring->push_slot_size = ring->interface->tx_push_slot_size;
+		ring->push_slot_mask = rounddown_pow_of_two(ring->interface->tx_push_stride /
+				ring->push_slot_size) - 1;
+		ring->push_inline_len = (ring->push_slot_size - ring->stride) & ~7;
+	}
+
 	ring->prod_ptr = 0;
+	ring->db_prod_ptr = 0;
 	ring->cons_ptr = 0;
 
 	// deactivate queue
@@ -98,6 +156,12 @@ int mqnic_open_tx_ring(struct mqnic_ring *ring, struct mqnic_priv *priv,
 	iowrite32(MQNIC_QUEUE_CMD_SET_CONS_PTR | (ring->cons_ptr & MQNIC_QUEUE_PTR_MASK),
 			ring->hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
 
+	ring->ptr_shadow = mqnic_interface_attach_ptr_shadow(ring->interface,
+			ring->interface->txq_res, ring->index, ring->hw_addr + MQNIC_QUEUE_SHADOW_ADDR_REG);
+
+	if (cq->src_ring != ring)
+		WRITE_ONCE(cq->tx_ring, ring);
+
 	return 0;
 
 fail:
@@ -109,7 +173,9 @@ void mqnic_close_tx_ring(struct mqnic_ring *ring)
 {
 	mqnic_disable_tx_ring(ring);
 
-	if (ring->cq) {
+	if (ring->cq && ring->cq->src_ring != ring) {
+		WRITE_ONCE(ring->cq->tx_ring, NULL);
+	} else if (ring->cq) {
 		ring->cq->src_ring = NULL;
 		ring->cq->handler = NULL;
 	}
@@ -117,21 +183,51 @@ void mqnic_close_tx_ring(struct mqnic_ring *ring)
 	ring->priv = NULL;
 	ring->cq = NULL;
 
+	if (ring->hw_addr) {
+		mqnic_interface_detach_ptr_shadow(ring->ptr_shadow,
+				ring->hw_addr + MQNIC_QUEUE_SHADOW_ADDR_REG);
+		ring->ptr_shadow = NULL;
+	}
+
 	ring->hw_addr = NULL;
+	ring->push_addr = NULL;
 
 	if (ring->buf) {
 		mqnic_free_tx_buf(ring);
 
-		dma_free_coherent(ring->dev, ring->buf_size, ring->buf, ring->buf_dma_addr);
+		mqnic_dma_arena_free(&ring->interface->dma_arena, ring->buf_size,
+				ring->buf, ring->buf_dma_addr);
 		ring->buf = NULL;
 		ring->buf_dma_addr = 0;
 	}
 
+#ifdef MQNIC_SW_TSO
+	if (ring->tso_hdrs) {
+		dma_free_coherent(ring->dev, ring->size * TSO_HEADER_SIZE,
+				ring->tso_hdrs, ring->tso_hdrs_dma_addr);
+		ring->tso_hdrs = NULL;
+		ring->tso_hdrs_dma_addr = 0;
+	}
+#endif
+
+	if (ring->tx_bounce) {
+		dma_free_coherent(ring->dev, ring->size * MQNIC_TX_COPYBREAK_MAX,
+				ring->tx_bounce, ring->tx_bounce_dma_addr);
+		ring->tx_bounce = NULL;
+		ring->tx_bounce_dma_addr = 0;
+	}
+
+	// BQL
+	if (ring->tx_queue)
+		netdev_tx_reset_queue(ring->tx_queue);
+
 	if (ring->tx_info) {
 		kvfree(ring->tx_info);
 		ring->tx_info = NULL;
 	}
 
+	ring->xsk_pool = NULL;
+
 	mqnic_res_free(ring->interface->txq_res, ring->index);
 	ring->index = -1;
 }
@@ -173,23 +269,89 @@ bool mqnic_is_tx_ring_full(const struct mqnic_ring *ring)
 
 void mqnic_tx_read_cons_ptr(struct mqnic_ring *ring)
 {
-	ring->cons_ptr += ((ioread32(ring->hw_addr + MQNIC_QUEUE_PTR_REG) >> 16) - ring->cons_ptr) & MQNIC_QUEUE_PTR_MASK;
+	ring->cons_ptr += ((mqnic_read_hw_ptr(ring->ptr_shadow, ring->hw_addr + MQNIC_QUEUE_PTR_REG) >> 16) - ring->cons_ptr) & MQNIC_QUEUE_PTR_MASK;
 }
 
 void mqnic_tx_write_prod_ptr(struct mqnic_ring *ring)
 {
+	ring->db_prod_ptr = ring->prod_ptr;
 	iowrite32(MQNIC_QUEUE_CMD_SET_PROD_PTR | (ring->prod_ptr & MQNIC_QUEUE_PTR_MASK),
 			ring->hw_addr + MQNIC_QUEUE_CTRL_STATUS_REG);
 }
 
+// copy the most recently enqueued descriptor block into the push window;
+// the host ring stays authoritative, so a lost push only costs the fetch
+static void mqnic_tx_push_desc(struct mqnic_ring *ring, struct mqnic_desc *tx_desc,
+		struct sk_buff *skb)
+{
+	u8 __iomem *slot = ring->push_addr +
+			((ring->prod_ptr - 1) & ring->push_slot_mask) * ring->push_slot_size;
+	u32 len = 0;
+
+	if (IS_ALIGNED((unsigned long)skb->data, 8))
+		len = min_t(u32, ring->push_inline_len, skb_headlen(skb)) & ~7;
+
+	__iowrite64_copy(slot, tx_desc, ring->stride / 8);
+	if (len)
+		__iowrite64_copy(slot + ring->stride, skb->data, len / 8);
+
+	// flush write-combining buffers ahead of the uncached doorbell
+	wmb();
+}
+
 void mqnic_free_tx_desc(struct mqnic_ring *ring, int index, int napi_budget)
 {
 	struct mqnic_tx_info *tx_info = &ring->tx_info[index];
 	struct sk_buff *skb = tx_info->skb;
 	u32 i;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	// XSK buffers stay mapped by the pool; completion is reported in bulk
+	if (tx_info->xsk) {
+		tx_info->xsk = 0;
+		return;
+	}
+
+	if (tx_info->xdpf) {
+		dma_unmap_single(ring->dev, dma_unmap_addr(tx_info, dma_addr),
+				dma_unmap_len(tx_info, len), DMA_TO_DEVICE);
+		dma_unmap_addr_set(tx_info, dma_addr, 0);
+
+		if (napi_budget)
+			xdp_return_frame_rx_napi(tx_info->xdpf);
+		else
+			xdp_return_frame(tx_info->xdpf);
+		tx_info->xdpf = NULL;
+		return;
+	}
+#endif
+
+	// driver-segmented entry; header lives in the ring header buffer
+	if (tx_info->tso) {
+		for (i = 0; i < tx_info->frag_count; i++)
+			dma_unmap_single(ring->dev, tx_info->frags[i].dma_addr,
+					tx_info->frags[i].len, DMA_TO_DEVICE);
+		tx_info->frag_count = 0;
+		tx_info->tso = 0;
+
+		// only the last segment holds the skb
+		if (skb) {
+			napi_consume_skb(skb, napi_budget);
+			tx_info->skb = NULL;
+		}
+		return;
+	}
+
 	prefetchw(&skb->users);
 
+	// copied into the bounce slot at enqueue; nothing to unmap
+	if (tx_info->bounce) {
+		tx_info->bounce = 0;
+		napi_consume_skb(skb, napi_budget);
+		tx_info->skb = NULL;
+		return;
+	}
+
 	dma_unmap_single(ring->dev, dma_unmap_addr(tx_info, dma_addr),
 			dma_unmap_len(tx_info, len), DMA_TO_DEVICE);
 	dma_unmap_addr_set(tx_info, dma_addr, 0);
@@ -207,39 +369,149 @@ int mqnic_free_tx_buf(struct mqnic_ring *ring)
 {
 	u32 index;
 	int cnt = 0;
+	u32 xsk_frames = 0;
 
 	while (!mqnic_is_tx_ring_empty(ring)) {
 		index = ring->cons_ptr & ring->size_mask;
+		if (ring->tx_info[index].xsk)
+			xsk_frames++;
 		mqnic_free_tx_desc(ring, index, 0);
 		ring->cons_ptr++;
 		cnt++;
 	}
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	if (xsk_frames)
+		xsk_tx_completed(ring->xsk_pool, xsk_frames);
+#endif
+
 	return cnt;
 }
 
+void mqnic_tx_cpl_begin(struct mqnic_ring *ring, struct mqnic_tx_cpl_ctx *ctx)
+{
+	struct mqnic_priv *priv = ring->priv;
+
+	ctx->packets = 0;
+	ctx->bytes = 0;
+	ctx->xsk_frames = 0;
+	ctx->in_order = true;
+
+	ctx->lat = mqnic_lat_enabled(priv);
+	ctx->lat_offset = ctx->lat ? READ_ONCE(priv->lat_phc_offset) : 0;
+
+	// prefetch for BQL
+	if (ring->tx_queue)
+		netdev_txq_bql_complete_prefetchw(ring->tx_queue);
+
+	ctx->ring_cons_ptr = READ_ONCE(ring->cons_ptr);
+}
+
+void mqnic_tx_cpl(struct mqnic_ring *ring, struct mqnic_tx_cpl_ctx *ctx,
+		struct mqnic_cpl *cpl, int napi_budget)
+{
+	struct mqnic_if *interface = ring->interface;
+	struct mqnic_tx_info *tx_info;
+	struct skb_shared_hwtstamps hwts;
+	u32 ring_index;
+
+	ring_index = le16_to_cpu(cpl->index) & ring->size_mask;
+	tx_info = &ring->tx_info[ring_index];
+
+	// completions usually arrive in ring order; fetch the entry the next
+	// one most likely refers to while this one is freed
+	prefetchw(&ring->tx_info[(ring_index + 1) & ring->size_mask]);
+
+	// TX hardware timestamp
+	if (unlikely(tx_info->ts_requested)) {
+		netdev_dbg(ring->priv->ndev, "%s: TX TS requested", __func__);
+		hwts.hwtstamp = mqnic_read_cpl_ts(interface->mdev, cpl);
+		skb_tstamp_tx(tx_info->skb, &hwts);
+	}
+	if (tx_info->xsk)
+		ctx->xsk_frames++;
+
+	// doorbell to hardware completion, on the PHC timescale
+	if (unlikely(ctx->lat) && tx_info->db_ns) {
+		mqnic_lat_record(ring, ktime_to_ns(mqnic_read_cpl_ts(interface->mdev, cpl)) -
+				(s64)tx_info->db_ns - ctx->lat_offset);
+		tx_info->db_ns = 0;
+	}
+
+	// count skb length to match what BQL was told at enqueue
+	if (tx_info->skb) {
+		ctx->packets++;
+		ctx->bytes += tx_info->skb->len;
+	}
+
+	// free TX descriptor; napi_consume_skb batches the skb frees
+	mqnic_free_tx_desc(ring, ring_index, napi_budget);
+
+	// advance the ring consumer pointer directly while in order
+	if (ctx->in_order && ring_index == (ctx->ring_cons_ptr & ring->size_mask))
+		ctx->ring_cons_ptr++;
+	else
+		ctx->in_order = false;
+}
+
+void mqnic_tx_cpl_end(struct mqnic_ring *ring, struct mqnic_tx_cpl_ctx *ctx)
+{
+	struct mqnic_tx_info *tx_info;
+	u32 ring_cons_ptr = ctx->ring_cons_ptr;
+	u32 ring_index;
+
+	// process ring; picks up entries freed out of order, and stops at
+	// the first outstanding entry when everything completed in order.
+	// hardware that only completes in order never leaves holes to skip.
+	if (!(ring->interface->if_features & MQNIC_IF_FEATURE_CPL_IN_ORDER)) {
+		ring_index = ring_cons_ptr & ring->size_mask;
+
+		while (ring_cons_ptr != ring->prod_ptr) {
+			tx_info = &ring->tx_info[ring_index];
+
+			if (tx_info->skb || tx_info->xdpf || tx_info->xsk || tx_info->tso)
+				break;
+
+			ring_cons_ptr++;
+			ring_index = ring_cons_ptr & ring->size_mask;
+		}
+	}
+
+	// update consumer pointer
+	WRITE_ONCE(ring->cons_ptr, ring_cons_ptr);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	if (ctx->xsk_frames)
+		xsk_tx_completed(ring->xsk_pool, ctx->xsk_frames);
+#endif
+
+	// XDP TX queues and detached rings are not attached to a netdev queue
+	if (!ring->tx_queue)
+		return;
+
+	// BQL
+	netdev_tx_completed_queue(ring->tx_queue, ctx->packets, ctx->bytes);
+
+	// wake queue if it is stopped
+	if (netif_tx_queue_stopped(ring->tx_queue) && !mqnic_is_tx_ring_full(ring))
+		netif_tx_wake_queue(ring->tx_queue);
+}
+
 int mqnic_process_tx_cq(struct mqnic_cq *cq, int napi_budget)
 {
-	struct mqnic_if *interface = cq->interface;
 	struct mqnic_ring *tx_ring = cq->src_ring;
 	struct mqnic_priv *priv = tx_ring->priv;
-	struct mqnic_tx_info *tx_info;
+	struct mqnic_tx_cpl_ctx ctx;
 	struct mqnic_cpl *cpl;
-	struct skb_shared_hwtstamps hwts;
 	u32 cq_index;
 	u32 cq_cons_ptr;
-	u32 ring_index;
-	u32 ring_cons_ptr;
-	u32 packets = 0;
-	u32 bytes = 0;
 	int done = 0;
 	int budget = napi_budget;
 
 	if (unlikely(!priv || !priv->port_up))
 		return done;
 
-	// prefetch for BQL
-	netdev_txq_bql_complete_prefetchw(tx_ring->tx_queue);
+	mqnic_tx_cpl_begin(tx_ring, &ctx);
 
 	// process completion queue
 	cq_cons_ptr = cq->cons_ptr;
@@ -253,20 +525,9 @@ int mqnic_process_tx_cq(struct mqnic_cq *cq, int napi_budget)
 
 		dma_rmb();
 
-		ring_index = le16_to_cpu(cpl->index) & tx_ring->size_mask;
-		tx_info = &tx_ring->tx_info[ring_index];
-
-		// TX hardware timestamp
-		if (unlikely(tx_info->ts_requested)) {
-			netdev_dbg(priv->ndev, "%s: TX TS requested", __func__);
-			hwts.hwtstamp = mqnic_read_cpl_ts(interface->mdev, tx_ring, cpl);
-			skb_tstamp_tx(tx_info->skb, &hwts);
-		}
-		// free TX descriptor
-		mqnic_free_tx_desc(tx_ring, ring_index, napi_budget);
+		prefetch(cq->buf + ((cq_cons_ptr + 1) & cq->size_mask) * cq->stride);
 
-		packets++;
-		bytes += le16_to_cpu(cpl->len);
+		mqnic_tx_cpl(tx_ring, &ctx, cpl, napi_budget);
 
 		done++;
 
@@ -274,40 +535,90 @@ int mqnic_process_tx_cq(struct mqnic_cq *cq, int napi_budget)
 		cq_index = cq_cons_ptr & cq->size_mask;
 	}
 
-	// update CQ consumer pointer
+	// update CQ consumer pointer; written out once enough has been consumed
+	// or on the next arm
 	cq->cons_ptr = cq_cons_ptr;
-	mqnic_cq_write_cons_ptr(cq);
+	mqnic_cq_update_cons_ptr(cq);
 
-	// process ring
-	ring_cons_ptr = READ_ONCE(tx_ring->cons_ptr);
-	ring_index = ring_cons_ptr & tx_ring->size_mask;
+	mqnic_tx_cpl_end(tx_ring, &ctx);
 
-	while (ring_cons_ptr != tx_ring->prod_ptr) {
-		tx_info = &tx_ring->tx_info[ring_index];
+	trace_mqnic_tx_cq(cq, done, napi_budget);
 
-		if (tx_info->skb)
-			break;
+	return done;
+}
 
-		ring_cons_ptr++;
-		ring_index = ring_cons_ptr & tx_ring->size_mask;
-	}
+void mqnic_tx_irq(struct mqnic_cq *cq)
+{
+	cq->event_ctr++;
+	napi_schedule_irqoff(mqnic_cq_napi(cq));
+}
 
-	// update consumer pointer
-	WRITE_ONCE(tx_ring->cons_ptr, ring_cons_ptr);
+#ifdef MQNIC_DIM
+static void mqnic_tx_dim_update(struct mqnic_cq *cq)
+{
+	struct mqnic_ring *ring = cq->src_ring;
+	struct dim_sample sample = {};
 
-	// BQL
-	//netdev_tx_completed_queue(tx_ring->tx_queue, packets, bytes);
+	dim_update_sample(cq->event_ctr, u64_stats_read(&ring->packets), u64_stats_read(&ring->bytes), &sample);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+	net_dim(&cq->dim, &sample);
+#else
+	net_dim(&cq->dim, sample);
+#endif
+}
 
-	// wake queue if it is stopped
-	if (netif_tx_queue_stopped(tx_ring->tx_queue) && !mqnic_is_tx_ring_full(tx_ring))
-		netif_tx_wake_queue(tx_ring->tx_queue);
+void mqnic_tx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct mqnic_cq *cq = container_of(dim, struct mqnic_cq, dim);
+	struct dim_cq_moder moder;
+
+	moder = net_dim_get_tx_moderation(dim->mode, dim->profile_ix);
+	mqnic_cq_set_coalesce(cq, moder.usec, moder.pkts);
+
+	dim->state = DIM_START_MEASURE;
+}
+#endif
+
+// process completions and pending XSK transmit; returns budget while
+// there is more to do
+int mqnic_reap_tx_cq(struct mqnic_cq *cq, int budget)
+{
+	u64 start = 0;
+	int done;
+
+	if (static_branch_unlikely(&mqnic_bench_key))
+		start = get_cycles();
+
+	done = mqnic_process_tx_cq(cq, budget);
+
+	if (static_branch_unlikely(&mqnic_bench_key))
+		mqnic_bench_account(cq->src_ring, start, done);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+	// transmit from the XSK TX ring, keep polling while it has more
+	if (cq->src_ring->xsk_pool && !mqnic_xsk_xmit(cq->src_ring, budget))
+		done = budget;
+#endif
+
+	if (done == budget) {
+		u64_stats_update_begin(&cq->src_ring->cpl_syncp);
+		u64_stats_inc(&cq->src_ring->napi_exhausted);
+		u64_stats_update_end(&cq->src_ring->cpl_syncp);
+	}
 
 	return done;
 }
 
-void mqnic_tx_irq(struct mqnic_cq *cq)
+// called once the NAPI polling the CQ has completed
+void mqnic_complete_tx_cq(struct mqnic_cq *cq, int done)
 {
-	napi_schedule_irqoff(&cq->napi);
+#ifdef MQNIC_DIM
+	if (cq->src_ring->priv->tx_dim_enabled)
+		mqnic_tx_dim_update(cq);
+#endif
+
+	mqnic_rearm_cq(cq, done);
 }
 
 int mqnic_poll_tx_cq(struct napi_struct *napi, int budget)
@@ -315,14 +626,17 @@ int mqnic_poll_tx_cq(struct napi_struct *napi, int budget)
 	struct mqnic_cq *cq = container_of(napi, struct mqnic_cq, napi);
 	int done;
 
-	done = mqnic_process_tx_cq(cq, budget);
+	done = mqnic_reap_tx_cq(cq, budget);
 
 	if (done == budget)
 		return done;
 
-	napi_complete(napi);
+	// leave the CQ unarmed while a busy poller owns the NAPI or hard IRQs
+	// are deferred; the core calls back into poll when it lets go
+	if (!napi_complete_done(napi, done))
+		return done;
 
-	mqnic_arm_cq(cq);
+	mqnic_complete_tx_cq(cq, done);
 
 	return done;
 }
@@ -339,6 +653,7 @@ static bool mqnic_map_skb(struct mqnic_ring *ring, struct mqnic_tx_info *tx_info
 	// update tx_info
 	tx_info->skb = skb;
 	tx_info->frag_count = 0;
+	tx_info->bounce = 0;
 
 	for (i = 0; i < shinfo->nr_frags; i++) {
 		frag = &shinfo->frags[i];
@@ -396,6 +711,366 @@ map_error:
 	return false;
 }
 
+// checksum command for the given start and field offset; false if the
+// hardware cannot reach them
+static bool mqnic_tx_csum_cmd(u32 if_features, u32 start, u32 offset, u16 *cmd)
+{
+	if (if_features & MQNIC_IF_FEATURE_TX_CSUM_EXT) {
+		if (start > MQNIC_TX_CSUM_EXT_START_MAX || offset > MQNIC_TX_CSUM_EXT_OFFSET_MAX ||
+				(start | offset) & 1)
+			return false;
+
+		*cmd = MQNIC_TX_CSUM_CMD_ENABLE | ((offset / 2) << MQNIC_TX_CSUM_EXT_OFFSET_SHIFT) | (start / 2);
+		return true;
+	}
+
+	if (start > 255 || offset > 127)
+		return false;
+
+	*cmd = MQNIC_TX_CSUM_CMD_ENABLE | (offset << 8) | start;
+	return true;
+}
+
+// headers replicated into each segment, through the inner TCP header of a
+// tunnel or the UDP header of a USO datagram
+static u32 mqnic_tx_tso_hdr_len(const struct sk_buff *skb)
+{
+	if (skb->encapsulation)
+		return skb_inner_transport_offset(skb) + inner_tcp_hdrlen(skb);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4)
+		return skb_transport_offset(skb) + sizeof(struct udphdr);
+#endif
+
+	return skb_transport_offset(skb) + tcp_hdrlen(skb);
+}
+
+// small frames are copied whole into the slot that belongs to this ring entry
+static void mqnic_bounce_skb(struct mqnic_ring *ring, u32 index, struct mqnic_tx_info *tx_info,
+		struct mqnic_desc *tx_desc, struct sk_buff *skb)
+{
+	u32 offset = index * MQNIC_TX_COPYBREAK_MAX;
+	u32 i;
+
+	skb_copy_bits(skb, 0, ring->tx_bounce + offset, skb->len);
+
+	tx_desc[0].len = cpu_to_le32(skb->len);
+	tx_desc[0].addr = cpu_to_le64(ring->tx_bounce_dma_addr + offset);
+
+	for (i = 0; i < ring->desc_block_size - 1; i++) {
+		tx_desc[i + 1].len = 0;
+		tx_desc[i + 1].addr = 0;
+	}
+
+	tx_info->skb = skb;
+	tx_info->frag_count = 0;
+	tx_info->bounce = 1;
+}
+
+// hardware launches the block at the given PHC time, within one second
+static void mqnic_tx_set_launch_time(struct mqnic_ring *ring, struct mqnic_desc *tx_desc,
+		struct sk_buff *skb, bool launch_time)
+{
+	struct timespec64 ts;
+	u32 val = 0;
+
+	if (!(ring->interface->if_features & MQNIC_IF_FEATURE_TX_LAUNCH_TIME) || ring->desc_block_size < 2)
+		return;
+
+	if (launch_time && skb->tstamp) {
+		ts = ktime_to_timespec64(skb->tstamp);
+		val = MQNIC_TX_LAUNCH_TIME_ENABLE | (ts.tv_nsec & MQNIC_TX_LAUNCH_TIME_NS_MASK);
+		if (ts.tv_sec & 1)
+			val |= MQNIC_TX_LAUNCH_TIME_SEC_LSB;
+	}
+
+	// always written, the slot may hold a stale launch time
+	tx_desc[1].tx_time.launch_time = cpu_to_le32(val);
+}
+
+// VLAN insert word, carried in the third descriptor of a TX block
+static void mqnic_tx_set_vlan(struct mqnic_ring *ring, struct mqnic_desc *tx_desc,
+		struct sk_buff *skb)
+{
+	u16 cmd = 0;
+	u16 tci = 0;
+
+	if (!(ring->interface->if_features & MQNIC_IF_FEATURE_VLAN_TX) || ring->desc_block_size < 3)
+		return;
+
+	if (skb_vlan_tag_present(skb)) {
+		cmd = MQNIC_TX_VLAN_CMD_INSERT;
+		tci = skb_vlan_tag_get(skb);
+	}
+
+	// always written, the slot may hold a stale tag
+	tx_desc[2].tx_vlan.vlan_tci = cpu_to_le16(tci);
+	tx_desc[2].tx_vlan.vlan_cmd = cpu_to_le16(cmd);
+}
+
+// one-step timestamp word, carried in the fourth descriptor of a TX block
+static void mqnic_tx_set_ts(struct mqnic_ring *ring, struct mqnic_desc *tx_desc,
+		u16 ts_offset, u16 ts_cmd)
+{
+	if (!(ring->interface->if_features & MQNIC_IF_FEATURE_PTP_ONESTEP) || ring->desc_block_size < 4)
+		return;
+
+	// always written, the slot may hold a stale insert
+	tx_desc[3].tx_ts.ts_offset = cpu_to_le16(ts_offset);
+	tx_desc[3].tx_ts.ts_cmd = cpu_to_le16(ts_cmd);
+}
+
+#ifdef MQNIC_PTP_ONESTEP
+/*
+ * One-step Sync: the MAC writes the departure time into originTimestamp, so
+ * the frame gets no TX timestamp of its own and needs no Follow_Up.  The
+ * field is zeroed here, with any UDP checksum already computed over it
+ * adjusted to match.  Anything that is not a one-step Sync, or that cannot
+ * be made writable, is timestamped two-step as usual.
+ */
+static bool mqnic_tx_onestep_sync(struct sk_buff *skb, u16 *ts_offset, u16 *ts_cmd)
+{
+	struct ptp_header *hdr;
+	struct udphdr *uh = NULL;
+	unsigned int offset;
+	unsigned int type;
+	u8 *ts;
+
+	type = ptp_classify_raw(skb);
+	if (type == PTP_CLASS_NONE)
+		return false;
+
+	hdr = ptp_parse_header(skb, type);
+	if (!hdr || ptp_get_msgtype(hdr, type) != PTP_MSGTYPE_SYNC)
+		return false;
+
+	// twoStepFlag, the time follows in a Follow_Up
+	if (hdr->flag_field[0] & 0x02)
+		return false;
+
+	offset = (u8 *)hdr - skb->data;
+
+	// originTimestamp, right after the common header
+	if (offset + sizeof(*hdr) + 10 > skb->len || offset > MQNIC_TX_TS_CMD_CSUM_MASK * 2)
+		return false;
+
+	if (skb_ensure_writable(skb, offset + sizeof(*hdr) + 10))
+		return false;
+
+	hdr = (struct ptp_header *)(skb->data + offset);
+	ts = (u8 *)(hdr + 1);
+
+	if ((type & PTP_CLASS_PMASK) != PTP_CLASS_L2)
+		uh = (struct udphdr *)((u8 *)hdr - sizeof(*uh));
+
+	if (memchr_inv(ts, 0, 10)) {
+		if (uh && uh->check && skb->ip_summed != CHECKSUM_PARTIAL) {
+			csum_replace_by_diff(&uh->check,
+					(__force __wsum)~(__force u32)csum_partial(ts, 10, 0));
+			if (!uh->check)
+				uh->check = CSUM_MANGLED_0;
+		}
+
+		memset(ts, 0, 10);
+	}
+
+	*ts_offset = offset;
+	*ts_cmd = MQNIC_TX_TS_CMD_INSERT;
+
+	// a zero UDP checksum over IPv4 stays zero
+	if (uh && (uh->check || skb->ip_summed == CHECKSUM_PARTIAL))
+		*ts_cmd |= ((u8 *)&uh->check - skb->data) / 2;
+
+	return true;
+}
+#endif
+
+#ifdef MQNIC_SW_TSO
+static bool mqnic_tso_fits_desc_block(const struct sk_buff *skb, u32 hdr_len, u32 max_bufs)
+{
+	const struct skb_shared_info *shinfo = skb_shinfo(skb);
+	u32 seg_left = shinfo->gso_size;
+	u32 bufs = 0;
+	u32 len;
+	int i;
+
+	// count payload buffers per segment, walking the head then the frags
+	for (i = -1; i < shinfo->nr_frags; i++) {
+		len = i < 0 ? skb_headlen(skb) - hdr_len : skb_frag_size(&shinfo->frags[i]);
+
+		while (len) {
+			u32 size = min(len, seg_left);
+
+			if (++bufs > max_bufs)
+				return false;
+
+			len -= size;
+			seg_left -= size;
+
+			if (!seg_left) {
+				seg_left = shinfo->gso_size;
+				bufs = 0;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void mqnic_tso_update_csum(struct sk_buff *skb, u8 *hdr, u32 hdr_len, u32 data_len)
+{
+	u8 *l4h = hdr + skb_transport_offset(skb);
+	u32 l4_len = hdr_len - skb_transport_offset(skb) + data_len;
+	u8 proto = IPPROTO_TCP;
+	__sum16 *check = &((struct tcphdr *)l4h)->check;
+
+	if (!skb_is_gso_tcp(skb)) {
+		proto = IPPROTO_UDP;
+		check = &((struct udphdr *)l4h)->check;
+	}
+
+	// seed the hardware checksum with the per-segment pseudo header
+	if (vlan_get_protocol(skb) == htons(ETH_P_IPV6)) {
+		struct ipv6hdr *ip6h = (struct ipv6hdr *)(hdr + skb_network_offset(skb));
+
+		*check = ~csum_ipv6_magic(&ip6h->saddr, &ip6h->daddr, l4_len, proto, 0);
+	} else {
+		struct iphdr *iph = (struct iphdr *)(hdr + skb_network_offset(skb));
+
+		ip_send_check(iph);
+		*check = ~csum_tcpudp_magic(iph->saddr, iph->daddr, l4_len, proto, 0);
+	}
+}
+
+static bool mqnic_tx_tso(struct mqnic_ring *ring, struct sk_buff *skb, int ts_requested,
+		bool launch_time)
+{
+	struct mqnic_tx_info *tx_info = NULL;
+	struct mqnic_desc *tx_desc;
+	u32 start_ptr = ring->prod_ptr;
+	u16 csum_cmd = 0;
+	u32 index;
+	u32 i;
+	int hdr_len;
+	int total_len;
+	dma_addr_t dma_addr;
+	struct tso_t tso;
+
+	hdr_len = mqnic_tx_tso_hdr_len(skb);
+
+	if (!mqnic_tso_fits_desc_block(skb, hdr_len, ring->desc_block_size - 1)) {
+		// payload too fragmented for the descriptor block; linearize
+		if (skb_linearize(skb))
+			return false;
+	}
+
+	// range checked by mqnic_features_check()
+	mqnic_tx_csum_cmd(ring->interface->if_features, skb_checksum_start_offset(skb),
+			skb->csum_offset, &csum_cmd);
+
+	hdr_len = tso_start(skb, &tso);
+	total_len = skb->len - hdr_len;
+
+	while (total_len > 0) {
+		int data_left = min_t(int, skb_shinfo(skb)->gso_size, total_len);
+		u8 *hdr;
+
+		total_len -= data_left;
+
+		index = ring->prod_ptr & ring->size_mask;
+		tx_desc = (struct mqnic_desc *)(ring->buf + index * ring->stride);
+		tx_info = &ring->tx_info[index];
+
+		tx_info->skb = NULL;
+		tx_info->frag_count = 0;
+		tx_info->ts_requested = 0;
+		tx_info->tso = 1;
+		dma_unmap_len_set(tx_info, len, 0);
+
+		// build segment header
+		hdr = ring->tso_hdrs + index * TSO_HEADER_SIZE;
+		tso_build_hdr(skb, hdr, &tso, data_left, total_len == 0);
+		mqnic_tso_update_csum(skb, hdr, hdr_len, data_left);
+
+		tx_desc[0].tx.tso_mss = 0;
+		tx_desc[0].tx.csum_cmd = cpu_to_le16(csum_cmd);
+		tx_desc[0].len = cpu_to_le32(hdr_len);
+		tx_desc[0].addr = cpu_to_le64(ring->tso_hdrs_dma_addr + index * TSO_HEADER_SIZE);
+
+		// map segment payload
+		for (i = 0; data_left > 0; i++) {
+			int size = min_t(int, tso.size, data_left);
+
+			dma_addr = dma_map_single(ring->dev, tso.data, size, DMA_TO_DEVICE);
+			if (unlikely(dma_mapping_error(ring->dev, dma_addr))) {
+				ring->prod_ptr++;
+				goto map_error;
+			}
+
+			tx_desc[i + 1].len = cpu_to_le32(size);
+			tx_desc[i + 1].addr = cpu_to_le64(dma_addr);
+
+			tx_info->frag_count = i + 1;
+			tx_info->frags[i].len = size;
+			tx_info->frags[i].dma_addr = dma_addr;
+
+			data_left -= size;
+			tso_build_data(skb, &tso, size);
+		}
+
+		for (; i < ring->desc_block_size - 1; i++) {
+			tx_desc[i + 1].len = 0;
+			tx_desc[i + 1].addr = 0;
+		}
+
+		mqnic_tx_set_launch_time(ring, tx_desc, skb, launch_time);
+		mqnic_tx_set_vlan(ring, tx_desc, skb);
+		mqnic_tx_set_ts(ring, tx_desc, 0, 0);
+
+		ring->prod_ptr++;
+	}
+
+	// last segment completes the skb
+	tx_info->skb = skb;
+	tx_info->ts_requested = ts_requested;
+
+	return true;
+
+map_error:
+	dev_err(ring->dev, "%s: DMA mapping failed", __func__);
+
+	// unwind segments queued so far
+	while (ring->prod_ptr != start_ptr) {
+		ring->prod_ptr--;
+		mqnic_free_tx_desc(ring, ring->prod_ptr & ring->size_mask, 0);
+	}
+
+	return false;
+}
+#endif
+
+netdev_features_t mqnic_features_check(struct sk_buff *skb, struct net_device *ndev,
+		netdev_features_t features)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	u16 csum_cmd;
+
+	if (!skb_is_gso(skb))
+		return features;
+
+	// driver-side segmentation has no tunnel support
+	if (skb->encapsulation && !(priv->if_features & MQNIC_IF_FEATURE_TSO_TUNNEL))
+		return features & ~NETIF_F_GSO_MASK;
+
+	// header must fit in the checksum command and the TSO header buffer
+	if (!mqnic_tx_csum_cmd(priv->if_features, skb_checksum_start_offset(skb), skb->csum_offset, &csum_cmd) ||
+			mqnic_tx_tso_hdr_len(skb) > MQNIC_TX_TSO_MAX_HDR_LEN)
+		features &= ~NETIF_F_GSO_MASK;
+
+	return features;
+}
+
 netdev_tx_t mqnic_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 {
 	struct skb_shared_info *shinfo = skb_shinfo(skb);
@@ -405,17 +1080,25 @@ netdev_tx_t mqnic_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 	struct mqnic_desc *tx_desc;
 	int ring_index;
 	u32 index;
+	bool launch_time;
 	bool stop_queue;
+	bool xmit_more;
+	bool ring_db;
+	bool onestep = false;
+	u16 ts_offset = 0;
+	u16 ts_cmd = 0;
 	u32 cons_ptr;
+	u32 len;
 
 	if (unlikely(!priv->port_up))
 		goto tx_drop;
 
 	ring_index = skb_get_queue_mapping(skb);
 
-	rcu_read_lock();
-	ring = radix_tree_lookup(&priv->txq_table, ring_index);
-	rcu_read_unlock();
+	// skb->tstamp is a launch time from SO_TXTIME on queues offloaded to ETF
+	launch_time = test_bit(ring_index, priv->txq_launch_time);
+
+	ring = rcu_dereference_bh(priv->txq_table[ring_index]);
 
 	if (unlikely(!ring))
 		// unknown TX queue
@@ -424,7 +1107,6 @@ netdev_tx_t mqnic_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 	if (skb->len < ETH_HLEN) {
 		netdev_warn(priv->ndev, "%s: ring %d dropping short frame (length %d)",
 				__func__, ring->index, skb->len);
-		ring->dropped_packets++;
 		goto tx_drop_count;
 	}
 
@@ -439,22 +1121,46 @@ netdev_tx_t mqnic_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 
 	tx_info = &ring->tx_info[index];
 
+#ifdef MQNIC_PTP_ONESTEP
+	// one-step Sync, timestamped in-line by the MAC
+	if (unlikely(priv->if_features & MQNIC_IF_FEATURE_PTP_ONESTEP && shinfo->tx_flags & SKBTX_HW_TSTAMP &&
+			READ_ONCE(priv->hwts_config.tx_type) == HWTSTAMP_TX_ONESTEP_SYNC &&
+			ring->desc_block_size >= 4))
+		onestep = mqnic_tx_onestep_sync(skb, &ts_offset, &ts_cmd);
+
+	// making the header writable may have moved it
+	shinfo = skb_shinfo(skb);
+#endif
+
 	// TX hardware timestamp
 	tx_info->ts_requested = 0;
-	if (unlikely(priv->if_features & MQNIC_IF_FEATURE_PTP_TS && shinfo->tx_flags & SKBTX_HW_TSTAMP)) {
+	if (unlikely(priv->if_features & MQNIC_IF_FEATURE_PTP_TS && shinfo->tx_flags & SKBTX_HW_TSTAMP &&
+			!onestep)) {
 		netdev_dbg(ndev, "%s: TX TS requested", __func__);
 		shinfo->tx_flags |= SKBTX_IN_PROGRESS;
 		tx_info->ts_requested = 1;
 	}
 
+#ifdef MQNIC_SW_TSO
+	// no hardware TSO; segment in the driver, sharing payload buffers
+	if (skb_is_gso(skb) && !(priv->if_features & MQNIC_IF_FEATURE_TSO)) {
+		if (!mqnic_tx_tso(ring, skb, tx_info->ts_requested, launch_time))
+			goto tx_drop_count;
+
+		goto tx_enqueued;
+	}
+#endif
+
 	// TX hardware checksum
 	if (skb->ip_summed == CHECKSUM_PARTIAL) {
 		unsigned int csum_start = skb_checksum_start_offset(skb);
 		unsigned int csum_offset = skb->csum_offset;
+		u16 csum_cmd;
 
-		if (csum_start > 255 || csum_offset > 127) {
-			netdev_info(ndev, "%s: Hardware checksum fallback start %d offset %d",
-					__func__, csum_start, csum_offset);
+		if (!mqnic_tx_csum_cmd(priv->if_features, csum_start, csum_offset, &csum_cmd)) {
+			if (net_ratelimit())
+				netdev_info(ndev, "%s: Hardware checksum fallback start %d offset %d",
+						__func__, csum_start, csum_offset);
 
 			// offset out of range, fall back on software checksum
 			if (skb_checksum_help(skb)) {
@@ -463,49 +1169,96 @@ netdev_tx_t mqnic_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 			}
 			tx_desc->tx.csum_cmd = 0;
 		} else {
-			tx_desc->tx.csum_cmd = cpu_to_le16(0x8000 | (csum_offset << 8) | (csum_start));
+			tx_desc->tx.csum_cmd = cpu_to_le16(csum_cmd);
 		}
 	} else {
 		tx_desc->tx.csum_cmd = 0;
 	}
 
-	if (shinfo->nr_frags > ring->desc_block_size - 1 || (skb->data_len && skb->data_len < 32)) {
-		// too many frags or very short data portion; linearize
-		if (skb_linearize(skb))
+	// TX segmentation offload
+	if (skb_is_gso(skb))
+		tx_desc->tx.tso_mss = cpu_to_le16(shinfo->gso_size);
+	else
+		tx_desc->tx.tso_mss = 0;
+
+	if (!skb_is_gso(skb) && skb->len <= READ_ONCE(priv->tx_copybreak)) {
+		// small frame; copy instead of mapping, gathering any frags
+		mqnic_bounce_skb(ring, index, tx_info, tx_desc, skb);
+	} else {
+		if (shinfo->nr_frags > ring->desc_block_size - 1 || (skb->data_len && skb->data_len < 32)) {
+			// too many frags or very short data portion; linearize
+			if (skb_linearize(skb))
+				goto tx_drop_count;
+		}
+
+		// map skb
+		if (!mqnic_map_skb(ring, tx_info, tx_desc, skb))
+			// map failed
 			goto tx_drop_count;
 	}
 
-	// map skb
-	if (!mqnic_map_skb(ring, tx_info, tx_desc, skb))
-		// map failed
-		goto tx_drop_count;
-
-	// count packet
-	ring->packets++;
-	ring->bytes += skb->len;
+	mqnic_tx_set_launch_time(ring, tx_desc, skb, launch_time);
+	mqnic_tx_set_vlan(ring, tx_desc, skb);
+	mqnic_tx_set_ts(ring, tx_desc, ts_offset, ts_cmd);
 
 	// enqueue
 	ring->prod_ptr++;
 
+#ifdef MQNIC_SW_TSO
+tx_enqueued:
+#endif
+	// count packet
+	len = skb->len;
+	stop_queue = mqnic_is_tx_ring_full(ring);
+
+	u64_stats_update_begin(&ring->syncp);
+	if (skb_is_gso(skb)) {
+		// count headers replicated into each segment
+		u64_stats_add(&ring->packets, shinfo->gso_segs);
+		u64_stats_add(&ring->bytes, len + (shinfo->gso_segs - 1) * mqnic_tx_tso_hdr_len(skb));
+	} else {
+		u64_stats_inc(&ring->packets);
+		u64_stats_add(&ring->bytes, len);
+	}
+	if (unlikely(stop_queue))
+		u64_stats_inc(&ring->queue_stops);
+	u64_stats_update_end(&ring->syncp);
+
 	skb_tx_timestamp(skb);
 
-	stop_queue = mqnic_is_tx_ring_full(ring);
 	if (unlikely(stop_queue)) {
 		netdev_dbg(ndev, "%s: TX ring %d full", __func__, ring_index);
 		netif_tx_stop_queue(ring->tx_queue);
 	}
 
-	// BQL
-	//netdev_tx_sent_queue(ring->tx_queue, tx_info->len);
-	//__netdev_tx_sent_queue(ring->tx_queue, tx_info->len, skb->xmit_more);
-
-	// enqueue on NIC
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
-	if (unlikely(!netdev_xmit_more() || stop_queue)) {
+	xmit_more = netdev_xmit_more();
+#else
+	xmit_more = skb->xmit_more;
+#endif
+
+	// BQL
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0)
+	ring_db = __netdev_tx_sent_queue(ring->tx_queue, len, xmit_more);
 #else
-	if (unlikely(!skb->xmit_more || stop_queue)) {
+	netdev_tx_sent_queue(ring->tx_queue, len);
+	ring_db = !xmit_more || netif_xmit_stopped(ring->tx_queue);
 #endif
+
+	// bound the number of descriptors waiting on a deferred doorbell
+	if (ring->prod_ptr - ring->db_prod_ptr >= MQNIC_TX_DOORBELL_BATCH)
+		ring_db = true;
+
+	trace_mqnic_tx_xmit(ring, len, ring_db || stop_queue);
+
+	// enqueue on NIC
+	if (ring_db || stop_queue) {
+		if (mqnic_lat_enabled(priv))
+			mqnic_lat_tx_doorbell(ring);
 		dma_wmb();
+		// lone descriptor behind the doorbell; push it to skip the fetch
+		if (ring->push_addr && ring->prod_ptr - ring->db_prod_ptr == 1)
+			mqnic_tx_push_desc(ring, tx_desc, skb);
 		mqnic_tx_write_prod_ptr(ring);
 	}
 
@@ -522,7 +1275,9 @@ netdev_tx_t mqnic_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 	return NETDEV_TX_OK;
 
 tx_drop_count:
-	ring->dropped_packets++;
+	u64_stats_update_begin(&ring->syncp);
+	u64_stats_inc(&ring->dropped_packets);
+	u64_stats_update_end(&ring->syncp);
 tx_drop:
 	dev_kfree_skb_any(skb);
 	return NETDEV_TX_OK;
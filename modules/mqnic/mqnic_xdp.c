@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#include <linux/version.h>
+#include <linux/bpf_trace.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+
+int mqnic_xdp_xmit_frame(struct mqnic_ring *ring, struct xdp_frame *xdpf)
+{
+	struct mqnic_tx_info *tx_info;
+	struct mqnic_desc *tx_desc;
+	dma_addr_t dma_addr;
+	u32 index;
+	u32 i;
+
+	if (unlikely(mqnic_is_tx_ring_full(ring)))
+		return -ENOSPC;
+
+	index = ring->prod_ptr & ring->size_mask;
+
+	tx_desc = (struct mqnic_desc *)(ring->buf + index * ring->stride);
+
+	tx_info = &ring->tx_info[index];
+
+	// map frame
+	dma_addr = dma_map_single(ring->dev, xdpf->data, xdpf->len, DMA_TO_DEVICE);
+
+	if (unlikely(dma_mapping_error(ring->dev, dma_addr)))
+		return -ENOMEM;
+
+	// write descriptor
+	tx_desc[0].tx.tso_mss = 0;
+	tx_desc[0].tx.csum_cmd = 0;
+	tx_desc[0].len = cpu_to_le32(xdpf->len);
+	tx_desc[0].addr = cpu_to_le64(dma_addr);
+
+	for (i = 1; i < ring->desc_block_size; i++) {
+		tx_desc[i].len = 0;
+		tx_desc[i].addr = 0;
+	}
+
+	// the slot may hold a stale VLAN or timestamp insert from an skb
+	if (ring->desc_block_size > 2)
+		tx_desc[2].tx_vlan.vlan_cmd = 0;
+	if (ring->desc_block_size > 3)
+		tx_desc[3].tx_ts.ts_cmd = 0;
+
+	// update tx_info
+	tx_info->skb = NULL;
+	tx_info->xdpf = xdpf;
+	tx_info->frag_count = 0;
+	tx_info->ts_requested = 0;
+	dma_unmap_addr_set(tx_info, dma_addr, dma_addr);
+	dma_unmap_len_set(tx_info, len, xdpf->len);
+
+	// count packet
+	u64_stats_update_begin(&ring->syncp);
+	u64_stats_inc(&ring->packets);
+	u64_stats_add(&ring->bytes, xdpf->len);
+	u64_stats_update_end(&ring->syncp);
+
+	// enqueue
+	ring->prod_ptr++;
+
+	return 0;
+}
+
+void mqnic_xdp_flush(struct mqnic_ring *ring)
+{
+	spin_lock(&ring->xdp_tx_lock);
+
+	// enqueue on NIC
+	dma_wmb();
+	mqnic_tx_write_prod_ptr(ring);
+
+	spin_unlock(&ring->xdp_tx_lock);
+}
+
+int mqnic_xdp_xmit(struct net_device *ndev, int n, struct xdp_frame **frames, u32 flags)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *ring;
+	int k;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	if (unlikely(!priv->port_up || !priv->xdp_txq_count))
+		return -ENETDOWN;
+
+	ring = priv->xdp_txq[smp_processor_id() % priv->xdp_txq_count];
+
+	spin_lock(&ring->xdp_tx_lock);
+
+	for (k = 0; k < n; k++) {
+		if (mqnic_xdp_xmit_frame(ring, frames[k]))
+			break;
+	}
+
+	if (flags & XDP_XMIT_FLUSH) {
+		// enqueue on NIC
+		dma_wmb();
+		mqnic_tx_write_prod_ptr(ring);
+	}
+
+	spin_unlock(&ring->xdp_tx_lock);
+
+	return k;
+}
+
+u32 mqnic_run_xdp(struct mqnic_ring *rx_ring, struct bpf_prog *prog, struct xdp_buff *xdp)
+{
+	struct mqnic_priv *priv = rx_ring->priv;
+	struct mqnic_ring *tx_ring;
+	struct xdp_frame *xdpf;
+	u32 act;
+	int ret;
+
+	act = bpf_prog_run_xdp(prog, xdp);
+
+	switch (act) {
+	case XDP_PASS:
+		return MQNIC_XDP_PASS;
+	case XDP_TX:
+		xdpf = xdp_convert_buff_to_frame(xdp);
+		if (unlikely(!xdpf))
+			goto xdp_abort;
+
+		tx_ring = priv->xdp_txq[rx_ring->queue_index % priv->xdp_txq_count];
+
+		spin_lock(&tx_ring->xdp_tx_lock);
+		ret = mqnic_xdp_xmit_frame(tx_ring, xdpf);
+		spin_unlock(&tx_ring->xdp_tx_lock);
+
+		if (unlikely(ret)) {
+			// zero-copy buffers are released when converted to a frame,
+			// so there is nothing left for the caller to free
+			if (rx_ring->xsk_pool) {
+				xdp_return_frame_rx_napi(xdpf);
+				trace_xdp_exception(priv->ndev, prog, act);
+				return MQNIC_XDP_TX;
+			}
+			goto xdp_abort;
+		}
+
+		return MQNIC_XDP_TX;
+	case XDP_REDIRECT:
+		if (unlikely(xdp_do_redirect(priv->ndev, xdp, prog)))
+			goto xdp_abort;
+
+		return MQNIC_XDP_REDIR;
+	default:
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+		bpf_warn_invalid_xdp_action(priv->ndev, prog, act);
+#else
+		bpf_warn_invalid_xdp_action(act);
+#endif
+		fallthrough;
+	case XDP_ABORTED:
+xdp_abort:
+		trace_xdp_exception(priv->ndev, prog, act);
+		fallthrough;
+	case XDP_DROP:
+		return MQNIC_XDP_CONSUMED;
+	}
+}
+
+static int mqnic_xdp_setup(struct net_device *ndev, struct bpf_prog *prog,
+		struct netlink_ext_ack *extack)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	struct bpf_prog *old_prog;
+	bool restart;
+	int ret = 0;
+
+	if (prog && ndev->mtu > MQNIC_XDP_MAX_MTU) {
+		NL_SET_ERR_MSG_MOD(extack, "MTU too large for XDP");
+		return -EINVAL;
+	}
+
+	// station RX rings deliver straight to the macvlan, past the program
+	if (prog && priv->fwd_count) {
+		NL_SET_ERR_MSG_MOD(extack, "XDP not supported with offloaded macvlans");
+		return -EBUSY;
+	}
+
+	mutex_lock(&mdev->state_lock);
+
+	// RX buffer layout and XDP TX queues only change on attach or detach
+	restart = priv->port_up && !priv->xdp_prog != !prog;
+
+	if (restart)
+		mqnic_stop_port(ndev);
+
+	old_prog = xchg(&priv->xdp_prog, prog);
+
+	if (restart) {
+		ret = mqnic_start_port(ndev);
+		if (ret) {
+			netdev_err(ndev, "Failed to start port with XDP program on interface %d: %d",
+					priv->interface->index, ret);
+			NL_SET_ERR_MSG_MOD(extack, "Failed to allocate XDP resources");
+
+			// revert to previous program
+			xchg(&priv->xdp_prog, old_prog);
+			old_prog = NULL;
+			mqnic_start_port(ndev);
+		}
+	}
+
+	mutex_unlock(&mdev->state_lock);
+
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return ret;
+}
+
+int mqnic_xdp(struct net_device *ndev, struct netdev_bpf *bpf)
+{
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return mqnic_xdp_setup(ndev, bpf->prog, bpf->extack);
+	case XDP_SETUP_XSK_POOL:
+		return mqnic_xsk_pool_setup(ndev, bpf->xsk.pool, bpf->xsk.queue_id);
+	default:
+		return -EINVAL;
+	}
+}
+
+#endif
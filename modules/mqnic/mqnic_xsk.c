@@ -0,0 +1,441 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include "mqnic.h"
+
+#include <linux/version.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 13, 0)
+
+#include <net/xdp_sock_drv.h>
+
+static int mqnic_xsk_pool_enable(struct net_device *ndev,
+		struct xsk_buff_pool *pool, u16 qid)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	bool restart;
+	int ret;
+
+	if (qid >= priv->rxq_count)
+		return -EINVAL;
+
+	ret = xsk_pool_dma_map(pool, priv->dev, 0);
+	if (ret)
+		return ret;
+
+	mutex_lock(&mdev->state_lock);
+
+	restart = priv->port_up;
+
+	if (restart)
+		mqnic_stop_port(ndev);
+
+	set_bit(qid, priv->xsk_zc_qps);
+
+	if (restart) {
+		ret = mqnic_start_port(ndev);
+		if (ret) {
+			netdev_err(ndev, "Failed to start port with XSK pool on queue %d: %d",
+					qid, ret);
+
+			clear_bit(qid, priv->xsk_zc_qps);
+			mqnic_start_port(ndev);
+		}
+	}
+
+	mutex_unlock(&mdev->state_lock);
+
+	if (ret)
+		xsk_pool_dma_unmap(pool, 0);
+
+	return ret;
+}
+
+static int mqnic_xsk_pool_disable(struct net_device *ndev, u16 qid)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_dev *mdev = priv->mdev;
+	struct xsk_buff_pool *pool;
+	bool restart;
+
+	pool = xsk_get_pool_from_qid(ndev, qid);
+	if (!pool || qid >= ndev->num_rx_queues || !test_bit(qid, priv->xsk_zc_qps))
+		return -EINVAL;
+
+	mutex_lock(&mdev->state_lock);
+
+	restart = priv->port_up;
+
+	if (restart)
+		mqnic_stop_port(ndev);
+
+	clear_bit(qid, priv->xsk_zc_qps);
+
+	if (restart)
+		mqnic_start_port(ndev);
+
+	mutex_unlock(&mdev->state_lock);
+
+	xsk_pool_dma_unmap(pool, 0);
+
+	return 0;
+}
+
+int mqnic_xsk_pool_setup(struct net_device *ndev, struct xsk_buff_pool *pool, u16 qid)
+{
+	if (pool)
+		return mqnic_xsk_pool_enable(ndev, pool, qid);
+	else
+		return mqnic_xsk_pool_disable(ndev, qid);
+}
+
+int mqnic_xsk_wakeup(struct net_device *ndev, u32 qid, u32 flags)
+{
+	struct mqnic_priv *priv = netdev_priv(ndev);
+	struct mqnic_ring *ring;
+	struct mqnic_cq *cq;
+
+	if (unlikely(!priv->port_up))
+		return -ENETDOWN;
+
+	if (qid >= priv->xdp_txq_count)
+		return -EINVAL;
+
+	ring = priv->xdp_txq[qid];
+	if (!ring->xsk_pool)
+		return -EINVAL;
+
+	// TX is driven from the XDP TX queue NAPI context
+	cq = ring->cq;
+	if (!napi_if_scheduled_mark_missed(&cq->napi))
+		napi_schedule(&cq->napi);
+
+	if (flags & XDP_WAKEUP_RX) {
+		rcu_read_lock();
+		ring = rcu_dereference(priv->rxq_table[qid]);
+		if (ring) {
+			cq = ring->cq;
+			if (!napi_if_scheduled_mark_missed(&cq->napi))
+				napi_schedule(&cq->napi);
+		}
+		rcu_read_unlock();
+	}
+
+	return 0;
+}
+
+int mqnic_prepare_rx_desc_zc(struct mqnic_ring *ring, int index)
+{
+	struct mqnic_rx_info *rx_info = &ring->rx_info[index];
+	struct mqnic_desc *rx_desc = (struct mqnic_desc *)(ring->buf + index * ring->stride);
+	struct xdp_buff *xdp;
+	dma_addr_t dma_addr;
+
+	if (unlikely(rx_info->xdp)) {
+		dev_err(ring->dev, "%s: buffer not yet processed on interface %d",
+				__func__, ring->interface->index);
+		return -1;
+	}
+
+	// pool buffers are already DMA mapped; running dry just means the fill ring is empty
+	xdp = xsk_buff_alloc(ring->xsk_pool);
+	if (unlikely(!xdp))
+		return -ENOMEM;
+
+	dma_addr = xsk_buff_xdp_get_dma(xdp);
+
+	// write descriptor
+	rx_desc->len = cpu_to_le32(xsk_pool_get_rx_frame_size(ring->xsk_pool));
+	rx_desc->addr = cpu_to_le64(dma_addr);
+
+	// update rx_info
+	rx_info->xdp = xdp;
+	rx_info->len = xsk_pool_get_rx_frame_size(ring->xsk_pool);
+
+	return 0;
+}
+
+void mqnic_free_rx_desc_zc(struct mqnic_ring *ring, int index)
+{
+	struct mqnic_rx_info *rx_info = &ring->rx_info[index];
+
+	if (!rx_info->xdp)
+		return;
+
+	xsk_buff_free(rx_info->xdp);
+	rx_info->xdp = NULL;
+}
+
+static struct sk_buff *mqnic_construct_skb_zc(struct mqnic_cq *cq, struct xdp_buff *xdp)
+{
+	unsigned int len = xdp->data_end - xdp->data;
+	struct sk_buff *skb;
+
+	skb = napi_alloc_skb(&cq->napi, len);
+	if (unlikely(!skb))
+		return NULL;
+
+	memcpy(skb_put(skb, len), xdp->data, len);
+
+	return skb;
+}
+
+int mqnic_process_rx_cq_zc(struct mqnic_cq *cq, int napi_budget)
+{
+	struct mqnic_if *interface = cq->interface;
+	struct mqnic_ring *rx_ring = cq->src_ring;
+	struct mqnic_priv *priv = rx_ring->priv;
+	struct xsk_buff_pool *pool = rx_ring->xsk_pool;
+	struct mqnic_rx_info *rx_info;
+	struct mqnic_cpl *cpl;
+	struct sk_buff *skb;
+	struct bpf_prog *xdp_prog;
+	struct xdp_buff *xdp;
+	u32 xdp_flags = 0;
+	u32 xdp_res;
+	u32 cq_index;
+	u32 cq_cons_ptr;
+	u32 ring_index;
+	u32 ring_cons_ptr;
+	int done = 0;
+	int budget = napi_budget;
+	int ret;
+	u32 len;
+
+	if (unlikely(!priv || !priv->port_up))
+		return done;
+
+	xdp_prog = READ_ONCE(priv->xdp_prog);
+
+	// process completion queue
+	cq_cons_ptr = cq->cons_ptr;
+	cq_index = cq_cons_ptr & cq->size_mask;
+
+	while (done < budget) {
+		cpl = (struct mqnic_cpl *)(cq->buf + cq_index * cq->stride);
+
+		if (!!(cpl->phase & cpu_to_le32(0x80000000)) == !!(cq_cons_ptr & cq->size))
+			break;
+
+		dma_rmb();
+
+		ring_index = le16_to_cpu(cpl->index) & rx_ring->size_mask;
+		rx_info = &rx_ring->rx_info[ring_index];
+		xdp = rx_info->xdp;
+		len = min_t(u32, le16_to_cpu(cpl->len), rx_info->len);
+
+		if (unlikely(!xdp)) {
+			netdev_err(priv->ndev, "%s: ring %d null buffer at index %d",
+					__func__, rx_ring->index, ring_index);
+			print_hex_dump(KERN_ERR, "", DUMP_PREFIX_NONE, 16, 1,
+					cpl, MQNIC_CPL_SIZE, true);
+			break;
+		}
+
+		rx_info->xdp = NULL;
+
+		u64_stats_update_begin(&rx_ring->syncp);
+		u64_stats_inc(&rx_ring->packets);
+		u64_stats_add(&rx_ring->bytes, le16_to_cpu(cpl->len));
+		u64_stats_update_end(&rx_ring->syncp);
+
+		if (len < ETH_HLEN) {
+			netdev_warn(priv->ndev, "%s: ring %d dropping short frame (length %d)",
+					__func__, rx_ring->index, len);
+			u64_stats_update_begin(&rx_ring->syncp);
+			u64_stats_inc(&rx_ring->dropped_packets);
+			u64_stats_update_end(&rx_ring->syncp);
+			xsk_buff_free(xdp);
+			goto rx_drop;
+		}
+
+		xdp->data_end = xdp->data + len;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+		xsk_buff_dma_sync_for_cpu(xdp);
+#else
+		xsk_buff_dma_sync_for_cpu(xdp, pool);
+#endif
+
+		if (xdp_prog) {
+			xdp_res = mqnic_run_xdp(rx_ring, xdp_prog, xdp);
+
+			if (xdp_res == MQNIC_XDP_CONSUMED)
+				xsk_buff_free(xdp);
+
+			if (xdp_res != MQNIC_XDP_PASS) {
+				xdp_flags |= xdp_res;
+				goto rx_drop;
+			}
+		}
+
+		// not redirected to the socket; copy out and hand to the stack
+		skb = mqnic_construct_skb_zc(cq, xdp);
+		xsk_buff_free(xdp);
+
+		if (unlikely(!skb)) {
+			u64_stats_update_begin(&rx_ring->syncp);
+			u64_stats_inc(&rx_ring->dropped_packets);
+			u64_stats_update_end(&rx_ring->syncp);
+			goto rx_drop;
+		}
+
+		// RX hardware timestamp
+		if (mqnic_rx_want_ts(priv, cpl))
+			skb_hwtstamps(skb)->hwtstamp = mqnic_read_cpl_ts(interface->mdev, cpl);
+
+		skb_record_rx_queue(skb, rx_ring->index);
+
+		// RX hardware checksum
+		if (priv->ndev->features & NETIF_F_RXCSUM) {
+			skb->csum = csum_unfold((__sum16) cpu_to_be16(le16_to_cpu(cpl->rx_csum)));
+			skb->ip_summed = CHECKSUM_COMPLETE;
+		}
+
+		// RX hardware hash
+		mqnic_rx_hash(rx_ring, cpl, skb);
+
+		// RX VLAN strip
+		mqnic_rx_vlan(rx_ring, cpl, skb);
+
+		skb->protocol = eth_type_trans(skb, priv->ndev);
+
+		// hand off SKB
+		napi_gro_receive(&cq->napi, skb);
+
+rx_drop:
+		done++;
+
+		cq_cons_ptr++;
+		cq_index = cq_cons_ptr & cq->size_mask;
+	}
+
+	// update CQ consumer pointer; written out once enough has been consumed
+	// or on the next arm
+	cq->cons_ptr = cq_cons_ptr;
+	mqnic_cq_update_cons_ptr(cq);
+
+	// flush XDP transmit and redirect
+	if (xdp_flags & MQNIC_XDP_TX)
+		mqnic_xdp_flush(priv->xdp_txq[rx_ring->queue_index % priv->xdp_txq_count]);
+
+	if (xdp_flags & MQNIC_XDP_REDIR)
+		xdp_do_flush();
+
+	// process ring
+	ring_cons_ptr = READ_ONCE(rx_ring->cons_ptr);
+
+	if (rx_ring->interface->if_features & MQNIC_IF_FEATURE_CPL_IN_ORDER) {
+		// every completion consumed the next entry in ring order
+		ring_cons_ptr += done;
+	} else {
+		ring_index = ring_cons_ptr & rx_ring->size_mask;
+
+		while (ring_cons_ptr != rx_ring->prod_ptr) {
+			rx_info = &rx_ring->rx_info[ring_index];
+
+			if (rx_info->xdp)
+				break;
+
+			ring_cons_ptr++;
+			ring_index = ring_cons_ptr & rx_ring->size_mask;
+		}
+	}
+
+	// update consumer pointer
+	WRITE_ONCE(rx_ring->cons_ptr, ring_cons_ptr);
+
+	// replenish buffers
+	ret = mqnic_refill_rx_buffers(rx_ring);
+
+	if (xsk_uses_need_wakeup(pool)) {
+		if (ret)
+			xsk_set_rx_need_wakeup(pool);
+		else
+			xsk_clear_rx_need_wakeup(pool);
+	}
+
+	return done;
+}
+
+bool mqnic_xsk_xmit(struct mqnic_ring *ring, int budget)
+{
+	struct xsk_buff_pool *pool = ring->xsk_pool;
+	struct mqnic_tx_info *tx_info;
+	struct mqnic_desc *tx_desc;
+	struct xdp_desc desc;
+	dma_addr_t dma_addr;
+	int count = 0;
+	u32 index;
+	u32 i;
+
+	spin_lock(&ring->xdp_tx_lock);
+
+	while (count < budget && !mqnic_is_tx_ring_full(ring)) {
+		if (!xsk_tx_peek_desc(pool, &desc))
+			break;
+
+		dma_addr = xsk_buff_raw_get_dma(pool, desc.addr);
+		xsk_buff_raw_dma_sync_for_device(pool, dma_addr, desc.len);
+
+		index = ring->prod_ptr & ring->size_mask;
+
+		tx_desc = (struct mqnic_desc *)(ring->buf + index * ring->stride);
+
+		tx_info = &ring->tx_info[index];
+
+		// write descriptor
+		tx_desc[0].tx.tso_mss = 0;
+		tx_desc[0].tx.csum_cmd = 0;
+		tx_desc[0].len = cpu_to_le32(desc.len);
+		tx_desc[0].addr = cpu_to_le64(dma_addr);
+
+		for (i = 1; i < ring->desc_block_size; i++) {
+			tx_desc[i].len = 0;
+			tx_desc[i].addr = 0;
+		}
+
+		// the slot may hold a stale VLAN or timestamp insert from an skb
+		if (ring->desc_block_size > 2)
+			tx_desc[2].tx_vlan.vlan_cmd = 0;
+		if (ring->desc_block_size > 3)
+			tx_desc[3].tx_ts.ts_cmd = 0;
+
+		// update tx_info
+		tx_info->skb = NULL;
+		tx_info->xdpf = NULL;
+		tx_info->xsk = 1;
+		tx_info->frag_count = 0;
+		tx_info->ts_requested = 0;
+
+		// count packet
+		u64_stats_update_begin(&ring->syncp);
+		u64_stats_inc(&ring->packets);
+		u64_stats_add(&ring->bytes, desc.len);
+		u64_stats_update_end(&ring->syncp);
+
+		// enqueue
+		ring->prod_ptr++;
+
+		count++;
+	}
+
+	if (count) {
+		// enqueue on NIC
+		dma_wmb();
+		mqnic_tx_write_prod_ptr(ring);
+
+		xsk_tx_release(pool);
+	}
+
+	spin_unlock(&ring->xdp_tx_lock);
+
+	if (xsk_uses_need_wakeup(pool))
+		xsk_set_tx_need_wakeup(pool);
+
+	return count < budget;
+}
+
+#endif
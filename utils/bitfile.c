@@ -3,63 +3,80 @@
  * Copyright (c) 2020-2023 The Regents of the University of California
  */
 
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "bitfile.h"
 
+// the file is mapped rather than read, so the image is only copied once,
+// by the caller, out of the page cache
 struct bitfile *bitfile_create_from_file(const char *bit_file_name)
 {
     struct bitfile *bf;
-    FILE *fp;
-    char *buffer;
-    char *data;
-    size_t len;
+    struct stat st;
+    void *map;
+    int fd;
 
-    fp = fopen(bit_file_name, "rb");
+    fd = open(bit_file_name, O_RDONLY);
 
-    if (!fp)
+    if (fd < 0)
     {
         fprintf(stderr, "Failed to open file\n");
         return 0;
     }
 
-    fseek(fp, 0, SEEK_END);
-    len = ftell(fp);
-    rewind(fp);
+    if (fstat(fd, &st) || st.st_size <= 0)
+    {
+        fprintf(stderr, "Error reading file\n");
+        close(fd);
+        return 0;
+    }
 
-    buffer = calloc(len + sizeof(struct bitfile), 1);
+    // private writable mapping, bitfile_parse takes non-const pointers
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
 
-    if (!buffer)
+    if (map == MAP_FAILED)
     {
-        fprintf(stderr, "Failed to allocate memory\n");
-        goto fail_file;
+        fprintf(stderr, "Failed to map file\n");
+        return 0;
     }
 
-    bf = (struct bitfile *)buffer;
-    data = buffer + sizeof(struct bitfile);
+    bf = calloc(1, sizeof(struct bitfile));
 
-    if (fread(data, 1, len, fp) < len)
+    if (!bf)
     {
-        fprintf(stderr, "Error reading file\n");
-        goto fail_buffer;
+        fprintf(stderr, "Failed to allocate memory\n");
+        goto fail_map;
     }
 
-    fclose(fp);
+    bf->map = map;
+    bf->map_len = st.st_size;
 
-    if (bitfile_parse(bf, data, len))
+    if (bitfile_parse(bf, map, st.st_size))
     {
         fprintf(stderr, "Failed to parse bitfile\n");
-        goto fail_buffer;
+        goto fail_bf;
+    }
+
+    if (bf->data < (char *)map || bf->data > (char *)map + st.st_size ||
+        bf->data_len > (size_t)((char *)map + st.st_size - bf->data))
+    {
+        fprintf(stderr, "Truncated bitfile\n");
+        goto fail_bf;
     }
 
     return bf;
 
-fail_buffer:
-    free(buffer);
-fail_file:
-    fclose(fp);
+fail_bf:
+    free(bf);
+fail_map:
+    munmap(map, st.st_size);
     return 0;
 }
 
@@ -149,6 +166,8 @@ void bitfile_close(struct bitfile *bf)
 {
     if (bf)
     {
+        if (bf->map)
+            munmap(bf->map, bf->map_len);
         free(bf);
     }
 }
@@ -15,6 +15,9 @@ struct bitfile {
 
     size_t data_len;
     char *data;
+
+    void *map;
+    size_t map_len;
 };
 
 struct bitfile *bitfile_create_from_file(const char *bit_file_name);
@@ -6,12 +6,27 @@
 #include <mqnic/mqnic.h>
 #include <mqnic/reg_if.h>
 
+#define DRP_POLL_LIMIT 1000
+
+// a DRP access takes a few DRP clock cycles, so it has normally finished
+// by the time the first status read returns; poll instead of paying for a
+// fixed dummy read on every access
+static int drp_rb_wait(const struct mqnic_reg_block *rb)
+{
+    for (int k = 0; k < DRP_POLL_LIMIT; k++)
+    {
+        if ((mqnic_reg_read32(rb->regs, 0x10) & 0x00000101) == 0)
+            return 0;
+    }
+
+    return -1;
+}
+
 int drp_rb_reg_read(const struct mqnic_reg_block *rb, uint32_t addr, uint32_t *val)
 {
     mqnic_reg_write32(rb->regs, 0x14, addr);
     mqnic_reg_write32(rb->regs, 0x10, 0x00000001);
-    mqnic_reg_read32(rb->regs, 0x10);
-    if ((mqnic_reg_read32(rb->regs, 0x10) & 0x00000101) != 0)
+    if (drp_rb_wait(rb))
         return -1;
     *val = mqnic_reg_read32(rb->regs, 0x1C);
     return 0;
@@ -22,10 +37,7 @@ int drp_rb_reg_write(const struct mqnic_reg_block *rb, uint32_t addr, uint32_t v
     mqnic_reg_write32(rb->regs, 0x14, addr);
     mqnic_reg_write32(rb->regs, 0x18, val);
     mqnic_reg_write32(rb->regs, 0x10, 0x00000003);
-    mqnic_reg_read32(rb->regs, 0x10);
-    if ((mqnic_reg_read32(rb->regs, 0x10) & 0x00000101) != 0)
-        return -1;
-    return 0;
+    return drp_rb_wait(rb);
 }
 
 static int drp_rb_reg_if_read32(const struct mqnic_reg_if *reg, ptrdiff_t offset, uint32_t *value)
@@ -47,4 +59,5 @@ void drp_rb_reg_if_init(struct mqnic_reg_if *reg, struct mqnic_reg_block *rb)
 {
     reg->priv = rb;
     reg->ops = &drp_rb_reg_if_ops;
+    reg->raw = NULL;
 }
@@ -10,7 +10,7 @@
 extern const struct flash_driver spi_flash_driver;
 extern const struct flash_driver bpi_flash_driver;
 
-struct flash_device *flash_open_spi(int data_width, volatile uint8_t *ctrl_reg)
+struct flash_device *flash_open_spi(int data_width, volatile uint8_t *ctrl_reg, volatile uint8_t *engine_reg)
 {
     struct flash_device *fdev;
 
@@ -27,6 +27,7 @@ struct flash_device *flash_open_spi(int data_width, volatile uint8_t *ctrl_reg)
     fdev->data_width = data_width;
 
     fdev->ctrl_reg = ctrl_reg;
+    fdev->engine_reg = engine_reg;
 
     if (fdev->driver->init(fdev))
     {
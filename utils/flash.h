@@ -29,6 +29,11 @@ struct flash_device {
     volatile uint8_t *addr_reg;
     volatile uint8_t *data_reg;
 
+    volatile uint8_t *engine_reg;
+    uint32_t engine_ctrl;
+    size_t engine_fifo_depth;
+    size_t engine_tx_free;
+
     size_t size;
     int data_width;
 
@@ -40,6 +45,8 @@ struct flash_device {
 
     int read_dummy_cycles;
 
+    int addr_auto_inc;
+
     int erase_region_count;
     struct flash_erase_region_info erase_region[FLASH_ERASE_REGIONS];
 };
@@ -58,7 +65,7 @@ struct flash_driver {
     int (*erase)(struct flash_device *fdev, size_t addr, size_t len);
 };
 
-struct flash_device *flash_open_spi(int data_width, volatile uint8_t *ctrl_reg);
+struct flash_device *flash_open_spi(int data_width, volatile uint8_t *ctrl_reg, volatile uint8_t *engine_reg);
 struct flash_device *flash_open_bpi(int data_width, volatile uint8_t *ctrl_reg, volatile uint8_t *addr_reg, volatile uint8_t *data_reg);
 void flash_release(struct flash_device *fdev);
 int flash_read(struct flash_device *fdev, size_t addr, size_t len, void *dest);
@@ -81,6 +81,11 @@
 #define FLASH_ADV_N     (1 << 3)
 #define FLASH_DQ_OE     (1 << 8)
 #define FLASH_REGION_OE (1 << 16)
+#define FLASH_ADDR_INC  (1 << 24) // step the address on WE_N rising, block version 0x300+
+
+// status polling spins this many times before it starts to back off
+#define BPI_POLL_SPIN    16
+#define BPI_POLL_MAX_US  256
 
 void bpi_flash_set_addr(struct flash_device *fdev, size_t addr)
 {
@@ -119,6 +124,60 @@ void bpi_flash_write_word(struct flash_device *fdev, size_t addr, uint16_t data)
     bpi_flash_write_cur(fdev, data);
 }
 
+// load a program buffer; with address auto-increment this is one address
+// write followed by the data strobes
+void bpi_flash_write_buffer(struct flash_device *fdev, size_t addr, size_t len, const uint8_t *s)
+{
+    if (!fdev->addr_auto_inc)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            bpi_flash_write_word(fdev, addr+i, s[0] | (s[1] << 8));
+            s += 2;
+        }
+        return;
+    }
+
+    bpi_flash_set_addr(fdev, addr);
+
+    for (size_t i = 0; i < len; i++)
+    {
+        reg_write32(fdev->data_reg, s[0] | (s[1] << 8));
+        reg_write32(fdev->ctrl_reg, FLASH_REGION_OE | FLASH_DQ_OE | FLASH_OE_N);
+        reg_read32(fdev->data_reg); // dummy read
+        reg_write32(fdev->ctrl_reg, FLASH_OE_N | FLASH_WE_N | FLASH_ADV_N | FLASH_ADDR_INC);
+        s += 2;
+    }
+}
+
+// programs take hundreds of microseconds and erases much longer, so after a
+// short spin leave the bus alone for increasing intervals
+void bpi_flash_poll_backoff(unsigned int *count)
+{
+    unsigned int delay;
+
+    if (++(*count) <= BPI_POLL_SPIN)
+        return;
+
+    delay = *count - BPI_POLL_SPIN < 9 ? 1 << (*count - BPI_POLL_SPIN - 1) : BPI_POLL_MAX_US;
+    usleep(delay < BPI_POLL_MAX_US ? delay : BPI_POLL_MAX_US);
+}
+
+// the device stays in read status mode until the next command, so the
+// command goes out once and the last status read is returned
+uint16_t bpi_flash_wait_status(struct flash_device *fdev, uint16_t cmd)
+{
+    unsigned int count = 0;
+    uint16_t val;
+
+    bpi_flash_write_cur(fdev, cmd);
+
+    while (!((val = bpi_flash_read_cur(fdev)) & 0x80))
+        bpi_flash_poll_backoff(&count);
+
+    return val;
+}
+
 void bpi_flash_deselect(struct flash_device *fdev)
 {
     bpi_flash_write_word(fdev, 0, CFI_READ_ARRAY);
@@ -158,9 +217,7 @@ int bpi_flash_intel_sector_erase(struct flash_device *fdev, size_t addr)
     bpi_flash_write_cur(fdev, BPI_INTEL_BLOCK_ERASE_SETUP);
     bpi_flash_write_cur(fdev, BPI_INTEL_BLOCK_ERASE_CONFIRM);
 
-    while (!(bpi_flash_intel_read_status_register(fdev) & 0x80)) {};
-
-    if (bpi_flash_intel_read_status_register(fdev) & 0x30)
+    if (bpi_flash_wait_status(fdev, BPI_INTEL_READ_STATUS_REG) & 0x30)
     {
         fprintf(stderr, "Failed to erase block\n");
         return -1;
@@ -177,18 +234,12 @@ int bpi_flash_intel_buffered_program(struct flash_device *fdev, size_t addr, siz
     bpi_flash_write_cur(fdev, BPI_INTEL_BUFFERED_PROGRAM_SETUP);
     bpi_flash_write_cur(fdev, len-1);
 
-    for (size_t i = 0; i < len; i++)
-    {
-        bpi_flash_write_word(fdev, addr+i, s[0] | (s[1] << 8));
-        s += 2;
-    }
+    bpi_flash_write_buffer(fdev, addr, len, s);
 
     bpi_flash_set_addr(fdev, addr);
     bpi_flash_write_cur(fdev, BPI_INTEL_BUFFERED_PROGRAM_CONFIRM);
 
-    while (!(bpi_flash_intel_read_status_register(fdev) & 0x80)) {};
-
-    if (bpi_flash_intel_read_status_register(fdev) & 0x30)
+    if (bpi_flash_wait_status(fdev, BPI_INTEL_READ_STATUS_REG) & 0x30)
     {
         fprintf(stderr, "Failed to write block\n");
         return -1;
@@ -226,6 +277,7 @@ void bpi_flash_amd_init(struct flash_device *fdev)
 int bpi_flash_amd_wait_for_operation(struct flash_device *fdev, uint16_t stop_mask)
 {
     uint16_t read_1, read_2, read_3;
+    unsigned int count = 0;
 
     while (1)
     {
@@ -239,6 +291,8 @@ int bpi_flash_amd_wait_for_operation(struct flash_device *fdev, uint16_t stop_ma
             {
                 return read_1;
             }
+
+            bpi_flash_poll_backoff(&count);
         }
         else
         {
@@ -276,11 +330,7 @@ int bpi_flash_amd_buffered_program(struct flash_device *fdev, size_t addr, size_
     bpi_flash_write_word(fdev, addr, BPI_AMD_BUFFERED_PROGRAM_SETUP);
     bpi_flash_write_cur(fdev, len-1);
 
-    for (size_t i = 0; i < len; i++)
-    {
-        bpi_flash_write_word(fdev, addr+i, s[0] | (s[1] << 8));
-        s += 2;
-    }
+    bpi_flash_write_buffer(fdev, addr, len, s);
 
     bpi_flash_set_addr(fdev, addr);
     bpi_flash_write_cur(fdev, BPI_AMD_BUFFERED_PROGRAM_CONFIRM);
@@ -337,9 +387,7 @@ int bpi_flash_micron_sector_erase(struct flash_device *fdev, size_t addr)
     bpi_flash_write_cur(fdev, BPI_MICRON_BLOCK_ERASE_SETUP);
     bpi_flash_write_cur(fdev, BPI_MICRON_BLOCK_ERASE_CONFIRM);
 
-    while (!(bpi_flash_micron_read_status_register(fdev) & 0x80)) {};
-
-    if (bpi_flash_micron_read_status_register(fdev) & 0x30)
+    if (bpi_flash_wait_status(fdev, BPI_MICRON_READ_STATUS_REG) & 0x30)
     {
         fprintf(stderr, "Failed to erase block\n");
         bpi_flash_write_cur(fdev, CFI_READ_ARRAY);
@@ -359,18 +407,12 @@ int bpi_flash_micron_buffered_program(struct flash_device *fdev, size_t addr, si
     bpi_flash_write_cur(fdev, BPI_MICRON_BUFFERED_PROGRAM_SETUP);
     bpi_flash_write_cur(fdev, len-1);
 
-    for (size_t i = 0; i < len; i++)
-    {
-        bpi_flash_write_word(fdev, addr+i, s[0] | (s[1] << 8));
-        s += 2;
-    }
+    bpi_flash_write_buffer(fdev, addr, len, s);
 
     bpi_flash_set_addr(fdev, addr);
     bpi_flash_write_cur(fdev, BPI_MICRON_BUFFERED_PROGRAM_CONFIRM);
 
-    while (!(bpi_flash_micron_read_status_register(fdev) & 0x80)) {};
-
-    if (bpi_flash_micron_read_status_register(fdev) & 0x30)
+    if (bpi_flash_wait_status(fdev, BPI_MICRON_READ_STATUS_REG) & 0x30)
     {
         fprintf(stderr, "Failed to write block\n");
         bpi_flash_write_cur(fdev, CFI_READ_ARRAY);
@@ -99,13 +99,170 @@
 #define FLASH_CLK     (1 << 16)
 #define FLASH_CS_N    (1 << 17)
 
+// shift register engine
+// data pushes and CTRL, RX_COUNT and DUMMY writes share the TX FIFO and are
+// executed in order, control writes taking one byte of space; CS is asserted
+// by the first shift after a release and SCK stalls while the RX FIFO is full
+#define ENGINE_REG_CTRL        0x0C
+#define ENGINE_REG_STATUS      0x10
+#define ENGINE_REG_TX_DATA     0x14 // push one byte
+#define ENGINE_REG_TX_WORD     0x18 // push four bytes, first out in bits 7:0
+#define ENGINE_REG_RX_DATA     0x1C // pop one byte
+#define ENGINE_REG_RX_WORD     0x20 // pop four bytes, first in in bits 7:0
+#define ENGINE_REG_RX_COUNT    0x24 // shift in this many bytes
+#define ENGINE_REG_DUMMY       0x28 // clock this many cycles, outputs off
+#define ENGINE_REG_FIFO_DEPTH  0x2C
+
+#define ENGINE_CTRL_CS_RELEASE  (1 << 0)
+#define ENGINE_CTRL_LANES_1     (0 << 8)
+#define ENGINE_CTRL_LANES_2     (1 << 8)
+#define ENGINE_CTRL_LANES_4     (2 << 8)
+#define ENGINE_CTRL_ENABLE      (1 << 31)
+
+#define ENGINE_STATUS_RX_LEVEL(s)  ((s) & 0xffff)
+#define ENGINE_STATUS_TX_FREE(s)   (((s) >> 16) & 0x7fff)
+#define ENGINE_STATUS_BUSY         (1 << 31)
+
+// TX free space is cached so that back to back pushes do not read status
+static void spi_engine_wait_tx(struct flash_device *fdev, size_t count)
+{
+    while (fdev->engine_tx_free < count)
+        fdev->engine_tx_free = ENGINE_STATUS_TX_FREE(reg_read32(fdev->engine_reg+ENGINE_REG_STATUS));
+
+    fdev->engine_tx_free -= count;
+}
+
+static void spi_engine_cmd(struct flash_device *fdev, int reg, uint32_t val)
+{
+    spi_engine_wait_tx(fdev, 1);
+    reg_write32(fdev->engine_reg+reg, val);
+}
+
+static void spi_engine_set_protocol(struct flash_device *fdev, int protocol)
+{
+    uint32_t ctrl = ENGINE_CTRL_ENABLE;
+
+    switch (protocol)
+    {
+    case SPI_PROTO_DUAL_STR:
+        ctrl |= ENGINE_CTRL_LANES_2;
+        break;
+    case SPI_PROTO_QUAD_STR:
+        ctrl |= ENGINE_CTRL_LANES_4;
+        break;
+    default:
+        ctrl |= ENGINE_CTRL_LANES_1;
+        break;
+    }
+
+    // lane changes queue behind data already in the TX FIFO
+    if (ctrl != fdev->engine_ctrl)
+    {
+        spi_engine_cmd(fdev, ENGINE_REG_CTRL, ctrl);
+        fdev->engine_ctrl = ctrl;
+    }
+}
+
+static size_t spi_engine_wait_rx(struct flash_device *fdev, size_t count)
+{
+    size_t level;
+
+    do
+    {
+        level = ENGINE_STATUS_RX_LEVEL(reg_read32(fdev->engine_reg+ENGINE_REG_STATUS));
+    }
+    while (level < count);
+
+    return level;
+}
+
+static void spi_engine_idle(struct flash_device *fdev)
+{
+    while (reg_read32(fdev->engine_reg+ENGINE_REG_STATUS) & ENGINE_STATUS_BUSY) {};
+
+    fdev->engine_tx_free = fdev->engine_fifo_depth;
+}
+
+static void spi_engine_write(struct flash_device *fdev, const uint8_t *src, size_t len, int protocol)
+{
+    spi_engine_set_protocol(fdev, protocol);
+
+    while (len >= 4)
+    {
+        spi_engine_wait_tx(fdev, 4);
+        reg_write32(fdev->engine_reg+ENGINE_REG_TX_WORD,
+            src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24));
+        src += 4;
+        len -= 4;
+    }
+
+    while (len > 0)
+    {
+        spi_engine_wait_tx(fdev, 1);
+        reg_write32(fdev->engine_reg+ENGINE_REG_TX_DATA, *src);
+        src++;
+        len--;
+    }
+}
+
+static void spi_engine_read(struct flash_device *fdev, uint8_t *dest, size_t len, int protocol)
+{
+    size_t chunk;
+    size_t level;
+    uint32_t val;
+
+    spi_engine_set_protocol(fdev, protocol);
+
+    while (len > 0)
+    {
+        chunk = len < fdev->engine_fifo_depth ? len : fdev->engine_fifo_depth;
+        spi_engine_cmd(fdev, ENGINE_REG_RX_COUNT, chunk);
+        len -= chunk;
+
+        while (chunk >= 4)
+        {
+            level = spi_engine_wait_rx(fdev, 4);
+
+            while (level >= 4 && chunk >= 4)
+            {
+                val = reg_read32(fdev->engine_reg+ENGINE_REG_RX_WORD);
+                dest[0] = val;
+                dest[1] = val >> 8;
+                dest[2] = val >> 16;
+                dest[3] = val >> 24;
+                dest += 4;
+                chunk -= 4;
+                level -= 4;
+            }
+        }
+
+        while (chunk > 0)
+        {
+            spi_engine_wait_rx(fdev, 1);
+            *dest = reg_read32(fdev->engine_reg+ENGINE_REG_RX_DATA);
+            dest++;
+            chunk--;
+        }
+    }
+}
+
 void spi_flash_select(struct flash_device *fdev)
 {
+    // the engine asserts CS on its own
+    if (fdev->engine_reg)
+        return;
+
     reg_write32(fdev->ctrl_reg, 0);
 }
 
 void spi_flash_deselect(struct flash_device *fdev)
 {
+    if (fdev->engine_reg)
+    {
+        spi_engine_cmd(fdev, ENGINE_REG_CTRL, fdev->engine_ctrl | ENGINE_CTRL_CS_RELEASE);
+        return;
+    }
+
     reg_write32(fdev->ctrl_reg, FLASH_CS_N);
 }
 
@@ -113,6 +270,12 @@ uint8_t spi_flash_read_byte(struct flash_device *fdev, int protocol)
 {
     uint8_t val = 0;
 
+    if (fdev->engine_reg)
+    {
+        spi_engine_read(fdev, &val, 1, protocol);
+        return val;
+    }
+
     switch (protocol)
     {
     case SPI_PROTO_STR:
@@ -162,6 +325,12 @@ void spi_flash_write_byte(struct flash_device *fdev, uint8_t val, int protocol)
 {
     uint8_t bit;
 
+    if (fdev->engine_reg)
+    {
+        spi_engine_write(fdev, &val, 1, protocol);
+        return;
+    }
+
     switch (protocol)
     {
     case SPI_PROTO_STR:
@@ -295,6 +464,14 @@ void spi_flash_reset(struct flash_device *fdev, int protocol)
 void spi_flash_release(struct flash_device *fdev)
 {
     spi_flash_deselect(fdev);
+
+    if (fdev->engine_reg)
+    {
+        // hand the pins back to the bit-bang register
+        spi_engine_idle(fdev);
+        reg_write32(fdev->engine_reg+ENGINE_REG_CTRL, 0);
+        fdev->engine_ctrl = 0;
+    }
 }
 
 int spi_flash_init(struct flash_device *fdev)
@@ -304,6 +481,24 @@ int spi_flash_init(struct flash_device *fdev)
     if (!fdev)
         return -1;
 
+    if (fdev->engine_reg)
+    {
+        fdev->engine_fifo_depth = reg_read32(fdev->engine_reg+ENGINE_REG_FIFO_DEPTH);
+
+        if (fdev->engine_fifo_depth < 4)
+        {
+            fprintf(stderr, "SPI engine reports no FIFO, using bit-bang access\n");
+            fdev->engine_reg = NULL;
+        }
+        else
+        {
+            printf("SPI engine FIFO depth: %ld B\n", fdev->engine_fifo_depth);
+            fdev->engine_ctrl = 0;
+            spi_engine_set_protocol(fdev, SPI_PROTO_STR);
+            spi_engine_idle(fdev);
+        }
+    }
+
     spi_flash_reset(fdev, SPI_PROTO_STR);
 
     spi_flash_write_byte(fdev, SPI_CMD_READ_ID, SPI_PROTO_STR);
@@ -391,18 +586,32 @@ int spi_flash_read(struct flash_device *fdev, size_t addr, size_t len, void *des
     if (protocol != SPI_PROTO_STR)
     {
         // dummy cycles
-        for (int i = 0; i < fdev->read_dummy_cycles; i++)
+        if (fdev->engine_reg)
         {
-            reg_write32(fdev->ctrl_reg, FLASH_CLK);
-            reg_write32(fdev->ctrl_reg, 0);
+            spi_engine_cmd(fdev, ENGINE_REG_DUMMY, fdev->read_dummy_cycles);
+        }
+        else
+        {
+            for (int i = 0; i < fdev->read_dummy_cycles; i++)
+            {
+                reg_write32(fdev->ctrl_reg, FLASH_CLK);
+                reg_write32(fdev->ctrl_reg, 0);
+            }
         }
     }
 
-    while (len > 0)
+    if (fdev->engine_reg)
     {
-        *d = spi_flash_read_byte(fdev, protocol);
-        len--;
-        d++;
+        spi_engine_read(fdev, (uint8_t *)d, len, protocol);
+    }
+    else
+    {
+        while (len > 0)
+        {
+            *d = spi_flash_read_byte(fdev, protocol);
+            len--;
+            d++;
+        }
     }
 
     spi_flash_deselect(fdev);
@@ -459,15 +668,31 @@ int spi_flash_write(struct flash_device *fdev, size_t addr, size_t len, const vo
             spi_flash_write_addr(fdev, addr, protocol);
         }
 
-        while (len > 0)
+        if (fdev->engine_reg)
         {
-            spi_flash_write_byte(fdev, *s, protocol);
-            addr++;
-            s++;
-            len--;
+            // rest of the page in one burst
+            size_t seg = SPI_PAGE_SIZE - (addr & (SPI_PAGE_SIZE-1));
+
+            if (seg > len)
+                seg = len;
 
-            if ((addr & 0xff) == 0)
-                break;
+            spi_engine_write(fdev, (const uint8_t *)s, seg, protocol);
+            addr += seg;
+            s += seg;
+            len -= seg;
+        }
+        else
+        {
+            while (len > 0)
+            {
+                spi_flash_write_byte(fdev, *s, protocol);
+                addr++;
+                s++;
+                len--;
+
+                if ((addr & 0xff) == 0)
+                    break;
+            }
         }
 
         spi_flash_deselect(fdev);
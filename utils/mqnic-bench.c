@@ -0,0 +1,295 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <mqnic/mqnic.h>
+
+// sync_dcn tables are programmed as 8-word entries
+#define TABLE_ENTRY_WORDS 8
+
+static void usage(char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        " -d name    device to open (/dev/mqnic0)\n"
+        " -n count   iterations per test (default 100000)\n"
+        " -w offset  run the write test against this application region offset\n"
+        " -t offset  run the table programming test against this application region offset\n"
+        " -e count   table entries per programming run (default 1024)\n",
+        name);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+// per-read latency; each read is non-posted, so this is the PCIe round trip
+static void bench_mmio_read(struct mqnic *dev, int count, int *first)
+{
+    volatile uint8_t *reg = dev->fw_id_rb ? dev->fw_id_rb->regs : dev->regs;
+    double *samples = calloc(count, sizeof(*samples));
+    double sum = 0;
+
+    if (!samples)
+    {
+        perror("calloc failed");
+        return;
+    }
+
+    for (int k = 0; k < count; k++)
+    {
+        double t = now_ns();
+        (void)mqnic_reg_read32(reg, 0);
+        samples[k] = now_ns() - t;
+        sum += samples[k];
+    }
+
+    qsort(samples, count, sizeof(*samples), cmp_double);
+
+    printf("%s\n  \"mmio_read\": {\"count\": %d, \"mean_ns\": %.1f, \"min_ns\": %.1f, \"p50_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f}",
+            *first ? "" : ",", count, sum / count, samples[0], samples[count / 2],
+            samples[(int)(count * 0.99)], samples[count - 1]);
+    *first = 0;
+
+    free(samples);
+}
+
+static void bench_mmio_write_region(const char *label, volatile uint8_t *base, size_t offset, int count, int *first)
+{
+    volatile uint32_t *reg = (volatile uint32_t *)(base + offset);
+    double t;
+
+    t = now_ns();
+    for (int k = 0; k < count; k++)
+        reg[k & 63] = k;
+    // posted writes only land once a read flushes them
+    (void)reg[0];
+    t = now_ns() - t;
+
+    printf("%s\n  \"%s\": {\"count\": %d, \"ns\": %.0f, \"mwrites_per_s\": %.3f, \"mb_per_s\": %.1f}",
+            *first ? "" : ",", label, count, t, count * 1e3 / t, count * 4 * 1e3 / t);
+    *first = 0;
+}
+
+static void bench_mmio_write(struct mqnic *dev, size_t offset, int count, int *first)
+{
+    if (!dev->app_regs || offset + 64*4 > dev->app_regs_size)
+    {
+        fprintf(stderr, "Write test offset outside application region\n");
+        return;
+    }
+
+    bench_mmio_write_region("mmio_write", dev->app_regs, offset, count, first);
+
+    if (dev->app_regs_wc)
+        bench_mmio_write_region("mmio_write_wc", dev->app_regs_wc, offset, count, first);
+}
+
+static void bench_enumerate(struct mqnic *dev, int count, int *first)
+{
+    struct mqnic_reg_block *list;
+    double t;
+    int blocks = 0;
+
+    if (count > 1000)
+        count = 1000;
+
+    t = now_ns();
+    for (int k = 0; k < count; k++)
+    {
+        list = mqnic_enumerate_reg_block_list(dev->regs, 0, dev->regs_size);
+        if (!list)
+        {
+            fprintf(stderr, "Register block enumeration failed\n");
+            return;
+        }
+        if (!blocks)
+            for (struct mqnic_reg_block *rb = list; rb->regs; rb++)
+                blocks++;
+        mqnic_free_reg_block_list(list);
+    }
+    t = now_ns() - t;
+
+    printf("%s\n  \"enumerate\": {\"count\": %d, \"blocks\": %d, \"mean_us\": %.3f}",
+            *first ? "" : ",", count, blocks, t / count / 1e3);
+    *first = 0;
+}
+
+static void bench_stats(struct mqnic *dev, int count, int *first)
+{
+    uint64_t *stats;
+    int stats_count;
+    double t;
+
+    if (!dev->stats_rb)
+        return;
+
+    stats = calloc(dev->stats_count, sizeof(*stats));
+    if (!stats)
+    {
+        perror("calloc failed");
+        return;
+    }
+
+    if (count > 1000)
+        count = 1000;
+
+    stats_count = 0;
+    t = now_ns();
+    for (int k = 0; k < count; k++)
+        stats_count = mqnic_stats_snapshot(dev, stats, dev->stats_count);
+    t = now_ns() - t;
+
+    printf("%s\n  \"stats\": {\"snapshots\": %d, \"counters\": %d, \"snapshot_us\": %.3f, \"mcounters_per_s\": %.3f}",
+            *first ? "" : ",", count, stats_count, t / count / 1e3, (double)count * stats_count * 1e3 / t);
+    *first = 0;
+
+    free(stats);
+}
+
+static void bench_table(struct mqnic *dev, size_t offset, int entries, int count, int *first)
+{
+    size_t words = (size_t)entries * TABLE_ENTRY_WORDS;
+    uint32_t *image;
+    double t;
+
+    if (offset + words * 4 > dev->app_regs_size)
+    {
+        fprintf(stderr, "Table test range outside application region\n");
+        return;
+    }
+
+    image = calloc(words, sizeof(*image));
+    if (!image)
+    {
+        perror("calloc failed");
+        return;
+    }
+
+    for (size_t k = 0; k < words; k++)
+        image[k] = k;
+
+    if (count > 100)
+        count = 100;
+
+    t = now_ns();
+    for (int k = 0; k < count; k++)
+    {
+        if (mqnic_app_write_table(dev, offset, image, words))
+        {
+            fprintf(stderr, "Table write failed\n");
+            free(image);
+            return;
+        }
+    }
+    // flush posted writes before stopping the clock
+    (void)mqnic_reg_read32(dev->app_regs, offset);
+    t = now_ns() - t;
+
+    printf("%s\n  \"table_program\": {\"runs\": %d, \"entries\": %d, \"run_us\": %.3f, \"mentries_per_s\": %.3f}",
+            *first ? "" : ",", count, entries, t / count / 1e3, (double)count * entries * 1e3 / t);
+    *first = 0;
+
+    free(image);
+}
+
+int main(int argc, char *argv[])
+{
+    char *name;
+    int opt;
+
+    char *device = NULL;
+    struct mqnic *dev;
+    int count = 100000;
+    long write_offset = -1;
+    long table_offset = -1;
+    int table_entries = 1024;
+    int first = 1;
+
+    name = strrchr(argv[0], '/');
+    name = name ? 1+name : argv[0];
+
+    while ((opt = getopt(argc, argv, "d:n:w:t:e:h?")) != EOF)
+    {
+        switch (opt)
+        {
+        case 'd':
+            device = optarg;
+            break;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'w':
+            write_offset = strtol(optarg, NULL, 0);
+            break;
+        case 't':
+            table_offset = strtol(optarg, NULL, 0);
+            break;
+        case 'e':
+            table_entries = atoi(optarg);
+            break;
+        case 'h':
+        case '?':
+            usage(name);
+            return 0;
+        default:
+            usage(name);
+            return -1;
+        }
+    }
+
+    if (!device)
+    {
+        fprintf(stderr, "Device not specified\n");
+        usage(name);
+        return -1;
+    }
+
+    if (count <= 0 || table_entries <= 0)
+    {
+        fprintf(stderr, "Invalid count\n");
+        return -1;
+    }
+
+    dev = mqnic_open(device);
+
+    if (!dev)
+    {
+        fprintf(stderr, "Failed to open device\n");
+        return -1;
+    }
+
+    // writes only go where explicitly asked; the control region is never written
+    printf("{");
+    bench_mmio_read(dev, count, &first);
+    if (write_offset >= 0)
+        bench_mmio_write(dev, write_offset, count, &first);
+    bench_enumerate(dev, count, &first);
+    bench_stats(dev, count, &first);
+    if (table_offset >= 0)
+        bench_table(dev, table_offset, table_entries, count, &first);
+    printf("\n}\n");
+
+    mqnic_close(dev);
+
+    return 0;
+}
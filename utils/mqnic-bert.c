@@ -57,10 +57,40 @@ static void usage(char *name)
         " -g number  PRBS31 generation\n"
         " -i number  TDMA measurement interval (s)\n"
         " -c file    write heat map CSV\n"
+        " -b file    write heat map in binary format\n"
         " -k number  heat map slice count (default 128)\n",
         name);
 }
 
+/*
+ * Binary heat map: one header, then one record per channel, slot and slice
+ * in capture order.  Fields are host byte order; bits = updates * bits_per_update.
+ */
+#define BERT_BIN_MAGIC "MQBERT\0\1"
+
+struct bert_bin_header {
+    char magic[8];
+    int64_t start_sec;
+    uint32_t start_nsec;
+    uint32_t period_ns;
+    uint32_t timeslot_period_ns;
+    uint32_t active_period_ns;
+    uint32_t channel_count;
+    uint32_t channel_mask;
+    uint32_t slot_count;
+    uint32_t slice_count;
+    uint32_t slice_time_ns;
+    uint32_t bits_per_update;
+};
+
+struct bert_bin_record {
+    uint16_t channel;
+    uint16_t slot;
+    uint32_t slice;
+    uint32_t updates;
+    uint32_t errors;
+};
+
 int main(int argc, char *argv[])
 {
     char *name;
@@ -71,7 +101,6 @@ int main(int argc, char *argv[])
 
     struct timespec ts_now;
     struct timespec ts_start;
-    struct timespec ts_period;
 
     int64_t start_nsec = 0;
     uint32_t period_nsec = 0;
@@ -83,6 +112,7 @@ int main(int argc, char *argv[])
     float interval = -1;
 
     char *csv_file_name = NULL;
+    char *bin_file_name = NULL;
     FILE *csv_file = NULL;
 
     int slice_count = 128;
@@ -90,7 +120,7 @@ int main(int argc, char *argv[])
     name = strrchr(argv[0], '/');
     name = name ? 1+name : argv[0];
 
-    while ((opt = getopt(argc, argv, "d:s:p:t:a:m:g:i:c:k:h?")) != EOF)
+    while ((opt = getopt(argc, argv, "d:s:p:t:a:m:g:i:c:b:k:h?")) != EOF)
     {
         switch (opt)
         {
@@ -121,6 +151,9 @@ int main(int argc, char *argv[])
         case 'c':
             csv_file_name = optarg;
             break;
+        case 'b':
+            bin_file_name = optarg;
+            break;
         case 'k':
             slice_count = atoi(optarg);
             break;
@@ -179,7 +212,7 @@ int main(int argc, char *argv[])
         printf(" type 0x%08x (v %d.%d.%d.%d)\n", rb->type, rb->version >> 24,
                 (rb->version >> 16) & 0xff, (rb->version >> 8) & 0xff, rb->version & 0xff);
 
-    struct mqnic_reg_block *tdma_sched_rb = mqnic_find_reg_block(tdma_ber_rb_list, MQNIC_RB_TDMA_SCH_TYPE, MQNIC_RB_TDMA_SCH_VER, 0);
+    struct mqnic_reg_block *tdma_sched_rb = mqnic_find_reg_block(tdma_ber_rb_list, MQNIC_RB_TDMA_SCH_TYPE, 0, 0);
     struct mqnic_reg_block *tdma_ber_rb = mqnic_find_reg_block(tdma_ber_rb_list, 0x0000c062, 0x00000100, 0);
 
     if (!tdma_sched_rb || !tdma_ber_rb)
@@ -245,29 +278,16 @@ int main(int argc, char *argv[])
         ts_now.tv_sec = mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_L) + (((int64_t)mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_H)) << 32);
 
         // normalize start
-        ts_start.tv_sec = start_nsec / NSEC_PER_SEC;
-        ts_start.tv_nsec = start_nsec - ts_start.tv_sec * NSEC_PER_SEC;
-
-        // normalize period
-        ts_period.tv_sec = period_nsec / NSEC_PER_SEC;
-        ts_period.tv_nsec = period_nsec - ts_period.tv_sec * NSEC_PER_SEC;
+        ts_start = timespec_from_ns(start_nsec);
 
         printf("time   %ld.%09ld s\n", ts_now.tv_sec, ts_now.tv_nsec);
         printf("start  %ld.%09ld s\n", ts_start.tv_sec, ts_start.tv_nsec);
         printf("period %d ns\n", period_nsec);
 
-        if (timespec_lt(ts_start, ts_now))
+        if (start_nsec < timespec_to_ns(ts_now))
         {
-            // start time is in the past
-
-            // modulo start with period
-            ts_start = timespec_mod(ts_start, ts_period);
-
-            // align time with period
-            struct timespec ts_aligned = timespec_sub(ts_now, timespec_mod(ts_now, ts_period));
-
-            // add aligned time
-            ts_start = timespec_add(ts_start, ts_aligned);
+            // start time is in the past, move it to its phase in the current period
+            ts_start = timespec_from_ns(ns_align(timespec_to_ns(ts_now), start_nsec, period_nsec));
         }
 
         printf("time   %ld.%09ld s\n", ts_now.tv_sec, ts_now.tv_nsec);
@@ -338,7 +358,7 @@ int main(int argc, char *argv[])
         goto err;
     }
 
-    if (csv_file_name)
+    if (csv_file_name || bin_file_name)
     {
         time_t cur_time;
         struct tm *tm_info;
@@ -355,47 +375,6 @@ int main(int argc, char *argv[])
             goto err;
         }
 
-        printf("Measuring heat map to %s\n", csv_file_name);
-
-        csv_file = fopen(csv_file_name, "w");
-
-        fprintf(csv_file, "#TDMA BER\n");
-        fprintf(csv_file, "#date,'%s'\n", datestr);
-
-        if (dev->pci_device_path[0])
-        {
-            char *ptr = strrchr(dev->pci_device_path, '/');
-            if (ptr)
-                fprintf(csv_file, "#pcie_id,%s\n", ptr+1);
-        }
-
-        fprintf(csv_file, "#fpga_id,0x%08x\n", dev->fpga_id);
-        fprintf(csv_file, "#fw_id,0x%08x\n", dev->fw_id);
-        fprintf(csv_file, "#fw_version,'%d.%d.%d.%d'\n", dev->fw_ver >> 24,
-                (dev->fw_ver >> 16) & 0xff,
-                (dev->fw_ver >> 8) & 0xff,
-                dev->fw_ver & 0xff);
-        fprintf(csv_file, "#board_id,0x%08x\n", dev->board_id);
-        fprintf(csv_file, "#board_version,'%d.%d.%d.%d'\n", dev->board_ver >> 24,
-                (dev->board_ver >> 16) & 0xff,
-                (dev->board_ver >> 8) & 0xff,
-                dev->board_ver & 0xff);
-        fprintf(csv_file, "#build_date,'%s UTC'\n", dev->build_date_str);
-        fprintf(csv_file, "#git_hash,'%08x'\n", dev->git_hash);
-        fprintf(csv_file, "#release_info,'%08x'\n", dev->rel_info);
-
-        fprintf(csv_file, "#start,%ld.%09ld\n", ts_start.tv_sec, ts_start.tv_nsec);
-        fprintf(csv_file, "#period_ns,%d\n", period_nsec);
-        fprintf(csv_file, "#timeslot_period_ns,%d\n", timeslot_period_nsec);
-        fprintf(csv_file, "#active_period_ns,%d\n", active_period_nsec);
-        fprintf(csv_file, "#channel_count,%d\n", channel_count);
-        fprintf(csv_file, "#channel_mask,0x%08x\n", channel_mask);
-
-        for (int i = 0; i < channel_count; i++)
-        {
-            fprintf(csv_file, "#channel_%d_rate,%f\n", i, rate[i]);
-        }
-
         uint32_t slice_num = 0;
         uint32_t slice_time = active_period_nsec / slice_count;
         uint32_t slice_batch = 0;
@@ -409,10 +388,121 @@ int main(int argc, char *argv[])
                 break;
         }
 
-        fprintf(csv_file, "#slot_count,%d\n", slot_count);
-        fprintf(csv_file, "#slice_count,%d\n", slice_count);
-        fprintf(csv_file, "#slice_time_ns,%d\n", slice_time);
-        fprintf(csv_file, "channel,slot,slice,offset_ns,slot_offset_ns,duration_ns,bits,errors\n");
+        int active_channels[32];
+        int active_count = 0;
+
+        for (int i = 0; i < channel_count; i++)
+        {
+            if (channel_mask & (1 << i))
+                active_channels[active_count++] = i;
+        }
+
+        // one batch of raw counters, read out before anything is formatted
+        uint32_t *ram_buf = calloc((size_t)slot_count * slice_batch * active_count * 2, sizeof(*ram_buf));
+        struct bert_bin_record *rec_buf = NULL;
+
+        if (!ram_buf)
+        {
+            perror("calloc failed");
+            goto err;
+        }
+
+        if (bin_file_name)
+        {
+            struct bert_bin_header hdr;
+
+            rec_buf = calloc((size_t)slot_count * slice_batch * active_count, sizeof(*rec_buf));
+
+            if (!rec_buf)
+            {
+                perror("calloc failed");
+                free(ram_buf);
+                goto err;
+            }
+
+            printf("Measuring heat map to %s\n", bin_file_name);
+
+            csv_file = fopen(bin_file_name, "wb");
+
+            if (!csv_file)
+            {
+                perror("Failed to open file");
+                free(rec_buf);
+                free(ram_buf);
+                goto err;
+            }
+
+            memset(&hdr, 0, sizeof(hdr));
+            memcpy(hdr.magic, BERT_BIN_MAGIC, sizeof(hdr.magic));
+            hdr.start_sec = ts_start.tv_sec;
+            hdr.start_nsec = ts_start.tv_nsec;
+            hdr.period_ns = period_nsec;
+            hdr.timeslot_period_ns = timeslot_period_nsec;
+            hdr.active_period_ns = active_period_nsec;
+            hdr.channel_count = channel_count;
+            hdr.channel_mask = channel_mask;
+            hdr.slot_count = slot_count;
+            hdr.slice_count = slice_count;
+            hdr.slice_time_ns = slice_time;
+            hdr.bits_per_update = bits_per_update;
+
+            fwrite(&hdr, sizeof(hdr), 1, csv_file);
+        }
+        else
+        {
+            printf("Measuring heat map to %s\n", csv_file_name);
+
+            csv_file = fopen(csv_file_name, "w");
+
+            if (!csv_file)
+            {
+                perror("Failed to open file");
+                free(ram_buf);
+                goto err;
+            }
+
+            fprintf(csv_file, "#TDMA BER\n");
+            fprintf(csv_file, "#date,'%s'\n", datestr);
+
+            if (dev->pci_device_path[0])
+            {
+                char *ptr = strrchr(dev->pci_device_path, '/');
+                if (ptr)
+                    fprintf(csv_file, "#pcie_id,%s\n", ptr+1);
+            }
+
+            fprintf(csv_file, "#fpga_id,0x%08x\n", dev->fpga_id);
+            fprintf(csv_file, "#fw_id,0x%08x\n", dev->fw_id);
+            fprintf(csv_file, "#fw_version,'%d.%d.%d.%d'\n", dev->fw_ver >> 24,
+                    (dev->fw_ver >> 16) & 0xff,
+                    (dev->fw_ver >> 8) & 0xff,
+                    dev->fw_ver & 0xff);
+            fprintf(csv_file, "#board_id,0x%08x\n", dev->board_id);
+            fprintf(csv_file, "#board_version,'%d.%d.%d.%d'\n", dev->board_ver >> 24,
+                    (dev->board_ver >> 16) & 0xff,
+                    (dev->board_ver >> 8) & 0xff,
+                    dev->board_ver & 0xff);
+            fprintf(csv_file, "#build_date,'%s UTC'\n", dev->build_date_str);
+            fprintf(csv_file, "#git_hash,'%08x'\n", dev->git_hash);
+            fprintf(csv_file, "#release_info,'%08x'\n", dev->rel_info);
+
+            fprintf(csv_file, "#start,%ld.%09ld\n", ts_start.tv_sec, ts_start.tv_nsec);
+            fprintf(csv_file, "#period_ns,%d\n", period_nsec);
+            fprintf(csv_file, "#timeslot_period_ns,%d\n", timeslot_period_nsec);
+            fprintf(csv_file, "#active_period_ns,%d\n", active_period_nsec);
+            fprintf(csv_file, "#channel_count,%d\n", channel_count);
+            fprintf(csv_file, "#channel_mask,0x%08x\n", channel_mask);
+
+            for (int i = 0; i < channel_count; i++)
+            {
+                fprintf(csv_file, "#channel_%d_rate,%f\n", i, rate[i]);
+            }
+
+            fprintf(csv_file, "#slot_count,%d\n", slot_count);
+            fprintf(csv_file, "#slice_count,%d\n", slice_count);
+            fprintf(csv_file, "#slice_time_ns,%d\n", slice_time);
+            fprintf(csv_file, "channel,slot,slice,offset_ns,slot_offset_ns,duration_ns,bits,errors\n");
+        }
 
         printf("slot count %d\n", slot_count);
         printf("slice count %d\n", slice_count);
@@ -431,6 +521,8 @@ int main(int argc, char *argv[])
 
         while (slice_num < slice_count)
         {
+            uint32_t *ptr = ram_buf;
+
             printf("slice %d / %d\n", slice_num, slice_count);
             printf("slice time %d ns\n", slice_time);
             printf("slice offset %d ns\n", slice_offset);
@@ -446,7 +538,8 @@ int main(int argc, char *argv[])
                 mqnic_reg_write32(tdma_ber_rb->regs, 0x18, i | 0x80000000);
             }
 
-            sleep(1);
+            // the clears are posted writes; a read pushes them out ahead of the start
+            mqnic_reg_read32(tdma_ber_rb->regs, 0x18);
 
             // start accumulation in slice mode
             mqnic_reg_write32(tdma_ber_rb->regs, 0x0C, 3);
@@ -456,26 +549,55 @@ int main(int argc, char *argv[])
             // stop accumulation
             mqnic_reg_write32(tdma_ber_rb->regs, 0x0C, 0);
 
+            // read the whole batch first so the counters are not left waiting on file output
+            for (int j = 0; j < slot_count*slice_batch; j++)
+            {
+                // select slice
+                mqnic_reg_write32(tdma_ber_rb->regs, 0x18, j);
+                mqnic_reg_read32(tdma_ber_rb->regs, 0x18);
+
+                for (int n = 0; n < active_count; n++)
+                {
+                    *ptr++ = mqnic_reg_read32(tdma_ber_rb->regs, 0x48 + active_channels[n]*16);
+                    *ptr++ = mqnic_reg_read32(tdma_ber_rb->regs, 0x4C + active_channels[n]*16);
+                }
+            }
+
+            ptr = ram_buf;
+
             for (int j = 0; j < slot_count; j++)
             {
                 for (int k = 0; k < slice_batch; k++)
                 {
-                    // select slice
-                    mqnic_reg_write32(tdma_ber_rb->regs, 0x18, (j<<slice_shift)+k);
-                    mqnic_reg_read32(tdma_ber_rb->regs, 0x18);
-
-                    for (int i = 0; i < channel_count; i++)
+                    for (int n = 0; n < active_count; n++)
                     {
-                        if (channel_mask & (1 << i))
+                        int i = active_channels[n];
+
+                        if (rec_buf)
                         {
-                            int64_t bits = ((int64_t)mqnic_reg_read32(tdma_ber_rb->regs, 0x48 + i*16)) * bits_per_update;
-                            int64_t errs = mqnic_reg_read32(tdma_ber_rb->regs, 0x4C + i*16);
+                            struct bert_bin_record *rec = &rec_buf[(j*slice_batch+k)*active_count+n];
+
+                            rec->channel = i;
+                            rec->slot = j;
+                            rec->slice = k+slice_num;
+                            rec->updates = ptr[0];
+                            rec->errors = ptr[1];
+                        }
+                        else
+                        {
+                            int64_t bits = ((int64_t)ptr[0]) * bits_per_update;
+                            int64_t errs = ptr[1];
                             fprintf(csv_file, "%d,%d,%d,%d,%d,%d,%ld,%ld\n", i, j, k+slice_num, j*timeslot_period_nsec+slice_offset+k*slice_time, slice_offset+k*slice_time, slice_time, bits, errs);
                         }
+
+                        ptr += 2;
                     }
                 }
             }
 
+            if (rec_buf)
+                fwrite(rec_buf, sizeof(*rec_buf), (size_t)slot_count * slice_batch * active_count, csv_file);
+
             fflush(csv_file);
 
             slice_num += slice_batch;
@@ -486,6 +608,9 @@ int main(int argc, char *argv[])
         mqnic_reg_write32(tdma_ber_rb->regs, 0x14, 0);
 
         fclose(csv_file);
+
+        free(rec_buf);
+        free(ram_buf);
     }
     else if (interval > 0)
     {
@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <mqnic/mqnic.h>
+
+#define BURST_SIZE 64
+
+// pcap with nanosecond timestamps and Ethernet link type
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAP_LINKTYPE_ETHERNET 1
+
+struct pcap_file_hdr
+{
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct pcap_pkt_hdr
+{
+    uint32_t ts_sec;
+    uint32_t ts_nsec;
+    uint32_t caplen;
+    uint32_t len;
+};
+
+static volatile sig_atomic_t stop;
+
+static void sig_handler(int sig)
+{
+    stop = 1;
+}
+
+static void usage(char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        " -d name    device to open (/dev/mqnic0)\n"
+        " -i number  interface\n"
+        " -p mask    port mask (default all ports)\n"
+        " -o offset  byte offset of the match window in the frame (default 0)\n"
+        " -m hex     match bytes, up to 16\n"
+        " -M hex     mask bytes, up to 16 (default all zero, matching every frame)\n"
+        " -s len     snap length (default whole frames)\n"
+        " -q size    capture queue size (default 4096)\n"
+        " -c count   stop after this many packets\n"
+        " -w file    pcap output file (default stdout)\n",
+        name);
+}
+
+static int parse_hex(const char *str, uint8_t *buf, int len)
+{
+    int k = 0;
+    unsigned int val;
+    int n;
+
+    memset(buf, 0, len);
+
+    while (*str)
+    {
+        if (*str == ':' || *str == ' ')
+        {
+            str++;
+            continue;
+        }
+
+        if (k >= len || sscanf(str, "%2x%n", &val, &n) != 1)
+            return -1;
+
+        buf[k++] = val;
+        str += n;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char *name;
+    int opt;
+    int ret = 0;
+
+    char *device = NULL;
+    struct mqnic *dev;
+    int interface = 0;
+    struct mqnic_if *dev_interface;
+    struct mqnic_capture_filter filter;
+    struct mqnic_capture *cap;
+    struct mqnic_capture_pkt pkts[BURST_SIZE];
+    long port_mask = -1;
+    uint32_t snaplen = 0;
+    uint32_t size = 4096;
+    long count = -1;
+    long captured = 0;
+    char *out_name = NULL;
+    FILE *out = stdout;
+    struct pcap_file_hdr file_hdr;
+
+    name = strrchr(argv[0], '/');
+    name = name ? 1+name : argv[0];
+
+    memset(&filter, 0, sizeof(filter));
+
+    while ((opt = getopt(argc, argv, "d:i:p:o:m:M:s:q:c:w:h?")) != EOF)
+    {
+        switch (opt)
+        {
+        case 'd':
+            device = optarg;
+            break;
+        case 'i':
+            interface = atoi(optarg);
+            break;
+        case 'p':
+            port_mask = strtol(optarg, NULL, 0);
+            break;
+        case 'o':
+            filter.offset = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            if (parse_hex(optarg, filter.match, sizeof(filter.match)))
+            {
+                fprintf(stderr, "Invalid match bytes\n");
+                return -1;
+            }
+            break;
+        case 'M':
+            if (parse_hex(optarg, filter.mask, sizeof(filter.mask)))
+            {
+                fprintf(stderr, "Invalid mask bytes\n");
+                return -1;
+            }
+            break;
+        case 's':
+            snaplen = strtoul(optarg, NULL, 0);
+            break;
+        case 'q':
+            size = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            count = strtol(optarg, NULL, 0);
+            break;
+        case 'w':
+            out_name = optarg;
+            break;
+        case 'h':
+        case '?':
+            usage(name);
+            return 0;
+        default:
+            usage(name);
+            return -1;
+        }
+    }
+
+    if (!device)
+    {
+        fprintf(stderr, "Device not specified\n");
+        usage(name);
+        return -1;
+    }
+
+    dev = mqnic_open(device);
+
+    if (!dev)
+    {
+        fprintf(stderr, "Failed to open device\n");
+        return -1;
+    }
+
+    dev_interface = mqnic_get_interface(dev, interface);
+
+    if (!dev_interface)
+    {
+        fprintf(stderr, "Invalid interface number\n");
+        ret = -1;
+        goto err;
+    }
+
+    filter.port_mask = port_mask < 0 ? (1u << dev_interface->port_count) - 1 : port_mask;
+
+    if (out_name)
+    {
+        out = fopen(out_name, "wb");
+        if (!out)
+        {
+            perror("Failed to open output file");
+            ret = -1;
+            goto err;
+        }
+    }
+
+    cap = mqnic_capture_open(dev_interface, &filter, size, snaplen);
+
+    if (!cap)
+    {
+        fprintf(stderr, "Failed to open capture\n");
+        ret = -1;
+        goto err_out;
+    }
+
+    file_hdr.magic = PCAP_MAGIC_NS;
+    file_hdr.version_major = 2;
+    file_hdr.version_minor = 4;
+    file_hdr.thiszone = 0;
+    file_hdr.sigfigs = 0;
+    file_hdr.snaplen = snaplen ? snaplen : dev_interface->max_rx_mtu;
+    file_hdr.linktype = PCAP_LINKTYPE_ETHERNET;
+
+    fwrite(&file_hdr, sizeof(file_hdr), 1, out);
+
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+
+    while (!stop && (count < 0 || captured < count))
+    {
+        int n = mqnic_capture_burst(cap, pkts, BURST_SIZE);
+
+        for (int k = 0; k < n && (count < 0 || captured < count); k++)
+        {
+            struct pcap_pkt_hdr pkt_hdr;
+
+            pkt_hdr.ts_sec = pkts[k].ts_ns / 1000000000;
+            pkt_hdr.ts_nsec = pkts[k].ts_ns % 1000000000;
+            pkt_hdr.caplen = pkts[k].len;
+            pkt_hdr.len = pkts[k].orig_len;
+
+            fwrite(&pkt_hdr, sizeof(pkt_hdr), 1, out);
+            fwrite(pkts[k].data, pkts[k].len, 1, out);
+
+            captured++;
+        }
+    }
+
+    fflush(out);
+
+    fprintf(stderr, "%ld packets captured\n", captured);
+
+    mqnic_capture_close(cap);
+
+err_out:
+    if (out != stdout)
+        fclose(out);
+
+err:
+    mqnic_close(dev);
+
+    return ret;
+}
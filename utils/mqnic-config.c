@@ -26,6 +26,9 @@
 
 #define NSEC_PER_SEC 1000000000
 
+#define MAX_DEVICES 64
+#define DEFAULT_COMMIT_LEAD_NSEC 100000000
+
 static void usage(char *name)
 {
     fprintf(stderr,
@@ -36,10 +39,364 @@ static void usage(char *name)
         " -s number  TDMA schedule start time (ns)\n"
         " -p number  TDMA schedule period (ns)\n"
         " -t number  TDMA timeslot period (ns)\n"
-        " -a number  TDMA active period (ns)\n",
+        " -a number  TDMA active period (ns)\n"
+        " -f file    batch TDMA schedule file\n"
+        " -c number  batch commit PHC time (ns)\n"
+        " -l number  batch commit lead time when -c is not set (ns, default 100000000)\n"
+        " -w         wait for the batch commit and verify it\n",
         name);
 }
 
+static int64_t read_phc_tod(struct mqnic *dev)
+{
+    struct timespec ts;
+
+    ts.tv_nsec = mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_CUR_TOD_NS);
+    ts.tv_sec = mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_L) +
+            (((int64_t)mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_H)) << 32);
+
+    return timespec_to_ns(ts);
+}
+
+// move a start time in the past to its phase in the period containing ref_nsec
+static int64_t align_start(int64_t start_nsec, int64_t ref_nsec, uint32_t period_nsec)
+{
+    if (start_nsec < ref_nsec)
+        start_nsec = ns_align(ref_nsec, start_nsec, period_nsec);
+
+    return start_nsec;
+}
+
+struct batch_device
+{
+    char name[256];
+    struct mqnic *dev;
+};
+
+struct batch_entry
+{
+    int line;
+    struct batch_device *bdev;
+    int interface;
+    int port;
+    int64_t start_nsec;
+    uint32_t period_nsec;
+    uint32_t timeslot_period_nsec;
+    uint32_t active_period_nsec;
+    struct mqnic_reg_block *rb;
+    struct timespec ts_start;
+};
+
+static struct batch_device *batch_get_device(struct batch_device *devices, int *device_count, const char *name)
+{
+    for (int k = 0; k < *device_count; k++)
+    {
+        if (strcmp(devices[k].name, name) == 0)
+            return &devices[k];
+    }
+
+    if (*device_count >= MAX_DEVICES)
+    {
+        fprintf(stderr, "Too many devices (max %d)\n", MAX_DEVICES);
+        return NULL;
+    }
+
+    struct batch_device *bdev = &devices[*device_count];
+
+    snprintf(bdev->name, sizeof(bdev->name), "%s", name);
+    bdev->dev = mqnic_open(name);
+
+    if (!bdev->dev)
+    {
+        fprintf(stderr, "Failed to open device %s\n", name);
+        return NULL;
+    }
+
+    if (!bdev->dev->phc_rb)
+    {
+        fprintf(stderr, "No PHC on card %s\n", name);
+        mqnic_close(bdev->dev);
+        return NULL;
+    }
+
+    (*device_count)++;
+    return bdev;
+}
+
+static int batch_validate_entry(struct batch_entry *e)
+{
+    struct mqnic *dev = e->bdev->dev;
+    struct mqnic_if *dev_interface;
+    struct mqnic_sched_block *dev_sched_block;
+    uint32_t ts_count;
+
+    dev_interface = mqnic_get_interface(dev, e->interface);
+
+    if (!dev_interface)
+    {
+        fprintf(stderr, "line %d: interface %d out of range on %s\n", e->line, e->interface, e->bdev->name);
+        return -1;
+    }
+
+    dev_sched_block = e->port < dev_interface->port_count ? mqnic_if_get_sched_block(dev_interface, e->port) : NULL;
+
+    if (!dev_sched_block)
+    {
+        fprintf(stderr, "line %d: port %d out of range on %s interface %d\n", e->line, e->port, e->bdev->name, e->interface);
+        return -1;
+    }
+
+    e->rb = mqnic_find_reg_block(dev_sched_block->rb_list, MQNIC_RB_TDMA_SCH_TYPE, 0, 0);
+
+    if (!e->rb || e->rb->version < MQNIC_RB_TDMA_SCH_VER_STAGED)
+    {
+        fprintf(stderr, "line %d: no TDMA scheduler with staged commit on %s interface %d port %d\n",
+                e->line, e->bdev->name, e->interface, e->port);
+        return -1;
+    }
+
+    if (e->start_nsec < 0)
+    {
+        fprintf(stderr, "line %d: negative schedule start time\n", e->line);
+        return -1;
+    }
+
+    // period registers only carry the ns field
+    if (e->period_nsec == 0 || e->period_nsec >= NSEC_PER_SEC ||
+            e->timeslot_period_nsec == 0 || e->timeslot_period_nsec > e->period_nsec ||
+            e->active_period_nsec == 0 || e->active_period_nsec > e->timeslot_period_nsec)
+    {
+        fprintf(stderr, "line %d: periods must satisfy 0 < active <= timeslot <= schedule < 1 s\n", e->line);
+        return -1;
+    }
+
+    ts_count = mqnic_reg_read32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_CTRL) >> 16;
+
+    if ((e->period_nsec + e->timeslot_period_nsec - 1) / e->timeslot_period_nsec > ts_count)
+    {
+        fprintf(stderr, "line %d: schedule needs more than %d timeslots\n", e->line, ts_count);
+        return -1;
+    }
+
+    if (mqnic_reg_read32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL) & MQNIC_TDMA_SCH_COMMIT_PENDING)
+    {
+        fprintf(stderr, "line %d: TDMA scheduler already has a commit pending\n", e->line);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int batch_config(const char *default_device, const char *file_name, int64_t commit_nsec, int64_t lead_nsec, int wait)
+{
+    FILE *fp;
+    char line[512];
+    int line_num = 0;
+    int ret = -1;
+
+    struct batch_device devices[MAX_DEVICES];
+    int device_count = 0;
+
+    struct batch_entry *entries = NULL;
+    int entry_count = 0;
+    int entry_size = 0;
+
+    struct timespec ts_commit;
+
+    fp = fopen(file_name, "r");
+
+    if (!fp)
+    {
+        perror("failed to open schedule file");
+        return -1;
+    }
+
+    // parse and validate everything before touching any scheduler
+    while (fgets(line, sizeof(line), fp))
+    {
+        char dev_name[256];
+        long long start_nsec;
+        unsigned int period_nsec, timeslot_period_nsec, active_period_nsec;
+        int interface, port;
+        char *ptr;
+
+        line_num++;
+
+        ptr = strchr(line, '#');
+        if (ptr)
+            *ptr = 0;
+
+        ptr = line;
+        while (*ptr == ' ' || *ptr == '\t' || *ptr == '\r' || *ptr == '\n')
+            ptr++;
+        if (!*ptr)
+            continue;
+
+        if (sscanf(ptr, "%255s %d %d %lld %u %u %u", dev_name, &interface, &port,
+                &start_nsec, &period_nsec, &timeslot_period_nsec, &active_period_nsec) != 7)
+        {
+            fprintf(stderr, "line %d: expected \"device interface port start period timeslot active\"\n", line_num);
+            goto err;
+        }
+
+        if (strcmp(dev_name, "-") == 0)
+        {
+            if (!default_device)
+            {
+                fprintf(stderr, "line %d: device \"-\" needs -d\n", line_num);
+                goto err;
+            }
+            snprintf(dev_name, sizeof(dev_name), "%s", default_device);
+        }
+
+        if (entry_count >= entry_size)
+        {
+            struct batch_entry *p;
+
+            entry_size = entry_size ? entry_size * 2 : 16;
+            p = realloc(entries, entry_size * sizeof(*entries));
+
+            if (!p)
+            {
+                fprintf(stderr, "Failed to allocate memory\n");
+                goto err;
+            }
+
+            entries = p;
+        }
+
+        struct batch_entry *e = &entries[entry_count];
+
+        memset(e, 0, sizeof(*e));
+        e->line = line_num;
+        e->interface = interface;
+        e->port = port;
+        e->start_nsec = start_nsec;
+        e->period_nsec = period_nsec;
+        e->timeslot_period_nsec = timeslot_period_nsec;
+        e->active_period_nsec = active_period_nsec;
+
+        e->bdev = batch_get_device(devices, &device_count, dev_name);
+
+        if (!e->bdev)
+            goto err;
+
+        if (batch_validate_entry(e))
+            goto err;
+
+        for (int k = 0; k < entry_count; k++)
+        {
+            if (entries[k].rb == e->rb)
+            {
+                fprintf(stderr, "line %d: TDMA scheduler already configured on line %d\n", line_num, entries[k].line);
+                goto err;
+            }
+        }
+
+        entry_count++;
+    }
+
+    if (entry_count == 0)
+    {
+        fprintf(stderr, "No schedule entries in %s\n", file_name);
+        goto err;
+    }
+
+    // all PHCs are expected to be synchronized, so one commit time serves all schedulers
+    if (commit_nsec <= 0)
+        commit_nsec = read_phc_tod(devices[0].dev) + lead_nsec;
+
+    ts_commit = timespec_from_ns(commit_nsec);
+
+    printf("Commit %d TDMA schedulers on %d devices at %ld.%09ld s\n",
+            entry_count, device_count, ts_commit.tv_sec, ts_commit.tv_nsec);
+
+    // stage
+    for (int k = 0; k < entry_count; k++)
+    {
+        struct batch_entry *e = &entries[k];
+
+        e->ts_start = timespec_from_ns(align_start(e->start_nsec, commit_nsec, e->period_nsec));
+
+        printf("%s if %d port %d: start %ld.%09ld s period %u ns timeslot %u ns active %u ns\n",
+                e->bdev->name, e->interface, e->port, e->ts_start.tv_sec, e->ts_start.tv_nsec,
+                e->period_nsec, e->timeslot_period_nsec, e->active_period_nsec);
+
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_NS, e->ts_start.tv_nsec);
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_SEC_L, e->ts_start.tv_sec & 0xffffffff);
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_STG_SCH_START_SEC_H, e->ts_start.tv_sec >> 32);
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_STG_SCH_PERIOD_NS, e->period_nsec);
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_STG_TS_PERIOD_NS, e->timeslot_period_nsec);
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_STG_ACTIVE_PERIOD_NS, e->active_period_nsec);
+
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_NS, ts_commit.tv_nsec);
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_L, ts_commit.tv_sec & 0xffffffff);
+        mqnic_reg_write32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_H, ts_commit.tv_sec >> 32);
+    }
+
+    // a scheduler armed after the commit time would commit late, on its own
+    for (int k = 0; k < device_count; k++)
+    {
+        if (read_phc_tod(devices[k].dev) >= commit_nsec)
+        {
+            fprintf(stderr, "Commit time passed on %s while staging, increase lead time\n", devices[k].name);
+            goto err;
+        }
+    }
+
+    // arm
+    for (int k = 0; k < entry_count; k++)
+        mqnic_reg_write32(entries[k].rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL, MQNIC_TDMA_SCH_COMMIT_ARM);
+
+    if (read_phc_tod(devices[0].dev) >= commit_nsec)
+        fprintf(stderr, "Warning: commit time passed while arming\n");
+
+    if (!wait)
+    {
+        ret = 0;
+        goto err;
+    }
+
+    // wait for the commit time to pass on every device
+    for (int k = 0; k < device_count; k++)
+    {
+        while (read_phc_tod(devices[k].dev) < commit_nsec)
+            usleep(1000);
+    }
+
+    usleep(1000);
+
+    ret = 0;
+
+    for (int k = 0; k < entry_count; k++)
+    {
+        struct batch_entry *e = &entries[k];
+        uint32_t val = mqnic_reg_read32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL);
+
+        if ((val & MQNIC_TDMA_SCH_COMMIT_PENDING) ||
+                mqnic_reg_read32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_SCH_PERIOD_NS) != e->period_nsec ||
+                mqnic_reg_read32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_TS_PERIOD_NS) != e->timeslot_period_nsec ||
+                mqnic_reg_read32(e->rb->regs, MQNIC_RB_TDMA_SCH_REG_ACTIVE_PERIOD_NS) != e->active_period_nsec)
+        {
+            fprintf(stderr, "%s if %d port %d: commit failed\n", e->bdev->name, e->interface, e->port);
+            ret = -1;
+        }
+        else
+        {
+            printf("%s if %d port %d: committed (commit count %d)\n", e->bdev->name, e->interface, e->port, val >> 16);
+        }
+    }
+
+err:
+    fclose(fp);
+    free(entries);
+
+    for (int k = 0; k < device_count; k++)
+        mqnic_close(devices[k].dev);
+
+    return ret;
+}
+
 int main(int argc, char *argv[])
 {
     char *name;
@@ -55,17 +412,21 @@ int main(int argc, char *argv[])
 
     struct timespec ts_now;
     struct timespec ts_start;
-    struct timespec ts_period;
 
     int64_t start_nsec = 0;
     uint32_t period_nsec = 0;
     uint32_t timeslot_period_nsec = 0;
     uint32_t active_period_nsec = 0;
 
+    char *batch_file = NULL;
+    int64_t commit_nsec = 0;
+    int64_t commit_lead_nsec = DEFAULT_COMMIT_LEAD_NSEC;
+    int commit_wait = 0;
+
     name = strrchr(argv[0], '/');
     name = name ? 1+name : argv[0];
 
-    while ((opt = getopt(argc, argv, "d:i:P:s:p:t:a:h?")) != EOF)
+    while ((opt = getopt(argc, argv, "d:i:P:s:p:t:a:f:c:l:wh?")) != EOF)
     {
         switch (opt)
         {
@@ -90,6 +451,18 @@ int main(int argc, char *argv[])
         case 'a':
             active_period_nsec = atoi(optarg);
             break;
+        case 'f':
+            batch_file = optarg;
+            break;
+        case 'c':
+            commit_nsec = atoll(optarg);
+            break;
+        case 'l':
+            commit_lead_nsec = atoll(optarg);
+            break;
+        case 'w':
+            commit_wait = 1;
+            break;
         case 'h':
         case '?':
             usage(name);
@@ -100,6 +473,9 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (batch_file)
+        return batch_config(device, batch_file, commit_nsec, commit_lead_nsec, commit_wait) ? -1 : 0;
+
     if (!device)
     {
         fprintf(stderr, "Device not specified\n");
@@ -136,7 +512,7 @@ int main(int argc, char *argv[])
         goto err;
     }
 
-    struct mqnic_if *dev_interface = dev->interfaces[interface];
+    struct mqnic_if *dev_interface = mqnic_get_interface(dev, interface);
 
     if (!dev_interface)
     {
@@ -171,7 +547,7 @@ int main(int argc, char *argv[])
         goto err;
     }
 
-    struct mqnic_sched_block *dev_sched_block = dev_interface->sched_blocks[sched_block];
+    struct mqnic_sched_block *dev_sched_block = mqnic_if_get_sched_block(dev_interface, sched_block);
 
     if (!dev_sched_block)
     {
@@ -181,7 +557,7 @@ int main(int argc, char *argv[])
     
     printf("Sched count: %d\n", dev_sched_block->sched_count);
 
-    rb = mqnic_find_reg_block(dev_sched_block->rb_list, MQNIC_RB_TDMA_SCH_TYPE, MQNIC_RB_TDMA_SCH_VER, 0);
+    rb = mqnic_find_reg_block(dev_sched_block->rb_list, MQNIC_RB_TDMA_SCH_TYPE, 0, 0);
 
     if (dev->phc_rb && rb)
     {
@@ -199,35 +575,16 @@ int main(int argc, char *argv[])
         {
             printf("Configure port TDMA schedule\n");
 
-            ts_now.tv_nsec = mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_CUR_TOD_NS);
-            ts_now.tv_sec = mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_L) +
-                    (((int64_t)mqnic_reg_read32(dev->phc_rb->regs, MQNIC_RB_PHC_REG_CUR_TOD_SEC_H)) << 32);
+            ts_now = timespec_from_ns(read_phc_tod(dev));
 
             // normalize start
-            ts_start.tv_sec = start_nsec / NSEC_PER_SEC;
-            ts_start.tv_nsec = start_nsec - ts_start.tv_sec * NSEC_PER_SEC;
-
-            // normalize period
-            ts_period.tv_sec = period_nsec / NSEC_PER_SEC;
-            ts_period.tv_nsec = period_nsec - ts_period.tv_sec * NSEC_PER_SEC;
+            ts_start = timespec_from_ns(start_nsec);
 
             printf("time   %ld.%09ld s\n", ts_now.tv_sec, ts_now.tv_nsec);
             printf("start  %ld.%09ld s\n", ts_start.tv_sec, ts_start.tv_nsec);
             printf("period %d ns\n", period_nsec);
 
-            if (timespec_lt(ts_start, ts_now))
-            {
-                // start time is in the past
-
-                // modulo start with period
-                ts_start = timespec_mod(ts_start, ts_period);
-
-                // align time with period
-                struct timespec ts_aligned = timespec_sub(ts_now, timespec_mod(ts_now, ts_period));
-
-                // add aligned time
-                ts_start = timespec_add(ts_start, ts_aligned);
-            }
+            ts_start = timespec_from_ns(align_start(start_nsec, timespec_to_ns(ts_now), period_nsec));
 
             printf("time   %ld.%09ld s\n", ts_now.tv_sec, ts_now.tv_nsec);
             printf("start  %ld.%09ld s\n", ts_start.tv_sec, ts_start.tv_nsec);
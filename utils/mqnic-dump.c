@@ -3,9 +3,12 @@
  * Copyright (c) 2019-2023 The Regents of the University of California
  */
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <mqnic/mqnic.h>
 
@@ -15,10 +18,184 @@ static void usage(char *name)
         "usage: %s [options]\n"
         " -d name    device to open (/dev/mqnic0)\n"
         " -i number  interface\n"
+        " -w ms      watch mode: sample counters and queue pointers every ms\n"
+        " -n count   number of watch samples (default: until interrupted)\n"
+        " -j         watch output as one JSON object per sample\n"
         " -v         verbose output\n",
         name);
 }
 
+static volatile sig_atomic_t watch_stop;
+
+static void watch_signal(int sig)
+{
+    (void)sig;
+    watch_stop = 1;
+}
+
+struct watch_queue
+{
+    const char *type;
+    struct mqnic_res *res;
+    int index;
+    uint32_t ptr_reg;
+    uint16_t last_prod;
+    uint16_t last_cons;
+};
+
+static int watch_add_queues(struct watch_queue *wq, int n, const char *type, struct mqnic_res *res,
+        uint32_t ctrl_reg, uint32_t enable_mask, uint32_t ptr_reg, int verbose)
+{
+    for (int k = 0; k < mqnic_res_get_count(res); k++)
+    {
+        volatile uint8_t *base = mqnic_res_get_addr(res, k);
+
+        if (!verbose && !(mqnic_reg_read32(base, ctrl_reg) & enable_mask))
+            continue;
+
+        wq[n].type = type;
+        wq[n].res = res;
+        wq[n].index = k;
+        wq[n].ptr_reg = ptr_reg;
+        n++;
+    }
+
+    return n;
+}
+
+static double watch_rate(uint64_t delta, double dt)
+{
+    return dt > 0 ? delta / dt : 0;
+}
+
+// sample the stats block and queue pointers at a fixed interval and print
+// per-second rates; queues are picked once up front, so each sample costs
+// one bulk pass over the counters plus one pointer read per queue, which
+// comes from host memory when the driver exposes a pointer shadow
+static int watch(struct mqnic *dev, struct mqnic_if *dev_interface, int interval_ms, int count, int json, int verbose)
+{
+    int queue_count = mqnic_res_get_count(dev_interface->eq_res) + mqnic_res_get_count(dev_interface->cq_res) +
+            mqnic_res_get_count(dev_interface->txq_res) + mqnic_res_get_count(dev_interface->rxq_res);
+    struct watch_queue *wq = calloc(queue_count ? queue_count : 1, sizeof(*wq));
+    int stats_count = dev->stats_rb ? dev->stats_count : 0;
+    uint64_t *stats = calloc(stats_count ? stats_count : 1, sizeof(*stats));
+    uint64_t *last_stats = calloc(stats_count ? stats_count : 1, sizeof(*last_stats));
+    struct timespec next, now, last;
+    int ret = 0;
+    int n = 0;
+
+    if (!wq || !stats || !last_stats)
+    {
+        perror("calloc failed");
+        ret = -1;
+        goto out;
+    }
+
+    n = watch_add_queues(wq, n, "eq", dev_interface->eq_res, MQNIC_EQ_CTRL_STATUS_REG, MQNIC_EQ_ENABLE_MASK, MQNIC_EQ_PTR_REG, verbose);
+    n = watch_add_queues(wq, n, "cq", dev_interface->cq_res, MQNIC_CQ_CTRL_STATUS_REG, MQNIC_CQ_ENABLE_MASK, MQNIC_CQ_PTR_REG, verbose);
+    n = watch_add_queues(wq, n, "txq", dev_interface->txq_res, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_ENABLE_MASK, MQNIC_QUEUE_PTR_REG, verbose);
+    n = watch_add_queues(wq, n, "rxq", dev_interface->rxq_res, MQNIC_QUEUE_CTRL_STATUS_REG, MQNIC_QUEUE_ENABLE_MASK, MQNIC_QUEUE_PTR_REG, verbose);
+
+    signal(SIGINT, watch_signal);
+    signal(SIGTERM, watch_signal);
+
+    // baseline
+    if (stats_count)
+        mqnic_stats_read_bulk(dev, 0, last_stats, stats_count);
+    for (int k = 0; k < n; k++)
+    {
+        uint32_t val = mqnic_res_read_ptr(wq[k].res, wq[k].index, wq[k].ptr_reg);
+        wq[k].last_prod = val & 0xffff;
+        wq[k].last_cons = val >> 16;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    next = last;
+
+    for (int sample = 0; !watch_stop && (count <= 0 || sample < count); sample++)
+    {
+        double dt;
+
+        next.tv_nsec += (long)interval_ms * 1000000;
+        while (next.tv_nsec >= 1000000000)
+        {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) && watch_stop)
+            break;
+
+        if (stats_count)
+            mqnic_stats_read_bulk(dev, 0, stats, stats_count);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        dt = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) * 1e-9;
+        last = now;
+
+        if (json)
+            printf("{\"t\": %ld.%09ld, \"dt\": %.6f, \"stats\": {", now.tv_sec, now.tv_nsec, dt);
+        else
+            printf("t=%ld.%03ld dt=%.3f ms\n", now.tv_sec, now.tv_nsec / 1000000, dt * 1e3);
+
+        int first = 1;
+        for (int k = 0; k < stats_count; k++)
+        {
+            uint64_t delta = stats[k] - last_stats[k];
+            last_stats[k] = stats[k];
+
+            if (!delta && !verbose)
+                continue;
+
+            if (json)
+                printf("%s\"%d\": %.0f", first ? "" : ", ", k, watch_rate(delta, dt));
+            else
+                printf("  stat %4d  %20lu  %16.0f/s\n", k, stats[k], watch_rate(delta, dt));
+            first = 0;
+        }
+
+        if (json)
+            printf("}, \"queues\": [");
+
+        first = 1;
+        for (int k = 0; k < n; k++)
+        {
+            uint32_t val = mqnic_res_read_ptr(wq[k].res, wq[k].index, wq[k].ptr_reg);
+            uint16_t prod = val & 0xffff;
+            uint16_t cons = val >> 16;
+            uint16_t prod_delta = prod - wq[k].last_prod;
+            uint16_t cons_delta = cons - wq[k].last_cons;
+            uint16_t occupancy = prod - cons;
+
+            wq[k].last_prod = prod;
+            wq[k].last_cons = cons;
+
+            if (!prod_delta && !cons_delta && !occupancy && !verbose)
+                continue;
+
+            if (json)
+                printf("%s{\"type\": \"%s\", \"index\": %d, \"prod\": %d, \"cons\": %d, \"len\": %d, \"prod_rate\": %.0f, \"cons_rate\": %.0f}",
+                        first ? "" : ", ", wq[k].type, wq[k].index, prod, cons, occupancy,
+                        watch_rate(prod_delta, dt), watch_rate(cons_delta, dt));
+            else
+                printf("  %-3s %4d  prod %6d  cons %6d  len %6d  %12.0f/s  %12.0f/s\n",
+                        wq[k].type, wq[k].index, prod, cons, occupancy,
+                        watch_rate(prod_delta, dt), watch_rate(cons_delta, dt));
+            first = 0;
+        }
+
+        if (json)
+            printf("]}\n");
+
+        fflush(stdout);
+    }
+
+out:
+    free(wq);
+    free(stats);
+    free(last_stats);
+
+    return ret;
+}
+
 int main(int argc, char *argv[])
 {
     char *name;
@@ -29,11 +206,14 @@ int main(int argc, char *argv[])
     struct mqnic *dev;
     int interface = 0;
     int verbose = 0;
+    int watch_ms = 0;
+    int watch_count = 0;
+    int json = 0;
 
     name = strrchr(argv[0], '/');
     name = name ? 1+name : argv[0];
 
-    while ((opt = getopt(argc, argv, "d:i:P:vh?")) != EOF)
+    while ((opt = getopt(argc, argv, "d:i:P:w:n:jvh?")) != EOF)
     {
         switch (opt)
         {
@@ -43,6 +223,15 @@ int main(int argc, char *argv[])
         case 'i':
             interface = atoi(optarg);
             break;
+        case 'w':
+            watch_ms = atoi(optarg);
+            break;
+        case 'n':
+            watch_count = atoi(optarg);
+            break;
+        case 'j':
+            json = 1;
+            break;
         case 'v':
             verbose++;
             break;
@@ -71,6 +260,21 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    if (watch_ms > 0)
+    {
+        struct mqnic_if *dev_interface = mqnic_get_interface(dev, interface);
+
+        if (!dev_interface)
+        {
+            fprintf(stderr, "Invalid interface\n");
+            ret = -1;
+            goto err;
+        }
+
+        ret = watch(dev, dev_interface, watch_ms, watch_count, json, verbose);
+        goto err;
+    }
+
     if (dev->pci_device_path[0])
     {
         char *ptr = strrchr(dev->pci_device_path, '/');
@@ -202,7 +406,7 @@ int main(int argc, char *argv[])
         goto err;
     }
 
-    struct mqnic_if *dev_interface = dev->interfaces[interface];
+    struct mqnic_if *dev_interface = mqnic_get_interface(dev, interface);
 
     if (!dev_interface)
     {
@@ -244,7 +448,10 @@ int main(int argc, char *argv[])
 
     for (int p = 0; p < dev_interface->port_count; p++)
     {
-        struct mqnic_port *dev_port = dev_interface->ports[p];
+        struct mqnic_port *dev_port = mqnic_if_get_port(dev_interface, p);
+
+        if (!dev_port)
+            continue;
 
         printf("Port-level register blocks (port %d):\n", p);
         for (struct mqnic_reg_block *rb = dev_port->rb_list; rb->regs; rb++)
@@ -276,7 +483,10 @@ int main(int argc, char *argv[])
 
     for (int s = 0; s < dev_interface->sched_block_count; s++)
     {
-        struct mqnic_sched_block *dev_sched_block = dev_interface->sched_blocks[s];
+        struct mqnic_sched_block *dev_sched_block = mqnic_if_get_sched_block(dev_interface, s);
+
+        if (!dev_sched_block)
+            continue;
 
         printf("Scheduler block-level register blocks (scheduler block %d):\n", s);
         for (struct mqnic_reg_block *rb = dev_sched_block->rb_list; rb->regs; rb++)
@@ -326,7 +536,7 @@ int main(int argc, char *argv[])
                 printf("Sched control: 0x%08x\n", mqnic_reg_read32(rb->regs, MQNIC_RB_SCHED_CTRL_TDMA_REG_CTRL));
                 printf("Sched timeslot count: %d\n", mqnic_reg_read32(rb->regs, MQNIC_RB_SCHED_CTRL_TDMA_REG_TS_COUNT));
             }
-            else if (rb->type == MQNIC_RB_TDMA_SCH_TYPE && rb->version == MQNIC_RB_TDMA_SCH_VER)
+            else if (rb->type == MQNIC_RB_TDMA_SCH_TYPE)
             {
                 printf("TDMA scheduler\n");
 
@@ -340,6 +550,16 @@ int main(int argc, char *argv[])
                 printf("TDMA schedule period: %d ns\n", mqnic_reg_read32(rb->regs, MQNIC_RB_TDMA_SCH_REG_SCH_PERIOD_NS));
                 printf("TDMA timeslot period: %d ns\n", mqnic_reg_read32(rb->regs, MQNIC_RB_TDMA_SCH_REG_TS_PERIOD_NS));
                 printf("TDMA active period:   %d ns\n", mqnic_reg_read32(rb->regs, MQNIC_RB_TDMA_SCH_REG_ACTIVE_PERIOD_NS));
+
+                if (rb->version >= MQNIC_RB_TDMA_SCH_VER_STAGED)
+                {
+                    val = mqnic_reg_read32(rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_CTRL);
+                    printf("TDMA commit time:     %ld.%09d s\n", mqnic_reg_read32(rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_L) +
+                            (((int64_t)mqnic_reg_read32(rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_SEC_H)) << 32),
+                            mqnic_reg_read32(rb->regs, MQNIC_RB_TDMA_SCH_REG_COMMIT_NS));
+                    printf("TDMA commit pending:  %d\n", val & MQNIC_TDMA_SCH_COMMIT_PENDING ? 1 : 0);
+                    printf("TDMA commit count:    %d\n", val >> 16);
+                }
             }
         }
     }
@@ -368,7 +588,7 @@ int main(int argc, char *argv[])
 
         uint64_t base_addr = (uint64_t)mqnic_reg_read32(base, MQNIC_EQ_BASE_ADDR_VF_REG) + ((uint64_t)mqnic_reg_read32(base, MQNIC_EQ_BASE_ADDR_VF_REG+4) << 32);
         base_addr &= 0xfffffffffffff000;
-        val = mqnic_reg_read32(base, MQNIC_EQ_PTR_REG);
+        val = mqnic_res_read_ptr(dev_interface->eq_res, k, MQNIC_EQ_PTR_REG);
         uint32_t prod_ptr = val & MQNIC_EQ_PTR_MASK;
         uint32_t cons_ptr = (val >> 16) & MQNIC_EQ_PTR_MASK;
         uint32_t occupancy = (prod_ptr - cons_ptr) & MQNIC_EQ_PTR_MASK;
@@ -400,7 +620,7 @@ int main(int argc, char *argv[])
 
         uint64_t base_addr = (uint64_t)mqnic_reg_read32(base, MQNIC_CQ_BASE_ADDR_VF_REG) + ((uint64_t)mqnic_reg_read32(base, MQNIC_CQ_BASE_ADDR_VF_REG+4) << 32);
         base_addr &= 0xfffffffffffff000;
-        val = mqnic_reg_read32(base, MQNIC_CQ_PTR_REG);
+        val = mqnic_res_read_ptr(dev_interface->cq_res, k, MQNIC_CQ_PTR_REG);
         uint32_t prod_ptr = val & MQNIC_CQ_PTR_MASK;
         uint32_t cons_ptr = (val >> 16) & MQNIC_CQ_PTR_MASK;
         uint32_t occupancy = (prod_ptr - cons_ptr) & MQNIC_CQ_PTR_MASK;
@@ -432,7 +652,7 @@ int main(int argc, char *argv[])
         uint32_t cqn = val & 0xffffff;
         uint8_t log_queue_size = (val >> 24) & 0xf;
         uint8_t log_desc_block_size = (val >> 28) & 0xf;
-        val = mqnic_reg_read32(base, MQNIC_QUEUE_PTR_REG);
+        val = mqnic_res_read_ptr(dev_interface->txq_res, k, MQNIC_QUEUE_PTR_REG);
         uint32_t prod_ptr = val & MQNIC_QUEUE_PTR_MASK;
         uint32_t cons_ptr = (val >> 16) & MQNIC_QUEUE_PTR_MASK;
         uint32_t occupancy = (prod_ptr - cons_ptr) & MQNIC_QUEUE_PTR_MASK;
@@ -464,7 +684,7 @@ int main(int argc, char *argv[])
         uint32_t cqn = val & 0xffffff;
         uint8_t log_queue_size = (val >> 24) & 0xf;
         uint8_t log_desc_block_size = (val >> 28) & 0xf;
-        val = mqnic_reg_read32(base, MQNIC_QUEUE_PTR_REG);
+        val = mqnic_res_read_ptr(dev_interface->rxq_res, k, MQNIC_QUEUE_PTR_REG);
         uint32_t prod_ptr = val & MQNIC_QUEUE_PTR_MASK;
         uint32_t cons_ptr = (val >> 16) & MQNIC_QUEUE_PTR_MASK;
         uint32_t occupancy = (prod_ptr - cons_ptr) & MQNIC_QUEUE_PTR_MASK;
@@ -474,7 +694,10 @@ int main(int argc, char *argv[])
 
     for (int s = 0; s < dev_interface->sched_block_count; s++)
     {
-        struct mqnic_sched_block *dev_sched_block = dev_interface->sched_blocks[s];
+        struct mqnic_sched_block *dev_sched_block = mqnic_if_get_sched_block(dev_interface, s);
+
+        if (!dev_sched_block)
+            continue;
 
         for (int k = 0; k < dev_sched_block->sched_count; k++)
         {
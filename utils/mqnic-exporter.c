@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: BSD-2-Clause-Views
+/*
+ * Copyright (c) 2026 The Regents of the University of California
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <mqnic/mqnic.h>
+
+static void usage(char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        " -d name    device to open (/dev/mqnic0)\n"
+        " -p port    TCP port to serve /metrics on (default 9437)\n"
+        " -a addr    address to bind (default 127.0.0.1)\n"
+        " -o         write one snapshot to stdout and exit\n"
+        " -v         also export unnamed counters that are nonzero\n",
+        name);
+}
+
+static volatile sig_atomic_t stop;
+
+static void handle_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+// render one snapshot in the Prometheus text exposition format
+static int format_metrics(struct mqnic *dev, const char *label, uint64_t *stats, int verbose, FILE *f)
+{
+    int count = mqnic_stats_snapshot(dev, stats, dev->stats_count);
+
+    if (count < 0)
+        return -1;
+
+    fprintf(f, "# HELP mqnic_stat Hardware statistics counter\n");
+    fprintf(f, "# TYPE mqnic_stat counter\n");
+
+    for (int k = 0; k < count; k++)
+    {
+        const char *stat_name = mqnic_stats_name(k);
+
+        if (stat_name)
+            fprintf(f, "mqnic_stat{device=\"%s\",index=\"%d\",name=\"%s\"} %lu\n", label, k, stat_name, stats[k]);
+        else if (verbose && stats[k])
+            fprintf(f, "mqnic_stat{device=\"%s\",index=\"%d\"} %lu\n", label, k, stats[k]);
+    }
+
+    return 0;
+}
+
+static void serve_client(int fd, struct mqnic *dev, const char *label, uint64_t *stats, int verbose)
+{
+    char req[1024];
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *f;
+    ssize_t len;
+    char hdr[256];
+    int hdr_len;
+
+    // only the request line matters, the rest of the headers are ignored
+    len = read(fd, req, sizeof(req)-1);
+    if (len <= 0)
+        return;
+    req[len] = 0;
+
+    if (strncmp(req, "GET /metrics", 12) && strncmp(req, "GET / ", 6))
+    {
+        static const char not_found[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        if (write(fd, not_found, sizeof(not_found)-1) < 0)
+            perror("write failed");
+        return;
+    }
+
+    f = open_memstream(&body, &body_len);
+    if (!f)
+    {
+        perror("open_memstream failed");
+        return;
+    }
+
+    format_metrics(dev, label, stats, verbose, f);
+    fclose(f);
+
+    hdr_len = snprintf(hdr, sizeof(hdr),
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n\r\n", body_len);
+
+    if (write(fd, hdr, hdr_len) < 0 || write(fd, body, body_len) < 0)
+        perror("write failed");
+
+    free(body);
+}
+
+int main(int argc, char *argv[])
+{
+    char *name;
+    int opt;
+    int ret = 0;
+
+    char *device = NULL;
+    struct mqnic *dev;
+    char *addr = "127.0.0.1";
+    int port = 9437;
+    int once = 0;
+    int verbose = 0;
+
+    const char *label;
+    uint64_t *stats = NULL;
+    struct sockaddr_in sa;
+    int sock = -1;
+    int val = 1;
+
+    name = strrchr(argv[0], '/');
+    name = name ? 1+name : argv[0];
+
+    while ((opt = getopt(argc, argv, "d:p:a:ovh?")) != EOF)
+    {
+        switch (opt)
+        {
+        case 'd':
+            device = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'a':
+            addr = optarg;
+            break;
+        case 'o':
+            once = 1;
+            break;
+        case 'v':
+            verbose++;
+            break;
+        case 'h':
+        case '?':
+            usage(name);
+            return 0;
+        default:
+            usage(name);
+            return -1;
+        }
+    }
+
+    if (!device)
+    {
+        fprintf(stderr, "Device not specified\n");
+        usage(name);
+        return -1;
+    }
+
+    dev = mqnic_open(device);
+
+    if (!dev)
+    {
+        fprintf(stderr, "Failed to open device\n");
+        return -1;
+    }
+
+    if (!dev->stats_rb)
+    {
+        fprintf(stderr, "Statistics block not found\n");
+        ret = -1;
+        goto err;
+    }
+
+    label = strrchr(device, '/');
+    label = label ? label+1 : device;
+
+    stats = calloc(dev->stats_count, sizeof(*stats));
+    if (!stats)
+    {
+        perror("calloc failed");
+        ret = -1;
+        goto err;
+    }
+
+    if (once)
+    {
+        ret = format_metrics(dev, label, stats, verbose, stdout);
+        goto err;
+    }
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+    {
+        perror("socket failed");
+        ret = -1;
+        goto err;
+    }
+
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid address: %s\n", addr);
+        ret = -1;
+        goto err;
+    }
+
+    if (bind(sock, (struct sockaddr *)&sa, sizeof(sa)) || listen(sock, 16))
+    {
+        perror("bind failed");
+        ret = -1;
+        goto err;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    // one scrape at a time; each is a single bulk pass over the stats block
+    while (!stop)
+    {
+        int fd = accept(sock, NULL, NULL);
+
+        if (fd < 0)
+            continue;
+
+        serve_client(fd, dev, label, stats, verbose);
+        close(fd);
+    }
+
+err:
+    if (sock >= 0)
+        close(sock);
+
+    free(stats);
+
+    mqnic_close(dev);
+
+    return ret;
+}
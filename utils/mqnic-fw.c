@@ -5,13 +5,16 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <glob.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <linux/pci.h>
 
 #include <mqnic/mqnic.h>
@@ -19,6 +22,7 @@
 #include "flash.h"
 
 #define MAX_SEGMENTS 8
+#define MAX_DEVICES 64
 
 uint32_t reverse_bits_32(uint32_t x)
 {
@@ -47,6 +51,38 @@ uint8_t reverse_bits_8(uint8_t x)
     return x;
 }
 
+// in-place bit reversal of each 8 or 16 bit word, table driven
+void reverse_bits_buf(void *buf, size_t len, int word_size)
+{
+    static uint8_t table[256];
+    static int table_init = 0;
+    uint8_t *p = buf;
+    uint8_t t;
+
+    if (!table_init)
+    {
+        for (int k = 0; k < 256; k++)
+            table[k] = reverse_bits_8(k);
+        table_init = 1;
+    }
+
+    if (word_size == 16)
+    {
+        // same as reverse_bits_16 on each little endian word
+        for (size_t k = 0; k+1 < len; k += 2)
+        {
+            t = p[k];
+            p[k] = table[p[k+1]];
+            p[k+1] = table[t];
+        }
+    }
+    else
+    {
+        for (size_t k = 0; k < len; k++)
+            p[k] = table[p[k]];
+    }
+}
+
 char* stristr(const char *str1, const char *str2)
 {
     const char* p1 = str1;
@@ -93,14 +129,17 @@ static void usage(char *name)
 {
     fprintf(stderr,
         "usage: %s [options]\n"
-        " -d name    device to open (/dev/mqnic0)\n"
+        " -d name    device to open (/dev/mqnic0), repeat to update several in parallel\n"
+        " -a         update all /dev/mqnic* devices in parallel\n"
         " -s slot    slot to program\n"
         " -r file    read flash to file\n"
         " -w file    write and verify flash from file\n"
         " -e         erase flash\n"
         " -b         boot FPGA from flash\n"
         " -t         hot reset FPGA\n"
-        " -y         no interactive confirm\n",
+        " -y         no interactive confirm\n"
+        " -D         only erase and program flash blocks that differ from the file\n"
+        " -B         bit-bang SPI flash even if a SPI engine is present\n",
         name);
 }
 
@@ -212,84 +251,89 @@ err:
     return ret;
 }
 
-int flash_write_verify_progress(struct flash_device *fdev, size_t addr, size_t len, const void *src)
+#define VERIFY_CHUNK_SIZE 0x100000
+#define VERIFY_RETRY_SIZE 0x1000
+
+// re-read one mismatching range a few times before calling it a failure,
+// so that a glitched read does not fail the whole update
+static int flash_verify_range(struct flash_device *fdev, size_t addr, size_t len, const uint8_t *ptr, uint8_t *buf)
+{
+    int reported = 0;
+
+    for (int read_attempts = 3; read_attempts > 0; read_attempts--)
+    {
+        if (flash_read(fdev, addr, len, buf))
+        {
+            fprintf(stderr, "\nRead failed\n");
+            return -1;
+        }
+
+        if (!memcmp(ptr, buf, len))
+            return 0;
+    }
+
+    fprintf(stderr, "\nVerify failed\n");
+
+    for (size_t k = 0; k < len && reported < 16; k++)
+    {
+        if (ptr[k] != buf[k])
+        {
+            fprintf(stderr, "flash offset 0x%08lx: expected 0x%02x, read 0x%02x\n",
+                addr+k, ptr[k], buf[k]);
+            reported++;
+        }
+    }
+
+    return -1;
+}
+
+// read the whole region back in large chunks; only mismatching sub-ranges
+// are read again
+int flash_verify_progress(struct flash_device *fdev, size_t addr, size_t len, const void *src)
 {
     int ret = 0;
     size_t remain = len;
     size_t seg;
-    int step = 0x10000;
     const uint8_t *ptr = src;
     uint8_t *check_buf;
+    uint8_t *retry_buf;
 
-    printf("Start address: 0x%08lx\n", addr);
-    printf("Length: 0x%08lx\n", len);
-
-    step = fdev->write_buffer_size > step ? fdev->write_buffer_size : step;
-
-    check_buf = calloc(step, 1);
+    check_buf = calloc(VERIFY_CHUNK_SIZE, 1);
+    retry_buf = calloc(VERIFY_RETRY_SIZE, 1);
 
-    if (!check_buf)
-        return -1;
+    if (!check_buf || !retry_buf)
+    {
+        ret = -1;
+        goto err;
+    }
 
     while (remain > 0)
     {
-        if (remain > step)
-        {
-            // longer than step, trim
-            if ((addr + step) & (step-1))
-            {
-                // align to step size
-                seg = step - ((addr + step) & (step-1));
-            }
-            else
-            {
-                // already aligned
-                seg = step;
-            }
-        }
-        else
-        {
-            // shorter than step
-            seg = remain;
-        }
+        seg = remain > VERIFY_CHUNK_SIZE ? VERIFY_CHUNK_SIZE : remain;
 
-        printf("Write/verify address 0x%08lx, length 0x%08lx (%ld%%)\r", addr, seg, (100*(len-remain))/len);
+        printf("Verify address 0x%08lx, length 0x%08lx (%ld%%)\r", addr, seg, (100*(len-remain))/len);
         fflush(stdout);
 
-        ret = flash_write(fdev, addr, seg, ptr);
+        ret = flash_read(fdev, addr, seg, check_buf);
 
         if (ret) {
-            fprintf(stderr, "\nWrite failed\n");
+            fprintf(stderr, "\nRead failed\n");
             goto err;
         }
 
-        for (int read_attempts = 3; read_attempts >= 0; read_attempts--)
+        if (memcmp(ptr, check_buf, seg))
         {
-            ret = flash_read(fdev, addr, seg, check_buf);
-
-            if (ret) {
-                fprintf(stderr, "\nRead failed\n");
-                goto err;
-            }
-
-            if (memcmp(ptr, check_buf, seg))
+            for (size_t k = 0; k < seg; k += VERIFY_RETRY_SIZE)
             {
-                fprintf(stderr, "\nVerify failed (%d more attempts)\n", read_attempts);
-
-                for (size_t k = 0; k < seg; k++)
-                {
-                    if (ptr[k] != check_buf[k])
-                    {
-                        fprintf(stderr, "flash offset 0x%08lx: expected 0x%02x, read 0x%02x\n",
-                            addr+k, ptr[k], check_buf[k]);
-                    }
-                }
+                size_t n = seg - k > VERIFY_RETRY_SIZE ? VERIFY_RETRY_SIZE : seg - k;
 
-                if (read_attempts > 0)
+                if (!memcmp(ptr+k, check_buf+k, n))
                     continue;
 
-                ret = -1;
-                goto err;
+                ret = flash_verify_range(fdev, addr+k, n, ptr+k, retry_buf);
+
+                if (ret)
+                    goto err;
             }
         }
 
@@ -302,9 +346,22 @@ int flash_write_verify_progress(struct flash_device *fdev, size_t addr, size_t l
 
 err:
     free(check_buf);
+    free(retry_buf);
     return ret;
 }
 
+int flash_write_verify_progress(struct flash_device *fdev, size_t addr, size_t len, const void *src)
+{
+    int ret;
+
+    ret = flash_write_progress(fdev, addr, len, src);
+
+    if (ret)
+        return ret;
+
+    return flash_verify_progress(fdev, addr, len, src);
+}
+
 int flash_erase_progress(struct flash_device *fdev, size_t addr, size_t len)
 {
     int ret;
@@ -356,6 +413,105 @@ int flash_erase_progress(struct flash_device *fdev, size_t addr, size_t len)
     return 0;
 }
 
+// compare each erase block against the image and only erase and program
+// the ones that differ; a block is programmed without an erase when the
+// new data only clears bits
+int flash_update_progress(struct flash_device *fdev, size_t addr, size_t len, const void *src)
+{
+    int ret = 0;
+    size_t remain = len;
+    size_t seg;
+    size_t step = fdev->erase_block_size;
+    const uint8_t *ptr = src;
+    uint8_t *check_buf;
+    size_t skipped = 0;
+    size_t programmed = 0;
+    size_t erased = 0;
+
+    printf("Start address: 0x%08lx\n", addr);
+    printf("Length: 0x%08lx\n", len);
+
+    if (!step)
+        step = 0x10000;
+
+    check_buf = calloc(step, 1);
+
+    if (!check_buf)
+        return -1;
+
+    while (remain > 0)
+    {
+        int need_erase = 0;
+
+        seg = step - (addr & (step-1));
+        if (seg > remain)
+            seg = remain;
+
+        printf("Update address 0x%08lx, length 0x%08lx (%ld%%)\r", addr, seg, (100*(len-remain))/len);
+        fflush(stdout);
+
+        ret = flash_read(fdev, addr, seg, check_buf);
+
+        if (ret) {
+            fprintf(stderr, "\nRead failed\n");
+            goto err;
+        }
+
+        if (!memcmp(ptr, check_buf, seg))
+        {
+            skipped++;
+            goto next;
+        }
+
+        for (size_t k = 0; k < seg; k++)
+        {
+            if ((check_buf[k] & ptr[k]) != ptr[k])
+            {
+                need_erase = 1;
+                break;
+            }
+        }
+
+        if (need_erase)
+        {
+            ret = flash_erase(fdev, addr, seg);
+
+            if (ret) {
+                fprintf(stderr, "\nErase failed\n");
+                goto err;
+            }
+
+            erased++;
+        }
+
+        ret = flash_write(fdev, addr, seg, ptr);
+
+        if (ret) {
+            fprintf(stderr, "\nWrite failed\n");
+            goto err;
+        }
+
+        ret = flash_verify_range(fdev, addr, seg, ptr, check_buf);
+
+        if (ret)
+            goto err;
+
+        programmed++;
+
+next:
+        addr += seg;
+        remain -= seg;
+        ptr += seg;
+    }
+
+    printf("\n");
+    printf("Blocks unchanged: %ld, programmed: %ld (%ld erased)\n", skipped, programmed, erased);
+
+err:
+    free(check_buf);
+    return ret;
+}
+
 int write_str_to_file(const char *file_name, const char *str)
 {
     int ret = 0;
@@ -510,6 +666,209 @@ int pcie_disable_fatal_err(const char *pci_port_path)
     return 0;
 }
 
+struct fleet_worker {
+    const char *device;
+    const char *label;
+    pid_t pid;
+    int fd;
+    char line[256];
+    size_t line_len;
+    char phase[32];
+    int percent;
+};
+
+// fork one worker per device, each running the normal single device flow
+// with its output on a pipe; returns the device index in the child and -1
+// in the parent
+static int fleet_start(struct fleet_worker *w, int count)
+{
+    int fds[2];
+
+    fflush(stdout);
+    fflush(stderr);
+
+    for (int k = 0; k < count; k++)
+    {
+        w[k].label = strrchr(w[k].device, '/');
+        w[k].label = w[k].label ? w[k].label+1 : w[k].device;
+        w[k].fd = -1;
+        w[k].pid = -1;
+        w[k].percent = -1;
+
+        if (pipe(fds))
+        {
+            perror("pipe failed");
+            continue;
+        }
+
+        w[k].pid = fork();
+
+        if (w[k].pid == 0)
+        {
+            int fd = open("/dev/null", O_RDONLY);
+
+            for (int j = 0; j < k; j++)
+                if (w[j].fd >= 0)
+                    close(w[j].fd);
+
+            close(fds[0]);
+            dup2(fds[1], STDOUT_FILENO);
+            dup2(fds[1], STDERR_FILENO);
+            close(fds[1]);
+
+            if (fd >= 0)
+            {
+                dup2(fd, STDIN_FILENO);
+                close(fd);
+            }
+
+            setvbuf(stdout, NULL, _IOLBF, 0);
+
+            return k;
+        }
+
+        close(fds[1]);
+
+        if (w[k].pid < 0)
+        {
+            perror("fork failed");
+            close(fds[0]);
+            continue;
+        }
+
+        w[k].fd = fds[0];
+    }
+
+    return -1;
+}
+
+static int fleet_progress_width;
+
+static void fleet_show_progress(struct fleet_worker *w, int count)
+{
+    char buf[1024];
+    int len = 0;
+
+    for (int k = 0; k < count && len < sizeof(buf); k++)
+    {
+        if (w[k].percent < 0)
+            continue;
+
+        len += snprintf(buf+len, sizeof(buf)-len, "%s%s %s %d%%", len ? " | " : "",
+                w[k].label, w[k].phase, w[k].percent);
+    }
+
+    printf("\r%-*s", fleet_progress_width, buf);
+    fleet_progress_width = len;
+    fflush(stdout);
+}
+
+static void fleet_line(struct fleet_worker *w, int k, int count, int progress)
+{
+    char *ptr;
+    int percent;
+
+    w[k].line[w[k].line_len] = 0;
+    w[k].line_len = 0;
+
+    // progress lines end with "(NN%)" and are folded into one status line
+    ptr = strrchr(w[k].line, '(');
+    if (progress && ptr && sscanf(ptr, "(%d%%)", &percent) == 1)
+    {
+        w[k].percent = percent;
+        sscanf(w[k].line, "%31s", w[k].phase);
+        fleet_show_progress(w, count);
+        return;
+    }
+
+    if (!w[k].line[0])
+        return;
+
+    printf("\r%-*s\r[%s] %s\n", fleet_progress_width, "", w[k].label, w[k].line);
+    fleet_progress_width = 0;
+    fleet_show_progress(w, count);
+}
+
+static int fleet_wait(struct fleet_worker *w, int count)
+{
+    struct pollfd pfd[MAX_DEVICES];
+    char buf[4096];
+    int open_count = 0;
+    int ret = 0;
+    int status;
+
+    for (int k = 0; k < count; k++)
+        if (w[k].fd >= 0)
+            open_count++;
+
+    while (open_count > 0)
+    {
+        for (int k = 0; k < count; k++)
+        {
+            pfd[k].fd = w[k].fd;
+            pfd[k].events = POLLIN;
+        }
+
+        if (poll(pfd, count, -1) < 0)
+        {
+            perror("poll failed");
+            break;
+        }
+
+        for (int k = 0; k < count; k++)
+        {
+            ssize_t len;
+
+            if (w[k].fd < 0 || !(pfd[k].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            len = read(w[k].fd, buf, sizeof(buf));
+
+            if (len <= 0)
+            {
+                if (w[k].line_len)
+                    fleet_line(w, k, count, 0);
+                close(w[k].fd);
+                w[k].fd = -1;
+                open_count--;
+                continue;
+            }
+
+            for (ssize_t i = 0; i < len; i++)
+            {
+                if (buf[i] == '\r' || buf[i] == '\n')
+                    fleet_line(w, k, count, buf[i] == '\r');
+                else if (w[k].line_len < sizeof(w[k].line)-1)
+                    w[k].line[w[k].line_len++] = buf[i];
+            }
+        }
+    }
+
+    printf("\r%-*s\r", fleet_progress_width, "");
+
+    for (int k = 0; k < count; k++)
+    {
+        if (w[k].pid < 0)
+        {
+            printf("%s: not started\n", w[k].label);
+            ret = -1;
+            continue;
+        }
+
+        if (waitpid(w[k].pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            printf("%s: failed\n", w[k].label);
+            ret = -1;
+        }
+        else
+        {
+            printf("%s: done\n", w[k].label);
+        }
+    }
+
+    return ret;
+}
+
 int main(int argc, char *argv[])
 {
     char *name;
@@ -517,6 +876,10 @@ int main(int argc, char *argv[])
     int ret = 0;
 
     char *device = NULL;
+    const char *devices[MAX_DEVICES];
+    int device_count = 0;
+    int scan_all = 0;
+    glob_t dev_glob;
     char *read_file_name = NULL;
     FILE *read_file = NULL;
     char *write_file_name = NULL;
@@ -535,10 +898,13 @@ int main(int argc, char *argv[])
     char action_boot = 0;
     char action_reset = 0;
     char no_confirm = 0;
+    char no_engine = 0;
+    char delta = 0;
 
     struct mqnic *dev = NULL;
 
     struct mqnic_reg_block *flash_rb = NULL;
+    volatile uint8_t *engine_regs[2] = {NULL, NULL};
 
     struct flash_device *pri_flash = NULL;
     struct flash_device *sec_flash = NULL;
@@ -550,12 +916,17 @@ int main(int argc, char *argv[])
     name = strrchr(argv[0], '/');
     name = name ? 1+name : argv[0];
 
-    while ((opt = getopt(argc, argv, "d:s:r:w:ebtyh?")) != EOF)
+    while ((opt = getopt(argc, argv, "d:as:r:w:ebtyDBh?")) != EOF)
     {
         switch (opt)
         {
         case 'd':
             device = optarg;
+            if (device_count < MAX_DEVICES)
+                devices[device_count++] = optarg;
+            break;
+        case 'a':
+            scan_all = 1;
             break;
         case 's':
             slot = atoi(optarg);
@@ -581,6 +952,12 @@ int main(int argc, char *argv[])
         case 'y':
             no_confirm = 1;
             break;
+        case 'D':
+            delta = 1;
+            break;
+        case 'B':
+            no_engine = 1;
+            break;
         case 'h':
         case '?':
             usage(name);
@@ -591,6 +968,73 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (scan_all)
+    {
+        device_count = 0;
+
+        if (glob("/dev/mqnic[0-9]*", 0, NULL, &dev_glob) == 0)
+        {
+            for (size_t k = 0; k < dev_glob.gl_pathc && device_count < MAX_DEVICES; k++)
+                devices[device_count++] = dev_glob.gl_pathv[k];
+        }
+
+        if (device_count == 0)
+        {
+            fprintf(stderr, "No devices found\n");
+            return -1;
+        }
+
+        device = (char *)devices[0];
+    }
+
+    if (device_count > 1)
+    {
+        struct fleet_worker workers[MAX_DEVICES];
+        int k;
+
+        if (action_read)
+        {
+            fprintf(stderr, "Reading flash is not supported for multiple devices\n");
+            return -1;
+        }
+
+        printf("Devices:");
+        for (k = 0; k < device_count; k++)
+            printf(" %s", devices[k]);
+        printf("\n");
+
+        // workers cannot ask, so confirm once for all of them
+        if (!no_confirm && (action_erase || action_write || action_boot || action_reset))
+        {
+            char str[32];
+
+            printf("Are you sure you want to update %d devices?\n", device_count);
+            printf("[y/N]: ");
+
+            fgets(str, sizeof(str), stdin);
+
+            if (str[0] != 'y' && str[0] != 'Y')
+                return 0;
+        }
+
+        memset(workers, 0, sizeof(workers));
+        for (k = 0; k < device_count; k++)
+            workers[k].device = devices[k];
+
+        k = fleet_start(workers, device_count);
+
+        if (k < 0)
+        {
+            ret = fleet_wait(workers, device_count);
+            if (scan_all)
+                globfree(&dev_glob);
+            return ret;
+        }
+
+        device = (char *)workers[k].device;
+        no_confirm = 1;
+    }
+
     if (!device)
     {
         fprintf(stderr, "Device not specified\n");
@@ -711,11 +1155,22 @@ int main(int argc, char *argv[])
 
         printf("Data width: %d\n", flash_data_width);
 
+        // shift register engines, one per chip select
+        for (int k = 0; k < 2 && !no_engine; k++)
+        {
+            struct mqnic_reg_block *rb = mqnic_find_reg_block(dev->rb_list, MQNIC_RB_SPI_FLASH_ENGINE_TYPE, MQNIC_RB_SPI_FLASH_ENGINE_VER, k);
+
+            if (rb)
+                engine_regs[k] = rb->regs;
+        }
+
+        printf("SPI engine: %s\n", engine_regs[0] ? "present" : "not present, using bit-bang access");
+
         if (flash_data_width > 4)
         {
             dual_qspi = 1;
-            pri_flash = flash_open_spi(4, flash_rb->regs+MQNIC_RB_SPI_FLASH_REG_CTRL_0);
-            sec_flash = flash_open_spi(4, flash_rb->regs+MQNIC_RB_SPI_FLASH_REG_CTRL_1);
+            pri_flash = flash_open_spi(4, flash_rb->regs+MQNIC_RB_SPI_FLASH_REG_CTRL_0, engine_regs[0]);
+            sec_flash = flash_open_spi(4, flash_rb->regs+MQNIC_RB_SPI_FLASH_REG_CTRL_1, engine_regs[1]);
 
             if (!pri_flash || !sec_flash)
             {
@@ -728,7 +1183,7 @@ int main(int argc, char *argv[])
         }
         else
         {
-            pri_flash = flash_open_spi(flash_data_width, flash_rb->regs+MQNIC_RB_SPI_FLASH_REG_CTRL_0);
+            pri_flash = flash_open_spi(flash_data_width, flash_rb->regs+MQNIC_RB_SPI_FLASH_REG_CTRL_0, engine_regs[0]);
 
             if (!pri_flash)
             {
@@ -758,6 +1213,7 @@ int main(int argc, char *argv[])
                 flash_segment0_length = 0;
                 break;
             case MQNIC_RB_BPI_FLASH_VER:
+            case MQNIC_RB_BPI_FLASH_VER_ADDR_INC:
                 flash_configuration = flash_format & 0xf;
                 flash_default_segment = (flash_format >> 4) & 0xf;
                 flash_fallback_segment = (flash_format >> 8) & 0xf;
@@ -804,6 +1260,8 @@ int main(int argc, char *argv[])
             goto skip_flash;
         }
 
+        pri_flash->addr_auto_inc = flash_rb->version >= MQNIC_RB_BPI_FLASH_VER_ADDR_INC;
+
         flash_size = pri_flash->size;
     }
     else
@@ -1085,29 +1543,10 @@ int main(int argc, char *argv[])
 
         // TODO check for and confirm FPGA ID
 
+        // padding is 0xff, which reversal leaves alone, so only the image
+        // itself needs to be converted
         if (bitswap)
-        {
-            if (word_size == 16)
-            {
-                uint16_t *p = (uint16_t *)segment;
-
-                for (size_t k = 0; k < segment_size; k += 2)
-                {
-                    *p = reverse_bits_16(*p);
-                    p++;
-                }
-            }
-            else
-            {
-                uint8_t *p = (uint8_t *)segment;
-
-                for (size_t k = 0; k < segment_size; k++)
-                {
-                    *p = reverse_bits_8(*p);
-                    p++;
-                }
-            }
-        }
+            reverse_bits_buf(segment, (len + 1) & ~(size_t)1, word_size);
 
         if (dual_qspi)
         {
@@ -1166,48 +1605,75 @@ int main(int argc, char *argv[])
                     goto err;
             }
 
-            printf("Erasing primary flash...\n");
-            if (flash_erase_progress(pri_flash, segment_offset/2, len_int))
+            if (delta)
             {
-                fprintf(stderr, "Erase failed!\n");
-                ret = -1;
-                free(segment);
-                free(pri_buf);
-                free(sec_buf);
-                goto err;
-            }
+                printf("Updating primary flash...\n");
+                if (flash_update_progress(pri_flash, segment_offset/2, len_int, pri_buf))
+                {
+                    fprintf(stderr, "Update failed!\n");
+                    ret = -1;
+                    free(segment);
+                    free(pri_buf);
+                    free(sec_buf);
+                    goto err;
+                }
 
-            printf("Erasing secondary flash...\n");
-            if (flash_erase_progress(sec_flash, segment_offset/2, len_int))
-            {
-                fprintf(stderr, "Erase failed!\n");
-                ret = -1;
-                free(segment);
-                free(pri_buf);
-                free(sec_buf);
-                goto err;
+                printf("Updating secondary flash...\n");
+                if (flash_update_progress(sec_flash, segment_offset/2, len_int, sec_buf))
+                {
+                    fprintf(stderr, "Update failed!\n");
+                    ret = -1;
+                    free(segment);
+                    free(pri_buf);
+                    free(sec_buf);
+                    goto err;
+                }
             }
-
-            printf("Writing and verifying primary flash...\n");
-            if (flash_write_verify_progress(pri_flash, segment_offset/2, len_int, pri_buf))
+            else
             {
-                fprintf(stderr, "Write/verify failed!\n");
-                ret = -1;
-                free(segment);
-                free(pri_buf);
-                free(sec_buf);
-                goto err;
-            }
+                printf("Erasing primary flash...\n");
+                if (flash_erase_progress(pri_flash, segment_offset/2, len_int))
+                {
+                    fprintf(stderr, "Erase failed!\n");
+                    ret = -1;
+                    free(segment);
+                    free(pri_buf);
+                    free(sec_buf);
+                    goto err;
+                }
 
-            printf("Writing and verifying secondary flash...\n");
-            if (flash_write_verify_progress(sec_flash, segment_offset/2, len_int, sec_buf))
-            {
-                fprintf(stderr, "Write/verify failed!\n");
-                ret = -1;
-                free(segment);
-                free(pri_buf);
-                free(sec_buf);
-                goto err;
+                printf("Erasing secondary flash...\n");
+                if (flash_erase_progress(sec_flash, segment_offset/2, len_int))
+                {
+                    fprintf(stderr, "Erase failed!\n");
+                    ret = -1;
+                    free(segment);
+                    free(pri_buf);
+                    free(sec_buf);
+                    goto err;
+                }
+
+                printf("Writing and verifying primary flash...\n");
+                if (flash_write_verify_progress(pri_flash, segment_offset/2, len_int, pri_buf))
+                {
+                    fprintf(stderr, "Write/verify failed!\n");
+                    ret = -1;
+                    free(segment);
+                    free(pri_buf);
+                    free(sec_buf);
+                    goto err;
+                }
+
+                printf("Writing and verifying secondary flash...\n");
+                if (flash_write_verify_progress(sec_flash, segment_offset/2, len_int, sec_buf))
+                {
+                    fprintf(stderr, "Write/verify failed!\n");
+                    ret = -1;
+                    free(segment);
+                    free(pri_buf);
+                    free(sec_buf);
+                    goto err;
+                }
             }
 
             printf("Programming succeeded!\n");
@@ -1238,22 +1704,36 @@ int main(int argc, char *argv[])
                     goto err;
             }
 
-            printf("Erasing flash...\n");
-            if (flash_erase_progress(pri_flash, segment_offset, len))
+            if (delta)
             {
-                fprintf(stderr, "Erase failed!\n");
-                ret = -1;
-                free(segment);
-                goto err;
+                printf("Updating flash...\n");
+                if (flash_update_progress(pri_flash, segment_offset, len, segment))
+                {
+                    fprintf(stderr, "Update failed!\n");
+                    ret = -1;
+                    free(segment);
+                    goto err;
+                }
             }
-
-            printf("Writing and verifying flash...\n");
-            if (flash_write_verify_progress(pri_flash, segment_offset, len, segment))
+            else
             {
-                fprintf(stderr, "Write/verify failed!\n");
-                ret = -1;
-                free(segment);
-                goto err;
+                printf("Erasing flash...\n");
+                if (flash_erase_progress(pri_flash, segment_offset, len))
+                {
+                    fprintf(stderr, "Erase failed!\n");
+                    ret = -1;
+                    free(segment);
+                    goto err;
+                }
+
+                printf("Writing and verifying flash...\n");
+                if (flash_write_verify_progress(pri_flash, segment_offset, len, segment))
+                {
+                    fprintf(stderr, "Write/verify failed!\n");
+                    ret = -1;
+                    free(segment);
+                    goto err;
+                }
             }
 
             printf("Programming succeeded!\n");
@@ -1302,28 +1782,7 @@ int main(int argc, char *argv[])
         }
 
         if (bitswap)
-        {
-            if (word_size == 16)
-            {
-                uint16_t *p = (uint16_t *)segment;
-
-                for (size_t k = 0; k < segment_size; k += 2)
-                {
-                    *p = reverse_bits_16(*p);
-                    p++;
-                }
-            }
-            else
-            {
-                uint8_t *p = (uint8_t *)segment;
-
-                for (size_t k = 0; k < segment_size; k++)
-                {
-                    *p = reverse_bits_8(*p);
-                    p++;
-                }
-            }
-        }
+            reverse_bits_buf(segment, segment_size, word_size);
 
         int file_type = file_type_from_ext(read_file_name);
 
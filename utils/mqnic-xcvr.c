@@ -21,10 +21,233 @@ static void usage(char *name)
         " -p preset  Load channel preset\n"
         " -r         Read registers\n"
         " -t [side]  Reset channels (tx, rx, txrx, default txrx)\n"
-        " -c file    Run eye scan and write CSV\n",
+        " -c file    Run eye scan and write CSV\n"
+        " -s field   Sweep channel register field addr:msb:lsb:start:stop[:step]\n"
+        "            (repeat for a joint sweep), keep the best eye per channel\n",
         name);
 }
 
+#define SWEEP_MAX_FIELDS 4
+#define SWEEP_MAX_CH (16*4)
+
+struct sweep_field {
+    uint32_t addr;
+    uint32_t mask;
+    uint32_t shift;
+    int start;
+    int stop;
+    int step;
+};
+
+static int parse_sweep_field(const char *str, struct sweep_field *field)
+{
+    int addr, msb, lsb;
+    int n;
+
+    field->step = 1;
+
+    n = sscanf(str, "%i:%i:%i:%i:%i:%i", &addr, &msb, &lsb, &field->start, &field->stop, &field->step);
+
+    if (n < 5 || addr < 0 || lsb < 0 || msb < lsb || msb > 15 || field->step <= 0 ||
+            field->start < 0 || field->stop < field->start || field->stop >> (msb-lsb+1))
+        return -1;
+
+    field->addr = addr;
+    field->shift = lsb;
+    field->mask = ((1 << (msb-lsb+1)) - 1) << lsb;
+
+    return 0;
+}
+
+static int sweep_field_count(const struct sweep_field *field)
+{
+    return (field->stop - field->start) / field->step + 1;
+}
+
+// setting index n is a mixed-radix number, first field varying fastest
+static int sweep_apply(struct gt_ch *ch, const struct sweep_field *fields, int field_count, int n)
+{
+    for (int k = 0; k < field_count; k++)
+    {
+        int count = sweep_field_count(&fields[k]);
+        int val = fields[k].start + (n % count) * fields[k].step;
+
+        n /= count;
+
+        if (gt_ch_reg_write_masked(ch, fields[k].addr, val, fields[k].mask, fields[k].shift))
+            return -1;
+    }
+
+    return 0;
+}
+
+static void sweep_print_setting(const struct sweep_field *fields, int field_count, int n)
+{
+    for (int k = 0; k < field_count; k++)
+    {
+        int count = sweep_field_count(&fields[k]);
+
+        printf(" 0x%04x=%d", fields[k].addr, fields[k].start + (n % count) * fields[k].step);
+        n /= count;
+    }
+}
+
+/*
+ * Equalization sweep: every setting is written to all selected channels,
+ * then a coarse eye scan runs on all of them at once (the scans are stepped
+ * round-robin, like -c).  The score is the number of error-free eye points,
+ * ties going to the lower total BER, and each channel is left at its best
+ * setting.
+ */
+static int run_sweep(struct gt_quad **gt_quads, int num_quads, int channel_mask,
+        const struct sweep_field *fields, int field_count)
+{
+    struct gt_eyescan_params params;
+    struct gt_eyescan_point point;
+    struct gt_ch *chs[SWEEP_MAX_CH];
+    int ch_index[SWEEP_MAX_CH];
+    int active[SWEEP_MAX_CH];
+    int score[SWEEP_MAX_CH];
+    double ber_sum[SWEEP_MAX_CH];
+    int best[SWEEP_MAX_CH];
+    int best_score[SWEEP_MAX_CH];
+    double best_ber_sum[SWEEP_MAX_CH];
+    int ch_count = 0;
+    int settings = 1;
+    int done;
+    int ret;
+
+    for (int qi = 0; qi < num_quads; qi++)
+    {
+        for (int ci = 0; ci < gt_quads[qi]->ch_count; ci++)
+        {
+            int index = qi*4 + ci;
+
+            if ((channel_mask & (1 << index)) == 0)
+                continue;
+
+            chs[ch_count] = &gt_quads[qi]->ch[ci];
+            ch_index[ch_count] = index;
+            best[ch_count] = -1;
+            best_score[ch_count] = -1;
+            best_ber_sum[ch_count] = 0;
+            ch_count++;
+        }
+    }
+
+    for (int k = 0; k < field_count; k++)
+        settings *= sweep_field_count(&fields[k]);
+
+    printf("Sweep %d settings on %d channels\n", settings, ch_count);
+
+    for (int n = 0; n < settings; n++)
+    {
+        params.target_bit_count = 1ULL << 24;
+        params.h_range = 0;
+        params.h_start = -32;
+        params.h_stop = 32;
+        params.h_step = 8;
+        params.v_range = 0;
+        params.v_start = -96;
+        params.v_stop = 96;
+        params.v_step = 24;
+
+        for (int k = 0; k < ch_count; k++)
+        {
+            score[k] = 0;
+            ber_sum[k] = 0;
+            active[k] = 0;
+
+            if (sweep_apply(chs[k], fields, field_count, n))
+            {
+                fprintf(stderr, "Failed to apply setting on channel %d\n", ch_index[k]);
+                continue;
+            }
+
+            // eye scan start resets the RX PMA, so the setting takes effect here
+            if (gt_ch_eyescan_start(chs[k], &params) < 0)
+            {
+                fprintf(stderr, "Channel %d did not lock\n", ch_index[k]);
+                continue;
+            }
+
+            active[k] = 1;
+        }
+
+        done = 0;
+        while (!done)
+        {
+            done = 1;
+            for (int k = 0; k < ch_count; k++)
+            {
+                if (!active[k])
+                    continue;
+
+                ret = gt_ch_eyescan_step(chs[k], &point);
+                if (ret < 0)
+                {
+                    fprintf(stderr, "Eye scan failed on channel %d\n", ch_index[k]);
+                    active[k] = 0;
+                    score[k] = -1;
+                    continue;
+                }
+                if (ret == 1)
+                {
+                    if (!point.error_count)
+                        score[k]++;
+                    if (point.bit_count)
+                        ber_sum[k] += (double)point.error_count / point.bit_count;
+                }
+                if (ret)
+                    done = 0;
+                else
+                    active[k] = 0;
+            }
+        }
+
+        printf("Setting %d:", n);
+        sweep_print_setting(fields, field_count, n);
+        printf("\n");
+
+        for (int k = 0; k < ch_count; k++)
+        {
+            printf("  channel %d: score %d ber_sum %g\n", ch_index[k], score[k], ber_sum[k]);
+
+            if (score[k] > best_score[k] || (score[k] == best_score[k] && score[k] >= 0 && ber_sum[k] < best_ber_sum[k]))
+            {
+                best[k] = n;
+                best_score[k] = score[k];
+                best_ber_sum[k] = ber_sum[k];
+            }
+        }
+    }
+
+    printf("Sweep results\n");
+
+    ret = 0;
+    for (int k = 0; k < ch_count; k++)
+    {
+        if (best[k] < 0 || best_score[k] < 0)
+        {
+            printf("Channel %d: no usable setting\n", ch_index[k]);
+            ret = -1;
+            continue;
+        }
+
+        printf("Channel %d: best", ch_index[k]);
+        sweep_print_setting(fields, field_count, best[k]);
+        printf(" score %d ber_sum %g\n", best_score[k], best_ber_sum[k]);
+
+        if (sweep_apply(chs[k], fields, field_count, best[k]) || gt_ch_rx_reset(chs[k]))
+        {
+            fprintf(stderr, "Failed to apply best setting on channel %d\n", ch_index[k]);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
 int main(int argc, char *argv[])
 {
     char *name;
@@ -41,10 +264,13 @@ int main(int argc, char *argv[])
 
     char *csv_file_name = NULL;
 
+    struct sweep_field sweep_fields[SWEEP_MAX_FIELDS];
+    int sweep_field_cnt = 0;
+
     name = strrchr(argv[0], '/');
     name = name ? 1+name : argv[0];
 
-    while ((opt = getopt(argc, argv, ":d:i:m:p:rt:c:h?")) != EOF)
+    while ((opt = getopt(argc, argv, ":d:i:m:p:rt:c:s:h?")) != EOF)
     {
         switch (opt)
         {
@@ -72,6 +298,19 @@ int main(int argc, char *argv[])
         case 'c':
             csv_file_name = optarg;
             break;
+        case 's':
+            if (sweep_field_cnt >= SWEEP_MAX_FIELDS)
+            {
+                fprintf(stderr, "Too many sweep fields\n");
+                return -1;
+            }
+            if (parse_sweep_field(optarg, &sweep_fields[sweep_field_cnt]))
+            {
+                fprintf(stderr, "Invalid sweep field: %s\n", optarg);
+                return -1;
+            }
+            sweep_field_cnt++;
+            break;
         case ':':
             switch (optopt)
             {
@@ -262,6 +501,13 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (sweep_field_cnt)
+    {
+        ret = run_sweep(gt_quads, num_quads, channel_mask, sweep_fields, sweep_field_cnt);
+        if (ret)
+            goto err;
+    }
+
     if (csv_file_name)
     {
         struct gt_eyescan_params params;
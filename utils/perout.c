@@ -20,6 +20,8 @@
 
 #include "timespec.h"
 
+#include <mqnic/mqnic.h>
+
 #ifndef CLOCK_INVALID
 #define CLOCK_INVALID -1
 #endif
@@ -39,11 +41,99 @@ static void usage(char *name)
     fprintf(stderr,
         "usage: %s [options]\n"
         " -d name    device to open\n"
+        " -m name    mqnic device to program all channels together on (/dev/mqnic0)\n"
         " -s number  start time (ns)\n"
-        " -p number  period (ns)\n",
+        " -p number  period (ns)\n"
+        " -w number  pulse width (ns, -m only)\n"
+        " -o list    comma-separated phase offsets, one per channel (ns, -m only)\n"
+        " -l number  minimum lead time before start (ns, -m only, default 10000000)\n",
         name);
 }
 
+static int mqnic_perout(const char *device, int64_t start_nsec, int64_t period_nsec,
+        int64_t width_nsec, const char *offsets, int64_t lead_nsec)
+{
+    struct mqnic *dev;
+    struct mqnic_perout_config config[MQNIC_MAX_PEROUT];
+    int count = 0;
+    uint64_t now_nsec;
+    int ret = -1;
+
+    memset(config, 0, sizeof(config));
+
+    dev = mqnic_open(device);
+
+    if (!dev)
+    {
+        fprintf(stderr, "Failed to open device\n");
+        return -1;
+    }
+
+    if (!dev->phc_rb)
+    {
+        fprintf(stderr, "No PHC on card\n");
+        goto err;
+    }
+
+    printf("Perout channels: %d\n", mqnic_perout_get_count(dev));
+
+    // one channel per offset, a single channel at offset 0 by default
+    do
+    {
+        char *end;
+
+        if (count >= mqnic_perout_get_count(dev))
+        {
+            fprintf(stderr, "More offsets than perout channels\n");
+            goto err;
+        }
+
+        config[count].enable = 1;
+        config[count].phase_ns = offsets ? strtoll(offsets, &end, 0) : 0;
+        config[count].period_ns = period_nsec;
+        config[count].width_ns = width_nsec;
+        count++;
+
+        offsets = offsets && *end == ',' ? end + 1 : NULL;
+    } while (offsets);
+
+    if (mqnic_phc_read_tod(dev, &now_nsec))
+    {
+        perror("Failed to read PHC time");
+        goto err;
+    }
+
+    // move a start time without enough lead to the same phase of a later period
+    if (start_nsec < (int64_t)now_nsec + lead_nsec)
+    {
+        int64_t ref_nsec = now_nsec + lead_nsec;
+
+        start_nsec = ns_align(ref_nsec, start_nsec, period_nsec);
+        if (start_nsec < ref_nsec)
+            start_nsec += period_nsec;
+    }
+
+    printf("time   %lu ns\n", now_nsec);
+    printf("start  %ld ns\n", start_nsec);
+    printf("period %ld ns\n", period_nsec);
+
+    for (int k = 0; k < count; k++)
+        printf("channel %d offset %ld ns\n", k, config[k].phase_ns);
+
+    if (mqnic_perout_arm(dev, config, count, start_nsec, lead_nsec / 2))
+    {
+        perror("Failed to arm perout channels");
+        goto err;
+    }
+
+    printf("Armed %d perout channels\n", count);
+    ret = 0;
+
+err:
+    mqnic_close(dev);
+    return ret;
+}
+
 int phc_index_from_if(const char *name)
 {
 #ifdef ETHTOOL_GET_TS_INFO
@@ -85,6 +175,8 @@ int main(int argc, char *argv[])
     int opt;
 
     char *device = NULL;
+    char *mqnic_device = NULL;
+    char *offsets = NULL;
     char dev_name[64];
     int ptp_fd;
     clockid_t clkid;
@@ -96,11 +188,13 @@ int main(int argc, char *argv[])
 
     int64_t start_nsec = 0;
     int64_t period_nsec = 0;
+    int64_t width_nsec = 0;
+    int64_t lead_nsec = 10000000;
 
     name = strrchr(argv[0], '/');
     name = name ? 1+name : argv[0];
 
-    while ((opt = getopt(argc, argv, "d:s:p:h?")) != EOF)
+    while ((opt = getopt(argc, argv, "d:m:s:p:w:o:l:h?")) != EOF)
     {
         switch (opt)
         {
@@ -113,6 +207,18 @@ int main(int argc, char *argv[])
         case 'p':
             period_nsec = atoll(optarg);
             break;
+        case 'm':
+            mqnic_device = optarg;
+            break;
+        case 'w':
+            width_nsec = atoll(optarg);
+            break;
+        case 'o':
+            offsets = optarg;
+            break;
+        case 'l':
+            lead_nsec = atoll(optarg);
+            break;
         case 'h':
         case '?':
             usage(name);
@@ -123,6 +229,17 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (mqnic_device)
+    {
+        if (period_nsec <= 0)
+        {
+            fprintf(stderr, "Period not specified\n");
+            return -1;
+        }
+
+        return mqnic_perout(mqnic_device, start_nsec, period_nsec, width_nsec, offsets, lead_nsec) ? -1 : 0;
+    }
+
     if (!device)
     {
         fprintf(stderr, "PTP device not specified\n");
@@ -165,29 +282,19 @@ int main(int argc, char *argv[])
         }
 
         // normalize start
-        ts_start.tv_sec = start_nsec / NSEC_PER_SEC;
-        ts_start.tv_nsec = start_nsec - ts_start.tv_sec * NSEC_PER_SEC;
+        ts_start = timespec_from_ns(start_nsec);
 
         // normalize period
-        ts_period.tv_sec = period_nsec / NSEC_PER_SEC;
-        ts_period.tv_nsec = period_nsec - ts_period.tv_sec * NSEC_PER_SEC;
+        ts_period = timespec_from_ns(period_nsec);
 
         printf("time   %ld.%09ld\n", ts_now.tv_sec, ts_now.tv_nsec);
         printf("start  %ld.%09ld\n", ts_start.tv_sec, ts_start.tv_nsec);
         printf("period %ld.%09ld\n", ts_period.tv_sec, ts_period.tv_nsec);
 
-        if (timespec_lt(ts_start, ts_now))
+        if (start_nsec < timespec_to_ns(ts_now))
         {
-            // start time is in the past
-
-            // modulo start with period
-            ts_start = timespec_mod(ts_start, ts_period);
-
-            // align time with period
-            struct timespec ts_aligned = timespec_sub(ts_now, timespec_mod(ts_now, ts_period));
-
-            // add aligned time
-            ts_start = timespec_add(ts_start, ts_aligned);
+            // start time is in the past, move it to its phase in the current period
+            ts_start = timespec_from_ns(ns_align(timespec_to_ns(ts_now), start_nsec, period_nsec));
         }
 
         printf("time   %ld.%09ld\n", ts_now.tv_sec, ts_now.tv_nsec);
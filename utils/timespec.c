@@ -100,12 +100,14 @@ struct timespec timespec_sub(struct timespec ts1, struct timespec ts2)
 
 /** \fn struct timespec timespec_mod(struct timespec ts1, struct timespec ts2)
  *  \brief Returns the remainder left over after dividing ts1 by ts2 (ts1%ts2).
+ *
+ * The result has the sign of ts2.  The remainder is computed on 128-bit
+ * nanosecond counts, which hold any pair of timespec values exactly.
 */
 struct timespec timespec_mod(struct timespec ts1, struct timespec ts2)
 {
-	int i = 0;
-	bool neg1 = false;
-	bool neg2 = false;
+	__int128 a, b, r;
+	struct timespec ts;
 
 	/* Normalise inputs to prevent tv_nsec rollover if whole-second values
 	 * are packed in it.
@@ -120,75 +122,21 @@ struct timespec timespec_mod(struct timespec ts1, struct timespec ts2)
 		return ts1;
 	}
 
-	/* If inputs are negative, flip and record sign
-	*/
-	if (ts1.tv_sec < 0 || ts1.tv_nsec < 0)
-	{
-		neg1 = true;
-		ts1.tv_sec = -ts1.tv_sec;
-		ts1.tv_nsec = -ts1.tv_nsec;
-	}
-
-	if (ts2.tv_sec < 0 || ts2.tv_nsec < 0)
-	{
-		neg2 = true;
-		ts2.tv_sec = -ts2.tv_sec;
-		ts2.tv_nsec = -ts2.tv_nsec;
-	}
+	a = (__int128)ts1.tv_sec * NSEC_PER_SEC + ts1.tv_nsec;
+	b = (__int128)ts2.tv_sec * NSEC_PER_SEC + ts2.tv_nsec;
 
-	/* Shift ts2 until it is larger than ts1 or is about to overflow
+	/* If signs differ and result is nonzero, add once more to cross zero
 	*/
-	while ((ts2.tv_sec < (LONG_MAX >> 1)) && timespec_ge(ts1, ts2))
+	r = a % b;
+	if (r != 0 && ((r < 0) != (b < 0)))
 	{
-		i++;
-		ts2.tv_nsec <<= 1;
-		ts2.tv_sec <<= 1;
-        if (ts2.tv_nsec > NSEC_PER_SEC)
-        {
-            ts2.tv_nsec -= NSEC_PER_SEC;
-            ts2.tv_sec++;
-        }
+		r += b;
 	}
 
-	/* Division by repeated subtraction
-	*/
-	while (i >= 0)
-	{
-		if (timespec_ge(ts1, ts2))
-		{
-			ts1 = timespec_sub(ts1, ts2);
-		}
-
-		if (i == 0)
-		{
-			break;
-		}
-
-		i--;
-		if (ts2.tv_sec & 1)
-		{
-			ts2.tv_nsec += NSEC_PER_SEC;
-		}
-		ts2.tv_nsec >>= 1;
-		ts2.tv_sec >>= 1;
-	}
+	ts.tv_sec = r / NSEC_PER_SEC;
+	ts.tv_nsec = r % NSEC_PER_SEC;
 
-	/* If signs differ and result is nonzero, subtract once more to cross zero
-	*/
-	if (neg1 ^ neg2 && (ts1.tv_sec != 0 || ts1.tv_nsec != 0))
-	{
-		ts1 = timespec_sub(ts1, ts2);
-	}
-
-	/* Restore sign
-	*/
-	if (neg1)
-	{
-		ts1.tv_sec = -ts1.tv_sec;
-		ts1.tv_nsec = -ts1.tv_nsec;
-	}
-
-	return ts1;
+	return ts;
 }
 
 /** \fn bool timespec_eq(struct timespec ts1, struct timespec ts2)
@@ -318,37 +266,21 @@ long timespec_to_ms(struct timespec ts)
 */
 struct timespec timespec_normalise(struct timespec ts)
 {
-	while(ts.tv_nsec >= NSEC_PER_SEC)
-	{
-		++(ts.tv_sec);
-		ts.tv_nsec -= NSEC_PER_SEC;
-	}
-	
-	while(ts.tv_nsec <= -NSEC_PER_SEC)
-	{
-		--(ts.tv_sec);
-		ts.tv_nsec += NSEC_PER_SEC;
-	}
-	
-	if(ts.tv_nsec < 0 && ts.tv_sec > 0)
-	{
-		/* Negative nanoseconds while seconds is positive.
-		 * Decrement tv_sec and roll tv_nsec over.
-		*/
-		
-		--(ts.tv_sec);
-		ts.tv_nsec = NSEC_PER_SEC - (-1 * ts.tv_nsec);
-	}
-	else if(ts.tv_nsec > 0 && ts.tv_sec < 0)
-	{
-		/* Positive nanoseconds while seconds is negative.
-		 * Increment tv_sec and roll tv_nsec over.
-		*/
-		
-		++(ts.tv_sec);
-		ts.tv_nsec = -NSEC_PER_SEC - (-1 * ts.tv_nsec);
-	}
-	
+	long adj;
+
+	/* Flatten surplus nanoseconds into tv_sec; the remainder keeps the
+	 * sign of tv_nsec.
+	*/
+	ts.tv_sec += ts.tv_nsec / NSEC_PER_SEC;
+	ts.tv_nsec %= NSEC_PER_SEC;
+
+	/* Move tv_nsec onto the side of zero that tv_sec is on, without
+	 * branching: adj is 1 for rule 2, -1 for rule 3, 0 otherwise.
+	*/
+	adj = (ts.tv_nsec < 0 && ts.tv_sec > 0) - (ts.tv_nsec > 0 && ts.tv_sec < 0);
+	ts.tv_sec -= adj;
+	ts.tv_nsec += adj * NSEC_PER_SEC;
+
 	return ts;
 }
 
@@ -409,6 +341,26 @@ struct timespec timespec_normalise(struct timespec ts)
 	} \
 }
 
+#define TEST_NS_MOD(a, b, expect) { \
+	int64_t got = ns_mod(a, b); \
+	if(got != expect) { \
+		printf("ns_mod(%lld, %lld) returned wrong value\n", (long long)(a), (long long)(b)); \
+		printf("    Expected: %lld\n", (long long)(expect)); \
+		printf("    Got:      %lld\n", (long long)(got)); \
+		result = 1; \
+	} \
+}
+
+#define TEST_NS_ALIGN(t, phase, period, expect) { \
+	int64_t got = ns_align(t, phase, period); \
+	if(got != expect) { \
+		printf("ns_align(%lld, %lld, %lld) returned wrong value\n", (long long)(t), (long long)(phase), (long long)(period)); \
+		printf("    Expected: %lld\n", (long long)(expect)); \
+		printf("    Got:      %lld\n", (long long)(got)); \
+		result = 1; \
+	} \
+}
+
 #define TEST_TEST_FUNC(func, ts1_sec, ts1_nsec, ts2_sec, ts2_nsec, expect) { \
 	struct timespec ts1 = { .tv_sec = ts1_sec, .tv_nsec = ts1_nsec }; \
 	struct timespec ts2 = { .tv_sec = ts2_sec, .tv_nsec = ts2_nsec }; \
@@ -547,6 +499,25 @@ int main()
 	TEST_MOD(LONG_MAX,0,  0,1,         0,0);
 	TEST_MOD(LONG_MAX,0,  LONG_MAX,1,  LONG_MAX,0);
 	
+	// ns_mod
+
+	TEST_NS_MOD(0,           0,          0);
+	TEST_NS_MOD(1,           0,          1);
+	TEST_NS_MOD(10,          3,          1);
+	TEST_NS_MOD(10,          -3,         -2);
+	TEST_NS_MOD(-10,         3,          2);
+	TEST_NS_MOD(-10,         -3,         -1);
+	TEST_NS_MOD(-10,         5,          0);
+	TEST_NS_MOD(5500000000,  2999999999, 2500000001);
+	TEST_NS_MOD(INT64_MAX,   1,          0);
+
+	// ns_align
+
+	TEST_NS_ALIGN(1050, 20,   100, 1020);
+	TEST_NS_ALIGN(1050, 1020, 100, 1020);
+	TEST_NS_ALIGN(1000, 0,    100, 1000);
+	TEST_NS_ALIGN(-50,  20,   100, -80);
+
 	// timespec_eq
 	
 	TEST_TEST_FUNC(timespec_eq, 0,0,    0,0,    true);
@@ -32,6 +32,7 @@
 #define DAN_TIMESPEC_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/time.h>
 #include <time.h>
 
@@ -58,6 +59,60 @@ long timespec_to_ms(struct timespec ts);
 
 struct timespec timespec_normalise(struct timespec ts);
 
+/* Integer nanosecond time
+ *
+ * Schedule arithmetic on plain int64_t nanoseconds (good for +/-292 years)
+ * needs no normalisation at all: add, subtract and compare are single
+ * instructions, and a modulo is one division.  Convert to and from
+ * timespec only at the edges.
+*/
+
+#define TIMESPEC_NSEC_PER_SEC 1000000000LL
+
+static inline int64_t timespec_to_ns(struct timespec ts)
+{
+	return (int64_t)ts.tv_sec * TIMESPEC_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* Result is normalised: tv_sec and tv_nsec carry the same sign */
+static inline struct timespec timespec_from_ns(int64_t ns)
+{
+	struct timespec ts = {
+		.tv_sec  = ns / TIMESPEC_NSEC_PER_SEC,
+		.tv_nsec = ns % TIMESPEC_NSEC_PER_SEC,
+	};
+
+	return ts;
+}
+
+/* a mod b with the sign of b, like timespec_mod; returns a if b is zero */
+static inline int64_t ns_mod(int64_t a, int64_t b)
+{
+	int64_t r;
+
+	if (b == 0)
+		return a;
+
+	/* INT64_MIN % -1 overflows */
+	if (b == -1)
+		return 0;
+
+	r = a % b;
+	return r + (b & -(int64_t)((r != 0) & ((r ^ b) < 0)));
+}
+
+/* Time with the phase of phase mod period, in the period that contains t */
+static inline int64_t ns_align(int64_t t, int64_t phase, int64_t period)
+{
+	return t - ns_mod(t, period) + ns_mod(phase, period);
+}
+
+/* a * b / c with a 128-bit intermediate product */
+static inline int64_t ns_mul_div(int64_t a, int64_t b, int64_t c)
+{
+	return (int64_t)((__int128)a * b / c);
+}
+
 #ifdef __cplusplus
 }
 #endif
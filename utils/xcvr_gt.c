@@ -62,7 +62,11 @@ int gt_pll_reg_write_multiple(struct gt_pll *pll, const struct gt_reg_val *vals)
 
     while (val && val->mask)
     {
-        ret = gt_pll_reg_write_masked(pll, val->addr, val->value, val->mask, val->shift);
+        // whole register fields need no read-modify-write
+        if (val->mask == 0xffff)
+            ret = gt_pll_reg_write(pll, val->addr, (val->value << val->shift) & val->mask);
+        else
+            ret = gt_pll_reg_write_masked(pll, val->addr, val->value, val->mask, val->shift);
         if (ret)
             return ret;
         val++;
@@ -119,7 +123,11 @@ int gt_ch_reg_write_multiple(struct gt_ch *ch, const struct gt_reg_val *vals)
 
     while (val && val->mask)
     {
-        ret = gt_ch_reg_write_masked(ch, val->addr, val->value, val->mask, val->shift);
+        // whole register fields need no read-modify-write
+        if (val->mask == 0xffff)
+            ret = gt_ch_reg_write(ch, val->addr, (val->value << val->shift) & val->mask);
+        else
+            ret = gt_ch_reg_write_masked(ch, val->addr, val->value, val->mask, val->shift);
         if (ret)
             return ret;
         val++;